@@ -128,6 +128,7 @@ typedef struct APIC_timer_state
 {
     volatile uint32_t periodic_initial_count;
     volatile uint32_t calibrated_hz;
+    volatile uint64_t tsc_hz;       // TSC rate measured against the same reference as the LAPIC timer.
     volatile uint8_t calibrated;
 } APIC_timer_state_t;
 
@@ -170,5 +171,6 @@ bool APIC_startup_ap(uint8_t apic_id, uint8_t startup_vector);
 void APIC_send_EOI(void);
 bool APIC_timer_init_bsp(uint32_t hz);
 bool APIC_timer_init_ap(uint32_t hz);
+uint64_t APIC_get_tsc_hz(void);
 
 #endif
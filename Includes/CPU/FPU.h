@@ -17,10 +17,26 @@
 #define FPU_XCR0_AVX           (1ULL << 2)
 
 #define FPU_XSAVE_CPUID_LEAF   0xDU
+#define FPU_XSAVE_SUBLEAF_EXT  1U
+#define FPU_XSAVE_FEAT_OPT     (1U << 0)   // CPUID.(0xD,1):EAX, XSAVEOPT.
+#define FPU_XSAVE_FEAT_COMPACT (1U << 1)   // CPUID.(0xD,1):EAX, XSAVEC.
+#define FPU_XSAVE_FEAT_XINUSE  (1U << 2)   // CPUID.(0xD,1):EAX, XGETBV with ECX=1.
+#define FPU_XSAVE_COMP_ALIGN64 (1U << 1)   // CPUID.(0xD,i):ECX, component is 64-byte aligned when compacted.
+#define FPU_XSAVE_LEGACY_SIZE  512U
+#define FPU_XSAVE_HEADER_SIZE  64U
 #define FPU_XSAVE_ALIGN        64U
 #define FPU_XSAVE_AREA_MAX     4096U
+#define FPU_MXCSR_DEFAULT      0x1F80U
 #define FPU_STRESS_CPU_SLOTS   256U
 
+typedef enum FPU_save_mode
+{
+    FPU_SAVE_MODE_FXSAVE = 0,
+    FPU_SAVE_MODE_XSAVE,
+    FPU_SAVE_MODE_XSAVEOPT,     // Standard layout, init and modified optimizations.
+    FPU_SAVE_MODE_XSAVEC        // Compacted layout, init optimization.
+} FPU_save_mode_t;
+
 typedef struct FPU_fx_state
 {
     uint8_t bytes[512];
@@ -31,15 +47,26 @@ typedef struct FPU_xsave_buffer
     uint8_t bytes[FPU_XSAVE_AREA_MAX];
 } __attribute__((aligned(FPU_XSAVE_ALIGN))) FPU_xsave_buffer_t;
 
+typedef struct FPU_switch_stats
+{
+    uint64_t saves;
+    uint64_t saves_skipped;         // Registers were in init state: nothing written.
+    uint64_t restores;
+    uint64_t restores_skipped;      // Incoming task and registers both in the init configuration.
+} FPU_switch_stats_t;
+
 typedef struct FPU_runtime_state
 {
     FPU_xsave_buffer_t initial_state;
     bool initial_state_ready;
     bool sse_enabled;
     bool avx_enabled;
-    uint8_t reserved0;
-    uint32_t state_area_size;
+    bool has_xinuse;
+    uint8_t save_mode;              // FPU_SAVE_MODE_*.
+    uint32_t state_area_size;       // Per-task area: compacted size under XSAVEC.
+    uint32_t standard_area_size;    // Non-compacted size for the enabled XCR0 features.
     uint64_t state_mask;
+    FPU_switch_stats_t cpu_stats[FPU_STRESS_CPU_SLOTS];
     FPU_xsave_buffer_t stress_state_a[FPU_STRESS_CPU_SLOTS];
     FPU_xsave_buffer_t stress_state_b[FPU_STRESS_CPU_SLOTS];
 } FPU_runtime_state_t;
@@ -51,5 +78,8 @@ void FPU_switch_task(struct task* prev, struct task* next);
 bool FPU_is_sse_enabled(void);
 bool FPU_is_avx_enabled(void);
 bool FPU_stress_ymm_local(uint32_t iterations, uint64_t* signature_out);
+bool FPU_bench_switch_local(uint32_t iterations, bool avx_dirty, uint64_t* cycles_out);
+const char* FPU_get_save_mode_name(void);
+void FPU_get_switch_stats(uint32_t cpu_index, FPU_switch_stats_t* out);
 
 #endif
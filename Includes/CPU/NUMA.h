@@ -107,6 +107,8 @@ typedef struct NUMA_runtime_state
 void NUMA_init(void);
 bool NUMA_is_available(void);
 uint32_t NUMA_get_node_count(void);
+uint32_t NUMA_get_node_index(uint32_t node_id);
+uint32_t NUMA_get_node_id(uint32_t index);
 uint32_t NUMA_get_cpu_node(uint32_t cpu_index);
 uint32_t NUMA_get_apic_node(uint32_t apic_id);
 uint32_t NUMA_get_distance(uint32_t from_node, uint32_t to_node);
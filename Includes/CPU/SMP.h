@@ -30,6 +30,7 @@
 #ifndef ASM_FILE
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 #include <Debug/Spinlock.h>
@@ -68,18 +69,43 @@
 #define SMP_SCHED_MAX_JOBS           ((SMP_SCHED_STRESS_JOBS > SMP_SCHED_BALANCE_JOBS) ? SMP_SCHED_STRESS_JOBS : SMP_SCHED_BALANCE_JOBS)
 #define SMP_TLB_SHOOTDOWN_TIMEOUT    50000000U
 #define SMP_TLB_TEST_ENABLE          1
+#define SMP_TLB_FLUSH_ALL_PAGES      32U     // Ranges above this drop the whole context instead of invlpg per page.
 #define SMP_YMM_STRESS_ENABLE        1
 #define SMP_YMM_STRESS_ITERS         4096U
 #define SMP_YMM_STRESS_TIMEOUT       300000000U
+#define SMP_YMM_BENCH_ITERS          4096U
+#define SMP_PAGE_STORM_ENABLE        1
+#define SMP_PAGE_STORM_ITERS         2048U
+#define SMP_PAGE_STORM_BATCH         8U      // Pages each iteration holds at once, like a burst of faults.
+#define SMP_PAGE_STORM_TIMEOUT       300000000U
+#define SMP_ZERO_POOL_TEST_ENABLE    1
+#define SMP_ZERO_POOL_TEST_PAGES     128U    // Under PMM_ZERO_POOL_HIGH, so a filled pool serves them all.
+#define SMP_SLAB_STRESS_ENABLE       1
+#define SMP_SLAB_STRESS_ITERS        2048U
+#define SMP_SLAB_STRESS_BATCH        24U     // Over a magazine, so refills and drains both run.
+#define SMP_SLAB_STRESS_OBJECT       96U
+#define SMP_SLAB_STRESS_PATTERN      0xC0FFEE0DDBA11ULL
+#define SMP_SLAB_STRESS_TIMEOUT      300000000U
 #define SMP_TIMER_INIT_TIMEOUT       50000000U
 
 typedef enum SMP_tlb_shootdown_kind
 {
     SMP_TLB_SHOOTDOWN_NONE = 0,
     SMP_TLB_SHOOTDOWN_PAGE = 1,
-    SMP_TLB_SHOOTDOWN_ALL = 2
+    SMP_TLB_SHOOTDOWN_ALL = 2,
+    SMP_TLB_SHOOTDOWN_RANGE = 3,
+    SMP_TLB_SHOOTDOWN_RELEASE = 4       // Switch away from an address space about to be freed.
 } SMP_tlb_shootdown_kind_t;
 
+typedef struct SMP_tlb_stats
+{
+    uint64_t requests;              // Remote flushes asked for (one per page, range or context).
+    uint64_t requests_no_ipi;       // ... that found no CPU with the address space live.
+    uint64_t ipis;                  // Shootdown IPIs sent.
+    uint64_t pages;                 // Pages covered by range requests.
+    uint64_t full_flushes;          // Range requests widened to a whole-context flush.
+} SMP_tlb_stats_t;
+
 typedef struct SMP_handoff
 {
     uint64_t magic;
@@ -138,7 +164,9 @@ typedef struct SMP_tests
     spinlock_t tlb_lock;
     uint64_t tlb_generation;
     uintptr_t tlb_target_virt;
+    uint64_t tlb_target_pages;
     uint8_t tlb_kind;
+    SMP_tlb_stats_t tlb_stats;
 } SMP_tests_t;
 
 typedef struct SMP_runtime_state
@@ -156,6 +184,15 @@ typedef struct SMP_runtime_state
     uint8_t ymm_done_cpu[SMP_MAX_CPUS];
     uint8_t ymm_fail_cpu[SMP_MAX_CPUS];
     uint64_t ymm_signature_cpu[SMP_MAX_CPUS];
+    uint64_t ymm_bench_clean_cycles_cpu[SMP_MAX_CPUS];  // FPU switch cost, both tasks in init state.
+    uint64_t ymm_bench_dirty_cycles_cpu[SMP_MAX_CPUS];  // FPU switch cost, both tasks with live ymm state.
+    uint8_t page_storm_done_cpu[SMP_MAX_CPUS];
+    uint8_t page_storm_fail_cpu[SMP_MAX_CPUS];
+    uint64_t page_storm_cycles_cpu[SMP_MAX_CPUS];
+    uint8_t slab_done_cpu[SMP_MAX_CPUS];
+    uint8_t slab_fail_cpu[SMP_MAX_CPUS];
+    uint64_t slab_cycles_cpu[SMP_MAX_CPUS];
+    struct kmem_cache* slab_test_cache;
     bool initialized;
     uint32_t bsp_apic_id;
 } SMP_runtime_state_t;
@@ -172,6 +209,10 @@ uint64_t SMP_get_sched_kick_count(uint32_t cpu_id);
 bool SMP_send_ipi_to_others(uint8_t vector);
 bool SMP_tlb_shootdown_page(uintptr_t virt);
 bool SMP_tlb_shootdown_all(void);
+bool SMP_tlb_shootdown_range(uintptr_t cr3_phys, uintptr_t virt, size_t page_count);
+bool SMP_tlb_shootdown_address_space(uintptr_t cr3_phys);
+bool SMP_tlb_release_address_space(uintptr_t cr3_phys);
+void SMP_get_tlb_stats(SMP_tlb_stats_t* out);
 bool SMP_start_ap_timers(void);
 
 #endif
@@ -23,7 +23,15 @@ static void SMP_sched_patho_short_job(void* arg);
 static bool SMP_run_sched_pathological_test(void);
 static void SMP_ymm_stress_job(void* arg);
 static bool SMP_run_ymm_stress_test(void);
+static void SMP_page_storm_job(void* arg);
+static bool SMP_run_page_storm_round(const uint8_t* cpu_targets, uint32_t cpu_count, bool pcp_enabled);
+static bool SMP_run_page_storm_test(void);
+static bool SMP_zero_pool_round(uint64_t* out_cycles);
+static bool SMP_run_zero_pool_test(void);
+static void SMP_slab_stress_ctor(void* obj);
+static void SMP_slab_stress_job(void* arg);
+static bool SMP_run_slab_stress_test(void);
 static bool SMP_validate_tlb_shootdown(void);
-static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t virt);
+static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t cr3_phys, uintptr_t virt, uint64_t pages);
 
 #endif
@@ -9,6 +9,20 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// Limits on IPC and console objects, set at configure time: only their pointer tables are static.
+#ifndef THEOS_MAX_PIPES
+#define THEOS_MAX_PIPES 256
+#endif
+#ifndef THEOS_MAX_MSG_QUEUES
+#define THEOS_MAX_MSG_QUEUES 256
+#endif
+#ifndef THEOS_MAX_SHM_SEGMENTS
+#define THEOS_MAX_SHM_SEGMENTS 128
+#endif
+#ifndef THEOS_MAX_CONSOLE_ROUTES
+#define THEOS_MAX_CONSOLE_ROUTES 64
+#endif
+
 #define SYSCALL_INT 0x80
 
 #define SYSCALL_FMASK_TF_BIT        (1ULL << 8)
@@ -19,19 +33,45 @@
 #define SYSCALL_CONSOLE_MAX_WRITE      4096U
 #define SYSCALL_PAGE_SIZE              0x1000ULL
 #define SYSCALL_MAP_MAX_PAGES          16384U
+#define SYSCALL_UNMAP_BATCH_PAGES      64U      // Pages unmapped per TLB flush: their frames wait for it.
 #define SYSCALL_MAP_HINT_BASE          0x0000000050000000ULL
 #define SYSCALL_MAP_HINT_LIMIT         0x000000006F000000ULL
+#define SYSCALL_THP_PAGES              512U     // 4 KiB pages behind one 2 MiB PDT entry.
+#define SYSCALL_THP_SIZE               (SYSCALL_THP_PAGES * SYSCALL_PAGE_SIZE)
+#define SYSCALL_THP_ORDER              9U
+#define SYSCALL_THP_SCAN_BUDGET        64U      // PDT entries looked at per collapse pass.
+#define SYSCALL_THP_COLLAPSE_BUDGET    1U       // Page tables folded into 2 MiB pages per pass.
+#define SYSCALL_SWAP_BATCH             32U      // Pages unmapped per TLB flush when swapping out.
+#define SYSCALL_SWAP_SCAN_PAGES        8192U    // Resident PTEs one pass looks at per address space.
+#define SYSCALL_SWAP_DIRECT_PAGES      64U      // Pages a faulting thread swaps out itself when memory is short.
+#define SYSCALL_SWAP_DIRECT_WAIT       100000U  // Pauses it waits for the background pass before trying.
 #define SYSCALL_MAX_OPEN_FILES         64U
 /*128 slots : saturations fréquentes sous charge (GUI + threads + DHCP), fork → -1 → EAGAIN côté LibC. */
 #define SYSCALL_MAX_PROCS              256U
 #define SYSCALL_MAX_EXIT_EVENTS        256U
 #define SYSCALL_MAX_THREAD_EXIT_EVENTS 128U
-#define SYSCALL_MAX_CONSOLE_ROUTES     16U
+#define SYSCALL_MAX_CONSOLE_ROUTES     ((uint32_t) THEOS_MAX_CONSOLE_ROUTES)
 #define SYSCALL_CONSOLE_CAPTURE_SIZE   16384U
 #define SYSCALL_CONSOLE_PTY_INPUT_SIZE 4096U
 #define SYSCALL_PATH_MAX_COMPONENTS    32U
 #define SYSCALL_PATH_COMPONENT_MAX     255U
 #define SYSCALL_PROC_NONE              0xFFFFFFFFU
+#define SYSCALL_PROC_KSTACK_SIZE       KERNEL_STACK_SIZE
+#define SYSCALL_RQ_PICK_SCAN_MAX       8U
+#define SYSCALL_OWNER_RUN_BUCKETS      512U
+#define SYSCALL_PID_HASH_BUCKETS       512U
+#define SYSCALL_VM_LOCK_BUCKETS        64U
+#define SYSCALL_MM_BUCKETS             512U     // Accounting slots, one per live address space.
+#define SYSCALL_NR_MAX                 84U
+#define SYSCALL_ENTRY_FAST             (1U << 0) // Trivial call: may sysret without the post handler.
+#define SYSCALL_RUN_STATE_NONE         0U
+#define SYSCALL_RUN_STATE_QUEUED       1U
+#define SYSCALL_RUN_STATE_RUNNING      2U
+#define SYSCALL_RUN_STATE_BLOCKED      3U
+#define SYSCALL_RT_PRIO_LEVELS         (SYS_SCHED_RT_PRIO_MAX + 1U)
+#define SYSCALL_RT_PERIOD_TICKS        100U
+#define SYSCALL_RT_RUNTIME_TICKS       95U
+#define SYSCALL_SCHED_NICE_0_WEIGHT    1024U
 #define SYSCALL_ELF_MAX_SIZE           (16ULL * 1024ULL * 1024ULL)
 #define SYSCALL_ELF_MAX_PHDRS          64U
 #define SYSCALL_ELF_STACK_TOP          0x0000000070000000ULL
@@ -56,6 +96,11 @@
 #define SYSCALL_PTE_PS                 (1ULL << 7)
 #define SYSCALL_PTE_COW                (1ULL << 9)
 #define SYSCALL_PTE_DMABUF             (1ULL << 10)
+#define SYSCALL_PTE_VVAR               (1ULL << 11) // Shared kernel-owned page: never freed or COW-split.
+#define SYSCALL_PTE_LAZY               (1ULL << 52) // Non-present anonymous page: zero-filled on first touch.
+#define SYSCALL_PTE_FILE               (1ULL << 53) // Private copy of file data: accounted as file, not anon.
+#define SYSCALL_PTE_SWAP               (1ULL << 54) // With LAZY: compressed in the swap pool, slot in the frame bits.
+#define SYSCALL_PTE_ACCESSED           (1ULL << 5)
 #define SYSCALL_ELF_PF_X               (1U << 0)
 #define SYSCALL_ELF_PF_W               (1U << 1)
 #define SYSCALL_ELF_PF_R               (1U << 2)
@@ -93,8 +138,8 @@
 #define SYSCALL_ELF64_ST_TYPE(info)    ((uint8_t) ((info) & 0x0FU))
 #define SYSCALL_PAGE_FAULT_PRESENT     (1ULL << 0)
 #define SYSCALL_PAGE_FAULT_WRITE       (1ULL << 1)
+#define SYSCALL_PAGE_FAULT_INSTR       (1ULL << 4)
 #define SYSCALL_PREEMPT_QUANTUM_TICKS  2U
-#define SYSCALL_COW_MAX_REFS           32768U
 #define SYSCALL_RFLAGS_IF              (1ULL << 9)
 
 #define SYSCALL_FD_TYPE_NONE     0U
@@ -131,6 +176,20 @@ typedef struct syscall_frame
     uint64_t reserved0;
 } syscall_frame_t;
 
+typedef uint64_t (*syscall_handler_fn_t)(uint32_t cpu_index, const syscall_frame_t* frame);
+
+typedef struct syscall_table_entry
+{
+    syscall_handler_fn_t fn;
+    uint32_t flags;
+} syscall_table_entry_t;
+
+typedef struct syscall_cpu_stats
+{
+    uint64_t calls[SYSCALL_NR_MAX];
+    uint64_t fast_returns;
+} syscall_cpu_stats_t;
+
 typedef struct syscall_user_resume_context
 {
     uint64_t rax;
@@ -177,6 +236,7 @@ typedef struct syscall_file_desc
 
 typedef struct syscall_process
 {
+    spinlock_t lock;                // Register image and exit state; nests inside proc_lock.
     bool used;
     bool exiting;
     bool terminated_by_signal;
@@ -185,6 +245,7 @@ typedef struct syscall_process
     uint32_t pid;
     uint32_t ppid;
     uint32_t owner_pid;
+    uint32_t pid_hash_next;         // Next slot of the pid hash chain, walked under RCU.
     uint32_t console_sid;
     uint32_t domain;
     int64_t exit_status;
@@ -212,11 +273,72 @@ typedef struct syscall_process
     uint64_t rsp;
     uint64_t pending_rax;
     uint32_t last_cpu;
+    uint8_t run_state;              // SYSCALL_RUN_STATE_*: queued, running or blocked on rq_cpu.
+    uint32_t rq_cpu;
+    uint32_t rq_prev;
+    uint32_t rq_next;
+    uint8_t sched_policy;           // SYS_SCHED_OTHER, SYS_SCHED_FIFO or SYS_SCHED_RR.
+    uint8_t rt_priority;            // SYS_SCHED_RT_PRIO_MIN..MAX under the real-time policies.
+    int8_t nice;
+    bool sched_yielded;             // Gave the CPU away: goes behind its peers on the next pick.
+    uint32_t sched_weight;          // Fair-class weight derived from nice.
+    uint64_t vruntime;              // Weighted TSC cycles consumed (fair class).
+    uint64_t exec_start_tsc;
+    bool in_kernel;                 // Inside a syscall: run time is charged to stime.
+    uint64_t utime_tsc;
+    uint64_t stime_tsc;
+    uint64_t wait_tsc;              // Time spent queued behind other threads.
+    uint64_t blocked_tsc;           // Time spent parked on a wait.
+    uint64_t state_since_tsc;       // When the current queued/blocked stint began.
+    uint64_t nvcsw;
+    uint64_t nivcsw;
+    syscall_rusage_t dead_usage;    // Exited threads (TSC cycles), kept on the owner main slot.
+    syscall_rusage_t child_usage;   // Exited non-thread children (TSC cycles).
+    uint64_t cpu_mask[SYS_SCHED_CPUSET_WORDS];
+    uintptr_t kernel_rsp;           // Saved kernel context while parked (0 = runs from user state).
+    uint64_t block_deadline;        // Timer tick at which a timed wait gives up (0 = none).
+    task_waiter_t* block_waiter;
 } syscall_process_t;
 
+typedef struct syscall_proc_list
+{
+    uint32_t head;
+    uint32_t tail;
+    volatile uint32_t count;
+} syscall_proc_list_t;
+
+typedef struct syscall_cpu_runqueue
+{
+    syscall_proc_list_t fair;       // Fair-class threads waiting for this CPU, sorted by vruntime.
+    syscall_proc_list_t rt[SYSCALL_RT_PRIO_LEVELS]; // Real-time threads, FIFO per priority.
+    syscall_proc_list_t blocked;    // Threads parked on this CPU, woken or timed out by its tick.
+    volatile uint32_t nr_queued;    // fair + rt, read without proc_lock by the tick and balancer.
+    uint32_t rt_bitmap;             // Bit n set while rt[n] is not empty.
+    uint32_t running_owner;         // owner_pid of the current process (0 = none).
+    uint64_t min_vruntime;          // Monotonic floor used to place woken and migrated threads.
+    uint16_t rt_window_ticks;
+    uint16_t rt_run_ticks;
+    uint8_t rt_throttled;           // RT used its share of the window: fair threads go first.
+} syscall_cpu_runqueue_t;
+
+typedef struct syscall_owner_run
+{
+    uint32_t owner_pid;
+    uint32_t running;
+} syscall_owner_run_t;
+
+typedef struct syscall_switch_cleanup
+{
+    bool pending;
+    bool cleanup_fds;
+    bool free_cr3;
+    uint32_t owner_pid;
+    uintptr_t cr3_phys;
+} syscall_switch_cleanup_t;
+
+// Allocated when a console gets its first route, freed when the route is cleared.
 typedef struct syscall_console_route
 {
-    bool used;
     uint32_t owner_pid;
     uint32_t console_sid;
     uint32_t flags;
@@ -230,13 +352,6 @@ typedef struct syscall_console_route
     char in_buffer[SYSCALL_CONSOLE_PTY_INPUT_SIZE];
 } syscall_console_route_t;
 
-typedef struct syscall_cow_ref
-{
-    bool used;
-    uintptr_t phys;
-    uint32_t refs;
-} syscall_cow_ref_t;
-
 typedef struct syscall_exit_event
 {
     bool used;
@@ -311,15 +426,20 @@ typedef struct syscall_elf64_rela
     int64_t r_addend;
 } __attribute__((packed)) syscall_elf64_rela_t;
 
-#define SYSCALL_PIPE_MAX            32U
+#define SYSCALL_PIPE_MAX            ((uint32_t) THEOS_MAX_PIPES)
 #define SYSCALL_PIPE_BUF_SIZE       4096U
 #define SYSCALL_PIPE_FLAG_READ      1U
 #define SYSCALL_PIPE_FLAG_WRITE     2U
 
+/*
+ * kmalloc'd by pipe(). The open ends hold one reference and every read or write in flight
+ * another, all under pipe_lock, so a close racing an I/O never frees it under the I/O.
+ */
 typedef struct syscall_pipe
 {
-    bool used;
-    uint8_t ring[SYSCALL_PIPE_BUF_SIZE];
+    bool used;                          // Cleared when the last end closes.
+    uint32_t id;
+    uint32_t refs;
     uint16_t head;
     uint16_t tail;
     uint32_t count;
@@ -328,7 +448,7 @@ typedef struct syscall_pipe
     task_wait_queue_t read_waitq;
     task_wait_queue_t write_waitq;
     spinlock_t lock;
-    bool lock_ready;
+    uint8_t ring[SYSCALL_PIPE_BUF_SIZE];
 } syscall_pipe_t;
 
 #define SYSCALL_FUTEX_BUCKETS       64U
@@ -339,74 +459,137 @@ typedef struct syscall_futex_bucket
     bool init;
 } syscall_futex_bucket_t;
 
-#define SYSCALL_SHM_MAX_SEGMENTS    32U
+#define SYSCALL_SHM_MAX_SEGMENTS    ((uint32_t) THEOS_MAX_SHM_SEGMENTS)
 #define SYSCALL_SHM_MAX_PAGES       64U
 
+// kmalloc'd by shmget with room for its own pages, freed after IPC_RMID and the last detach.
 typedef struct syscall_shm_segment
 {
-    bool used;
     int32_t key;
     size_t size;
-    uint32_t num_pages;
-    uintptr_t pages[SYSCALL_SHM_MAX_PAGES];
     uint32_t refcount;
     bool marked_remove;
     uint32_t mode;
+    uint32_t num_pages;
+    uintptr_t pages[];
 } syscall_shm_segment_t;
 
-#define SYSCALL_MSG_MAX_QUEUES      32U
-#define SYSCALL_MSG_RING_SIZE       64U
+#define SYSCALL_MM_EMPTY            0U
+#define SYSCALL_MM_DEAD             1U      // Removed key: probing goes on past it.
+#define SYSCALL_MM_NONE             0U
+#define SYSCALL_MM_ANON             1U
+#define SYSCALL_MM_FILE             2U
+#define SYSCALL_MM_SHARED           3U
+
+/*
+ * Memory accounting of one address space, keyed by its CR3: the threads of a process share
+ * it. Counters move under the address space's vm_lock, except shm attach/detach which only
+ * holds shm_lock, hence the atomics. Limits are in bytes, as set by SYS_SETRLIMIT.
+ */
+typedef struct syscall_mm
+{
+    uintptr_t cr3_phys;
+    volatile uint64_t vm_pages;
+    volatile uint64_t anon_pages;
+    volatile uint64_t file_pages;
+    volatile uint64_t shared_pages;
+    volatile uint64_t pt_pages;
+    volatile uint64_t swap_pages;       // Anonymous pages sitting in the swap pool, not in rss.
+    uint64_t serial;                    // Tells a reused CR3 from the address space it replaced.
+    uintptr_t swap_cursor;              // Where the next swap-out pass resumes its scan.
+    uintptr_t thp_cursor;               // Where the next collapse pass resumes, in the mmap window.
+    volatile uint8_t thp_queued;        // A collapse pass is waiting in the work queue.
+    syscall_rlimit_t limit_as;
+    syscall_rlimit_t limit_rss;
+} syscall_mm_t;
+
+// An address space a swap-out pass may visit, checked again under its vm_lock.
+typedef struct syscall_swap_candidate
+{
+    uintptr_t cr3_phys;
+    uint64_t serial;
+    bool running;                       // A thread of it is on a CPU: visited last.
+} syscall_swap_candidate_t;
+
+#define SYSCALL_MSG_MAX_QUEUES      ((uint32_t) THEOS_MAX_MSG_QUEUES)
+#define SYSCALL_MSG_QUEUE_DEPTH     64U     // Messages a queue holds before msgsnd blocks.
 #define SYSCALL_MSG_MAX_TEXT        4096U
 
+// One kmalloc per message, sized to its text.
 typedef struct syscall_msg
 {
+    struct syscall_msg* next;
     int32_t mtype;
     uint16_t len;
-    uint8_t mtext[SYSCALL_MSG_MAX_TEXT];
+    uint8_t mtext[];
 } syscall_msg_t;
 
+// kmalloc'd by the first msgget of its key. There is no IPC_RMID: a queue stays until reboot.
 typedef struct syscall_msgq
 {
-    bool used;
     int32_t key;
-    syscall_msg_t ring[SYSCALL_MSG_RING_SIZE];
-    uint16_t head;
-    uint16_t tail;
+    uint32_t refs;                  // The table's own, plus one per call using the queue.
+    bool removed;                   // IPC_RMID: out of the table, freed with the last reference.
+    syscall_msg_t* head;
+    syscall_msg_t* tail;
     uint32_t count;
     task_wait_queue_t send_waitq;
     task_wait_queue_t recv_waitq;
     spinlock_t lock;
-    bool lock_ready;
 } syscall_msgq_t;
 
 typedef struct syscall_runtime_state
 {
-    volatile uint64_t count_per_cpu[256];
+    syscall_cpu_stats_t cpu_syscall_stats[256];
     uintptr_t user_map_hint;
     syscall_file_desc_t fds[SYSCALL_MAX_OPEN_FILES];
     spinlock_t fd_lock;
     bool fd_lock_ready;
-    spinlock_t vm_lock;
+    spinlock_t vm_locks[SYSCALL_VM_LOCK_BUCKETS];  // Hashed by CR3: the threads of a process share one.
     bool vm_lock_ready;
+    volatile uint64_t usercopy_slow;    // User copies that faulted and finished under the lock.
+    syscall_mm_t mms[SYSCALL_MM_BUCKETS];   // Open addressing on CR3; lookups take no lock.
+    spinlock_t mm_lock;                 // Inserts and removals.
+    uint64_t mm_serial;
+    volatile uint64_t rlimit_hits;      // Mappings and faults refused by RLIMIT_AS/RLIMIT_RSS.
+    volatile uint8_t swap_reclaiming;   // One swap-out pass at a time, background or direct.
+    uint32_t swap_proc_cursor;          // Process slot the next pass starts from.
+    uint32_t swap_candidate_count;
+    syscall_swap_candidate_t swap_candidates[SYSCALL_MAX_PROCS];
+    volatile uint64_t swap_outs;
+    volatile uint64_t swap_ins;
+    volatile uint64_t swap_direct;      // Faults that had to reclaim before being served.
+    volatile uint64_t thp_pages;        // 2 MiB user pages mapped right now.
+    volatile uint64_t thp_faults;
+    volatile uint64_t thp_fallbacks;    // Lazy 2 MiB ranges that had to go 4 KiB: no order-9 block.
+    volatile uint64_t thp_splits;
+    volatile uint64_t thp_collapses;
     syscall_process_t procs[SYSCALL_MAX_PROCS];
-    syscall_console_route_t console_routes[SYSCALL_MAX_CONSOLE_ROUTES];
+    syscall_console_route_t* console_routes[SYSCALL_MAX_CONSOLE_ROUTES];
     syscall_exit_event_t exit_events[SYSCALL_MAX_EXIT_EVENTS];
     syscall_thread_exit_event_t thread_exit_events[SYSCALL_MAX_THREAD_EXIT_EVENTS];
-    syscall_cow_ref_t cow_refs[SYSCALL_COW_MAX_REFS];
     uint32_t cpu_current_proc[256];
     uint8_t cpu_need_resched[256];
     uint8_t cpu_yield_same_owner_pick[256];
     uint8_t cpu_need_timer_preempt[256];
     uint8_t cpu_slice_ticks[256];
+    syscall_switch_cleanup_t cpu_switch_cleanup[256];
+    syscall_cpu_runqueue_t cpu_runqueue[256];
+    syscall_owner_run_t owner_run[SYSCALL_OWNER_RUN_BUCKETS];
+    volatile uint32_t queued_total;
+    volatile uint64_t pick_next_calls;
+    volatile uint64_t pick_next_cycles;
+    volatile uint64_t user_steals;
+    uintptr_t proc_kstack_base[SYSCALL_MAX_PROCS];
+    uint32_t pid_hash[SYSCALL_PID_HASH_BUCKETS];
+    volatile uint8_t slot_reclaim_pending[SYSCALL_MAX_PROCS]; // Exited, waiting for RCU readers.
     uint32_t next_pid;
     spinlock_t proc_lock;
     bool proc_lock_ready;
     spinlock_t console_lock;
     bool console_lock_ready;
-    spinlock_t cow_lock;
-    bool cow_lock_ready;
 
-    syscall_pipe_t pipes[SYSCALL_PIPE_MAX];
+    syscall_pipe_t* pipes[SYSCALL_PIPE_MAX];
     spinlock_t pipe_lock;
     bool pipe_lock_ready;
 
@@ -414,11 +597,13 @@ typedef struct syscall_runtime_state
     spinlock_t futex_lock;
     bool futex_lock_ready;
 
-    syscall_shm_segment_t shm_segments[SYSCALL_SHM_MAX_SEGMENTS];
+    syscall_shm_segment_t* shm_segments[SYSCALL_SHM_MAX_SEGMENTS];
     spinlock_t shm_lock;
     bool shm_lock_ready;
 
-    syscall_msgq_t msg_queues[SYSCALL_MSG_MAX_QUEUES];
+    syscall_msgq_t* msg_queues[SYSCALL_MSG_MAX_QUEUES];
+    spinlock_t msg_lock;                // Table inserts and key lookups.
+    bool msg_lock_ready;
 } syscall_runtime_state_t;
 
 void Syscall_init(void);
@@ -431,8 +616,11 @@ uint64_t Syscall_interrupt_handler(uint64_t syscall_num, syscall_frame_t* frame,
 uint64_t Syscall_interupt_handler(uint64_t syscall_num, syscall_frame_t* frame, uint32_t cpu_index);
 uint64_t Syscall_post_handler(uint64_t syscall_ret, syscall_frame_t* frame, uint32_t cpu_index);
 bool Syscall_handle_user_exception(interrupt_frame_t* frame, uintptr_t fault_addr);
+bool Syscall_handle_kernel_page_fault(uintptr_t fault_addr, uint64_t err_code);
 void Syscall_on_timer_tick(uint32_t cpu_index);
 bool Syscall_handle_timer_preempt(interrupt_frame_t* frame, uint32_t cpu_index);
 bool Syscall_try_dispatch_user_from_idle(uint32_t cpu_index);
+bool Syscall_block_current(task_waiter_t* waiter, uint64_t timeout_ticks, bool* out_signaled);
+void Syscall_wake_parked(uint32_t slot, const task_waiter_t* waiter);
 
 #endif
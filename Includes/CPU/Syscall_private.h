@@ -8,8 +8,50 @@ static inline void Syscall_write_cr3_phys(uintptr_t cr3_phys);
 static bool Syscall_cow_ref_add(uintptr_t phys, uint32_t delta);
 static bool Syscall_cow_ref_sub(uintptr_t phys, bool* out_zero);
 static uint32_t Syscall_cow_ref_get(uintptr_t phys);
+static bool Syscall_page_is_shm(uintptr_t phys);
+static void Syscall_shm_page_unmapped(uintptr_t phys);
+static uint32_t Syscall_mm_hash(uintptr_t cr3_phys);
+static syscall_mm_t* Syscall_mm_get(uintptr_t cr3_phys);
+static bool Syscall_mm_create(uintptr_t cr3_phys, uintptr_t parent_cr3_phys);
+static void Syscall_mm_destroy(uintptr_t cr3_phys);
+static volatile uint64_t* Syscall_mm_counter(syscall_mm_t* mm, uint32_t kind);
+static uint64_t Syscall_mm_rss(const syscall_mm_t* mm);
+static uint32_t Syscall_mm_kind_of(uint64_t entry);
+static bool Syscall_mm_charge(syscall_mm_t* mm, uint32_t kind, uint64_t pages);
+static void Syscall_mm_uncharge(syscall_mm_t* mm, uint32_t kind, uint64_t pages);
+static bool Syscall_mm_reserve_vm(syscall_mm_t* mm, uint64_t pages);
+static void Syscall_mm_release_vm(syscall_mm_t* mm, uint64_t pages);
+static void Syscall_mm_add_pt(uintptr_t cr3_phys, int64_t tables);
 static uint64_t* Syscall_get_user_pte_ptr(uintptr_t cr3_phys, uintptr_t virt);
+static spinlock_t* Syscall_vm_lock(uintptr_t cr3_phys);
+static bool Syscall_copy_to_user_page(uintptr_t user_addr, const void* kernel_src, size_t chunk);
+static bool Syscall_copy_from_user_page(void* kernel_dst, uintptr_t user_addr, size_t chunk);
 static bool Syscall_resolve_cow_fault(uint32_t cpu_index, uintptr_t fault_addr, uint64_t err_code);
+static uint64_t* Syscall_get_user_pde_ptr(uintptr_t cr3_phys, uintptr_t virt);
+static uint64_t* Syscall_get_user_huge_pde_ptr(uintptr_t cr3_phys, uintptr_t virt);
+static bool Syscall_pde_is_lazy_huge(uint64_t entry);
+static uint64_t* Syscall_user_pde_alloc(uintptr_t cr3_phys, uintptr_t virt);
+static uint64_t* Syscall_user_pte_alloc(uintptr_t cr3_phys, uintptr_t virt);
+static bool Syscall_user_pt_is_empty(uintptr_t pt_phys);
+static bool Syscall_user_page_is_lazy(uintptr_t cr3_phys, uintptr_t page);
+static bool Syscall_thp_split_pde(uintptr_t cr3_phys, uint64_t* pde);
+static bool Syscall_thp_split_range_locked(uintptr_t cr3_phys, uintptr_t base, size_t size);
+static bool Syscall_memory_low(void);
+static bool Syscall_thp_populate_locked(uintptr_t cr3_phys, uint64_t* pde);
+static bool Syscall_lazy_populate_locked(uintptr_t cr3_phys, uintptr_t page);
+static bool Syscall_lazy_populate_range(uintptr_t base, size_t size);
+static bool Syscall_resolve_lazy_fault(uintptr_t fault_addr, uint64_t err_code);
+static inline uint32_t Syscall_swap_slot(uint64_t entry);
+static bool Syscall_interrupts_enabled(void);
+static bool Syscall_swap_page_eligible(uint64_t entry);
+static uint64_t Syscall_swap_out_batch_locked(uintptr_t cr3_phys, syscall_mm_t* mm, uint64_t** ptes, uint32_t count);
+static uint64_t Syscall_swap_out_locked(uintptr_t cr3_phys, syscall_mm_t* mm, uint64_t target_pages);
+static void Syscall_swap_collect_candidates(void);
+static uint64_t Syscall_swap_reclaim(uint64_t target_pages);
+static void Syscall_swap_direct_reclaim(void);
+static bool Syscall_thp_collapse_locked(uintptr_t cr3_phys, uint64_t* pde);
+static void Syscall_thp_collapse_work(void* arg);
+static void Syscall_thp_queue_collapse(void);
 static bool Syscall_proc_owner_has_other_live_locked(uint32_t owner_pid, int32_t exclude_slot);
 static uint32_t Syscall_proc_current_pid(uint32_t cpu_index, const syscall_frame_t* frame);
 static bool Syscall_is_audio_dsp_path(const char* path);
@@ -39,14 +81,82 @@ static uint64_t Syscall_handle_read(uint32_t cpu_index, const syscall_frame_t* f
 static uint64_t Syscall_handle_write(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_lseek(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_ioctl(uint32_t cpu_index, const syscall_frame_t* frame);
+static syscall_pipe_t* Syscall_pipe_get(uint32_t pipe_id);
+static void Syscall_pipe_put(syscall_pipe_t* p);
+static void Syscall_pipe_release(syscall_pipe_t* p);
+static void Syscall_pipe_close_end(uint32_t pipe_id, bool was_reader, bool was_writer);
+static uint64_t Syscall_pipe_read(syscall_pipe_t* p, void* user_buf, size_t len);
+static uint64_t Syscall_pipe_write(syscall_pipe_t* p, const void* user_buf, size_t len);
 static uint64_t Syscall_handle_pipe(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_futex(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_shmget(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_shmat(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_shmdt(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_shmctl(uint32_t cpu_index, const syscall_frame_t* frame);
+static syscall_msgq_t* Syscall_msgq_get(int32_t msqid);
+static void Syscall_msgq_put(syscall_msgq_t* q);
+static int32_t Syscall_msgq_find_locked(int32_t key);
 static uint64_t Syscall_handle_msgget(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_msgsnd(uint32_t cpu_index, const syscall_frame_t* frame);
 static uint64_t Syscall_handle_msgrcv(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_msgctl(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_setpriority(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_getpriority(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_sched_setscheduler(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_sched_getscheduler(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_sched_setaffinity(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_sched_getaffinity(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_getrusage(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_getrlimit(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_setrlimit(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_getppid(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_fs_mkdir(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_sleep_ms(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_tick_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_rtc_time_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_kdebug_write(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_cpu_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_sched_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_ahci_irq_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_rcu_sync(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_rcu_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_proc_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_console_write(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_console_route_set(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_console_route_read(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_console_route_set_sid(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_console_route_read_sid(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_console_route_input_write_sid(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_console_route_input_read(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_exit(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_fork(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_execve(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_yield(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_map(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_unmap(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_mprotect(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_getpid(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_kbd_get_scancode(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_kbd_capture_set(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_kbd_inject_scancode(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_mouse_get_event(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_mouse_debug_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_fs_isdir(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_fs_readdir(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_waitpid(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_kill(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_thread_create(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_thread_join(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_thread_exit(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_thread_self(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_thread_set_fsbase(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_thread_get_fsbase(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_power(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_syscall_stats_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_tlb_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_mem_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_kmem_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_ipc_info_get(uint32_t cpu_index, const syscall_frame_t* frame);
+static uint64_t Syscall_handle_sync(uint32_t cpu_index, const syscall_frame_t* frame);
 
 #endif
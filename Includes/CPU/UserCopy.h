@@ -0,0 +1,30 @@
+#ifndef _USER_COPY_H
+#define _USER_COPY_H
+
+#include <CPU/IDT.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// One .ex_table entry: a #PF at insn resumes at fixup (see UserCopy.S).
+typedef struct UserCopy_fixup
+{
+    uintptr_t insn;
+    uintptr_t fixup;
+} UserCopy_fixup_t;
+
+extern const UserCopy_fixup_t ex_table_start[];
+extern const UserCopy_fixup_t ex_table_end[];
+
+/*
+ * Direct accesses to user memory through the live page tables. They never resolve a fault
+ * themselves: a non-present, lazy or read-only page stops the copy and the caller takes the
+ * slow path for what is left.
+ */
+size_t UserCopy_copy(void* dst, const void* src, size_t size);
+int64_t UserCopy_strncpy(char* dst, const char* src, size_t max);
+
+bool UserCopy_fixup_fault(interrupt_frame_t* frame, uintptr_t fault_addr);
+
+#endif
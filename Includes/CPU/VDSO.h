@@ -0,0 +1,20 @@
+#ifndef _VDSO_H
+#define _VDSO_H
+
+#include <UAPI/Syscall.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct VDSO_runtime_state
+{
+    uintptr_t vvar_phys;
+    syscall_vvar_t* vvar;
+    bool ready;
+} VDSO_runtime_state_t;
+
+bool VDSO_init(void);
+void VDSO_on_tick(uint64_t ticks);
+uintptr_t VDSO_get_vvar_phys(void);
+
+#endif
@@ -57,6 +57,14 @@ static inline void x86_clear_ts(void)
     __asm__ __volatile__("clts");
 }
 
+static inline uint64_t x86_rdtsc(void)
+{
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | lo;
+}
+
 static inline uint64_t x86_xgetbv(uint32_t index)
 {
     uint32_t eax = 0;
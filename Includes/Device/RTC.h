@@ -47,5 +47,6 @@ uint8_t RTC_read_year(void);
 uint8_t RTC_read_century(void);
 
 void RTC_read(RTC_t* rtc_out);
+uint64_t RTC_get_epoch_seconds(void);
 
 #endif
\ No newline at end of file
@@ -11,7 +11,20 @@
 #define MEM_STATE_AVAILABLE 2
 #define MEM_STATE_AVALIABLE MEM_STATE_AVAILABLE
 
-#define KMEM_HEAP_SIZE      (16 * 1024 * 1024)
+#define KMEM_BOOT_HEAP_SIZE     (1 * 1024 * 1024)   // Carved out of the first usable region by PMM_init.
+#define KMEM_ARENA_ORDER        8U                  // Arenas added on demand are 1 MiB buddy blocks...
+#define KMEM_ARENA_MAX_ORDER    10U                 // ...or up to 4 MiB for a larger request.
+#define KMEM_ARENA_MAX          64U
+#define KMEM_VMALLOC_THRESHOLD  (128 * 1024)        // Larger requests are page-mapped by vmalloc.
+
+// Build with THEOS_KMEM_TRACK=1 to tag every kmalloc with its caller (see kmem_get_sites).
+#ifndef THEOS_KMEM_TRACK
+#define THEOS_KMEM_TRACK 0
+#endif
+
+#define KMEM_SITE_MAX           512U                // Distinct callers tracked; more count as untracked.
+#define KMEM_TRACK_SLOTS        32768U              // Live tagged allocations (power of two).
+#define KMEM_DUMP_SITES         16U
 
 typedef struct malloc_header
 {
@@ -20,12 +33,82 @@ typedef struct malloc_header
     struct malloc_header* prev_malloc_header;   // The previous malloc header.
 } malloc_header_t;
 
+// One physically contiguous first-fit heap; headers never cross from one arena into another.
+typedef struct kmem_arena
+{
+    void* start;                                // NULL for an unused slot.
+    size_t size;
+    uint32_t order;                             // Buddy order it came from, unused for the boot arena.
+    bool boot;
+} kmem_arena_t;
+
+/*
+ * Bytes are counted as the backend sizes them: the slab class, the heap block or the
+ * vmalloc request, so bytes_in_use is what kmalloc callers actually hold.
+ */
+typedef struct KMEM_stats
+{
+    uint64_t bytes_in_use;
+    uint64_t bytes_peak;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+    uint64_t last_failure_size;
+    uint64_t heap_size;                         // Every arena, headers included.
+    uint64_t heap_used;
+    uint64_t heap_used_blocks;
+    uint64_t heap_free;
+    uint64_t heap_free_blocks;                  // Length of the free list, i.e. its fragmentation.
+    uint64_t heap_largest_free;
+    uint32_t arenas;
+    uint32_t site_count;                        // Callers seen, 0 unless THEOS_KMEM_TRACK.
+    uint64_t arenas_grown;
+    uint64_t arenas_released;
+    uint64_t untracked;                         // Allocations the tracker had no room for.
+} KMEM_stats_t;
+
+typedef struct KMEM_site_stats
+{
+    uintptr_t site;                             // Return address into the caller of kmalloc.
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t live_bytes;
+    uint64_t live_count;
+    uint64_t peak_bytes;
+} KMEM_site_stats_t;
+
+#if THEOS_KMEM_TRACK
+// One live allocation: a linear-probing slot keyed by pointer, NULL when empty.
+typedef struct kmem_track_slot
+{
+    void* ptr;
+    uint32_t site;                              // Index into sites[].
+} kmem_track_slot_t;
+#endif
+
 typedef struct KMEM_runtime_state
 {
-    void* heap_start;
-    size_t heap_size;
     spinlock_t lock;
-    bool lock_ready;
+    uint32_t arena_count;                       // Slots in use, released ones included.
+    uint64_t arenas_grown;
+    uint64_t arenas_released;
+    uint64_t heap_used;                         // Under the lock, like the arenas.
+    uint64_t heap_used_blocks;
+    uint64_t bytes_in_use;                      // Atomics: every backend, outside the lock.
+    uint64_t bytes_peak;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+    uint64_t last_failure_size;
+    bool dumping;
+    kmem_arena_t arenas[KMEM_ARENA_MAX];
+#if THEOS_KMEM_TRACK
+    spinlock_t track_lock;
+    uint32_t site_count;
+    uint64_t untracked;
+    KMEM_site_stats_t sites[KMEM_SITE_MAX];
+    kmem_track_slot_t track[KMEM_TRACK_SLOTS];
+#endif
 } KMEM_runtime_state_t;
 
 void kmem_init(uint64_t heap_start, size_t heap_size);
@@ -33,6 +116,11 @@ void kmem_init(uint64_t heap_start, size_t heap_size);
 void* kmalloc(size_t size);
 void* krealloc(void* ptr, size_t new_size);
 
+// Also releases vmalloc memory, which kmalloc hands out for large requests.
 void kfree(void* ptr);
 
+void kmem_get_stats(KMEM_stats_t* out);
+uint32_t kmem_get_sites(KMEM_site_stats_t* out, uint32_t max);
+void kmem_dump(uint32_t max_sites);
+
 #endif
@@ -3,7 +3,23 @@
 
 #include <Memory/KMem.h>
 
+static kmem_arena_t* kmem_arena_of(const void* ptr);
+static bool kmem_arena_add(void* start, size_t size, uint32_t order, bool boot);
+static bool kmem_arena_is_empty(const kmem_arena_t* arena);
+static void* kmem_arena_alloc(kmem_arena_t* arena, size_t size);
+static void* kmalloc_grow(size_t size);
 static void* kmalloc_nolock(size_t size);
-static void kfree_nolock(void* ptr);
+static size_t kfree_nolock(kmem_arena_t* arena, void* ptr);
+static void* kmalloc_site(size_t size, uintptr_t site);
+static size_t kmem_block_size(const void* ptr);
+static void kmem_note_alloc(void* ptr, size_t bytes, uintptr_t site);
+static void kmem_note_free(void* ptr, size_t bytes);
+static void kmem_note_failure(size_t size);
+#if THEOS_KMEM_TRACK
+static uint32_t kmem_site_index_locked(uintptr_t site);
+static uint32_t kmem_track_hash(const void* ptr);
+static void kmem_track_insert(void* ptr, size_t bytes, uintptr_t site);
+static void kmem_track_remove(void* ptr, size_t bytes);
+#endif
 
 #endif
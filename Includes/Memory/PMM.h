@@ -1,6 +1,8 @@
 #ifndef _PMM_H
 #define _PMM_H
 
+#include <Debug/Spinlock.h>
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -12,14 +14,125 @@
 #define PMM_BOOT_ENTRY_ALLOCATABLE (1U << 0)
 #define PMM_BOOT_ENTRY_HHDM_MAP    (1U << 1)
 
+#define PMM_MAX_ORDER           10U     // Largest buddy block: 2^10 pages (4 MiB).
+#define PMM_ORDER_COUNT         (PMM_MAX_ORDER + 1U)
+#define PMM_PAGE_IN_BLOCK       0x00U   // Page map byte: inside a free block (not its head).
+#define PMM_PAGE_FREE_HEAD      0x20U   // ... first page of a free block, | order.
+#define PMM_PAGE_RESERVED       0x40U   // ... kernel image, page map or boot heap.
+#define PMM_PAGE_USED           0x80U   // ... handed out by PMM_alloc_pages.
+#define PMM_PAGE_CACHED         0xC0U   // ... parked in a per-CPU page cache.
+#define PMM_PAGE_ORDER_MASK     0x1FU
+
+#define PMM_PAGE_F_COW          (1U << 0)   // Page descriptor: shared copy-on-write by several PTEs.
+#define PMM_PAGE_F_SHM          (1U << 1)   // ... backs a System V shared memory segment.
+
+#define PMM_MAX_NODES           16U     // Matches NUMA_MAX_NODES.
+#define PMM_PCP_MAX_CPUS        256U
+#define PMM_PCP_BATCH           16U     // Pages moved between a CPU cache and the buddy lists at once.
+#define PMM_PCP_HIGH            64U     // A CPU cache above this gives its coldest batch back.
+#define PMM_PCP_CAPACITY        (PMM_PCP_HIGH + PMM_PCP_BATCH)
+#define PMM_ZERO_POOL_HIGH      256U    // Pre-zeroed pages kept per node by the idle-time refill job.
+#define PMM_ZERO_POOL_LOW       64U     // Taking the pool below this queues a refill.
+#define PMM_ZERO_POOL_RESERVE   4096U   // Free pages the refill job leaves alone: the pool never starves allocations.
+#define PMM_RECLAIM_LOW_SHIFT   6U      // Less than 1/64 of memory free queues the shrinker ...
+#define PMM_RECLAIM_HIGH_SHIFT  5U      // ... which works until 1/32 is free again.
+#define PMM_RECLAIM_MIN_PAGES   1024U   // Floor of the low watermark on small machines.
+#define PMM_RECLAIM_BACKOFF     512U    // Allocations let through after a pass that freed nothing.
+#define PMM_SHRINKER_MAX        4U
+
+// Gives back up to target_pages to the allocator, returns how many it freed.
+typedef uint64_t (*PMM_shrinker_t)(uint64_t target_pages);
+
 typedef struct PMM_region
 {
     uintptr_t addr_start;
     uintptr_t addr_end;
-    uintptr_t addr_mmap_start;
+    uintptr_t addr_mmap_start;          // Page map: one state byte per page of the region.
+    uintptr_t addr_pages_start;         // Page descriptors: one PMM_page_t per page of the region.
     uint64_t len;
+    uint64_t first_pfn;
+    uint64_t page_count;
+    uint32_t node;                      // NUMA node index; regions never straddle two nodes.
 } PMM_region_t;
 
+/*
+ * Per-frame metadata, found from the PFN without any search. Handed out cleared: refcount
+ * counts the extra owners of a shared frame, 0 means the allocator's caller owns it alone.
+ */
+typedef struct PMM_page
+{
+    uint32_t refcount;
+    uint16_t mapcount;                  // User PTEs mapping a shared segment frame.
+    uint8_t flags;                      // PMM_PAGE_F_*.
+    uint8_t node;                       // NUMA node index the frame belongs to.
+} PMM_page_t;
+
+// Free blocks are linked through their own first page (HHDM view).
+typedef struct PMM_free_block
+{
+    struct PMM_free_block* next;
+    struct PMM_free_block* prev;
+    uint32_t region_index;
+    uint32_t order;
+} PMM_free_block_t;
+
+// Order-0 pages kept per CPU so faults on different cores do not meet on the buddy lock.
+typedef struct PMM_pcp
+{
+    spinlock_t lock;                    // Only contended by remote drains.
+    uint32_t count;
+    uint8_t offline;
+    uint8_t reserved[3];
+    uintptr_t pages[PMM_PCP_CAPACITY];  // Coldest at 0, hottest at count - 1.
+    uint64_t hits;
+    uint64_t refills;
+    uint64_t drains;
+} PMM_pcp_t;
+
+// Frames zeroed ahead of time for user pages and page tables; they count as free memory.
+typedef struct PMM_zero_pool
+{
+    spinlock_t lock;
+    uint32_t count;
+    uint8_t refill_queued;
+    uint8_t reserved[3];
+    uintptr_t pages[PMM_ZERO_POOL_HIGH];
+} PMM_zero_pool_t;
+
+typedef struct PMM_node_stats
+{
+    uint32_t node_id;                   // ACPI proximity domain.
+    uint32_t reserved;
+    uint64_t total_pages;
+    uint64_t free_pages;                // Buddy lists only, per-CPU caches not included.
+    uint64_t local_allocs;              // Allocations meant for this node and served by it.
+    uint64_t remote_allocs;             // ... that had to fall back to another node.
+} PMM_node_stats_t;
+
+typedef struct PMM_stats
+{
+    uint64_t total_pages;
+    uint64_t free_pages;                // Buddy lists plus per-CPU caches.
+    uint64_t cached_pages;              // ... of which sit in per-CPU caches.
+    uint64_t free_blocks[PMM_ORDER_COUNT];
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t splits;
+    uint64_t merges;
+    uint64_t bad_frees;                 // Double frees or pages the PMM never handed out.
+    uint64_t pcp_hits;
+    uint64_t pcp_refills;
+    uint64_t pcp_drains;
+    uint64_t zero_pool_pages;           // Free pages sitting zeroed in the pools (counted in free_pages).
+    uint64_t zero_hits;                 // Zeroed pages served from a pool ...
+    uint64_t zero_misses;               // ... or zeroed on the spot because it was empty.
+    uint64_t zero_refills;              // Pages zeroed by the refill job.
+    uint64_t reclaim_runs;              // Shrinker passes queued by the low watermark.
+    uint64_t reclaim_pages;             // ... and the pages they gave back.
+    uint32_t node_count;
+    PMM_node_stats_t nodes[PMM_MAX_NODES];
+} PMM_stats_t;
+
 typedef struct PMM_boot_entry
 {
     uintptr_t addr_start;
@@ -39,6 +152,28 @@ typedef struct PMM_runtime_state
     uintptr_t kernel_virt_start;
     uintptr_t kernel_virt_end;
     bool kmem_initialized;
+    spinlock_t lock;
+    PMM_free_block_t* free_lists[PMM_MAX_NODES][PMM_ORDER_COUNT];
+    PMM_stats_t stats;
+    bool numa_ready;
+    uint32_t node_fallback[PMM_MAX_NODES][PMM_MAX_NODES];  // Nodes by SLIT distance, own node first.
+    uint8_t cpu_node[PMM_PCP_MAX_CPUS];
+    volatile uint64_t pcp_cached_pages;
+    bool pcp_disabled;
+    PMM_pcp_t pcp[PMM_PCP_MAX_CPUS];
+    bool zero_pool_disabled;
+    volatile uint64_t zero_pool_pages;
+    volatile uint64_t zero_hits;
+    volatile uint64_t zero_misses;
+    volatile uint64_t zero_refills;
+    PMM_zero_pool_t zero_pool[PMM_MAX_NODES];
+    PMM_shrinker_t shrinkers[PMM_SHRINKER_MAX];
+    uint32_t shrinker_reserved;
+    uint32_t shrinker_count;
+    uint8_t reclaim_queued;
+    volatile uint32_t reclaim_backoff;
+    volatile uint64_t reclaim_runs;
+    volatile uint64_t reclaim_pages;
 } PMM_runtime_state_t;
 
 void PMM_init(uintptr_t kernel_phys_start,
@@ -55,6 +190,7 @@ PMM_region_t* PMM_get_regions(void);
 int PMM_get_num_regions(void);
 
 void PMM_init_region(uintptr_t addr, uintptr_t len);
+void PMM_numa_init(void);
 
 void PMM_boot_entries_reset(void);
 bool PMM_boot_entry_add(uintptr_t addr,
@@ -68,11 +204,29 @@ bool PMM_promote_boot_entries_to_allocatable(uint64_t type,
                                              uint64_t* regions_added_out,
                                              uint64_t* pages_added_out);
 
-void PMM_mmap_unset(PMM_region_t* region, int bit);
-void PMM_mmap_set(PMM_region_t* region, int bit);
-
-uint32_t PMM_get_index_of_free_page(PMM_region_t region);
+void* PMM_alloc_pages(uint32_t order);
+void* PMM_alloc_pages_node(uint32_t order, uint32_t node);
+void PMM_free_pages(void* ptr, uint32_t order);
 void* PMM_alloc_page(void);
 void PMM_dealloc_page(void* ptr);
+void PMM_dealloc_page_cold(void* ptr);
+void PMM_drain_cpu(uint32_t cpu_index);
+void PMM_drain_all(void);
+void PMM_cpu_set_online(uint32_t cpu_index, bool online);
+void PMM_set_pcp_enabled(bool enabled);
+void* PMM_alloc_zeroed_page(void);
+void PMM_zero_pool_refill(uint32_t node);
+void PMM_zero_pool_drain_all(void);
+void PMM_set_zero_pool_enabled(bool enabled);
+uint64_t PMM_get_free_page_count(void);
+uint64_t PMM_get_total_page_count(void);
+uint64_t PMM_reclaim_low_watermark(void);
+uint64_t PMM_reclaim_high_watermark(void);
+bool PMM_register_shrinker(PMM_shrinker_t shrinker);
+PMM_page_t* PMM_page_get(uintptr_t phys);
+bool PMM_page_ref_add(uintptr_t phys, uint32_t delta, uint8_t flag);
+bool PMM_page_ref_sub(uintptr_t phys, bool* out_zero);
+uint32_t PMM_page_ref_get(uintptr_t phys);
+void PMM_get_stats(PMM_stats_t* out);
 
 #endif
@@ -0,0 +1,118 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <Debug/Spinlock.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define KMEM_SLAB_ORDER         2U      // Every slab is one 16 KiB buddy block, naturally aligned.
+#define KMEM_SLAB_SIZE          (4096U << KMEM_SLAB_ORDER)
+#define KMEM_SLAB_MAGIC         0x534C4142U
+#define KMEM_SLAB_MAX_OBJECT    2048U   // Larger requests go to the first-fit heap.
+#define KMEM_CACHE_MAX          32U
+#define KMEM_CACHE_NAME_MAX     24U
+#define KMEM_CACHE_MAX_CPUS     256U
+#define KMEM_MAGAZINE_SIZE      16U     // Objects a CPU keeps per cache without the cache lock.
+#define KMEM_MAGAZINE_BATCH     (KMEM_MAGAZINE_SIZE / 2U)
+#define KMEM_SIZE_CLASS_COUNT   8U      // kmalloc classes: 16, 32, ... 2048 bytes.
+#define KMEM_SIZE_CLASS_MIN     16U
+
+#define KMEM_CACHE_NO_MAGAZINE  (1U << 0)   // Every alloc and free takes the cache lock.
+
+typedef void (*kmem_ctor_t)(void* obj);
+
+/*
+ * Header at the start of each slab, so any object finds its slab by masking its address.
+ * Free objects are linked through a pointer stored at cache->free_offset.
+ */
+typedef struct kmem_slab
+{
+    struct kmem_slab* next;
+    struct kmem_slab* prev;
+    struct kmem_cache* cache;
+    void* free_list;
+    uint32_t in_use;
+    uint32_t magic;
+} kmem_slab_t;
+
+typedef struct kmem_slab_list
+{
+    kmem_slab_t* head;
+    uint32_t count;
+} kmem_slab_list_t;
+
+typedef struct kmem_magazine
+{
+    spinlock_t lock;                    // Only contended by a remote drain.
+    uint32_t count;
+    uint64_t hits;
+    uint64_t misses;
+    void* objs[KMEM_MAGAZINE_SIZE];
+} kmem_magazine_t;
+
+typedef struct kmem_cache
+{
+    char name[KMEM_CACHE_NAME_MAX];
+    bool used;
+    uint32_t flags;
+    uint32_t object_size;
+    uint32_t stride;                    // Object plus free pointer, rounded to the alignment.
+    uint32_t free_offset;               // Past the object when a constructor owns its bytes.
+    uint32_t first_offset;              // Slab header, rounded to the alignment.
+    uint32_t objects_per_slab;
+    kmem_ctor_t ctor;
+    spinlock_t lock;
+    kmem_slab_list_t partial;
+    kmem_slab_list_t full;
+    kmem_slab_list_t empty;             // At most one is kept; further empties go back to the PMM.
+    uint64_t slab_allocs;               // Objects handed out by the slabs (magazines included).
+    uint64_t slab_frees;
+    uint64_t slabs_grown;
+    uint64_t slabs_released;
+    kmem_magazine_t* magazines[KMEM_CACHE_MAX_CPUS];
+} kmem_cache_t;
+
+typedef struct kmem_cache_stats
+{
+    char name[KMEM_CACHE_NAME_MAX];
+    uint32_t object_size;
+    uint32_t objects_per_slab;
+    uint32_t slabs;
+    uint32_t reserved;
+    uint64_t objects_total;
+    uint64_t objects_active;            // Held by callers: neither in a slab nor in a magazine.
+    uint64_t magazine_objects;
+    uint64_t magazine_hits;
+    uint64_t magazine_misses;
+    uint64_t slabs_grown;
+    uint64_t slabs_released;
+} kmem_cache_stats_t;
+
+typedef struct SLAB_runtime_state
+{
+    spinlock_t lock;                    // Cache table.
+    bool ready;
+    kmem_cache_t caches[KMEM_CACHE_MAX];
+    kmem_cache_t* magazine_cache;
+    kmem_cache_t* size_classes[KMEM_SIZE_CLASS_COUNT];
+} SLAB_runtime_state_t;
+
+void kmem_slab_init(void);
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, kmem_ctor_t ctor, uint32_t flags);
+bool kmem_cache_destroy(kmem_cache_t* cache);
+void* kmem_cache_alloc(kmem_cache_t* cache);
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+void kmem_cache_shrink(kmem_cache_t* cache);
+bool kmem_cache_get_stats(const kmem_cache_t* cache, kmem_cache_stats_t* out);
+uint32_t kmem_cache_get_count(void);
+kmem_cache_t* kmem_cache_get(uint32_t index);
+
+void* kmem_slab_alloc_size(size_t size);
+bool kmem_slab_owns(const void* ptr);
+size_t kmem_slab_object_size(const void* ptr);
+void kmem_slab_free(void* ptr);
+
+#endif
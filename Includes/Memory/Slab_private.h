@@ -0,0 +1,15 @@
+#ifndef _SLAB_PRIVATE_H
+#define _SLAB_PRIVATE_H
+
+#include <Memory/Slab.h>
+
+static void kmem_slab_list_push(kmem_slab_list_t* list, kmem_slab_t* slab);
+static void kmem_slab_list_remove(kmem_slab_list_t* list, kmem_slab_t* slab);
+static kmem_slab_t* kmem_slab_of(const void* obj);
+static kmem_slab_t* kmem_cache_grow_locked(kmem_cache_t* cache);
+static void* kmem_cache_take_locked(kmem_cache_t* cache);
+static void kmem_cache_put_locked(kmem_cache_t* cache, void* obj);
+static kmem_magazine_t* kmem_cache_magazine(kmem_cache_t* cache);
+static void kmem_magazine_drain_locked(kmem_cache_t* cache, kmem_magazine_t* magazine, uint32_t keep);
+
+#endif
@@ -12,6 +12,7 @@
 #define USER_MODE       (1ULL << 2)
 #define WRITE_THROUGH   (1ULL << 3)
 #define CACHE_DISABLE   (1ULL << 4)
+#define LARGE_PAGE      (1ULL << 7)    // PS in a PDT entry: it maps a 2 MiB page, no PT below.
 #define NO_EXECUTE      (1ULL << 63)
 
 #define VMM_RECURSIVE_INDEX 510
@@ -22,6 +23,8 @@
 #define PT_INDEX(x)     (((x) >> 12) & 0x1FF)
 
 #define FRAME           0x000FFFFFFFFFF000ULL
+#define LARGE_FRAME     0x000FFFFFFFE00000ULL
+#define LARGE_PAGE_SIZE 0x200000ULL
 
 #define HILO2ADDR(hi, lo)   ((((uint64_t) hi) << 32) + lo)
 
@@ -29,6 +32,15 @@
 #define ADDRLO(a)           ((a) & 0xFFFFFFFFULL)
 #define VMM_STARTUP_IDENTITY_LOW_LIMIT 0x100000ULL
 
+#define VMM_CR0_WP          (1ULL << 16)    // Supervisor writes honour read-only PTEs too.
+#define VMM_CR4_PCIDE       (1ULL << 17)
+#define VMM_CR3_PCID_MASK   0xFFFULL
+#define VMM_CR3_NOFLUSH     (1ULL << 63)    // MOV to CR3 keeps the TLB entries tagged with the new PCID.
+#define VMM_PCID_MAX_CPUS   256U
+#define VMM_PCID_SLOTS      16U             // Address spaces kept tagged per CPU (PCID = slot + 1).
+#define VMM_INVPCID_SINGLE  1ULL
+#define VMM_INVPCID_ALL     2ULL
+
 uintptr_t VMM_get_hhdm_base(void);
 void VMM_set_hhdm_base(uintptr_t hhdm_base);
 uintptr_t VMM_hhdm_to_phys_addr(uintptr_t virt);
@@ -61,6 +73,46 @@ typedef struct PT
     uint64_t entries[512];
 } PT_t;
 
+typedef struct VMM_pcid_slot
+{
+    uintptr_t cr3_phys;             // 0 = free.
+    uint64_t gen;                   // Flush generation the tagged entries are valid for (0 = stale).
+} VMM_pcid_slot_t;
+
+typedef struct VMM_pcid_cpu
+{
+    VMM_pcid_slot_t slots[VMM_PCID_SLOTS];
+    bool enabled;
+    uint8_t reserved[3];
+    uint32_t next_victim;
+    uint64_t cr3_switches;
+    uint64_t cr3_noflush;           // Switches that kept the tagged TLB entries.
+    uint64_t cr3_flush;             // Switches that had to flush the new PCID.
+    uint64_t recycles;              // Slots taken over from another address space.
+} VMM_pcid_cpu_t;
+
+typedef struct VMM_tlb_cpu
+{
+    uintptr_t loaded_cr3;           // Address space live in this CPU's CR3 (kept while idle).
+    volatile uint8_t lazy;          // Idle with that address space still loaded.
+    volatile uint8_t flush_pending; // A shootdown skipped this CPU while lazy: flush before user code.
+    uint8_t reserved[6];
+} VMM_tlb_cpu_t;
+
+typedef struct VMM_pcid_stats
+{
+    bool enabled;
+    bool invpcid;
+    uint64_t cr3_switches;
+    uint64_t cr3_noflush;
+    uint64_t cr3_flush;
+    uint64_t recycles;
+    uint64_t as_invalidations;
+    uint64_t global_invalidations;
+    uint64_t lazy_skips;            // Shootdown IPIs not sent to idle CPUs.
+    uint64_t lazy_flushes;          // Deferred flushes run when such a CPU picked up user code.
+} VMM_pcid_stats_t;
+
 typedef struct VMM_runtime_state
 {
     PML4_t* pml4;
@@ -73,11 +125,23 @@ typedef struct VMM_runtime_state
     bool startup_identity_map_active;
     bool nx_checked;
     bool nx_supported;
+    bool pcid_supported;
+    bool invpcid_supported;
+    uint32_t pcid_cpu_limit;        // One past the highest CPU with PCIDs enabled.
+    volatile uint64_t pcid_gen;     // Bumped when kernel mappings change under every PCID.
+    uint64_t pcid_as_invalidations;
+    uint64_t pcid_global_invalidations;
+    VMM_pcid_cpu_t pcid_cpu[VMM_PCID_MAX_CPUS];
+    uint64_t tlb_lazy_skips;
+    uint64_t tlb_lazy_flushes;
+    VMM_tlb_cpu_t tlb_cpu[VMM_PCID_MAX_CPUS];
 } VMM_runtime_state_t;
 
 uintptr_t VMM_get_AHCI_virt(void);
 uintptr_t VMM_get_kernel_cr3_phys(void);
+bool VMM_is_nx_supported(void);
 void VMM_enable_nx_current_cpu(void);
+void VMM_enable_wp_current_cpu(void);
 
 void VMM_map_kernel(void);
 void VMM_map_userland_stack(void);
@@ -94,8 +158,22 @@ void VMM_map_mmio_uc_page(uintptr_t virt, uintptr_t phys);
 void VMM_map_mmio_uc_pages(uintptr_t virt, uintptr_t phys, size_t len);
 bool VMM_unmap_page(uintptr_t virt, uintptr_t* old_phys_out);
 bool VMM_update_page_flags(uintptr_t virt, uintptr_t set_bits, uintptr_t clear_bits);
+bool VMM_unmap_page_noflush(uintptr_t virt, uintptr_t* old_phys_out);
+bool VMM_update_page_flags_noflush(uintptr_t virt, uintptr_t set_bits, uintptr_t clear_bits);
+void VMM_flush_tlb_range(uintptr_t virt, size_t page_count);
 
 void VMM_load_cr3(void);
+void VMM_enable_pcid_current_cpu(uint32_t cpu_index);
+void VMM_switch_cr3(uint32_t cpu_index, uintptr_t cr3_phys);
+void VMM_flush_address_space(uintptr_t cr3_phys);
+void VMM_forget_address_space(uintptr_t cr3_phys);
+void VMM_pcid_invalidate_all(void);
+void VMM_get_pcid_stats(VMM_pcid_stats_t* out);
+void VMM_tlb_enter_lazy(uint32_t cpu_index);
+void VMM_tlb_leave_lazy(uint32_t cpu_index);
+bool VMM_tlb_cpu_needs_flush(uint32_t cpu_index, uintptr_t cr3_phys);
+bool VMM_tlb_cpu_has_loaded(uint32_t cpu_index, uintptr_t cr3_phys);
+void VMM_tlb_release_address_space(uint32_t cpu_index, uintptr_t cr3_phys);
 
 bool VMM_virt_to_phys(uintptr_t virt, uintptr_t* phys_out);
 bool VMM_phys_to_virt(uintptr_t phys, uintptr_t* virt_out);
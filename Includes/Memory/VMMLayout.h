@@ -9,12 +9,14 @@
 #define VMM_HHDM_BASE              0xFFFF800000000000
 #define VMM_KERNEL_VIRT_BASE       0xFFFFFFFF80000000
 #define VMM_MMIO_BASE              0xFFFFC00000000000
+#define VMM_VMALLOC_BASE           0xFFFFE00000000000
 #define VMM_USER_SPACE_MAX         0x00007FFFFFFFFFFF
 #define VMM_KERNEL_SPACE_MIN       0xFFFF800000000000
 #else
 #define VMM_HHDM_BASE              0xFFFF800000000000ULL
 #define VMM_KERNEL_VIRT_BASE       0xFFFFFFFF80000000ULL
 #define VMM_MMIO_BASE              0xFFFFC00000000000ULL
+#define VMM_VMALLOC_BASE           0xFFFFE00000000000ULL
 #define VMM_USER_SPACE_MAX         0x00007FFFFFFFFFFFULL
 #define VMM_KERNEL_SPACE_MIN       0xFFFF800000000000ULL
 #endif
@@ -22,5 +24,7 @@
 #define VMM_HHDM_PML4_INDEX        256U
 #define VMM_KERNEL_PML4_INDEX      511U
 #define VMM_KERNEL_PDPT_INDEX      510U
+#define VMM_VMALLOC_PML4_INDEX     448U
+#define VMM_VMALLOC_SIZE           (1ULL << 39)    // One PML4 slot, shared by every address space.
 
 #endif
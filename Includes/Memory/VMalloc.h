@@ -0,0 +1,67 @@
+#ifndef _VMALLOC_H
+#define _VMALLOC_H
+
+#include <Debug/Spinlock.h>
+#include <Memory/VMMLayout.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define VMALLOC_AREA_MAX        1024U
+#define VMALLOC_GUARD_PAGES     1U      // Left unmapped after each area so overruns fault.
+#define VMALLOC_UNMAP_BATCH     64U     // Pages unmapped per TLB flush on release.
+
+#define VMALLOC_AREA_FREE       0U
+#define VMALLOC_AREA_USED       1U
+#define VMALLOC_AREA_RELEASING  2U      // Being unmapped: the range is reused only after the flush.
+#define VMALLOC_AREA_DEFERRED   3U      // Freed with interrupts off: still mapped until a later call.
+
+/*
+ * A virtual range of the vmalloc window, mapped page by page over non-contiguous
+ * physical memory. span_pages includes the guard page(s).
+ */
+typedef struct VMALLOC_area
+{
+    uintptr_t base;
+    size_t span_pages;
+    size_t mapped_pages;
+    size_t size;
+    uint32_t state;
+} VMALLOC_area_t;
+
+typedef struct VMALLOC_stats
+{
+    uint32_t areas;
+    uint32_t free_areas;
+    uint64_t mapped_pages;
+    uint64_t window_used;               // Bytes of the window handed out so far (bump pointer).
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+} VMALLOC_stats_t;
+
+typedef struct VMALLOC_runtime_state
+{
+    spinlock_t lock;
+    bool ready;
+    uintptr_t next;                     // Bump pointer into the window.
+    uint32_t area_count;                // Slots in use, free ranges included.
+    uint64_t mapped_pages;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+    VMALLOC_area_t areas[VMALLOC_AREA_MAX];
+} VMALLOC_runtime_state_t;
+
+void vmalloc_init(void);
+bool vmalloc_is_ready(void);
+
+void* vmalloc(size_t size);
+void vfree(void* ptr);
+
+bool vmalloc_owns(const void* ptr);
+size_t vmalloc_size(const void* ptr);
+void vmalloc_get_stats(VMALLOC_stats_t* out);
+
+#endif
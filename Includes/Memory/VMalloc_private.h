@@ -0,0 +1,14 @@
+#ifndef _VMALLOC_PRIVATE_H
+#define _VMALLOC_PRIVATE_H
+
+#include <Memory/VMalloc.h>
+
+static bool vmalloc_interrupts_enabled(void);
+static VMALLOC_area_t* vmalloc_new_slot_locked(void);
+static VMALLOC_area_t* vmalloc_reserve_locked(size_t span_pages);
+static VMALLOC_area_t* vmalloc_find_locked(uintptr_t base);
+static void vmalloc_merge_locked(VMALLOC_area_t* area);
+static void vmalloc_release_area(VMALLOC_area_t* area);
+static void vmalloc_reap_deferred(void);
+
+#endif
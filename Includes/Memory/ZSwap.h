@@ -0,0 +1,72 @@
+#ifndef _ZSWAP_H
+#define _ZSWAP_H
+
+#include <Debug/Spinlock.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define ZSWAP_PAGE_SIZE         4096U
+#define ZSWAP_MAX_STORED        2048U   // Pages that do not compress below this stay resident.
+#define ZSWAP_POOL_SHIFT        2U      // Compressed copies take at most 1/4 of physical memory ...
+#define ZSWAP_SLOT_SHIFT        1U      // ... in at most one slot per two physical pages.
+#define ZSWAP_SLOT_LIMIT        (1U << 20)
+#define ZSWAP_LZ4_HASH_BITS     10U
+#define ZSWAP_LZ4_MIN_MATCH     4U
+#define ZSWAP_LZ4_LAST_LITERALS 5U      // Block format rules: the last bytes are always literals ...
+#define ZSWAP_LZ4_MFLIMIT       12U     // ... and no match starts this close to the end.
+
+#define ZSWAP_SLOT_FREE         0U
+#define ZSWAP_SLOT_DATA         1U      // LZ4 block in a kmalloc buffer.
+#define ZSWAP_SLOT_FILL         2U      // One 64-bit word repeated over the page: nothing stored.
+
+/*
+ * A swapped-out page. Slots are shared by every PTE a fork copied the entry into; free ones
+ * are chained through data. Slot 0 is never handed out.
+ */
+typedef struct ZSWAP_slot
+{
+    uintptr_t data;                     // Buffer, fill word, or next free slot.
+    uint32_t len;
+    uint16_t refs;
+    uint16_t kind;
+} ZSWAP_slot_t;
+
+typedef struct ZSWAP_stats
+{
+    uint64_t stored_pages;              // Slots in use.
+    uint64_t fill_pages;                // ... of which same-filled pages, taking no memory.
+    uint64_t pool_bytes;                // Compressed bytes held.
+    uint64_t pool_limit;
+    uint64_t stores;
+    uint64_t loads;
+    uint64_t rejects;                   // Pages that did not compress well enough.
+    uint64_t failures;                  // Pool or slot table full, or no memory for the copy.
+} ZSWAP_stats_t;
+
+typedef struct ZSWAP_runtime_state
+{
+    spinlock_t lock;
+    uint8_t ready;
+    ZSWAP_slot_t* slots;                // vmalloc'd on the first store.
+    uint32_t capacity;
+    uint32_t next_unused;               // Slots past this were never handed out.
+    uint32_t free_head;
+    uint64_t pool_limit;
+    uint64_t stored_pages;
+    uint64_t fill_pages;
+    uint64_t pool_bytes;
+    uint64_t stores;
+    uint64_t loads;
+    volatile uint64_t rejects;
+    volatile uint64_t failures;
+} ZSWAP_runtime_state_t;
+
+bool zswap_store(const void* page, uint32_t* out_slot);
+bool zswap_load(uint32_t slot, void* page);
+bool zswap_dup(uint32_t slot);
+void zswap_free(uint32_t slot);
+void zswap_get_stats(ZSWAP_stats_t* out);
+
+#endif
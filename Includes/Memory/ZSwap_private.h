@@ -0,0 +1,23 @@
+#ifndef _ZSWAP_PRIVATE_H
+#define _ZSWAP_PRIVATE_H
+
+#include <Memory/ZSwap.h>
+
+static inline uint32_t zswap_read32(const uint8_t* ptr);
+static inline uint32_t zswap_hash(uint32_t sequence);
+static bool zswap_put_length(uint8_t* dst, uint32_t* op, uint32_t cap, uint32_t len);
+static bool zswap_put_sequence(uint8_t* dst,
+                               uint32_t* op,
+                               uint32_t cap,
+                               const uint8_t* literals,
+                               uint32_t literal_len,
+                               uint32_t offset,
+                               uint32_t match_len);
+static uint32_t zswap_compress(const uint8_t* src, uint8_t* dst, uint32_t cap);
+static bool zswap_get_length(const uint8_t* src, uint32_t len, uint32_t* ip, uint32_t* value);
+static bool zswap_decompress(const uint8_t* src, uint32_t len, uint8_t* dst);
+static bool zswap_page_fill(const void* page, uint64_t* out_word);
+static bool zswap_table_init(void);
+static void zswap_release_slot_locked(uint32_t slot, uintptr_t* out_buffer);
+
+#endif
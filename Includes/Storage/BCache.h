@@ -0,0 +1,82 @@
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+#include <Debug/Spinlock.h>
+#include <Storage/AHCI.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef THEOS_BCACHE_MAX_KIB
+#define THEOS_BCACHE_MAX_KIB    32768U
+#endif
+
+#define BCACHE_HASH_BUCKETS     1024U
+#define BCACHE_BLOCK_MAX        65536U
+#define BCACHE_MEM_SHIFT        4U      // At most 1/16 of physical memory, and THEOS_BCACHE_MAX_KIB ...
+#define BCACHE_MIN_BYTES        (256U * 1024U)  // ... but this much is kept even when memory runs low.
+
+/*
+ * A cached disk block, keyed by (port, first sector, size). Entries sit on a hash chain
+ * and the LRU list; dirty ones are also on the dirty list, oldest write first.
+ */
+typedef struct BCACHE_entry
+{
+    struct BCACHE_entry* hash_next;
+    struct BCACHE_entry* lru_prev;      // Toward the most recently used.
+    struct BCACHE_entry* lru_next;
+    struct BCACHE_entry* dirty_prev;
+    struct BCACHE_entry* dirty_next;
+    HBA_PORT_t* port;
+    uint64_t lba;
+    uint32_t size;
+    uint8_t dirty;
+    uint8_t writeback;                  // On its way to the disk: not evicted, not written twice.
+    uint8_t* data;
+} BCACHE_entry_t;
+
+typedef struct BCACHE_stats
+{
+    uint64_t blocks;
+    uint64_t dirty_blocks;
+    uint64_t bytes;
+    uint64_t limit;                     // Current size limit, lowered while memory is short.
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t reads;                     // Blocks read from the disk ...
+    uint64_t writes;                    // ... and written back to it.
+    uint64_t evictions;
+    uint64_t io_errors;
+} BCACHE_stats_t;
+
+typedef struct BCACHE_runtime_state
+{
+    spinlock_t lock;
+    bool ready;
+    BCACHE_entry_t* buckets[BCACHE_HASH_BUCKETS];
+    uint32_t bucket_gen[BCACHE_HASH_BUCKETS];  // Bumped when an entry joins or leaves the chain.
+    BCACHE_entry_t* lru_head;
+    BCACHE_entry_t* lru_tail;
+    BCACHE_entry_t* dirty_head;
+    BCACHE_entry_t* dirty_tail;
+    uint64_t blocks;
+    uint64_t dirty_blocks;
+    uint64_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t evictions;
+    volatile uint64_t io_errors;
+} BCACHE_runtime_state_t;
+
+void BCache_init(void);
+bool BCache_read(HBA_PORT_t* port, uint64_t lba, uint32_t size, uint32_t offset, void* out, uint32_t len);
+bool BCache_write(HBA_PORT_t* port, uint64_t lba, uint32_t size, uint32_t offset, const void* data, uint32_t len);
+bool BCache_sync(HBA_PORT_t* port);
+uint64_t BCache_drop_clean(void);
+uint64_t BCache_shrink(uint64_t target_pages);
+void BCache_get_stats(BCACHE_stats_t* out);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _BCACHE_PRIVATE_H
+#define _BCACHE_PRIVATE_H
+
+#include <Storage/BCache.h>
+
+static uint32_t BCache_hash(const HBA_PORT_t* port, uint64_t lba);
+static bool BCache_request_valid(HBA_PORT_t* port, uint32_t size, uint32_t offset, uint32_t len);
+static uint64_t BCache_limit(void);
+static BCACHE_entry_t* BCache_find_locked(const HBA_PORT_t* port, uint64_t lba, uint32_t size);
+static void BCache_lru_unlink_locked(BCACHE_entry_t* entry);
+static void BCache_lru_push_locked(BCACHE_entry_t* entry);
+static void BCache_insert_locked(BCACHE_entry_t* entry);
+static void BCache_remove_locked(BCACHE_entry_t* entry);
+static void BCache_mark_dirty_locked(BCACHE_entry_t* entry);
+static void BCache_clear_dirty_locked(BCACHE_entry_t* entry);
+static BCACHE_entry_t* BCache_evict_clean_locked(void);
+static BCACHE_entry_t* BCache_entry_alloc(HBA_PORT_t* port, uint64_t lba, uint32_t size);
+static void BCache_entry_free(BCACHE_entry_t* entry);
+static bool BCache_disk_io(BCACHE_entry_t* entry, bool write);
+static int BCache_writeback_one(HBA_PORT_t* port);
+static void BCache_make_room(uint32_t size);
+static BCACHE_entry_t* BCache_get(HBA_PORT_t* port,
+                                  uint64_t lba,
+                                  uint32_t size,
+                                  bool fill,
+                                  BCACHE_entry_t** out_spare,
+                                  uint64_t* out_flags);
+
+#endif
@@ -16,6 +16,7 @@
 #define TASK_CPU_LOCAL_SYSCALL_RSP0_OFF 0
 #define TASK_CPU_LOCAL_CPU_INDEX_OFF 8
 #define TASK_CPU_LOCAL_APIC_ID_OFF 12
+#define TASK_CPU_LOCAL_SYSCALL_FAST_RETURN_OFF 14
 #define TASK_CPU_LOCAL_SYSCALL_USER_RSP_OFF 40
 #define TASK_CPU_LOCAL_MAGIC 0x4350554CUL
 #define TASK_WORK_CPU_ANY 0xFFFFFFFFU
@@ -54,10 +55,13 @@ typedef struct task
     uintptr_t fpu_state_alloc;
     uint32_t fpu_state_size;
     uint8_t fpu_initialized;
-    uint8_t fpu_reserved[3];
+    uint8_t fpu_state_init;         // Registers were in init state at the last switch-out: area not written.
+    uint8_t fpu_reserved[2];
 } task_t;
 
 typedef void (*task_work_fn_t)(void* arg);
+typedef uint32_t (*task_balance_depth_fn_t)(uint32_t cpu_index);
+typedef uint32_t (*task_balance_steal_fn_t)(uint32_t victim_cpu, uint32_t batch_max, void* context);
 
 typedef struct task_cpu_local
 {
@@ -65,7 +69,8 @@ typedef struct task_cpu_local
     uint32_t cpu_index;
     uint8_t apic_id;
     uint8_t online;
-    uint16_t reserved0;
+    uint8_t syscall_fast_return;    // Set by the dispatcher: the stub skips the post handler.
+    uint8_t reserved0;
     uint32_t magic;
     volatile uint64_t syscall_count;
     uintptr_t current_task;
@@ -94,7 +99,9 @@ typedef struct task_waiter
     uint32_t cpu_index;
     volatile uint8_t queued;
     volatile uint8_t signaled;
-    uint8_t reserved[2];
+    volatile uint8_t parked;        // Owner user process is parked off-CPU on this waiter.
+    volatile uint8_t interrupted;   // Owner was killed while parked: the wait must give up.
+    uint32_t parked_slot;
 } task_waiter_t;
 
 typedef struct task_wait_queue
@@ -142,6 +149,7 @@ typedef struct task_scheduler_state
     task_cpu_local_t cpu_local_per_apic[TASK_MAX_CPUS];
     task_runqueue_t runqueues[TASK_MAX_CPUS];
     uint32_t steal_cursor[TASK_MAX_CPUS];
+    uintptr_t cpu_kernel_stack[TASK_MAX_CPUS];
     task_wait_queue_t sleep_waitq;
     task_scheduler_stats_t stats;
     task_scheduler_control_t control;
@@ -153,14 +161,22 @@ extern void perform_task_switch(task_t* task);
 void task_init(uintptr_t kernel_stack);
 bool task_init_cpu(uint32_t cpu_index, uintptr_t kernel_stack, uint8_t apic_id);
 uint32_t task_get_current_cpu_index(void);
+bool task_cpu_is_online(uint32_t cpu_index);
 task_cpu_local_t* task_get_cpu_local(void);
 task_t* task_get_current_task(void);
+uintptr_t task_get_cpu_kernel_stack(uint32_t cpu_index);
+void task_set_user_kernel_stack(uint32_t cpu_index, uintptr_t rsp0);
 void task_switch(void);
 bool task_schedule_work(task_work_fn_t fn, void* arg);
 bool task_schedule_work_on_cpu(uint32_t cpu_index, task_work_fn_t fn, void* arg);
 bool task_run_next_work(void);
 bool task_run_next_work_on_cpu(uint32_t cpu_index);
 void task_scheduler_on_tick(void);
+uint32_t task_balance_pick_push_target(uint32_t source_cpu, task_balance_depth_fn_t depth_fn);
+bool task_balance_steal(uint32_t thief_cpu,
+                        task_balance_depth_fn_t depth_fn,
+                        task_balance_steal_fn_t steal_fn,
+                        void* context);
 void task_set_push_balance(bool enabled);
 bool task_is_push_balance_enabled(void);
 void task_set_work_stealing(bool enabled);
@@ -3,6 +3,5 @@
 
 #include <Task/Task.h>
 
-static bool task_cpu_is_online(uint32_t cpu_index);
 
 #endif
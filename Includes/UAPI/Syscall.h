@@ -72,6 +72,45 @@
 #define SYS_RTC_TIME_GET                  64
 /* Écriture directe vers KDEBUG (série / fichier tampon), indépendante du routage PTY/GUI. */
 #define SYS_KDEBUG_WRITE                  65
+#define SYS_SETPRIORITY                   66
+/* Renvoie 20 - nice (1..40) pour que -1 reste l'erreur. */
+#define SYS_GETPRIORITY                   67
+#define SYS_SCHED_SETSCHEDULER            68
+#define SYS_SCHED_GETSCHEDULER            69
+#define SYS_SCHED_SETAFFINITY             70
+#define SYS_SCHED_GETAFFINITY             71
+/* Temps CPU (ns TSC), attente runqueue et changements de contexte : self, thread ou enfants attendus. */
+#define SYS_GETRUSAGE                     72
+#define SYS_GETPID                        73
+#define SYS_GETPPID                       74
+/* Compteurs d'appels par numéro de syscall (somme sur les CPU) et retours rapides. */
+#define SYS_SYSCALL_STATS_GET             75
+#define SYS_SYSCALL_STATS_MAX             128U
+/* Compteurs TLB : changements de CR3 avec ou sans flush grâce aux PCID (somme sur les CPU). */
+#define SYS_TLB_INFO_GET                  76
+/* Mémoire physique : pages libres et blocs libres par ordre de l'allocateur buddy, et par nœud NUMA. */
+#define SYS_MEM_INFO_GET                  77
+#define SYS_MEM_ORDER_COUNT               11U
+#define SYS_MEM_MAX_NODES                 16U
+/* Limites mémoire de l'espace d'adressage courant, héritées par fork et exec (octets, syscall_rlimit_t). */
+#define SYS_GETRLIMIT                     78
+/* cur doit rester <= max, et max ne peut que baisser. */
+#define SYS_SETRLIMIT                     79
+/* Tas noyau (kmalloc) : octets utilisés et pic, fragmentation et, noyau construit avec THEOS_KMEM_TRACK, appelants principaux. */
+#define SYS_KMEM_INFO_GET                 80
+#define SYS_KMEM_INFO_DUMP                (1U << 0)   /* Écrit aussi le rapport sur KDEBUG. */
+#define SYS_KMEM_SITE_MAX                 16U
+/* Écrit sur disque les blocs modifiés du cache de blocs ext4. */
+#define SYS_SYNC                          81
+#define SYS_SYNC_DROP_CACHES              (1U << 0)   /* Puis oublie les blocs propres : le prochain accès relit le disque. */
+/* IPC_RMID seul : la clé est libérée, les appels bloqués sur la file échouent. */
+#define SYS_MSGCTL                        82
+
+#define SYS_IPC_INFO_GET                  83
+
+/* Page vvar en lecture seule mappée par exec dans chaque processus : horloges lues sans syscall. */
+#define SYS_VVAR_ADDR                     0x0000000070001000ULL
+#define SYS_VVAR_TSC_SHIFT                24U
 
 #define SYS_CONSOLE_ROUTE_FLAG_CAPTURE   (1U << 0)
 #define SYS_CONSOLE_ROUTE_FLAG_TTY       (1U << 1)
@@ -91,6 +130,7 @@
 #define SYS_MAP_SHARED    0x01U
 #define SYS_MAP_PRIVATE   0x02U
 #define SYS_MAP_ANONYMOUS 0x20U
+#define SYS_MAP_POPULATE  0x8000U   // Anonyme : alloue toutes les pages au mmap au lieu du premier accès.
 
 #define SYS_FUTEX_WAIT   0
 #define SYS_FUTEX_WAKE   1
@@ -148,6 +188,16 @@
 #define SYS_POWER_CMD_SLEEP    2U
 #define SYS_POWER_CMD_REBOOT   3U
 
+#define SYS_SCHED_OTHER        0U
+#define SYS_SCHED_FIFO         1U
+#define SYS_SCHED_RR           2U
+#define SYS_SCHED_RT_PRIO_MIN  1U
+#define SYS_SCHED_RT_PRIO_MAX  31U
+#define SYS_SCHED_CPUSET_WORDS 4U
+#define SYS_PRIO_PROCESS       0U
+#define SYS_NICE_MIN           (-20)
+#define SYS_NICE_MAX           19
+
 #define SYS_DIRENT_NAME_MAX 255U
 #define SYS_DT_UNKNOWN      0U
 #define SYS_DT_DIR          4U
@@ -163,6 +213,12 @@
 #define SYS_PROC_DOMAIN_USERLAND           3U
 #define SYS_PROC_CPU_NONE                  0xFFFFFFFFU
 #define SYS_PROC_MAX_ENTRIES               32U
+#define SYS_RUSAGE_SELF                    0U
+#define SYS_RUSAGE_THREAD                  1U
+#define SYS_RUSAGE_CHILDREN                2U
+#define SYS_RLIMIT_AS                      0U   // Pages réservées (mmap, shm, ELF, pile) : mmap échoue au-delà.
+#define SYS_RLIMIT_RSS                     1U   // Pages résidentes : l'allocation ou la faute échoue au-delà.
+#define SYS_RLIM_INFINITY                  0xFFFFFFFFFFFFFFFFULL
 
 #ifndef __ASSEMBLER__
 typedef struct syscall_cpu_info
@@ -182,6 +238,11 @@ typedef struct syscall_sched_info
     uint32_t preempt_count;
     uint32_t local_rq_depth;
     uint32_t total_rq_depth;
+    uint32_t user_rq_depth;
+    uint32_t user_rq_total;
+    uint64_t pick_next_calls;
+    uint64_t pick_next_cycles;
+    uint64_t user_steals;
 } syscall_sched_info_t;
 
 typedef struct syscall_ahci_irq_info
@@ -200,6 +261,143 @@ typedef struct syscall_rcu_info
     uint32_t local_preempt_count;
 } syscall_rcu_info_t;
 
+/*
+ * Seqlock: seq est impair pendant la mise à jour, relire si seq change.
+ * monotonic_ns = ns_base + (((tsc - tsc_base) * tsc_mult) >> SYS_VVAR_TSC_SHIFT), tsc_mult = 0 sans TSC.
+ */
+typedef struct syscall_vvar
+{
+    volatile uint32_t seq;
+    uint32_t tick_hz;
+    uint64_t ticks;
+    uint64_t tsc_base;
+    uint64_t tsc_mult;
+    uint64_t ns_base;
+    uint64_t realtime_offset_ns;    // CLOCK_REALTIME - CLOCK_MONOTONIC (0 sans RTC).
+} syscall_vvar_t;
+
+typedef struct syscall_stats_info
+{
+    uint32_t nr_count;      // Valid entries of calls[].
+    uint32_t reserved;
+    uint64_t fast_returns;  // Calls that returned to user mode without the post handler.
+    uint64_t calls[SYS_SYSCALL_STATS_MAX];
+} syscall_stats_info_t;
+
+typedef struct syscall_tlb_info
+{
+    uint32_t pcid_enabled;
+    uint32_t invpcid;
+    uint64_t cr3_switches;
+    uint64_t cr3_noflush;           // Address-space switches that kept the tagged TLB entries.
+    uint64_t cr3_flush;
+    uint64_t pcid_recycles;         // PCIDs taken over from another address space.
+    uint64_t as_invalidations;      // One address space edited: its tags elsewhere went stale.
+    uint64_t global_invalidations;  // Kernel mappings edited: every tag went stale.
+    uint64_t shootdowns;            // Remote flush requests (a page, a range or a context).
+    uint64_t shootdowns_no_ipi;     // ... with no other CPU running the address space.
+    uint64_t shootdown_ipis;
+    uint64_t shootdown_pages;       // Pages covered by range requests.
+    uint64_t shootdown_full_flushes;
+    uint64_t lazy_skips;            // IPIs not sent to idle CPUs, left a pending flush instead.
+    uint64_t lazy_flushes;
+} syscall_tlb_info_t;
+
+typedef struct syscall_mem_info
+{
+    uint64_t page_size;
+    uint64_t total_pages;
+    uint64_t free_pages;
+    uint64_t free_blocks[SYS_MEM_ORDER_COUNT];  // Free blocks of 2^order pages.
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t splits;
+    uint64_t merges;
+    uint64_t bad_frees;             // Refused frees: double frees or pages never handed out.
+    uint64_t cached_pages;          // Free pages parked in per-CPU caches (counted in free_pages).
+    uint64_t pcp_hits;
+    uint64_t pcp_refills;
+    uint64_t pcp_drains;
+    uint32_t node_count;
+    uint32_t reserved;
+    uint32_t node_id[SYS_MEM_MAX_NODES];            // Domaine de proximité ACPI.
+    uint64_t node_total_pages[SYS_MEM_MAX_NODES];
+    uint64_t node_free_pages[SYS_MEM_MAX_NODES];    // Hors caches par CPU.
+    uint64_t node_local_allocs[SYS_MEM_MAX_NODES];  // Servies par le nœud du CPU demandeur.
+    uint64_t node_remote_allocs[SYS_MEM_MAX_NODES]; // Repli sur un nœud plus lointain.
+    uint64_t thp_pages;             // Pages de 2 Mio mappées en ce moment.
+    uint64_t thp_faults;            // Premiers accès servis par une page de 2 Mio.
+    uint64_t thp_fallbacks;         // Repli en 4 Kio faute de bloc d'ordre 9.
+    uint64_t thp_splits;
+    uint64_t thp_collapses;
+    uint64_t zero_pool_pages;       // Pages libres déjà mises à zéro (comptées dans free_pages).
+    uint64_t zero_hits;             // Pages zéro servies par le pool ...
+    uint64_t zero_misses;           // ... ou effacées sur place, pool vide.
+    uint64_t usercopy_slow;         // Copies noyau <-> user reprises page par page après une faute.
+    uint64_t rlimit_hits;           // Mappings et fautes refusés par RLIMIT_AS/RLIMIT_RSS.
+    uint64_t swap_pages;            // Pages anonymes compressées en mémoire (swap).
+    uint64_t swap_fill_pages;       // ... dont pages uniformes, sans stockage.
+    uint64_t swap_pool_bytes;       // Octets compressés conservés.
+    uint64_t swap_pool_limit;
+    uint64_t swap_outs;
+    uint64_t swap_ins;
+    uint64_t swap_rejects;          // Pages trop peu compressibles ou pool plein : restées résidentes.
+    uint64_t swap_direct;           // Fautes qui ont dû libérer de la mémoire elles-mêmes.
+    uint64_t reclaim_runs;          // Passes de fond déclenchées par le seuil bas du PMM.
+    uint64_t reclaim_pages;
+    uint64_t bcache_blocks;         // Blocs disque en cache (métadonnées et données ext4).
+    uint64_t bcache_dirty;          // ... dont modifiés, pas encore écrits.
+    uint64_t bcache_bytes;
+    uint64_t bcache_limit;          // Plafond courant, abaissé quand la mémoire manque.
+    uint64_t bcache_hits;
+    uint64_t bcache_misses;
+    uint64_t bcache_reads;          // Blocs lus sur le disque ...
+    uint64_t bcache_writes;         // ... et écrits.
+    uint64_t bcache_evictions;
+} syscall_mem_info_t;
+
+typedef struct syscall_kmem_site
+{
+    uint64_t site;                  // Adresse de retour dans l'appelant de kmalloc.
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t live_bytes;
+    uint64_t live_count;
+    uint64_t peak_bytes;
+} syscall_kmem_site_t;
+
+typedef struct syscall_kmem_info
+{
+    uint64_t bytes_in_use;          // Taille servie par le slab, le tas ou vmalloc.
+    uint64_t bytes_peak;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+    uint64_t last_failure_size;
+    uint64_t heap_size;             // Toutes les arènes, en-têtes compris.
+    uint64_t heap_used;
+    uint64_t heap_used_blocks;
+    uint64_t heap_free;
+    uint64_t heap_free_blocks;      // Longueur de la liste libre.
+    uint64_t heap_largest_free;
+    uint64_t arenas_grown;
+    uint64_t arenas_released;
+    uint32_t arenas;
+    uint32_t tracking;              // 1 si le noyau étiquette chaque allocation.
+    uint32_t site_count;
+    uint32_t site_returned;         // Entrées valides de sites[], par octets vivants décroissants.
+    uint64_t untracked;
+    syscall_kmem_site_t sites[SYS_KMEM_SITE_MAX];
+} syscall_kmem_info_t;
+
+typedef struct syscall_ipc_info
+{
+    uint32_t pipes;                 // Objets IPC alloués à la création : tubes vivants ...
+    uint32_t pipes_max;             // ... et leur plafond (THEOS_MAX_PIPES).
+    uint32_t msg_queues;            // Files de messages, jusqu'à IPC_RMID.
+    uint32_t msg_queues_max;
+} syscall_ipc_info_t;
+
 typedef struct syscall_dirent
 {
     uint32_t d_ino;
@@ -219,8 +417,37 @@ typedef struct syscall_proc_info
     uint32_t last_cpu;
     uint32_t term_signal;
     int64_t exit_status;
+    uint64_t utime_ns;
+    uint64_t stime_ns;
+    uint64_t wait_ns;
+    uint64_t blocked_ns;
+    uint64_t nvcsw;
+    uint64_t nivcsw;
+    uint64_t rss_pages;             // Pages résidentes de l'espace d'adressage (communes aux threads).
+    uint64_t anon_pages;
+    uint64_t file_pages;            // Copies privées de fichiers et segments ELF.
+    uint64_t shared_pages;          // Segments shm et dma-buf.
+    uint64_t pt_pages;              // Tables de pages user sous le PML4.
+    uint64_t vm_pages;              // Pages réservées, résidentes ou non.
+    uint64_t swap_pages;            // Pages anonymes compressées dans le pool de swap.
 } syscall_proc_info_t;
 
+typedef struct syscall_rlimit
+{
+    uint64_t cur;
+    uint64_t max;
+} syscall_rlimit_t;
+
+typedef struct syscall_rusage
+{
+    uint64_t utime_ns;
+    uint64_t stime_ns;
+    uint64_t wait_ns;
+    uint64_t blocked_ns;
+    uint64_t nvcsw;
+    uint64_t nivcsw;
+} syscall_rusage_t;
+
 typedef struct syscall_mouse_event
 {
     int16_t dx;
@@ -3,6 +3,7 @@
 
 #include <CPU/ISR.h>
 #include <CPU/Syscall.h>
+#include <CPU/x86.h>
 #include <Device/HPET.h>
 #include <Device/PIT.h>
 #include <Device/TTY.h>
@@ -656,6 +657,7 @@ bool APIC_timer_init_bsp(uint32_t hz)
     APIC_local_write(APIC_LVT_TMR, APIC_DISABLE | (TICK_VECTOR & 0xFFU));
 
     const uint32_t start_count = 0xFFFFFFFFU;
+    uint64_t tsc_start = x86_rdtsc();
     APIC_local_write(APIC_TMRINITCNT, start_count);
 
     uint64_t calib_ref_ticks = 0;
@@ -686,6 +688,7 @@ bool APIC_timer_init_bsp(uint32_t hz)
     }
 
     uint32_t elapsed = start_count - APIC_local_read(APIC_TMRCURRCNT);
+    uint64_t tsc_elapsed = x86_rdtsc() - tsc_start;
     if (elapsed == 0)
     {
         APIC_local_write(APIC_LVT_TMR, APIC_DISABLE | (TICK_VECTOR & 0xFFU));
@@ -705,6 +708,7 @@ bool APIC_timer_init_bsp(uint32_t hz)
 
     __atomic_store_n(&APIC_runtime_state.timer.periodic_initial_count, periodic_initial_count, __ATOMIC_RELAXED);
     __atomic_store_n(&APIC_runtime_state.timer.calibrated_hz, hz, __ATOMIC_RELAXED);
+    __atomic_store_n(&APIC_runtime_state.timer.tsc_hz, (tsc_elapsed * 1000ULL) / LAPIC_TIMER_CALIBRATION_MS, __ATOMIC_RELAXED);
     __atomic_store_n(&APIC_runtime_state.timer.calibrated, 1, __ATOMIC_RELEASE);
 
     if (!use_hpet)
@@ -733,6 +737,11 @@ bool APIC_timer_init_bsp(uint32_t hz)
     return true;
 }
 
+uint64_t APIC_get_tsc_hz(void)
+{
+    return __atomic_load_n(&APIC_runtime_state.timer.tsc_hz, __ATOMIC_RELAXED);
+}
+
 bool APIC_timer_init_ap(uint32_t hz)
 {
     if (!APIC_runtime_state.capability.enabled)
@@ -13,7 +13,9 @@ _Static_assert(FPU_STRESS_CPU_SLOTS == TASK_MAX_CPUS,
                "FPU stress slots must match scheduler CPU slots");
 
 static FPU_runtime_state_t FPU_state = {
+    .save_mode = FPU_SAVE_MODE_FXSAVE,
     .state_area_size = sizeof(FPU_fx_state_t),
+    .standard_area_size = sizeof(FPU_fx_state_t),
     .state_mask = FPU_XCR0_X87 | FPU_XCR0_SSE
 };
 
@@ -58,6 +60,21 @@ static inline void FPU_xsave_to(void* state)
     __asm__ __volatile__("xsave (%0)" : : "r"(state), "a"(eax), "d"(edx) : "memory");
 }
 
+static inline void FPU_xsaveopt_to(void* state)
+{
+    uint32_t eax = (uint32_t) (FPU_state.state_mask & 0xFFFFFFFFULL);
+    uint32_t edx = (uint32_t) ((FPU_state.state_mask >> 32) & 0xFFFFFFFFULL);
+    __asm__ __volatile__("xsaveopt (%0)" : : "r"(state), "a"(eax), "d"(edx) : "memory");
+}
+
+static inline void FPU_xsavec_to(void* state)
+{
+    uint32_t eax = (uint32_t) (FPU_state.state_mask & 0xFFFFFFFFULL);
+    uint32_t edx = (uint32_t) ((FPU_state.state_mask >> 32) & 0xFFFFFFFFULL);
+    __asm__ __volatile__("xsavec (%0)" : : "r"(state), "a"(eax), "d"(edx) : "memory");
+}
+
+/* XRSTOR picks the standard or compacted layout from XCOMP_BV in the area header. */
 static inline void FPU_xrstor_from(const void* state)
 {
     uint32_t eax = (uint32_t) (FPU_state.state_mask & 0xFFFFFFFFULL);
@@ -67,20 +84,55 @@ static inline void FPU_xrstor_from(const void* state)
 
 static inline void FPU_save_state(void* state)
 {
-    if (FPU_state.avx_enabled)
-        FPU_xsave_to(state);
-    else
-        FPU_fxsave_to((FPU_fx_state_t*) state);
+    switch (FPU_state.save_mode)
+    {
+        case FPU_SAVE_MODE_XSAVEC:
+            FPU_xsavec_to(state);
+            break;
+        case FPU_SAVE_MODE_XSAVEOPT:
+            FPU_xsaveopt_to(state);
+            break;
+        case FPU_SAVE_MODE_XSAVE:
+            FPU_xsave_to(state);
+            break;
+        default:
+            FPU_fxsave_to((FPU_fx_state_t*) state);
+            break;
+    }
 }
 
 static inline void FPU_restore_state(const void* state)
 {
-    if (FPU_state.avx_enabled)
+    if (FPU_state.save_mode != FPU_SAVE_MODE_FXSAVE)
         FPU_xrstor_from(state);
     else
         FPU_fxrstor_from((const FPU_fx_state_t*) state);
 }
 
+/*
+ * True when every enabled component is in its init configuration, so the live state
+ * equals the boot image and does not need to be written out. XINUSE does not track
+ * MXCSR, which is checked separately.
+ */
+static inline bool FPU_registers_in_init_state(void)
+{
+    if (!FPU_state.has_xinuse)
+        return false;
+
+    if ((x86_xgetbv(1) & FPU_state.state_mask) != 0)
+        return false;
+
+    uint32_t mxcsr = 0;
+    __asm__ __volatile__("stmxcsr %0" : "=m"(mxcsr));
+    return mxcsr == FPU_MXCSR_DEFAULT;
+}
+
+static inline uint32_t FPU_cpu_slot(void)
+{
+    uint32_t cpu_index = task_get_current_cpu_index();
+    return (cpu_index < FPU_STRESS_CPU_SLOTS) ? cpu_index : 0;
+}
+
 static inline uintptr_t FPU_align_up_uintptr(uintptr_t value, uintptr_t align)
 {
     return (value + (align - 1U)) & ~(align - 1U);
@@ -119,11 +171,19 @@ static bool FPU_ensure_task_state(task_t* task)
     return true;
 }
 
-static inline void FPU_save_task(task_t* task)
+static inline void FPU_save_task(task_t* task, uint32_t cpu_slot)
 {
     if (!task || !task->fpu_initialized)
         return;
 
+    /* Nothing to write back: the restore path reloads the init image instead. */
+    if (FPU_registers_in_init_state())
+    {
+        task->fpu_state_init = 1;
+        FPU_state.cpu_stats[cpu_slot].saves_skipped++;
+        return;
+    }
+
     if (!FPU_ensure_task_state(task))
     {
         task->fpu_initialized = 0;
@@ -131,20 +191,39 @@ static inline void FPU_save_task(task_t* task)
     }
 
     FPU_save_state((void*) task->fpu_state_ptr);
+    task->fpu_state_init = 0;
+    FPU_state.cpu_stats[cpu_slot].saves++;
 }
 
-static inline bool FPU_restore_task(task_t* task)
+static inline bool FPU_restore_task(task_t* task, uint32_t cpu_slot)
 {
     if (!task || !task->fpu_initialized)
         return false;
 
-    if (!FPU_ensure_task_state(task))
+    if (task->fpu_state_init)
     {
-        task->fpu_initialized = 0;
-        return false;
+        if (FPU_registers_in_init_state())
+            FPU_state.cpu_stats[cpu_slot].restores_skipped++;
+        else if (FPU_state.initial_state_ready)
+        {
+            FPU_restore_state(FPU_state.initial_state.bytes);
+            FPU_state.cpu_stats[cpu_slot].restores++;
+        }
+        else
+            __asm__ __volatile__("fninit");
+    }
+    else
+    {
+        if (!FPU_ensure_task_state(task))
+        {
+            task->fpu_initialized = 0;
+            return false;
+        }
+
+        FPU_restore_state((const void*) task->fpu_state_ptr);
+        FPU_state.cpu_stats[cpu_slot].restores++;
     }
 
-    FPU_restore_state((const void*) task->fpu_state_ptr);
     return true;
 }
 
@@ -153,39 +232,48 @@ void FPU_switch_task(task_t* prev, task_t* next)
     if (!FPU_state.sse_enabled)
         return;
 
+    uint32_t cpu_slot = FPU_cpu_slot();
+
     /* Save previous task FPU state if it was ever initialized. */
     if (prev && prev->fpu_initialized)
-        FPU_save_task(prev);
+        FPU_save_task(prev, cpu_slot);
 
     /* No next task => no state to restore. */
     if (!next)
         return;
 
-    /* Ensure next has a state buffer and either restore from it or
-     * initialize from the global initial state. */
+    /* A task that never ran starts from the init image, like one whose registers were clean. */
     if (!next->fpu_initialized)
     {
-        if (!FPU_ensure_task_state(next))
-        {
-            __asm__ __volatile__("fninit");
-            return;
-        }
-
-        if (FPU_state.initial_state_ready)
-            FPU_restore_state(FPU_state.initial_state.bytes);
-        else
-            __asm__ __volatile__("fninit");
-
         next->fpu_initialized = 1;
+        next->fpu_state_init = 1;
     }
-    else
+
+    if (!FPU_restore_task(next, cpu_slot))
+        __asm__ __volatile__("fninit");
+}
+
+/*
+ * Size of a compacted (XSAVEC) area for the features in mask: legacy region and header,
+ * then each enabled extended component packed in order, 64-byte aligned when CPUID asks.
+ */
+static uint32_t FPU_compacted_area_size(uint64_t mask)
+{
+    uint32_t size = FPU_XSAVE_LEGACY_SIZE + FPU_XSAVE_HEADER_SIZE;
+    for (uint32_t component = 2; component < 63; component++)
     {
-        if (!FPU_restore_task(next))
-        {
-            __asm__ __volatile__("fninit");
-            return;
-        }
+        if ((mask & (1ULL << component)) == 0)
+            continue;
+
+        uint32_t component_size = 0;
+        uint32_t component_flags = 0;
+        FPU_cpuid_full(FPU_XSAVE_CPUID_LEAF, component, &component_size, NULL, &component_flags, NULL);
+        if ((component_flags & FPU_XSAVE_COMP_ALIGN64) != 0)
+            size = (uint32_t) FPU_align_up_uintptr(size, FPU_XSAVE_ALIGN);
+        size += component_size;
     }
+
+    return size;
 }
 
 bool FPU_init_cpu(uint32_t cpu_index)
@@ -232,12 +320,29 @@ bool FPU_init_cpu(uint32_t cpu_index)
         xcr0 |= (FPU_XCR0_X87 | FPU_XCR0_SSE | FPU_XCR0_AVX);
         x86_xsetbv(0, xcr0);
 
+        /* EBX of sub-leaf 0 is the standard size for the features enabled in XCR0 right now. */
         uint32_t xsave_size = 0;
-        FPU_cpuid_full(FPU_XSAVE_CPUID_LEAF, 0, &xsave_size, NULL, NULL, NULL);
+        uint32_t xsave_features = 0;
+        FPU_cpuid_full(FPU_XSAVE_CPUID_LEAF, 0, NULL, &xsave_size, NULL, NULL);
+        FPU_cpuid_full(FPU_XSAVE_CPUID_LEAF, FPU_XSAVE_SUBLEAF_EXT, &xsave_features, NULL, NULL, NULL);
         if (xsave_size >= sizeof(FPU_fx_state_t) && xsave_size <= FPU_XSAVE_AREA_MAX)
         {
+            uint64_t mask = x86_xgetbv(0);
+            uint32_t compact_size = FPU_compacted_area_size(mask);
+
+            FPU_state.standard_area_size = xsave_size;
             FPU_state.state_area_size = xsave_size;
-            FPU_state.state_mask = x86_xgetbv(0);
+            FPU_state.state_mask = mask;
+            FPU_state.has_xinuse = (xsave_features & FPU_XSAVE_FEAT_XINUSE) != 0;
+            if ((xsave_features & FPU_XSAVE_FEAT_COMPACT) != 0 && compact_size <= xsave_size)
+            {
+                FPU_state.save_mode = FPU_SAVE_MODE_XSAVEC;
+                FPU_state.state_area_size = compact_size;
+            }
+            else if ((xsave_features & FPU_XSAVE_FEAT_OPT) != 0)
+                FPU_state.save_mode = FPU_SAVE_MODE_XSAVEOPT;
+            else
+                FPU_state.save_mode = FPU_SAVE_MODE_XSAVE;
             FPU_state.avx_enabled = true;
         }
         else
@@ -256,7 +361,10 @@ bool FPU_init_cpu(uint32_t cpu_index)
     if (!FPU_state.avx_enabled)
     {
         FPU_state.state_area_size = sizeof(FPU_fx_state_t);
+        FPU_state.standard_area_size = sizeof(FPU_fx_state_t);
         FPU_state.state_mask = FPU_XCR0_X87 | FPU_XCR0_SSE;
+        FPU_state.save_mode = FPU_SAVE_MODE_FXSAVE;
+        FPU_state.has_xinuse = false;
     }
 
     x86_clear_ts();
@@ -271,11 +379,13 @@ bool FPU_init_cpu(uint32_t cpu_index)
 
     FPU_state.sse_enabled = true;
 
-    kdebug_printf("[FPU] cpu=%u init sse=on avx=%s state=%uB mode=%s\n",
+    kdebug_printf("[FPU] cpu=%u init sse=on avx=%s state=%uB std=%uB mode=%s xinuse=%s\n",
                   cpu_index,
                   FPU_state.avx_enabled ? "on" : "off",
                   FPU_state.state_area_size,
-                  FPU_state.avx_enabled ? "xsave" : "fxsave");
+                  FPU_state.standard_area_size,
+                  FPU_get_save_mode_name(),
+                  FPU_state.has_xinuse ? "on" : "off");
     return true;
 }
 
@@ -304,8 +414,8 @@ bool FPU_stress_ymm_local(uint32_t iterations, uint64_t* signature_out)
     void* state_a = (void*) FPU_state.stress_state_a[cpu_index].bytes;
     void* state_b = (void*) FPU_state.stress_state_b[cpu_index].bytes;
 
-    memset(state_a, 0, FPU_state.state_area_size);
-    memset(state_b, 0, FPU_state.state_area_size);
+    memset(state_a, 0, FPU_state.standard_area_size);
+    memset(state_b, 0, FPU_state.standard_area_size);
 
     uint8_t pattern_a[32] __attribute__((aligned(32)));
     uint8_t pattern_b[32] __attribute__((aligned(32)));
@@ -358,3 +468,111 @@ bool FPU_stress_ymm_local(uint32_t iterations, uint64_t* signature_out)
 
     return ok;
 }
+
+/*
+ * Average TSC cycles of one FPU_switch_task() between two private tasks on this CPU.
+ * With avx_dirty each side writes ymm registers before switching out, so every switch
+ * saves and restores full AVX state; otherwise both stay in the init configuration.
+ * The caller state is parked in the per-CPU stress buffer and put back afterwards.
+ */
+bool FPU_bench_switch_local(uint32_t iterations, bool avx_dirty, uint64_t* cycles_out)
+{
+    if (!FPU_state.sse_enabled || (avx_dirty && !FPU_state.avx_enabled))
+        return false;
+
+    if (iterations == 0)
+        iterations = 1;
+
+    uint32_t cpu_index = FPU_cpu_slot();
+    void* saved_live = (void*) FPU_state.stress_state_a[cpu_index].bytes;
+    memset(saved_live, 0, FPU_state.state_area_size);
+    FPU_save_state(saved_live);
+
+    task_t bench_a;
+    task_t bench_b;
+    memset(&bench_a, 0, sizeof(bench_a));
+    memset(&bench_b, 0, sizeof(bench_b));
+    if (!FPU_ensure_task_state(&bench_a) || !FPU_ensure_task_state(&bench_b))
+    {
+        if (bench_a.fpu_state_alloc != 0)
+            kfree((void*) bench_a.fpu_state_alloc);
+        FPU_restore_state(saved_live);
+        return false;
+    }
+
+    uint8_t pattern_a[32] __attribute__((aligned(32)));
+    uint8_t pattern_b[32] __attribute__((aligned(32)));
+    for (uint32_t i = 0; i < sizeof(pattern_a); i++)
+    {
+        pattern_a[i] = (uint8_t) (0x21U + i);
+        pattern_b[i] = (uint8_t) (0xA5U ^ i);
+    }
+
+    if (FPU_state.initial_state_ready)
+        FPU_restore_state(FPU_state.initial_state.bytes);
+    else
+        __asm__ __volatile__("fninit");
+    FPU_switch_task(NULL, &bench_a);
+
+    uint64_t start = x86_rdtsc();
+    for (uint32_t iter = 0; iter < iterations; iter++)
+    {
+        if (avx_dirty)
+            __asm__ __volatile__("vmovdqu %0, %%ymm1" : : "m"(*(const uint8_t (*)[32]) pattern_a) : "ymm1", "memory");
+        FPU_switch_task(&bench_a, &bench_b);
+
+        if (avx_dirty)
+            __asm__ __volatile__("vmovdqu %0, %%ymm1" : : "m"(*(const uint8_t (*)[32]) pattern_b) : "ymm1", "memory");
+        FPU_switch_task(&bench_b, &bench_a);
+    }
+    uint64_t elapsed = x86_rdtsc() - start;
+
+    bool ok = true;
+    /* The last switch brought bench_a back: ymm1 must hold its pattern, not bench_b's. */
+    if (avx_dirty)
+    {
+        uint8_t out[32] __attribute__((aligned(32)));
+        __asm__ __volatile__("vmovdqu %%ymm1, %0" : "=m"(*(uint8_t (*)[32]) out) : : "memory");
+        ok = memcmp(out, pattern_a, sizeof(out)) == 0;
+    }
+
+    kfree((void*) bench_a.fpu_state_alloc);
+    kfree((void*) bench_b.fpu_state_alloc);
+
+    FPU_restore_state(saved_live);
+
+    if (cycles_out)
+        *cycles_out = elapsed / ((uint64_t) iterations * 2ULL);
+    return ok;
+}
+
+const char* FPU_get_save_mode_name(void)
+{
+    switch (FPU_state.save_mode)
+    {
+        case FPU_SAVE_MODE_XSAVEC:
+            return "xsavec";
+        case FPU_SAVE_MODE_XSAVEOPT:
+            return "xsaveopt";
+        case FPU_SAVE_MODE_XSAVE:
+            return "xsave";
+        default:
+            return "fxsave";
+    }
+}
+
+void FPU_get_switch_stats(uint32_t cpu_index, FPU_switch_stats_t* out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+    if (cpu_index >= FPU_STRESS_CPU_SLOTS)
+        return;
+
+    const FPU_switch_stats_t* stats = &FPU_state.cpu_stats[cpu_index];
+    out->saves = __atomic_load_n(&stats->saves, __ATOMIC_RELAXED);
+    out->saves_skipped = __atomic_load_n(&stats->saves_skipped, __ATOMIC_RELAXED);
+    out->restores = __atomic_load_n(&stats->restores, __ATOMIC_RELAXED);
+    out->restores_skipped = __atomic_load_n(&stats->restores_skipped, __ATOMIC_RELAXED);
+}
@@ -5,6 +5,8 @@
 #include <CPU/Syscall.h>
 #include <CPU/APIC.h>
 #include <CPU/GDT.h>
+#include <CPU/UserCopy.h>
+#include <CPU/VDSO.h>
 #include <Debug/KDebug.h>
 
 #include <stdbool.h>
@@ -192,6 +194,10 @@ void ISR_handler(interrupt_frame_t* frame)
 
         if (from_user && Syscall_handle_user_exception(frame, fault_addr))
             return;
+        if (!from_user && frame->int_no == 14 &&
+            (Syscall_handle_kernel_page_fault(fault_addr, frame->err_code) ||
+             UserCopy_fixup_fault(frame, fault_addr)))
+            return;
 
         if (frame->int_no == 14)
         {
@@ -286,7 +292,10 @@ void IRQ_handler(interrupt_frame_t *frame)
 
         uint64_t total_ticks;
         if (contributes_to_wall_clock)
+        {
             total_ticks = __atomic_add_fetch(&ISR_state.timer_ticks, 1, __ATOMIC_RELAXED);
+            VDSO_on_tick(total_ticks);
+        }
         else
             total_ticks = __atomic_load_n(&ISR_state.timer_ticks, __ATOMIC_RELAXED);
 
@@ -283,6 +283,20 @@ uint32_t NUMA_get_node_count(void)
     return NUMA_state.node_count;
 }
 
+// Dense index (0 .. node_count - 1) of a proximity domain, for per-node tables.
+uint32_t NUMA_get_node_index(uint32_t node_id)
+{
+    if (!NUMA_state.ready || NUMA_state.node_count == 0)
+        return (node_id == 0) ? 0 : NUMA_INVALID_NODE;
+
+    return NUMA_domain_to_slot(node_id, false);
+}
+
+uint32_t NUMA_get_node_id(uint32_t index)
+{
+    return NUMA_slot_to_domain(index);
+}
+
 uint32_t NUMA_get_cpu_node(uint32_t cpu_index)
 {
     if (!NUMA_state.ready || cpu_index >= NUMA_CPU_MAP_SIZE)
@@ -7,6 +7,9 @@
 #include <CPU/x86.h>
 #include <Debug/KDebug.h>
 #include <Debug/Spinlock.h>
+#include <Memory/KMem.h>
+#include <Memory/PMM.h>
+#include <Memory/Slab.h>
 #include <Memory/VMM.h>
 
 #include <string.h>
@@ -24,7 +27,7 @@ static uintptr_t SMP_read_cr3(void)
 {
     uintptr_t cr3 = 0;
     __asm__ __volatile__("mov %%cr3, %0" : "=r"(cr3));
-    return cr3;
+    return cr3 & FRAME;
 }
 
 static bool SMP_interrupts_enabled(void)
@@ -223,14 +226,27 @@ static void SMP_ipi_tlb_handler(interrupt_frame_t* frame)
 
     uint32_t cpu_id = task_get_current_cpu_index();
     SMP_cpu_local_t* cpu = SMP_cpu_local_from_cpu(cpu_id);
-    uintptr_t virt = __atomic_load_n(&SMP_state.tests.tlb_target_virt, __ATOMIC_RELAXED);
     uint8_t kind = __atomic_load_n(&SMP_state.tests.tlb_kind, __ATOMIC_ACQUIRE);
+    uintptr_t virt = __atomic_load_n(&SMP_state.tests.tlb_target_virt, __ATOMIC_RELAXED);
+    uint64_t pages = __atomic_load_n(&SMP_state.tests.tlb_target_pages, __ATOMIC_RELAXED);
     uint64_t generation = __atomic_load_n(&SMP_state.tests.tlb_generation, __ATOMIC_RELAXED);
 
     if (kind == SMP_TLB_SHOOTDOWN_PAGE)
         SMP_local_invlpg(virt);
     else if (kind == SMP_TLB_SHOOTDOWN_ALL)
         SMP_local_reload_cr3();
+    else if (kind == SMP_TLB_SHOOTDOWN_RELEASE)
+        VMM_tlb_release_address_space(cpu_id, virt);
+    else if (kind == SMP_TLB_SHOOTDOWN_RANGE)
+    {
+        if (pages > SMP_TLB_FLUSH_ALL_PAGES)
+            SMP_local_reload_cr3();
+        else
+        {
+            for (uint64_t page = 0; page < pages; page++)
+                SMP_local_invlpg(virt + (uintptr_t) (page << 12));
+        }
+    }
 
     if (cpu)
     {
@@ -937,8 +953,18 @@ static void SMP_ymm_stress_job(void* arg)
     uint64_t signature = 0;
     bool ok = FPU_stress_ymm_local(SMP_YMM_STRESS_ITERS, &signature);
 
+    uint64_t clean_cycles = 0;
+    uint64_t dirty_cycles = 0;
+    if (!FPU_bench_switch_local(SMP_YMM_BENCH_ITERS, false, &clean_cycles) ||
+        !FPU_bench_switch_local(SMP_YMM_BENCH_ITERS, true, &dirty_cycles))
+    {
+        ok = false;
+    }
+
     if (cpu_id < SMP_MAX_CPUS)
     {
+        __atomic_store_n(&SMP_state.ymm_bench_clean_cycles_cpu[cpu_id], clean_cycles, __ATOMIC_RELAXED);
+        __atomic_store_n(&SMP_state.ymm_bench_dirty_cycles_cpu[cpu_id], dirty_cycles, __ATOMIC_RELAXED);
         __atomic_store_n(&SMP_state.ymm_signature_cpu[cpu_id], signature, __ATOMIC_RELAXED);
         __atomic_store_n(&SMP_state.ymm_fail_cpu[cpu_id], ok ? 0 : 1, __ATOMIC_RELEASE);
         __atomic_store_n(&SMP_state.ymm_done_cpu[cpu_id], 1, __ATOMIC_RELEASE);
@@ -959,6 +985,8 @@ static bool SMP_run_ymm_stress_test(void)
     memset(SMP_state.ymm_done_cpu, 0, sizeof(SMP_state.ymm_done_cpu));
     memset(SMP_state.ymm_fail_cpu, 0, sizeof(SMP_state.ymm_fail_cpu));
     memset(SMP_state.ymm_signature_cpu, 0, sizeof(SMP_state.ymm_signature_cpu));
+    memset(SMP_state.ymm_bench_clean_cycles_cpu, 0, sizeof(SMP_state.ymm_bench_clean_cycles_cpu));
+    memset(SMP_state.ymm_bench_dirty_cycles_cpu, 0, sizeof(SMP_state.ymm_bench_dirty_cycles_cpu));
 
     uint8_t core_count = APIC_get_core_count();
     uint8_t cpu_targets[SMP_MAX_CPUS];
@@ -1040,11 +1068,15 @@ static bool SMP_run_ymm_stress_test(void)
 
     uint32_t failed_cpu = SMP_INVALID_CPU_ID;
     uint64_t signature_mix = 0;
+    uint64_t clean_cycles_sum = 0;
+    uint64_t dirty_cycles_sum = 0;
     for (uint32_t i = 0; i < target_count; i++)
     {
         uint8_t cpu_id = cpu_targets[i];
         uint64_t signature = __atomic_load_n(&SMP_state.ymm_signature_cpu[cpu_id], __ATOMIC_RELAXED);
         signature_mix ^= (signature + (((uint64_t) cpu_id + 1ULL) << 32));
+        clean_cycles_sum += __atomic_load_n(&SMP_state.ymm_bench_clean_cycles_cpu[cpu_id], __ATOMIC_RELAXED);
+        dirty_cycles_sum += __atomic_load_n(&SMP_state.ymm_bench_dirty_cycles_cpu[cpu_id], __ATOMIC_RELAXED);
 
         if (__atomic_load_n(&SMP_state.ymm_fail_cpu[cpu_id], __ATOMIC_ACQUIRE) != 0 && failed_cpu == SMP_INVALID_CPU_ID)
             failed_cpu = cpu_id;
@@ -1062,14 +1094,443 @@ static bool SMP_run_ymm_stress_test(void)
                   target_count,
                   SMP_YMM_STRESS_ITERS,
                   (unsigned long long) signature_mix);
+
+    FPU_switch_stats_t bsp_stats;
+    FPU_get_switch_stats(SMP_state.bsp_cpu, &bsp_stats);
+    kdebug_printf("[SMP] YMM switch bench mode=%s iters=%u clean=%llu cyc dirty=%llu cyc (avg/switch over %u cpus) bsp saves=%llu/%llu skipped restores=%llu/%llu skipped\n",
+                  FPU_get_save_mode_name(),
+                  SMP_YMM_BENCH_ITERS,
+                  (unsigned long long) (clean_cycles_sum / target_count),
+                  (unsigned long long) (dirty_cycles_sum / target_count),
+                  target_count,
+                  (unsigned long long) bsp_stats.saves,
+                  (unsigned long long) bsp_stats.saves_skipped,
+                  (unsigned long long) bsp_stats.restores,
+                  (unsigned long long) bsp_stats.restores_skipped);
     return true;
 }
 
-static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t virt)
+// Allocate, touch and free pages in small bursts, the way a page fault storm hits the PMM.
+static void SMP_page_storm_job(void* arg)
+{
+    (void) arg;
+
+    uint32_t cpu_id = task_get_current_cpu_index();
+    uintptr_t pages[SMP_PAGE_STORM_BATCH];
+    bool ok = true;
+    uint64_t start = x86_rdtsc();
+    for (uint32_t iter = 0; iter < SMP_PAGE_STORM_ITERS && ok; iter++)
+    {
+        uint32_t held = 0;
+        for (; held < SMP_PAGE_STORM_BATCH; held++)
+        {
+            pages[held] = (uintptr_t) PMM_alloc_page();
+            if (pages[held] == 0)
+            {
+                ok = false;
+                break;
+            }
+            *(volatile uint64_t*) P2V(pages[held]) = ((uint64_t) cpu_id << 32) | iter;
+        }
+
+        for (uint32_t i = 0; i < held; i++)
+        {
+            if (*(volatile uint64_t*) P2V(pages[i]) != (((uint64_t) cpu_id << 32) | iter))
+                ok = false;
+            PMM_dealloc_page((void*) pages[i]);
+        }
+    }
+    uint64_t cycles = x86_rdtsc() - start;
+
+    if (cpu_id < SMP_MAX_CPUS)
+    {
+        __atomic_store_n(&SMP_state.page_storm_cycles_cpu[cpu_id], cycles, __ATOMIC_RELAXED);
+        __atomic_store_n(&SMP_state.page_storm_fail_cpu[cpu_id], ok ? 0 : 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&SMP_state.page_storm_done_cpu[cpu_id], 1, __ATOMIC_RELEASE);
+    }
+}
+
+static bool SMP_run_page_storm_round(const uint8_t* cpu_targets, uint32_t cpu_count, bool pcp_enabled)
+{
+    memset(SMP_state.page_storm_done_cpu, 0, sizeof(SMP_state.page_storm_done_cpu));
+    memset(SMP_state.page_storm_fail_cpu, 0, sizeof(SMP_state.page_storm_fail_cpu));
+    memset(SMP_state.page_storm_cycles_cpu, 0, sizeof(SMP_state.page_storm_cycles_cpu));
+    PMM_set_pcp_enabled(pcp_enabled);
+
+    uint64_t free_before = PMM_get_free_page_count();
+    uint64_t start = x86_rdtsc();
+    for (uint32_t i = 0; i < cpu_count; i++)
+    {
+        if (!task_schedule_work_on_cpu(cpu_targets[i], SMP_page_storm_job, NULL))
+        {
+            kdebug_printf("[SMP] page storm enqueue failed cpu=%u depth_cpu=%u depth_total=%u\n",
+                          cpu_targets[i],
+                          task_runqueue_depth_cpu(cpu_targets[i]),
+                          task_runqueue_depth_total());
+            PMM_set_pcp_enabled(true);
+            return false;
+        }
+    }
+
+    uint32_t done_count = 0;
+    for (uint32_t spin = 0; spin < SMP_PAGE_STORM_TIMEOUT && done_count != cpu_count; spin++)
+    {
+        while (task_run_next_work())
+            ;
+
+        done_count = 0;
+        for (uint32_t i = 0; i < cpu_count; i++)
+        {
+            if (__atomic_load_n(&SMP_state.page_storm_done_cpu[cpu_targets[i]], __ATOMIC_ACQUIRE) != 0)
+                done_count++;
+        }
+
+        if (done_count != cpu_count)
+            __asm__ __volatile__("pause");
+    }
+    uint64_t wall_cycles = x86_rdtsc() - start;
+    PMM_set_pcp_enabled(true);
+
+    if (done_count != cpu_count)
+    {
+        kdebug_printf("[SMP] page storm timeout done=%u/%u pcp=%s depth_total=%u\n",
+                      done_count,
+                      cpu_count,
+                      pcp_enabled ? "on" : "off",
+                      task_runqueue_depth_total());
+        return false;
+    }
+
+    uint64_t job_cycles_sum = 0;
+    for (uint32_t i = 0; i < cpu_count; i++)
+    {
+        uint8_t cpu_id = cpu_targets[i];
+        job_cycles_sum += __atomic_load_n(&SMP_state.page_storm_cycles_cpu[cpu_id], __ATOMIC_RELAXED);
+        if (__atomic_load_n(&SMP_state.page_storm_fail_cpu[cpu_id], __ATOMIC_ACQUIRE) != 0)
+        {
+            kdebug_printf("[SMP] page storm FAILED cpu=%u pcp=%s\n", cpu_id, pcp_enabled ? "on" : "off");
+            return false;
+        }
+    }
+
+    // Every page went back: the free count may only differ by what sits in CPU caches.
+    uint64_t free_after = PMM_get_free_page_count();
+    if (free_after + ((uint64_t) cpu_count * PMM_PCP_CAPACITY) < free_before)
+    {
+        kdebug_printf("[SMP] page storm leaked pages before=%llu after=%llu\n",
+                      (unsigned long long) free_before,
+                      (unsigned long long) free_after);
+        return false;
+    }
+
+    uint64_t pages_per_cpu = (uint64_t) SMP_PAGE_STORM_ITERS * SMP_PAGE_STORM_BATCH;
+    uint64_t pages_total = pages_per_cpu * cpu_count;
+    kdebug_printf("[SMP] page storm cpus=%u pcp=%s pages=%llu cyc/page=%llu (per cpu) pages/Mcyc=%llu (aggregate)\n",
+                  cpu_count,
+                  pcp_enabled ? "on" : "off",
+                  (unsigned long long) pages_total,
+                  (unsigned long long) (job_cycles_sum / pages_total),
+                  (unsigned long long) (wall_cycles ? (pages_total * 1000000ULL) / wall_cycles : 0));
+    return true;
+}
+
+/*
+ * Alloc/free throughput as more cores join in: with per-CPU caches it should grow with the
+ * core count, while the last round (caches off, every page through the buddy lock) shows
+ * what the caches save.
+ */
+static bool SMP_run_page_storm_test(void)
+{
+    if (SMP_get_online_cpu_count() == 0)
+        return true;
+
+    uint8_t core_count = APIC_get_core_count();
+    uint8_t cpu_targets[SMP_MAX_CPUS];
+    uint32_t target_count = 0;
+    for (uint8_t cpu_index = 0; cpu_index < core_count; cpu_index++)
+    {
+        uint8_t apic_id = APIC_get_core_id(cpu_index);
+        if (apic_id == 0xFF || !SMP_is_apic_online(apic_id))
+            continue;
+
+        if (target_count < SMP_MAX_CPUS)
+            cpu_targets[target_count++] = cpu_index;
+    }
+
+    if (target_count == 0)
+        return true;
+
+    bool ok = true;
+    for (uint32_t cpus = 1; ok; cpus <<= 1)
+    {
+        if (cpus > target_count)
+            cpus = target_count;
+        ok = SMP_run_page_storm_round(cpu_targets, cpus, true);
+        if (cpus == target_count)
+            break;
+    }
+
+    if (ok)
+        ok = SMP_run_page_storm_round(cpu_targets, target_count, false);
+
+    PMM_stats_t stats;
+    PMM_get_stats(&stats);
+    kdebug_printf("[SMP] page storm %s pcp hits=%llu refills=%llu drains=%llu cached=%llu\n",
+                  ok ? "OK" : "FAILED",
+                  (unsigned long long) stats.pcp_hits,
+                  (unsigned long long) stats.pcp_refills,
+                  (unsigned long long) stats.pcp_drains,
+                  (unsigned long long) stats.cached_pages);
+    return ok;
+}
+
+// Allocate and first-touch a burst of zeroed pages, as a run of anonymous faults would.
+static bool SMP_zero_pool_round(uint64_t* out_cycles)
+{
+    uintptr_t pages[SMP_ZERO_POOL_TEST_PAGES];
+    uint32_t held = 0;
+    bool ok = true;
+    uint64_t start = x86_rdtsc();
+    for (; held < SMP_ZERO_POOL_TEST_PAGES; held++)
+    {
+        pages[held] = (uintptr_t) PMM_alloc_zeroed_page();
+        if (pages[held] == 0)
+        {
+            ok = false;
+            break;
+        }
+        *(volatile uint64_t*) P2V(pages[held]) = held + 1U;
+    }
+    *out_cycles = x86_rdtsc() - start;
+
+    for (uint32_t i = 0; i < held; i++)
+    {
+        const volatile uint64_t* words = (const volatile uint64_t*) P2V(pages[i]);
+        for (uint32_t w = 1; w < PHYS_PAGE_SIZE / sizeof(uint64_t); w++)
+        {
+            if (words[w] != 0)
+            {
+                ok = false;
+                break;
+            }
+        }
+        PMM_dealloc_page((void*) pages[i]);
+    }
+
+    return ok;
+}
+
+/*
+ * First-touch cost of a zeroed page with the pools filled ahead of time, then with every
+ * page cleared on the spot. Both must hand out pages that read back as zero.
+ */
+static bool SMP_run_zero_pool_test(void)
+{
+    PMM_set_zero_pool_enabled(true);
+    for (uint32_t node = 0; node < PMM_MAX_NODES; node++)
+        PMM_zero_pool_refill(node);
+
+    PMM_stats_t before;
+    PMM_get_stats(&before);
+    uint64_t pool_cycles = 0;
+    bool ok = SMP_zero_pool_round(&pool_cycles);
+
+    PMM_set_zero_pool_enabled(false);
+    uint64_t direct_cycles = 0;
+    if (ok)
+        ok = SMP_zero_pool_round(&direct_cycles);
+    PMM_set_zero_pool_enabled(true);
+
+    PMM_stats_t after;
+    PMM_get_stats(&after);
+    kdebug_printf("[SMP] zero pool %s pages=%u cyc/page pool=%llu direct=%llu hits=%llu misses=%llu\n",
+                  ok ? "OK" : "FAILED",
+                  SMP_ZERO_POOL_TEST_PAGES,
+                  (unsigned long long) (pool_cycles / SMP_ZERO_POOL_TEST_PAGES),
+                  (unsigned long long) (direct_cycles / SMP_ZERO_POOL_TEST_PAGES),
+                  (unsigned long long) (after.zero_hits - before.zero_hits),
+                  (unsigned long long) (after.zero_misses - before.zero_misses));
+    return ok;
+}
+
+static void SMP_slab_stress_ctor(void* obj)
+{
+    uint64_t* words = (uint64_t*) obj;
+    words[0] = SMP_SLAB_STRESS_PATTERN;
+    words[1] = ~SMP_SLAB_STRESS_PATTERN;
+}
+
+/*
+ * kmalloc across every size class plus a constructed cache, all CPUs at once. Objects of
+ * the constructed cache must arrive in their constructed state and are handed back in it.
+ */
+static void SMP_slab_stress_job(void* arg)
+{
+    (void) arg;
+
+    uint32_t cpu_id = task_get_current_cpu_index();
+    kmem_cache_t* cache = SMP_state.slab_test_cache;
+    uint8_t* small[SMP_SLAB_STRESS_BATCH];
+    uint64_t* constructed[SMP_SLAB_STRESS_BATCH];
+    bool ok = true;
+    uint64_t start = x86_rdtsc();
+    for (uint32_t iter = 0; iter < SMP_SLAB_STRESS_ITERS && ok; iter++)
+    {
+        for (uint32_t i = 0; i < SMP_SLAB_STRESS_BATCH; i++)
+        {
+            size_t size = (size_t) KMEM_SIZE_CLASS_MIN << ((iter + i) % KMEM_SIZE_CLASS_COUNT);
+            small[i] = (uint8_t*) kmalloc(size);
+            constructed[i] = (uint64_t*) kmem_cache_alloc(cache);
+            if (!small[i] || !constructed[i])
+            {
+                ok = false;
+                continue;
+            }
+
+            small[i][0] = (uint8_t) cpu_id;
+            small[i][size - 1U] = (uint8_t) iter;
+            if (constructed[i][0] != SMP_SLAB_STRESS_PATTERN || constructed[i][1] != ~SMP_SLAB_STRESS_PATTERN)
+                ok = false;
+            constructed[i][2] = ((uint64_t) cpu_id << 32) | iter;
+        }
+
+        for (uint32_t i = 0; i < SMP_SLAB_STRESS_BATCH; i++)
+        {
+            size_t size = (size_t) KMEM_SIZE_CLASS_MIN << ((iter + i) % KMEM_SIZE_CLASS_COUNT);
+            if (small[i] && (small[i][0] != (uint8_t) cpu_id || small[i][size - 1U] != (uint8_t) iter))
+                ok = false;
+            if (constructed[i] && constructed[i][2] != (((uint64_t) cpu_id << 32) | iter))
+                ok = false;
+            kfree(small[i]);
+            kmem_cache_free(cache, constructed[i]);
+        }
+    }
+    uint64_t cycles = x86_rdtsc() - start;
+
+    if (cpu_id < SMP_MAX_CPUS)
+    {
+        __atomic_store_n(&SMP_state.slab_cycles_cpu[cpu_id], cycles, __ATOMIC_RELAXED);
+        __atomic_store_n(&SMP_state.slab_fail_cpu[cpu_id], ok ? 0 : 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&SMP_state.slab_done_cpu[cpu_id], 1, __ATOMIC_RELEASE);
+    }
+}
+
+static bool SMP_run_slab_stress_test(void)
+{
+    if (SMP_get_online_cpu_count() == 0)
+        return true;
+
+    SMP_state.slab_test_cache = kmem_cache_create("smp-slab-test",
+                                                  SMP_SLAB_STRESS_OBJECT,
+                                                  sizeof(uint64_t),
+                                                  SMP_slab_stress_ctor,
+                                                  0);
+    if (!SMP_state.slab_test_cache)
+    {
+        kdebug_puts("[SMP] slab stress cache create failed\n");
+        return false;
+    }
+
+    memset(SMP_state.slab_done_cpu, 0, sizeof(SMP_state.slab_done_cpu));
+    memset(SMP_state.slab_fail_cpu, 0, sizeof(SMP_state.slab_fail_cpu));
+    memset(SMP_state.slab_cycles_cpu, 0, sizeof(SMP_state.slab_cycles_cpu));
+
+    uint8_t core_count = APIC_get_core_count();
+    uint8_t cpu_targets[SMP_MAX_CPUS];
+    uint32_t target_count = 0;
+    for (uint8_t cpu_index = 0; cpu_index < core_count; cpu_index++)
+    {
+        uint8_t apic_id = APIC_get_core_id(cpu_index);
+        if (apic_id == 0xFF || !SMP_is_apic_online(apic_id))
+            continue;
+
+        if (target_count < SMP_MAX_CPUS && task_schedule_work_on_cpu(cpu_index, SMP_slab_stress_job, NULL))
+            cpu_targets[target_count++] = cpu_index;
+    }
+
+    uint32_t done_count = 0;
+    for (uint32_t spin = 0; spin < SMP_SLAB_STRESS_TIMEOUT && done_count != target_count; spin++)
+    {
+        while (task_run_next_work())
+            ;
+
+        done_count = 0;
+        for (uint32_t i = 0; i < target_count; i++)
+        {
+            if (__atomic_load_n(&SMP_state.slab_done_cpu[cpu_targets[i]], __ATOMIC_ACQUIRE) != 0)
+                done_count++;
+        }
+
+        if (done_count != target_count)
+            __asm__ __volatile__("pause");
+    }
+
+    if (done_count != target_count)
+    {
+        kdebug_printf("[SMP] slab stress timeout done=%u/%u depth_total=%u\n",
+                      done_count,
+                      target_count,
+                      task_runqueue_depth_total());
+        return false; // Jobs may still run: the test cache stays alive.
+    }
+
+    bool ok = target_count != 0;
+    uint64_t cycles_sum = 0;
+    for (uint32_t i = 0; i < target_count; i++)
+    {
+        cycles_sum += __atomic_load_n(&SMP_state.slab_cycles_cpu[cpu_targets[i]], __ATOMIC_RELAXED);
+        if (__atomic_load_n(&SMP_state.slab_fail_cpu[cpu_targets[i]], __ATOMIC_ACQUIRE) != 0)
+        {
+            kdebug_printf("[SMP] slab stress FAILED cpu=%u\n", cpu_targets[i]);
+            ok = false;
+        }
+    }
+
+    kmem_cache_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    (void) kmem_cache_get_stats(SMP_state.slab_test_cache, &stats);
+    if (stats.objects_active != 0)
+    {
+        kdebug_printf("[SMP] slab stress leaked objects=%llu\n", (unsigned long long) stats.objects_active);
+        ok = false;
+    }
+    if (!kmem_cache_destroy(SMP_state.slab_test_cache))
+        ok = false;
+    SMP_state.slab_test_cache = NULL;
+
+    // Each iteration is one kmalloc/kfree pair and one cache alloc/free pair per batch slot.
+    uint64_t ops = (uint64_t) SMP_SLAB_STRESS_ITERS * SMP_SLAB_STRESS_BATCH * 2ULL * (target_count ? target_count : 1U);
+    kdebug_printf("[SMP] slab stress %s cpus=%u ops=%llu cyc/op=%llu magazine hits=%llu misses=%llu slabs_grown=%llu\n",
+                  ok ? "OK" : "FAILED",
+                  target_count,
+                  (unsigned long long) ops,
+                  (unsigned long long) (cycles_sum / ops),
+                  (unsigned long long) stats.magazine_hits,
+                  (unsigned long long) stats.magazine_misses,
+                  (unsigned long long) stats.slabs_grown);
+    return ok;
+}
+
+/*
+ * Flush virt (or the whole context) on the other CPUs and wait for their acks. With a
+ * cr3_phys only CPUs that have that address space live get the IPI; a CPU that sits idle
+ * with it loaded is left to flush before it runs user code again (see VMM_tlb_leave_lazy).
+ * cr3_phys = 0 is for kernel mappings, which every CPU shares.
+ */
+static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t cr3_phys, uintptr_t virt, uint64_t pages)
 {
     if (!APIC_is_enabled() || __atomic_load_n(&SMP_state.cpu_count, __ATOMIC_ACQUIRE) <= 1)
         return true;
 
+    SMP_tlb_stats_t* stats = &SMP_state.tests.tlb_stats;
+    __atomic_fetch_add(&stats->requests, 1, __ATOMIC_RELAXED);
+    if (kind == SMP_TLB_SHOOTDOWN_RANGE)
+    {
+        __atomic_fetch_add(&stats->pages, pages, __ATOMIC_RELAXED);
+        if (pages > SMP_TLB_FLUSH_ALL_PAGES)
+            __atomic_fetch_add(&stats->full_flushes, 1, __ATOMIC_RELAXED);
+    }
+
     uint8_t self_apic = APIC_get_current_lapic_id();
     uint8_t core_count = APIC_get_core_count();
     uint8_t cpu_targets[SMP_MAX_CPUS];
@@ -1081,6 +1542,13 @@ static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t virt)
         uint8_t apic_id = APIC_get_core_id(cpu_index);
         if (apic_id == 0xFF || apic_id == self_apic || !SMP_is_apic_online(apic_id))
             continue;
+        if (kind == SMP_TLB_SHOOTDOWN_RELEASE)
+        {
+            if (!VMM_tlb_cpu_has_loaded(cpu_index, cr3_phys))
+                continue;
+        }
+        else if (cr3_phys != 0 && !VMM_tlb_cpu_needs_flush(cpu_index, cr3_phys))
+            continue;
 
         if (target_count < SMP_MAX_CPUS)
         {
@@ -1091,7 +1559,10 @@ static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t virt)
     }
 
     if (target_count == 0)
+    {
+        __atomic_fetch_add(&stats->requests_no_ipi, 1, __ATOMIC_RELAXED);
         return true;
+    }
 
     bool ok = true;
     /*
@@ -1104,6 +1575,7 @@ static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t virt)
     uint64_t generation = __atomic_add_fetch(&SMP_state.tests.tlb_generation, 1, __ATOMIC_ACQ_REL);
 
     __atomic_store_n(&SMP_state.tests.tlb_target_virt, virt & ~(uintptr_t) 0xFFFULL, __ATOMIC_RELAXED);
+    __atomic_store_n(&SMP_state.tests.tlb_target_pages, pages, __ATOMIC_RELAXED);
     __atomic_store_n(&SMP_state.tests.tlb_kind, kind, __ATOMIC_RELEASE);
 
     for (uint32_t i = 0; i < target_count; i++)
@@ -1126,6 +1598,8 @@ static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t virt)
                 __atomic_store_n(&cpu->tlb_ack_generation, generation, __ATOMIC_RELAXED);
             ok = false;
         }
+        else
+            __atomic_fetch_add(&stats->ipis, 1, __ATOMIC_RELAXED);
     }
 
     for (uint32_t i = 0; i < target_count; i++)
@@ -1163,13 +1637,56 @@ static bool SMP_issue_tlb_shootdown(uint8_t kind, uintptr_t virt)
 bool SMP_tlb_shootdown_page(uintptr_t virt)
 {
     SMP_local_invlpg(virt);
-    return SMP_issue_tlb_shootdown(SMP_TLB_SHOOTDOWN_PAGE, virt);
+    return SMP_issue_tlb_shootdown(SMP_TLB_SHOOTDOWN_PAGE, 0, virt, 1);
 }
 
 bool SMP_tlb_shootdown_all(void)
 {
     SMP_local_reload_cr3();
-    return SMP_issue_tlb_shootdown(SMP_TLB_SHOOTDOWN_ALL, 0);
+    return SMP_issue_tlb_shootdown(SMP_TLB_SHOOTDOWN_ALL, 0, 0, 0);
+}
+
+/*
+ * Remote half of a batched flush: one IPI per target covers page_count pages from virt.
+ * The caller already flushed this CPU (the PCID-aware way, see VMM_flush_tlb_range).
+ */
+bool SMP_tlb_shootdown_range(uintptr_t cr3_phys, uintptr_t virt, size_t page_count)
+{
+    if (page_count == 0)
+        return true;
+
+    return SMP_issue_tlb_shootdown(SMP_TLB_SHOOTDOWN_RANGE, cr3_phys, virt, (uint64_t) page_count);
+}
+
+// Whole-context flush on the CPUs running cr3_phys.
+bool SMP_tlb_shootdown_address_space(uintptr_t cr3_phys)
+{
+    if (cr3_phys == 0)
+        return true;
+
+    return SMP_issue_tlb_shootdown(SMP_TLB_SHOOTDOWN_ALL, cr3_phys, 0, 0);
+}
+
+// Move the CPUs that still have cr3_phys loaded (idle ones) off it before its tables are freed.
+bool SMP_tlb_release_address_space(uintptr_t cr3_phys)
+{
+    if (cr3_phys == 0)
+        return true;
+
+    return SMP_issue_tlb_shootdown(SMP_TLB_SHOOTDOWN_RELEASE, cr3_phys, cr3_phys, 0);
+}
+
+void SMP_get_tlb_stats(SMP_tlb_stats_t* out)
+{
+    if (!out)
+        return;
+
+    const SMP_tlb_stats_t* stats = &SMP_state.tests.tlb_stats;
+    out->requests = __atomic_load_n(&stats->requests, __ATOMIC_RELAXED);
+    out->requests_no_ipi = __atomic_load_n(&stats->requests_no_ipi, __ATOMIC_RELAXED);
+    out->ipis = __atomic_load_n(&stats->ipis, __ATOMIC_RELAXED);
+    out->pages = __atomic_load_n(&stats->pages, __ATOMIC_RELAXED);
+    out->full_flushes = __atomic_load_n(&stats->full_flushes, __ATOMIC_RELAXED);
 }
 
 static bool SMP_validate_tlb_shootdown(void)
@@ -1258,6 +1775,8 @@ bool SMP_init(void)
     memset(SMP_state.ymm_done_cpu, 0, sizeof(SMP_state.ymm_done_cpu));
     memset(SMP_state.ymm_fail_cpu, 0, sizeof(SMP_state.ymm_fail_cpu));
     memset(SMP_state.ymm_signature_cpu, 0, sizeof(SMP_state.ymm_signature_cpu));
+    memset(SMP_state.ymm_bench_clean_cycles_cpu, 0, sizeof(SMP_state.ymm_bench_clean_cycles_cpu));
+    memset(SMP_state.ymm_bench_dirty_cycles_cpu, 0, sizeof(SMP_state.ymm_bench_dirty_cycles_cpu));
     __atomic_store_n(&SMP_state.sched_patho_short_done, 0, __ATOMIC_RELAXED);
     __atomic_store_n(&SMP_state.sched_patho_long_done, 0, __ATOMIC_RELAXED);
     spinlock_init(&SMP_state.tests.counter_lock);
@@ -1363,6 +1882,21 @@ bool SMP_init(void)
         kdebug_puts("[SMP] YMM stress test reported failures\n");
 #endif
 
+#if SMP_PAGE_STORM_ENABLE
+    if (!SMP_run_page_storm_test())
+        kdebug_puts("[SMP] page storm test reported failures\n");
+#endif
+
+#if SMP_ZERO_POOL_TEST_ENABLE
+    if (!SMP_run_zero_pool_test())
+        kdebug_puts("[SMP] zero pool test reported failures\n");
+#endif
+
+#if SMP_SLAB_STRESS_ENABLE
+    if (!SMP_run_slab_stress_test())
+        kdebug_puts("[SMP] slab stress test reported failures\n");
+#endif
+
 #if SMP_TLB_TEST_ENABLE
     if (!SMP_validate_tlb_shootdown())
         kdebug_puts("[SMP] TLB shootdown validation failed\n");
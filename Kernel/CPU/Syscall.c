@@ -6,6 +6,9 @@
 #include <CPU/ISR.h>
 #include <CPU/MSR.h>
 #include <CPU/SMP.h>
+#include <CPU/UserCopy.h>
+#include <CPU/VDSO.h>
+#include <CPU/x86.h>
 #include <Device/HPET.h>
 #include <Device/Keyboard.h>
 #include <Device/Mouse.h>
@@ -18,11 +21,13 @@
 #include <Memory/KMem.h>
 #include <Memory/PMM.h>
 #include <Memory/VMM.h>
+#include <Memory/ZSwap.h>
 #include <Network/ARP.h>
 #include <Network/Socket.h>
 #include <Network/TCP.h>
 #include <Network/Unix.h>
 #include <Storage/AHCI.h>
+#include <Storage/BCache.h>
 #include <Storage/VFS.h>
 #include <Task/RCU.h>
 #include <Task/Task.h>
@@ -34,6 +39,13 @@
 #include <stdio.h>
 #include <string.h>
 
+_Static_assert(SYSCALL_NR_MAX <= SYS_SYSCALL_STATS_MAX,
+               "Syscall stats layout mismatch: the dispatch table must fit the UAPI counter array");
+_Static_assert(SYS_MEM_ORDER_COUNT == PMM_ORDER_COUNT,
+               "Memory info layout mismatch: UAPI and PMM disagree on the buddy order count");
+_Static_assert(SYS_MEM_MAX_NODES == PMM_MAX_NODES,
+               "Memory info layout mismatch: UAPI and PMM disagree on the NUMA node count");
+
 static syscall_runtime_state_t Syscall_state = {
     .user_map_hint = SYSCALL_MAP_HINT_BASE,
     .next_pid = 1U
@@ -48,20 +60,13 @@ static uint64_t Syscall_debug_preempt_no_flag = 0;
 static uint64_t Syscall_debug_preempt_no_current = 0;
 static uint64_t Syscall_debug_preempt_same_slot = 0;
 static uint64_t Syscall_debug_preempt_invalid_next = 0;
-static uint64_t Syscall_debug_post_calls = 0;
 static uint64_t Syscall_debug_post_pick_next = 0;
 static uint64_t Syscall_debug_post_switch = 0;
 static uint64_t Syscall_debug_need_resched_set_cpu[4] = { 0, 0, 0, 0 };
 static uint64_t Syscall_debug_preempt_attempt_cpu[4] = { 0, 0, 0, 0 };
 static uint64_t Syscall_debug_preempt_success_cpu[4] = { 0, 0, 0, 0 };
 static uint64_t Syscall_debug_preempt_no_flag_cpu[4] = { 0, 0, 0, 0 };
-static uint64_t Syscall_debug_irq_calls_cpu[4] = { 0, 0, 0, 0 };
-static uint64_t Syscall_debug_post_calls_cpu[4] = { 0, 0, 0, 0 };
 static uint64_t Syscall_debug_post_switch_cpu[4] = { 0, 0, 0, 0 };
-static uint64_t Syscall_debug_nr_read = 0;
-static uint64_t Syscall_debug_nr_write = 0;
-static uint64_t Syscall_debug_nr_sleep = 0;
-static uint64_t Syscall_debug_nr_other = 0;
 static uint64_t Syscall_debug_flag_consume_timer_cpu[4] = { 0, 0, 0, 0 };
 static uint64_t Syscall_debug_flag_consume_post_cpu[4] = { 0, 0, 0, 0 };
 static uint64_t Syscall_debug_flag_set_sleep_cpu[4] = { 0, 0, 0, 0 };
@@ -71,55 +76,11 @@ static uint64_t Syscall_debug_idle_dispatch_rejected_running = 0;
 static uint64_t Syscall_debug_idle_dispatch_rejected_empty = 0;
 static uint64_t Syscall_debug_idle_dispatch_attempt_cpu[4] = { 0, 0, 0, 0 };
 static uint64_t Syscall_debug_idle_dispatch_success_cpu[4] = { 0, 0, 0, 0 };
-static uint8_t Syscall_idle_claimed_slots[SYSCALL_MAX_PROCS] = { 0 };
-
-static bool Syscall_is_leap_year(uint32_t year)
-{
-    if ((year % 4U) != 0U)
-        return false;
-    if ((year % 100U) != 0U)
-        return true;
-    return (year % 400U) == 0U;
-}
-
-static uint32_t Syscall_days_in_month(uint32_t year, uint32_t month_1_to_12)
-{
-    static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
-    if (month_1_to_12 == 2U)
-        return days[1] + (Syscall_is_leap_year(year) ? 1U : 0U);
-    if (month_1_to_12 < 1U || month_1_to_12 > 12U)
-        return 31U;
-    return days[month_1_to_12 - 1U];
-}
-
-static uint64_t Syscall_rtc_epoch_seconds(void)
-{
-    RTC_t rtc;
-    RTC_read(&rtc);
-    uint32_t year = (uint32_t) rtc.year;
-    uint32_t month = (uint32_t) rtc.month;
-    uint32_t day = (uint32_t) rtc.month_day;
-    uint32_t hour = (uint32_t) rtc.hours;
-    uint32_t minute = (uint32_t) rtc.minutes;
-    uint32_t second = (uint32_t) rtc.seconds;
-
-    if (year < 1970U || month < 1U || month > 12U || day < 1U || day > 31U ||
-        hour > 23U || minute > 59U || second > 59U)
-        return 0ULL;
-
-    uint64_t days = 0ULL;
-    for (uint32_t y = 1970U; y < year; y++)
-        days += Syscall_is_leap_year(y) ? 366ULL : 365ULL;
-    for (uint32_t m = 1U; m < month; m++)
-        days += (uint64_t) Syscall_days_in_month(year, m);
-    if (day > Syscall_days_in_month(year, month))
-        return 0ULL;
-    days += (uint64_t) (day - 1U);
-
-    return days * 86400ULL + (uint64_t) hour * 3600ULL + (uint64_t) minute * 60ULL + (uint64_t) second;
-}
+static uint64_t Syscall_debug_block_count = 0;
+static uint64_t Syscall_debug_unblock_count = 0;
 
 __attribute__((__noreturn__)) void Syscall_resume_user_context(const syscall_user_resume_context_t* ctx);
+void Syscall_kernel_context_switch(uintptr_t* save_rsp, uintptr_t next_rsp);
 
 #define SYSCALL_KBD_INJECT_QUEUE_CAP 256U
 typedef struct syscall_kbd_inject_entry
@@ -313,113 +274,157 @@ static bool Syscall_mmap_window_in_bounds(uintptr_t base, size_t size)
     return true;
 }
 
-static bool Syscall_copy_to_user(void* user_dst, const void* kernel_src, size_t size)
+static spinlock_t* Syscall_vm_lock(uintptr_t cr3_phys)
 {
-    if (size == 0)
-        return true;
-    if (!user_dst || !kernel_src)
+    uint32_t frame = (uint32_t) (cr3_phys >> 12);
+    return &Syscall_state.vm_locks[(frame * 2654435761U) & (SYSCALL_VM_LOCK_BUCKETS - 1U)];
+}
+
+/*
+ * Slow path of a user write, for the page that stopped the direct copy: populate a lazy
+ * page, break COW, then copy under the address space lock.
+ */
+static bool Syscall_copy_to_user_page(uintptr_t user_addr, const void* kernel_src, size_t chunk)
+{
+    if (!Syscall_state.vm_lock_ready)
         return false;
-    if (!Syscall_user_range_in_bounds((uintptr_t) user_dst, size))
+
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    spinlock_t* vm_lock = Syscall_vm_lock(current_cr3);
+    uintptr_t page = user_addr & ~(uintptr_t) (SYSCALL_PAGE_SIZE - 1U);
+    spin_lock(vm_lock);
+    if (!VMM_is_user_accessible(page) && !Syscall_lazy_populate_locked(current_cr3, page))
+    {
+        spin_unlock(vm_lock);
         return false;
+    }
 
-    if (Syscall_state.vm_lock_ready)
-        spin_lock(&Syscall_state.vm_lock);
+    uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, page);
+    if (!pte)
+        pte = Syscall_get_user_huge_pde_ptr(current_cr3, page);    // Never COW: fork splits them.
+    if (!pte)
+    {
+        spin_unlock(vm_lock);
+        return false;
+    }
 
-    size_t copied = 0;
-    while (copied < size)
+    uintptr_t entry = *pte;
+    bool pte_updated = false;
+    if ((entry & SYSCALL_PTE_COW) != 0)
     {
-        uintptr_t user_addr = (uintptr_t) user_dst + copied;
-        uintptr_t page = user_addr & ~(uintptr_t) (SYSCALL_PAGE_SIZE - 1U);
-        if (!VMM_is_user_accessible(page))
+        uintptr_t old_phys = entry & FRAME;
+        if (old_phys == 0)
         {
-            if (Syscall_state.vm_lock_ready)
-                spin_unlock(&Syscall_state.vm_lock);
+            spin_unlock(vm_lock);
             return false;
         }
 
-        uintptr_t current_cr3 = Syscall_read_cr3_phys();
-        uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, page);
-        if (!pte)
+        uint32_t refs = Syscall_cow_ref_get(old_phys);
+        if (refs <= 1U)
         {
-            if (Syscall_state.vm_lock_ready)
-                spin_unlock(&Syscall_state.vm_lock);
-            return false;
+            bool dummy_zero = false;
+            (void) Syscall_cow_ref_sub(old_phys, &dummy_zero);
+            entry &= ~SYSCALL_PTE_COW;
+            entry |= WRITABLE;
+            *pte = entry;
+            pte_updated = true;
         }
-
-        uintptr_t entry = *pte;
-        bool pte_updated = false;
-        if ((entry & SYSCALL_PTE_COW) != 0)
+        else
         {
-            uintptr_t old_phys = entry & FRAME;
-            if (old_phys == 0)
+            uintptr_t new_phys = (uintptr_t) PMM_alloc_page();
+            if (new_phys == 0)
             {
-                if (Syscall_state.vm_lock_ready)
-                    spin_unlock(&Syscall_state.vm_lock);
+                spin_unlock(vm_lock);
                 return false;
             }
 
-            uint32_t refs = Syscall_cow_ref_get(old_phys);
-            if (refs <= 1U)
-            {
-                bool dummy_zero = false;
-                (void) Syscall_cow_ref_sub(old_phys, &dummy_zero);
-                entry &= ~SYSCALL_PTE_COW;
-                entry |= WRITABLE;
-                *pte = entry;
-                pte_updated = true;
-            }
-            else
-            {
-                uintptr_t new_phys = (uintptr_t) PMM_alloc_page();
-                if (new_phys == 0)
-                {
-                    if (Syscall_state.vm_lock_ready)
-                        spin_unlock(&Syscall_state.vm_lock);
-                    return false;
-                }
+            memcpy((void*) P2V(new_phys), (const void*) P2V(old_phys), SYSCALL_PAGE_SIZE);
+            entry &= ~FRAME;
+            entry |= new_phys;
+            entry &= ~SYSCALL_PTE_COW;
+            entry |= WRITABLE;
+            *pte = entry;
+            pte_updated = true;
 
-                memcpy((void*) P2V(new_phys), (const void*) P2V(old_phys), SYSCALL_PAGE_SIZE);
-                entry &= ~FRAME;
-                entry |= new_phys;
-                entry &= ~SYSCALL_PTE_COW;
-                entry |= WRITABLE;
-                *pte = entry;
-                pte_updated = true;
+            bool ref_zero = false;
+            if (Syscall_cow_ref_sub(old_phys, &ref_zero) && ref_zero)
+                PMM_dealloc_page((void*) old_phys);
+        }
 
-                bool ref_zero = false;
-                if (Syscall_cow_ref_sub(old_phys, &ref_zero) && ref_zero)
-                    PMM_dealloc_page((void*) old_phys);
-            }
+        /* We are about to write into the same user page. Make the new PTE
+         * visible immediately to avoid writing through a stale read-only TLB entry. */
+        if (pte_updated)
+            VMM_flush_address_space(current_cr3);
 
-            /* We are about to write into the same user page. Make the new PTE
-             * visible immediately to avoid writing through a stale read-only TLB entry. */
-            if (pte_updated)
-                Syscall_write_cr3_phys(current_cr3);
+        entry = *pte;
+    }
 
-            entry = *pte;
-        }
+    if ((entry & WRITABLE) == 0)
+    {
+        spin_unlock(vm_lock);
+        return false;
+    }
 
-        if ((entry & WRITABLE) == 0)
-        {
-            if (Syscall_state.vm_lock_ready)
-                spin_unlock(&Syscall_state.vm_lock);
-            return false;
-        }
+    memcpy((void*) user_addr, kernel_src, chunk);
+    spin_unlock(vm_lock);
+    return true;
+}
 
-        size_t page_remaining = SYSCALL_PAGE_SIZE - (size_t) (user_addr & (SYSCALL_PAGE_SIZE - 1U));
-        size_t chunk = size - copied;
-        if (chunk > page_remaining)
-            chunk = page_remaining;
+static bool Syscall_copy_from_user_page(void* kernel_dst, uintptr_t user_addr, size_t chunk)
+{
+    if (!Syscall_state.vm_lock_ready)
+        return false;
 
-        memcpy((void*) user_addr, (const uint8_t*) kernel_src + copied, chunk);
-        copied += chunk;
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    spinlock_t* vm_lock = Syscall_vm_lock(current_cr3);
+    uintptr_t page = user_addr & ~(uintptr_t) (SYSCALL_PAGE_SIZE - 1U);
+    spin_lock(vm_lock);
+    if (!VMM_is_user_accessible(page) && !Syscall_lazy_populate_locked(current_cr3, page))
+    {
+        spin_unlock(vm_lock);
+        return false;
     }
 
-    if (Syscall_state.vm_lock_ready)
-        spin_unlock(&Syscall_state.vm_lock);
+    memcpy(kernel_dst, (const void*) user_addr, chunk);
+    spin_unlock(vm_lock);
     return true;
 }
 
+/*
+ * User copies go straight through the live page tables, with no lock: bulk read/write/ioctl
+ * buffers of different processes no longer serialize. A fault (lazy page, COW, no mapping)
+ * stops the copy; only the page that stopped it is resolved under the lock, then the direct
+ * copy resumes.
+ */
+static bool Syscall_copy_to_user(void* user_dst, const void* kernel_src, size_t size)
+{
+    if (size == 0)
+        return true;
+    if (!user_dst || !kernel_src)
+        return false;
+    if (!Syscall_user_range_in_bounds((uintptr_t) user_dst, size))
+        return false;
+
+    size_t copied = 0;
+    for (;;)
+    {
+        size_t left = UserCopy_copy((uint8_t*) user_dst + copied, (const uint8_t*) kernel_src + copied, size - copied);
+        copied = size - left;
+        if (left == 0)
+            return true;
+
+        uintptr_t user_addr = (uintptr_t) user_dst + copied;
+        size_t chunk = SYSCALL_PAGE_SIZE - (size_t) (user_addr & (SYSCALL_PAGE_SIZE - 1U));
+        if (chunk > left)
+            chunk = left;
+
+        __atomic_add_fetch(&Syscall_state.usercopy_slow, 1U, __ATOMIC_RELAXED);
+        if (!Syscall_copy_to_user_page(user_addr, (const uint8_t*) kernel_src + copied, chunk))
+            return false;
+        copied += chunk;
+    }
+}
+
 static bool Syscall_copy_from_user(void* kernel_dst, const void* user_src, size_t size)
 {
     if (size == 0)
@@ -429,33 +434,24 @@ static bool Syscall_copy_from_user(void* kernel_dst, const void* user_src, size_
     if (!Syscall_user_range_in_bounds((uintptr_t) user_src, size))
         return false;
 
-    if (Syscall_state.vm_lock_ready)
-        spin_lock(&Syscall_state.vm_lock);
-
     size_t copied = 0;
-    while (copied < size)
+    for (;;)
     {
-        uintptr_t user_addr = (uintptr_t) user_src + copied;
-        uintptr_t page = user_addr & ~(uintptr_t) (SYSCALL_PAGE_SIZE - 1U);
-        if (!VMM_is_user_accessible(page))
-        {
-            if (Syscall_state.vm_lock_ready)
-                spin_unlock(&Syscall_state.vm_lock);
-            return false;
-        }
+        size_t left = UserCopy_copy((uint8_t*) kernel_dst + copied, (const uint8_t*) user_src + copied, size - copied);
+        copied = size - left;
+        if (left == 0)
+            return true;
 
-        size_t page_remaining = SYSCALL_PAGE_SIZE - (size_t) (user_addr & (SYSCALL_PAGE_SIZE - 1U));
-        size_t chunk = size - copied;
-        if (chunk > page_remaining)
-            chunk = page_remaining;
+        uintptr_t user_addr = (uintptr_t) user_src + copied;
+        size_t chunk = SYSCALL_PAGE_SIZE - (size_t) (user_addr & (SYSCALL_PAGE_SIZE - 1U));
+        if (chunk > left)
+            chunk = left;
 
-        memcpy((uint8_t*) kernel_dst + copied, (const void*) user_addr, chunk);
+        __atomic_add_fetch(&Syscall_state.usercopy_slow, 1U, __ATOMIC_RELAXED);
+        if (!Syscall_copy_from_user_page((uint8_t*) kernel_dst + copied, user_addr, chunk))
+            return false;
         copied += chunk;
     }
-
-    if (Syscall_state.vm_lock_ready)
-        spin_unlock(&Syscall_state.vm_lock);
-    return true;
 }
 
 static bool Syscall_copy_in_sockaddr_in(const void* user_addr, size_t user_len, uint32_t* out_addr_be, uint16_t* out_port)
@@ -504,39 +500,34 @@ static bool Syscall_read_user_cstr(char* kernel_dst, size_t kernel_dst_size, con
     if (!kernel_dst || kernel_dst_size < 2 || !user_src)
         return false;
 
-    if (Syscall_state.vm_lock_ready)
-        spin_lock(&Syscall_state.vm_lock);
-
-    for (size_t i = 0; i < kernel_dst_size - 1; i++)
+    size_t copied = 0;
+    while (copied < kernel_dst_size - 1)
     {
-        uintptr_t user_addr = (uintptr_t) (user_src + i);
+        uintptr_t user_addr = (uintptr_t) user_src + copied;
         if (!Syscall_user_range_in_bounds(user_addr, 1))
-        {
-            if (Syscall_state.vm_lock_ready)
-                spin_unlock(&Syscall_state.vm_lock);
             return false;
-        }
 
-        uintptr_t page = user_addr & ~(uintptr_t) (SYSCALL_PAGE_SIZE - 1U);
-        if (!VMM_is_user_accessible(page))
+        size_t chunk = SYSCALL_PAGE_SIZE - (size_t) (user_addr & (SYSCALL_PAGE_SIZE - 1U));
+        if (chunk > kernel_dst_size - 1 - copied)
+            chunk = kernel_dst_size - 1 - copied;
+
+        // A page never touched yet faults: back it under the lock and read it once more.
+        int64_t len = UserCopy_strncpy(kernel_dst + copied, (const char*) user_addr, chunk);
+        if (len < 0)
         {
-            if (Syscall_state.vm_lock_ready)
-                spin_unlock(&Syscall_state.vm_lock);
-            return false;
+            __atomic_add_fetch(&Syscall_state.usercopy_slow, 1U, __ATOMIC_RELAXED);
+            if (!Syscall_lazy_populate_range(user_addr, 1))
+                return false;
+            len = UserCopy_strncpy(kernel_dst + copied, (const char*) user_addr, chunk);
+            if (len < 0)
+                return false;
         }
 
-        char c = user_src[i];
-        kernel_dst[i] = c;
-        if (c == '\0')
-        {
-            if (Syscall_state.vm_lock_ready)
-                spin_unlock(&Syscall_state.vm_lock);
+        if ((size_t) len < chunk)
             return true;
-        }
+        copied += chunk;
     }
 
-    if (Syscall_state.vm_lock_ready)
-        spin_unlock(&Syscall_state.vm_lock);
     kernel_dst[kernel_dst_size - 1] = '\0';
     return false;
 }
@@ -739,11 +730,12 @@ static bool Syscall_user_range_unmapped(uintptr_t base, size_t size)
     if (!Syscall_user_range_in_bounds(base, size))
         return false;
 
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
     uintptr_t end = base + (uintptr_t) size;
     for (uintptr_t page = base; page < end; page += SYSCALL_PAGE_SIZE)
     {
         uintptr_t phys = 0;
-        if (VMM_virt_to_phys(page, &phys))
+        if (VMM_virt_to_phys(page, &phys) || Syscall_user_page_is_lazy(current_cr3, page))
             return false;
     }
 
@@ -2170,30 +2162,7 @@ static uint64_t Syscall_handle_close(uint32_t cpu_index, const syscall_frame_t*
         bool was_writer = entry->can_write;
         memset(entry, 0, sizeof(*entry));
         spin_unlock(&Syscall_state.fd_lock);
-
-        if (pipe_id < SYSCALL_PIPE_MAX)
-        {
-            syscall_pipe_t* p = &Syscall_state.pipes[pipe_id];
-            if (p->used && p->lock_ready)
-            {
-                spin_lock(&p->lock);
-                if (was_reader && p->readers > 0)
-                    p->readers--;
-                if (was_writer && p->writers > 0)
-                    p->writers--;
-                task_wait_queue_wake_all(&p->read_waitq);
-                task_wait_queue_wake_all(&p->write_waitq);
-                if (p->readers == 0 && p->writers == 0)
-                {
-                    spin_unlock(&p->lock);
-                    spin_lock(&Syscall_state.pipe_lock);
-                    p->used = false;
-                    spin_unlock(&Syscall_state.pipe_lock);
-                }
-                else
-                    spin_unlock(&p->lock);
-            }
-        }
+        Syscall_pipe_close_end(pipe_id, was_reader, was_writer);
         return 0;
     }
 
@@ -2384,44 +2353,12 @@ static uint64_t Syscall_handle_read(uint32_t cpu_index, const syscall_frame_t* f
         uint32_t pipe_id = entry->net_socket_id;
         spin_unlock(&Syscall_state.fd_lock);
 
-        if (pipe_id >= SYSCALL_PIPE_MAX)
-            return (uint64_t) -1;
-        syscall_pipe_t* p = &Syscall_state.pipes[pipe_id];
-        if (!p->used || !p->lock_ready)
-            return (uint64_t) -1;
-
-        spin_lock(&p->lock);
-        if (p->count == 0 && p->writers > 0)
-        {
-            spin_unlock(&p->lock);
-            task_waiter_t waiter;
-            task_waiter_init(&waiter);
-            task_wait_queue_wait_event(&p->read_waitq, &waiter,
-                                       Syscall_pipe_rx_empty, p,
-                                       TASK_WAIT_TIMEOUT_INFINITE);
-            spin_lock(&p->lock);
-        }
-
-        if (p->count == 0)
-        {
-            spin_unlock(&p->lock);
-            return 0;
-        }
-
-        size_t to_read = p->count < len ? p->count : len;
-        uint8_t pipe_buf[SYSCALL_PIPE_BUF_SIZE];
-        for (size_t i = 0; i < to_read; i++)
-        {
-            pipe_buf[i] = p->ring[p->head];
-            p->head = (uint16_t) ((p->head + 1U) % SYSCALL_PIPE_BUF_SIZE);
-        }
-        __atomic_store_n(&p->count, p->count - (uint32_t) to_read, __ATOMIC_RELEASE);
-        task_wait_queue_wake_all(&p->write_waitq);
-        spin_unlock(&p->lock);
-
-        if (!Syscall_copy_to_user(user_buf, pipe_buf, to_read))
+        syscall_pipe_t* p = Syscall_pipe_get(pipe_id);
+        if (!p)
             return (uint64_t) -1;
-        return (uint64_t) to_read;
+        uint64_t ret = Syscall_pipe_read(p, user_buf, len);
+        Syscall_pipe_put(p);
+        return ret;
     }
 
     if (entry_type != SYSCALL_FD_TYPE_REGULAR)
@@ -2617,51 +2554,12 @@ static uint64_t Syscall_handle_write(uint32_t cpu_index, const syscall_frame_t*
         uint32_t pipe_id = entry->net_socket_id;
         spin_unlock(&Syscall_state.fd_lock);
 
-        if (pipe_id >= SYSCALL_PIPE_MAX)
-            return (uint64_t) -1;
-        syscall_pipe_t* p = &Syscall_state.pipes[pipe_id];
-        if (!p->used || !p->lock_ready)
-            return (uint64_t) -1;
-
-        uint8_t pipe_buf[SYSCALL_PIPE_BUF_SIZE];
-        size_t to_write = len < SYSCALL_PIPE_BUF_SIZE ? len : SYSCALL_PIPE_BUF_SIZE;
-        if (!Syscall_copy_from_user(pipe_buf, user_buf, to_write))
+        syscall_pipe_t* p = Syscall_pipe_get(pipe_id);
+        if (!p)
             return (uint64_t) -1;
-
-        spin_lock(&p->lock);
-        if (p->readers == 0)
-        {
-            spin_unlock(&p->lock);
-            return (uint64_t) -1;
-        }
-
-        if (p->count >= SYSCALL_PIPE_BUF_SIZE)
-        {
-            spin_unlock(&p->lock);
-            task_waiter_t waiter;
-            task_waiter_init(&waiter);
-            task_wait_queue_wait_event(&p->write_waitq, &waiter,
-                                       Syscall_pipe_tx_full, p,
-                                       TASK_WAIT_TIMEOUT_INFINITE);
-            spin_lock(&p->lock);
-            if (p->readers == 0)
-            {
-                spin_unlock(&p->lock);
-                return (uint64_t) -1;
-            }
-        }
-
-        uint32_t avail = SYSCALL_PIPE_BUF_SIZE - p->count;
-        size_t actual = to_write < avail ? to_write : avail;
-        for (size_t i = 0; i < actual; i++)
-        {
-            p->ring[p->tail] = pipe_buf[i];
-            p->tail = (uint16_t) ((p->tail + 1U) % SYSCALL_PIPE_BUF_SIZE);
-        }
-        __atomic_store_n(&p->count, p->count + (uint32_t) actual, __ATOMIC_RELEASE);
-        task_wait_queue_wake_all(&p->read_waitq);
-        spin_unlock(&p->lock);
-        return (uint64_t) actual;
+        uint64_t ret = Syscall_pipe_write(p, user_buf, len);
+        Syscall_pipe_put(p);
+        return ret;
     }
 
     if (entry_type != SYSCALL_FD_TYPE_REGULAR)
@@ -3404,9 +3302,10 @@ static inline uintptr_t Syscall_read_cr3_phys(void)
     return cr3 & FRAME;
 }
 
+// Address-space switch: keeps the TLB entries of cr3_phys when its PCID tag is still valid.
 static inline void Syscall_write_cr3_phys(uintptr_t cr3_phys)
 {
-    __asm__ __volatile__("mov %0, %%cr3" : : "r"(cr3_phys) : "memory");
+    VMM_switch_cr3(task_get_current_cpu_index(), cr3_phys);
 }
 
 static inline uintptr_t Syscall_read_fs_base(void)
@@ -3421,12 +3320,7 @@ static inline void Syscall_write_fs_base(uintptr_t fs_base)
 
 static uintptr_t Syscall_alloc_zero_page_phys(void)
 {
-    uintptr_t phys = (uintptr_t) PMM_alloc_page();
-    if (phys == 0)
-        return 0;
-
-    memset((void*) P2V(phys), 0, SYSCALL_PAGE_SIZE);
-    return phys;
+    return (uintptr_t) PMM_alloc_zeroed_page();
 }
 
 static bool Syscall_is_canonical_low(uint64_t value)
@@ -3444,104 +3338,244 @@ static bool Syscall_user_fs_base_is_valid(uintptr_t fs_base)
            fs_base <= SYSCALL_USER_VADDR_MAX;
 }
 
-static int32_t Syscall_cow_ref_find_locked(uintptr_t phys)
+// COW sharing lives in the frame's PMM descriptor: one reference per PTE mapping it.
+static bool Syscall_cow_ref_add(uintptr_t phys, uint32_t delta)
+{
+    if (phys == 0 || delta == 0)
+        return false;
+
+    return PMM_page_ref_add(phys, delta, PMM_PAGE_F_COW);
+}
+
+static bool Syscall_cow_ref_sub(uintptr_t phys, bool* out_zero)
+{
+    if (out_zero)
+        *out_zero = false;
+    if (phys == 0)
+        return false;
+
+    return PMM_page_ref_sub(phys, out_zero);
+}
+
+static uint32_t Syscall_cow_ref_get(uintptr_t phys)
+{
+    if (phys == 0)
+        return 0;
+
+    return PMM_page_ref_get(phys);
+}
+
+static bool Syscall_page_is_shm(uintptr_t phys)
+{
+    const PMM_page_t* page = PMM_page_get(phys);
+    return page && (__atomic_load_n(&page->flags, __ATOMIC_ACQUIRE) & PMM_PAGE_F_SHM) != 0;
+}
+
+// A user PTE to a segment frame goes away: the frame is freed with its last reference.
+static void Syscall_shm_page_unmapped(uintptr_t phys)
+{
+    PMM_page_t* page = PMM_page_get(phys);
+    if (!page)
+        return;
+
+    if (__atomic_load_n(&page->mapcount, __ATOMIC_RELAXED) != 0)
+        __atomic_sub_fetch(&page->mapcount, 1U, __ATOMIC_RELAXED);
+
+    bool ref_zero = false;
+    if (PMM_page_ref_sub(phys, &ref_zero) && ref_zero)
+        PMM_dealloc_page((void*) phys);
+}
+
+static uint32_t Syscall_mm_hash(uintptr_t cr3_phys)
+{
+    uint32_t frame = (uint32_t) (cr3_phys >> 12);
+    return (frame * 2654435761U) & (SYSCALL_MM_BUCKETS - 1U);
+}
+
+// The accounting of an address space, or NULL for the kernel's own and the legacy loader's.
+static syscall_mm_t* Syscall_mm_get(uintptr_t cr3_phys)
 {
-    for (uint32_t i = 0; i < SYSCALL_COW_MAX_REFS; i++)
+    if (cr3_phys == 0)
+        return NULL;
+
+    uint32_t index = Syscall_mm_hash(cr3_phys);
+    for (uint32_t probe = 0; probe < SYSCALL_MM_BUCKETS; probe++)
     {
-        if (Syscall_state.cow_refs[i].used && Syscall_state.cow_refs[i].phys == phys)
-            return (int32_t) i;
+        syscall_mm_t* mm = &Syscall_state.mms[(index + probe) & (SYSCALL_MM_BUCKETS - 1U)];
+        uintptr_t key = __atomic_load_n(&mm->cr3_phys, __ATOMIC_ACQUIRE);
+        if (key == cr3_phys)
+            return mm;
+        if (key == SYSCALL_MM_EMPTY)
+            return NULL;
     }
-    return -1;
+
+    return NULL;
 }
 
-static int32_t Syscall_cow_ref_alloc_locked(void)
+/*
+ * A new address space starts with nothing charged and the limits of the one it is built
+ * from: the parent's on fork, the old image's on exec. The first one gets no limits.
+ */
+static bool Syscall_mm_create(uintptr_t cr3_phys, uintptr_t parent_cr3_phys)
 {
-    for (uint32_t i = 0; i < SYSCALL_COW_MAX_REFS; i++)
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.mm_lock);
+    syscall_rlimit_t limit_as = { SYS_RLIM_INFINITY, SYS_RLIM_INFINITY };
+    syscall_rlimit_t limit_rss = limit_as;
+    const syscall_mm_t* parent = Syscall_mm_get(parent_cr3_phys);
+    if (parent)
     {
-        if (!Syscall_state.cow_refs[i].used)
-            return (int32_t) i;
+        limit_as = parent->limit_as;
+        limit_rss = parent->limit_rss;
     }
-    return -1;
+
+    syscall_mm_t* mm = NULL;
+    uint32_t index = Syscall_mm_hash(cr3_phys);
+    for (uint32_t probe = 0; probe < SYSCALL_MM_BUCKETS && !mm; probe++)
+    {
+        syscall_mm_t* candidate = &Syscall_state.mms[(index + probe) & (SYSCALL_MM_BUCKETS - 1U)];
+        if (candidate->cr3_phys == SYSCALL_MM_EMPTY || candidate->cr3_phys == SYSCALL_MM_DEAD)
+            mm = candidate;
+    }
+
+    if (mm)
+    {
+        mm->vm_pages = 0;
+        mm->anon_pages = 0;
+        mm->file_pages = 0;
+        mm->shared_pages = 0;
+        mm->pt_pages = 0;
+        mm->swap_pages = 0;
+        mm->serial = ++Syscall_state.mm_serial;
+        mm->swap_cursor = SYSCALL_USER_VADDR_MIN;
+        mm->thp_cursor = SYSCALL_MAP_HINT_BASE;
+        mm->thp_queued = 0;
+        mm->limit_as = limit_as;
+        mm->limit_rss = limit_rss;
+        __atomic_store_n(&mm->cr3_phys, cr3_phys, __ATOMIC_RELEASE);
+    }
+    spin_unlock_irqrestore(&Syscall_state.mm_lock, lock_flags);
+    return mm != NULL;
 }
 
-static bool Syscall_cow_ref_add(uintptr_t phys, uint32_t delta)
+static void Syscall_mm_destroy(uintptr_t cr3_phys)
 {
-    if (phys == 0 || delta == 0 || !Syscall_state.cow_lock_ready)
-        return false;
-
-    spin_lock(&Syscall_state.cow_lock);
-    int32_t slot = Syscall_cow_ref_find_locked(phys);
-    if (slot >= 0)
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.mm_lock);
+    syscall_mm_t* mm = Syscall_mm_get(cr3_phys);
+    if (mm)
     {
-        syscall_cow_ref_t* ref = &Syscall_state.cow_refs[(uint32_t) slot];
-        if (ref->refs > UINT32_MAX - delta)
+        const uint32_t mask = SYSCALL_MM_BUCKETS - 1U;
+        uint32_t index = (uint32_t) (mm - Syscall_state.mms);
+        if (Syscall_state.mms[(index + 1U) & mask].cr3_phys != SYSCALL_MM_EMPTY)
+            __atomic_store_n(&mm->cr3_phys, (uintptr_t) SYSCALL_MM_DEAD, __ATOMIC_RELEASE);
+        else
         {
-            spin_unlock(&Syscall_state.cow_lock);
-            return false;
+            // No probe sequence goes on past an empty slot: the removed keys before it can go too.
+            __atomic_store_n(&mm->cr3_phys, (uintptr_t) SYSCALL_MM_EMPTY, __ATOMIC_RELEASE);
+            index = (index - 1U) & mask;
+            while (Syscall_state.mms[index].cr3_phys == SYSCALL_MM_DEAD)
+            {
+                __atomic_store_n(&Syscall_state.mms[index].cr3_phys, (uintptr_t) SYSCALL_MM_EMPTY, __ATOMIC_RELEASE);
+                index = (index - 1U) & mask;
+            }
         }
-        ref->refs += delta;
-        spin_unlock(&Syscall_state.cow_lock);
-        return true;
     }
+    spin_unlock_irqrestore(&Syscall_state.mm_lock, lock_flags);
+}
 
-    slot = Syscall_cow_ref_alloc_locked();
-    if (slot < 0)
+static volatile uint64_t* Syscall_mm_counter(syscall_mm_t* mm, uint32_t kind)
+{
+    if (!mm)
+        return NULL;
+
+    switch (kind)
     {
-        spin_unlock(&Syscall_state.cow_lock);
-        return false;
+        case SYSCALL_MM_ANON:
+            return &mm->anon_pages;
+        case SYSCALL_MM_FILE:
+            return &mm->file_pages;
+        case SYSCALL_MM_SHARED:
+            return &mm->shared_pages;
+        default:
+            return NULL;
     }
+}
 
-    syscall_cow_ref_t* ref = &Syscall_state.cow_refs[(uint32_t) slot];
-    ref->used = true;
-    ref->phys = phys;
-    ref->refs = delta;
-    spin_unlock(&Syscall_state.cow_lock);
-    return true;
+static uint64_t Syscall_mm_rss(const syscall_mm_t* mm)
+{
+    return __atomic_load_n(&mm->anon_pages, __ATOMIC_RELAXED) +
+           __atomic_load_n(&mm->file_pages, __ATOMIC_RELAXED) +
+           __atomic_load_n(&mm->shared_pages, __ATOMIC_RELAXED);
 }
 
-static bool Syscall_cow_ref_sub(uintptr_t phys, bool* out_zero)
+// What a present user PTE counts as. The vvar page belongs to the kernel and counts as nothing.
+static uint32_t Syscall_mm_kind_of(uint64_t entry)
 {
-    if (out_zero)
-        *out_zero = false;
-    if (phys == 0 || !Syscall_state.cow_lock_ready)
-        return false;
+    if ((entry & SYSCALL_PTE_VVAR) != 0)
+        return SYSCALL_MM_NONE;
+    if ((entry & SYSCALL_PTE_DMABUF) != 0 || Syscall_page_is_shm(entry & FRAME))
+        return SYSCALL_MM_SHARED;
 
-    spin_lock(&Syscall_state.cow_lock);
-    int32_t slot = Syscall_cow_ref_find_locked(phys);
-    if (slot < 0)
-    {
-        spin_unlock(&Syscall_state.cow_lock);
-        return false;
-    }
+    return (entry & SYSCALL_PTE_FILE) != 0 ? SYSCALL_MM_FILE : SYSCALL_MM_ANON;
+}
 
-    syscall_cow_ref_t* ref = &Syscall_state.cow_refs[(uint32_t) slot];
-    if (ref->refs <= 1U)
-    {
-        ref->used = false;
-        ref->phys = 0;
-        ref->refs = 0;
-        if (out_zero)
-            *out_zero = true;
-    }
-    else
+/*
+ * Pages about to become resident, refused past RLIMIT_RSS. The check and the add are not
+ * one atomic step: the threads of a process serialize on the vm_lock, and shmat may
+ * overshoot by one segment at worst.
+ */
+static bool Syscall_mm_charge(syscall_mm_t* mm, uint32_t kind, uint64_t pages)
+{
+    volatile uint64_t* counter = Syscall_mm_counter(mm, kind);
+    if (!counter || pages == 0)
+        return true;
+
+    uint64_t limit = __atomic_load_n(&mm->limit_rss.cur, __ATOMIC_RELAXED) / SYSCALL_PAGE_SIZE;
+    if (Syscall_mm_rss(mm) + pages > limit)
     {
-        ref->refs -= 1U;
+        __atomic_add_fetch(&Syscall_state.rlimit_hits, 1U, __ATOMIC_RELAXED);
+        return false;
     }
 
-    spin_unlock(&Syscall_state.cow_lock);
+    __atomic_add_fetch(counter, pages, __ATOMIC_RELAXED);
     return true;
 }
 
-static uint32_t Syscall_cow_ref_get(uintptr_t phys)
+static void Syscall_mm_uncharge(syscall_mm_t* mm, uint32_t kind, uint64_t pages)
 {
-    if (phys == 0 || !Syscall_state.cow_lock_ready)
-        return 0;
-
-    spin_lock(&Syscall_state.cow_lock);
-    int32_t slot = Syscall_cow_ref_find_locked(phys);
-    uint32_t refs = (slot >= 0) ? Syscall_state.cow_refs[(uint32_t) slot].refs : 0U;
-    spin_unlock(&Syscall_state.cow_lock);
-    return refs;
+    volatile uint64_t* counter = Syscall_mm_counter(mm, kind);
+    if (counter && pages != 0)
+        __atomic_sub_fetch(counter, pages, __ATOMIC_RELAXED);
+}
+
+// Address space about to be handed out, mapped now or on first touch; refused past RLIMIT_AS.
+static bool Syscall_mm_reserve_vm(syscall_mm_t* mm, uint64_t pages)
+{
+    if (!mm || pages == 0)
+        return true;
+
+    uint64_t limit = __atomic_load_n(&mm->limit_as.cur, __ATOMIC_RELAXED) / SYSCALL_PAGE_SIZE;
+    if (__atomic_load_n(&mm->vm_pages, __ATOMIC_RELAXED) + pages > limit)
+    {
+        __atomic_add_fetch(&Syscall_state.rlimit_hits, 1U, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    __atomic_add_fetch(&mm->vm_pages, pages, __ATOMIC_RELAXED);
+    return true;
+}
+
+static void Syscall_mm_release_vm(syscall_mm_t* mm, uint64_t pages)
+{
+    if (mm && pages != 0)
+        __atomic_sub_fetch(&mm->vm_pages, pages, __ATOMIC_RELAXED);
+}
+
+// User page tables built or freed by this file; the PML4 itself is not counted.
+static void Syscall_mm_add_pt(uintptr_t cr3_phys, int64_t tables)
+{
+    syscall_mm_t* mm = Syscall_mm_get(cr3_phys);
+    if (mm && tables != 0)
+        __atomic_add_fetch(&mm->pt_pages, (uint64_t) tables, __ATOMIC_RELAXED);
 }
 
 static uint64_t* Syscall_get_user_pte_ptr(uintptr_t cr3_phys, uintptr_t virt)
@@ -3579,236 +3613,860 @@ static uint64_t* Syscall_get_user_pte_ptr(uintptr_t cr3_phys, uintptr_t virt)
     return &pt->entries[pt_index];
 }
 
-static void Syscall_free_user_pt(uintptr_t pt_phys)
+// The PDT entry covering virt, present or not, or NULL when the upper tables are missing.
+static uint64_t* Syscall_get_user_pde_ptr(uintptr_t cr3_phys, uintptr_t virt)
 {
-    if (pt_phys == 0)
-        return;
+    if (cr3_phys == 0 || !Syscall_is_canonical_low(virt) || virt < SYSCALL_USER_VADDR_MIN)
+        return NULL;
+    if (PML4_INDEX(virt) >= VMM_HHDM_PML4_INDEX)
+        return NULL;
 
-    PT_t* pt = (PT_t*) P2V(pt_phys);
-    for (uint32_t i = 0; i < 512; i++)
-    {
-        uintptr_t entry = pt->entries[i];
-        if ((entry & PRESENT) == 0)
-            continue;
+    PML4_t* pml4 = (PML4_t*) P2V(cr3_phys);
+    uintptr_t pml4_entry = pml4->entries[PML4_INDEX(virt)];
+    if ((pml4_entry & PRESENT) == 0 || (pml4_entry & USER_MODE) == 0)
+        return NULL;
 
-        uintptr_t page_phys = entry & FRAME;
-        if (page_phys == 0)
-            continue;
+    PDPT_t* pdpt = (PDPT_t*) P2V(pml4_entry & FRAME);
+    uintptr_t pdpt_entry = pdpt->entries[PDPT_INDEX(virt)];
+    if ((pdpt_entry & PRESENT) == 0 || (pdpt_entry & USER_MODE) == 0)
+        return NULL;
+    if ((pdpt_entry & SYSCALL_PTE_PS) != 0)
+        return NULL;
 
-        if ((entry & SYSCALL_PTE_DMABUF) != 0)
-        {
-            (void) DRM_dmabuf_unref_map_pages_by_phys(page_phys, 1U);
-            continue;
-        }
+    PDT_t* pdt = (PDT_t*) P2V(pdpt_entry & FRAME);
+    return &pdt->entries[PDT_INDEX(virt)];
+}
 
-        if ((entry & SYSCALL_PTE_COW) != 0)
-        {
-            bool ref_zero = false;
-            if (Syscall_cow_ref_sub(page_phys, &ref_zero) && ref_zero)
-                PMM_dealloc_page((void*) page_phys);
-            continue;
-        }
+// A present 2 MiB user page mapping virt.
+static uint64_t* Syscall_get_user_huge_pde_ptr(uintptr_t cr3_phys, uintptr_t virt)
+{
+    uint64_t* pde = Syscall_get_user_pde_ptr(cr3_phys, virt);
+    if (!pde || (*pde & (PRESENT | SYSCALL_PTE_PS | USER_MODE)) != (PRESENT | SYSCALL_PTE_PS | USER_MODE))
+        return NULL;
 
-        PMM_dealloc_page((void*) page_phys);
-    }
+    return pde;
+}
 
-    PMM_dealloc_page((void*) pt_phys);
+static bool Syscall_pde_is_lazy_huge(uint64_t entry)
+{
+    return (entry & (PRESENT | SYSCALL_PTE_PS | SYSCALL_PTE_LAZY)) == (SYSCALL_PTE_PS | SYSCALL_PTE_LAZY);
 }
 
-static void Syscall_free_user_pdt(uintptr_t pdt_phys)
+// Like Syscall_get_user_pde_ptr, but builds the missing PDPT and PDT on the way down.
+static uint64_t* Syscall_user_pde_alloc(uintptr_t cr3_phys, uintptr_t virt)
 {
-    if (pdt_phys == 0)
-        return;
+    if (cr3_phys == 0 || !Syscall_is_canonical_low(virt) || virt < SYSCALL_USER_VADDR_MIN)
+        return NULL;
+    if (PML4_INDEX(virt) >= VMM_HHDM_PML4_INDEX)
+        return NULL;
 
-    PDT_t* pdt = (PDT_t*) P2V(pdt_phys);
-    for (uint32_t i = 0; i < 512; i++)
+    const uint16_t indexes[2] = { PML4_INDEX(virt), PDPT_INDEX(virt) };
+    uint64_t* table = (uint64_t*) P2V(cr3_phys);
+    for (uint32_t level = 0; level < 2; level++)
     {
-        uintptr_t entry = pdt->entries[i];
+        uint64_t entry = table[indexes[level]];
         if ((entry & PRESENT) == 0)
-            continue;
-        if ((entry & SYSCALL_PTE_PS) != 0)
-            continue;
+        {
+            uintptr_t next_phys = Syscall_alloc_zero_page_phys();
+            if (next_phys == 0)
+                return NULL;
 
-        Syscall_free_user_pt(entry & FRAME);
+            entry = next_phys | PRESENT | WRITABLE | USER_MODE;
+            table[indexes[level]] = entry;
+            Syscall_mm_add_pt(cr3_phys, 1);
+        }
+        else if ((entry & SYSCALL_PTE_PS) != 0)
+            return NULL;
+        else if ((entry & USER_MODE) == 0)
+        {
+            entry |= USER_MODE;
+            table[indexes[level]] = entry;
+        }
+
+        table = (uint64_t*) P2V(entry & FRAME);
     }
 
-    PMM_dealloc_page((void*) pdt_phys);
+    return &table[PDT_INDEX(virt)];
 }
 
-static void Syscall_free_user_pdpt(uintptr_t pdpt_phys)
+// Like Syscall_get_user_pte_ptr, but builds the missing user page tables on the way down.
+static uint64_t* Syscall_user_pte_alloc(uintptr_t cr3_phys, uintptr_t virt)
 {
-    if (pdpt_phys == 0)
-        return;
+    uint64_t* pde = Syscall_user_pde_alloc(cr3_phys, virt);
+    if (!pde)
+        return NULL;
 
-    PDPT_t* pdpt = (PDPT_t*) P2V(pdpt_phys);
-    for (uint32_t i = 0; i < 512; i++)
+    uint64_t entry = *pde;
+    if ((entry & PRESENT) == 0)
     {
-        uintptr_t entry = pdpt->entries[i];
-        if ((entry & PRESENT) == 0)
-            continue;
-        if ((entry & SYSCALL_PTE_PS) != 0)
-            continue;
+        // A lazy 2 MiB reservation is split explicitly, never overwritten here.
+        if (Syscall_pde_is_lazy_huge(entry))
+            return NULL;
 
-        Syscall_free_user_pdt(entry & FRAME);
+        uintptr_t pt_phys = Syscall_alloc_zero_page_phys();
+        if (pt_phys == 0)
+            return NULL;
+
+        entry = pt_phys | PRESENT | WRITABLE | USER_MODE;
+        *pde = entry;
+        Syscall_mm_add_pt(cr3_phys, 1);
+    }
+    else if ((entry & SYSCALL_PTE_PS) != 0)
+        return NULL;
+    else if ((entry & USER_MODE) == 0)
+    {
+        entry |= USER_MODE;
+        *pde = entry;
     }
 
-    PMM_dealloc_page((void*) pdpt_phys);
+    PT_t* pt = (PT_t*) P2V(entry & FRAME);
+    return &pt->entries[PT_INDEX(virt)];
 }
 
-static void Syscall_free_address_space(uintptr_t cr3_phys)
+// A page table left behind by munmap: no entry of any kind, lazy ones included.
+static bool Syscall_user_pt_is_empty(uintptr_t pt_phys)
 {
-    if (cr3_phys == 0)
-        return;
-
-    PML4_t* pml4 = (PML4_t*) P2V(cr3_phys);
-    for (uint32_t i = 0; i < VMM_HHDM_PML4_INDEX; i++)
+    const PT_t* pt = (const PT_t*) P2V(pt_phys);
+    for (uint32_t i = 0; i < 512; i++)
     {
-        uintptr_t entry = pml4->entries[i];
-        if ((entry & PRESENT) == 0)
-            continue;
-
-        Syscall_free_user_pdpt(entry & FRAME);
+        if (pt->entries[i] != 0)
+            return false;
     }
 
-    PMM_dealloc_page((void*) cr3_phys);
+    return true;
 }
 
-static bool Syscall_clone_user_pt(uintptr_t src_pt_phys, uintptr_t* out_dst_pt_phys)
+static bool Syscall_user_page_is_lazy(uintptr_t cr3_phys, uintptr_t page)
 {
-    if (!out_dst_pt_phys || src_pt_phys == 0)
-        return false;
+    uint64_t* pte = Syscall_get_user_pte_ptr(cr3_phys, page);
+    if (pte)
+        return (*pte & (PRESENT | SYSCALL_PTE_LAZY)) == SYSCALL_PTE_LAZY;
 
-    uintptr_t dst_pt_phys = Syscall_alloc_zero_page_phys();
-    if (dst_pt_phys == 0)
-        return false;
+    uint64_t* pde = Syscall_get_user_pde_ptr(cr3_phys, page);
+    return pde && Syscall_pde_is_lazy_huge(*pde);
+}
 
-    PT_t* src_pt = (PT_t*) P2V(src_pt_phys);
-    PT_t* dst_pt = (PT_t*) P2V(dst_pt_phys);
+/*
+ * Turn a 2 MiB entry back into a page table: a lazy one into 512 lazy PTEs, a present one
+ * into 512 PTEs over the same frames with the same rights. Translations do not change, so
+ * no flush is needed here; the caller flushes whatever it edits next, and INVLPG on any
+ * address inside a large page drops its whole TLB entry. The frames of the order-9 block
+ * are freed one by one later on, which the buddy allocator merges back.
+ */
+static bool Syscall_thp_split_pde(uintptr_t cr3_phys, uint64_t* pde)
+{
+    uint64_t entry = *pde;
+    bool lazy = Syscall_pde_is_lazy_huge(entry);
+    bool huge = (entry & (PRESENT | SYSCALL_PTE_PS)) == (PRESENT | SYSCALL_PTE_PS);
+    if (!lazy && !huge)
+        return true;
 
-    for (uint32_t i = 0; i < 512; i++)
+    uintptr_t pt_phys = Syscall_alloc_zero_page_phys();
+    if (pt_phys == 0)
+        return false;
+
+    PT_t* pt = (PT_t*) P2V(pt_phys);
+    uint64_t rights = entry & (USER_MODE | WRITABLE | NO_EXECUTE);
+    if (lazy)
     {
-        uintptr_t src_entry = src_pt->entries[i];
-        if ((src_entry & PRESENT) == 0)
-            continue;
-        if ((src_entry & SYSCALL_PTE_PS) != 0)
-        {
-            Syscall_free_user_pt(dst_pt_phys);
-            return false;
-        }
+        for (uint32_t i = 0; i < SYSCALL_THP_PAGES; i++)
+            pt->entries[i] = SYSCALL_PTE_LAZY | rights;
+    }
+    else
+    {
+        uintptr_t frame = entry & LARGE_FRAME;
+        for (uint32_t i = 0; i < SYSCALL_THP_PAGES; i++)
+            pt->entries[i] = (frame + ((uintptr_t) i * SYSCALL_PAGE_SIZE)) | PRESENT | rights;
 
-        uintptr_t src_page_phys = src_entry & FRAME;
-        if (src_page_phys == 0)
-        {
-            dst_pt->entries[i] = src_entry;
-            continue;
-        }
+        __atomic_sub_fetch(&Syscall_state.thp_pages, 1U, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&Syscall_state.thp_splits, 1U, __ATOMIC_RELAXED);
+    }
 
-        if ((src_entry & SYSCALL_PTE_DMABUF) != 0)
-        {
-            if (!DRM_dmabuf_ref_map_pages_by_phys(src_page_phys, 1U))
-            {
-                Syscall_free_user_pt(dst_pt_phys);
-                return false;
-            }
+    *pde = pt_phys | PRESENT | WRITABLE | USER_MODE;
+    Syscall_mm_add_pt(cr3_phys, 1);
+    return true;
+}
 
-            dst_pt->entries[i] = src_entry;
+/*
+ * Split every 2 MiB entry overlapping [base, base + size) before it is edited page by page.
+ * The VMM edits PTEs through the recursive window, whose slot for a new table may still
+ * translate to the old large page: one flush drops it before anyone goes through it.
+ */
+static bool Syscall_thp_split_range_locked(uintptr_t cr3_phys, uintptr_t base, size_t size)
+{
+    uintptr_t end = base + (uintptr_t) size;
+    bool split_present = false;
+    bool ok = true;
+    for (uintptr_t chunk = base & ~(SYSCALL_THP_SIZE - 1U); ok && chunk < end; chunk += SYSCALL_THP_SIZE)
+    {
+        uint64_t* pde = Syscall_get_user_pde_ptr(cr3_phys, chunk);
+        if (!pde)
             continue;
-        }
-
-        bool writable = (src_entry & WRITABLE) != 0;
-        bool already_cow = (src_entry & SYSCALL_PTE_COW) != 0;
-        if (writable || already_cow)
-        {
-            uintptr_t shared_entry = src_entry & ~WRITABLE;
-            shared_entry |= SYSCALL_PTE_COW;
 
-            uint32_t delta = already_cow ? 1U : 2U;
-            if (!Syscall_cow_ref_add(src_page_phys, delta))
-            {
-                Syscall_free_user_pt(dst_pt_phys);
-                return false;
-            }
+        bool present_huge = (*pde & (PRESENT | SYSCALL_PTE_PS)) == (PRESENT | SYSCALL_PTE_PS);
+        ok = Syscall_thp_split_pde(cr3_phys, pde);
+        split_present |= ok && present_huge;
+    }
 
-            src_pt->entries[i] = shared_entry;
-            dst_pt->entries[i] = shared_entry;
-            continue;
-        }
+    if (split_present)
+        VMM_flush_address_space(cr3_phys);
+    return ok;
+}
 
-        uintptr_t dst_page_phys = Syscall_alloc_zero_page_phys();
-        if (dst_page_phys == 0)
-        {
-            Syscall_free_user_pt(dst_pt_phys);
-            return false;
-        }
+// Below the PMM's reclaim watermark: 2 MiB pages cannot be swapped out, so none are made.
+static bool Syscall_memory_low(void)
+{
+    return PMM_get_free_page_count() < PMM_reclaim_low_watermark();
+}
 
-        memcpy((void*) P2V(dst_page_phys), (const void*) P2V(src_page_phys), SYSCALL_PAGE_SIZE);
-        dst_pt->entries[i] = (src_entry & ~FRAME) | dst_page_phys;
+/*
+ * First touch of a lazy 2 MiB reservation: back it with one zeroed order-9 block, or, when
+ * none is free, memory runs low or RLIMIT_RSS has no room for all of it, fall back to a
+ * table of lazy 4 KiB pages. Like the 4 KiB case, the entry was never present, so nothing
+ * needs flushing.
+ */
+static bool Syscall_thp_populate_locked(uintptr_t cr3_phys, uint64_t* pde)
+{
+    uint64_t entry = *pde;
+    syscall_mm_t* mm = Syscall_mm_get(cr3_phys);
+    void* block = NULL;
+    if (!Syscall_memory_low() && Syscall_mm_charge(mm, SYSCALL_MM_ANON, SYSCALL_THP_PAGES))
+    {
+        block = PMM_alloc_pages(SYSCALL_THP_ORDER);
+        if (!block)
+            Syscall_mm_uncharge(mm, SYSCALL_MM_ANON, SYSCALL_THP_PAGES);
+    }
+    if (block)
+    {
+        memset((void*) P2V((uintptr_t) block), 0, SYSCALL_THP_SIZE);
+        *pde = (uintptr_t) block | PRESENT | SYSCALL_PTE_PS | (entry & (USER_MODE | WRITABLE | NO_EXECUTE));
+        __atomic_add_fetch(&Syscall_state.thp_pages, 1U, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&Syscall_state.thp_faults, 1U, __ATOMIC_RELAXED);
+        return true;
     }
 
-    *out_dst_pt_phys = dst_pt_phys;
-    return true;
+    __atomic_add_fetch(&Syscall_state.thp_fallbacks, 1U, __ATOMIC_RELAXED);
+    return Syscall_thp_split_pde(cr3_phys, pde);
 }
 
-static bool Syscall_clone_user_pdt(uintptr_t src_pdt_phys, uintptr_t* out_dst_pdt_phys)
+/*
+ * Back a lazy anonymous page with a zeroed frame, or with its old contents when it was
+ * swapped out. The caller holds vm_lock; a page that is already present (another thread
+ * got there first) counts as done. The old entry was not present, so no TLB can hold it
+ * and nothing needs flushing.
+ */
+static bool Syscall_lazy_populate_locked(uintptr_t cr3_phys, uintptr_t page)
 {
-    if (!out_dst_pdt_phys || src_pdt_phys == 0)
+    uint64_t* pte = Syscall_get_user_pte_ptr(cr3_phys, page);
+    if (!pte)
+    {
+        uint64_t* pde = Syscall_get_user_pde_ptr(cr3_phys, page);
+        if (!pde)
+            return false;
+        if (Syscall_get_user_huge_pde_ptr(cr3_phys, page))
+            return true;
+        if (!Syscall_pde_is_lazy_huge(*pde) || !Syscall_thp_populate_locked(cr3_phys, pde))
+            return false;
+        if ((*pde & SYSCALL_PTE_PS) != 0)
+            return true;
+
+        pte = Syscall_get_user_pte_ptr(cr3_phys, page);
+        if (!pte)
+            return false;
+    }
+
+    uintptr_t entry = *pte;
+    if ((entry & PRESENT) != 0)
+        return (entry & USER_MODE) != 0;
+    if ((entry & SYSCALL_PTE_LAZY) == 0)
         return false;
 
-    uintptr_t dst_pdt_phys = Syscall_alloc_zero_page_phys();
-    if (dst_pdt_phys == 0)
+    syscall_mm_t* mm = Syscall_mm_get(cr3_phys);
+    if (!Syscall_mm_charge(mm, SYSCALL_MM_ANON, 1U))
         return false;
 
-    PDT_t* src_pdt = (PDT_t*) P2V(src_pdt_phys);
-    PDT_t* dst_pdt = (PDT_t*) P2V(dst_pdt_phys);
-    for (uint32_t i = 0; i < 512; i++)
+    bool swapped = (entry & SYSCALL_PTE_SWAP) != 0;
+    uintptr_t phys = swapped ? (uintptr_t) PMM_alloc_page() : Syscall_alloc_zero_page_phys();
+    if (phys == 0)
     {
-        uintptr_t src_entry = src_pdt->entries[i];
-        if ((src_entry & PRESENT) == 0)
-            continue;
-        if ((src_entry & SYSCALL_PTE_PS) != 0)
-        {
-            Syscall_free_user_pdt(dst_pdt_phys);
-            return false;
-        }
+        Syscall_mm_uncharge(mm, SYSCALL_MM_ANON, 1U);
+        return false;
+    }
 
-        uintptr_t dst_pt_phys = 0;
-        if (!Syscall_clone_user_pt(src_entry & FRAME, &dst_pt_phys))
+    uint64_t rights = entry & (USER_MODE | WRITABLE | NO_EXECUTE);
+    if (swapped)
+    {
+        if (!zswap_load(Syscall_swap_slot(entry), (void*) P2V(phys)))
         {
-            Syscall_free_user_pdt(dst_pdt_phys);
+            PMM_dealloc_page((void*) phys);
+            Syscall_mm_uncharge(mm, SYSCALL_MM_ANON, 1U);
             return false;
         }
 
-        dst_pdt->entries[i] = (src_entry & ~FRAME) | dst_pt_phys;
+        zswap_free(Syscall_swap_slot(entry));
+        if (mm)
+            __atomic_sub_fetch(&mm->swap_pages, 1U, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&Syscall_state.swap_ins, 1U, __ATOMIC_RELAXED);
+        // Just used: the next swap-out pass only clears the bit instead of taking it straight back.
+        rights |= SYSCALL_PTE_ACCESSED;
     }
 
-    *out_dst_pdt_phys = dst_pdt_phys;
+    *pte = phys | PRESENT | rights;
     return true;
 }
 
-static bool Syscall_clone_user_pdpt(uintptr_t src_pdpt_phys, uintptr_t* out_dst_pdpt_phys)
+// For kernel paths that dereference user pointers directly instead of going through the copy helpers.
+static bool Syscall_lazy_populate_range(uintptr_t base, size_t size)
 {
-    if (!out_dst_pdpt_phys || src_pdpt_phys == 0)
+    if (size == 0 || !Syscall_state.vm_lock_ready || !Syscall_user_range_in_bounds(base, size))
         return false;
 
-    uintptr_t dst_pdpt_phys = Syscall_alloc_zero_page_phys();
-    if (dst_pdpt_phys == 0)
-        return false;
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    uintptr_t end = base + (uintptr_t) size;
+    bool ok = true;
+    spinlock_t* vm_lock = Syscall_vm_lock(current_cr3);
+    spin_lock(vm_lock);
+    for (uintptr_t page = base & FRAME; ok && page < end; page += SYSCALL_PAGE_SIZE)
+        ok = VMM_is_user_accessible(page) || Syscall_lazy_populate_locked(current_cr3, page);
+    spin_unlock(vm_lock);
+    return ok;
+}
 
-    PDPT_t* src_pdpt = (PDPT_t*) P2V(src_pdpt_phys);
-    PDPT_t* dst_pdpt = (PDPT_t*) P2V(dst_pdpt_phys);
-    for (uint32_t i = 0; i < 512; i++)
-    {
-        uintptr_t src_entry = src_pdpt->entries[i];
-        if ((src_entry & PRESENT) == 0)
-            continue;
-        if ((src_entry & SYSCALL_PTE_PS) != 0)
-        {
+static inline uint32_t Syscall_swap_slot(uint64_t entry)
+{
+    return (uint32_t) ((entry & FRAME) >> 12);
+}
+
+static bool Syscall_interrupts_enabled(void)
+{
+    uint64_t rflags = 0;
+    __asm__ __volatile__("pushfq\n\tpopq %0" : "=r"(rflags));
+    return (rflags & SYSCALL_RFLAGS_IF) != 0;
+}
+
+/*
+ * Only anonymous pages this address space owns alone go to the swap pool: COW, shm,
+ * dma-buf, vvar and file pages stay resident, and so do 2 MiB pages.
+ */
+static bool Syscall_swap_page_eligible(uint64_t entry)
+{
+    if ((entry & (PRESENT | USER_MODE)) != (PRESENT | USER_MODE))
+        return false;
+    if ((entry & (SYSCALL_PTE_COW | SYSCALL_PTE_DMABUF | SYSCALL_PTE_VVAR | SYSCALL_PTE_FILE |
+                  SYSCALL_PTE_PS | WRITE_THROUGH | CACHE_DISABLE)) != 0)
+        return false;
+
+    const PMM_page_t* page = PMM_page_get(entry & FRAME);
+    return page && __atomic_load_n(&page->refcount, __ATOMIC_ACQUIRE) == 0 &&
+           __atomic_load_n(&page->flags, __ATOMIC_ACQUIRE) == 0;
+}
+
+/*
+ * Unmap a batch, flush once, then compress the frames no TLB can reach any more. A page
+ * touched between the scan and the unmap, or one the pool turns down, is mapped back as
+ * it was with its accessed bit set, so the next pass leaves it alone too.
+ */
+static uint64_t Syscall_swap_out_batch_locked(uintptr_t cr3_phys, syscall_mm_t* mm, uint64_t** ptes, uint32_t count)
+{
+    uint64_t old_entries[SYSCALL_SWAP_BATCH];
+    for (uint32_t i = 0; i < count; i++)
+        old_entries[i] = __atomic_fetch_and(ptes[i], ~PRESENT, __ATOMIC_ACQ_REL);
+
+    VMM_flush_address_space(cr3_phys);
+
+    uint64_t freed = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t old_entry = old_entries[i];
+        uintptr_t phys = old_entry & FRAME;
+        uint32_t slot = 0;
+        if ((old_entry & SYSCALL_PTE_ACCESSED) != 0 || !zswap_store((const void*) P2V(phys), &slot))
+        {
+            __atomic_store_n(ptes[i], old_entry | SYSCALL_PTE_ACCESSED, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        __atomic_store_n(ptes[i],
+                         SYSCALL_PTE_LAZY | SYSCALL_PTE_SWAP | ((uint64_t) slot << 12) |
+                         (old_entry & (USER_MODE | WRITABLE | NO_EXECUTE)),
+                         __ATOMIC_RELEASE);
+        PMM_dealloc_page_cold((void*) phys);
+        freed++;
+    }
+
+    Syscall_mm_uncharge(mm, SYSCALL_MM_ANON, freed);
+    __atomic_add_fetch(&mm->swap_pages, freed, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&Syscall_state.swap_outs, freed, __ATOMIC_RELAXED);
+    return freed;
+}
+
+/*
+ * One clock pass over an address space, resuming where the last one stopped: a resident
+ * page with its accessed bit set only loses the bit (a second chance), the others are
+ * swapped out, until target_pages are freed or SYSCALL_SWAP_SCAN_PAGES were looked at.
+ * The caller holds vm_lock.
+ */
+static uint64_t Syscall_swap_out_locked(uintptr_t cr3_phys, syscall_mm_t* mm, uint64_t target_pages)
+{
+    PML4_t* pml4 = (PML4_t*) P2V(cr3_phys);
+    uint64_t* batch[SYSCALL_SWAP_BATCH];
+    uint32_t batch_count = 0;
+    uint64_t freed = 0;
+    uint32_t scanned = 0;
+    bool wrapped = false;
+    uintptr_t virt = mm->swap_cursor;
+    while (scanned < SYSCALL_SWAP_SCAN_PAGES && freed + batch_count < target_pages)
+    {
+        if (virt < SYSCALL_USER_VADDR_MIN || virt >= SYSCALL_ELF_CANONICAL_LOW_MAX)
+        {
+            if (wrapped)
+                break;
+            wrapped = true;
+            virt = SYSCALL_USER_VADDR_MIN;
+        }
+
+        // Missing or large upper levels are skipped whole.
+        uintptr_t entry = pml4->entries[PML4_INDEX(virt)];
+        if ((entry & (PRESENT | USER_MODE)) != (PRESENT | USER_MODE))
+        {
+            virt = (virt | ((1ULL << 39) - 1U)) + 1U;
+            continue;
+        }
+        entry = ((PDPT_t*) P2V(entry & FRAME))->entries[PDPT_INDEX(virt)];
+        if ((entry & (PRESENT | USER_MODE | SYSCALL_PTE_PS)) != (PRESENT | USER_MODE))
+        {
+            virt = (virt | ((1ULL << 30) - 1U)) + 1U;
+            continue;
+        }
+        entry = ((PDT_t*) P2V(entry & FRAME))->entries[PDT_INDEX(virt)];
+        if ((entry & (PRESENT | USER_MODE | SYSCALL_PTE_PS)) != (PRESENT | USER_MODE))
+        {
+            virt = (virt | (SYSCALL_THP_SIZE - 1U)) + 1U;
+            continue;
+        }
+
+        PT_t* pt = (PT_t*) P2V(entry & FRAME);
+        for (uint32_t i = PT_INDEX(virt);
+             i < 512U && scanned < SYSCALL_SWAP_SCAN_PAGES && freed + batch_count < target_pages;
+             i++)
+        {
+            uint64_t* pte = &pt->entries[i];
+            uint64_t pte_entry = *pte;
+            virt += SYSCALL_PAGE_SIZE;
+            scanned++;
+            if (!Syscall_swap_page_eligible(pte_entry))
+                continue;
+            if ((pte_entry & SYSCALL_PTE_ACCESSED) != 0)
+            {
+                __atomic_fetch_and(pte, ~SYSCALL_PTE_ACCESSED, __ATOMIC_RELAXED);
+                continue;
+            }
+
+            batch[batch_count++] = pte;
+            if (batch_count == SYSCALL_SWAP_BATCH)
+            {
+                freed += Syscall_swap_out_batch_locked(cr3_phys, mm, batch, batch_count);
+                batch_count = 0;
+            }
+        }
+    }
+
+    if (batch_count != 0)
+        freed += Syscall_swap_out_batch_locked(cr3_phys, mm, batch, batch_count);
+    mm->swap_cursor = virt;
+    return freed;
+}
+
+// Live address spaces, each once; read under proc_lock, trusted only once their vm_lock is held.
+static void Syscall_swap_collect_candidates(void)
+{
+    uint32_t count = 0;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    uint32_t start = Syscall_state.swap_proc_cursor;
+    for (uint32_t n = 0; n < SYSCALL_MAX_PROCS; n++)
+    {
+        const syscall_process_t* proc = &Syscall_state.procs[(start + n) % SYSCALL_MAX_PROCS];
+        if (!proc->used || proc->cr3_phys == 0)
+            continue;
+
+        uint32_t i = 0;
+        while (i < count && Syscall_state.swap_candidates[i].cr3_phys != proc->cr3_phys)
+            i++;
+        if (i == count)
+        {
+            const syscall_mm_t* mm = Syscall_mm_get(proc->cr3_phys);
+            if (!mm)
+                continue;
+
+            Syscall_state.swap_candidates[count].cr3_phys = proc->cr3_phys;
+            Syscall_state.swap_candidates[count].serial = mm->serial;
+            Syscall_state.swap_candidates[count].running = false;
+            count++;
+        }
+        if (proc->run_state == SYSCALL_RUN_STATE_RUNNING)
+            Syscall_state.swap_candidates[i].running = true;
+    }
+    Syscall_state.swap_proc_cursor = (start + 1U) % SYSCALL_MAX_PROCS;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    Syscall_state.swap_candidate_count = count;
+}
+
+/*
+ * The PMM's shrinker, also called by a faulting thread when memory runs out: swap pages
+ * out until target_pages frames are free again. Address spaces with no thread on a CPU go
+ * first; a busy vm_lock means the address space is skipped, never waited for. Needs
+ * interrupts on for the TLB shootdowns.
+ */
+static uint64_t Syscall_swap_reclaim(uint64_t target_pages)
+{
+    if (target_pages == 0 || !Syscall_state.vm_lock_ready || !Syscall_state.proc_lock_ready ||
+        !Syscall_interrupts_enabled())
+        return 0;
+
+    uint8_t expected = 0;
+    if (!__atomic_compare_exchange_n(&Syscall_state.swap_reclaiming, &expected, 1, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return 0;
+
+    Syscall_swap_collect_candidates();
+    uint64_t freed = 0;
+    for (uint32_t pass = 0; pass < 2U && freed < target_pages; pass++)
+    {
+        for (uint32_t i = 0; i < Syscall_state.swap_candidate_count && freed < target_pages; i++)
+        {
+            const syscall_swap_candidate_t* candidate = &Syscall_state.swap_candidates[i];
+            if (candidate->running != (pass == 1U))
+                continue;
+
+            spinlock_t* vm_lock = Syscall_vm_lock(candidate->cr3_phys);
+            if (!spin_try_lock(vm_lock))
+                continue;
+
+            syscall_mm_t* mm = Syscall_mm_get(candidate->cr3_phys);
+            if (mm && mm->serial == candidate->serial)
+                freed += Syscall_swap_out_locked(candidate->cr3_phys, mm, target_pages - freed);
+            spin_unlock(vm_lock);
+        }
+    }
+
+    __atomic_store_n(&Syscall_state.swap_reclaiming, 0, __ATOMIC_RELEASE);
+    return freed;
+}
+
+/*
+ * A user fault with free memory nearly gone: make room before serving it rather than fail
+ * the allocation. The fault came from user mode, so nothing is held and interrupts can come
+ * back on for the shootdowns. A background pass already running is waited for first.
+ */
+static void Syscall_swap_direct_reclaim(void)
+{
+    uint64_t threshold = PMM_reclaim_low_watermark() / 2U;
+    if (PMM_get_free_page_count() >= threshold)
+        return;
+
+    __atomic_add_fetch(&Syscall_state.swap_direct, 1U, __ATOMIC_RELAXED);
+    sti();
+    for (uint32_t spin = 0;
+         spin < SYSCALL_SWAP_DIRECT_WAIT && __atomic_load_n(&Syscall_state.swap_reclaiming, __ATOMIC_ACQUIRE) != 0;
+         spin++)
+        __asm__ __volatile__("pause");
+    if (PMM_get_free_page_count() < threshold)
+        (void) Syscall_swap_reclaim(SYSCALL_SWAP_DIRECT_PAGES);
+    cli();
+}
+
+static void Syscall_free_user_pt(uintptr_t pt_phys)
+{
+    if (pt_phys == 0)
+        return;
+
+    PT_t* pt = (PT_t*) P2V(pt_phys);
+    for (uint32_t i = 0; i < 512; i++)
+    {
+        uintptr_t entry = pt->entries[i];
+        if ((entry & PRESENT) == 0)
+        {
+            if ((entry & SYSCALL_PTE_SWAP) != 0)
+                zswap_free(Syscall_swap_slot(entry));
+            continue;
+        }
+
+        uintptr_t page_phys = entry & FRAME;
+        if (page_phys == 0)
+            continue;
+
+        if ((entry & SYSCALL_PTE_DMABUF) != 0)
+        {
+            (void) DRM_dmabuf_unref_map_pages_by_phys(page_phys, 1U);
+            continue;
+        }
+        if ((entry & SYSCALL_PTE_VVAR) != 0)
+            continue;
+
+        if ((entry & SYSCALL_PTE_COW) != 0)
+        {
+            bool ref_zero = false;
+            if (Syscall_cow_ref_sub(page_phys, &ref_zero) && ref_zero)
+                PMM_dealloc_page((void*) page_phys);
+            continue;
+        }
+        if (Syscall_page_is_shm(page_phys))
+        {
+            Syscall_shm_page_unmapped(page_phys);
+            continue;
+        }
+
+        PMM_dealloc_page((void*) page_phys);
+    }
+
+    PMM_dealloc_page((void*) pt_phys);
+}
+
+static void Syscall_free_user_pdt(uintptr_t pdt_phys)
+{
+    if (pdt_phys == 0)
+        return;
+
+    PDT_t* pdt = (PDT_t*) P2V(pdt_phys);
+    for (uint32_t i = 0; i < 512; i++)
+    {
+        uintptr_t entry = pdt->entries[i];
+        if ((entry & PRESENT) == 0)
+            continue;
+        if ((entry & SYSCALL_PTE_PS) != 0)
+        {
+            PMM_free_pages((void*) (entry & LARGE_FRAME), SYSCALL_THP_ORDER);
+            __atomic_sub_fetch(&Syscall_state.thp_pages, 1U, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        Syscall_free_user_pt(entry & FRAME);
+    }
+
+    PMM_dealloc_page((void*) pdt_phys);
+}
+
+static void Syscall_free_user_pdpt(uintptr_t pdpt_phys)
+{
+    if (pdpt_phys == 0)
+        return;
+
+    PDPT_t* pdpt = (PDPT_t*) P2V(pdpt_phys);
+    for (uint32_t i = 0; i < 512; i++)
+    {
+        uintptr_t entry = pdpt->entries[i];
+        if ((entry & PRESENT) == 0)
+            continue;
+        if ((entry & SYSCALL_PTE_PS) != 0)
+            continue;
+
+        Syscall_free_user_pdt(entry & FRAME);
+    }
+
+    PMM_dealloc_page((void*) pdpt_phys);
+}
+
+static void Syscall_free_address_space(uintptr_t cr3_phys)
+{
+    if (cr3_phys == 0)
+        return;
+
+    VMM_forget_address_space(cr3_phys);
+    // Under vm_lock: a swap-out pass only walks address spaces it still finds accounted.
+    spinlock_t* vm_lock = Syscall_state.vm_lock_ready ? Syscall_vm_lock(cr3_phys) : NULL;
+    if (vm_lock)
+        spin_lock(vm_lock);
+    Syscall_mm_destroy(cr3_phys);
+    if (vm_lock)
+        spin_unlock(vm_lock);
+
+    PML4_t* pml4 = (PML4_t*) P2V(cr3_phys);
+    for (uint32_t i = 0; i < VMM_HHDM_PML4_INDEX; i++)
+    {
+        uintptr_t entry = pml4->entries[i];
+        if ((entry & PRESENT) == 0)
+            continue;
+
+        Syscall_free_user_pdpt(entry & FRAME);
+    }
+
+    PMM_dealloc_page((void*) cr3_phys);
+}
+
+static bool Syscall_clone_user_pt(uintptr_t src_pt_phys, uintptr_t* out_dst_pt_phys)
+{
+    if (!out_dst_pt_phys || src_pt_phys == 0)
+        return false;
+
+    uintptr_t dst_pt_phys = Syscall_alloc_zero_page_phys();
+    if (dst_pt_phys == 0)
+        return false;
+
+    PT_t* src_pt = (PT_t*) P2V(src_pt_phys);
+    PT_t* dst_pt = (PT_t*) P2V(dst_pt_phys);
+
+    for (uint32_t i = 0; i < 512; i++)
+    {
+        uintptr_t src_entry = src_pt->entries[i];
+        if ((src_entry & PRESENT) == 0)
+        {
+            // An untouched lazy page stays lazy in the child: each side zero-fills its own.
+            // A swapped-out one shares its slot until each side faults its own copy back.
+            if ((src_entry & SYSCALL_PTE_SWAP) != 0 && !zswap_dup(Syscall_swap_slot(src_entry)))
+            {
+                Syscall_free_user_pt(dst_pt_phys);
+                return false;
+            }
+            if ((src_entry & SYSCALL_PTE_LAZY) != 0)
+                dst_pt->entries[i] = src_entry;
+            continue;
+        }
+        if ((src_entry & SYSCALL_PTE_PS) != 0)
+        {
+            Syscall_free_user_pt(dst_pt_phys);
+            return false;
+        }
+
+        uintptr_t src_page_phys = src_entry & FRAME;
+        if (src_page_phys == 0)
+        {
+            dst_pt->entries[i] = src_entry;
+            continue;
+        }
+
+        if ((src_entry & SYSCALL_PTE_DMABUF) != 0)
+        {
+            if (!DRM_dmabuf_ref_map_pages_by_phys(src_page_phys, 1U))
+            {
+                Syscall_free_user_pt(dst_pt_phys);
+                return false;
+            }
+
+            dst_pt->entries[i] = src_entry;
+            continue;
+        }
+        if ((src_entry & SYSCALL_PTE_VVAR) != 0)
+        {
+            dst_pt->entries[i] = src_entry;
+            continue;
+        }
+        // Segment frames stay shared across fork: the child holds its own attach reference.
+        if (Syscall_page_is_shm(src_page_phys))
+        {
+            if (!PMM_page_ref_add(src_page_phys, 1U, PMM_PAGE_F_SHM))
+            {
+                Syscall_free_user_pt(dst_pt_phys);
+                return false;
+            }
+
+            __atomic_add_fetch(&PMM_page_get(src_page_phys)->mapcount, 1U, __ATOMIC_RELAXED);
+            dst_pt->entries[i] = src_entry;
+            continue;
+        }
+
+        bool writable = (src_entry & WRITABLE) != 0;
+        bool already_cow = (src_entry & SYSCALL_PTE_COW) != 0;
+        if (writable || already_cow)
+        {
+            uintptr_t shared_entry = src_entry & ~WRITABLE;
+            shared_entry |= SYSCALL_PTE_COW;
+
+            uint32_t delta = already_cow ? 1U : 2U;
+            if (!Syscall_cow_ref_add(src_page_phys, delta))
+            {
+                Syscall_free_user_pt(dst_pt_phys);
+                return false;
+            }
+
+            src_pt->entries[i] = shared_entry;
+            dst_pt->entries[i] = shared_entry;
+            continue;
+        }
+
+        uintptr_t dst_page_phys = Syscall_alloc_zero_page_phys();
+        if (dst_page_phys == 0)
+        {
+            Syscall_free_user_pt(dst_pt_phys);
+            return false;
+        }
+
+        memcpy((void*) P2V(dst_page_phys), (const void*) P2V(src_page_phys), SYSCALL_PAGE_SIZE);
+        dst_pt->entries[i] = (src_entry & ~FRAME) | dst_page_phys;
+    }
+
+    *out_dst_pt_phys = dst_pt_phys;
+    return true;
+}
+
+static bool Syscall_clone_user_pdt(uintptr_t src_cr3_phys, uintptr_t src_pdt_phys, uintptr_t* out_dst_pdt_phys)
+{
+    if (!out_dst_pdt_phys || src_pdt_phys == 0)
+        return false;
+
+    uintptr_t dst_pdt_phys = Syscall_alloc_zero_page_phys();
+    if (dst_pdt_phys == 0)
+        return false;
+
+    PDT_t* src_pdt = (PDT_t*) P2V(src_pdt_phys);
+    PDT_t* dst_pdt = (PDT_t*) P2V(dst_pdt_phys);
+    for (uint32_t i = 0; i < 512; i++)
+    {
+        uintptr_t src_entry = src_pdt->entries[i];
+        if ((src_entry & PRESENT) == 0)
+        {
+            if (Syscall_pde_is_lazy_huge(src_entry))
+                dst_pdt->entries[i] = src_entry;
+            continue;
+        }
+        // A 2 MiB page is shared COW 4 KiB at a time: split it in the parent first.
+        if ((src_entry & SYSCALL_PTE_PS) != 0)
+        {
+            if (!Syscall_thp_split_pde(src_cr3_phys, &src_pdt->entries[i]))
+            {
+                Syscall_free_user_pdt(dst_pdt_phys);
+                return false;
+            }
+            src_entry = src_pdt->entries[i];
+        }
+
+        uintptr_t dst_pt_phys = 0;
+        if (!Syscall_clone_user_pt(src_entry & FRAME, &dst_pt_phys))
+        {
+            Syscall_free_user_pdt(dst_pdt_phys);
+            return false;
+        }
+
+        dst_pdt->entries[i] = (src_entry & ~FRAME) | dst_pt_phys;
+    }
+
+    *out_dst_pdt_phys = dst_pdt_phys;
+    return true;
+}
+
+static bool Syscall_clone_user_pdpt(uintptr_t src_cr3_phys, uintptr_t src_pdpt_phys, uintptr_t* out_dst_pdpt_phys)
+{
+    if (!out_dst_pdpt_phys || src_pdpt_phys == 0)
+        return false;
+
+    uintptr_t dst_pdpt_phys = Syscall_alloc_zero_page_phys();
+    if (dst_pdpt_phys == 0)
+        return false;
+
+    PDPT_t* src_pdpt = (PDPT_t*) P2V(src_pdpt_phys);
+    PDPT_t* dst_pdpt = (PDPT_t*) P2V(dst_pdpt_phys);
+    for (uint32_t i = 0; i < 512; i++)
+    {
+        uintptr_t src_entry = src_pdpt->entries[i];
+        if ((src_entry & PRESENT) == 0)
+            continue;
+        if ((src_entry & SYSCALL_PTE_PS) != 0)
+        {
             Syscall_free_user_pdpt(dst_pdpt_phys);
             return false;
         }
 
         uintptr_t dst_pdt_phys = 0;
-        if (!Syscall_clone_user_pdt(src_entry & FRAME, &dst_pdt_phys))
+        if (!Syscall_clone_user_pdt(src_cr3_phys, src_entry & FRAME, &dst_pdt_phys))
         {
             Syscall_free_user_pdpt(dst_pdpt_phys);
             return false;
@@ -3829,6 +4487,11 @@ static bool Syscall_create_kernel_mirrored_address_space(uintptr_t src_cr3_phys,
     uintptr_t dst_cr3_phys = Syscall_alloc_zero_page_phys();
     if (dst_cr3_phys == 0)
         return false;
+    if (!Syscall_mm_create(dst_cr3_phys, src_cr3_phys))
+    {
+        PMM_dealloc_page((void*) dst_cr3_phys);
+        return false;
+    }
 
     PML4_t* src_pml4 = (PML4_t*) P2V(src_cr3_phys);
     PML4_t* dst_pml4 = (PML4_t*) P2V(dst_cr3_phys);
@@ -3851,6 +4514,9 @@ static bool Syscall_clone_address_space(uintptr_t src_cr3_phys, uintptr_t* out_d
     if (!Syscall_create_kernel_mirrored_address_space(src_cr3_phys, &dst_cr3_phys))
         return false;
 
+    // The parent's tables hold still meanwhile: its other threads and the swap-out pass wait.
+    spinlock_t* src_vm_lock = Syscall_vm_lock(src_cr3_phys);
+    spin_lock(src_vm_lock);
     PML4_t* src_pml4 = (PML4_t*) P2V(src_cr3_phys);
     PML4_t* dst_pml4 = (PML4_t*) P2V(dst_cr3_phys);
     for (uint32_t i = 0; i < VMM_HHDM_PML4_INDEX; i++)
@@ -3860,8 +4526,10 @@ static bool Syscall_clone_address_space(uintptr_t src_cr3_phys, uintptr_t* out_d
             continue;
 
         uintptr_t dst_pdpt_phys = 0;
-        if (!Syscall_clone_user_pdpt(src_entry & FRAME, &dst_pdpt_phys))
+        if (!Syscall_clone_user_pdpt(src_cr3_phys, src_entry & FRAME, &dst_pdpt_phys))
         {
+            // Unlocked first: the child's vm_lock may be the same bucket.
+            spin_unlock(src_vm_lock);
             Syscall_free_address_space(dst_cr3_phys);
             return false;
         }
@@ -3869,14 +4537,29 @@ static bool Syscall_clone_address_space(uintptr_t src_cr3_phys, uintptr_t* out_d
         dst_pml4->entries[i] = (src_entry & ~FRAME) | dst_pdpt_phys;
     }
 
-    if (src_cr3_phys == Syscall_read_cr3_phys())
-        Syscall_write_cr3_phys(src_cr3_phys);
+    // Parent pages just turned read-only for COW: no CPU may keep writable entries for them.
+    VMM_flush_address_space(src_cr3_phys);
+
+    // The child maps what the parent maps, COW pages on both sides, with the same tables.
+    const syscall_mm_t* src_mm = Syscall_mm_get(src_cr3_phys);
+    syscall_mm_t* dst_mm = Syscall_mm_get(dst_cr3_phys);
+    if (src_mm && dst_mm)
+    {
+        dst_mm->vm_pages = __atomic_load_n(&src_mm->vm_pages, __ATOMIC_RELAXED);
+        dst_mm->anon_pages = __atomic_load_n(&src_mm->anon_pages, __ATOMIC_RELAXED);
+        dst_mm->file_pages = __atomic_load_n(&src_mm->file_pages, __ATOMIC_RELAXED);
+        dst_mm->shared_pages = __atomic_load_n(&src_mm->shared_pages, __ATOMIC_RELAXED);
+        dst_mm->pt_pages = __atomic_load_n(&src_mm->pt_pages, __ATOMIC_RELAXED);
+        dst_mm->swap_pages = __atomic_load_n(&src_mm->swap_pages, __ATOMIC_RELAXED);
+    }
+    spin_unlock(src_vm_lock);
 
     *out_dst_cr3_phys = dst_cr3_phys;
     return true;
 }
 
-static bool Syscall_map_user_range_current(uintptr_t base, size_t size)
+// kind is what the new pages are charged as; a page two segments share is charged once.
+static bool Syscall_map_user_range_current(uintptr_t base, size_t size, uint32_t kind)
 {
     if (size == 0)
         return true;
@@ -3887,18 +4570,37 @@ static bool Syscall_map_user_range_current(uintptr_t base, size_t size)
 
     uintptr_t start = base & ~(uintptr_t) (SYSCALL_PAGE_SIZE - 1U);
     uintptr_t end = Syscall_align_up_page(end_raw);
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    syscall_mm_t* mm = Syscall_mm_get(current_cr3);
 
     for (uintptr_t page = start; page < end; page += SYSCALL_PAGE_SIZE)
     {
         uintptr_t phys = 0;
         if (!VMM_virt_to_phys(page, &phys))
         {
-            uintptr_t new_page = (uintptr_t) PMM_alloc_page();
+            if (!Syscall_mm_reserve_vm(mm, 1U))
+                return false;
+            if (!Syscall_mm_charge(mm, kind, 1U))
+            {
+                Syscall_mm_release_vm(mm, 1U);
+                return false;
+            }
+
+            uintptr_t new_page = (uintptr_t) PMM_alloc_zeroed_page();
             if (new_page == 0)
+            {
+                Syscall_mm_uncharge(mm, kind, 1U);
+                Syscall_mm_release_vm(mm, 1U);
                 return false;
+            }
 
+            // Built here rather than inside the VMM so the new tables are counted.
+            (void) Syscall_user_pte_alloc(current_cr3, page);
             VMM_map_user_page(page, new_page);
-            memset((void*) P2V(new_page), 0, SYSCALL_PAGE_SIZE);
+
+            uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, page);
+            if (pte && kind == SYSCALL_MM_FILE)
+                *pte |= SYSCALL_PTE_FILE;
         }
         else if (!VMM_is_user_accessible(page))
             return false;
@@ -3907,6 +4609,23 @@ static bool Syscall_map_user_range_current(uintptr_t base, size_t size)
     return true;
 }
 
+// The clock page libc reads instead of calling SYS_TICK_GET/SYS_RTC_TIME_GET: user read-only, no exec.
+static bool Syscall_map_vvar_current(void)
+{
+    uintptr_t vvar_phys = VDSO_get_vvar_phys();
+    if (vvar_phys == 0)
+        return false;
+
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    (void) Syscall_user_pte_alloc(current_cr3, SYS_VVAR_ADDR);
+    VMM_map_page_flags(SYS_VVAR_ADDR, vvar_phys, USER_MODE | NO_EXECUTE);
+    uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, SYS_VVAR_ADDR);
+    if (!pte)
+        return false;
+    *pte |= SYSCALL_PTE_VVAR;
+    return VMM_update_page_flags(SYS_VVAR_ADDR, 0, WRITABLE);
+}
+
 static bool Syscall_zero_user_phys(uintptr_t user_dst, size_t size)
 {
     if (size == 0)
@@ -4177,7 +4896,7 @@ static bool Syscall_load_elf_segment_current(const uint8_t* elf_image,
     if (writable && executable)
         return false;
 
-    if (!Syscall_map_user_range_current(seg_base, (size_t) phdr->p_memsz))
+    if (!Syscall_map_user_range_current(seg_base, (size_t) phdr->p_memsz, SYSCALL_MM_FILE))
         return false;
     if (!Syscall_zero_user_phys(seg_base, (size_t) phdr->p_memsz))
         return false;
@@ -5192,7 +5911,7 @@ static bool Syscall_load_elf_current(const char* path, uintptr_t* out_entry, uin
     kdebug_puts("[USER] exec loader: protections applied\n");
 
     uintptr_t stack_bottom = SYSCALL_ELF_STACK_TOP - SYSCALL_ELF_STACK_SIZE;
-    if (!Syscall_map_user_range_current(stack_bottom, SYSCALL_ELF_STACK_SIZE))
+    if (!Syscall_map_user_range_current(stack_bottom, SYSCALL_ELF_STACK_SIZE, SYSCALL_MM_ANON))
     {
         kdebug_printf("[USER] exec reject '%s': failed to map user stack (%llu bytes)\n",
                       path,
@@ -5200,6 +5919,12 @@ static bool Syscall_load_elf_current(const char* path, uintptr_t* out_entry, uin
         goto fail;
     }
 
+    if (!Syscall_map_vvar_current())
+    {
+        kdebug_printf("[USER] exec reject '%s': failed to map the vvar page\n", path);
+        goto fail;
+    }
+
     *out_entry = modules[0].entry;
     *out_rsp = SYSCALL_ELF_STACK_TOP & ~(uintptr_t) 0xFULL;
     kdebug_puts("[USER] exec loader: stack mapped\n");
@@ -5343,51 +6068,587 @@ static void Syscall_fd_cleanup_owner(uint32_t owner_pid)
             continue;
         }
 
-        if (entry_type != SYSCALL_FD_TYPE_REGULAR)
+        if (entry_type == SYSCALL_FD_TYPE_PIPE)
+        {
+            uint32_t pipe_id = entry->net_socket_id;
+            bool was_reader = entry->can_read;
+            bool was_writer = entry->can_write;
+            memset(entry, 0, sizeof(*entry));
+            spin_unlock(&Syscall_state.fd_lock);
+            Syscall_pipe_close_end(pipe_id, was_reader, was_writer);
+            continue;
+        }
+
+        if (entry_type != SYSCALL_FD_TYPE_REGULAR)
+        {
+            memset(entry, 0, sizeof(*entry));
+            spin_unlock(&Syscall_state.fd_lock);
+            continue;
+        }
+
+        entry->io_busy = true;
+        if (entry->can_write && entry->dirty)
+        {
+            should_flush = true;
+            flush_size = entry->size;
+            flush_data = entry->data;
+            memcpy(flush_path, entry->path, sizeof(flush_path));
+        }
+        spin_unlock(&Syscall_state.fd_lock);
+
+        if (should_flush)
+        {
+            size_t block_size = VFS_block_size();
+            if (VFS_is_ready() && block_size != 0U && flush_size <= block_size)
+                (void) VFS_write_file(flush_path, flush_data, flush_size);
+        }
+
+        spin_lock(&Syscall_state.fd_lock);
+        entry = &Syscall_state.fds[i];
+        if (entry->used && entry->owner_pid == owner_pid)
+        {
+            if (entry->data)
+                kfree(entry->data);
+            memset(entry, 0, sizeof(*entry));
+        }
+        spin_unlock(&Syscall_state.fd_lock);
+    }
+}
+
+static int32_t Syscall_proc_alloc_locked(void)
+{
+    for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
+    {
+        if (!Syscall_state.procs[i].used &&
+            __atomic_load_n(&Syscall_state.slot_reclaim_pending[i], __ATOMIC_ACQUIRE) == 0U)
+            return (int32_t) i;
+    }
+
+    return -1;
+}
+
+static uint32_t Syscall_pid_hash(uint32_t pid)
+{
+    return (pid * 2654435761U) & (SYSCALL_PID_HASH_BUCKETS - 1U);
+}
+
+// Chains are changed under proc_lock and walked under RCU only, so links are published with release.
+static void Syscall_pid_hash_insert_locked(uint32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    uint32_t bucket = Syscall_pid_hash(proc->pid);
+    proc->pid_hash_next = Syscall_state.pid_hash[bucket];
+    __atomic_store_n(&Syscall_state.pid_hash[bucket], slot, __ATOMIC_RELEASE);
+}
+
+static void Syscall_pid_hash_remove_locked(uint32_t slot)
+{
+    uint32_t* link = &Syscall_state.pid_hash[Syscall_pid_hash(Syscall_state.procs[slot].pid)];
+    while (*link != SYSCALL_PROC_NONE)
+    {
+        if (*link == slot)
+        {
+            __atomic_store_n(link, Syscall_state.procs[slot].pid_hash_next, __ATOMIC_RELEASE);
+            return;
+        }
+        link = &Syscall_state.procs[*link].pid_hash_next;
+    }
+}
+
+static void Syscall_proc_slot_reclaim_rcu(void* context)
+{
+    __atomic_store_n(&Syscall_state.slot_reclaim_pending[(uintptr_t) context], 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Free an exited slot. It leaves the pid hash at once but keeps its chain link, and is not
+ * handed out again before every lookup that may still stand on it has left its RCU section.
+ */
+static void Syscall_proc_release_slot_locked(uint32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    Syscall_pid_hash_remove_locked(slot);
+    uint32_t hash_next = proc->pid_hash_next;
+    memset(proc, 0, sizeof(*proc));
+    proc->pid_hash_next = hash_next;
+
+    __atomic_store_n(&Syscall_state.slot_reclaim_pending[slot], 1, __ATOMIC_RELAXED);
+    if (!RCU_call(Syscall_proc_slot_reclaim_rcu, (void*) (uintptr_t) slot))
+        __atomic_store_n(&Syscall_state.slot_reclaim_pending[slot], 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Find the live slot of pid without proc_lock. The answer is only a hint: the slot may exit
+ * right after, so callers that act on it check it again under the lock they need.
+ */
+static int32_t Syscall_pid_lookup_rcu(uint32_t pid)
+{
+    int32_t found = -1;
+    RCU_read_lock();
+    uint32_t slot = __atomic_load_n(&Syscall_state.pid_hash[Syscall_pid_hash(pid)], __ATOMIC_ACQUIRE);
+    for (uint32_t hops = 0; slot < SYSCALL_MAX_PROCS && hops < SYSCALL_MAX_PROCS; hops++)
+    {
+        const syscall_process_t* proc = &Syscall_state.procs[slot];
+        if (__atomic_load_n(&proc->used, __ATOMIC_ACQUIRE) && __atomic_load_n(&proc->pid, __ATOMIC_RELAXED) == pid)
+        {
+            found = (int32_t) slot;
+            break;
+        }
+        slot = __atomic_load_n(&proc->pid_hash_next, __ATOMIC_ACQUIRE);
+    }
+    RCU_read_unlock();
+    return found;
+}
+
+// Link slot after `after` (SYSCALL_PROC_NONE = at the head).
+static void Syscall_proc_list_insert_after_locked(syscall_proc_list_t* list, uint32_t after, uint32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    proc->rq_prev = after;
+    proc->rq_next = (after != SYSCALL_PROC_NONE) ? Syscall_state.procs[after].rq_next : list->head;
+    if (after != SYSCALL_PROC_NONE)
+        Syscall_state.procs[after].rq_next = slot;
+    else
+        list->head = slot;
+    if (proc->rq_next != SYSCALL_PROC_NONE)
+        Syscall_state.procs[proc->rq_next].rq_prev = slot;
+    else
+        list->tail = slot;
+    __atomic_store_n(&list->count, list->count + 1U, __ATOMIC_RELAXED);
+}
+
+static void Syscall_proc_list_push_tail_locked(syscall_proc_list_t* list, uint32_t slot)
+{
+    Syscall_proc_list_insert_after_locked(list, list->tail, slot);
+}
+
+static void Syscall_proc_list_remove_locked(syscall_proc_list_t* list, uint32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    if (proc->rq_prev != SYSCALL_PROC_NONE)
+        Syscall_state.procs[proc->rq_prev].rq_next = proc->rq_next;
+    else
+        list->head = proc->rq_next;
+    if (proc->rq_next != SYSCALL_PROC_NONE)
+        Syscall_state.procs[proc->rq_next].rq_prev = proc->rq_prev;
+    else
+        list->tail = proc->rq_prev;
+    proc->rq_prev = SYSCALL_PROC_NONE;
+    proc->rq_next = SYSCALL_PROC_NONE;
+    __atomic_store_n(&list->count, list->count - 1U, __ATOMIC_RELAXED);
+}
+
+// Linux nice-to-weight table: each nice step is worth roughly 10% of CPU time.
+static const uint32_t Syscall_sched_nice_weight[40] =
+{
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+    9548,  7620,  6100,  4904,  3906,  3121,  2501,  1991,  1586,  1277,
+    1024,  820,   655,   526,   423,   335,   272,   215,   172,   137,
+    110,   87,    70,    56,    45,    36,    29,    23,    18,    15
+};
+
+static inline bool Syscall_proc_is_rt(const syscall_process_t* proc)
+{
+    return proc->sched_policy == SYS_SCHED_FIFO || proc->sched_policy == SYS_SCHED_RR;
+}
+
+static uint32_t Syscall_sched_weight_from_nice(int32_t nice)
+{
+    if (nice < SYS_NICE_MIN)
+        nice = SYS_NICE_MIN;
+    if (nice > SYS_NICE_MAX)
+        nice = SYS_NICE_MAX;
+    return Syscall_sched_nice_weight[nice - SYS_NICE_MIN];
+}
+
+static bool Syscall_proc_cpu_allowed(const syscall_process_t* proc, uint32_t cpu_index)
+{
+    if (cpu_index >= SYS_SCHED_CPUSET_WORDS * 64U)
+        return false;
+    return (proc->cpu_mask[cpu_index / 64U] & (1ULL << (cpu_index % 64U))) != 0ULL;
+}
+
+// Scheduling attributes of a new process: inherited across fork and thread creation.
+static void Syscall_sched_inherit_locked(syscall_process_t* proc, const syscall_process_t* parent)
+{
+    if (parent)
+    {
+        proc->sched_policy = parent->sched_policy;
+        proc->rt_priority = parent->rt_priority;
+        proc->nice = parent->nice;
+        proc->sched_weight = parent->sched_weight;
+        memcpy(proc->cpu_mask, parent->cpu_mask, sizeof(proc->cpu_mask));
+    }
+    else
+    {
+        proc->sched_policy = SYS_SCHED_OTHER;
+        proc->rt_priority = 0;
+        proc->nice = 0;
+        proc->sched_weight = SYSCALL_SCHED_NICE_0_WEIGHT;
+        memset(proc->cpu_mask, 0xFF, sizeof(proc->cpu_mask));
+    }
+    proc->sched_yielded = false;
+    proc->vruntime = 0;
+    proc->exec_start_tsc = 0;
+}
+
+// Move the clock of a running process forward: CPU time by mode, and vruntime for fair threads.
+static void Syscall_sched_charge(syscall_process_t* proc, uint64_t now)
+{
+    uint64_t delta = now - proc->exec_start_tsc;
+    proc->exec_start_tsc = now;
+    if (proc->in_kernel)
+        proc->stime_tsc += delta;
+    else
+        proc->utime_tsc += delta;
+    if (Syscall_proc_is_rt(proc))
+        return;
+
+    uint32_t weight = proc->sched_weight ? proc->sched_weight : SYSCALL_SCHED_NICE_0_WEIGHT;
+    proc->vruntime += (weight == SYSCALL_SCHED_NICE_0_WEIGHT) ?
+                      delta : (delta * SYSCALL_SCHED_NICE_0_WEIGHT) / weight;
+}
+
+// Charge the current process of cpu_index for the cycles it ran since it was last accounted.
+static void Syscall_sched_update_curr_locked(uint32_t cpu_index)
+{
+    uint32_t slot = Syscall_state.cpu_current_proc[cpu_index];
+    if (slot >= SYSCALL_MAX_PROCS)
+        return;
+
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    if (!proc->used || proc->exec_start_tsc == 0)
+        return;
+
+    Syscall_sched_charge(proc, x86_rdtsc());
+    if (Syscall_proc_is_rt(proc))
+        return;
+
+    // min_vruntime follows the least advanced fair thread of the CPU and never goes back.
+    syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[cpu_index];
+    uint64_t floor = proc->vruntime;
+    if (rq->fair.head != SYSCALL_PROC_NONE && Syscall_state.procs[rq->fair.head].vruntime < floor)
+        floor = Syscall_state.procs[rq->fair.head].vruntime;
+    if (floor > rq->min_vruntime)
+        rq->min_vruntime = floor;
+}
+
+// Keep the lag of a fair thread relative to its CPU when it moves to another one.
+static void Syscall_sched_migrate_vruntime_locked(syscall_process_t* proc, uint32_t from_cpu, uint32_t to_cpu)
+{
+    if (from_cpu >= 256 || to_cpu >= 256 || from_cpu == to_cpu || Syscall_proc_is_rt(proc))
+        return;
+
+    uint64_t from_min = Syscall_state.cpu_runqueue[from_cpu].min_vruntime;
+    uint64_t to_min = Syscall_state.cpu_runqueue[to_cpu].min_vruntime;
+    uint64_t lag = (proc->vruntime > from_min) ? (proc->vruntime - from_min) : 0ULL;
+    proc->vruntime = to_min + lag;
+}
+
+// Fair list is sorted by vruntime: woken threads usually land at the head, requeued ones near the tail.
+static void Syscall_rq_fair_insert_locked(syscall_cpu_runqueue_t* rq, uint32_t slot)
+{
+    uint64_t vruntime = Syscall_state.procs[slot].vruntime;
+    uint32_t head = rq->fair.head;
+    if (head == SYSCALL_PROC_NONE || vruntime < Syscall_state.procs[head].vruntime)
+    {
+        Syscall_proc_list_insert_after_locked(&rq->fair, SYSCALL_PROC_NONE, slot);
+        return;
+    }
+
+    uint32_t after = rq->fair.tail;
+    while (after != SYSCALL_PROC_NONE && Syscall_state.procs[after].vruntime > vruntime)
+        after = Syscall_state.procs[after].rq_prev;
+    Syscall_proc_list_insert_after_locked(&rq->fair, after, slot);
+}
+
+/*
+ * Queue slot on cpu_index. Real-time threads go to the tail of their priority level, or back
+ * to its head when they were preempted rather than gave the CPU away.
+ */
+static void Syscall_rq_enqueue_locked(uint32_t cpu_index, uint32_t slot, bool rt_at_head)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[cpu_index];
+    proc->run_state = SYSCALL_RUN_STATE_QUEUED;
+    proc->rq_cpu = cpu_index;
+    proc->state_since_tsc = x86_rdtsc();
+    if (Syscall_proc_is_rt(proc))
+    {
+        syscall_proc_list_t* list = &rq->rt[proc->rt_priority];
+        if (rt_at_head)
+            Syscall_proc_list_insert_after_locked(list, SYSCALL_PROC_NONE, slot);
+        else
+            Syscall_proc_list_push_tail_locked(list, slot);
+        rq->rt_bitmap |= 1U << proc->rt_priority;
+    }
+    else
+        Syscall_rq_fair_insert_locked(rq, slot);
+
+    __atomic_store_n(&rq->nr_queued, rq->nr_queued + 1U, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&Syscall_state.queued_total, 1U, __ATOMIC_RELAXED);
+}
+
+// Queue a thread coming back from a wait: it must not bank the CPU time it missed while asleep.
+static void Syscall_rq_enqueue_wakeup_locked(uint32_t cpu_index, uint32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    uint64_t floor = Syscall_state.cpu_runqueue[cpu_index].min_vruntime;
+    if (proc->vruntime < floor)
+        proc->vruntime = floor;
+    Syscall_rq_enqueue_locked(cpu_index, slot, false);
+}
+
+static void Syscall_rq_block_locked(uint32_t cpu_index, uint32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    proc->run_state = SYSCALL_RUN_STATE_BLOCKED;
+    proc->rq_cpu = cpu_index;
+    proc->state_since_tsc = x86_rdtsc();
+    Syscall_proc_list_push_tail_locked(&Syscall_state.cpu_runqueue[cpu_index].blocked, slot);
+}
+
+// Take a queued or blocked slot off its per-CPU list; running slots are not on any list.
+static void Syscall_rq_dequeue_locked(uint32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[proc->rq_cpu];
+    uint64_t since = proc->state_since_tsc;
+    uint64_t waited = (since != 0ULL) ? (x86_rdtsc() - since) : 0ULL;
+    proc->state_since_tsc = 0;
+    if (proc->run_state == SYSCALL_RUN_STATE_QUEUED)
+    {
+        proc->wait_tsc += waited;
+        if (Syscall_proc_is_rt(proc))
+        {
+            syscall_proc_list_t* list = &rq->rt[proc->rt_priority];
+            Syscall_proc_list_remove_locked(list, slot);
+            if (list->head == SYSCALL_PROC_NONE)
+                rq->rt_bitmap &= ~(1U << proc->rt_priority);
+        }
+        else
+            Syscall_proc_list_remove_locked(&rq->fair, slot);
+        __atomic_store_n(&rq->nr_queued, rq->nr_queued - 1U, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&Syscall_state.queued_total, 1U, __ATOMIC_RELAXED);
+    }
+    else if (proc->run_state == SYSCALL_RUN_STATE_BLOCKED)
+    {
+        proc->blocked_tsc += waited;
+        Syscall_proc_list_remove_locked(&rq->blocked, slot);
+    }
+    proc->run_state = SYSCALL_RUN_STATE_NONE;
+}
+
+// Load seen by the balancer: queued threads plus the one on the CPU. Read without proc_lock.
+static uint32_t Syscall_rq_depth_cpu(uint32_t cpu_index)
+{
+    if (cpu_index >= 256)
+        return 0;
+
+    uint32_t depth = __atomic_load_n(&Syscall_state.cpu_runqueue[cpu_index].nr_queued, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&Syscall_state.cpu_current_proc[cpu_index], __ATOMIC_RELAXED) < SYSCALL_MAX_PROCS)
+        depth++;
+    return depth;
+}
+
+static uint32_t Syscall_owner_run_hash(uint32_t owner_pid)
+{
+    return (owner_pid * 2654435761U) & (SYSCALL_OWNER_RUN_BUCKETS - 1U);
+}
+
+static syscall_owner_run_t* Syscall_owner_run_find_locked(uint32_t owner_pid)
+{
+    uint32_t idx = Syscall_owner_run_hash(owner_pid);
+    for (uint32_t probe = 0; probe < SYSCALL_OWNER_RUN_BUCKETS; probe++)
+    {
+        syscall_owner_run_t* entry = &Syscall_state.owner_run[idx];
+        if (entry->owner_pid == 0U)
+            return NULL;
+        if (entry->owner_pid == owner_pid)
+            return entry;
+        idx = (idx + 1U) & (SYSCALL_OWNER_RUN_BUCKETS - 1U);
+    }
+
+    return NULL;
+}
+
+static void Syscall_owner_run_acquire_locked(uint32_t owner_pid)
+{
+    uint32_t idx = Syscall_owner_run_hash(owner_pid);
+    for (uint32_t probe = 0; probe < SYSCALL_OWNER_RUN_BUCKETS; probe++)
+    {
+        syscall_owner_run_t* entry = &Syscall_state.owner_run[idx];
+        if (entry->owner_pid == owner_pid)
         {
-            memset(entry, 0, sizeof(*entry));
-            spin_unlock(&Syscall_state.fd_lock);
-            continue;
+            entry->running++;
+            return;
         }
-
-        entry->io_busy = true;
-        if (entry->can_write && entry->dirty)
+        if (entry->owner_pid == 0U)
         {
-            should_flush = true;
-            flush_size = entry->size;
-            flush_data = entry->data;
-            memcpy(flush_path, entry->path, sizeof(flush_path));
+            entry->owner_pid = owner_pid;
+            entry->running = 1U;
+            return;
         }
-        spin_unlock(&Syscall_state.fd_lock);
+        idx = (idx + 1U) & (SYSCALL_OWNER_RUN_BUCKETS - 1U);
+    }
+}
 
-        if (should_flush)
+static void Syscall_owner_run_release_locked(uint32_t owner_pid)
+{
+    const uint32_t mask = SYSCALL_OWNER_RUN_BUCKETS - 1U;
+    syscall_owner_run_t* entry = Syscall_owner_run_find_locked(owner_pid);
+    if (!entry)
+        return;
+    if (entry->running > 1U)
+    {
+        entry->running--;
+        return;
+    }
+
+    // Backward-shift deletion keeps linear probing chains intact without tombstones.
+    uint32_t hole = (uint32_t) (entry - Syscall_state.owner_run);
+    uint32_t next = (hole + 1U) & mask;
+    while (Syscall_state.owner_run[next].owner_pid != 0U)
+    {
+        uint32_t home = Syscall_owner_run_hash(Syscall_state.owner_run[next].owner_pid);
+        if (((next - home) & mask) >= ((next - hole) & mask))
         {
-            size_t block_size = VFS_block_size();
-            if (VFS_is_ready() && block_size != 0U && flush_size <= block_size)
-                (void) VFS_write_file(flush_path, flush_data, flush_size);
+            Syscall_state.owner_run[hole] = Syscall_state.owner_run[next];
+            hole = next;
         }
+        next = (next + 1U) & mask;
+    }
+    Syscall_state.owner_run[hole].owner_pid = 0U;
+    Syscall_state.owner_run[hole].running = 0U;
+}
 
-        spin_lock(&Syscall_state.fd_lock);
-        entry = &Syscall_state.fds[i];
-        if (entry->used && entry->owner_pid == owner_pid)
+// Threads of one owner never run on two CPUs at once; the owner's own CPU does not count.
+static bool Syscall_proc_owner_busy_locked(const syscall_process_t* proc, uint32_t cpu_index)
+{
+    uint32_t owner = proc->owner_pid;
+    if (owner == 0U)
+        return false;
+
+    const syscall_owner_run_t* entry = Syscall_owner_run_find_locked(owner);
+    if (!entry)
+        return false;
+
+    uint32_t running = entry->running;
+    if (Syscall_state.cpu_runqueue[cpu_index].running_owner == owner)
+        running--;
+    return running != 0U;
+}
+
+// preferred_cpu when the affinity mask allows it, otherwise the least loaded allowed online CPU.
+static uint32_t Syscall_sched_select_cpu_locked(const syscall_process_t* proc, uint32_t preferred_cpu)
+{
+    if (preferred_cpu < 256 && Syscall_proc_cpu_allowed(proc, preferred_cpu))
+        return preferred_cpu;
+
+    uint32_t best_cpu = SYSCALL_PROC_NONE;
+    uint32_t best_depth = UINT32_MAX;
+    for (uint32_t cpu = 0; cpu < 256; cpu++)
+    {
+        if (!Syscall_proc_cpu_allowed(proc, cpu) || !task_cpu_is_online(cpu))
+            continue;
+
+        uint32_t depth = Syscall_rq_depth_cpu(cpu);
+        if (depth < best_depth)
         {
-            if (entry->data)
-                kfree(entry->data);
-            memset(entry, 0, sizeof(*entry));
+            best_depth = depth;
+            best_cpu = cpu;
         }
-        spin_unlock(&Syscall_state.fd_lock);
     }
+
+    return (best_cpu < 256) ? best_cpu : preferred_cpu;
 }
 
-static int32_t Syscall_proc_alloc_locked(void)
+/*
+ * Put the outgoing current process of cpu_index back on a runqueue. A real-time thread that was
+ * preempted keeps its place at the head of its level; one that yielded or used up its RR slice
+ * goes to the tail. A thread whose affinity no longer allows this CPU moves away here.
+ */
+static void Syscall_rq_requeue_prev_locked(uint32_t cpu_index, uint32_t slot)
 {
-    for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    bool rt_at_head = Syscall_proc_is_rt(proc) && !proc->sched_yielded;
+    proc->sched_yielded = false;
+
+    uint32_t target_cpu = cpu_index;
+    if (proc->kernel_rsp == 0)
+        target_cpu = Syscall_sched_select_cpu_locked(proc, cpu_index);
+    if (target_cpu != cpu_index)
     {
-        if (!Syscall_state.procs[i].used)
-            return (int32_t) i;
+        Syscall_sched_migrate_vruntime_locked(proc, cpu_index, target_cpu);
+        Syscall_rq_enqueue_locked(target_cpu, slot, false);
+        return;
     }
 
-    return -1;
+    Syscall_rq_enqueue_locked(cpu_index, slot, rt_at_head);
+}
+
+/*
+ * Make next_slot (nothing when < 0) the current process of cpu_index.
+ * The outgoing process goes back to a runqueue unless it blocked or exited.
+ */
+static void Syscall_proc_set_current_locked(uint32_t cpu_index, int32_t next_slot)
+{
+    syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[cpu_index];
+    uint32_t prev_slot = Syscall_state.cpu_current_proc[cpu_index];
+    if (next_slot >= 0 && prev_slot == (uint32_t) next_slot)
+        return;
+
+    Syscall_sched_update_curr_locked(cpu_index);
+    if (rq->running_owner != 0U)
+    {
+        Syscall_owner_run_release_locked(rq->running_owner);
+        rq->running_owner = 0U;
+    }
+
+    if (prev_slot < SYSCALL_MAX_PROCS)
+    {
+        syscall_process_t* prev = &Syscall_state.procs[prev_slot];
+        if (prev->used)
+        {
+            prev->exec_start_tsc = 0;
+            if (prev->run_state == SYSCALL_RUN_STATE_BLOCKED || prev->sched_yielded)
+                prev->nvcsw++;
+            else if (prev->run_state == SYSCALL_RUN_STATE_RUNNING)
+                prev->nivcsw++;
+            if (prev->run_state == SYSCALL_RUN_STATE_RUNNING)
+                Syscall_rq_requeue_prev_locked(cpu_index, prev_slot);
+        }
+    }
+
+    Syscall_state.cpu_current_proc[cpu_index] = SYSCALL_PROC_NONE;
+    if (next_slot < 0)
+        return;
+
+    syscall_process_t* next = &Syscall_state.procs[(uint32_t) next_slot];
+    Syscall_rq_dequeue_locked((uint32_t) next_slot);
+    next->run_state = SYSCALL_RUN_STATE_RUNNING;
+    next->rq_cpu = cpu_index;
+    next->last_cpu = cpu_index;
+    next->exec_start_tsc = x86_rdtsc();
+    Syscall_state.cpu_current_proc[cpu_index] = (uint32_t) next_slot;
+    rq->running_owner = next->owner_pid;
+    if (next->owner_pid != 0U)
+        Syscall_owner_run_acquire_locked(next->owner_pid);
+}
+
+// Queue a freshly created process, pushed away from source_cpu if it is overloaded.
+static void Syscall_rq_enqueue_new_locked(uint32_t slot, uint32_t source_cpu)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    uint32_t target_cpu = 0;
+    if (source_cpu < 256)
+        target_cpu = task_balance_pick_push_target(source_cpu, Syscall_rq_depth_cpu);
+    if (target_cpu >= 256)
+        target_cpu = 0;
+    target_cpu = Syscall_sched_select_cpu_locked(proc, target_cpu);
+
+    proc->vruntime = Syscall_state.cpu_runqueue[target_cpu].min_vruntime;
+    Syscall_rq_enqueue_locked(target_cpu, slot, false);
 }
 
 static int32_t Syscall_proc_get_current_slot_locked(uint32_t cpu_index)
@@ -5416,7 +6677,6 @@ static int32_t Syscall_proc_ensure_current_locked(uint32_t cpu_index, const sysc
 
     syscall_process_t* proc = &Syscall_state.procs[new_slot];
     memset(proc, 0, sizeof(*proc));
-    Syscall_idle_claimed_slots[(uint32_t) new_slot] = 0U;
     proc->used = true;
     proc->exiting = false;
     proc->terminated_by_signal = false;
@@ -5455,16 +6715,39 @@ static int32_t Syscall_proc_ensure_current_locked(uint32_t cpu_index, const sysc
     proc->rsp = frame->rsp;
     proc->pending_rax = 0;
     proc->last_cpu = cpu_index;
+    Syscall_sched_inherit_locked(proc, NULL);
+    proc->vruntime = Syscall_state.cpu_runqueue[cpu_index].min_vruntime;
+    Syscall_pid_hash_insert_locked((uint32_t) new_slot);
 
-    Syscall_state.cpu_current_proc[cpu_index] = (uint32_t) new_slot;
+    Syscall_proc_set_current_locked(cpu_index, new_slot);
     return new_slot;
 }
 
+/*
+ * Slot running on the calling CPU, read without proc_lock. Only this CPU changes it and it stays
+ * put for the whole syscall (parked threads resume where they blocked), so -1 only means the
+ * process has not been set up yet and the caller must go through Syscall_proc_ensure_current_locked.
+ */
+static int32_t Syscall_proc_current_slot_fast(uint32_t cpu_index)
+{
+    if (cpu_index >= 256)
+        return -1;
+
+    uint32_t slot = __atomic_load_n(&Syscall_state.cpu_current_proc[cpu_index], __ATOMIC_RELAXED);
+    if (slot >= SYSCALL_MAX_PROCS || !Syscall_state.procs[slot].used)
+        return -1;
+    return (int32_t) slot;
+}
+
 static uint32_t Syscall_proc_current_pid(uint32_t cpu_index, const syscall_frame_t* frame)
 {
     if (!Syscall_state.proc_lock_ready)
         return 0;
 
+    int32_t fast_slot = Syscall_proc_current_slot_fast(cpu_index);
+    if (fast_slot >= 0)
+        return Syscall_state.procs[fast_slot].owner_pid;
+
     uint64_t flags = spin_lock_irqsave(&Syscall_state.proc_lock);
     int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
     uint32_t pid = (slot >= 0) ? Syscall_state.procs[slot].owner_pid : 0;
@@ -5472,6 +6755,22 @@ static uint32_t Syscall_proc_current_pid(uint32_t cpu_index, const syscall_frame
     return pid;
 }
 
+static uint64_t Syscall_handle_getppid(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
+
+    int32_t fast_slot = Syscall_proc_current_slot_fast(cpu_index);
+    if (fast_slot >= 0)
+        return Syscall_state.procs[fast_slot].ppid;
+
+    uint64_t flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    uint64_t ppid = (slot >= 0) ? Syscall_state.procs[slot].ppid : (uint64_t) -1;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, flags);
+    return ppid;
+}
+
 static uint32_t Syscall_proc_current_console_sid(uint32_t cpu_index, const syscall_frame_t* frame)
 {
     if (!Syscall_state.proc_lock_ready)
@@ -5510,44 +6809,48 @@ static int32_t Syscall_console_route_find_locked(uint32_t console_sid)
 
     for (uint32_t i = 0; i < SYSCALL_MAX_CONSOLE_ROUTES; i++)
     {
-        if (!Syscall_state.console_routes[i].used)
-            continue;
-        if (Syscall_state.console_routes[i].console_sid == console_sid)
+        if (Syscall_state.console_routes[i] && Syscall_state.console_routes[i]->console_sid == console_sid)
             return (int32_t) i;
     }
 
     return -1;
 }
 
-static int32_t Syscall_console_route_alloc_locked(uint32_t owner_pid, uint32_t console_sid)
+/*
+ * Install a route the caller allocated before taking console_lock, which is held with
+ * interrupts off. On success *fresh is consumed and set to NULL; otherwise the caller
+ * frees it.
+ */
+static int32_t Syscall_console_route_alloc_locked(uint32_t owner_pid, uint32_t console_sid, syscall_console_route_t** fresh)
 {
-    if (owner_pid == 0U || console_sid == 0U)
+    if (owner_pid == 0U || console_sid == 0U || !fresh || !*fresh)
         return -1;
 
     for (uint32_t i = 0; i < SYSCALL_MAX_CONSOLE_ROUTES; i++)
     {
-        if (Syscall_state.console_routes[i].used)
+        if (Syscall_state.console_routes[i])
             continue;
-        memset(&Syscall_state.console_routes[i], 0, sizeof(Syscall_state.console_routes[i]));
-        Syscall_state.console_routes[i].used = true;
-        Syscall_state.console_routes[i].owner_pid = owner_pid;
-        Syscall_state.console_routes[i].console_sid = console_sid;
+        syscall_console_route_t* route = *fresh;
+        memset(route, 0, sizeof(*route));
+        route->owner_pid = owner_pid;
+        route->console_sid = console_sid;
+        Syscall_state.console_routes[i] = route;
+        *fresh = NULL;
         return (int32_t) i;
     }
 
     return -1;
 }
 
-static void Syscall_console_route_clear_sid(uint32_t console_sid)
+// Unhook a route; the caller kfrees it once console_lock is dropped.
+static syscall_console_route_t* Syscall_console_route_remove_locked(int32_t route_slot)
 {
-    if (!Syscall_state.console_lock_ready || console_sid == 0)
-        return;
+    if (route_slot < 0 || (uint32_t) route_slot >= SYSCALL_MAX_CONSOLE_ROUTES)
+        return NULL;
 
-    uint64_t flags = spin_lock_irqsave(&Syscall_state.console_lock);
-    int32_t slot = Syscall_console_route_find_locked(console_sid);
-    if (slot >= 0)
-        memset(&Syscall_state.console_routes[(uint32_t) slot], 0, sizeof(syscall_console_route_t));
-    spin_unlock_irqrestore(&Syscall_state.console_lock, flags);
+    syscall_console_route_t* route = Syscall_state.console_routes[(uint32_t) route_slot];
+    Syscall_state.console_routes[(uint32_t) route_slot] = NULL;
+    return route;
 }
 
 static bool Syscall_console_route_exists_for_sid(uint32_t console_sid)
@@ -5663,110 +6966,457 @@ static void Syscall_console_route_input_push_locked(syscall_console_route_t* rou
     }
 }
 
-static size_t Syscall_console_route_input_pop_locked(syscall_console_route_t* route, char* out, size_t out_size)
+static size_t Syscall_console_route_input_pop_locked(syscall_console_route_t* route, char* out, size_t out_size)
+{
+    if (!route || !out || out_size == 0U || route->in_count == 0U)
+        return 0U;
+
+    size_t copied = 0U;
+    while (copied < out_size && route->in_count > 0U)
+    {
+        out[copied++] = route->in_buffer[route->in_tail];
+        route->in_tail = (route->in_tail + 1U) % SYSCALL_CONSOLE_PTY_INPUT_SIZE;
+        route->in_count--;
+    }
+
+    if (route->in_count == 0U)
+    {
+        route->in_head = 0U;
+        route->in_tail = 0U;
+    }
+
+    return copied;
+}
+
+static bool Syscall_proc_is_runnable_locked(const syscall_process_t* p, uint32_t cpu_index)
+{
+    if (!p->used || p->cr3_phys == 0)
+        return false;
+    if (p->run_state != SYSCALL_RUN_STATE_QUEUED && p->run_state != SYSCALL_RUN_STATE_RUNNING)
+        return false;
+
+    // A parked kernel context lives on its own stack and stays pinned to the CPU that parked it.
+    if (p->kernel_rsp != 0)
+        return p->last_cpu == cpu_index;
+
+    return Syscall_proc_cpu_allowed(p, cpu_index);
+}
+
+// First thread of a runqueue list that may run here now; only a bounded prefix is looked at.
+static int32_t Syscall_rq_pick_list_locked(const syscall_proc_list_t* list, uint32_t cpu_index, uint32_t owner_filter)
+{
+    uint32_t slot = list->head;
+    for (uint32_t scanned = 0; slot != SYSCALL_PROC_NONE && scanned < SYSCALL_RQ_PICK_SCAN_MAX; scanned++)
+    {
+        const syscall_process_t* p = &Syscall_state.procs[slot];
+        if ((owner_filter == 0U || p->owner_pid == owner_filter) &&
+            Syscall_proc_is_runnable_locked(p, cpu_index) &&
+            !Syscall_proc_owner_busy_locked(p, cpu_index))
+            return (int32_t) slot;
+        slot = p->rq_next;
+    }
+
+    return -1;
+}
+
+// Best queued real-time thread of this CPU, highest priority level first.
+static int32_t Syscall_rq_pick_rt_locked(uint32_t cpu_index, uint32_t owner_filter)
+{
+    syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[cpu_index];
+    uint32_t levels = rq->rt_bitmap;
+    while (levels != 0U)
+    {
+        uint32_t prio = 31U - (uint32_t) __builtin_clz(levels);
+        int32_t slot = Syscall_rq_pick_list_locked(&rq->rt[prio], cpu_index, owner_filter);
+        if (slot >= 0)
+            return slot;
+        levels &= ~(1U << prio);
+    }
+
+    return -1;
+}
+
+typedef struct syscall_rq_steal_ctx
+{
+    uint32_t thief_cpu;
+    int32_t first_slot;
+} syscall_rq_steal_ctx_t;
+
+static bool Syscall_rq_try_steal_slot_locked(syscall_rq_steal_ctx_t* ctx, uint32_t victim_cpu, uint32_t slot)
+{
+    syscall_process_t* p = &Syscall_state.procs[slot];
+    if (p->kernel_rsp != 0 ||
+        !Syscall_proc_cpu_allowed(p, ctx->thief_cpu) ||
+        !Syscall_proc_is_runnable_locked(p, ctx->thief_cpu) ||
+        Syscall_proc_owner_busy_locked(p, ctx->thief_cpu))
+        return false;
+
+    Syscall_rq_dequeue_locked(slot);
+    Syscall_sched_migrate_vruntime_locked(p, victim_cpu, ctx->thief_cpu);
+    Syscall_rq_enqueue_locked(ctx->thief_cpu, slot, false);
+    if (ctx->first_slot < 0)
+        ctx->first_slot = (int32_t) slot;
+    return true;
+}
+
+/*
+ * task_balance_steal callback, runs under proc_lock. Real-time threads waiting behind a busy CPU
+ * are pulled first, then fair threads from the tail (the ones furthest from running there).
+ */
+static uint32_t Syscall_rq_steal_from_cpu(uint32_t victim_cpu, uint32_t batch_max, void* context)
+{
+    syscall_rq_steal_ctx_t* ctx = (syscall_rq_steal_ctx_t*) context;
+    if (victim_cpu >= 256)
+        return 0;
+
+    syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[victim_cpu];
+    uint32_t stolen = 0;
+    uint32_t scanned = 0;
+    uint32_t levels = rq->rt_bitmap;
+    while (levels != 0U && scanned < SYSCALL_RQ_PICK_SCAN_MAX && stolen < batch_max)
+    {
+        uint32_t prio = 31U - (uint32_t) __builtin_clz(levels);
+        levels &= ~(1U << prio);
+        uint32_t slot = rq->rt[prio].head;
+        while (slot != SYSCALL_PROC_NONE && scanned < SYSCALL_RQ_PICK_SCAN_MAX && stolen < batch_max)
+        {
+            uint32_t next = Syscall_state.procs[slot].rq_next;
+            if (Syscall_rq_try_steal_slot_locked(ctx, victim_cpu, slot))
+                stolen++;
+            scanned++;
+            slot = next;
+        }
+    }
+
+    uint32_t slot = rq->fair.tail;
+    while (slot != SYSCALL_PROC_NONE && scanned < SYSCALL_RQ_PICK_SCAN_MAX && stolen < batch_max)
+    {
+        uint32_t prev = Syscall_state.procs[slot].rq_prev;
+        if (Syscall_rq_try_steal_slot_locked(ctx, victim_cpu, slot))
+            stolen++;
+        scanned++;
+        slot = prev;
+    }
+
+    if (stolen != 0)
+        Syscall_state.user_steals += stolen;
+    return stolen;
+}
+
+static int32_t Syscall_rq_try_steal_locked(uint32_t cpu_index)
+{
+    if (__atomic_load_n(&Syscall_state.queued_total, __ATOMIC_RELAXED) == 0U)
+        return -1;
+
+    syscall_rq_steal_ctx_t ctx = { .thief_cpu = cpu_index, .first_slot = -1 };
+    if (!task_balance_steal(cpu_index, Syscall_rq_depth_cpu, Syscall_rq_steal_from_cpu, &ctx))
+        return -1;
+    return ctx.first_slot;
+}
+
+/*
+ * Pick what cpu_index runs next:
+ *  - a queued real-time thread beats any fair thread and lower real-time priorities;
+ *  - a real-time current keeps the CPU until it blocks, yields or its RR slice runs out;
+ *  - among fair threads the smallest vruntime wins, the current one included;
+ *  - while RT is throttled for the window, waiting fair threads go first.
+ */
+static int32_t Syscall_proc_pick_next_locked(int32_t current_slot, uint32_t cpu_index)
+{
+    uint64_t start = x86_rdtsc();
+    syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[cpu_index];
+    Syscall_sched_update_curr_locked(cpu_index);
+
+    syscall_process_t* cur = NULL;
+    if (current_slot >= 0 &&
+        Syscall_proc_is_runnable_locked(&Syscall_state.procs[(uint32_t) current_slot], cpu_index))
+        cur = &Syscall_state.procs[(uint32_t) current_slot];
+    if (cur && cur->sched_policy == SYS_SCHED_RR &&
+        Syscall_state.cpu_slice_ticks[cpu_index] >= SYSCALL_PREEMPT_QUANTUM_TICKS)
+        cur->sched_yielded = true;
+
+    bool cur_rt = cur && Syscall_proc_is_rt(cur);
+    bool yielded = cur && cur->sched_yielded;
+    int32_t rt_slot = Syscall_rq_pick_rt_locked(cpu_index, 0U);
+    int32_t fair_slot = Syscall_rq_pick_list_locked(&rq->fair, cpu_index, 0U);
+    bool throttled = rq->rt_throttled != 0U && (fair_slot >= 0 || (cur && !cur_rt));
+
+    int32_t next_slot = -1;
+    if (rt_slot >= 0 && !throttled &&
+        (!cur_rt || yielded || Syscall_state.procs[(uint32_t) rt_slot].rt_priority > cur->rt_priority))
+        next_slot = rt_slot;
+    if (next_slot < 0 && cur_rt && !yielded && !throttled)
+        next_slot = current_slot;
+    if (next_slot < 0 && fair_slot >= 0 &&
+        (!cur || yielded || cur_rt ||
+         Syscall_state.procs[(uint32_t) fair_slot].vruntime < cur->vruntime))
+        next_slot = fair_slot;
+    if (next_slot < 0 && cur)
+        next_slot = current_slot;
+    if (next_slot < 0)
+        next_slot = rt_slot;
+    if (next_slot < 0)
+        next_slot = Syscall_rq_try_steal_locked(cpu_index);
+    if (cur && next_slot == current_slot)
+        cur->sched_yielded = false;
+
+    Syscall_state.pick_next_calls++;
+    Syscall_state.pick_next_cycles += x86_rdtsc() - start;
+    return next_slot;
+}
+
+static int32_t Syscall_proc_pick_next_same_owner_locked(int32_t current_slot, uint32_t cpu_index)
+{
+    if (current_slot < 0 || (uint32_t) current_slot >= SYSCALL_MAX_PROCS)
+        return Syscall_proc_pick_next_locked(current_slot, cpu_index);
+
+    syscall_process_t* cur = &Syscall_state.procs[(uint32_t) current_slot];
+    if (!cur->used || cur->owner_pid == 0U)
+        return Syscall_proc_pick_next_locked(current_slot, cpu_index);
+
+    int32_t next_slot = Syscall_rq_pick_rt_locked(cpu_index, cur->owner_pid);
+    if (next_slot < 0)
+        next_slot = Syscall_rq_pick_list_locked(&Syscall_state.cpu_runqueue[cpu_index].fair,
+                                                cpu_index,
+                                                cur->owner_pid);
+    if (next_slot >= 0)
+        return next_slot;
+
+    if (Syscall_proc_is_runnable_locked(cur, cpu_index))
+    {
+        cur->sched_yielded = false;
+        return current_slot;
+    }
+
+    return Syscall_proc_pick_next_locked(current_slot, cpu_index);
+}
+
+// pid 0 names the calling thread; any other pid names one thread, like the Linux tid.
+static int32_t Syscall_sched_find_target_locked(uint32_t cpu_index, const syscall_frame_t* frame, int32_t pid)
+{
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+        return Syscall_proc_ensure_current_locked(cpu_index, frame);
+
+    int32_t slot = Syscall_pid_lookup_rcu((uint32_t) pid);
+    if (slot < 0 || Syscall_state.procs[slot].exiting)
+        return -1;
+    return slot;
+}
+
+// Get the CPU that runs or queues slot to pick again on its next tick.
+static void Syscall_sched_request_repick_locked(uint32_t slot)
+{
+    const syscall_process_t* proc = &Syscall_state.procs[slot];
+    uint32_t cpu = proc->rq_cpu;
+    if (cpu >= 256 || Syscall_state.cpu_current_proc[cpu] >= SYSCALL_MAX_PROCS)
+        return;
+    if (proc->run_state != SYSCALL_RUN_STATE_QUEUED && proc->run_state != SYSCALL_RUN_STATE_RUNNING)
+        return;
+
+    // The calling CPU picks again on its way out of the syscall; others on their next tick.
+    if (cpu == task_get_current_cpu_index())
+        __atomic_store_n(&Syscall_state.cpu_need_resched[cpu], 1, __ATOMIC_RELEASE);
+    else
+        __atomic_store_n(&Syscall_state.cpu_need_timer_preempt[cpu], 1, __ATOMIC_RELEASE);
+}
+
+static void Syscall_sched_set_attr_locked(uint32_t slot, uint8_t policy, uint8_t rt_priority, int32_t nice)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    bool queued = proc->run_state == SYSCALL_RUN_STATE_QUEUED;
+    uint32_t cpu = proc->rq_cpu;
+    if (queued)
+        Syscall_rq_dequeue_locked(slot);
+    else if (proc->run_state == SYSCALL_RUN_STATE_RUNNING && cpu == task_get_current_cpu_index())
+        Syscall_sched_update_curr_locked(cpu);
+
+    proc->sched_policy = policy;
+    proc->rt_priority = (policy == SYS_SCHED_OTHER) ? 0U : rt_priority;
+    proc->nice = (int8_t) nice;
+    proc->sched_weight = Syscall_sched_weight_from_nice(nice);
+
+    // A thread leaving the RT class must not come back with the vruntime it had before.
+    if (cpu < 256 && !Syscall_proc_is_rt(proc) && proc->vruntime < Syscall_state.cpu_runqueue[cpu].min_vruntime)
+        proc->vruntime = Syscall_state.cpu_runqueue[cpu].min_vruntime;
+    if (queued)
+        Syscall_rq_enqueue_locked(cpu, slot, false);
+    Syscall_sched_request_repick_locked(slot);
+}
+
+static uint64_t Syscall_handle_setpriority(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready || frame->rdi != SYS_PRIO_PROCESS)
+        return (uint64_t) -1;
+
+    int32_t nice = (int32_t) frame->rdx;
+    if (nice < SYS_NICE_MIN)
+        nice = SYS_NICE_MIN;
+    if (nice > SYS_NICE_MAX)
+        nice = SYS_NICE_MAX;
+
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_sched_find_target_locked(cpu_index, frame, (int32_t) frame->rsi);
+    if (slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
+
+    const syscall_process_t* proc = &Syscall_state.procs[(uint32_t) slot];
+    Syscall_sched_set_attr_locked((uint32_t) slot, proc->sched_policy, proc->rt_priority, nice);
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    return 0;
+}
+
+static uint64_t Syscall_handle_getpriority(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready || frame->rdi != SYS_PRIO_PROCESS)
+        return (uint64_t) -1;
+
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_sched_find_target_locked(cpu_index, frame, (int32_t) frame->rsi);
+    int32_t nice = (slot >= 0) ? Syscall_state.procs[(uint32_t) slot].nice : 0;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    if (slot < 0)
+        return (uint64_t) -1;
+
+    return (uint64_t) (20 - nice);
+}
+
+static uint64_t Syscall_handle_sched_setscheduler(uint32_t cpu_index, const syscall_frame_t* frame)
 {
-    if (!route || !out || out_size == 0U || route->in_count == 0U)
-        return 0U;
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-    size_t copied = 0U;
-    while (copied < out_size && route->in_count > 0U)
+    uint64_t policy = frame->rsi;
+    uint64_t rt_priority = frame->rdx;
+    if (policy == SYS_SCHED_OTHER)
     {
-        out[copied++] = route->in_buffer[route->in_tail];
-        route->in_tail = (route->in_tail + 1U) % SYSCALL_CONSOLE_PTY_INPUT_SIZE;
-        route->in_count--;
+        if (rt_priority != 0)
+            return (uint64_t) -1;
+    }
+    else if (policy == SYS_SCHED_FIFO || policy == SYS_SCHED_RR)
+    {
+        if (rt_priority < SYS_SCHED_RT_PRIO_MIN || rt_priority > SYS_SCHED_RT_PRIO_MAX)
+            return (uint64_t) -1;
     }
+    else
+        return (uint64_t) -1;
 
-    if (route->in_count == 0U)
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_sched_find_target_locked(cpu_index, frame, (int32_t) frame->rdi);
+    if (slot < 0)
     {
-        route->in_head = 0U;
-        route->in_tail = 0U;
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
     }
 
-    return copied;
+    Syscall_sched_set_attr_locked((uint32_t) slot,
+                                  (uint8_t) policy,
+                                  (uint8_t) rt_priority,
+                                  Syscall_state.procs[(uint32_t) slot].nice);
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    return 0;
 }
 
-static bool Syscall_proc_is_on_other_cpu_locked(uint32_t slot, uint32_t cpu_index)
+static uint64_t Syscall_handle_sched_getscheduler(uint32_t cpu_index, const syscall_frame_t* frame)
 {
-    uint32_t owner = 0U;
-    if (slot < SYSCALL_MAX_PROCS)
-    {
-        syscall_process_t* cand = &Syscall_state.procs[slot];
-        if (cand->used)
-            owner = cand->owner_pid;
-    }
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-    for (uint32_t i = 0; i < 256; i++)
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_sched_find_target_locked(cpu_index, frame, (int32_t) frame->rdi);
+    uint32_t policy = 0;
+    int32_t rt_priority = 0;
+    if (slot >= 0)
     {
-        if (i == cpu_index)
-            continue;
-
-        uint32_t running_slot = Syscall_state.cpu_current_proc[i];
-        if (running_slot >= SYSCALL_MAX_PROCS)
-            continue;
-        if (running_slot == slot)
-            return true;
-        if (owner == 0U)
-            continue;
-
-        syscall_process_t* running = &Syscall_state.procs[running_slot];
-        if (running->used && !running->exiting && running->owner_pid == owner)
-            return true;
+        policy = Syscall_state.procs[(uint32_t) slot].sched_policy;
+        rt_priority = Syscall_state.procs[(uint32_t) slot].rt_priority;
     }
-    return false;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    if (slot < 0)
+        return (uint64_t) -1;
+
+    void* user_priority = (void*) (uintptr_t) frame->rsi;
+    if (user_priority && !Syscall_copy_to_user(user_priority, &rt_priority, sizeof(rt_priority)))
+        return (uint64_t) -1;
+    return policy;
 }
 
-static int32_t Syscall_proc_pick_next_locked(int32_t current_slot, uint32_t cpu_index)
+static uint64_t Syscall_handle_sched_setaffinity(uint32_t cpu_index, const syscall_frame_t* frame)
 {
-    if (current_slot >= 0)
-    {
-        for (uint32_t step = 1; step < SYSCALL_MAX_PROCS; step++)
-        {
-            uint32_t idx = ((uint32_t) current_slot + step) % SYSCALL_MAX_PROCS;
-            syscall_process_t* p = &Syscall_state.procs[idx];
-            if (p->used && p->cr3_phys != 0 &&
-                !Syscall_proc_is_on_other_cpu_locked(idx, cpu_index))
-                return (int32_t) idx;
-        }
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-        syscall_process_t* cur = &Syscall_state.procs[(uint32_t) current_slot];
-        if (cur->used && cur->cr3_phys != 0)
-            return current_slot;
-    }
+    size_t len = (size_t) frame->rsi;
+    const void* user_mask = (const void*) (uintptr_t) frame->rdx;
+    uint64_t mask[SYS_SCHED_CPUSET_WORDS];
+    memset(mask, 0, sizeof(mask));
+    if (!user_mask || len == 0)
+        return (uint64_t) -1;
+    if (len > sizeof(mask))
+        len = sizeof(mask);
+    if (!Syscall_copy_from_user(mask, user_mask, len))
+        return (uint64_t) -1;
+
+    bool any_online = false;
+    for (uint32_t cpu = 0; cpu < SYS_SCHED_CPUSET_WORDS * 64U && !any_online; cpu++)
+        any_online = (mask[cpu / 64U] & (1ULL << (cpu % 64U))) != 0ULL && task_cpu_is_online(cpu);
+    if (!any_online)
+        return (uint64_t) -1;
 
-    for (uint32_t idx = 0; idx < SYSCALL_MAX_PROCS; idx++)
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_sched_find_target_locked(cpu_index, frame, (int32_t) frame->rdi);
+    if (slot < 0)
     {
-        syscall_process_t* p = &Syscall_state.procs[idx];
-        if (p->used && p->cr3_phys != 0 &&
-            !Syscall_proc_is_on_other_cpu_locked(idx, cpu_index))
-            return (int32_t) idx;
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
     }
 
-    return -1;
+    // Queued threads move now, running ones on their next pick; parked ones stay pinned until then.
+    syscall_process_t* proc = &Syscall_state.procs[(uint32_t) slot];
+    memcpy(proc->cpu_mask, mask, sizeof(proc->cpu_mask));
+    if (proc->run_state == SYSCALL_RUN_STATE_QUEUED && proc->kernel_rsp == 0 &&
+        !Syscall_proc_cpu_allowed(proc, proc->rq_cpu))
+    {
+        uint32_t from_cpu = proc->rq_cpu;
+        uint32_t target_cpu = Syscall_sched_select_cpu_locked(proc, from_cpu);
+        Syscall_rq_dequeue_locked((uint32_t) slot);
+        Syscall_sched_migrate_vruntime_locked(proc, from_cpu, target_cpu);
+        Syscall_rq_enqueue_locked(target_cpu, (uint32_t) slot, false);
+    }
+    else if (proc->run_state == SYSCALL_RUN_STATE_RUNNING && !Syscall_proc_cpu_allowed(proc, proc->rq_cpu))
+        Syscall_sched_request_repick_locked((uint32_t) slot);
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    return 0;
 }
 
-static int32_t Syscall_proc_pick_next_same_owner_locked(int32_t current_slot, uint32_t cpu_index)
+static uint64_t Syscall_handle_sched_getaffinity(uint32_t cpu_index, const syscall_frame_t* frame)
 {
-    if (current_slot < 0 || (uint32_t) current_slot >= SYSCALL_MAX_PROCS)
-        return Syscall_proc_pick_next_locked(current_slot, cpu_index);
-
-    const syscall_process_t* cur = &Syscall_state.procs[(uint32_t) current_slot];
-    if (!cur->used || cur->owner_pid == 0U)
-        return Syscall_proc_pick_next_locked(current_slot, cpu_index);
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-    const uint32_t owner = cur->owner_pid;
-    for (uint32_t step = 1; step < SYSCALL_MAX_PROCS; step++)
-    {
-        uint32_t idx = ((uint32_t) current_slot + step) % SYSCALL_MAX_PROCS;
-        syscall_process_t* p = &Syscall_state.procs[idx];
-        if (p->used && !p->exiting && p->cr3_phys != 0 && p->owner_pid == owner &&
-            !Syscall_proc_is_on_other_cpu_locked(idx, cpu_index))
-            return (int32_t) idx;
-    }
+    size_t len = (size_t) frame->rsi;
+    void* user_mask = (void*) (uintptr_t) frame->rdx;
+    uint64_t mask[SYS_SCHED_CPUSET_WORDS];
+    if (!user_mask || len < sizeof(uint64_t))
+        return (uint64_t) -1;
+    if (len > sizeof(mask))
+        len = sizeof(mask);
 
-    if (cur->used && cur->cr3_phys != 0)
-        return current_slot;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_sched_find_target_locked(cpu_index, frame, (int32_t) frame->rdi);
+    if (slot >= 0)
+        memcpy(mask, Syscall_state.procs[(uint32_t) slot].cpu_mask, sizeof(mask));
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    if (slot < 0)
+        return (uint64_t) -1;
 
-    return Syscall_proc_pick_next_locked(current_slot, cpu_index);
+    if (!Syscall_copy_to_user(user_mask, mask, len))
+        return (uint64_t) -1;
+    return (uint64_t) len;
 }
 
 static bool Syscall_proc_has_other_owner_peer_locked(int32_t current_slot)
@@ -5822,29 +7472,373 @@ static void Syscall_proc_save_from_interrupt(syscall_process_t* proc,
     proc->fs_base = fs_base;
 }
 
-static void Syscall_proc_load_to_interrupt(const syscall_process_t* proc, interrupt_frame_t* frame)
+static inline uintptr_t Syscall_read_rsp(void)
+{
+    uintptr_t rsp = 0;
+    __asm__ __volatile__("movq %%rsp, %0" : "=r"(rsp));
+    return rsp;
+}
+
+static uintptr_t Syscall_proc_kstack_top_locked(uint32_t slot, uint32_t cpu_index)
+{
+    if (slot >= SYSCALL_MAX_PROCS)
+        return task_get_cpu_kernel_stack(cpu_index);
+
+    // Kernel stacks follow the slot, not the pid: a reused slot keeps its stack.
+    uintptr_t base = Syscall_state.proc_kstack_base[slot];
+    if (base == 0)
+    {
+        base = (uintptr_t) kmalloc(SYSCALL_PROC_KSTACK_SIZE);
+        if (base == 0)
+            return task_get_cpu_kernel_stack(cpu_index);
+        Syscall_state.proc_kstack_base[slot] = base;
+    }
+
+    return (base + SYSCALL_PROC_KSTACK_SIZE) & ~0xFULL;
+}
+
+static bool Syscall_proc_on_own_kstack_locked(uint32_t slot)
+{
+    uintptr_t base = Syscall_state.proc_kstack_base[slot];
+    if (base == 0)
+        return false;
+
+    uintptr_t rsp = Syscall_read_rsp();
+    return rsp > base && rsp <= base + SYSCALL_PROC_KSTACK_SIZE;
+}
+
+static void Syscall_set_kernel_gs(bool in_syscall)
+{
+    task_cpu_local_t* cpu_local = task_get_cpu_local();
+    if (!cpu_local)
+        return;
+
+    // Inside a syscall GS holds the per-CPU block and KERNEL_GS_BASE the user value (0).
+    if (in_syscall)
+    {
+        MSR_set(IA32_KERNEL_GS_BASE, 0);
+        MSR_set(IA32_GS_BASE, (uint64_t) (uintptr_t) cpu_local);
+    }
+    else
+    {
+        MSR_set(IA32_GS_BASE, 0);
+        MSR_set(IA32_KERNEL_GS_BASE, (uint64_t) (uintptr_t) cpu_local);
+    }
+}
+
+static void Syscall_take_switch_cleanup_locked(uint32_t cpu_index, syscall_switch_cleanup_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    if (cpu_index >= 256)
+        return;
+
+    *out = Syscall_state.cpu_switch_cleanup[cpu_index];
+    memset(&Syscall_state.cpu_switch_cleanup[cpu_index], 0, sizeof(Syscall_state.cpu_switch_cleanup[cpu_index]));
+}
+
+static void Syscall_run_switch_cleanup(const syscall_switch_cleanup_t* cleanup, bool has_user_next)
+{
+    if (!cleanup || !cleanup->pending)
+        return;
+
+    if (cleanup->cleanup_fds)
+    {
+        Syscall_fd_cleanup_owner(cleanup->owner_pid);
+        if (cleanup->owner_pid != 0U && Syscall_kbd_hardware_capture_pid == cleanup->owner_pid)
+            Syscall_kbd_hardware_capture_pid = 0U;
+    }
+
+    if (cleanup->free_cr3 && cleanup->cr3_phys != 0)
+    {
+        uintptr_t loaded_cr3 = Syscall_read_cr3_phys();
+        if (loaded_cr3 == cleanup->cr3_phys)
+        {
+            if (has_user_next)
+                return;
+            Syscall_write_cr3_phys(VMM_get_kernel_cr3_phys());
+        }
+        Syscall_free_address_space(cleanup->cr3_phys);
+    }
+}
+
+static __attribute__((__noreturn__)) void Syscall_switch_user_entry(void)
+{
+    uint32_t cpu_index = task_get_current_cpu_index();
+    int32_t slot = Syscall_proc_get_current_slot_locked(cpu_index);
+    syscall_switch_cleanup_t cleanup;
+    Syscall_take_switch_cleanup_locked(cpu_index, &cleanup);
+    spin_unlock(&Syscall_state.proc_lock);
+
+    if (cleanup.pending)
+    {
+        __asm__ __volatile__("sti");
+        Syscall_run_switch_cleanup(&cleanup, slot >= 0);
+        __asm__ __volatile__("cli");
+    }
+
+    if (slot < 0)
+    {
+        __asm__ __volatile__("sti");
+        task_idle_loop();
+    }
+
+    // Only this CPU touches the register image of its current process.
+    const syscall_process_t* next = &Syscall_state.procs[(uint32_t) slot];
+    syscall_user_resume_context_t resume_ctx;
+    resume_ctx.rax = next->rax;
+    resume_ctx.rcx = next->rcx;
+    resume_ctx.rdx = next->rdx;
+    resume_ctx.rsi = next->rsi;
+    resume_ctx.rdi = next->rdi;
+    resume_ctx.r8 = next->r8;
+    resume_ctx.r9 = next->r9;
+    resume_ctx.r10 = next->r10;
+    resume_ctx.r11 = next->r11;
+    resume_ctx.r15 = next->r15;
+    resume_ctx.r14 = next->r14;
+    resume_ctx.r13 = next->r13;
+    resume_ctx.r12 = next->r12;
+    resume_ctx.rbp = next->rbp;
+    resume_ctx.rbx = next->rbx;
+    resume_ctx.rip = next->rip;
+    resume_ctx.rflags = next->rflags | SYSCALL_RFLAGS_IF;
+    resume_ctx.rsp = next->rsp;
+
+    Syscall_set_kernel_gs(false);
+    Syscall_resume_user_context(&resume_ctx);
+}
+
+static __attribute__((__noreturn__)) void Syscall_switch_idle_entry(void)
+{
+    uint32_t cpu_index = task_get_current_cpu_index();
+    syscall_switch_cleanup_t cleanup;
+    Syscall_take_switch_cleanup_locked(cpu_index, &cleanup);
+    spin_unlock(&Syscall_state.proc_lock);
+
+    __asm__ __volatile__("sti");
+    Syscall_run_switch_cleanup(&cleanup, false);
+    task_idle_loop();
+}
+
+static uintptr_t Syscall_kstack_prepare_entry(uintptr_t stack_top, void (*entry)(void))
+{
+    uint64_t* sp = (uint64_t*) (stack_top & ~0xFULL);
+
+    // Matches the frame popped by Syscall_kernel_context_switch: 6 callee-saved regs then RIP.
+    *--sp = 0;
+    *--sp = (uint64_t) (uintptr_t) entry;
+    for (uint32_t i = 0; i < 6U; i++)
+        *--sp = 0;
+
+    return (uintptr_t) sp;
+}
+
+/*
+ * Hand this CPU to next_slot (or to the idle loop when next_slot < 0) with proc_lock held.
+ * The lock is released by whatever context we land in, once it no longer runs on our stack,
+ * so no other CPU can pick up a process whose kernel stack is still in use here.
+ * Returns only when prev_slot (a parked process) is switched back in.
+ */
+static void Syscall_proc_switch_locked(uint32_t cpu_index, int32_t prev_slot, int32_t next_slot)
+{
+    uintptr_t discard_rsp = 0;
+    uintptr_t* save_rsp = &discard_rsp;
+    if (prev_slot >= 0)
+        save_rsp = &Syscall_state.procs[(uint32_t) prev_slot].kernel_rsp;
+
+    Syscall_state.cpu_slice_ticks[cpu_index] = 0;
+    Syscall_proc_set_current_locked(cpu_index, next_slot);
+    if (next_slot < 0)
+    {
+        // The idle loop keeps the address space loaded: shootdowns leave it a pending flush.
+        VMM_tlb_enter_lazy(cpu_index);
+        uintptr_t idle_top = task_get_cpu_kernel_stack(cpu_index);
+        task_set_user_kernel_stack(cpu_index, idle_top);
+        Syscall_kernel_context_switch(save_rsp, Syscall_kstack_prepare_entry(idle_top, Syscall_switch_idle_entry));
+        return;
+    }
+
+    syscall_process_t* next = &Syscall_state.procs[(uint32_t) next_slot];
+    uintptr_t kstack_top = Syscall_proc_kstack_top_locked((uint32_t) next_slot, cpu_index);
+    task_set_user_kernel_stack(cpu_index, kstack_top);
+    VMM_tlb_leave_lazy(cpu_index);
+    if (next->cr3_phys != Syscall_read_cr3_phys())
+        VMM_switch_cr3(cpu_index, next->cr3_phys);
+    if (next->fs_base != Syscall_read_fs_base())
+        Syscall_write_fs_base(next->fs_base);
+
+    uintptr_t next_rsp = next->kernel_rsp;
+    if (next_rsp != 0)
+    {
+        next->kernel_rsp = 0;
+        Syscall_set_kernel_gs(true);
+        Syscall_kernel_context_switch(save_rsp, next_rsp);
+        return;
+    }
+
+    Syscall_kernel_context_switch(save_rsp, Syscall_kstack_prepare_entry(kstack_top, Syscall_switch_user_entry));
+}
+
+static void Syscall_proc_unblock_locked(uint32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    if (proc->run_state != SYSCALL_RUN_STATE_BLOCKED)
+        return;
+
+    // Parked contexts are pinned: requeue on the CPU that parked it.
+    uint32_t cpu = proc->rq_cpu;
+    Syscall_rq_dequeue_locked(slot);
+    proc->block_waiter = NULL;
+    proc->block_deadline = 0;
+    Syscall_rq_enqueue_wakeup_locked(cpu, slot);
+    Syscall_debug_unblock_count++;
+
+    // Get the pinned CPU to look at its runqueue on its next tick if it is busy with user code.
+    if (cpu < 256 && Syscall_state.cpu_current_proc[cpu] < SYSCALL_MAX_PROCS)
+        __atomic_store_n(&Syscall_state.cpu_need_timer_preempt[cpu], 1, __ATOMIC_RELEASE);
+}
+
+bool Syscall_block_current(task_waiter_t* waiter, uint64_t timeout_ticks, bool* out_signaled)
+{
+    if (!waiter || !out_signaled || !Syscall_state.proc_lock_ready)
+        return false;
+
+    uint32_t cpu_index = task_get_current_cpu_index();
+    if (cpu_index >= 256 || task_get_preempt_count_cpu(cpu_index) != 0)
+        return false;
+
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_get_current_slot_locked(cpu_index);
+    if (slot < 0 || !Syscall_proc_on_own_kstack_locked((uint32_t) slot))
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return false;
+    }
+
+    syscall_process_t* proc = &Syscall_state.procs[(uint32_t) slot];
+    if (proc->exiting)
+    {
+        __atomic_store_n(&waiter->interrupted, 1, __ATOMIC_RELEASE);
+        *out_signaled = __atomic_load_n(&waiter->signaled, __ATOMIC_ACQUIRE) != 0;
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return true;
+    }
+
+    waiter->parked_slot = (uint32_t) slot;
+    __atomic_store_n(&waiter->parked, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&waiter->signaled, __ATOMIC_SEQ_CST) == 0)
+    {
+        uint64_t deadline = 0;
+        if (timeout_ticks != TASK_WAIT_TIMEOUT_INFINITE)
+        {
+            uint64_t now = ISR_get_timer_ticks();
+            deadline = (UINT64_MAX - now < timeout_ticks) ? UINT64_MAX : (now + timeout_ticks);
+        }
+
+        proc->block_waiter = waiter;
+        proc->block_deadline = deadline;
+        proc->last_cpu = cpu_index;
+        Syscall_rq_block_locked(cpu_index, (uint32_t) slot);
+        Syscall_debug_block_count++;
+
+        int32_t next_slot = Syscall_proc_pick_next_locked(slot, cpu_index);
+        Syscall_proc_switch_locked(cpu_index, slot, next_slot);
+    }
+
+    // Back on this CPU (parked contexts are pinned) with proc_lock held by whoever switched us in.
+    __atomic_store_n(&waiter->parked, 0, __ATOMIC_RELEASE);
+    if (proc->exiting)
+        __atomic_store_n(&waiter->interrupted, 1, __ATOMIC_RELEASE);
+
+    syscall_switch_cleanup_t cleanup;
+    Syscall_take_switch_cleanup_locked(cpu_index, &cleanup);
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    Syscall_run_switch_cleanup(&cleanup, true);
+
+    *out_signaled = __atomic_load_n(&waiter->signaled, __ATOMIC_ACQUIRE) != 0;
+    return true;
+}
+
+void Syscall_wake_parked(uint32_t slot, const task_waiter_t* waiter)
+{
+    if (!Syscall_state.proc_lock_ready || slot >= SYSCALL_MAX_PROCS || !waiter)
+        return;
+
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    // The waiter may already be gone (stale stack object): only the pointer is compared.
+    if (proc->used && proc->run_state == SYSCALL_RUN_STATE_BLOCKED && proc->block_waiter == waiter)
+        Syscall_proc_unblock_locked(slot);
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+}
+
+/*
+ * First touch of a lazy anonymous page. The access must be one the mapping allows: a write
+ * to a read-only or an instruction fetch from a no-exec lazy page stays a SIGSEGV.
+ */
+static bool Syscall_resolve_lazy_fault(uintptr_t fault_addr, uint64_t err_code)
+{
+    if ((err_code & SYSCALL_PAGE_FAULT_PRESENT) != 0 || !Syscall_state.vm_lock_ready)
+        return false;
+
+    uintptr_t page = fault_addr & FRAME;
+    if (!Syscall_user_range_in_bounds(page, 1))
+        return false;
+
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    spinlock_t* vm_lock = Syscall_vm_lock(current_cr3);
+    spin_lock(vm_lock);
+    uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, page);
+    if (!pte)
+    {
+        // A 2 MiB entry, lazy or present, carries the same rights as a PTE would.
+        uint64_t* pde = Syscall_get_user_pde_ptr(current_cr3, page);
+        if (pde && (*pde & SYSCALL_PTE_PS) != 0)
+            pte = pde;
+    }
+    uintptr_t entry = pte ? *pte : 0;
+
+    // Another thread populated (or a collapse pass remapped) it meanwhile: retry the access, which faults again if it must.
+    bool resolved = (entry & (PRESENT | USER_MODE)) == (PRESENT | USER_MODE);
+    if (!resolved && (entry & SYSCALL_PTE_LAZY) != 0)
+    {
+        bool allowed = true;
+        if ((err_code & SYSCALL_PAGE_FAULT_WRITE) != 0 && (entry & WRITABLE) == 0)
+            allowed = false;
+        if ((err_code & SYSCALL_PAGE_FAULT_INSTR) != 0 && (entry & NO_EXECUTE) != 0)
+            allowed = false;
+
+        resolved = allowed && Syscall_lazy_populate_locked(current_cr3, page);
+    }
+    spin_unlock(vm_lock);
+    return resolved;
+}
+
+/*
+ * Kernel code that checked a user page was resident and then reads it directly (the futex
+ * word) may find it swapped out since: bring it back as a user fault would. A collapse pass
+ * may also have unmapped it for its copy; it is back once vm_lock is free, as part of a
+ * 2 MiB page. Any other kernel fault is left to the exception table.
+ */
+bool Syscall_handle_kernel_page_fault(uintptr_t fault_addr, uint64_t err_code)
 {
-    if (!proc || !frame)
-        return;
+    if ((err_code & SYSCALL_PAGE_FAULT_PRESENT) != 0 || !Syscall_state.vm_lock_ready)
+        return false;
+
+    uintptr_t page = fault_addr & FRAME;
+    if (!Syscall_user_range_in_bounds(page, 1))
+        return false;
 
-    frame->rax = proc->rax;
-    frame->rcx = proc->rcx;
-    frame->rdx = proc->rdx;
-    frame->rsi = proc->rsi;
-    frame->rdi = proc->rdi;
-    frame->r8 = proc->r8;
-    frame->r9 = proc->r9;
-    frame->r10 = proc->r10;
-    frame->r11 = proc->r11;
-    frame->r15 = proc->r15;
-    frame->r14 = proc->r14;
-    frame->r13 = proc->r13;
-    frame->r12 = proc->r12;
-    frame->rbp = proc->rbp;
-    frame->rbx = proc->rbx;
-    frame->rip = proc->rip;
-    frame->rflags = proc->rflags | SYSCALL_RFLAGS_IF;
-    frame->rsp = proc->rsp;
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    spinlock_t* vm_lock = Syscall_vm_lock(current_cr3);
+    spin_lock(vm_lock);
+    uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, page);
+    uint64_t* pde = pte ? NULL : Syscall_get_user_pde_ptr(current_cr3, page);
+    bool resolved = (pde && (*pde & (PRESENT | SYSCALL_PTE_PS)) == (PRESENT | SYSCALL_PTE_PS)) ||
+                    (pte && (*pte & (PRESENT | SYSCALL_PTE_SWAP)) == SYSCALL_PTE_SWAP &&
+                     Syscall_lazy_populate_locked(current_cr3, page));
+    spin_unlock(vm_lock);
+    return resolved;
 }
 
 static bool Syscall_resolve_cow_fault(uint32_t cpu_index, uintptr_t fault_addr, uint64_t err_code)
@@ -5874,18 +7868,19 @@ static bool Syscall_resolve_cow_fault(uint32_t cpu_index, uintptr_t fault_addr,
     if (proc_cr3 == 0 || proc_cr3 != current_cr3)
         return false;
 
-    spin_lock(&Syscall_state.vm_lock);
+    spinlock_t* vm_lock = Syscall_vm_lock(proc_cr3);
+    spin_lock(vm_lock);
     uint64_t* pte = Syscall_get_user_pte_ptr(proc_cr3, page);
     if (!pte)
     {
-        spin_unlock(&Syscall_state.vm_lock);
+        spin_unlock(vm_lock);
         return false;
     }
 
     uintptr_t entry = *pte;
     if ((entry & (PRESENT | USER_MODE)) != (PRESENT | USER_MODE))
     {
-        spin_unlock(&Syscall_state.vm_lock);
+        spin_unlock(vm_lock);
         return false;
     }
 
@@ -5897,17 +7892,17 @@ static bool Syscall_resolve_cow_fault(uint32_t cpu_index, uintptr_t fault_addr,
     if ((entry & SYSCALL_PTE_COW) == 0)
     {
         bool writable = (entry & WRITABLE) != 0;
-        spin_unlock(&Syscall_state.vm_lock);
+        spin_unlock(vm_lock);
         if (!writable)
             return false;
-        Syscall_write_cr3_phys(proc_cr3);
+        VMM_flush_address_space(proc_cr3);
         return true;
     }
 
     uintptr_t old_phys = entry & FRAME;
     if (old_phys == 0)
     {
-        spin_unlock(&Syscall_state.vm_lock);
+        spin_unlock(vm_lock);
         return false;
     }
 
@@ -5919,15 +7914,15 @@ static bool Syscall_resolve_cow_fault(uint32_t cpu_index, uintptr_t fault_addr,
         entry &= ~SYSCALL_PTE_COW;
         entry |= WRITABLE;
         *pte = entry;
-        spin_unlock(&Syscall_state.vm_lock);
-        Syscall_write_cr3_phys(proc_cr3);
+        spin_unlock(vm_lock);
+        VMM_flush_address_space(proc_cr3);
         return true;
     }
 
     uintptr_t new_phys = (uintptr_t) PMM_alloc_page();
     if (new_phys == 0)
     {
-        spin_unlock(&Syscall_state.vm_lock);
+        spin_unlock(vm_lock);
         return false;
     }
 
@@ -5937,13 +7932,13 @@ static bool Syscall_resolve_cow_fault(uint32_t cpu_index, uintptr_t fault_addr,
     entry &= ~SYSCALL_PTE_COW;
     entry |= WRITABLE;
     *pte = entry;
-    spin_unlock(&Syscall_state.vm_lock);
+    spin_unlock(vm_lock);
 
     bool ref_zero = false;
     if (Syscall_cow_ref_sub(old_phys, &ref_zero) && ref_zero)
         PMM_dealloc_page((void*) old_phys);
 
-    Syscall_write_cr3_phys(proc_cr3);
+    VMM_flush_address_space(proc_cr3);
     return true;
 }
 
@@ -6106,6 +8101,17 @@ static char Syscall_signal_default_action(int32_t signal)
     }
 }
 
+// Under the slot lock, so a syscall leaving on the fast path either sees it or has already saved its state.
+static void Syscall_proc_mark_killed_locked(syscall_process_t* proc, int32_t signal)
+{
+    spin_lock(&proc->lock);
+    proc->exiting = true;
+    proc->terminated_by_signal = true;
+    proc->term_signal = signal;
+    proc->exit_status = 128 + signal;
+    spin_unlock(&proc->lock);
+}
+
 static bool Syscall_signal_terminate_owner_locked(uint32_t owner_pid, int32_t signal)
 {
     if (owner_pid == 0 || !Syscall_signal_is_valid(signal))
@@ -6118,10 +8124,7 @@ static bool Syscall_signal_terminate_owner_locked(uint32_t owner_pid, int32_t si
         if (!proc->used || proc->owner_pid != owner_pid)
             continue;
 
-        proc->exiting = true;
-        proc->terminated_by_signal = true;
-        proc->term_signal = signal;
-        proc->exit_status = 128 + signal;
+        Syscall_proc_mark_killed_locked(proc, signal);
         proc->thread_exit_value = 0;
         terminated = true;
     }
@@ -6167,10 +8170,7 @@ static void Syscall_signal_terminate_fork_children_of_owner_locked(uint32_t pare
         if (proc->is_thread)
             continue;
 
-        proc->exiting = true;
-        proc->terminated_by_signal = true;
-        proc->term_signal = signal;
-        proc->exit_status = 128 + signal;
+        Syscall_proc_mark_killed_locked(proc, signal);
         proc->thread_exit_value = 0;
         any = true;
     }
@@ -6342,6 +8342,213 @@ static bool Syscall_proc_owner_has_other_live_non_thread_locked(uint32_t owner_p
     return false;
 }
 
+static void Syscall_rusage_add(syscall_rusage_t* dst, const syscall_rusage_t* src)
+{
+    dst->utime_ns += src->utime_ns;
+    dst->stime_ns += src->stime_ns;
+    dst->wait_ns += src->wait_ns;
+    dst->blocked_ns += src->blocked_ns;
+    dst->nvcsw += src->nvcsw;
+    dst->nivcsw += src->nivcsw;
+}
+
+// Raw counters of one slot, still in TSC cycles; the syscall boundary converts them to ns.
+static void Syscall_proc_usage_locked(const syscall_process_t* proc, syscall_rusage_t* out)
+{
+    out->utime_ns = proc->utime_tsc;
+    out->stime_ns = proc->stime_tsc;
+    out->wait_ns = proc->wait_tsc;
+    out->blocked_ns = proc->blocked_tsc;
+    out->nvcsw = proc->nvcsw;
+    out->nivcsw = proc->nivcsw;
+}
+
+static uint64_t Syscall_tsc_to_ns(uint64_t cycles)
+{
+    uint64_t hz = APIC_get_tsc_hz();
+    if (hz == 0ULL)
+        return 0ULL;
+    return (cycles / hz) * 1000000000ULL + ((cycles % hz) * 1000000000ULL) / hz;
+}
+
+static void Syscall_rusage_to_ns(syscall_rusage_t* usage)
+{
+    usage->utime_ns = Syscall_tsc_to_ns(usage->utime_ns);
+    usage->stime_ns = Syscall_tsc_to_ns(usage->stime_ns);
+    usage->wait_ns = Syscall_tsc_to_ns(usage->wait_ns);
+    usage->blocked_ns = Syscall_tsc_to_ns(usage->blocked_ns);
+}
+
+/*
+ * Usage of one slot in ns, including the stint still in progress: the running one since it
+ * was last charged, a queued or blocked one since it left the CPU.
+ */
+static void Syscall_proc_usage_running_locked(const syscall_process_t* proc, bool on_cpu, syscall_rusage_t* out)
+{
+    Syscall_proc_usage_locked(proc, out);
+    uint64_t now = x86_rdtsc();
+    uint64_t exec_start = __atomic_load_n(&proc->exec_start_tsc, __ATOMIC_RELAXED);
+    if (on_cpu && exec_start != 0ULL && now > exec_start)
+    {
+        if (proc->in_kernel)
+            out->stime_ns += now - exec_start;
+        else
+            out->utime_ns += now - exec_start;
+    }
+    else if (proc->state_since_tsc != 0ULL && now > proc->state_since_tsc)
+    {
+        if (proc->run_state == SYSCALL_RUN_STATE_QUEUED)
+            out->wait_ns += now - proc->state_since_tsc;
+        else if (proc->run_state == SYSCALL_RUN_STATE_BLOCKED)
+            out->blocked_ns += now - proc->state_since_tsc;
+    }
+    Syscall_rusage_to_ns(out);
+}
+
+/*
+ * Keep the usage of an exiting slot: a thread hands it to a surviving thread of its owner,
+ * the last thread of a process hands the whole process to its parent.
+ */
+static void Syscall_proc_usage_fold_exit_locked(int32_t slot)
+{
+    syscall_process_t* proc = &Syscall_state.procs[(uint32_t) slot];
+    syscall_rusage_t total;
+    Syscall_proc_usage_locked(proc, &total);
+    Syscall_rusage_add(&total, &proc->dead_usage);
+
+    int32_t heir = -1;
+    for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
+    {
+        syscall_process_t* p = &Syscall_state.procs[i];
+        if ((int32_t) i == slot || !p->used || p->owner_pid != proc->owner_pid || proc->owner_pid == 0U)
+            continue;
+        if (heir < 0 || (!p->is_thread && p->pid == p->owner_pid))
+            heir = (int32_t) i;
+    }
+    if (heir >= 0)
+    {
+        Syscall_rusage_add(&Syscall_state.procs[(uint32_t) heir].dead_usage, &total);
+        Syscall_rusage_add(&Syscall_state.procs[(uint32_t) heir].child_usage, &proc->child_usage);
+        return;
+    }
+
+    if (proc->ppid == 0U)
+        return;
+
+    Syscall_rusage_add(&total, &proc->child_usage);
+    int32_t parent = Syscall_pid_lookup_rcu(proc->ppid);
+    if (parent >= 0 && !Syscall_state.procs[parent].is_thread)
+        Syscall_rusage_add(&Syscall_state.procs[parent].child_usage, &total);
+}
+
+static uint64_t Syscall_handle_getrusage(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
+
+    uint64_t who = frame->rdi;
+    void* user_usage = (void*) (uintptr_t) frame->rsi;
+    if (!user_usage || (who != SYS_RUSAGE_SELF && who != SYS_RUSAGE_THREAD && who != SYS_RUSAGE_CHILDREN))
+        return (uint64_t) -1;
+
+    syscall_rusage_t usage;
+    memset(&usage, 0, sizeof(usage));
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
+
+    const syscall_process_t* self = &Syscall_state.procs[(uint32_t) slot];
+    if (who == SYS_RUSAGE_THREAD)
+        Syscall_proc_usage_running_locked(self, true, &usage);
+    else
+    {
+        // Exited threads and children were folded into whichever slot of the owner outlived them.
+        syscall_rusage_t folded;
+        memset(&folded, 0, sizeof(folded));
+        for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
+        {
+            const syscall_process_t* p = &Syscall_state.procs[i];
+            if (!p->used || (i != (uint32_t) slot && (self->owner_pid == 0U || p->owner_pid != self->owner_pid)))
+                continue;
+            if (who == SYS_RUSAGE_CHILDREN)
+            {
+                Syscall_rusage_add(&folded, &p->child_usage);
+                continue;
+            }
+
+            syscall_rusage_t live;
+            Syscall_proc_usage_running_locked(p, p->run_state == SYSCALL_RUN_STATE_RUNNING, &live);
+            Syscall_rusage_add(&usage, &live);
+            Syscall_rusage_add(&folded, &p->dead_usage);
+        }
+        Syscall_rusage_to_ns(&folded);
+        Syscall_rusage_add(&usage, &folded);
+    }
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+
+    if (!Syscall_copy_to_user(user_usage, &usage, sizeof(usage)))
+        return (uint64_t) -1;
+    return 0;
+}
+
+// RLIMIT_AS and RLIMIT_RSS belong to the address space: every thread of the caller shares them.
+static uint64_t Syscall_handle_getrlimit(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+
+    uint32_t resource = (uint32_t) frame->rdi;
+    syscall_rlimit_t* user_limit = (syscall_rlimit_t*) frame->rsi;
+    if (resource != SYS_RLIMIT_AS && resource != SYS_RLIMIT_RSS)
+        return (uint64_t) -1;
+
+    syscall_rlimit_t limit = { SYS_RLIM_INFINITY, SYS_RLIM_INFINITY };
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.mm_lock);
+    const syscall_mm_t* mm = Syscall_mm_get(Syscall_read_cr3_phys());
+    if (mm)
+        limit = (resource == SYS_RLIMIT_AS) ? mm->limit_as : mm->limit_rss;
+    spin_unlock_irqrestore(&Syscall_state.mm_lock, lock_flags);
+
+    return Syscall_copy_to_user(user_limit, &limit, sizeof(limit)) ? 0 : (uint64_t) -1;
+}
+
+/*
+ * A limit below the current usage is accepted: what is mapped stays, the next mapping or
+ * fault fails. The hard limit can only go down.
+ */
+static uint64_t Syscall_handle_setrlimit(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+
+    uint32_t resource = (uint32_t) frame->rdi;
+    const syscall_rlimit_t* user_limit = (const syscall_rlimit_t*) frame->rsi;
+    if (resource != SYS_RLIMIT_AS && resource != SYS_RLIMIT_RSS)
+        return (uint64_t) -1;
+
+    syscall_rlimit_t limit;
+    if (!Syscall_copy_from_user(&limit, user_limit, sizeof(limit)) || limit.cur > limit.max)
+        return (uint64_t) -1;
+
+    uint64_t ret = (uint64_t) -1;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.mm_lock);
+    syscall_mm_t* mm = Syscall_mm_get(Syscall_read_cr3_phys());
+    if (mm)
+    {
+        syscall_rlimit_t* target = (resource == SYS_RLIMIT_AS) ? &mm->limit_as : &mm->limit_rss;
+        if (limit.max <= target->max)
+        {
+            __atomic_store_n(&target->cur, limit.cur, __ATOMIC_RELAXED);
+            __atomic_store_n(&target->max, limit.max, __ATOMIC_RELAXED);
+            ret = 0;
+        }
+    }
+    spin_unlock_irqrestore(&Syscall_state.mm_lock, lock_flags);
+    return ret;
+}
+
 static bool Syscall_proc_has_live_thread_locked(uint32_t owner_pid, uint32_t tid)
 {
     if (owner_pid == 0 || tid == 0)
@@ -6382,17 +8589,37 @@ void Syscall_init(void)
     memset(Syscall_state.fds, 0, sizeof(Syscall_state.fds));
     spinlock_init(&Syscall_state.fd_lock);
     Syscall_state.fd_lock_ready = true;
-    spinlock_init(&Syscall_state.vm_lock);
+    for (uint32_t i = 0; i < SYSCALL_VM_LOCK_BUCKETS; i++)
+        spinlock_init(&Syscall_state.vm_locks[i]);
+    spinlock_init(&Syscall_state.mm_lock);
     Syscall_state.vm_lock_ready = true;
 
     memset(Syscall_state.procs, 0, sizeof(Syscall_state.procs));
     memset(Syscall_state.console_routes, 0, sizeof(Syscall_state.console_routes));
     memset(Syscall_state.exit_events, 0, sizeof(Syscall_state.exit_events));
     memset(Syscall_state.thread_exit_events, 0, sizeof(Syscall_state.thread_exit_events));
-    memset(Syscall_state.cow_refs, 0, sizeof(Syscall_state.cow_refs));
+    memset(Syscall_state.owner_run, 0, sizeof(Syscall_state.owner_run));
+    memset((void*) Syscall_state.slot_reclaim_pending, 0, sizeof(Syscall_state.slot_reclaim_pending));
+    for (uint32_t i = 0; i < SYSCALL_PID_HASH_BUCKETS; i++)
+        Syscall_state.pid_hash[i] = SYSCALL_PROC_NONE;
+    Syscall_state.queued_total = 0;
+    Syscall_state.pick_next_calls = 0;
+    Syscall_state.pick_next_cycles = 0;
+    Syscall_state.user_steals = 0;
     for (uint32_t i = 0; i < 256; i++)
     {
+        syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[i];
         Syscall_state.cpu_current_proc[i] = SYSCALL_PROC_NONE;
+        memset(rq, 0, sizeof(*rq));
+        rq->fair.head = SYSCALL_PROC_NONE;
+        rq->fair.tail = SYSCALL_PROC_NONE;
+        for (uint32_t prio = 0; prio < SYSCALL_RT_PRIO_LEVELS; prio++)
+        {
+            rq->rt[prio].head = SYSCALL_PROC_NONE;
+            rq->rt[prio].tail = SYSCALL_PROC_NONE;
+        }
+        rq->blocked.head = SYSCALL_PROC_NONE;
+        rq->blocked.tail = SYSCALL_PROC_NONE;
         Syscall_state.cpu_need_resched[i] = 0;
         Syscall_state.cpu_yield_same_owner_pick[i] = 0;
         Syscall_state.cpu_need_timer_preempt[i] = 0;
@@ -6403,8 +8630,6 @@ void Syscall_init(void)
     Syscall_state.proc_lock_ready = true;
     spinlock_init(&Syscall_state.console_lock);
     Syscall_state.console_lock_ready = true;
-    spinlock_init(&Syscall_state.cow_lock);
-    Syscall_state.cow_lock_ready = true;
     spinlock_init(&Syscall_kbd_inject_lock);
     Syscall_kbd_inject_lock_ready = true;
 
@@ -6421,6 +8646,11 @@ void Syscall_init(void)
     Syscall_state.shm_lock_ready = true;
 
     memset(Syscall_state.msg_queues, 0, sizeof(Syscall_state.msg_queues));
+    spinlock_init(&Syscall_state.msg_lock);
+    Syscall_state.msg_lock_ready = true;
+
+    // Anonymous pages go to the compressed pool when the PMM runs low, after the block cache.
+    (void) PMM_register_shrinker(Syscall_swap_reclaim);
 
     MSR_set(IA32_LSTAR, (uint64_t) &syscall_handler_stub);
     MSR_set(IA32_FMASK, SYSCALL_FMASK_TF_BIT | SYSCALL_FMASK_DF_BIT);
@@ -6439,6 +8669,146 @@ void Syscall_init(void)
 static bool Syscall_pipe_rx_empty(void* ctx) { syscall_pipe_t* p = (syscall_pipe_t*) ctx; return p && __atomic_load_n(&p->count, __ATOMIC_ACQUIRE) == 0 && __atomic_load_n(&p->writers, __ATOMIC_ACQUIRE) > 0; }
 static bool Syscall_pipe_tx_full(void* ctx)  { syscall_pipe_t* p = (syscall_pipe_t*) ctx; return p && __atomic_load_n(&p->count, __ATOMIC_ACQUIRE) >= SYSCALL_PIPE_BUF_SIZE && __atomic_load_n(&p->readers, __ATOMIC_ACQUIRE) > 0; }
 
+// Take an I/O reference on an open pipe; NULL once its last end has closed.
+static syscall_pipe_t* Syscall_pipe_get(uint32_t pipe_id)
+{
+    if (pipe_id >= SYSCALL_PIPE_MAX || !Syscall_state.pipe_lock_ready)
+        return NULL;
+
+    spin_lock(&Syscall_state.pipe_lock);
+    syscall_pipe_t* p = Syscall_state.pipes[pipe_id];
+    if (p && p->used)
+        p->refs++;
+    else
+        p = NULL;
+    spin_unlock(&Syscall_state.pipe_lock);
+    return p;
+}
+
+static void Syscall_pipe_put(syscall_pipe_t* p)
+{
+    spin_lock(&Syscall_state.pipe_lock);
+    bool last = --p->refs == 0;
+    if (last)
+        Syscall_state.pipes[p->id] = NULL;
+    spin_unlock(&Syscall_state.pipe_lock);
+    if (last)
+        kfree(p);
+}
+
+// Both ends are closed: new lookups fail, and the reference the open ends held goes.
+static void Syscall_pipe_release(syscall_pipe_t* p)
+{
+    spin_lock(&Syscall_state.pipe_lock);
+    bool was_open = p->used;
+    p->used = false;
+    spin_unlock(&Syscall_state.pipe_lock);
+    if (was_open)
+        Syscall_pipe_put(p);
+}
+
+// One end closed, by close() or by its owner exiting: the peer sees EOF or EPIPE.
+static void Syscall_pipe_close_end(uint32_t pipe_id, bool was_reader, bool was_writer)
+{
+    syscall_pipe_t* p = Syscall_pipe_get(pipe_id);
+    if (!p)
+        return;
+
+    spin_lock(&p->lock);
+    if (was_reader && p->readers > 0)
+        p->readers--;
+    if (was_writer && p->writers > 0)
+        p->writers--;
+    task_wait_queue_wake_all(&p->read_waitq);
+    task_wait_queue_wake_all(&p->write_waitq);
+    bool last = p->readers == 0 && p->writers == 0;
+    spin_unlock(&p->lock);
+    if (last)
+        Syscall_pipe_release(p);
+    Syscall_pipe_put(p);
+}
+
+static uint64_t Syscall_pipe_read(syscall_pipe_t* p, void* user_buf, size_t len)
+{
+    spin_lock(&p->lock);
+    if (p->count == 0 && p->writers > 0)
+    {
+        spin_unlock(&p->lock);
+        task_waiter_t waiter;
+        task_waiter_init(&waiter);
+        task_wait_queue_wait_event(&p->read_waitq, &waiter,
+                                   Syscall_pipe_rx_empty, p,
+                                   TASK_WAIT_TIMEOUT_INFINITE);
+        spin_lock(&p->lock);
+    }
+
+    if (p->count == 0)
+    {
+        spin_unlock(&p->lock);
+        return 0;
+    }
+
+    size_t to_read = p->count < len ? p->count : len;
+    uint8_t pipe_buf[SYSCALL_PIPE_BUF_SIZE];
+    size_t first = SYSCALL_PIPE_BUF_SIZE - p->head;
+    if (first > to_read)
+        first = to_read;
+    memcpy(pipe_buf, &p->ring[p->head], first);
+    memcpy(pipe_buf + first, p->ring, to_read - first);
+    p->head = (uint16_t) ((p->head + to_read) % SYSCALL_PIPE_BUF_SIZE);
+    __atomic_store_n(&p->count, p->count - (uint32_t) to_read, __ATOMIC_RELEASE);
+    task_wait_queue_wake_all(&p->write_waitq);
+    spin_unlock(&p->lock);
+
+    if (!Syscall_copy_to_user(user_buf, pipe_buf, to_read))
+        return (uint64_t) -1;
+    return (uint64_t) to_read;
+}
+
+static uint64_t Syscall_pipe_write(syscall_pipe_t* p, const void* user_buf, size_t len)
+{
+    uint8_t pipe_buf[SYSCALL_PIPE_BUF_SIZE];
+    size_t to_write = len < SYSCALL_PIPE_BUF_SIZE ? len : SYSCALL_PIPE_BUF_SIZE;
+    if (!Syscall_copy_from_user(pipe_buf, user_buf, to_write))
+        return (uint64_t) -1;
+
+    spin_lock(&p->lock);
+    if (p->readers == 0)
+    {
+        spin_unlock(&p->lock);
+        return (uint64_t) -1;
+    }
+
+    if (p->count >= SYSCALL_PIPE_BUF_SIZE)
+    {
+        spin_unlock(&p->lock);
+        task_waiter_t waiter;
+        task_waiter_init(&waiter);
+        task_wait_queue_wait_event(&p->write_waitq, &waiter,
+                                   Syscall_pipe_tx_full, p,
+                                   TASK_WAIT_TIMEOUT_INFINITE);
+        spin_lock(&p->lock);
+        if (p->readers == 0)
+        {
+            spin_unlock(&p->lock);
+            return (uint64_t) -1;
+        }
+    }
+
+    uint32_t avail = SYSCALL_PIPE_BUF_SIZE - p->count;
+    size_t actual = to_write < avail ? to_write : avail;
+    size_t first = SYSCALL_PIPE_BUF_SIZE - p->tail;
+    if (first > actual)
+        first = actual;
+    memcpy(&p->ring[p->tail], pipe_buf, first);
+    memcpy(p->ring, pipe_buf + first, actual - first);
+    p->tail = (uint16_t) ((p->tail + actual) % SYSCALL_PIPE_BUF_SIZE);
+    __atomic_store_n(&p->count, p->count + (uint32_t) actual, __ATOMIC_RELEASE);
+    task_wait_queue_wake_all(&p->read_waitq);
+    spin_unlock(&p->lock);
+    return (uint64_t) actual;
+}
+
 static uint64_t Syscall_handle_pipe(uint32_t cpu_index, const syscall_frame_t* frame)
 {
     if (!frame || !Syscall_state.pipe_lock_ready)
@@ -6452,41 +8822,46 @@ static uint64_t Syscall_handle_pipe(uint32_t cpu_index, const syscall_frame_t* f
     if (owner_pid == 0U)
         return (uint64_t) -1;
 
+    syscall_pipe_t* p = (syscall_pipe_t*) kmalloc(sizeof(*p));
+    if (!p)
+        return (uint64_t) -1;
+    memset(p, 0, sizeof(*p));
+    p->used = true;
+    p->refs = 1;
+    p->readers = 1;
+    p->writers = 1;
+    spinlock_init(&p->lock);
+    task_wait_queue_init(&p->read_waitq);
+    task_wait_queue_init(&p->write_waitq);
+
     spin_lock(&Syscall_state.pipe_lock);
     int32_t pipe_id = -1;
     for (uint32_t i = 0; i < SYSCALL_PIPE_MAX; i++)
     {
-        if (!Syscall_state.pipes[i].used)
+        if (!Syscall_state.pipes[i])
         {
             pipe_id = (int32_t) i;
             break;
         }
     }
+    if (pipe_id >= 0)
+    {
+        p->id = (uint32_t) pipe_id;
+        Syscall_state.pipes[(uint32_t) pipe_id] = p;
+    }
+    spin_unlock(&Syscall_state.pipe_lock);
     if (pipe_id < 0)
     {
-        spin_unlock(&Syscall_state.pipe_lock);
+        kfree(p);
         return (uint64_t) -1;
     }
 
-    syscall_pipe_t* p = &Syscall_state.pipes[(uint32_t) pipe_id];
-    memset(p, 0, sizeof(*p));
-    p->used = true;
-    p->readers = 1;
-    p->writers = 1;
-    spinlock_init(&p->lock);
-    p->lock_ready = true;
-    task_wait_queue_init(&p->read_waitq);
-    task_wait_queue_init(&p->write_waitq);
-    spin_unlock(&Syscall_state.pipe_lock);
-
     spin_lock(&Syscall_state.fd_lock);
     int32_t read_fd = Syscall_fd_alloc_locked();
     if (read_fd < 0)
     {
         spin_unlock(&Syscall_state.fd_lock);
-        spin_lock(&Syscall_state.pipe_lock);
-        p->used = false;
-        spin_unlock(&Syscall_state.pipe_lock);
+        Syscall_pipe_release(p);
         return (uint64_t) -1;
     }
     syscall_file_desc_t* rentry = &Syscall_state.fds[(uint32_t) read_fd];
@@ -6503,9 +8878,7 @@ static uint64_t Syscall_handle_pipe(uint32_t cpu_index, const syscall_frame_t* f
     {
         memset(rentry, 0, sizeof(*rentry));
         spin_unlock(&Syscall_state.fd_lock);
-        spin_lock(&Syscall_state.pipe_lock);
-        p->used = false;
-        spin_unlock(&Syscall_state.pipe_lock);
+        Syscall_pipe_release(p);
         return (uint64_t) -1;
     }
     syscall_file_desc_t* wentry = &Syscall_state.fds[(uint32_t) write_fd];
@@ -6525,9 +8898,7 @@ static uint64_t Syscall_handle_pipe(uint32_t cpu_index, const syscall_frame_t* f
         memset(&Syscall_state.fds[(uint32_t) read_fd], 0, sizeof(syscall_file_desc_t));
         memset(&Syscall_state.fds[(uint32_t) write_fd], 0, sizeof(syscall_file_desc_t));
         spin_unlock(&Syscall_state.fd_lock);
-        spin_lock(&Syscall_state.pipe_lock);
-        p->used = false;
-        spin_unlock(&Syscall_state.pipe_lock);
+        Syscall_pipe_release(p);
         return (uint64_t) -1;
     }
 
@@ -6571,9 +8942,10 @@ static uint64_t Syscall_handle_futex(uint32_t cpu_index, const syscall_frame_t*
 
     if (!uaddr)
         return (uint64_t) -1;
+    if (op == SYS_FUTEX_WAIT && !Syscall_lazy_populate_range((uintptr_t) uaddr, sizeof(*uaddr)))
+        return (uint64_t) -1;
 
-    uintptr_t cr3_phys = 0;
-    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3_phys));
+    uintptr_t cr3_phys = Syscall_read_cr3_phys();
     uint32_t bucket = Syscall_futex_hash(cr3_phys, (uintptr_t) uaddr);
 
     spin_lock(&Syscall_state.futex_lock);
@@ -6637,7 +9009,7 @@ static uint64_t Syscall_handle_shmget(uint32_t cpu_index, const syscall_frame_t*
 
     for (uint32_t i = 0; i < SYSCALL_SHM_MAX_SEGMENTS; i++)
     {
-        if (Syscall_state.shm_segments[i].used && Syscall_state.shm_segments[i].key == key)
+        if (Syscall_state.shm_segments[i] && Syscall_state.shm_segments[i]->key == key)
         {
             spin_unlock(&Syscall_state.shm_lock);
             return (uint64_t) i;
@@ -6659,7 +9031,7 @@ static uint64_t Syscall_handle_shmget(uint32_t cpu_index, const syscall_frame_t*
     int32_t slot = -1;
     for (uint32_t i = 0; i < SYSCALL_SHM_MAX_SEGMENTS; i++)
     {
-        if (!Syscall_state.shm_segments[i].used)
+        if (!Syscall_state.shm_segments[i])
         {
             slot = (int32_t) i;
             break;
@@ -6672,9 +9044,14 @@ static uint64_t Syscall_handle_shmget(uint32_t cpu_index, const syscall_frame_t*
     }
 
     uint32_t num_pages = (uint32_t) ((size + 4095ULL) / 4096ULL);
-    syscall_shm_segment_t* seg = &Syscall_state.shm_segments[slot];
-    memset(seg, 0, sizeof(*seg));
-    seg->used = true;
+    size_t seg_size = sizeof(syscall_shm_segment_t) + (size_t) num_pages * sizeof(uintptr_t);
+    syscall_shm_segment_t* seg = (syscall_shm_segment_t*) kmalloc(seg_size);
+    if (!seg)
+    {
+        spin_unlock(&Syscall_state.shm_lock);
+        return (uint64_t) -1;
+    }
+    memset(seg, 0, seg_size);
     seg->key = key;
     seg->size = size;
     seg->num_pages = num_pages;
@@ -6682,19 +9059,20 @@ static uint64_t Syscall_handle_shmget(uint32_t cpu_index, const syscall_frame_t*
 
     for (uint32_t i = 0; i < num_pages; i++)
     {
-        void* page_ptr = PMM_alloc_page();
+        void* page_ptr = PMM_alloc_zeroed_page();
         if (!page_ptr)
         {
             for (uint32_t j = 0; j < i; j++)
                 PMM_dealloc_page((void*) seg->pages[j]);
-            memset(seg, 0, sizeof(*seg));
             spin_unlock(&Syscall_state.shm_lock);
+            kfree(seg);
             return (uint64_t) -1;
         }
         seg->pages[i] = (uintptr_t) page_ptr;
-        memset((void*) P2V(seg->pages[i]), 0, 4096);
+        (void) PMM_page_ref_add(seg->pages[i], 1U, PMM_PAGE_F_SHM);    // The segment's own reference.
     }
 
+    Syscall_state.shm_segments[slot] = seg;
     spin_unlock(&Syscall_state.shm_lock);
     return (uint64_t) slot;
 }
@@ -6711,38 +9089,56 @@ static uint64_t Syscall_handle_shmat(uint32_t cpu_index, const syscall_frame_t*
     if (shmid < 0 || (uint32_t) shmid >= SYSCALL_SHM_MAX_SEGMENTS)
         return (uint64_t) -1;
 
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    syscall_mm_t* mm = Syscall_mm_get(current_cr3);
     spin_lock(&Syscall_state.shm_lock);
-    syscall_shm_segment_t* seg = &Syscall_state.shm_segments[shmid];
-    if (!seg->used)
+    syscall_shm_segment_t* seg = Syscall_state.shm_segments[shmid];
+    if (!seg || seg->marked_remove)
     {
         spin_unlock(&Syscall_state.shm_lock);
         return (uint64_t) -1;
     }
 
     uint32_t num_pages = seg->num_pages;
+    if (!Syscall_mm_reserve_vm(mm, num_pages))
+    {
+        spin_unlock(&Syscall_state.shm_lock);
+        return (uint64_t) -1;
+    }
+    if (!Syscall_mm_charge(mm, SYSCALL_MM_SHARED, num_pages))
+    {
+        Syscall_mm_release_vm(mm, num_pages);
+        spin_unlock(&Syscall_state.shm_lock);
+        return (uint64_t) -1;
+    }
+
+    // Each attached PTE holds a reference, so the frames outlive an exit without shmdt.
     uintptr_t pages_copy[SYSCALL_SHM_MAX_PAGES];
     for (uint32_t i = 0; i < num_pages; i++)
+    {
         pages_copy[i] = seg->pages[i];
+        (void) PMM_page_ref_add(pages_copy[i], 1U, PMM_PAGE_F_SHM);
+        __atomic_add_fetch(&PMM_page_get(pages_copy[i])->mapcount, 1U, __ATOMIC_RELAXED);
+    }
     seg->refcount++;
     spin_unlock(&Syscall_state.shm_lock);
 
     uintptr_t base = hint;
     if (base == 0)
     {
-        spin_lock(&Syscall_state.vm_lock);
-        base = Syscall_state.user_map_hint;
-        Syscall_state.user_map_hint += (uintptr_t) num_pages * 4096ULL;
-        spin_unlock(&Syscall_state.vm_lock);
+        base = __atomic_fetch_add(&Syscall_state.user_map_hint, (uintptr_t) num_pages * 4096ULL, __ATOMIC_RELAXED);
     }
 
-    uintptr_t cr3_phys = 0;
-    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3_phys));
-
+    // Under the vm_lock: the tables built here must not race another thread's mmap.
+    spinlock_t* vm_lock = Syscall_vm_lock(current_cr3);
+    spin_lock(vm_lock);
     for (uint32_t i = 0; i < num_pages; i++)
     {
         uintptr_t virt = base + (uintptr_t) i * 4096ULL;
+        (void) Syscall_user_pte_alloc(current_cr3, virt);
         VMM_map_user_page(virt, pages_copy[i]);
     }
+    spin_unlock(vm_lock);
 
     return (uint64_t) base;
 }
@@ -6760,13 +9156,12 @@ static uint64_t Syscall_handle_shmdt(uint32_t cpu_index, const syscall_frame_t*
     spin_lock(&Syscall_state.shm_lock);
     for (uint32_t i = 0; i < SYSCALL_SHM_MAX_SEGMENTS; i++)
     {
-        syscall_shm_segment_t* seg = &Syscall_state.shm_segments[i];
-        if (!seg->used)
+        syscall_shm_segment_t* seg = Syscall_state.shm_segments[i];
+        if (!seg)
             continue;
 
         bool match = false;
-        uintptr_t cr3_phys = 0;
-        __asm__ volatile("mov %%cr3, %0" : "=r"(cr3_phys));
+        uintptr_t cr3_phys = Syscall_read_cr3_phys();
         for (uint32_t p = 0; p < seg->num_pages; p++)
         {
             uintptr_t virt = addr + (uintptr_t) p * 4096ULL;
@@ -6780,21 +9175,29 @@ static uint64_t Syscall_handle_shmdt(uint32_t cpu_index, const syscall_frame_t*
 
         if (match)
         {
+            uint32_t unmapped = 0;
             for (uint32_t p = 0; p < seg->num_pages; p++)
             {
                 uintptr_t virt = addr + (uintptr_t) p * 4096ULL;
                 uintptr_t old_phys = 0;
-                VMM_unmap_page(virt, &old_phys);
+                if (VMM_unmap_page(virt, &old_phys) && old_phys != 0)
+                {
+                    Syscall_shm_page_unmapped(old_phys & FRAME);
+                    unmapped++;
+                }
             }
+            syscall_mm_t* mm = Syscall_mm_get(cr3_phys);
+            Syscall_mm_uncharge(mm, SYSCALL_MM_SHARED, unmapped);
+            Syscall_mm_release_vm(mm, unmapped);
             if (seg->refcount > 0)
                 seg->refcount--;
-            if (seg->refcount == 0 && seg->marked_remove)
-            {
-                for (uint32_t p = 0; p < seg->num_pages; p++)
-                    PMM_dealloc_page((void*) seg->pages[p]);
-                memset(seg, 0, sizeof(*seg));
-            }
+            // The segment's page references went at IPC_RMID; the last detach only frees the slot.
+            bool release = seg->refcount == 0 && seg->marked_remove;
+            if (release)
+                Syscall_state.shm_segments[i] = NULL;
             spin_unlock(&Syscall_state.shm_lock);
+            if (release)
+                kfree(seg);
             return 0;
         }
     }
@@ -6818,20 +9221,29 @@ static uint64_t Syscall_handle_shmctl(uint32_t cpu_index, const syscall_frame_t*
         return (uint64_t) -1;
 
     spin_lock(&Syscall_state.shm_lock);
-    syscall_shm_segment_t* seg = &Syscall_state.shm_segments[shmid];
-    if (!seg->used)
+    syscall_shm_segment_t* seg = Syscall_state.shm_segments[shmid];
+    if (!seg)
     {
         spin_unlock(&Syscall_state.shm_lock);
         return (uint64_t) -1;
     }
-    seg->marked_remove = true;
-    if (seg->refcount == 0)
+    if (!seg->marked_remove)
     {
+        // Drop the segment's own references: frames still attached live until their last PTE goes.
+        seg->marked_remove = true;
         for (uint32_t p = 0; p < seg->num_pages; p++)
-            PMM_dealloc_page((void*) seg->pages[p]);
-        memset(seg, 0, sizeof(*seg));
+        {
+            bool ref_zero = false;
+            if (PMM_page_ref_sub(seg->pages[p], &ref_zero) && ref_zero)
+                PMM_dealloc_page((void*) seg->pages[p]);
+        }
     }
+    bool release = seg->refcount == 0;
+    if (release)
+        Syscall_state.shm_segments[shmid] = NULL;
     spin_unlock(&Syscall_state.shm_lock);
+    if (release)
+        kfree(seg);
     return 0;
 }
 
@@ -6842,18 +9254,63 @@ static uint64_t Syscall_handle_shmctl(uint32_t cpu_index, const syscall_frame_t*
 static bool Syscall_msgq_send_full(void* ctx)
 {
     syscall_msgq_t* q = (syscall_msgq_t*) ctx;
-    return q && __atomic_load_n(&q->count, __ATOMIC_ACQUIRE) >= SYSCALL_MSG_RING_SIZE;
+    return q && !__atomic_load_n(&q->removed, __ATOMIC_ACQUIRE) &&
+           __atomic_load_n(&q->count, __ATOMIC_ACQUIRE) >= SYSCALL_MSG_QUEUE_DEPTH;
+}
+
+static bool Syscall_msgq_recv_empty(void* ctx)
+{
+    syscall_msgq_t* q = (syscall_msgq_t*) ctx;
+    return q && !__atomic_load_n(&q->removed, __ATOMIC_ACQUIRE) &&
+           __atomic_load_n(&q->count, __ATOMIC_ACQUIRE) == 0;
+}
+
+// A reference on a live queue, dropped with Syscall_msgq_put; NULL once IPC_RMID took it out.
+static syscall_msgq_t* Syscall_msgq_get(int32_t msqid)
+{
+    if (msqid < 0 || (uint32_t) msqid >= SYSCALL_MSG_MAX_QUEUES || !Syscall_state.msg_lock_ready)
+        return NULL;
+
+    spin_lock(&Syscall_state.msg_lock);
+    syscall_msgq_t* q = Syscall_state.msg_queues[msqid];
+    if (q)
+        q->refs++;
+    spin_unlock(&Syscall_state.msg_lock);
+    return q;
+}
+
+// The last reference frees the queue and whatever messages were still in it.
+static void Syscall_msgq_put(syscall_msgq_t* q)
+{
+    spin_lock(&Syscall_state.msg_lock);
+    bool last = --q->refs == 0;
+    spin_unlock(&Syscall_state.msg_lock);
+    if (!last)
+        return;
+
+    syscall_msg_t* msg = q->head;
+    while (msg)
+    {
+        syscall_msg_t* next = msg->next;
+        kfree(msg);
+        msg = next;
+    }
+    kfree(q);
 }
 
-static bool Syscall_msgq_recv_empty(void* ctx)
+static int32_t Syscall_msgq_find_locked(int32_t key)
 {
-    syscall_msgq_t* q = (syscall_msgq_t*) ctx;
-    return q && __atomic_load_n(&q->count, __ATOMIC_ACQUIRE) == 0;
+    for (uint32_t i = 0; i < SYSCALL_MSG_MAX_QUEUES; i++)
+    {
+        if (Syscall_state.msg_queues[i] && Syscall_state.msg_queues[i]->key == key)
+            return (int32_t) i;
+    }
+    return -1;
 }
 
 static uint64_t Syscall_handle_msgget(uint32_t cpu_index, const syscall_frame_t* frame)
 {
-    if (!frame)
+    if (!frame || !Syscall_state.msg_lock_ready)
         return (uint64_t) -1;
     (void) cpu_index;
 
@@ -6861,31 +9318,41 @@ static uint64_t Syscall_handle_msgget(uint32_t cpu_index, const syscall_frame_t*
     uint32_t flags = (uint32_t) frame->rsi;
     bool create = (flags & 0x200U) != 0; /* IPC_CREAT */
 
-    for (uint32_t i = 0; i < SYSCALL_MSG_MAX_QUEUES; i++)
-    {
-        if (Syscall_state.msg_queues[i].used && Syscall_state.msg_queues[i].key == key)
-            return (uint64_t) i;
-    }
+    spin_lock(&Syscall_state.msg_lock);
+    int32_t msqid = Syscall_msgq_find_locked(key);
+    spin_unlock(&Syscall_state.msg_lock);
+    if (msqid >= 0 || !create)
+        return (uint64_t) (int64_t) msqid;
 
-    if (!create)
+    syscall_msgq_t* q = (syscall_msgq_t*) kmalloc(sizeof(*q));
+    if (!q)
         return (uint64_t) -1;
+    memset(q, 0, sizeof(*q));
+    q->key = key;
+    q->refs = 1;
+    spinlock_init(&q->lock);
+    task_wait_queue_init(&q->send_waitq);
+    task_wait_queue_init(&q->recv_waitq);
 
-    for (uint32_t i = 0; i < SYSCALL_MSG_MAX_QUEUES; i++)
+    // Looked up again: another msgget may have created the key meanwhile.
+    spin_lock(&Syscall_state.msg_lock);
+    msqid = Syscall_msgq_find_locked(key);
+    if (msqid < 0)
     {
-        syscall_msgq_t* q = &Syscall_state.msg_queues[i];
-        if (!q->used)
+        for (uint32_t i = 0; i < SYSCALL_MSG_MAX_QUEUES; i++)
         {
-            memset(q, 0, sizeof(*q));
-            q->used = true;
-            q->key = key;
-            spinlock_init(&q->lock);
-            q->lock_ready = true;
-            task_wait_queue_init(&q->send_waitq);
-            task_wait_queue_init(&q->recv_waitq);
-            return (uint64_t) i;
+            if (!Syscall_state.msg_queues[i])
+            {
+                Syscall_state.msg_queues[i] = q;
+                q = NULL;
+                msqid = (int32_t) i;
+                break;
+            }
         }
     }
-    return (uint64_t) -1;
+    spin_unlock(&Syscall_state.msg_lock);
+    kfree(q);
+    return (uint64_t) (int64_t) msqid;
 }
 
 static uint64_t Syscall_handle_msgsnd(uint32_t cpu_index, const syscall_frame_t* frame)
@@ -6899,30 +9366,37 @@ static uint64_t Syscall_handle_msgsnd(uint32_t cpu_index, const syscall_frame_t*
     size_t msgsz = (size_t) frame->rdx;
     uint32_t msgflg = (uint32_t) frame->r10;
 
-    if (msqid < 0 || (uint32_t) msqid >= SYSCALL_MSG_MAX_QUEUES || !user_msgp)
-        return (uint64_t) -1;
-
-    syscall_msgq_t* q = &Syscall_state.msg_queues[msqid];
-    if (!q->used || !q->lock_ready)
+    if (!user_msgp || msgsz > SYSCALL_MSG_MAX_TEXT)
         return (uint64_t) -1;
 
-    if (msgsz > SYSCALL_MSG_MAX_TEXT)
+    syscall_msg_t* msg = (syscall_msg_t*) kmalloc(sizeof(*msg) + msgsz);
+    if (!msg)
         return (uint64_t) -1;
-
-    int32_t mtype = 0;
-    if (!Syscall_copy_from_user(&mtype, user_msgp, sizeof(mtype)))
+    msg->next = NULL;
+    msg->len = (uint16_t) msgsz;
+    if (!Syscall_copy_from_user(&msg->mtype, user_msgp, sizeof(msg->mtype)) ||
+        (msgsz > 0 && !Syscall_copy_from_user(msg->mtext, (const uint8_t*) user_msgp + sizeof(int32_t), msgsz)))
+    {
+        kfree(msg);
         return (uint64_t) -1;
+    }
 
-    uint8_t mtext[SYSCALL_MSG_MAX_TEXT];
-    if (msgsz > 0 && !Syscall_copy_from_user(mtext, (const uint8_t*) user_msgp + sizeof(int32_t), msgsz))
+    syscall_msgq_t* q = Syscall_msgq_get(msqid);
+    if (!q)
+    {
+        kfree(msg);
         return (uint64_t) -1;
+    }
 
+    uint64_t result = 0;
     spin_lock(&q->lock);
-    if (q->count >= SYSCALL_MSG_RING_SIZE)
+    if (q->count >= SYSCALL_MSG_QUEUE_DEPTH && !q->removed)
     {
         if (msgflg & 0x800U) /* IPC_NOWAIT */
         {
             spin_unlock(&q->lock);
+            kfree(msg);
+            Syscall_msgq_put(q);
             return (uint64_t) -2;
         }
         spin_unlock(&q->lock);
@@ -6934,23 +9408,27 @@ static uint64_t Syscall_handle_msgsnd(uint32_t cpu_index, const syscall_frame_t*
                                    TASK_WAIT_TIMEOUT_INFINITE);
 
         spin_lock(&q->lock);
-        if (!q->used || q->count >= SYSCALL_MSG_RING_SIZE)
-        {
-            spin_unlock(&q->lock);
-            return (uint64_t) -1;
-        }
     }
 
-    syscall_msg_t* slot = &q->ring[q->tail];
-    slot->mtype = mtype;
-    slot->len = (uint16_t) msgsz;
-    if (msgsz > 0)
-        memcpy(slot->mtext, mtext, msgsz);
-    q->tail = (uint16_t) ((q->tail + 1U) % SYSCALL_MSG_RING_SIZE);
-    __atomic_store_n(&q->count, q->count + 1U, __ATOMIC_RELEASE);
-    task_wait_queue_wake_all(&q->recv_waitq);
+    // Removed while waiting, or still full: the message goes nowhere.
+    if (q->removed || q->count >= SYSCALL_MSG_QUEUE_DEPTH)
+    {
+        kfree(msg);
+        result = (uint64_t) -1;
+    }
+    else
+    {
+        if (q->tail)
+            q->tail->next = msg;
+        else
+            q->head = msg;
+        q->tail = msg;
+        __atomic_store_n(&q->count, q->count + 1U, __ATOMIC_RELEASE);
+        task_wait_queue_wake_all(&q->recv_waitq);
+    }
     spin_unlock(&q->lock);
-    return 0;
+    Syscall_msgq_put(q);
+    return result;
 }
 
 static uint64_t Syscall_handle_msgrcv(uint32_t cpu_index, const syscall_frame_t* frame)
@@ -6965,20 +9443,26 @@ static uint64_t Syscall_handle_msgrcv(uint32_t cpu_index, const syscall_frame_t*
     int32_t msgtyp = (int32_t) frame->r10;
     uint32_t msgflg = (uint32_t) frame->r8;
 
-    if (msqid < 0 || (uint32_t) msqid >= SYSCALL_MSG_MAX_QUEUES || !user_msgp)
+    if (!user_msgp)
         return (uint64_t) -1;
-
-    syscall_msgq_t* q = &Syscall_state.msg_queues[msqid];
-    if (!q->used || !q->lock_ready)
+    syscall_msgq_t* q = Syscall_msgq_get(msqid);
+    if (!q)
         return (uint64_t) -1;
 
     spin_lock(&q->lock);
 retry:
+    if (q->removed)
+    {
+        spin_unlock(&q->lock);
+        Syscall_msgq_put(q);
+        return (uint64_t) -1;
+    }
     if (q->count == 0U)
     {
         if (msgflg & 0x800U) /* IPC_NOWAIT */
         {
             spin_unlock(&q->lock);
+            Syscall_msgq_put(q);
             return (uint64_t) -2;
         }
         spin_unlock(&q->lock);
@@ -6990,58 +9474,73 @@ retry:
                                    TASK_WAIT_TIMEOUT_INFINITE);
 
         spin_lock(&q->lock);
-        if (!q->used || q->count == 0U)
+        if (q->removed || q->count == 0U)
         {
             spin_unlock(&q->lock);
+            Syscall_msgq_put(q);
             return (uint64_t) -1;
         }
     }
 
     /* Search for matching message */
-    uint32_t found_idx = SYSCALL_MSG_RING_SIZE;
-    for (uint32_t i = 0; i < q->count; i++)
+    syscall_msg_t* prev = NULL;
+    syscall_msg_t* found = q->head;
+    while (found && msgtyp != 0 && found->mtype != msgtyp)
     {
-        uint32_t idx = (q->head + i) % SYSCALL_MSG_RING_SIZE;
-        if (msgtyp == 0 || q->ring[idx].mtype == msgtyp)
-        {
-            found_idx = idx;
-            break;
-        }
+        prev = found;
+        found = found->next;
     }
 
-    if (found_idx >= SYSCALL_MSG_RING_SIZE)
+    if (!found)
         goto retry;
 
-    syscall_msg_t found_msg = q->ring[found_idx];
-
-    /* Remove from ring - if it's the head, just advance head */
-    if (found_idx == q->head)
-    {
-        q->head = (uint16_t) ((q->head + 1U) % SYSCALL_MSG_RING_SIZE);
-    }
+    if (prev)
+        prev->next = found->next;
     else
-    {
-        /* Shift entries to fill the gap */
-        uint32_t pos = found_idx;
-        uint32_t end_pos = (q->head + q->count - 1U) % SYSCALL_MSG_RING_SIZE;
-        while (pos != end_pos)
-        {
-            uint32_t next = (pos + 1U) % SYSCALL_MSG_RING_SIZE;
-            q->ring[pos] = q->ring[next];
-            pos = next;
-        }
-    }
+        q->head = found->next;
+    if (q->tail == found)
+        q->tail = prev;
     __atomic_store_n(&q->count, q->count - 1U, __ATOMIC_RELEASE);
     task_wait_queue_wake_all(&q->send_waitq);
     spin_unlock(&q->lock);
+    Syscall_msgq_put(q);
+
+    size_t copy_len = found->len < msgsz ? found->len : msgsz;
+    bool ok = Syscall_copy_to_user(user_msgp, &found->mtype, sizeof(found->mtype)) &&
+              (copy_len == 0 || Syscall_copy_to_user((uint8_t*) user_msgp + sizeof(int32_t), found->mtext, copy_len));
+    kfree(found);
+    return ok ? (uint64_t) copy_len : (uint64_t) -1;
+}
+
+/*
+ * IPC_RMID only: the key is free again at once, blocked senders and receivers fail, and the
+ * queue with its pending messages is freed once the last of them lets go.
+ */
+static uint64_t Syscall_handle_msgctl(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!frame || !Syscall_state.msg_lock_ready)
+        return (uint64_t) -1;
+    (void) cpu_index;
 
-    size_t copy_len = found_msg.len < msgsz ? found_msg.len : msgsz;
-    if (!Syscall_copy_to_user(user_msgp, &found_msg.mtype, sizeof(found_msg.mtype)))
+    int32_t msqid = (int32_t) frame->rdi;
+    int32_t cmd = (int32_t) frame->rsi;
+    if (msqid < 0 || (uint32_t) msqid >= SYSCALL_MSG_MAX_QUEUES || cmd != 0) /* IPC_RMID = 0 */
         return (uint64_t) -1;
-    if (copy_len > 0 && !Syscall_copy_to_user((uint8_t*) user_msgp + sizeof(int32_t), found_msg.mtext, copy_len))
+
+    spin_lock(&Syscall_state.msg_lock);
+    syscall_msgq_t* q = Syscall_state.msg_queues[msqid];
+    Syscall_state.msg_queues[msqid] = NULL;
+    spin_unlock(&Syscall_state.msg_lock);
+    if (!q)
         return (uint64_t) -1;
 
-    return (uint64_t) copy_len;
+    spin_lock(&q->lock);
+    __atomic_store_n(&q->removed, true, __ATOMIC_RELEASE);
+    task_wait_queue_wake_all(&q->send_waitq);
+    task_wait_queue_wake_all(&q->recv_waitq);
+    spin_unlock(&q->lock);
+    Syscall_msgq_put(q);
+    return 0;
 }
 
 void Syscall_on_timer_tick(uint32_t cpu_index)
@@ -7050,16 +9549,44 @@ void Syscall_on_timer_tick(uint32_t cpu_index)
         return;
     Syscall_debug_tick_calls++;
 
-    uint32_t runnable = 0;
-    uint64_t flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-    for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
+    syscall_cpu_runqueue_t* rq = &Syscall_state.cpu_runqueue[cpu_index];
+    if (__atomic_load_n(&rq->blocked.count, __ATOMIC_RELAXED) != 0U)
     {
-        if (Syscall_state.procs[i].used)
-            runnable++;
+        uint64_t now_ticks = ISR_get_timer_ticks();
+        uint64_t flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+        uint32_t slot = rq->blocked.head;
+        while (slot != SYSCALL_PROC_NONE)
+        {
+            syscall_process_t* proc = &Syscall_state.procs[slot];
+            uint32_t next = proc->rq_next;
+
+            // Parked waiter stacks stay valid while blocked, so the waiter can be inspected here.
+            bool expired = proc->block_deadline != 0 && now_ticks >= proc->block_deadline;
+            bool signaled = proc->block_waiter && __atomic_load_n(&proc->block_waiter->signaled, __ATOMIC_ACQUIRE) != 0;
+            if (expired || signaled || proc->exiting)
+                Syscall_proc_unblock_locked(slot);
+            slot = next;
+        }
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, flags);
     }
-    spin_unlock_irqrestore(&Syscall_state.proc_lock, flags);
 
-    if (runnable <= 1U)
+    // RT bandwidth: real-time threads get at most SYSCALL_RT_RUNTIME_TICKS of every period.
+    uint32_t cur_slot = __atomic_load_n(&Syscall_state.cpu_current_proc[cpu_index], __ATOMIC_RELAXED);
+    const syscall_process_t* cur = (cur_slot < SYSCALL_MAX_PROCS) ? &Syscall_state.procs[cur_slot] : NULL;
+    bool cur_rt = cur && Syscall_proc_is_rt(cur);
+    if (cur_rt)
+        rq->rt_run_ticks++;
+    if (++rq->rt_window_ticks >= SYSCALL_RT_PERIOD_TICKS)
+    {
+        rq->rt_window_ticks = 0;
+        rq->rt_run_ticks = 0;
+        rq->rt_throttled = 0;
+    }
+    else if (rq->rt_run_ticks >= SYSCALL_RT_RUNTIME_TICKS)
+        rq->rt_throttled = 1;
+
+    // Only threads waiting on this CPU can use its quantum.
+    if (Syscall_rq_depth_cpu(cpu_index) <= 1U)
     {
         Syscall_state.cpu_slice_ticks[cpu_index] = 0;
         Syscall_debug_tick_runnable_le1++;
@@ -7068,7 +9595,17 @@ void Syscall_on_timer_tick(uint32_t cpu_index)
 
     uint8_t slice = (uint8_t) (Syscall_state.cpu_slice_ticks[cpu_index] + 1U);
     Syscall_state.cpu_slice_ticks[cpu_index] = slice;
-    if (slice >= SYSCALL_PREEMPT_QUANTUM_TICKS)
+
+    // A queued real-time thread above the current one does not wait for the quantum.
+    bool preempt = slice >= SYSCALL_PREEMPT_QUANTUM_TICKS;
+    uint32_t rt_levels = __atomic_load_n(&rq->rt_bitmap, __ATOMIC_RELAXED);
+    if (rt_levels != 0U && rq->rt_throttled == 0U)
+    {
+        uint32_t top_prio = 31U - (uint32_t) __builtin_clz(rt_levels);
+        if (!cur_rt || top_prio > cur->rt_priority)
+            preempt = true;
+    }
+    if (preempt)
     {
         __atomic_store_n(&Syscall_state.cpu_need_timer_preempt[cpu_index], 1, __ATOMIC_RELEASE);
         Syscall_debug_need_resched_set++;
@@ -7082,16 +9619,13 @@ bool Syscall_try_dispatch_user_from_idle(uint32_t cpu_index)
     if (!Syscall_state.proc_lock_ready || cpu_index >= 256)
         return false;
 
+    // Nothing queued anywhere: stay idle without touching proc_lock.
+    if (__atomic_load_n(&Syscall_state.queued_total, __ATOMIC_RELAXED) == 0U)
+        return false;
+
     Syscall_debug_idle_dispatch_attempts++;
     Syscall_debug_idle_dispatch_attempt_cpu[cpu_index & 0x3U]++;
 
-    syscall_user_resume_context_t resume_ctx;
-    memset(&resume_ctx, 0, sizeof(resume_ctx));
-    uintptr_t next_cr3 = 0;
-    uintptr_t next_fs_base = 0;
-    uint32_t next_pid = 0;
-    bool has_target = false;
-
     uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
     int32_t current_slot = Syscall_proc_get_current_slot_locked(cpu_index);
     if (current_slot >= 0)
@@ -7101,92 +9635,23 @@ bool Syscall_try_dispatch_user_from_idle(uint32_t cpu_index)
         return false;
     }
 
-    int32_t next_slot = -1;
-    syscall_process_t* next = NULL;
-    for (uint32_t idx = 0; idx < SYSCALL_MAX_PROCS; idx++)
-    {
-        syscall_process_t* cand = &Syscall_state.procs[idx];
-        if (!cand->used || cand->exiting || cand->cr3_phys == 0)
-            continue;
-        if (cand->pid == 1U || cand->ppid == 0U)
-            continue;
-        if (Syscall_idle_claimed_slots[idx] != 0U)
-            continue;
-        if (Syscall_proc_is_on_other_cpu_locked(idx, cpu_index))
-            continue;
-
-        next_slot = (int32_t) idx;
-        next = cand;
-        break;
-    }
-    if (next_slot < 0 || !next)
+    int32_t next_slot = Syscall_proc_pick_next_locked(-1, cpu_index);
+    if (next_slot < 0)
     {
         spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
         Syscall_debug_idle_dispatch_rejected_empty++;
         return false;
     }
 
-    Syscall_state.cpu_current_proc[cpu_index] = (uint32_t) next_slot;
-    next->last_cpu = cpu_index;
-    Syscall_idle_claimed_slots[(uint32_t) next_slot] = 1U;
-    Syscall_state.cpu_slice_ticks[cpu_index] = 0U;
+    Syscall_debug_idle_dispatch_success++;
+    Syscall_debug_idle_dispatch_success_cpu[cpu_index & 0x3U]++;
     __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 0, __ATOMIC_RELEASE);
     __atomic_store_n(&Syscall_state.cpu_need_timer_preempt[cpu_index], 0, __ATOMIC_RELEASE);
     __atomic_store_n(&Syscall_state.cpu_yield_same_owner_pick[cpu_index], 0, __ATOMIC_RELEASE);
 
-    resume_ctx.rax = next->rax;
-    resume_ctx.rcx = next->rcx;
-    resume_ctx.rdx = next->rdx;
-    resume_ctx.rsi = next->rsi;
-    resume_ctx.rdi = next->rdi;
-    resume_ctx.r8 = next->r8;
-    resume_ctx.r9 = next->r9;
-    resume_ctx.r10 = next->r10;
-    resume_ctx.r11 = next->r11;
-    resume_ctx.r15 = next->r15;
-    resume_ctx.r14 = next->r14;
-    resume_ctx.r13 = next->r13;
-    resume_ctx.r12 = next->r12;
-    resume_ctx.rbp = next->rbp;
-    resume_ctx.rbx = next->rbx;
-    resume_ctx.rip = next->rip;
-    resume_ctx.rflags = next->rflags | SYSCALL_RFLAGS_IF;
-    resume_ctx.rsp = next->rsp;
-
-    next_cr3 = next->cr3_phys;
-    next_fs_base = next->fs_base;
-    next_pid = next->pid;
-    has_target = true;
-    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-
-    if (!has_target)
-        return false;
-
-    if (next_cr3 != Syscall_read_cr3_phys())
-        Syscall_write_cr3_phys(next_cr3);
-    if (next_fs_base != Syscall_read_fs_base())
-        Syscall_write_fs_base(next_fs_base);
-
-    /*
-     * Idle->user handoff may run outside the syscall stub path.
-     * Re-establish GS/KERNEL_GS_BASE invariants expected by SYSCALL entry:
-     *   - IA32_GS_BASE         = user GS base (currently 0)
-     *   - IA32_KERNEL_GS_BASE  = per-CPU kernel local pointer
-     */
-    task_cpu_local_t* cpu_local = task_get_cpu_local();
-    if (cpu_local)
-    {
-        MSR_set(IA32_GS_BASE, 0);
-        MSR_set(IA32_KERNEL_GS_BASE, (uint64_t) (uintptr_t) cpu_local);
-    }
-
-    Syscall_debug_idle_dispatch_success++;
-    Syscall_debug_idle_dispatch_success_cpu[cpu_index & 0x3U]++;
-    kdebug_printf("[SMPUSR] idle dispatch cpu=%u pid=%u rip=0x%llx\n",
-                  (unsigned) cpu_index,
-                  (unsigned) next_pid,
-                  (unsigned long long) resume_ctx.rip);
-    Syscall_resume_user_context(&resume_ctx);
+    // The idle stack is dropped; a later switch back to idle starts it afresh.
+    Syscall_proc_switch_locked(cpu_index, -1, next_slot);
+    __builtin_unreachable();
 }
 
 bool Syscall_handle_timer_preempt(interrupt_frame_t* frame, uint32_t cpu_index)
@@ -7199,6 +9664,15 @@ bool Syscall_handle_timer_preempt(interrupt_frame_t* frame, uint32_t cpu_index)
 
     Syscall_debug_preempt_attempts++;
     Syscall_debug_preempt_attempt_cpu[cpu_index & 0x3U]++;
+
+    // Most ticks have nothing to do: leave proc_lock alone unless a preemption was requested.
+    if (__atomic_load_n(&Syscall_state.cpu_need_timer_preempt[cpu_index], __ATOMIC_ACQUIRE) == 0)
+    {
+        Syscall_debug_preempt_no_flag++;
+        Syscall_debug_preempt_no_flag_cpu[cpu_index & 0x3U]++;
+        return false;
+    }
+
     uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
     if (__atomic_exchange_n(&Syscall_state.cpu_need_timer_preempt[cpu_index], 0, __ATOMIC_ACQ_REL) == 0)
     {
@@ -7246,2021 +9720,2713 @@ bool Syscall_handle_timer_preempt(interrupt_frame_t* frame, uint32_t cpu_index)
         return false;
     }
 
-    uintptr_t current_cr3 = Syscall_read_cr3_phys();
-    uintptr_t current_fs_base = Syscall_read_fs_base();
-    Syscall_proc_save_from_interrupt(current, frame, current_cr3, current_fs_base);
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    uintptr_t current_fs_base = Syscall_read_fs_base();
+    Syscall_proc_save_from_interrupt(current, frame, current_cr3, current_fs_base);
+
+    // A current thread whose affinity dropped this CPU leaves it even with nothing else to run.
+    int32_t next_slot = Syscall_proc_pick_next_locked(current_slot, cpu_index);
+    if ((next_slot < 0 && Syscall_proc_cpu_allowed(current, cpu_index)) || next_slot == current_slot)
+    {
+        Syscall_debug_preempt_same_slot++;
+        Syscall_state.cpu_slice_ticks[cpu_index] = 0;
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return false;
+    }
+
+    const syscall_process_t* next = (next_slot >= 0) ? &Syscall_state.procs[(uint32_t) next_slot] : NULL;
+    if (next && (!next->used || next->exiting || next->cr3_phys == 0))
+    {
+        Syscall_debug_preempt_invalid_next++;
+        Syscall_state.cpu_slice_ticks[cpu_index] = 0;
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return false;
+    }
+
+    Syscall_debug_preempt_success++;
+    Syscall_debug_preempt_success_cpu[cpu_index & 0x3U]++;
+
+    // The interrupted context is saved in its slot: leave this stack for good, EOI first.
+    APIC_send_EOI();
+    Syscall_proc_switch_locked(cpu_index, -1, next_slot);
+    __builtin_unreachable();
+}
+
+/*
+ * Close the user-mode stint of the current process: what it ran since it was last accounted
+ * goes to utime, the rest of the syscall to stime. Only this CPU moves the running slot's
+ * clock, so masking interrupts against the tick is enough.
+ */
+static void Syscall_account_enter(uint32_t cpu_index)
+{
+    if (cpu_index >= 256 || !Syscall_state.proc_lock_ready)
+        return;
+
+    cli();
+    uint32_t slot = Syscall_state.cpu_current_proc[cpu_index];
+    if (slot < SYSCALL_MAX_PROCS)
+    {
+        syscall_process_t* proc = &Syscall_state.procs[slot];
+        if (proc->used)
+        {
+            proc->in_kernel = false;
+            if (proc->exec_start_tsc != 0)
+                Syscall_sched_charge(proc, x86_rdtsc());
+            proc->in_kernel = true;
+        }
+    }
+    sti();
+}
+
+static uint64_t Syscall_handle_fs_mkdir(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+
+    char path[SYSCALL_USER_CSTR_MAX];
+    if (!Syscall_read_user_cstr(path, sizeof(path), (const char*) frame->rdi))
+        return (uint64_t) -1;
+
+    char normalized[SYSCALL_USER_CSTR_MAX];
+    if (!Syscall_normalize_write_path(path, normalized, sizeof(normalized)))
+        return (uint64_t) -1;
+
+    bool ok = VFS_mkdir(normalized);
+    return ok ? 0 : (uint64_t) -1;
+}
+
+/*
+ * Fold one fully populated page table into a 2 MiB page: every entry present, private,
+ * with the same rights. Threads of the address space may be running, so the entries are
+ * unmapped and flushed before the copy: a touch meanwhile faults, waits on vm_lock and
+ * finds the 2 MiB page. The flush after the PDT entry changes drops any cached pointer to
+ * the table being freed. The caller holds vm_lock, with interrupts on for the shootdowns.
+ */
+static bool Syscall_thp_collapse_locked(uintptr_t cr3_phys, uint64_t* pde)
+{
+    uint64_t pde_entry = *pde;
+    if ((pde_entry & (PRESENT | SYSCALL_PTE_PS | USER_MODE)) != (PRESENT | USER_MODE))
+        return false;
+
+    PT_t* pt = (PT_t*) P2V(pde_entry & FRAME);
+    const uint64_t rights_mask = WRITABLE | USER_MODE | NO_EXECUTE;
+    const uint64_t reject_mask = WRITE_THROUGH | CACHE_DISABLE | SYSCALL_PTE_COW |
+                                 SYSCALL_PTE_DMABUF | SYSCALL_PTE_VVAR | SYSCALL_PTE_FILE;
+    uint64_t rights = pt->entries[0] & rights_mask;
+    for (uint32_t i = 0; i < SYSCALL_THP_PAGES; i++)
+    {
+        uint64_t entry = pt->entries[i];
+        if ((entry & PRESENT) == 0 || (entry & reject_mask) != 0 || (entry & rights_mask) != rights)
+            return false;
+        if ((entry & FRAME) == 0 || Syscall_cow_ref_get(entry & FRAME) != 0 || Syscall_page_is_shm(entry & FRAME))
+            return false;
+    }
+
+    void* block = Syscall_memory_low() ? NULL : PMM_alloc_pages(SYSCALL_THP_ORDER);
+    if (!block)
+        return false;
+
+    // Not present, the entries are out of the hardware's reach: their frames stay readable below.
+    for (uint32_t i = 0; i < SYSCALL_THP_PAGES; i++)
+        __atomic_fetch_and(&pt->entries[i], ~PRESENT, __ATOMIC_ACQ_REL);
+    VMM_flush_address_space(cr3_phys);
+
+    for (uint32_t i = 0; i < SYSCALL_THP_PAGES; i++)
+    {
+        memcpy((void*) P2V((uintptr_t) block + ((uintptr_t) i * SYSCALL_PAGE_SIZE)),
+               (const void*) P2V(pt->entries[i] & FRAME),
+               SYSCALL_PAGE_SIZE);
+    }
+
+    *pde = (uintptr_t) block | PRESENT | SYSCALL_PTE_PS | rights;
+    VMM_flush_address_space(cr3_phys);
+
+    for (uint32_t i = 0; i < SYSCALL_THP_PAGES; i++)
+        PMM_dealloc_page((void*) (pt->entries[i] & FRAME));
+    PMM_dealloc_page((void*) (pde_entry & FRAME));
+    Syscall_mm_add_pt(cr3_phys, -1);
+
+    __atomic_add_fetch(&Syscall_state.thp_pages, 1U, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&Syscall_state.thp_collapses, 1U, __ATOMIC_RELAXED);
+    return true;
+}
+
+/*
+ * Background collapse pass over one address space: a few PDT entries of the mmap window per
+ * run, resuming at its own cursor. Queued when one of its tasks goes to sleep, so the sleep
+ * itself does not pay for the copies.
+ */
+static void Syscall_thp_collapse_work(void* arg)
+{
+    uintptr_t cr3_phys = (uintptr_t) arg;
+    spinlock_t* vm_lock = Syscall_vm_lock(cr3_phys);
+    spin_lock(vm_lock);
+    // Freed since it was queued: Syscall_free_address_space drops the accounting under vm_lock.
+    syscall_mm_t* mm = Syscall_mm_get(cr3_phys);
+    if (!mm)
+    {
+        spin_unlock(vm_lock);
+        return;
+    }
+
+    uintptr_t cursor = mm->thp_cursor;
+    uint32_t collapsed = 0;
+    for (uint32_t scanned = 0;
+         Syscall_interrupts_enabled() &&
+         scanned < SYSCALL_THP_SCAN_BUDGET && collapsed < SYSCALL_THP_COLLAPSE_BUDGET;
+         scanned++, cursor += SYSCALL_THP_SIZE)
+    {
+        if (cursor < SYSCALL_MAP_HINT_BASE || cursor + SYSCALL_THP_SIZE > SYSCALL_MAP_HINT_LIMIT)
+            cursor = SYSCALL_MAP_HINT_BASE;
+
+        uint64_t* pde = Syscall_get_user_pde_ptr(cr3_phys, cursor);
+        if (pde && Syscall_thp_collapse_locked(cr3_phys, pde))
+            collapsed++;
+    }
+    mm->thp_cursor = cursor;
+    __atomic_store_n(&mm->thp_queued, 0, __ATOMIC_RELEASE);
+    spin_unlock(vm_lock);
+}
+
+// One pass per address space waits in the work queue at a time.
+static void Syscall_thp_queue_collapse(void)
+{
+    if (!Syscall_state.vm_lock_ready)
+        return;
+
+    uintptr_t cr3_phys = Syscall_read_cr3_phys();
+    syscall_mm_t* mm = Syscall_mm_get(cr3_phys);
+    uint8_t expected = 0;
+    if (mm &&
+        __atomic_compare_exchange_n(&mm->thp_queued, &expected, 1, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) &&
+        !task_schedule_work(Syscall_thp_collapse_work, (void*) cr3_phys))
+        __atomic_store_n(&mm->thp_queued, 0, __ATOMIC_RELEASE);
+}
+
+static uint64_t Syscall_handle_sleep_ms(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    Syscall_thp_queue_collapse();
+
+    bool sleep_ok = HPET_sleep_ms((uint32_t) frame->rdi);
+    if (sleep_ok && cpu_index < 256)
+    {
+        __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
+        Syscall_debug_flag_set_sleep_cpu[cpu_index & 0x3U]++;
+    }
+    return sleep_ok ? 0 : (uint64_t) -1;
+}
+
+static uint64_t Syscall_handle_tick_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+    (void) frame;
+
+    return ISR_get_timer_ticks();
+}
+
+static uint64_t Syscall_handle_rtc_time_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+    (void) frame;
+
+    return RTC_get_epoch_seconds();
+}
+
+static uint64_t Syscall_handle_kdebug_write(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+
+    const char* user_buf = (const char*) frame->rdi;
+    size_t len = (size_t) frame->rsi;
+    if (!user_buf || len == 0)
+        return 0;
 
-    int32_t next_slot = Syscall_proc_pick_next_locked(current_slot, cpu_index);
-    if (next_slot < 0 || next_slot == current_slot)
+    if (len > SYSCALL_CONSOLE_MAX_WRITE)
+        len = SYSCALL_CONSOLE_MAX_WRITE;
+
+    char stack_buf[1024];
+    char* kernel_buf = stack_buf;
+    bool heap_buf = false;
+    if (len > sizeof(stack_buf))
     {
-        Syscall_debug_preempt_same_slot++;
-        Syscall_state.cpu_slice_ticks[cpu_index] = 0;
-        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-        return false;
+        kernel_buf = (char*) kmalloc(len);
+        if (!kernel_buf)
+            return (uint64_t) -1;
+        heap_buf = true;
     }
 
-    syscall_process_t* next = &Syscall_state.procs[(uint32_t) next_slot];
-    if (!next->used || next->exiting || next->cr3_phys == 0)
+    if (!Syscall_copy_from_user(kernel_buf, user_buf, len))
     {
-        Syscall_debug_preempt_invalid_next++;
-        Syscall_state.cpu_slice_ticks[cpu_index] = 0;
-        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-        return false;
+        if (heap_buf)
+            kfree(kernel_buf);
+        return (uint64_t) -1;
     }
 
-    Syscall_state.cpu_current_proc[cpu_index] = (uint32_t) next_slot;
-    next->last_cpu = cpu_index;
-    Syscall_state.cpu_slice_ticks[cpu_index] = 0;
-    Syscall_proc_load_to_interrupt(next, frame);
-    uintptr_t next_cr3 = next->cr3_phys;
-    uintptr_t next_fs_base = next->fs_base;
-    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-
-    if (next_cr3 != current_cr3)
-        Syscall_write_cr3_phys(next_cr3);
-    if (next_fs_base != current_fs_base)
-        Syscall_write_fs_base(next_fs_base);
+    for (size_t i = 0; i < len; i++)
+        kdebug_putc(kernel_buf[i]);
 
-    Syscall_debug_preempt_success++;
-    Syscall_debug_preempt_success_cpu[cpu_index & 0x3U]++;
-    return true;
+    if (heap_buf)
+        kfree(kernel_buf);
+    return (uint64_t) len;
 }
 
-uint64_t Syscall_interrupt_handler(uint64_t syscall_num, syscall_frame_t* frame, uint32_t cpu_index)
+static uint64_t Syscall_handle_cpu_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
 {
     task_cpu_local_t* cpu_local = task_get_cpu_local();
-    uint8_t apic_id = APIC_get_current_lapic_id();
-    if (cpu_local)
+
+    syscall_cpu_info_t info;
+    memset(&info, 0, sizeof(info));
+
+    info.cpu_index = cpu_index;
+    info.apic_id = cpu_local ? __atomic_load_n(&cpu_local->apic_id, __ATOMIC_RELAXED) :
+                               APIC_get_current_lapic_id();
+    info.online_cpus = SMP_get_online_cpu_count();
+    info.tick_hz = ISR_get_tick_hz();
+    info.ticks = ISR_get_timer_ticks();
+    task_get_activity_counters(&info.sched_exec_total, &info.sched_idle_hlt_total);
+    return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+}
+
+static uint64_t Syscall_handle_sched_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    syscall_sched_info_t info;
+    memset(&info, 0, sizeof(info));
+
+    info.current_cpu = cpu_index;
+    info.preempt_count = task_get_preempt_count();
+    info.local_rq_depth = task_runqueue_depth();
+    info.total_rq_depth = task_runqueue_depth_total();
+    if (cpu_index < 256)
+        info.user_rq_depth = __atomic_load_n(&Syscall_state.cpu_runqueue[cpu_index].nr_queued, __ATOMIC_RELAXED);
+    info.user_rq_total = __atomic_load_n(&Syscall_state.queued_total, __ATOMIC_RELAXED);
+    info.pick_next_calls = Syscall_state.pick_next_calls;
+    info.pick_next_cycles = Syscall_state.pick_next_cycles;
+    info.user_steals = Syscall_state.user_steals;
+    return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+}
+
+static uint64_t Syscall_handle_ahci_irq_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+
+    syscall_ahci_irq_info_t info;
+    memset(&info, 0, sizeof(info));
+
+    info.mode = AHCI_get_irq_mode();
+    info.reserved = 0;
+    info.count = AHCI_get_irq_count();
+    return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+}
+
+static uint64_t Syscall_handle_rcu_sync(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+    (void) frame;
+
+    return RCU_synchronize() ? 0 : (uint64_t) -1;
+}
+
+static uint64_t Syscall_handle_rcu_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+
+    syscall_rcu_info_t info;
+    memset(&info, 0, sizeof(info));
+
+    rcu_stats_t stats = { 0 };
+    RCU_get_stats(&stats);
+    info.gp_seq = stats.gp_seq;
+    info.gp_target = stats.gp_target;
+    info.callbacks_pending = stats.callbacks_pending;
+    info.local_read_depth = stats.local_read_depth;
+    info.local_preempt_count = stats.local_preempt_count;
+    return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+}
+
+static uint64_t Syscall_handle_proc_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
+
+    // Too large for the kernel stack once the usage counters are included.
+    syscall_proc_info_t* snapshot = (syscall_proc_info_t*) kmalloc(SYSCALL_MAX_PROCS * sizeof(*snapshot));
+    if (!snapshot)
+        return (uint64_t) -1;
+
+    uint32_t running_cpu[SYSCALL_MAX_PROCS];
+    uint32_t last_cpu[SYSCALL_MAX_PROCS];
+    for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
     {
-        cpu_index = __atomic_load_n(&cpu_local->cpu_index, __ATOMIC_RELAXED);
-        apic_id = __atomic_load_n(&cpu_local->apic_id, __ATOMIC_RELAXED);
+        memset(&snapshot[i], 0, sizeof(snapshot[i]));
+        running_cpu[i] = SYS_PROC_CPU_NONE;
+        last_cpu[i] = SYS_PROC_CPU_NONE;
     }
 
-    if (cpu_index >= 256)
-        cpu_index = apic_id;
+    uint32_t snapshot_count = 0;
 
-    Syscall_debug_irq_calls_cpu[cpu_index & 0x3U]++;
-    uint64_t count = __atomic_add_fetch(&Syscall_state.count_per_cpu[cpu_index], 1, __ATOMIC_RELAXED);
-    if (cpu_local)
-        __atomic_store_n(&cpu_local->syscall_count, count, __ATOMIC_RELAXED);
-
-    if (syscall_num == SYS_READ)
-        Syscall_debug_nr_read++;
-    else if (syscall_num == SYS_WRITE)
-        Syscall_debug_nr_write++;
-    else if (syscall_num == SYS_SLEEP_MS)
-        Syscall_debug_nr_sleep++;
-    else
-        Syscall_debug_nr_other++;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    for (uint32_t cpu = 0; cpu < 256; cpu++)
+    {
+        uint32_t slot = Syscall_state.cpu_current_proc[cpu];
+        if (slot >= SYSCALL_MAX_PROCS)
+            continue;
+        if (!Syscall_state.procs[slot].used)
+            continue;
+        running_cpu[slot] = cpu;
+    }
 
-    switch (syscall_num)
+    for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
     {
-        case SYS_FS_MKDIR:
+        const syscall_process_t* proc = &Syscall_state.procs[i];
+        if (!proc->used)
+            continue;
+        if (snapshot_count >= SYSCALL_MAX_PROCS)
+            break;
+        if (proc->last_cpu < 256U)
+            last_cpu[i] = proc->last_cpu;
+
+        syscall_proc_info_t* out = &snapshot[snapshot_count++];
+        out->pid = proc->pid;
+        out->ppid = proc->ppid;
+        out->owner_pid = proc->owner_pid;
+        out->domain = proc->domain;
+        out->flags = 0;
+        if (proc->is_thread)
+            out->flags |= SYS_PROC_FLAG_THREAD;
+        if (proc->exiting)
+            out->flags |= SYS_PROC_FLAG_EXITING;
+        if (proc->terminated_by_signal)
+            out->flags |= SYS_PROC_FLAG_TERMINATED_BY_SIGNAL;
+        if (proc->domain == SYS_PROC_DOMAIN_DRIVERLAND)
+            out->flags |= SYS_PROC_FLAG_DRIVERLAND;
+        if (running_cpu[i] != SYS_PROC_CPU_NONE)
+        {
+            out->flags |= SYS_PROC_FLAG_ON_CPU;
+            out->current_cpu = running_cpu[i];
+            out->last_cpu = running_cpu[i];
+        }
+        else
         {
-            char path[SYSCALL_USER_CSTR_MAX];
-            if (!Syscall_read_user_cstr(path, sizeof(path), (const char*) frame->rdi))
-                return (uint64_t) -1;
-
-            char normalized[SYSCALL_USER_CSTR_MAX];
-            if (!Syscall_normalize_write_path(path, normalized, sizeof(normalized)))
-                return (uint64_t) -1;
-
-            bool ok = VFS_mkdir(normalized);
-            return ok ? 0 : (uint64_t) -1;
+            out->current_cpu = last_cpu[i];
+            out->last_cpu = last_cpu[i];
         }
+        out->term_signal = proc->terminated_by_signal ? (uint32_t) proc->term_signal : 0U;
+        out->exit_status = proc->exit_status;
 
-        case SYS_SLEEP_MS:
+        syscall_rusage_t usage;
+        Syscall_proc_usage_running_locked(proc, running_cpu[i] != SYS_PROC_CPU_NONE, &usage);
+        out->utime_ns = usage.utime_ns;
+        out->stime_ns = usage.stime_ns;
+        out->wait_ns = usage.wait_ns;
+        out->blocked_ns = usage.blocked_ns;
+        out->nvcsw = usage.nvcsw;
+        out->nivcsw = usage.nivcsw;
+
+        const syscall_mm_t* mm = Syscall_mm_get(proc->cr3_phys);
+        if (mm)
         {
-            bool sleep_ok = HPET_sleep_ms((uint32_t) frame->rdi);
-            if (sleep_ok && cpu_index < 256)
-            {
-                __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
-                Syscall_debug_flag_set_sleep_cpu[cpu_index & 0x3U]++;
-            }
-            return sleep_ok ? 0 : (uint64_t) -1;
+            out->anon_pages = __atomic_load_n(&mm->anon_pages, __ATOMIC_RELAXED);
+            out->file_pages = __atomic_load_n(&mm->file_pages, __ATOMIC_RELAXED);
+            out->shared_pages = __atomic_load_n(&mm->shared_pages, __ATOMIC_RELAXED);
+            out->rss_pages = out->anon_pages + out->file_pages + out->shared_pages;
+            out->pt_pages = __atomic_load_n(&mm->pt_pages, __ATOMIC_RELAXED);
+            out->vm_pages = __atomic_load_n(&mm->vm_pages, __ATOMIC_RELAXED);
+            out->swap_pages = __atomic_load_n(&mm->swap_pages, __ATOMIC_RELAXED);
         }
+    }
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
-        case SYS_TICK_GET:
-            return ISR_get_timer_ticks();
+    uint32_t max_entries = (uint32_t) frame->rsi;
+    uint32_t copy_count = snapshot_count;
+    if (copy_count > max_entries)
+        copy_count = max_entries;
 
-        case SYS_RTC_TIME_GET:
-            return Syscall_rtc_epoch_seconds();
+    syscall_proc_info_t* user_entries = (syscall_proc_info_t*) frame->rdi;
+    bool copied = copy_count == 0U ||
+                  Syscall_copy_to_user(user_entries, snapshot, (size_t) copy_count * sizeof(snapshot[0]));
+    kfree(snapshot);
+    if (!copied)
+        return (uint64_t) -1;
 
-        case SYS_KDEBUG_WRITE:
-        {
-            const char* user_buf = (const char*) frame->rdi;
-            size_t len = (size_t) frame->rsi;
-            if (!user_buf || len == 0)
-                return 0;
+    uint32_t* user_total = (uint32_t*) frame->rdx;
+    if (user_total && !Syscall_copy_to_user(user_total, &snapshot_count, sizeof(snapshot_count)))
+        return (uint64_t) -1;
 
-            if (len > SYSCALL_CONSOLE_MAX_WRITE)
-                len = SYSCALL_CONSOLE_MAX_WRITE;
+    return (uint64_t) copy_count;
+}
 
-            char stack_buf[1024];
-            char* kernel_buf = stack_buf;
-            bool heap_buf = false;
-            if (len > sizeof(stack_buf))
-            {
-                kernel_buf = (char*) kmalloc(len);
-                if (!kernel_buf)
-                    return (uint64_t) -1;
-                heap_buf = true;
-            }
+static uint64_t Syscall_handle_console_write(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    const char* user_buf = (const char*) frame->rdi;
+    size_t len = (size_t) frame->rsi;
+    if (!user_buf || len == 0)
+        return 0;
 
-            if (!Syscall_copy_from_user(kernel_buf, user_buf, len))
-            {
-                if (heap_buf)
-                    kfree(kernel_buf);
-                return (uint64_t) -1;
-            }
+    if (len > SYSCALL_CONSOLE_MAX_WRITE)
+        len = SYSCALL_CONSOLE_MAX_WRITE;
 
-            for (size_t i = 0; i < len; i++)
-                kdebug_putc(kernel_buf[i]);
+    char* kernel_buf = (char*) kmalloc(len);
+    if (!kernel_buf)
+        return (uint64_t) -1;
 
-            if (heap_buf)
-                kfree(kernel_buf);
-            return (uint64_t) len;
-        }
+    if (!Syscall_copy_from_user(kernel_buf, user_buf, len))
+    {
+        kfree(kernel_buf);
+        return (uint64_t) -1;
+    }
 
-        case SYS_CPU_INFO_GET:
+    uint32_t owner_pid = Syscall_proc_current_pid(cpu_index, frame);
+    bool owner_is_driverland = Syscall_proc_owner_is_driverland(owner_pid);
+    bool write_tty = !owner_is_driverland;
+    bool mirror_kdebug = true;
+    uint32_t console_sid = Syscall_proc_current_console_sid(cpu_index, frame);
+    if (Syscall_state.console_lock_ready && console_sid != 0U)
+    {
+        uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+        int32_t route_slot = Syscall_console_route_find_locked(console_sid);
+        if (route_slot >= 0)
         {
-            syscall_cpu_info_t info;
-            memset(&info, 0, sizeof(info));
-
-            info.cpu_index = cpu_index;
-            info.apic_id = apic_id;
-            info.online_cpus = SMP_get_online_cpu_count();
-            info.tick_hz = ISR_get_tick_hz();
-            info.ticks = ISR_get_timer_ticks();
-            task_get_activity_counters(&info.sched_exec_total, &info.sched_idle_hlt_total);
-            return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+            syscall_console_route_t* route = Syscall_state.console_routes[(uint32_t) route_slot];
+            uint32_t route_flags = route->flags;
+            write_tty = (route_flags & SYS_CONSOLE_ROUTE_FLAG_TTY) != 0U;
+            if (!owner_is_driverland &&
+                (route_flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) != 0U &&
+                (route_flags & SYS_CONSOLE_ROUTE_FLAG_TTY) == 0U)
+            {
+                /* Capture-only routes (GUI bridges) should not flood kdebug/serial. */
+                mirror_kdebug = false;
+            }
+            Syscall_console_route_push_locked(route, kernel_buf, len);
         }
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+    }
 
-        case SYS_SCHED_INFO_GET:
-        {
-            syscall_sched_info_t info;
-            memset(&info, 0, sizeof(info));
+    for (size_t i = 0; i < len; i++)
+    {
+        if (write_tty)
+            putc(kernel_buf[i]);
+        if (mirror_kdebug)
+            kdebug_putc(kernel_buf[i]);
+    }
 
-            info.current_cpu = cpu_index;
-            info.preempt_count = task_get_preempt_count();
-            info.local_rq_depth = task_runqueue_depth();
-            info.total_rq_depth = task_runqueue_depth_total();
-            return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
-        }
+    kfree(kernel_buf);
+    return (uint64_t) len;
+}
 
-        case SYS_AHCI_IRQ_INFO_GET:
-        {
-            syscall_ahci_irq_info_t info;
-            memset(&info, 0, sizeof(info));
+static uint64_t Syscall_handle_console_route_set(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uint32_t flags = (uint32_t) frame->rdi;
+    uint32_t allowed =
+        SYS_CONSOLE_ROUTE_FLAG_CAPTURE | SYS_CONSOLE_ROUTE_FLAG_TTY | SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT;
+    if ((flags & ~allowed) != 0U)
+        return (uint64_t) -1;
 
-            info.mode = AHCI_get_irq_mode();
-            info.reserved = 0;
-            info.count = AHCI_get_irq_count();
-            return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
-        }
+    if (!Syscall_state.console_lock_ready)
+        return (uint64_t) -1;
 
-        case SYS_RCU_SYNC:
-            return RCU_synchronize() ? 0 : (uint64_t) -1;
+    uint32_t console_sid = Syscall_proc_current_console_sid(cpu_index, frame);
+    if (console_sid == 0U)
+        return (uint64_t) -1;
+    uint32_t owner_pid = Syscall_proc_current_pid(cpu_index, frame);
+    if (owner_pid == 0U)
+        return (uint64_t) -1;
 
-        case SYS_RCU_INFO_GET:
-        {
-            syscall_rcu_info_t info;
-            memset(&info, 0, sizeof(info));
+    syscall_console_route_t* fresh = NULL;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+    int32_t route_slot = Syscall_console_route_find_locked(console_sid);
+    if (flags == 0U)
+    {
+        syscall_console_route_t* removed = Syscall_console_route_remove_locked(route_slot);
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+        kfree(removed);
+        return 0ULL;
+    }
 
-            rcu_stats_t stats = { 0 };
-            RCU_get_stats(&stats);
-            info.gp_seq = stats.gp_seq;
-            info.gp_target = stats.gp_target;
-            info.callbacks_pending = stats.callbacks_pending;
-            info.local_read_depth = stats.local_read_depth;
-            info.local_preempt_count = stats.local_preempt_count;
-            return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
-        }
+    if (route_slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+        fresh = (syscall_console_route_t*) kmalloc(sizeof(*fresh));
+        if (!fresh)
+            return (uint64_t) -1;
 
-        case SYS_PROC_INFO_GET:
+        lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+        route_slot = Syscall_console_route_find_locked(console_sid);
+        if (route_slot < 0)
+            route_slot = Syscall_console_route_alloc_locked(owner_pid, console_sid, &fresh);
+        if (route_slot < 0)
         {
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) -1;
-
-            syscall_proc_info_t snapshot[SYSCALL_MAX_PROCS];
-            uint32_t running_cpu[SYSCALL_MAX_PROCS];
-            uint32_t last_cpu[SYSCALL_MAX_PROCS];
-            for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
-            {
-                memset(&snapshot[i], 0, sizeof(snapshot[i]));
-                running_cpu[i] = SYS_PROC_CPU_NONE;
-                last_cpu[i] = SYS_PROC_CPU_NONE;
-            }
+            spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+            kfree(fresh);
+            return (uint64_t) -1;
+        }
+    }
 
-            uint32_t snapshot_count = 0;
+    syscall_console_route_t* route = Syscall_state.console_routes[(uint32_t) route_slot];
+    if (route->owner_pid != owner_pid)
+    {
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+        kfree(fresh);
+        return (uint64_t) -1;
+    }
+    route->flags = flags;
+    if ((flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) == 0U)
+    {
+        route->head = 0U;
+        route->tail = 0U;
+        route->count = 0U;
+    }
+    if ((flags & SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT) == 0U)
+    {
+        route->in_head = 0U;
+        route->in_tail = 0U;
+        route->in_count = 0U;
+    }
+    spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+    kfree(fresh);               // Another caller set the route up first.
+    return 0ULL;
+}
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            for (uint32_t cpu = 0; cpu < 256; cpu++)
-            {
-                uint32_t slot = Syscall_state.cpu_current_proc[cpu];
-                if (slot >= SYSCALL_MAX_PROCS)
-                    continue;
-                if (!Syscall_state.procs[slot].used)
-                    continue;
-                running_cpu[slot] = cpu;
-            }
+static uint64_t Syscall_handle_console_route_read(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    char* user_buf = (char*) frame->rdi;
+    size_t cap = (size_t) frame->rsi;
+    if (!user_buf || cap == 0U)
+        return 0ULL;
 
-            for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
-            {
-                const syscall_process_t* proc = &Syscall_state.procs[i];
-                if (!proc->used)
-                    continue;
-                if (snapshot_count >= SYSCALL_MAX_PROCS)
-                    break;
-                if (proc->last_cpu < 256U)
-                    last_cpu[i] = proc->last_cpu;
-
-                syscall_proc_info_t* out = &snapshot[snapshot_count++];
-                out->pid = proc->pid;
-                out->ppid = proc->ppid;
-                out->owner_pid = proc->owner_pid;
-                out->domain = proc->domain;
-                out->flags = 0;
-                if (proc->is_thread)
-                    out->flags |= SYS_PROC_FLAG_THREAD;
-                if (proc->exiting)
-                    out->flags |= SYS_PROC_FLAG_EXITING;
-                if (proc->terminated_by_signal)
-                    out->flags |= SYS_PROC_FLAG_TERMINATED_BY_SIGNAL;
-                if (proc->domain == SYS_PROC_DOMAIN_DRIVERLAND)
-                    out->flags |= SYS_PROC_FLAG_DRIVERLAND;
-                if (running_cpu[i] != SYS_PROC_CPU_NONE)
-                {
-                    out->flags |= SYS_PROC_FLAG_ON_CPU;
-                    out->current_cpu = running_cpu[i];
-                    out->last_cpu = running_cpu[i];
-                }
-                else
-                {
-                    out->current_cpu = last_cpu[i];
-                    out->last_cpu = last_cpu[i];
-                }
-                out->term_signal = proc->terminated_by_signal ? (uint32_t) proc->term_signal : 0U;
-                out->exit_status = proc->exit_status;
-            }
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    if (cap > SYSCALL_CONSOLE_MAX_WRITE)
+        cap = SYSCALL_CONSOLE_MAX_WRITE;
 
-            uint32_t max_entries = (uint32_t) frame->rsi;
-            uint32_t copy_count = snapshot_count;
-            if (copy_count > max_entries)
-                copy_count = max_entries;
+    if (!Syscall_state.console_lock_ready)
+        return 0ULL;
 
-            syscall_proc_info_t* user_entries = (syscall_proc_info_t*) frame->rdi;
-            if (copy_count > 0U &&
-                !Syscall_copy_to_user(user_entries, snapshot, (size_t) copy_count * sizeof(snapshot[0])))
-            {
-                return (uint64_t) -1;
-            }
+    uint32_t console_sid = Syscall_proc_current_console_sid(cpu_index, frame);
+    if (console_sid == 0U)
+        return 0ULL;
+    uint32_t owner_pid = Syscall_proc_current_pid(cpu_index, frame);
+    if (owner_pid == 0U)
+        return 0ULL;
 
-            uint32_t* user_total = (uint32_t*) frame->rdx;
-            if (user_total && !Syscall_copy_to_user(user_total, &snapshot_count, sizeof(snapshot_count)))
-                return (uint64_t) -1;
+    char* kernel_buf = (char*) kmalloc(cap);
+    if (!kernel_buf)
+        return (uint64_t) -1;
 
-            return (uint64_t) copy_count;
+    size_t copied = 0U;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+    int32_t route_slot = Syscall_console_route_find_locked(console_sid);
+    if (route_slot >= 0)
+    {
+        syscall_console_route_t* route = Syscall_state.console_routes[(uint32_t) route_slot];
+        if (route->owner_pid == owner_pid &&
+            (route->flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) != 0U)
+        {
+            copied = Syscall_console_route_pop_locked(route, kernel_buf, cap);
         }
+    }
+    spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
 
-        case SYS_CONSOLE_WRITE:
-        {
-            const char* user_buf = (const char*) frame->rdi;
-            size_t len = (size_t) frame->rsi;
-            if (!user_buf || len == 0)
-                return 0;
+    if (copied == 0U)
+    {
+        kfree(kernel_buf);
+        return 0ULL;
+    }
 
-            if (len > SYSCALL_CONSOLE_MAX_WRITE)
-                len = SYSCALL_CONSOLE_MAX_WRITE;
+    if (!Syscall_copy_to_user(user_buf, kernel_buf, copied))
+    {
+        kfree(kernel_buf);
+        return (uint64_t) -1;
+    }
 
-            char* kernel_buf = (char*) kmalloc(len);
-            if (!kernel_buf)
-                return (uint64_t) -1;
+    kfree(kernel_buf);
+    return (uint64_t) copied;
+}
 
-            if (!Syscall_copy_from_user(kernel_buf, user_buf, len))
-            {
-                kfree(kernel_buf);
-                return (uint64_t) -1;
-            }
+static uint64_t Syscall_handle_console_route_set_sid(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uint32_t console_sid = (uint32_t) frame->rdi;
+    uint32_t flags = (uint32_t) frame->rsi;
+    uint32_t allowed =
+        SYS_CONSOLE_ROUTE_FLAG_CAPTURE | SYS_CONSOLE_ROUTE_FLAG_TTY | SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT;
+    if (console_sid == 0U || (flags & ~allowed) != 0U)
+        return (uint64_t) -1;
 
-            uint32_t owner_pid = Syscall_proc_current_pid(cpu_index, frame);
-            bool owner_is_driverland = Syscall_proc_owner_is_driverland(owner_pid);
-            bool write_tty = !owner_is_driverland;
-            bool mirror_kdebug = true;
-            uint32_t console_sid = Syscall_proc_current_console_sid(cpu_index, frame);
-            if (Syscall_state.console_lock_ready && console_sid != 0U)
-            {
-                uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
-                int32_t route_slot = Syscall_console_route_find_locked(console_sid);
-                if (route_slot >= 0)
-                {
-                    syscall_console_route_t* route = &Syscall_state.console_routes[(uint32_t) route_slot];
-                    uint32_t route_flags = route->flags;
-                    write_tty = (route_flags & SYS_CONSOLE_ROUTE_FLAG_TTY) != 0U;
-                    if (!owner_is_driverland &&
-                        (route_flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) != 0U &&
-                        (route_flags & SYS_CONSOLE_ROUTE_FLAG_TTY) == 0U)
-                    {
-                        /* Capture-only routes (GUI bridges) should not flood kdebug/serial. */
-                        mirror_kdebug = false;
-                    }
-                    Syscall_console_route_push_locked(route, kernel_buf, len);
-                }
-                spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-            }
+    if (!Syscall_state.console_lock_ready)
+        return (uint64_t) -1;
 
-            for (size_t i = 0; i < len; i++)
-            {
-                if (write_tty)
-                    putc(kernel_buf[i]);
-                if (mirror_kdebug)
-                    kdebug_putc(kernel_buf[i]);
-            }
+    uint32_t caller_owner_pid = Syscall_proc_current_pid(cpu_index, frame);
+    if (caller_owner_pid == 0U)
+        return (uint64_t) -1;
 
-            kfree(kernel_buf);
-            return (uint64_t) len;
+    syscall_console_route_t* fresh = NULL;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+    int32_t route_slot = Syscall_console_route_find_locked(console_sid);
+    if (flags == 0U)
+    {
+        syscall_console_route_t* removed = NULL;
+        if (route_slot >= 0 &&
+            Syscall_state.console_routes[(uint32_t) route_slot]->owner_pid == caller_owner_pid)
+        {
+            removed = Syscall_console_route_remove_locked(route_slot);
         }
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+        kfree(removed);
+        return 0ULL;
+    }
 
-        case SYS_CONSOLE_ROUTE_SET:
-        {
-            uint32_t flags = (uint32_t) frame->rdi;
-            uint32_t allowed =
-                SYS_CONSOLE_ROUTE_FLAG_CAPTURE | SYS_CONSOLE_ROUTE_FLAG_TTY | SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT;
-            if ((flags & ~allowed) != 0U)
-                return (uint64_t) -1;
+    if (route_slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+        if (!Syscall_console_sid_manageable_by(caller_owner_pid, console_sid) &&
+            !Syscall_console_sid_assign_process(caller_owner_pid, console_sid))
+            return (uint64_t) -1;
 
-            if (!Syscall_state.console_lock_ready)
-                return (uint64_t) -1;
+        fresh = (syscall_console_route_t*) kmalloc(sizeof(*fresh));
+        if (!fresh)
+            return (uint64_t) -1;
 
-            uint32_t console_sid = Syscall_proc_current_console_sid(cpu_index, frame);
-            if (console_sid == 0U)
-                return (uint64_t) -1;
-            uint32_t owner_pid = Syscall_proc_current_pid(cpu_index, frame);
-            if (owner_pid == 0U)
-                return (uint64_t) -1;
+        lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+        route_slot = Syscall_console_route_find_locked(console_sid);
+        if (route_slot < 0)
+            route_slot = Syscall_console_route_alloc_locked(caller_owner_pid, console_sid, &fresh);
+        if (route_slot < 0)
+        {
+            spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+            kfree(fresh);
+            return (uint64_t) -1;
+        }
+    }
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
-            int32_t route_slot = Syscall_console_route_find_locked(console_sid);
-            if (flags == 0U)
-            {
-                if (route_slot >= 0)
-                    memset(&Syscall_state.console_routes[(uint32_t) route_slot], 0, sizeof(syscall_console_route_t));
-                spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                return 0ULL;
-            }
+    syscall_console_route_t* route = Syscall_state.console_routes[(uint32_t) route_slot];
+    if (route->owner_pid != caller_owner_pid)
+    {
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+        kfree(fresh);
+        return (uint64_t) -1;
+    }
+    route->flags = flags;
+    if ((flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) == 0U)
+    {
+        route->head = 0U;
+        route->tail = 0U;
+        route->count = 0U;
+    }
+    if ((flags & SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT) == 0U)
+    {
+        route->in_head = 0U;
+        route->in_tail = 0U;
+        route->in_count = 0U;
+    }
+    spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+    kfree(fresh);               // Another caller set the route up first.
+    return 0ULL;
+}
 
-            if (route_slot < 0)
-            {
-                route_slot = Syscall_console_route_alloc_locked(owner_pid, console_sid);
-                if (route_slot < 0)
-                {
-                    spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                    return (uint64_t) -1;
-                }
-            }
+static uint64_t Syscall_handle_console_route_read_sid(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uint32_t console_sid = (uint32_t) frame->rdi;
+    char* user_buf = (char*) frame->rsi;
+    size_t cap = (size_t) frame->rdx;
+    if (console_sid == 0U || !user_buf || cap == 0U)
+        return 0ULL;
 
-            syscall_console_route_t* route = &Syscall_state.console_routes[(uint32_t) route_slot];
-            if (route->owner_pid != owner_pid)
-            {
-                spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                return (uint64_t) -1;
-            }
-            route->flags = flags;
-            if ((flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) == 0U)
-            {
-                route->head = 0U;
-                route->tail = 0U;
-                route->count = 0U;
-            }
-            if ((flags & SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT) == 0U)
-            {
-                route->in_head = 0U;
-                route->in_tail = 0U;
-                route->in_count = 0U;
-            }
-            spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-            return 0ULL;
-        }
+    if (cap > SYSCALL_CONSOLE_MAX_WRITE)
+        cap = SYSCALL_CONSOLE_MAX_WRITE;
+
+    if (!Syscall_state.console_lock_ready)
+        return 0ULL;
+
+    uint32_t caller_owner_pid = Syscall_proc_current_pid(cpu_index, frame);
+    if (caller_owner_pid == 0U)
+        return 0ULL;
+
+    char* kernel_buf = (char*) kmalloc(cap);
+    if (!kernel_buf)
+        return (uint64_t) -1;
 
-        case SYS_CONSOLE_ROUTE_READ:
+    size_t copied = 0U;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+    int32_t route_slot = Syscall_console_route_find_locked(console_sid);
+    if (route_slot >= 0)
+    {
+        syscall_console_route_t* route = Syscall_state.console_routes[(uint32_t) route_slot];
+        if (route->owner_pid == caller_owner_pid &&
+            (route->flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) != 0U)
         {
-            char* user_buf = (char*) frame->rdi;
-            size_t cap = (size_t) frame->rsi;
-            if (!user_buf || cap == 0U)
-                return 0ULL;
+            copied = Syscall_console_route_pop_locked(route, kernel_buf, cap);
+        }
+    }
+    spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
 
-            if (cap > SYSCALL_CONSOLE_MAX_WRITE)
-                cap = SYSCALL_CONSOLE_MAX_WRITE;
+    if (copied == 0U)
+    {
+        kfree(kernel_buf);
+        return 0ULL;
+    }
 
-            if (!Syscall_state.console_lock_ready)
-                return 0ULL;
+    if (!Syscall_copy_to_user(user_buf, kernel_buf, copied))
+    {
+        kfree(kernel_buf);
+        return (uint64_t) -1;
+    }
 
-            uint32_t console_sid = Syscall_proc_current_console_sid(cpu_index, frame);
-            if (console_sid == 0U)
-                return 0ULL;
-            uint32_t owner_pid = Syscall_proc_current_pid(cpu_index, frame);
-            if (owner_pid == 0U)
-                return 0ULL;
+    kfree(kernel_buf);
+    return (uint64_t) copied;
+}
 
-            char* kernel_buf = (char*) kmalloc(cap);
-            if (!kernel_buf)
-                return (uint64_t) -1;
+static uint64_t Syscall_handle_console_route_input_write_sid(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uint32_t console_sid = (uint32_t) frame->rdi;
+    const char* user_buf = (const char*) frame->rsi;
+    size_t len = (size_t) frame->rdx;
+    if (console_sid == 0U || !user_buf || len == 0U)
+        return (uint64_t) -1;
 
-            size_t copied = 0U;
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
-            int32_t route_slot = Syscall_console_route_find_locked(console_sid);
-            if (route_slot >= 0)
-            {
-                syscall_console_route_t* route = &Syscall_state.console_routes[(uint32_t) route_slot];
-                if (route->owner_pid == owner_pid &&
-                    (route->flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) != 0U)
-                {
-                    copied = Syscall_console_route_pop_locked(route, kernel_buf, cap);
-                }
-            }
-            spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+    if (len > SYSCALL_CONSOLE_MAX_WRITE)
+        len = SYSCALL_CONSOLE_MAX_WRITE;
 
-            if (copied == 0U)
-            {
-                kfree(kernel_buf);
-                return 0ULL;
-            }
+    if (!Syscall_state.console_lock_ready)
+        return (uint64_t) -1;
 
-            if (!Syscall_copy_to_user(user_buf, kernel_buf, copied))
-            {
-                kfree(kernel_buf);
-                return (uint64_t) -1;
-            }
+    uint32_t caller_owner_pid = Syscall_proc_current_pid(cpu_index, frame);
+    if (caller_owner_pid == 0U)
+        return (uint64_t) -1;
 
-            kfree(kernel_buf);
-            return (uint64_t) copied;
-        }
+    char* kernel_buf = (char*) kmalloc(len);
+    if (!kernel_buf)
+        return (uint64_t) -1;
 
-        case SYS_CONSOLE_ROUTE_SET_SID:
-        {
-            uint32_t console_sid = (uint32_t) frame->rdi;
-            uint32_t flags = (uint32_t) frame->rsi;
-            uint32_t allowed =
-                SYS_CONSOLE_ROUTE_FLAG_CAPTURE | SYS_CONSOLE_ROUTE_FLAG_TTY | SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT;
-            if (console_sid == 0U || (flags & ~allowed) != 0U)
-                return (uint64_t) -1;
+    if (!Syscall_copy_from_user(kernel_buf, user_buf, len))
+    {
+        kfree(kernel_buf);
+        return (uint64_t) -1;
+    }
 
-            if (!Syscall_state.console_lock_ready)
-                return (uint64_t) -1;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+    int32_t route_slot = Syscall_console_route_find_locked(console_sid);
+    if (route_slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+        kfree(kernel_buf);
+        return (uint64_t) -1;
+    }
 
-            uint32_t caller_owner_pid = Syscall_proc_current_pid(cpu_index, frame);
-            if (caller_owner_pid == 0U)
-                return (uint64_t) -1;
+    syscall_console_route_t* route = Syscall_state.console_routes[(uint32_t) route_slot];
+    if (route->owner_pid != caller_owner_pid || (route->flags & SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT) == 0U)
+    {
+        spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+        kfree(kernel_buf);
+        return (uint64_t) -1;
+    }
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
-            int32_t route_slot = Syscall_console_route_find_locked(console_sid);
-            if (flags == 0U)
-            {
-                if (route_slot >= 0 &&
-                    Syscall_state.console_routes[(uint32_t) route_slot].owner_pid == caller_owner_pid)
-                {
-                    memset(&Syscall_state.console_routes[(uint32_t) route_slot], 0, sizeof(syscall_console_route_t));
-                }
-                spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                return 0ULL;
-            }
+    Syscall_console_route_input_push_locked(route, kernel_buf, len);
+    spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+    kfree(kernel_buf);
+    return (uint64_t) len;
+}
 
-            if (route_slot < 0)
-            {
-                spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                if (!Syscall_console_sid_manageable_by(caller_owner_pid, console_sid) &&
-                    !Syscall_console_sid_assign_process(caller_owner_pid, console_sid))
-                    return (uint64_t) -1;
+static uint64_t Syscall_handle_console_route_input_read(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    char* user_buf = (char*) frame->rdi;
+    size_t cap = (size_t) frame->rsi;
+    if (!user_buf || cap == 0U)
+        return 0ULL;
 
-                lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
-                route_slot = Syscall_console_route_alloc_locked(caller_owner_pid, console_sid);
-                if (route_slot < 0)
-                {
-                    spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                    return (uint64_t) -1;
-                }
-            }
+    if (cap > SYSCALL_CONSOLE_MAX_WRITE)
+        cap = SYSCALL_CONSOLE_MAX_WRITE;
 
-            syscall_console_route_t* route = &Syscall_state.console_routes[(uint32_t) route_slot];
-            if (route->owner_pid != caller_owner_pid)
-            {
-                spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                return (uint64_t) -1;
-            }
-            route->flags = flags;
-            if ((flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) == 0U)
-            {
-                route->head = 0U;
-                route->tail = 0U;
-                route->count = 0U;
-            }
-            if ((flags & SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT) == 0U)
-            {
-                route->in_head = 0U;
-                route->in_tail = 0U;
-                route->in_count = 0U;
-            }
-            spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-            return 0ULL;
-        }
+    if (!Syscall_state.console_lock_ready)
+        return 0ULL;
 
-        case SYS_CONSOLE_ROUTE_READ_SID:
-        {
-            uint32_t console_sid = (uint32_t) frame->rdi;
-            char* user_buf = (char*) frame->rsi;
-            size_t cap = (size_t) frame->rdx;
-            if (console_sid == 0U || !user_buf || cap == 0U)
-                return 0ULL;
+    uint32_t console_sid = Syscall_proc_current_console_sid(cpu_index, frame);
+    if (console_sid == 0U)
+        return 0ULL;
 
-            if (cap > SYSCALL_CONSOLE_MAX_WRITE)
-                cap = SYSCALL_CONSOLE_MAX_WRITE;
+    char* kernel_buf = (char*) kmalloc(cap);
+    if (!kernel_buf)
+        return (uint64_t) -1;
 
-            if (!Syscall_state.console_lock_ready)
-                return 0ULL;
+    size_t copied = 0U;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
+    int32_t route_slot = Syscall_console_route_find_locked(console_sid);
+    if (route_slot >= 0)
+    {
+        syscall_console_route_t* route = Syscall_state.console_routes[(uint32_t) route_slot];
+        if ((route->flags & SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT) != 0U)
+            copied = Syscall_console_route_input_pop_locked(route, kernel_buf, cap);
+    }
+    spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
 
-            uint32_t caller_owner_pid = Syscall_proc_current_pid(cpu_index, frame);
-            if (caller_owner_pid == 0U)
-                return 0ULL;
+    if (copied == 0U)
+    {
+        kfree(kernel_buf);
+        return 0ULL;
+    }
 
-            char* kernel_buf = (char*) kmalloc(cap);
-            if (!kernel_buf)
-                return (uint64_t) -1;
+    if (!Syscall_copy_to_user(user_buf, kernel_buf, copied))
+    {
+        kfree(kernel_buf);
+        return (uint64_t) -1;
+    }
 
-            size_t copied = 0U;
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
-            int32_t route_slot = Syscall_console_route_find_locked(console_sid);
-            if (route_slot >= 0)
-            {
-                syscall_console_route_t* route = &Syscall_state.console_routes[(uint32_t) route_slot];
-                if (route->owner_pid == caller_owner_pid &&
-                    (route->flags & SYS_CONSOLE_ROUTE_FLAG_CAPTURE) != 0U)
-                {
-                    copied = Syscall_console_route_pop_locked(route, kernel_buf, cap);
-                }
-            }
-            spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+    kfree(kernel_buf);
+    return (uint64_t) copied;
+}
 
-            if (copied == 0U)
-            {
-                kfree(kernel_buf);
-                return 0ULL;
-            }
+static uint64_t Syscall_handle_exit(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    int64_t status = (int64_t) frame->rdi;
+    kdebug_printf("[USER] exit status=%lld\n", (long long) status);
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) status;
 
-            if (!Syscall_copy_to_user(user_buf, kernel_buf, copied))
-            {
-                kfree(kernel_buf);
-                return (uint64_t) -1;
-            }
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (slot >= 0)
+    {
+        Syscall_state.procs[slot].exiting = true;
+        Syscall_state.procs[slot].terminated_by_signal = false;
+        Syscall_state.procs[slot].exit_status = status;
+        Syscall_state.procs[slot].thread_exit_value = (uint64_t) status;
+        Syscall_state.procs[slot].term_signal = 0;
+    }
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    return (uint64_t) status;
+}
 
-            kfree(kernel_buf);
-            return (uint64_t) copied;
-        }
+static uint64_t Syscall_handle_fork(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-        case SYS_CONSOLE_ROUTE_INPUT_WRITE_SID:
-        {
-            uint32_t console_sid = (uint32_t) frame->rdi;
-            const char* user_buf = (const char*) frame->rsi;
-            size_t len = (size_t) frame->rdx;
-            if (console_sid == 0U || !user_buf || len == 0U)
-                return (uint64_t) -1;
+    uint32_t parent_pid = 0;
+    uintptr_t parent_cr3 = 0;
+    uintptr_t parent_fs_base = 0;
+    uint32_t parent_console_sid = 0;
+    uint32_t parent_domain = SYS_PROC_DOMAIN_USERLAND;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t parent_slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (parent_slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
 
-            if (len > SYSCALL_CONSOLE_MAX_WRITE)
-                len = SYSCALL_CONSOLE_MAX_WRITE;
+    syscall_process_t* parent = &Syscall_state.procs[parent_slot];
+    if (Syscall_proc_owner_has_other_live_non_thread_locked(parent->owner_pid, parent_slot))
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
 
-            if (!Syscall_state.console_lock_ready)
-                return (uint64_t) -1;
+    parent_pid = parent->owner_pid;
+    parent_cr3 = parent->cr3_phys;
+    parent_fs_base = parent->fs_base;
+    parent_console_sid = parent->console_sid;
+    parent_domain = parent->domain;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
-            uint32_t caller_owner_pid = Syscall_proc_current_pid(cpu_index, frame);
-            if (caller_owner_pid == 0U)
-                return (uint64_t) -1;
+    uintptr_t child_cr3 = 0;
+    if (!Syscall_clone_address_space(parent_cr3, &child_cr3))
+        return (uint64_t) -1;
 
-            char* kernel_buf = (char*) kmalloc(len);
-            if (!kernel_buf)
-                return (uint64_t) -1;
+    lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t child_slot = Syscall_proc_alloc_locked();
+    if (child_slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        Syscall_free_address_space(child_cr3);
+        return (uint64_t) -1;
+    }
+
+    uint32_t child_pid = Syscall_state.next_pid++;
+    uint32_t child_console_sid = child_pid;
+    if (Syscall_console_route_exists_for_sid(parent_console_sid))
+        child_console_sid = parent_console_sid;
+    syscall_process_t* child = &Syscall_state.procs[child_slot];
+    memset(child, 0, sizeof(*child));
+    child->used = true;
+    child->exiting = false;
+    child->terminated_by_signal = false;
+    child->owns_cr3 = true;
+    child->is_thread = false;
+    child->pid = child_pid;
+    child->ppid = parent_pid;
+    child->owner_pid = child_pid;
+    child->console_sid = child_console_sid;
+    child->domain = parent_domain;
+    child->exit_status = 0;
+    child->thread_exit_value = 0;
+    child->term_signal = 0;
+    child->cr3_phys = child_cr3;
+    child->fs_base = parent_fs_base;
+    child->rax = 0;
+    child->rcx = 0;
+    child->rdx = frame->rdx;
+    child->rsi = frame->rsi;
+    child->rdi = frame->rdi;
+    child->r8 = frame->r8;
+    child->r9 = frame->r9;
+    child->r10 = frame->r10;
+    child->r11 = 0;
+    child->r15 = frame->r15;
+    child->r14 = frame->r14;
+    child->r13 = frame->r13;
+    child->r12 = frame->r12;
+    child->rbp = frame->rbp;
+    child->rbx = frame->rbx;
+    child->rip = frame->rip;
+    child->rflags = frame->rflags | SYSCALL_RFLAGS_IF;
+    child->rsp = frame->rsp;
+    child->pending_rax = 0;
+    child->last_cpu = cpu_index;
+    parent_slot = Syscall_proc_get_current_slot_locked(cpu_index);
+    Syscall_sched_inherit_locked(child, (parent_slot >= 0) ? &Syscall_state.procs[parent_slot] : NULL);
+    Syscall_pid_hash_insert_locked((uint32_t) child_slot);
+    Syscall_rq_enqueue_new_locked((uint32_t) child_slot, cpu_index);
+    if (cpu_index < 256)
+        Syscall_state.cpu_need_resched[cpu_index] = 1;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
-            if (!Syscall_copy_from_user(kernel_buf, user_buf, len))
-            {
-                kfree(kernel_buf);
-                return (uint64_t) -1;
-            }
+    return (uint64_t) child_pid;
+}
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
-            int32_t route_slot = Syscall_console_route_find_locked(console_sid);
-            if (route_slot < 0)
-            {
-                spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                kfree(kernel_buf);
-                return (uint64_t) -1;
-            }
+static uint64_t Syscall_handle_execve(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    // A successful exec rewrites the frame the stub returns through.
+    syscall_frame_t* user_frame = (syscall_frame_t*) frame;
 
-            syscall_console_route_t* route = &Syscall_state.console_routes[(uint32_t) route_slot];
-            if (route->owner_pid != caller_owner_pid || (route->flags & SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT) == 0U)
-            {
-                spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-                kfree(kernel_buf);
-                return (uint64_t) -1;
-            }
+    char path[SYSCALL_USER_CSTR_MAX];
+    if (!Syscall_read_user_cstr(path, sizeof(path), (const char*) frame->rdi))
+        return (uint64_t) -1;
+    uint32_t exec_domain = Syscall_process_domain_from_exec_path(path);
 
-            Syscall_console_route_input_push_locked(route, kernel_buf, len);
-            spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
-            kfree(kernel_buf);
-            return (uint64_t) len;
+    if (Syscall_state.proc_lock_ready)
+    {
+        uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+        int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+        if (slot < 0)
+        {
+            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+            return (uint64_t) -1;
         }
 
-        case SYS_CONSOLE_ROUTE_INPUT_READ:
+        syscall_process_t* proc = &Syscall_state.procs[slot];
+        if (Syscall_proc_owner_has_other_live_locked(proc->owner_pid, slot))
         {
-            char* user_buf = (char*) frame->rdi;
-            size_t cap = (size_t) frame->rsi;
-            if (!user_buf || cap == 0U)
-                return 0ULL;
+            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+            return (uint64_t) -1;
+        }
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    }
 
-            if (cap > SYSCALL_CONSOLE_MAX_WRITE)
-                cap = SYSCALL_CONSOLE_MAX_WRITE;
+    char* argv_copy[SYSCALL_EXEC_MAX_ARGS];
+    char* envp_copy[SYSCALL_EXEC_MAX_ENVP];
+    size_t argc_copy = 0;
+    size_t envc_copy = 0;
+    bool argv_ok = Syscall_exec_read_user_vec((const char* const*) frame->rsi,
+                                              argv_copy,
+                                              SYSCALL_EXEC_MAX_ARGS,
+                                              &argc_copy);
+    if (!argv_ok)
+    {
+        Syscall_exec_free_vec(argv_copy, argc_copy);
+        return (uint64_t) -1;
+    }
 
-            if (!Syscall_state.console_lock_ready)
-                return 0ULL;
+    bool envp_ok = Syscall_exec_read_user_vec((const char* const*) frame->rdx,
+                                              envp_copy,
+                                              SYSCALL_EXEC_MAX_ENVP,
+                                              &envc_copy);
+    if (!envp_ok)
+    {
+        Syscall_exec_free_vec(envp_copy, envc_copy);
+        Syscall_exec_free_vec(argv_copy, argc_copy);
+        return (uint64_t) -1;
+    }
 
-            uint32_t console_sid = Syscall_proc_current_console_sid(cpu_index, frame);
-            if (console_sid == 0U)
-                return 0ULL;
+    uintptr_t new_cr3 = 0;
+    uintptr_t new_entry = 0;
+    uintptr_t new_rsp = 0;
+    if (!Syscall_execve_build_address_space(path, &new_cr3, &new_entry, &new_rsp))
+    {
+        Syscall_exec_free_vec(envp_copy, envc_copy);
+        Syscall_exec_free_vec(argv_copy, argc_copy);
+        return (uint64_t) -1;
+    }
 
-            char* kernel_buf = (char*) kmalloc(cap);
-            if (!kernel_buf)
-                return (uint64_t) -1;
+    bool stack_ok = Syscall_exec_install_initial_stack(new_cr3,
+                                                       &new_rsp,
+                                                       path,
+                                                       argv_copy,
+                                                       argc_copy,
+                                                       envp_copy,
+                                                       envc_copy);
+    Syscall_exec_free_vec(envp_copy, envc_copy);
+    Syscall_exec_free_vec(argv_copy, argc_copy);
+    if (!stack_ok)
+    {
+        Syscall_free_address_space(new_cr3);
+        return (uint64_t) -1;
+    }
 
-            size_t copied = 0U;
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.console_lock);
-            int32_t route_slot = Syscall_console_route_find_locked(console_sid);
-            if (route_slot >= 0)
-            {
-                syscall_console_route_t* route = &Syscall_state.console_routes[(uint32_t) route_slot];
-                if ((route->flags & SYS_CONSOLE_ROUTE_FLAG_PTY_INPUT) != 0U)
-                    copied = Syscall_console_route_input_pop_locked(route, kernel_buf, cap);
-            }
-            spin_unlock_irqrestore(&Syscall_state.console_lock, lock_flags);
+    uintptr_t old_cr3 = 0;
+    bool free_old = false;
+    if (Syscall_state.proc_lock_ready)
+    {
+        uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+        int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+        if (slot >= 0)
+        {
+            syscall_process_t* proc = &Syscall_state.procs[slot];
+            old_cr3 = proc->cr3_phys;
+            free_old = proc->owns_cr3 && old_cr3 != 0 && old_cr3 != new_cr3;
+            proc->cr3_phys = new_cr3;
+            proc->owns_cr3 = true;
+            proc->is_thread = false;
+            proc->owner_pid = proc->pid;
+            proc->domain = exec_domain;
+            proc->exiting = false;
+            proc->terminated_by_signal = false;
+            proc->exit_status = 0;
+            proc->thread_exit_value = 0;
+            proc->term_signal = 0;
+            proc->rax = 0;
+            proc->rcx = 0;
+            proc->rdx = 0;
+            proc->rsi = 0;
+            proc->rdi = 0;
+            proc->r8 = 0;
+            proc->r9 = 0;
+            proc->r10 = 0;
+            proc->r11 = 0;
+            proc->r15 = 0;
+            proc->r14 = 0;
+            proc->r13 = 0;
+            proc->r12 = 0;
+            proc->rbp = 0;
+            proc->rbx = 0;
+            proc->rip = new_entry;
+            proc->rflags = frame->rflags | SYSCALL_RFLAGS_IF;
+            proc->rsp = new_rsp;
+            proc->pending_rax = 0;
+            proc->fs_base = 0;
+        }
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    }
 
-            if (copied == 0U)
-            {
-                kfree(kernel_buf);
-                return 0ULL;
-            }
+    user_frame->rdx = 0;
+    user_frame->rsi = 0;
+    user_frame->rdi = 0;
+    user_frame->r8 = 0;
+    user_frame->r9 = 0;
+    user_frame->r10 = 0;
+    user_frame->r15 = 0;
+    user_frame->r14 = 0;
+    user_frame->r13 = 0;
+    user_frame->r12 = 0;
+    user_frame->rbp = 0;
+    user_frame->rbx = 0;
+    user_frame->rip = new_entry;
+    user_frame->rsp = new_rsp;
+    Syscall_write_cr3_phys(new_cr3);
+    Syscall_write_fs_base(0);
+    if (free_old)
+        Syscall_free_address_space(old_cr3);
 
-            if (!Syscall_copy_to_user(user_buf, kernel_buf, copied))
-            {
-                kfree(kernel_buf);
-                return (uint64_t) -1;
-            }
+    return 0;
+}
 
-            kfree(kernel_buf);
-            return (uint64_t) copied;
-        }
+static uint64_t Syscall_handle_yield(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (cpu_index < 256)
+    {
+        // Nobody waits for a CPU anywhere: the pick would hand this one straight back.
+        if (Syscall_state.proc_lock_ready && Syscall_proc_current_slot_fast(cpu_index) >= 0 &&
+            __atomic_load_n(&Syscall_state.queued_total, __ATOMIC_RELAXED) == 0U)
+            return 0;
 
-        case SYS_EXIT:
+        if (Syscall_state.proc_lock_ready)
         {
-            int64_t status = (int64_t) frame->rdi;
-            kdebug_printf("[USER] exit status=%lld\n", (long long) status);
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) status;
-
             uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
             int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
             if (slot >= 0)
-            {
-                Syscall_state.procs[slot].exiting = true;
-                Syscall_state.procs[slot].terminated_by_signal = false;
-                Syscall_state.procs[slot].exit_status = status;
-                Syscall_state.procs[slot].thread_exit_value = (uint64_t) status;
-                Syscall_state.procs[slot].term_signal = 0;
-            }
+                Syscall_state.procs[(uint32_t) slot].sched_yielded = true;
+            if (slot >= 0 && Syscall_proc_has_other_owner_peer_locked(slot))
+                __atomic_store_n(&Syscall_state.cpu_yield_same_owner_pick[cpu_index], 1, __ATOMIC_RELEASE);
             spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-            return (uint64_t) status;
         }
+        __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
 
-        case SYS_FORK:
-        {
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) -1;
+static uint64_t Syscall_handle_map(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uintptr_t requested = (uintptr_t) frame->rdi;
+    size_t len = (size_t) frame->rsi;
+    uint64_t prot = frame->rdx;
+    uint64_t map_flags = frame->r10;
+    int64_t map_fd = (int64_t) frame->r8;
+    uint64_t map_offset = frame->r9;
+    const uint64_t prot_mask = SYS_PROT_READ | SYS_PROT_WRITE | SYS_PROT_EXEC;
+    if (len == 0 || (prot & SYS_PROT_READ) == 0 || (prot & ~prot_mask) != 0)
+        return (uint64_t) -1;
+    if (len > ((size_t) -1 - (SYSCALL_PAGE_SIZE - 1U)))
+        return (uint64_t) -1;
 
-            uint32_t parent_pid = 0;
-            uintptr_t parent_cr3 = 0;
-            uintptr_t parent_fs_base = 0;
-            uint32_t parent_console_sid = 0;
-            uint32_t parent_domain = SYS_PROC_DOMAIN_USERLAND;
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t parent_slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            if (parent_slot < 0)
-            {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                return (uint64_t) -1;
-            }
+    size_t page_count = (len + (SYSCALL_PAGE_SIZE - 1U)) / SYSCALL_PAGE_SIZE;
+    if (page_count == 0 || page_count > SYSCALL_MAP_MAX_PAGES)
+        return (uint64_t) -1;
 
-            syscall_process_t* parent = &Syscall_state.procs[parent_slot];
-            if (Syscall_proc_owner_has_other_live_non_thread_locked(parent->owner_pid, parent_slot))
-            {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                return (uint64_t) -1;
-            }
+    bool legacy_map = (map_flags == 0 && map_fd == 0 && map_offset == 0);
+    if (legacy_map)
+    {
+        map_flags = SYS_MAP_PRIVATE | SYS_MAP_ANONYMOUS;
+        map_fd = -1;
+    }
 
-            parent_pid = parent->owner_pid;
-            parent_cr3 = parent->cr3_phys;
-            parent_fs_base = parent->fs_base;
-            parent_console_sid = parent->console_sid;
-            parent_domain = parent->domain;
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    const uint64_t supported_map_flags = SYS_MAP_PRIVATE | SYS_MAP_SHARED | SYS_MAP_ANONYMOUS | SYS_MAP_POPULATE;
+    if ((map_flags & ~supported_map_flags) != 0)
+        return (uint64_t) -1;
 
-            uintptr_t child_cr3 = 0;
-            if (!Syscall_clone_address_space(parent_cr3, &child_cr3))
-                return (uint64_t) -1;
+    bool is_private = (map_flags & SYS_MAP_PRIVATE) != 0;
+    bool is_shared = (map_flags & SYS_MAP_SHARED) != 0;
+    bool is_anon = (map_flags & SYS_MAP_ANONYMOUS) != 0;
+    if (is_private == is_shared)
+        return (uint64_t) -1;
+    if (is_anon)
+    {
+        if (map_fd != -1 || map_offset != 0)
+            return (uint64_t) -1;
+    }
+    else
+    {
+        if (map_fd < 0)
+            return (uint64_t) -1;
+        if ((map_offset & (SYSCALL_PAGE_SIZE - 1U)) != 0)
+            return (uint64_t) -1;
+    }
+
+    if (!Syscall_state.vm_lock_ready)
+        return (uint64_t) -1;
+
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    spinlock_t* vm_lock = Syscall_vm_lock(current_cr3);
+    spin_lock(vm_lock);
+    uint64_t ret = (uint64_t) -1;
+    syscall_mm_t* mm = Syscall_mm_get(current_cr3);
+    bool vm_reserved = false;
+    size_t map_size = page_count * SYSCALL_PAGE_SIZE;
+    uintptr_t base = 0;
+    bool lazy_anon = is_anon && (map_flags & SYS_MAP_POPULATE) == 0;
+    if (requested == 0)
+    {
+        // Large lazy mappings start on a 2 MiB boundary so their chunks can take huge pages.
+        if (lazy_anon && page_count >= SYSCALL_THP_PAGES &&
+            Syscall_pick_user_map_base(page_count + SYSCALL_THP_PAGES - 1U, &base))
+            base = (base + SYSCALL_THP_SIZE - 1U) & ~(SYSCALL_THP_SIZE - 1U);
+        else if (!Syscall_pick_user_map_base(page_count, &base))
+            goto map_out;
+    }
+    else
+    {
+        if ((requested & (SYSCALL_PAGE_SIZE - 1U)) != 0)
+            goto map_out;
+        if (!Syscall_mmap_window_in_bounds(requested, map_size))
+            goto map_out;
+
+        // UNIX-like hint behavior: when addr is non-null but MAP_FIXED is not requested,
+        // prefer the hinted address and fall back to another free range in the mmap window.
+        if (Syscall_user_range_unmapped(requested, map_size))
+        {
+            base = requested;
+        }
+        else
+        {
+            if (!Syscall_pick_user_map_base_from_hint(page_count, requested, &base))
+                goto map_out;
+        }
+    }
+
+    bool writable = (prot & SYS_PROT_WRITE) != 0;
+    bool executable = (prot & SYS_PROT_EXEC) != 0;
+    if (writable && executable)
+        goto map_out;
+    uintptr_t set_bits = 0;
+    uintptr_t clear_bits = 0;
+    if (!writable)
+        clear_bits |= WRITABLE;
+    if (!executable)
+        set_bits |= NO_EXECUTE;
+    else
+        clear_bits |= NO_EXECUTE;
+
+    // RLIMIT_AS counts the whole range up front, lazy pages included.
+    if (!Syscall_mm_reserve_vm(mm, page_count))
+        goto map_out;
+    vm_reserved = true;
+
+    if (lazy_anon)
+    {
+        // Only the page tables are built now: each page is allocated and zeroed on first touch.
+        uintptr_t lazy_entry = SYSCALL_PTE_LAZY | USER_MODE;
+        if (writable)
+            lazy_entry |= WRITABLE;
+        if (!executable)
+        {
+            if (!VMM_is_nx_supported())
+                goto map_out;
+            lazy_entry |= NO_EXECUTE;
+        }
 
-            lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t child_slot = Syscall_proc_alloc_locked();
-            if (child_slot < 0)
+        uintptr_t stale_pts[SYSCALL_MAP_MAX_PAGES / SYSCALL_THP_PAGES];
+        size_t stale_count = 0;
+        size_t reserved_pages = 0;
+        while (reserved_pages < page_count)
+        {
+            // Whole aligned 2 MiB chunks are reserved in one PDT entry, over an empty table if need be.
+            uintptr_t virt = base + (reserved_pages * SYSCALL_PAGE_SIZE);
+            if ((virt & (SYSCALL_THP_SIZE - 1U)) == 0 && page_count - reserved_pages >= SYSCALL_THP_PAGES)
             {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                Syscall_free_address_space(child_cr3);
-                return (uint64_t) -1;
+                uint64_t* pde = Syscall_user_pde_alloc(current_cr3, virt);
+                uintptr_t old_pt = 0;
+                if (pde && (*pde & (PRESENT | SYSCALL_PTE_PS)) == PRESENT &&
+                    stale_count < sizeof(stale_pts) / sizeof(stale_pts[0]) &&
+                    Syscall_user_pt_is_empty(*pde & FRAME))
+                    old_pt = *pde & FRAME;
+                if (pde && (*pde == 0 || old_pt != 0))
+                {
+                    if (old_pt != 0)
+                        stale_pts[stale_count++] = old_pt;
+                    *pde = lazy_entry | SYSCALL_PTE_PS;
+                    reserved_pages += SYSCALL_THP_PAGES;
+                    continue;
+                }
             }
 
-            uint32_t child_pid = Syscall_state.next_pid++;
-            uint32_t child_console_sid = child_pid;
-            if (Syscall_console_route_exists_for_sid(parent_console_sid))
-                child_console_sid = parent_console_sid;
-            syscall_process_t* child = &Syscall_state.procs[child_slot];
-            memset(child, 0, sizeof(*child));
-            Syscall_idle_claimed_slots[(uint32_t) child_slot] = 0U;
-            child->used = true;
-            child->exiting = false;
-            child->terminated_by_signal = false;
-            child->owns_cr3 = true;
-            child->is_thread = false;
-            child->pid = child_pid;
-            child->ppid = parent_pid;
-            child->owner_pid = child_pid;
-            child->console_sid = child_console_sid;
-            child->domain = parent_domain;
-            child->exit_status = 0;
-            child->thread_exit_value = 0;
-            child->term_signal = 0;
-            child->cr3_phys = child_cr3;
-            child->fs_base = parent_fs_base;
-            child->rax = 0;
-            child->rcx = 0;
-            child->rdx = frame->rdx;
-            child->rsi = frame->rsi;
-            child->rdi = frame->rdi;
-            child->r8 = frame->r8;
-            child->r9 = frame->r9;
-            child->r10 = frame->r10;
-            child->r11 = 0;
-            child->r15 = frame->r15;
-            child->r14 = frame->r14;
-            child->r13 = frame->r13;
-            child->r12 = frame->r12;
-            child->rbp = frame->rbp;
-            child->rbx = frame->rbx;
-            child->rip = frame->rip;
-            child->rflags = frame->rflags | SYSCALL_RFLAGS_IF;
-            child->rsp = frame->rsp;
-            child->pending_rax = 0;
-            child->last_cpu = cpu_index;
-            if (cpu_index < 256)
-                Syscall_state.cpu_need_resched[cpu_index] = 1;
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+            uint64_t* pte = Syscall_user_pte_alloc(current_cr3, virt);
+            if (!pte)
+                break;
 
-            return (uint64_t) child_pid;
+            *pte = lazy_entry;
+            reserved_pages++;
         }
 
-        case SYS_EXECVE:
+        if (reserved_pages != page_count)
         {
-            char path[SYSCALL_USER_CSTR_MAX];
-            if (!Syscall_read_user_cstr(path, sizeof(path), (const char*) frame->rdi))
-                return (uint64_t) -1;
-            uint32_t exec_domain = Syscall_process_domain_from_exec_path(path);
-
-            if (Syscall_state.proc_lock_ready)
+            for (size_t i = 0; i < reserved_pages; i++)
             {
-                uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-                int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-                if (slot < 0)
+                uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+                uint64_t* pde = Syscall_get_user_pde_ptr(current_cr3, virt);
+                if (pde && Syscall_pde_is_lazy_huge(*pde))
                 {
-                    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                    return (uint64_t) -1;
+                    *pde = 0;
+                    i += SYSCALL_THP_PAGES - 1U;
+                    continue;
                 }
 
-                syscall_process_t* proc = &Syscall_state.procs[slot];
-                if (Syscall_proc_owner_has_other_live_locked(proc->owner_pid, slot))
-                {
-                    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                    return (uint64_t) -1;
-                }
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+                uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, virt);
+                if (pte)
+                    *pte = 0;
             }
+        }
 
-            char* argv_copy[SYSCALL_EXEC_MAX_ARGS];
-            char* envp_copy[SYSCALL_EXEC_MAX_ENVP];
-            size_t argc_copy = 0;
-            size_t envc_copy = 0;
-            bool argv_ok = Syscall_exec_read_user_vec((const char* const*) frame->rsi,
-                                                      argv_copy,
-                                                      SYSCALL_EXEC_MAX_ARGS,
-                                                      &argc_copy);
-            if (!argv_ok)
+        // A table replaced above may still sit in paging-structure caches until this flush.
+        if (stale_count != 0)
+        {
+            VMM_flush_address_space(current_cr3);
+            for (size_t i = 0; i < stale_count; i++)
+                PMM_dealloc_page((void*) stale_pts[i]);
+            Syscall_mm_add_pt(current_cr3, -(int64_t) stale_count);
+        }
+        if (reserved_pages != page_count)
+            goto map_out;
+    }
+    else if (is_anon)
+    {
+        size_t mapped_pages = 0;
+        for (size_t i = 0; i < page_count; i++)
+        {
+            uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+            if (!Syscall_mm_charge(mm, SYSCALL_MM_ANON, 1U))
+                break;
+            uintptr_t phys = (uintptr_t) PMM_alloc_zeroed_page();
+            if (phys == 0)
             {
-                Syscall_exec_free_vec(argv_copy, argc_copy);
-                return (uint64_t) -1;
+                Syscall_mm_uncharge(mm, SYSCALL_MM_ANON, 1U);
+                break;
             }
 
-            bool envp_ok = Syscall_exec_read_user_vec((const char* const*) frame->rdx,
-                                                      envp_copy,
-                                                      SYSCALL_EXEC_MAX_ENVP,
-                                                      &envc_copy);
-            if (!envp_ok)
-            {
-                Syscall_exec_free_vec(envp_copy, envc_copy);
-                Syscall_exec_free_vec(argv_copy, argc_copy);
-                return (uint64_t) -1;
-            }
+            (void) Syscall_user_pte_alloc(current_cr3, virt);
+            VMM_map_user_page(virt, phys);
+            mapped_pages++;
 
-            uintptr_t new_cr3 = 0;
-            uintptr_t new_entry = 0;
-            uintptr_t new_rsp = 0;
-            if (!Syscall_execve_build_address_space(path, &new_cr3, &new_entry, &new_rsp))
-            {
-                Syscall_exec_free_vec(envp_copy, envc_copy);
-                Syscall_exec_free_vec(argv_copy, argc_copy);
-                return (uint64_t) -1;
-            }
+            if ((set_bits | clear_bits) != 0 &&
+                !VMM_update_page_flags(virt, set_bits, clear_bits))
+                break;
+        }
 
-            bool stack_ok = Syscall_exec_install_initial_stack(new_cr3,
-                                                               &new_rsp,
-                                                               path,
-                                                               argv_copy,
-                                                               argc_copy,
-                                                               envp_copy,
-                                                               envc_copy);
-            Syscall_exec_free_vec(envp_copy, envc_copy);
-            Syscall_exec_free_vec(argv_copy, argc_copy);
-            if (!stack_ok)
+        if (mapped_pages != page_count)
+        {
+            for (size_t i = 0; i < mapped_pages; i++)
             {
-                Syscall_free_address_space(new_cr3);
-                return (uint64_t) -1;
+                uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+                uintptr_t phys = 0;
+                if (VMM_unmap_page(virt, &phys) && phys != 0)
+                    PMM_dealloc_page((void*) phys);
             }
+            Syscall_mm_uncharge(mm, SYSCALL_MM_ANON, mapped_pages);
+            goto map_out;
+        }
+    }
+    else
+    {
+        uint32_t owner_pid = Syscall_proc_current_pid(cpu_index, frame);
+        if (owner_pid == 0 || (uint64_t) map_fd >= SYSCALL_MAX_OPEN_FILES)
+            goto map_out;
 
-            uintptr_t old_cr3 = 0;
-            bool free_old = false;
-            if (Syscall_state.proc_lock_ready)
-            {
-                uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-                int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-                if (slot >= 0)
-                {
-                    syscall_process_t* proc = &Syscall_state.procs[slot];
-                    old_cr3 = proc->cr3_phys;
-                    free_old = proc->owns_cr3 && old_cr3 != 0 && old_cr3 != new_cr3;
-                    proc->cr3_phys = new_cr3;
-                    proc->owns_cr3 = true;
-                    proc->is_thread = false;
-                    proc->owner_pid = proc->pid;
-                    proc->domain = exec_domain;
-                    proc->exiting = false;
-                    proc->terminated_by_signal = false;
-                    proc->exit_status = 0;
-                    proc->thread_exit_value = 0;
-                    proc->term_signal = 0;
-                    proc->rax = 0;
-                    proc->rcx = 0;
-                    proc->rdx = 0;
-                    proc->rsi = 0;
-                    proc->rdi = 0;
-                    proc->r8 = 0;
-                    proc->r9 = 0;
-                    proc->r10 = 0;
-                    proc->r11 = 0;
-                    proc->r15 = 0;
-                    proc->r14 = 0;
-                    proc->r13 = 0;
-                    proc->r12 = 0;
-                    proc->rbp = 0;
-                    proc->rbx = 0;
-                    proc->rip = new_entry;
-                    proc->rflags = frame->rflags | SYSCALL_RFLAGS_IF;
-                    proc->rsp = new_rsp;
-                    proc->pending_rax = 0;
-                    proc->fs_base = 0;
-                }
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-            }
+        uint32_t entry_type = SYSCALL_FD_TYPE_NONE;
+        uint32_t dmabuf_id = 0;
+        const uint8_t* regular_data = NULL;
+        size_t regular_size = 0;
 
-            frame->rdx = 0;
-            frame->rsi = 0;
-            frame->rdi = 0;
-            frame->r8 = 0;
-            frame->r9 = 0;
-            frame->r10 = 0;
-            frame->r15 = 0;
-            frame->r14 = 0;
-            frame->r13 = 0;
-            frame->r12 = 0;
-            frame->rbp = 0;
-            frame->rbx = 0;
-            frame->rip = new_entry;
-            frame->rsp = new_rsp;
-            Syscall_write_cr3_phys(new_cr3);
-            Syscall_write_fs_base(0);
-            if (free_old)
-                Syscall_free_address_space(old_cr3);
+        if (!Syscall_state.fd_lock_ready)
+            goto map_out;
 
-            return 0;
+        spin_lock(&Syscall_state.fd_lock);
+        syscall_file_desc_t* map_entry = &Syscall_state.fds[(uint32_t) map_fd];
+        if (!map_entry->used || map_entry->owner_pid != owner_pid || map_entry->io_busy)
+        {
+            spin_unlock(&Syscall_state.fd_lock);
+            goto map_out;
         }
 
-        case SYS_YIELD:
-            if (cpu_index < 256)
+        entry_type = map_entry->type;
+        if (entry_type == SYSCALL_FD_TYPE_DMABUF)
+        {
+            dmabuf_id = map_entry->drm_dmabuf_id;
+            spin_unlock(&Syscall_state.fd_lock);
+        }
+        else if (entry_type == SYSCALL_FD_TYPE_REGULAR)
+        {
+            if (!is_private)
             {
-                if (Syscall_state.proc_lock_ready)
-                {
-                    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-                    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-                    if (slot >= 0 && Syscall_proc_has_other_owner_peer_locked(slot))
-                        __atomic_store_n(&Syscall_state.cpu_yield_same_owner_pick[cpu_index], 1, __ATOMIC_RELEASE);
-                    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                }
-                __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
+                spin_unlock(&Syscall_state.fd_lock);
+                goto map_out;
+            }
+            if (!map_entry->can_read || !map_entry->data)
+            {
+                spin_unlock(&Syscall_state.fd_lock);
+                goto map_out;
             }
-            return 0;
 
-        case SYS_MAP:
+            regular_data = map_entry->data;
+            regular_size = map_entry->size;
+            map_entry->io_busy = true;
+            spin_unlock(&Syscall_state.fd_lock);
+        }
+        else
         {
-            uintptr_t requested = (uintptr_t) frame->rdi;
-            size_t len = (size_t) frame->rsi;
-            uint64_t prot = frame->rdx;
-            uint64_t map_flags = frame->r10;
-            int64_t map_fd = (int64_t) frame->r8;
-            uint64_t map_offset = frame->r9;
-            const uint64_t prot_mask = SYS_PROT_READ | SYS_PROT_WRITE | SYS_PROT_EXEC;
-            if (len == 0 || (prot & SYS_PROT_READ) == 0 || (prot & ~prot_mask) != 0)
-                return (uint64_t) -1;
-            if (len > ((size_t) -1 - (SYSCALL_PAGE_SIZE - 1U)))
-                return (uint64_t) -1;
+            spin_unlock(&Syscall_state.fd_lock);
+            goto map_out;
+        }
 
-            size_t page_count = (len + (SYSCALL_PAGE_SIZE - 1U)) / SYSCALL_PAGE_SIZE;
-            if (page_count == 0 || page_count > SYSCALL_MAP_MAX_PAGES)
-                return (uint64_t) -1;
+        if (entry_type == SYSCALL_FD_TYPE_DMABUF)
+        {
+            if (!is_shared || dmabuf_id == 0)
+                goto map_out;
 
-            bool legacy_map = (map_flags == 0 && map_fd == 0 && map_offset == 0);
-            if (legacy_map)
-            {
-                map_flags = SYS_MAP_PRIVATE | SYS_MAP_ANONYMOUS;
-                map_fd = -1;
-            }
+            uint64_t dmabuf_size = 0;
+            uint32_t dmabuf_pages = 0;
+            if (!DRM_dmabuf_get_layout(dmabuf_id, &dmabuf_size, &dmabuf_pages))
+                goto map_out;
+            uint64_t request_len = (uint64_t) len;
+            if (request_len > (uint64_t) -1 - map_offset)
+                goto map_out;
+            uint64_t request_end = map_offset + request_len;
+            if (request_end > dmabuf_size)
+                goto map_out;
 
-            const uint64_t supported_map_flags = SYS_MAP_PRIVATE | SYS_MAP_SHARED | SYS_MAP_ANONYMOUS;
-            if ((map_flags & ~supported_map_flags) != 0)
-                return (uint64_t) -1;
+            if ((uint64_t) map_size > (uint64_t) -1 - map_offset)
+                goto map_out;
+            uint64_t map_end = map_offset + (uint64_t) map_size;
+            uint64_t dmabuf_mappable_end = (uint64_t) dmabuf_pages * (uint64_t) SYSCALL_PAGE_SIZE;
+            if (map_end > dmabuf_mappable_end)
+                goto map_out;
 
-            bool is_private = (map_flags & SYS_MAP_PRIVATE) != 0;
-            bool is_shared = (map_flags & SYS_MAP_SHARED) != 0;
-            bool is_anon = (map_flags & SYS_MAP_ANONYMOUS) != 0;
-            if (is_private == is_shared)
-                return (uint64_t) -1;
-            if (is_anon)
-            {
-                if (map_fd != -1 || map_offset != 0)
-                    return (uint64_t) -1;
-            }
-            else
+            size_t mapped_pages = 0;
+            uint32_t start_page = (uint32_t) (map_offset / SYSCALL_PAGE_SIZE);
+            for (size_t i = 0; i < page_count; i++)
             {
-                if (map_fd < 0)
-                    return (uint64_t) -1;
-                if ((map_offset & (SYSCALL_PAGE_SIZE - 1U)) != 0)
-                    return (uint64_t) -1;
-            }
+                uint32_t page_index = start_page + (uint32_t) i;
+                if (page_index >= dmabuf_pages)
+                    break;
 
-            if (!Syscall_state.vm_lock_ready)
-                return (uint64_t) -1;
+                uintptr_t phys = 0;
+                if (!DRM_dmabuf_get_page_phys(dmabuf_id, page_index, &phys) || phys == 0)
+                    break;
 
-            spin_lock(&Syscall_state.vm_lock);
-            uint64_t ret = (uint64_t) -1;
-            size_t map_size = page_count * SYSCALL_PAGE_SIZE;
-            uintptr_t base = 0;
-            if (requested == 0)
-            {
-                if (!Syscall_pick_user_map_base(page_count, &base))
-                    goto map_out;
+                uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+                if (!Syscall_mm_charge(mm, SYSCALL_MM_SHARED, 1U))
+                    break;
+                (void) Syscall_user_pte_alloc(current_cr3, virt);
+                VMM_map_page_flags(virt, phys, USER_MODE);
+                mapped_pages++;
+
+                uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, virt);
+                if (!pte)
+                    break;
+                *pte |= SYSCALL_PTE_DMABUF;
+
+                if ((set_bits | clear_bits) != 0 &&
+                    !VMM_update_page_flags(virt, set_bits, clear_bits))
+                    break;
             }
-            else
+
+            if (mapped_pages != page_count)
             {
-                if ((requested & (SYSCALL_PAGE_SIZE - 1U)) != 0)
-                    goto map_out;
-                if (!Syscall_mmap_window_in_bounds(requested, map_size))
-                    goto map_out;
-
-                // UNIX-like hint behavior: when addr is non-null but MAP_FIXED is not requested,
-                // prefer the hinted address and fall back to another free range in the mmap window.
-                if (Syscall_user_range_unmapped(requested, map_size))
-                {
-                    base = requested;
-                }
-                else
+                for (size_t i = 0; i < mapped_pages; i++)
                 {
-                    if (!Syscall_pick_user_map_base_from_hint(page_count, requested, &base))
-                        goto map_out;
+                    uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+                    (void) VMM_unmap_page(virt, NULL);
                 }
-            }
-
-            bool writable = (prot & SYS_PROT_WRITE) != 0;
-            bool executable = (prot & SYS_PROT_EXEC) != 0;
-            if (writable && executable)
+                Syscall_mm_uncharge(mm, SYSCALL_MM_SHARED, mapped_pages);
                 goto map_out;
-            uintptr_t set_bits = 0;
-            uintptr_t clear_bits = 0;
-            if (!writable)
-                clear_bits |= WRITABLE;
-            if (!executable)
-                set_bits |= NO_EXECUTE;
-            else
-                clear_bits |= NO_EXECUTE;
+            }
 
-            if (is_anon)
+            if (!DRM_dmabuf_ref_map_pages(dmabuf_id, (uint32_t) page_count))
             {
-                size_t mapped_pages = 0;
-                for (size_t i = 0; i < page_count; i++)
+                for (size_t i = 0; i < mapped_pages; i++)
                 {
                     uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                    uintptr_t phys = (uintptr_t) PMM_alloc_page();
-                    if (phys == 0)
-                        break;
-
-                    VMM_map_user_page(virt, phys);
-                    mapped_pages++;
-                    memset((void*) virt, 0, SYSCALL_PAGE_SIZE);
-
-                    if ((set_bits | clear_bits) != 0 &&
-                        !VMM_update_page_flags(virt, set_bits, clear_bits))
-                        break;
+                    (void) VMM_unmap_page(virt, NULL);
                 }
+                Syscall_mm_uncharge(mm, SYSCALL_MM_SHARED, mapped_pages);
+                goto map_out;
+            }
+        }
+        else
+        {
+            bool clear_io_busy = true;
+            uint64_t request_len = (uint64_t) len;
+            if (request_len > (uint64_t) -1 - map_offset)
+                goto map_regular_out;
 
-                if (mapped_pages != page_count)
+            uint64_t request_end = map_offset + request_len;
+            if (request_end > (uint64_t) regular_size)
+                goto map_regular_out;
+
+            size_t mapped_pages = 0;
+            for (size_t i = 0; i < page_count; i++)
+            {
+                uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+                if (!Syscall_mm_charge(mm, SYSCALL_MM_FILE, 1U))
+                    break;
+                uintptr_t phys = (uintptr_t) PMM_alloc_zeroed_page();
+                if (phys == 0)
                 {
-                    for (size_t i = 0; i < mapped_pages; i++)
-                    {
-                        uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                        uintptr_t phys = 0;
-                        if (VMM_unmap_page(virt, &phys) && phys != 0)
-                            PMM_dealloc_page((void*) phys);
-                    }
-                    goto map_out;
+                    Syscall_mm_uncharge(mm, SYSCALL_MM_FILE, 1U);
+                    break;
                 }
-            }
-            else
-            {
-                uint32_t owner_pid = Syscall_proc_current_pid(cpu_index, frame);
-                if (owner_pid == 0 || (uint64_t) map_fd >= SYSCALL_MAX_OPEN_FILES)
-                    goto map_out;
 
-                uint32_t entry_type = SYSCALL_FD_TYPE_NONE;
-                uint32_t dmabuf_id = 0;
-                const uint8_t* regular_data = NULL;
-                size_t regular_size = 0;
+                (void) Syscall_user_pte_alloc(current_cr3, virt);
+                VMM_map_user_page(virt, phys);
+                mapped_pages++;
 
-                if (!Syscall_state.fd_lock_ready)
-                    goto map_out;
+                uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, virt);
+                if (pte)
+                    *pte |= SYSCALL_PTE_FILE;
 
-                spin_lock(&Syscall_state.fd_lock);
-                syscall_file_desc_t* map_entry = &Syscall_state.fds[(uint32_t) map_fd];
-                if (!map_entry->used || map_entry->owner_pid != owner_pid || map_entry->io_busy)
+                uint64_t page_off = map_offset + (uint64_t) (i * SYSCALL_PAGE_SIZE);
+                if (page_off < (uint64_t) regular_size)
                 {
-                    spin_unlock(&Syscall_state.fd_lock);
-                    goto map_out;
+                    uint64_t remain64 = (uint64_t) regular_size - page_off;
+                    size_t copy_size = (remain64 > SYSCALL_PAGE_SIZE) ? SYSCALL_PAGE_SIZE : (size_t) remain64;
+                    memcpy((void*) virt, regular_data + (size_t) page_off, copy_size);
                 }
 
-                entry_type = map_entry->type;
-                if (entry_type == SYSCALL_FD_TYPE_DMABUF)
-                {
-                    dmabuf_id = map_entry->drm_dmabuf_id;
-                    spin_unlock(&Syscall_state.fd_lock);
-                }
-                else if (entry_type == SYSCALL_FD_TYPE_REGULAR)
-                {
-                    if (!is_private)
-                    {
-                        spin_unlock(&Syscall_state.fd_lock);
-                        goto map_out;
-                    }
-                    if (!map_entry->can_read || !map_entry->data)
-                    {
-                        spin_unlock(&Syscall_state.fd_lock);
-                        goto map_out;
-                    }
+                if ((set_bits | clear_bits) != 0 &&
+                    !VMM_update_page_flags(virt, set_bits, clear_bits))
+                    break;
+            }
 
-                    regular_data = map_entry->data;
-                    regular_size = map_entry->size;
-                    map_entry->io_busy = true;
-                    spin_unlock(&Syscall_state.fd_lock);
-                }
-                else
+            if (mapped_pages != page_count)
+            {
+                for (size_t i = 0; i < mapped_pages; i++)
                 {
-                    spin_unlock(&Syscall_state.fd_lock);
-                    goto map_out;
+                    uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+                    uintptr_t phys = 0;
+                    if (VMM_unmap_page(virt, &phys) && phys != 0)
+                        PMM_dealloc_page((void*) phys);
                 }
+                Syscall_mm_uncharge(mm, SYSCALL_MM_FILE, mapped_pages);
+                goto map_regular_out;
+            }
 
-                if (entry_type == SYSCALL_FD_TYPE_DMABUF)
-                {
-                    if (!is_shared || dmabuf_id == 0)
-                        goto map_out;
-
-                    uint64_t dmabuf_size = 0;
-                    uint32_t dmabuf_pages = 0;
-                    if (!DRM_dmabuf_get_layout(dmabuf_id, &dmabuf_size, &dmabuf_pages))
-                        goto map_out;
-                    uint64_t request_len = (uint64_t) len;
-                    if (request_len > (uint64_t) -1 - map_offset)
-                        goto map_out;
-                    uint64_t request_end = map_offset + request_len;
-                    if (request_end > dmabuf_size)
-                        goto map_out;
-
-                    if ((uint64_t) map_size > (uint64_t) -1 - map_offset)
-                        goto map_out;
-                    uint64_t map_end = map_offset + (uint64_t) map_size;
-                    uint64_t dmabuf_mappable_end = (uint64_t) dmabuf_pages * (uint64_t) SYSCALL_PAGE_SIZE;
-                    if (map_end > dmabuf_mappable_end)
-                        goto map_out;
-
-                    size_t mapped_pages = 0;
-                    uint32_t start_page = (uint32_t) (map_offset / SYSCALL_PAGE_SIZE);
-                    for (size_t i = 0; i < page_count; i++)
-                    {
-                        uint32_t page_index = start_page + (uint32_t) i;
-                        if (page_index >= dmabuf_pages)
-                            break;
-
-                        uintptr_t phys = 0;
-                        if (!DRM_dmabuf_get_page_phys(dmabuf_id, page_index, &phys) || phys == 0)
-                            break;
-
-                        uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                        VMM_map_page_flags(virt, phys, USER_MODE);
-                        mapped_pages++;
-
-                        uint64_t* pte = Syscall_get_user_pte_ptr(Syscall_read_cr3_phys(), virt);
-                        if (!pte)
-                            break;
-                        *pte |= SYSCALL_PTE_DMABUF;
-
-                        if ((set_bits | clear_bits) != 0 &&
-                            !VMM_update_page_flags(virt, set_bits, clear_bits))
-                            break;
-                    }
-
-                    if (mapped_pages != page_count)
-                    {
-                        for (size_t i = 0; i < mapped_pages; i++)
-                        {
-                            uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                            (void) VMM_unmap_page(virt, NULL);
-                        }
-                        goto map_out;
-                    }
+            clear_io_busy = false;
+            ret = (uint64_t) base;
 
-                    if (!DRM_dmabuf_ref_map_pages(dmabuf_id, (uint32_t) page_count))
-                    {
-                        for (size_t i = 0; i < mapped_pages; i++)
-                        {
-                            uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                            (void) VMM_unmap_page(virt, NULL);
-                        }
-                        goto map_out;
-                    }
-                }
-                else
+map_regular_out:
+            if (Syscall_state.fd_lock_ready)
+            {
+                spin_lock(&Syscall_state.fd_lock);
+                map_entry = &Syscall_state.fds[(uint32_t) map_fd];
+                if (map_entry->used &&
+                    map_entry->owner_pid == owner_pid &&
+                    map_entry->type == SYSCALL_FD_TYPE_REGULAR)
                 {
-                    bool clear_io_busy = true;
-                    uint64_t request_len = (uint64_t) len;
-                    if (request_len > (uint64_t) -1 - map_offset)
-                        goto map_regular_out;
+                    map_entry->io_busy = false;
+                }
+                spin_unlock(&Syscall_state.fd_lock);
+            }
+            if (clear_io_busy)
+                goto map_out;
+            goto map_out;
+        }
+    }
+    ret = (uint64_t) base;
 
-                    uint64_t request_end = map_offset + request_len;
-                    if (request_end > (uint64_t) regular_size)
-                        goto map_regular_out;
+map_out:
+    if (ret == (uint64_t) -1 && vm_reserved)
+        Syscall_mm_release_vm(mm, page_count);
+    spin_unlock(vm_lock);
+    return ret;
+}
 
-                    size_t mapped_pages = 0;
-                    for (size_t i = 0; i < page_count; i++)
-                    {
-                        uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                        uintptr_t phys = (uintptr_t) PMM_alloc_page();
-                        if (phys == 0)
-                            break;
+static uint64_t Syscall_handle_unmap(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-                        VMM_map_user_page(virt, phys);
-                        mapped_pages++;
-                        memset((void*) virt, 0, SYSCALL_PAGE_SIZE);
+    uintptr_t base = (uintptr_t) frame->rdi;
+    size_t len = (size_t) frame->rsi;
+    if (len == 0 || (base & (SYSCALL_PAGE_SIZE - 1U)) != 0)
+        return (uint64_t) -1;
+    if (len > ((size_t) -1 - (SYSCALL_PAGE_SIZE - 1U)))
+        return (uint64_t) -1;
 
-                        uint64_t page_off = map_offset + (uint64_t) (i * SYSCALL_PAGE_SIZE);
-                        if (page_off < (uint64_t) regular_size)
-                        {
-                            uint64_t remain64 = (uint64_t) regular_size - page_off;
-                            size_t copy_size = (remain64 > SYSCALL_PAGE_SIZE) ? SYSCALL_PAGE_SIZE : (size_t) remain64;
-                            memcpy((void*) virt, regular_data + (size_t) page_off, copy_size);
-                        }
+    size_t page_count = (len + (SYSCALL_PAGE_SIZE - 1U)) / SYSCALL_PAGE_SIZE;
+    if (page_count == 0 || page_count > SYSCALL_MAP_MAX_PAGES)
+        return (uint64_t) -1;
+    if (!Syscall_state.vm_lock_ready)
+        return (uint64_t) -1;
 
-                        if ((set_bits | clear_bits) != 0 &&
-                            !VMM_update_page_flags(virt, set_bits, clear_bits))
-                            break;
-                    }
+    spinlock_t* vm_lock = Syscall_vm_lock(Syscall_read_cr3_phys());
+    spin_lock(vm_lock);
+    uint64_t ret = (uint64_t) -1;
+    size_t map_size = page_count * SYSCALL_PAGE_SIZE;
+    if (!Syscall_mmap_window_in_bounds(base, map_size))
+        goto unmap_out;
 
-                    if (mapped_pages != page_count)
-                    {
-                        for (size_t i = 0; i < mapped_pages; i++)
-                        {
-                            uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                            uintptr_t phys = 0;
-                            if (VMM_unmap_page(virt, &phys) && phys != 0)
-                                PMM_dealloc_page((void*) phys);
-                        }
-                        goto map_regular_out;
-                    }
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    for (size_t i = 0; i < page_count; i++)
+    {
+        uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+        if (!VMM_is_user_accessible(virt) && !Syscall_user_page_is_lazy(current_cr3, virt))
+            goto unmap_out;
+    }
 
-                    clear_io_busy = false;
-                    ret = (uint64_t) base;
+    // 2 MiB entries are edited 4 KiB at a time: split them all first, before anything changes.
+    if (!Syscall_thp_split_range_locked(current_cr3, base, map_size))
+        goto unmap_out;
 
-map_regular_out:
-                    if (Syscall_state.fd_lock_ready)
-                    {
-                        spin_lock(&Syscall_state.fd_lock);
-                        map_entry = &Syscall_state.fds[(uint32_t) map_fd];
-                        if (map_entry->used &&
-                            map_entry->owner_pid == owner_pid &&
-                            map_entry->type == SYSCALL_FD_TYPE_REGULAR)
-                        {
-                            map_entry->io_busy = false;
-                        }
-                        spin_unlock(&Syscall_state.fd_lock);
-                    }
-                    if (clear_io_busy)
-                        goto map_out;
-                    goto map_out;
+    /*
+     * Unmap in batches with one TLB flush each (a single IPI per CPU running this address
+     * space); a frame may only be released once no TLB can still reach it.
+     */
+    uintptr_t batch_phys[SYSCALL_UNMAP_BATCH_PAGES];
+    uint64_t batch_pte[SYSCALL_UNMAP_BATCH_PAGES];
+    uint64_t uncharged[SYSCALL_MM_SHARED + 1U] = { 0 };
+    uint64_t swapped_out = 0;
+    size_t done = 0;
+    bool unmap_ok = true;
+    while (unmap_ok && done < page_count)
+    {
+        uintptr_t batch_base = base + (done * SYSCALL_PAGE_SIZE);
+        size_t batch_count = 0;
+        while (batch_count < SYSCALL_UNMAP_BATCH_PAGES && done + batch_count < page_count)
+        {
+            uintptr_t virt = batch_base + (batch_count * SYSCALL_PAGE_SIZE);
+            uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, virt);
+            uint64_t pte_bits = pte ? (*pte & (SYSCALL_PTE_COW | SYSCALL_PTE_DMABUF |
+                                               SYSCALL_PTE_VVAR | SYSCALL_PTE_FILE)) : 0;
+            uintptr_t phys = 0;
+            if (pte && (*pte & (PRESENT | SYSCALL_PTE_LAZY)) == SYSCALL_PTE_LAZY)
+            {
+                // Never touched or swapped out: no frame and nothing any TLB could hold.
+                if ((*pte & SYSCALL_PTE_SWAP) != 0)
+                {
+                    zswap_free(Syscall_swap_slot(*pte));
+                    swapped_out++;
                 }
+                *pte = 0;
+            }
+            else if (!VMM_unmap_page_noflush(virt, &phys))
+            {
+                unmap_ok = false;
+                break;
             }
-            ret = (uint64_t) base;
 
-map_out:
-            spin_unlock(&Syscall_state.vm_lock);
-            return ret;
+            batch_phys[batch_count] = phys;
+            batch_pte[batch_count] = pte_bits;
+            batch_count++;
         }
 
-        case SYS_UNMAP:
+        VMM_flush_tlb_range(batch_base, batch_count);
+        for (size_t i = 0; i < batch_count; i++)
         {
-            uintptr_t base = (uintptr_t) frame->rdi;
-            size_t len = (size_t) frame->rsi;
-            if (len == 0 || (base & (SYSCALL_PAGE_SIZE - 1U)) != 0)
-                return (uint64_t) -1;
-            if (len > ((size_t) -1 - (SYSCALL_PAGE_SIZE - 1U)))
-                return (uint64_t) -1;
-
-            size_t page_count = (len + (SYSCALL_PAGE_SIZE - 1U)) / SYSCALL_PAGE_SIZE;
-            if (page_count == 0 || page_count > SYSCALL_MAP_MAX_PAGES)
-                return (uint64_t) -1;
-            if (!Syscall_state.vm_lock_ready)
-                return (uint64_t) -1;
-
-            spin_lock(&Syscall_state.vm_lock);
-            uint64_t ret = (uint64_t) -1;
-            size_t map_size = page_count * SYSCALL_PAGE_SIZE;
-            if (!Syscall_mmap_window_in_bounds(base, map_size))
-                goto unmap_out;
+            uintptr_t phys = batch_phys[i];
+            if (phys == 0)
+                continue;
 
-            for (size_t i = 0; i < page_count; i++)
+            uncharged[Syscall_mm_kind_of(batch_pte[i] | phys)]++;
+            if ((batch_pte[i] & SYSCALL_PTE_DMABUF) != 0)
             {
-                uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                if (!VMM_is_user_accessible(virt))
-                    goto unmap_out;
+                (void) DRM_dmabuf_unref_map_pages_by_phys(phys, 1U);
             }
-
-            for (size_t i = 0; i < page_count; i++)
+            else if ((batch_pte[i] & SYSCALL_PTE_COW) != 0)
             {
-                uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                uintptr_t phys = 0;
-                bool was_cow = false;
-                bool was_dmabuf = false;
-                uint64_t* pte = Syscall_get_user_pte_ptr(Syscall_read_cr3_phys(), virt);
-                if (pte && ((*pte & SYSCALL_PTE_COW) != 0))
-                    was_cow = true;
-                if (pte && ((*pte & SYSCALL_PTE_DMABUF) != 0))
-                    was_dmabuf = true;
-                if (!VMM_unmap_page(virt, &phys))
-                    goto unmap_out;
-                if (phys != 0)
-                {
-                    if (was_dmabuf)
-                    {
-                        (void) DRM_dmabuf_unref_map_pages_by_phys(phys, 1U);
-                    }
-                    else if (was_cow)
-                    {
-                        bool ref_zero = false;
-                        if (Syscall_cow_ref_sub(phys, &ref_zero) && ref_zero)
-                            PMM_dealloc_page((void*) phys);
-                    }
-                    else
-                        PMM_dealloc_page((void*) phys);
-                }
+                bool ref_zero = false;
+                if (Syscall_cow_ref_sub(phys, &ref_zero) && ref_zero)
+                    PMM_dealloc_page((void*) phys);
             }
-            ret = 0;
+            else if (Syscall_page_is_shm(phys))
+                Syscall_shm_page_unmapped(phys);
+            else
+                PMM_dealloc_page((void*) phys);
+        }
+        done += batch_count;
+    }
+
+    syscall_mm_t* mm = Syscall_mm_get(current_cr3);
+    Syscall_mm_uncharge(mm, SYSCALL_MM_ANON, uncharged[SYSCALL_MM_ANON]);
+    Syscall_mm_uncharge(mm, SYSCALL_MM_FILE, uncharged[SYSCALL_MM_FILE]);
+    Syscall_mm_uncharge(mm, SYSCALL_MM_SHARED, uncharged[SYSCALL_MM_SHARED]);
+    if (mm && swapped_out != 0)
+        __atomic_sub_fetch(&mm->swap_pages, swapped_out, __ATOMIC_RELAXED);
+    Syscall_mm_release_vm(mm, done);
+    if (!unmap_ok)
+        goto unmap_out;
+    ret = 0;
 
 unmap_out:
-            spin_unlock(&Syscall_state.vm_lock);
-            return ret;
-        }
+    spin_unlock(vm_lock);
+    return ret;
+}
+
+static uint64_t Syscall_handle_mprotect(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
+
+    uintptr_t base = (uintptr_t) frame->rdi;
+    size_t len = (size_t) frame->rsi;
+    uint64_t prot = frame->rdx;
+    const uint64_t prot_mask = SYS_PROT_READ | SYS_PROT_WRITE | SYS_PROT_EXEC;
+    if (len == 0 || (base & (SYSCALL_PAGE_SIZE - 1U)) != 0 ||
+        (prot & SYS_PROT_READ) == 0 || (prot & ~prot_mask) != 0)
+        return (uint64_t) -1;
+    if (len > ((size_t) -1 - (SYSCALL_PAGE_SIZE - 1U)))
+        return (uint64_t) -1;
+
+    size_t page_count = (len + (SYSCALL_PAGE_SIZE - 1U)) / SYSCALL_PAGE_SIZE;
+    if (page_count == 0 || page_count > SYSCALL_MAP_MAX_PAGES)
+        return (uint64_t) -1;
+    if (!Syscall_state.vm_lock_ready)
+        return (uint64_t) -1;
+
+    spinlock_t* vm_lock = Syscall_vm_lock(Syscall_read_cr3_phys());
+    spin_lock(vm_lock);
+    uint64_t ret = (uint64_t) -1;
+    size_t map_size = page_count * SYSCALL_PAGE_SIZE;
+    if (!Syscall_mmap_window_in_bounds(base, map_size))
+        goto mprotect_out;
 
-        case SYS_MPROTECT:
-        {
-            uintptr_t base = (uintptr_t) frame->rdi;
-            size_t len = (size_t) frame->rsi;
-            uint64_t prot = frame->rdx;
-            const uint64_t prot_mask = SYS_PROT_READ | SYS_PROT_WRITE | SYS_PROT_EXEC;
-            if (len == 0 || (base & (SYSCALL_PAGE_SIZE - 1U)) != 0 ||
-                (prot & SYS_PROT_READ) == 0 || (prot & ~prot_mask) != 0)
-                return (uint64_t) -1;
-            if (len > ((size_t) -1 - (SYSCALL_PAGE_SIZE - 1U)))
-                return (uint64_t) -1;
+    uintptr_t current_cr3 = Syscall_read_cr3_phys();
+    for (size_t i = 0; i < page_count; i++)
+    {
+        uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+        if (!VMM_is_user_accessible(virt) && !Syscall_user_page_is_lazy(current_cr3, virt))
+            goto mprotect_out;
+    }
 
-            size_t page_count = (len + (SYSCALL_PAGE_SIZE - 1U)) / SYSCALL_PAGE_SIZE;
-            if (page_count == 0 || page_count > SYSCALL_MAP_MAX_PAGES)
-                return (uint64_t) -1;
-            if (!Syscall_state.vm_lock_ready)
-                return (uint64_t) -1;
+    if (!Syscall_thp_split_range_locked(current_cr3, base, map_size))
+        goto mprotect_out;
 
-            spin_lock(&Syscall_state.vm_lock);
-            uint64_t ret = (uint64_t) -1;
-            size_t map_size = page_count * SYSCALL_PAGE_SIZE;
-            if (!Syscall_mmap_window_in_bounds(base, map_size))
+    bool writable = (prot & SYS_PROT_WRITE) != 0;
+    bool executable = (prot & SYS_PROT_EXEC) != 0;
+    if (writable && executable)
+        goto mprotect_out;
+    uintptr_t set_bits = writable ? WRITABLE : 0;
+    uintptr_t clear_bits = writable ? 0 : WRITABLE;
+    if (!executable)
+        set_bits |= NO_EXECUTE;
+    else
+        clear_bits |= NO_EXECUTE;
+
+    if (writable)
+    {
+        for (size_t i = 0; i < page_count; i++)
+        {
+            uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
+            uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, virt);
+            if (pte && ((*pte & SYSCALL_PTE_COW) != 0))
                 goto mprotect_out;
+        }
+    }
+    // Nothing is freed here: the whole range shares one TLB flush, even a partial one.
+    // Untouched lazy pages only carry the protection their first fault will install.
+    const uintptr_t lazy_mask = WRITABLE | NO_EXECUTE;
+    size_t updated = 0;
+    while (updated < page_count)
+    {
+        uintptr_t virt = base + (updated * SYSCALL_PAGE_SIZE);
+        uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, virt);
+        if (pte && (*pte & (PRESENT | SYSCALL_PTE_LAZY)) == SYSCALL_PTE_LAZY)
+        {
+            if ((set_bits & NO_EXECUTE) != 0 && !VMM_is_nx_supported())
+                break;
+            *pte = (*pte | (set_bits & lazy_mask)) & ~(clear_bits & lazy_mask);
+        }
+        else if (!VMM_update_page_flags_noflush(virt, set_bits, clear_bits))
+            break;
+        updated++;
+    }
+    VMM_flush_tlb_range(base, updated);
+    if (updated != page_count)
+        goto mprotect_out;
+    ret = 0;
 
-            for (size_t i = 0; i < page_count; i++)
-            {
-                uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                if (!VMM_is_user_accessible(virt))
-                    goto mprotect_out;
-            }
+mprotect_out:
+    spin_unlock(vm_lock);
+    return ret;
+}
 
-            bool writable = (prot & SYS_PROT_WRITE) != 0;
-            bool executable = (prot & SYS_PROT_EXEC) != 0;
-            if (writable && executable)
-                goto mprotect_out;
-            uintptr_t set_bits = writable ? WRITABLE : 0;
-            uintptr_t clear_bits = writable ? 0 : WRITABLE;
-            if (!executable)
-                set_bits |= NO_EXECUTE;
-            else
-                clear_bits |= NO_EXECUTE;
+static uint64_t Syscall_handle_getpid(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    return Syscall_proc_current_pid(cpu_index, frame);
+}
 
-            if (writable)
-            {
-                uintptr_t current_cr3 = Syscall_read_cr3_phys();
-                for (size_t i = 0; i < page_count; i++)
-                {
-                    uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                    uint64_t* pte = Syscall_get_user_pte_ptr(current_cr3, virt);
-                    if (pte && ((*pte & SYSCALL_PTE_COW) != 0))
-                        goto mprotect_out;
-                }
-            }
-            for (size_t i = 0; i < page_count; i++)
-            {
-                uintptr_t virt = base + (i * SYSCALL_PAGE_SIZE);
-                if (!VMM_update_page_flags(virt, set_bits, clear_bits))
-                    goto mprotect_out;
-            }
-            ret = 0;
+static uint64_t Syscall_handle_kbd_get_scancode(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uint32_t caller_pid = Syscall_proc_current_pid(cpu_index, frame);
+    uint8_t injected = 0U;
+    if (caller_pid != 0U && Syscall_kbd_inject_pop_for_pid(caller_pid, &injected))
+        return (uint64_t) injected;
+    if (caller_pid != 0U && Syscall_kbd_inject_is_target(caller_pid))
+    {
+        Syscall_kbd_inject_target_hits++;
+        return 0ULL;
+    }
+    if (Syscall_kbd_hardware_capture_pid != 0U && caller_pid != Syscall_kbd_hardware_capture_pid)
+        return 0ULL;
+    return (uint64_t) Keyboard_get_scancode();
+}
 
-mprotect_out:
-            spin_unlock(&Syscall_state.vm_lock);
-            return ret;
-        }
+static uint64_t Syscall_handle_kbd_capture_set(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uint32_t caller_pid = Syscall_proc_current_pid(cpu_index, frame);
+    uint32_t want = (uint32_t) frame->rdi;
+    if (caller_pid == 0U)
+        return (uint64_t) -1;
+    if (want == 0U)
+    {
+        if (Syscall_kbd_hardware_capture_pid == caller_pid)
+            Syscall_kbd_hardware_capture_pid = 0U;
+        return 0ULL;
+    }
+    if (want != caller_pid)
+        return (uint64_t) -1;
+    Syscall_kbd_hardware_capture_pid = want;
+    return 0ULL;
+}
 
-        case SYS_OPEN:
-            return Syscall_handle_open(cpu_index, frame);
+static uint64_t Syscall_handle_kbd_inject_scancode(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_CLOSE:
-            return Syscall_handle_close(cpu_index, frame);
+    uint32_t target_pid = (uint32_t) frame->rdi;
+    uint8_t scancode = (uint8_t) (frame->rsi & 0xFFU);
+    Syscall_kbd_inject_register_target(target_pid);
+    if (!Syscall_kbd_inject_push(target_pid, scancode))
+        return (uint64_t) -1;
+    return 0ULL;
+}
 
-        case SYS_READ:
-            return Syscall_handle_read(cpu_index, frame);
+static uint64_t Syscall_handle_mouse_get_event(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_WRITE:
-            return Syscall_handle_write(cpu_index, frame);
+    syscall_mouse_event_t* user_event = (syscall_mouse_event_t*) frame->rdi;
+    if (!user_event)
+        return (uint64_t) -1;
 
-        case SYS_LSEEK:
-            return Syscall_handle_lseek(cpu_index, frame);
+    syscall_mouse_event_t event;
+    if (!Mouse_get_event(&event))
+        return 0ULL;
 
-        case SYS_IOCTL:
-            return Syscall_handle_ioctl(cpu_index, frame);
+    if (!Syscall_copy_to_user(user_event, &event, sizeof(event)))
+        return (uint64_t) -1;
 
-        case SYS_SOCKET:
-            return Syscall_handle_socket(cpu_index, frame);
+    return 1ULL;
+}
 
-        case SYS_BIND:
-            return Syscall_handle_bind(cpu_index, frame);
+static uint64_t Syscall_handle_mouse_debug_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_CONNECT:
-            return Syscall_handle_connect(cpu_index, frame);
+    syscall_mouse_debug_info_t* user_info = (syscall_mouse_debug_info_t*) frame->rdi;
+    if (!user_info)
+        return (uint64_t) -1;
 
-        case SYS_LISTEN:
-            return Syscall_handle_listen(cpu_index, frame);
+    syscall_mouse_debug_info_t info;
+    memset(&info, 0, sizeof(info));
+    if (!Mouse_get_debug_info(&info))
+        return (uint64_t) -1;
+    if (!Syscall_copy_to_user(user_info, &info, sizeof(info)))
+        return (uint64_t) -1;
+    return 0ULL;
+}
 
-        case SYS_ACCEPT:
-            return Syscall_handle_accept(cpu_index, frame);
+static uint64_t Syscall_handle_fs_isdir(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_SENDTO:
-            return Syscall_handle_sendto(cpu_index, frame);
+    char path[SYSCALL_USER_CSTR_MAX];
+    if (!Syscall_read_user_cstr(path, sizeof(path), (const char*) frame->rdi))
+        return (uint64_t) -1;
 
-        case SYS_RECVFROM:
-            return Syscall_handle_recvfrom(cpu_index, frame);
+    bool is_dir = VFS_path_is_dir(path);
+    return is_dir ? 1ULL : 0ULL;
+}
 
-        case SYS_GETSOCKNAME:
-            return Syscall_handle_getsockname(cpu_index, frame);
+static uint64_t Syscall_handle_fs_readdir(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_GETPEERNAME:
-            return Syscall_handle_getpeername(cpu_index, frame);
+    char path[SYSCALL_USER_CSTR_MAX];
+    if (!Syscall_read_user_cstr(path, sizeof(path), (const char*) frame->rdi))
+        return (uint64_t) -1;
 
-        case SYS_KBD_GET_SCANCODE:
-        {
-            uint32_t caller_pid = Syscall_proc_current_pid(cpu_index, frame);
-            uint8_t injected = 0U;
-            if (caller_pid != 0U && Syscall_kbd_inject_pop_for_pid(caller_pid, &injected))
-                return (uint64_t) injected;
-            if (caller_pid != 0U && Syscall_kbd_inject_is_target(caller_pid))
-            {
-                Syscall_kbd_inject_target_hits++;
-                return 0ULL;
-            }
-            if (Syscall_kbd_hardware_capture_pid != 0U && caller_pid != Syscall_kbd_hardware_capture_pid)
-                return 0ULL;
-            return (uint64_t) Keyboard_get_scancode();
-        }
+    size_t index = (size_t) frame->rsi;
+    syscall_dirent_t* user_out = (syscall_dirent_t*) frame->rdx;
+    if (!user_out)
+        return (uint64_t) -1;
 
-        case SYS_KBD_CAPTURE_SET:
-        {
-            uint32_t caller_pid = Syscall_proc_current_pid(cpu_index, frame);
-            uint32_t want = (uint32_t) frame->rdi;
-            if (caller_pid == 0U)
-                return (uint64_t) -1;
-            if (want == 0U)
-            {
-                if (Syscall_kbd_hardware_capture_pid == caller_pid)
-                    Syscall_kbd_hardware_capture_pid = 0U;
-                return 0ULL;
-            }
-            if (want != caller_pid)
-                return (uint64_t) -1;
-            Syscall_kbd_hardware_capture_pid = want;
-            return 0ULL;
-        }
+    vfs_dirent_info_t info;
+    memset(&info, 0, sizeof(info));
 
-        case SYS_KBD_INJECT_SCANCODE:
-        {
-            uint32_t target_pid = (uint32_t) frame->rdi;
-            uint8_t scancode = (uint8_t) (frame->rsi & 0xFFU);
-            Syscall_kbd_inject_register_target(target_pid);
-            if (!Syscall_kbd_inject_push(target_pid, scancode))
-                return (uint64_t) -1;
-            return 0ULL;
-        }
+    bool ok = VFS_read_dirent_at(path, index, &info);
 
-        case SYS_MOUSE_GET_EVENT:
-        {
-            syscall_mouse_event_t* user_event = (syscall_mouse_event_t*) frame->rdi;
-            if (!user_event)
-                return (uint64_t) -1;
+    if (!ok)
+        return 0;
 
-            syscall_mouse_event_t event;
-            if (!Mouse_get_event(&event))
-                return 0ULL;
+    syscall_dirent_t out;
+    memset(&out, 0, sizeof(out));
+    out.d_ino = info.inode;
+    out.d_type = info.type;
+    size_t name_len = strlen(info.name);
+    if (name_len > SYS_DIRENT_NAME_MAX)
+        name_len = SYS_DIRENT_NAME_MAX;
+    memcpy(out.d_name, info.name, name_len);
+    out.d_name[name_len] = '\0';
 
-            if (!Syscall_copy_to_user(user_event, &event, sizeof(event)))
-                return (uint64_t) -1;
+    if (!Syscall_copy_to_user(user_out, &out, sizeof(out)))
+        return (uint64_t) -1;
 
-            return 1ULL;
-        }
+    return 1;
+}
 
-        case SYS_MOUSE_DEBUG_INFO_GET:
-        {
-            syscall_mouse_debug_info_t* user_info = (syscall_mouse_debug_info_t*) frame->rdi;
-            if (!user_info)
-                return (uint64_t) -1;
+static uint64_t Syscall_handle_waitpid(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-            syscall_mouse_debug_info_t info;
-            memset(&info, 0, sizeof(info));
-            if (!Mouse_get_debug_info(&info))
-                return (uint64_t) -1;
-            if (!Syscall_copy_to_user(user_info, &info, sizeof(info)))
-                return (uint64_t) -1;
-            return 0ULL;
-        }
+    int32_t wait_pid = (int32_t) frame->rdi;
+    int* out_status = (int*) frame->rsi;
+    int* out_signal = (int*) frame->rdx;
+    uint32_t reaped_pid = 0;
+    int64_t reaped_status = 0;
+    int32_t reaped_signal = 0;
+    bool has_child = false;
+    bool got_event = false;
 
-        case SYS_FS_ISDIR:
-        {
-            char path[SYSCALL_USER_CSTR_MAX];
-            if (!Syscall_read_user_cstr(path, sizeof(path), (const char*) frame->rdi))
-                return (uint64_t) -1;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
 
-            bool is_dir = VFS_path_is_dir(path);
-            return is_dir ? 1ULL : 0ULL;
-        }
+    uint32_t parent_pid = Syscall_state.procs[slot].owner_pid;
+    got_event = Syscall_exit_event_pop_locked(parent_pid,
+                                              wait_pid,
+                                              &reaped_pid,
+                                              &reaped_status,
+                                              &reaped_signal);
+    if (!got_event)
+        has_child = Syscall_proc_has_matching_child_locked(parent_pid, wait_pid);
 
-        case SYS_FS_READDIR:
-        {
-            char path[SYSCALL_USER_CSTR_MAX];
-            if (!Syscall_read_user_cstr(path, sizeof(path), (const char*) frame->rdi))
-                return (uint64_t) -1;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
-            size_t index = (size_t) frame->rsi;
-            syscall_dirent_t* user_out = (syscall_dirent_t*) frame->rdx;
-            if (!user_out)
-                return (uint64_t) -1;
+    if (!got_event)
+    {
+        if (!has_child)
+            return (uint64_t) -1;
 
-            vfs_dirent_info_t info;
-            memset(&info, 0, sizeof(info));
+        if (cpu_index < 256)
+            __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
+        return 0;
+    }
 
-            bool ok = VFS_read_dirent_at(path, index, &info);
+    int status32 = (int) reaped_status;
+    if (out_status && !Syscall_copy_to_user(out_status, &status32, sizeof(status32)))
+        return (uint64_t) -1;
+    if (out_signal && !Syscall_copy_to_user(out_signal, &reaped_signal, sizeof(reaped_signal)))
+        return (uint64_t) -1;
 
-            if (!ok)
-                return 0;
+    return (uint64_t) reaped_pid;
+}
 
-            syscall_dirent_t out;
-            memset(&out, 0, sizeof(out));
-            out.d_ino = info.inode;
-            out.d_type = info.type;
-            size_t name_len = strlen(info.name);
-            if (name_len > SYS_DIRENT_NAME_MAX)
-                name_len = SYS_DIRENT_NAME_MAX;
-            memcpy(out.d_name, info.name, name_len);
-            out.d_name[name_len] = '\0';
+static uint64_t Syscall_handle_kill(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-            if (!Syscall_copy_to_user(user_out, &out, sizeof(out)))
-                return (uint64_t) -1;
+    int32_t target_pid = (int32_t) frame->rdi;
+    int32_t signal = (int32_t) frame->rsi;
+    if (target_pid <= 0)
+        return (uint64_t) -1;
+    if (signal < 0)
+        return (uint64_t) -1;
+    if (signal != 0 && !Syscall_signal_is_valid(signal))
+        return (uint64_t) -1;
 
-            return 1;
-        }
+    // kill(pid, 0) only asks whether pid exists: answer it from the pid hash.
+    if (signal == 0)
+    {
+        int32_t probe_slot = Syscall_pid_lookup_rcu((uint32_t) target_pid);
+        return (probe_slot >= 0 && Syscall_state.procs[probe_slot].owner_pid != 0) ? 0 : (uint64_t) -1;
+    }
 
-        case SYS_WAITPID:
-        {
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) -1;
+    uint32_t sender_pid = 0;
+    bool delivered = false;
+    bool core_dump_not_implemented = false;
+    bool stop_semantics_not_implemented = false;
+    bool ignored = false;
+    uint32_t target_owner_pid = 0;
 
-            int32_t wait_pid = (int32_t) frame->rdi;
-            int* out_status = (int*) frame->rsi;
-            int* out_signal = (int*) frame->rdx;
-            uint32_t reaped_pid = 0;
-            int64_t reaped_status = 0;
-            int32_t reaped_signal = 0;
-            bool has_child = false;
-            bool got_event = false;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t sender_slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (sender_slot >= 0)
+        sender_pid = Syscall_state.procs[sender_slot].pid;
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            if (slot < 0)
-            {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                return (uint64_t) -1;
-            }
+    int32_t target_slot = Syscall_pid_lookup_rcu((uint32_t) target_pid);
+    if (target_slot >= 0)
+        target_owner_pid = Syscall_state.procs[target_slot].owner_pid;
 
-            uint32_t parent_pid = Syscall_state.procs[slot].owner_pid;
-            got_event = Syscall_exit_event_pop_locked(parent_pid,
-                                                      wait_pid,
-                                                      &reaped_pid,
-                                                      &reaped_status,
-                                                      &reaped_signal);
-            if (!got_event)
-                has_child = Syscall_proc_has_matching_child_locked(parent_pid, wait_pid);
+    if (target_slot >= 0 && target_owner_pid != 0)
+    {
+        char action = Syscall_signal_default_action(signal);
+        switch (action)
+        {
+            case 'E':
+                delivered = Syscall_signal_terminate_owner_locked(target_owner_pid, signal);
+                if (delivered)
+                    Syscall_signal_terminate_fork_children_of_owner_locked(target_owner_pid, signal);
+                break;
+            case 'C':
+                delivered = Syscall_signal_terminate_owner_locked(target_owner_pid, signal);
+                if (delivered)
+                    Syscall_signal_terminate_fork_children_of_owner_locked(target_owner_pid, signal);
+                core_dump_not_implemented = delivered;
+                break;
+            case 'I':
+                delivered = true;
+                ignored = true;
+                break;
+            case 'S':
+                delivered = true;
+                stop_semantics_not_implemented = true;
+                break;
+            default:
+                delivered = false;
+                break;
+        }
+    }
 
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
-            if (!got_event)
-            {
-                if (!has_child)
-                    return (uint64_t) -1;
+    if (!delivered)
+        return (uint64_t) -1;
 
-                if (cpu_index < 256)
-                    __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
-                return 0;
-            }
+    const char* signal_name = Syscall_signal_name(signal);
+    if (stop_semantics_not_implemented)
+    {
+        kdebug_printf("[USER] pid=%u sent %s to pid=%d (stop semantics not implemented yet)\n",
+                      (unsigned int) sender_pid,
+                      signal_name,
+                      (int) target_pid);
+    }
+    else if (core_dump_not_implemented)
+    {
+        kdebug_printf("[USER] pid=%u sent %s to pid=%d (core dump not implemented yet, process terminated)\n",
+                      (unsigned int) sender_pid,
+                      signal_name,
+                      (int) target_pid);
+    }
+    else if (ignored)
+    {
+        kdebug_printf("[USER] pid=%u sent %s to pid=%d (ignored by default)\n",
+                      (unsigned int) sender_pid,
+                      signal_name,
+                      (int) target_pid);
+    }
+    else
+    {
+        kdebug_printf("[USER] pid=%u sent %s to pid=%d\n",
+                      (unsigned int) sender_pid,
+                      signal_name,
+                      (int) target_pid);
+    }
+    return 0;
+}
 
-            int status32 = (int) reaped_status;
-            if (out_status && !Syscall_copy_to_user(out_status, &status32, sizeof(status32)))
-                return (uint64_t) -1;
-            if (out_signal && !Syscall_copy_to_user(out_signal, &reaped_signal, sizeof(reaped_signal)))
-                return (uint64_t) -1;
+static uint64_t Syscall_handle_thread_create(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-            return (uint64_t) reaped_pid;
-        }
+    uintptr_t start_rip = (uintptr_t) frame->rdi;
+    uintptr_t start_arg = (uintptr_t) frame->rsi;
+    uintptr_t stack_top = (uintptr_t) frame->rdx & ~(uintptr_t) 0xFULL;
+    uintptr_t requested_fs_base = (uintptr_t) frame->r10;
+    if (!Syscall_is_canonical_low(start_rip) ||
+        start_rip < SYSCALL_USER_VADDR_MIN ||
+        start_rip > SYSCALL_USER_VADDR_MAX)
+    {
+        return (uint64_t) -1;
+    }
 
-        case SYS_KILL:
-        {
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) -1;
+    if (stack_top <= (SYSCALL_USER_VADDR_MIN + 8U) || stack_top > SYSCALL_USER_VADDR_MAX)
+        return (uint64_t) -1;
+    if (!Syscall_user_fs_base_is_valid(requested_fs_base))
+        return (uint64_t) -1;
 
-            int32_t target_pid = (int32_t) frame->rdi;
-            int32_t signal = (int32_t) frame->rsi;
-            if (target_pid <= 0)
-                return (uint64_t) -1;
-            if (signal < 0)
-                return (uint64_t) -1;
-            if (signal != 0 && !Syscall_signal_is_valid(signal))
-                return (uint64_t) -1;
+    uintptr_t thread_rsp = stack_top - 8U;
+    if (!Syscall_user_range_in_bounds(thread_rsp, sizeof(uint64_t)))
+        return (uint64_t) -1;
 
-            uint32_t sender_pid = 0;
-            bool delivered = false;
-            bool core_dump_not_implemented = false;
-            bool stop_semantics_not_implemented = false;
-            bool ignored = false;
-            uint32_t target_owner_pid = 0;
+    uint64_t fake_ret = 0;
+    if (!Syscall_copy_to_user((void*) thread_rsp, &fake_ret, sizeof(fake_ret)))
+        return (uint64_t) -1;
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t sender_slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            if (sender_slot >= 0)
-                sender_pid = Syscall_state.procs[sender_slot].pid;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t parent_slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (parent_slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
 
-            int32_t target_slot = -1;
-            for (uint32_t i = 0; i < SYSCALL_MAX_PROCS; i++)
-            {
-                if (!Syscall_state.procs[i].used || Syscall_state.procs[i].pid != (uint32_t) target_pid)
-                    continue;
-                target_slot = (int32_t) i;
-                target_owner_pid = Syscall_state.procs[i].owner_pid;
-                break;
-            }
+    syscall_process_t* parent = &Syscall_state.procs[(uint32_t) parent_slot];
+    int32_t thread_slot = Syscall_proc_alloc_locked();
+    if (thread_slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
 
-            if (target_slot >= 0 && target_owner_pid != 0)
-            {
-                if (signal == 0)
-                {
-                    delivered = true;
-                }
-                else
-                {
-                    char action = Syscall_signal_default_action(signal);
-                    switch (action)
-                    {
-                        case 'E':
-                            delivered = Syscall_signal_terminate_owner_locked(target_owner_pid, signal);
-                            if (delivered)
-                                Syscall_signal_terminate_fork_children_of_owner_locked(target_owner_pid, signal);
-                            break;
-                        case 'C':
-                            delivered = Syscall_signal_terminate_owner_locked(target_owner_pid, signal);
-                            if (delivered)
-                                Syscall_signal_terminate_fork_children_of_owner_locked(target_owner_pid, signal);
-                            core_dump_not_implemented = delivered;
-                            break;
-                        case 'I':
-                            delivered = true;
-                            ignored = true;
-                            break;
-                        case 'S':
-                            delivered = true;
-                            stop_semantics_not_implemented = true;
-                            break;
-                        default:
-                            delivered = false;
-                            break;
-                    }
-                }
-            }
+    uint32_t tid = Syscall_state.next_pid++;
+    syscall_process_t* thread = &Syscall_state.procs[(uint32_t) thread_slot];
+    memset(thread, 0, sizeof(*thread));
+    thread->used = true;
+    thread->exiting = false;
+    thread->terminated_by_signal = false;
+    thread->owns_cr3 = false;
+    thread->is_thread = true;
+    thread->pid = tid;
+    thread->ppid = parent->ppid;
+    thread->owner_pid = parent->owner_pid;
+    thread->console_sid = parent->console_sid;
+    thread->domain = parent->domain;
+    thread->exit_status = 0;
+    thread->thread_exit_value = 0;
+    thread->term_signal = 0;
+    thread->cr3_phys = parent->cr3_phys;
+    thread->fs_base = (requested_fs_base != 0) ? requested_fs_base : parent->fs_base;
+    thread->rax = 0;
+    thread->rcx = 0;
+    thread->rdx = 0;
+    thread->rsi = 0;
+    thread->rdi = start_arg;
+    thread->r8 = 0;
+    thread->r9 = 0;
+    thread->r10 = 0;
+    thread->r11 = 0;
+    thread->r15 = 0;
+    thread->r14 = 0;
+    thread->r13 = 0;
+    thread->r12 = 0;
+    thread->rbp = 0;
+    thread->rbx = 0;
+    thread->rip = start_rip;
+    thread->rflags = parent->rflags | SYSCALL_RFLAGS_IF;
+    thread->rsp = thread_rsp;
+    thread->pending_rax = 0;
+    thread->last_cpu = cpu_index;
+    Syscall_sched_inherit_locked(thread, parent);
+    Syscall_pid_hash_insert_locked((uint32_t) thread_slot);
+    Syscall_rq_enqueue_new_locked((uint32_t) thread_slot, cpu_index);
+
+    if (cpu_index < 256)
+        __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    return (uint64_t) tid;
+}
 
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+static uint64_t Syscall_handle_thread_join(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-            if (!delivered)
-                return (uint64_t) -1;
+    int32_t tid = (int32_t) frame->rdi;
+    uint64_t* out_retval = (uint64_t*) frame->rsi;
+    if (tid <= 0)
+        return (uint64_t) -1;
 
-            if (signal != 0)
-            {
-                const char* signal_name = Syscall_signal_name(signal);
-                if (stop_semantics_not_implemented)
-                {
-                    kdebug_printf("[USER] pid=%u sent %s to pid=%d (stop semantics not implemented yet)\n",
-                                  (unsigned int) sender_pid,
-                                  signal_name,
-                                  (int) target_pid);
-                }
-                else if (core_dump_not_implemented)
-                {
-                    kdebug_printf("[USER] pid=%u sent %s to pid=%d (core dump not implemented yet, process terminated)\n",
-                                  (unsigned int) sender_pid,
-                                  signal_name,
-                                  (int) target_pid);
-                }
-                else if (ignored)
-                {
-                    kdebug_printf("[USER] pid=%u sent %s to pid=%d (ignored by default)\n",
-                                  (unsigned int) sender_pid,
-                                  signal_name,
-                                  (int) target_pid);
-                }
-                else
-                {
-                    kdebug_printf("[USER] pid=%u sent %s to pid=%d\n",
-                                  (unsigned int) sender_pid,
-                                  signal_name,
-                                  (int) target_pid);
-                }
-            }
-            return 0;
-        }
+    uint32_t owner_pid = 0;
+    uint32_t self_tid = 0;
+    uint64_t thread_retval = 0;
+    bool got_event = false;
+    bool has_live_thread = false;
+
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
 
-        case SYS_THREAD_CREATE:
-        {
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) -1;
+    owner_pid = Syscall_state.procs[slot].owner_pid;
+    self_tid = Syscall_state.procs[slot].pid;
+    if ((uint32_t) tid == self_tid)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
 
-            uintptr_t start_rip = (uintptr_t) frame->rdi;
-            uintptr_t start_arg = (uintptr_t) frame->rsi;
-            uintptr_t stack_top = (uintptr_t) frame->rdx & ~(uintptr_t) 0xFULL;
-            uintptr_t requested_fs_base = (uintptr_t) frame->r10;
-            if (!Syscall_is_canonical_low(start_rip) ||
-                start_rip < SYSCALL_USER_VADDR_MIN ||
-                start_rip > SYSCALL_USER_VADDR_MAX)
-            {
-                return (uint64_t) -1;
-            }
+    got_event = Syscall_thread_exit_event_pop_locked(owner_pid, (uint32_t) tid, &thread_retval);
+    if (!got_event)
+        has_live_thread = Syscall_proc_has_live_thread_locked(owner_pid, (uint32_t) tid);
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
-            if (stack_top <= (SYSCALL_USER_VADDR_MIN + 8U) || stack_top > SYSCALL_USER_VADDR_MAX)
-                return (uint64_t) -1;
-            if (!Syscall_user_fs_base_is_valid(requested_fs_base))
-                return (uint64_t) -1;
+    if (!got_event)
+    {
+        if (!has_live_thread)
+            return (uint64_t) -1;
+        if (cpu_index < 256)
+            __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
+        return 0;
+    }
 
-            uintptr_t thread_rsp = stack_top - 8U;
-            if (!Syscall_user_range_in_bounds(thread_rsp, sizeof(uint64_t)))
-                return (uint64_t) -1;
+    if (out_retval && !Syscall_copy_to_user(out_retval, &thread_retval, sizeof(thread_retval)))
+        return (uint64_t) -1;
+    return (uint64_t) tid;
+}
 
-            uint64_t fake_ret = 0;
-            if (!Syscall_copy_to_user((void*) thread_rsp, &fake_ret, sizeof(fake_ret)))
-                return (uint64_t) -1;
+static uint64_t Syscall_handle_thread_exit(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uint64_t retval = frame->rdi;
+    if (!Syscall_state.proc_lock_ready)
+        return retval;
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t parent_slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            if (parent_slot < 0)
-            {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                return (uint64_t) -1;
-            }
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (slot >= 0)
+    {
+        syscall_process_t* proc = &Syscall_state.procs[slot];
+        proc->exiting = true;
+        proc->terminated_by_signal = false;
+        proc->exit_status = (int64_t) retval;
+        proc->thread_exit_value = retval;
+        proc->term_signal = 0;
+    }
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    return retval;
+}
 
-            syscall_process_t* parent = &Syscall_state.procs[(uint32_t) parent_slot];
-            int32_t thread_slot = Syscall_proc_alloc_locked();
-            if (thread_slot < 0)
-            {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                return (uint64_t) -1;
-            }
+static uint64_t Syscall_handle_thread_self(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-            uint32_t tid = Syscall_state.next_pid++;
-            syscall_process_t* thread = &Syscall_state.procs[(uint32_t) thread_slot];
-            memset(thread, 0, sizeof(*thread));
-            thread->used = true;
-            thread->exiting = false;
-            thread->terminated_by_signal = false;
-            thread->owns_cr3 = false;
-            thread->is_thread = true;
-            thread->pid = tid;
-            thread->ppid = parent->ppid;
-            thread->owner_pid = parent->owner_pid;
-            thread->console_sid = parent->console_sid;
-            thread->domain = parent->domain;
-            thread->exit_status = 0;
-            thread->thread_exit_value = 0;
-            thread->term_signal = 0;
-            thread->cr3_phys = parent->cr3_phys;
-            thread->fs_base = (requested_fs_base != 0) ? requested_fs_base : parent->fs_base;
-            thread->rax = 0;
-            thread->rcx = 0;
-            thread->rdx = 0;
-            thread->rsi = 0;
-            thread->rdi = start_arg;
-            thread->r8 = 0;
-            thread->r9 = 0;
-            thread->r10 = 0;
-            thread->r11 = 0;
-            thread->r15 = 0;
-            thread->r14 = 0;
-            thread->r13 = 0;
-            thread->r12 = 0;
-            thread->rbp = 0;
-            thread->rbx = 0;
-            thread->rip = start_rip;
-            thread->rflags = parent->rflags | SYSCALL_RFLAGS_IF;
-            thread->rsp = thread_rsp;
-            thread->pending_rax = 0;
-            thread->last_cpu = cpu_index;
-
-            if (cpu_index < 256)
-                __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-            return (uint64_t) tid;
-        }
+    int32_t fast_slot = Syscall_proc_current_slot_fast(cpu_index);
+    if (fast_slot >= 0)
+        return Syscall_state.procs[fast_slot].pid;
 
-        case SYS_THREAD_JOIN:
-        {
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) -1;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    uint64_t tid = (slot >= 0) ? Syscall_state.procs[slot].pid : (uint64_t) -1;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    return tid;
+}
 
-            int32_t tid = (int32_t) frame->rdi;
-            uint64_t* out_retval = (uint64_t*) frame->rsi;
-            if (tid <= 0)
-                return (uint64_t) -1;
+static uint64_t Syscall_handle_thread_set_fsbase(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uintptr_t fs_base = (uintptr_t) frame->rdi;
+    if (!Syscall_user_fs_base_is_valid(fs_base) || !Syscall_state.proc_lock_ready)
+        return (uint64_t) -1;
 
-            uint32_t owner_pid = 0;
-            uint32_t self_tid = 0;
-            uint64_t thread_retval = 0;
-            bool got_event = false;
-            bool has_live_thread = false;
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (slot < 0)
+    {
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+        return (uint64_t) -1;
+    }
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            if (slot < 0)
-            {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                return (uint64_t) -1;
-            }
+    Syscall_state.procs[slot].fs_base = fs_base;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    Syscall_write_fs_base(fs_base);
+    return 0;
+}
 
-            owner_pid = Syscall_state.procs[slot].owner_pid;
-            self_tid = Syscall_state.procs[slot].pid;
-            if ((uint32_t) tid == self_tid)
-            {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                return (uint64_t) -1;
-            }
+static uint64_t Syscall_handle_thread_get_fsbase(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    uintptr_t fs_base = Syscall_read_fs_base();
+    if (!Syscall_state.proc_lock_ready)
+        return (uint64_t) fs_base;
 
-            got_event = Syscall_thread_exit_event_pop_locked(owner_pid, (uint32_t) tid, &thread_retval);
-            if (!got_event)
-                has_live_thread = Syscall_proc_has_live_thread_locked(owner_pid, (uint32_t) tid);
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+    int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+    if (slot >= 0)
+        Syscall_state.procs[slot].fs_base = fs_base;
+    spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+    return (uint64_t) fs_base;
+}
 
-            if (!got_event)
-            {
-                if (!has_live_thread)
-                    return (uint64_t) -1;
-                if (cpu_index < 256)
-                    __atomic_store_n(&Syscall_state.cpu_need_resched[cpu_index], 1, __ATOMIC_RELEASE);
-                return 0;
-            }
+static uint64_t Syscall_handle_power(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-            if (out_retval && !Syscall_copy_to_user(out_retval, &thread_retval, sizeof(thread_retval)))
+    uint32_t cmd = (uint32_t) frame->rdi;
+    uint32_t arg = (uint32_t) frame->rsi;
+    switch (cmd)
+    {
+        case SYS_POWER_CMD_SHUTDOWN:
+            return ACPI_shutdown() ? 0 : (uint64_t) -1;
+        case SYS_POWER_CMD_SLEEP:
+            if (arg > (uint32_t) ACPI_SLEEP_S5)
                 return (uint64_t) -1;
-            return (uint64_t) tid;
-        }
+            return ACPI_sleep((ACPI_sleep_state_t) arg) ? 0 : (uint64_t) -1;
+        case SYS_POWER_CMD_REBOOT:
+            return ACPI_reboot() ? 0 : (uint64_t) -1;
+        default:
+            return (uint64_t) -1;
+    }
+}
+
+static uint64_t Syscall_handle_unknown(uint64_t syscall_num, uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    if (Syscall_state.proc_lock_ready)
+    {
+        uint32_t pid = 0;
+        bool delivered = false;
 
-        case SYS_THREAD_EXIT:
+        uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
+        int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
+        if (slot >= 0)
         {
-            uint64_t retval = frame->rdi;
-            if (!Syscall_state.proc_lock_ready)
-                return retval;
+            syscall_process_t* proc = &Syscall_state.procs[slot];
+            pid = proc->pid;
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            if (slot >= 0)
+            delivered = Syscall_signal_terminate_owner_locked(proc->owner_pid, SYS_SIGSYS);
+            if (!delivered)
             {
-                syscall_process_t* proc = &Syscall_state.procs[slot];
-                proc->exiting = true;
-                proc->terminated_by_signal = false;
-                proc->exit_status = (int64_t) retval;
-                proc->thread_exit_value = retval;
-                proc->term_signal = 0;
+                Syscall_proc_mark_killed_locked(proc, SYS_SIGSYS);
+                proc->thread_exit_value = 0;
+                delivered = true;
             }
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-            return retval;
         }
+        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
-        case SYS_THREAD_SELF:
+        if (delivered)
         {
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) -1;
-
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            uint64_t tid = (slot >= 0) ? Syscall_state.procs[slot].pid : (uint64_t) -1;
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-            return tid;
+            kdebug_printf("[USER] pid=%u killed by SIGSYS (unknown syscall=%llu)\n",
+                          (unsigned int) pid,
+                          (unsigned long long) syscall_num);
         }
+    }
 
-        case SYS_THREAD_SET_FSBASE:
-        {
-            uintptr_t fs_base = (uintptr_t) frame->rdi;
-            if (!Syscall_user_fs_base_is_valid(fs_base) || !Syscall_state.proc_lock_ready)
-                return (uint64_t) -1;
+    return (uint64_t) -1;
+}
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            if (slot < 0)
-            {
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-                return (uint64_t) -1;
-            }
+// Indexed by syscall number; a missing entry is an unknown syscall and ends in SIGSYS.
+static const syscall_table_entry_t Syscall_table[SYSCALL_NR_MAX] = {
+    [SYS_SLEEP_MS] = { Syscall_handle_sleep_ms, 0U },
+    [SYS_TICK_GET] = { Syscall_handle_tick_get, SYSCALL_ENTRY_FAST },
+    [SYS_CPU_INFO_GET] = { Syscall_handle_cpu_info_get, SYSCALL_ENTRY_FAST },
+    [SYS_SCHED_INFO_GET] = { Syscall_handle_sched_info_get, SYSCALL_ENTRY_FAST },
+    [SYS_AHCI_IRQ_INFO_GET] = { Syscall_handle_ahci_irq_info_get, 0U },
+    [SYS_RCU_SYNC] = { Syscall_handle_rcu_sync, 0U },
+    [SYS_RCU_INFO_GET] = { Syscall_handle_rcu_info_get, SYSCALL_ENTRY_FAST },
+    [SYS_CONSOLE_WRITE] = { Syscall_handle_console_write, 0U },
+    [SYS_EXIT] = { Syscall_handle_exit, 0U },
+    [SYS_FORK] = { Syscall_handle_fork, 0U },
+    [SYS_EXECVE] = { Syscall_handle_execve, 0U },
+    [SYS_YIELD] = { Syscall_handle_yield, SYSCALL_ENTRY_FAST },
+    [SYS_MAP] = { Syscall_handle_map, 0U },
+    [SYS_UNMAP] = { Syscall_handle_unmap, 0U },
+    [SYS_MPROTECT] = { Syscall_handle_mprotect, 0U },
+    [SYS_OPEN] = { Syscall_handle_open, 0U },
+    [SYS_CLOSE] = { Syscall_handle_close, 0U },
+    [SYS_READ] = { Syscall_handle_read, 0U },
+    [SYS_WRITE] = { Syscall_handle_write, 0U },
+    [SYS_LSEEK] = { Syscall_handle_lseek, 0U },
+    [SYS_KBD_GET_SCANCODE] = { Syscall_handle_kbd_get_scancode, 0U },
+    [SYS_FS_ISDIR] = { Syscall_handle_fs_isdir, 0U },
+    [SYS_FS_MKDIR] = { Syscall_handle_fs_mkdir, 0U },
+    [SYS_FS_READDIR] = { Syscall_handle_fs_readdir, 0U },
+    [SYS_WAITPID] = { Syscall_handle_waitpid, 0U },
+    [SYS_KILL] = { Syscall_handle_kill, 0U },
+    [SYS_POWER] = { Syscall_handle_power, 0U },
+    [SYS_THREAD_CREATE] = { Syscall_handle_thread_create, 0U },
+    [SYS_THREAD_JOIN] = { Syscall_handle_thread_join, 0U },
+    [SYS_THREAD_EXIT] = { Syscall_handle_thread_exit, 0U },
+    [SYS_THREAD_SELF] = { Syscall_handle_thread_self, SYSCALL_ENTRY_FAST },
+    [SYS_THREAD_SET_FSBASE] = { Syscall_handle_thread_set_fsbase, 0U },
+    [SYS_THREAD_GET_FSBASE] = { Syscall_handle_thread_get_fsbase, SYSCALL_ENTRY_FAST },
+    [SYS_PROC_INFO_GET] = { Syscall_handle_proc_info_get, 0U },
+    [SYS_IOCTL] = { Syscall_handle_ioctl, 0U },
+    [SYS_SOCKET] = { Syscall_handle_socket, 0U },
+    [SYS_BIND] = { Syscall_handle_bind, 0U },
+    [SYS_SENDTO] = { Syscall_handle_sendto, 0U },
+    [SYS_RECVFROM] = { Syscall_handle_recvfrom, 0U },
+    [SYS_CONNECT] = { Syscall_handle_connect, 0U },
+    [SYS_GETSOCKNAME] = { Syscall_handle_getsockname, 0U },
+    [SYS_GETPEERNAME] = { Syscall_handle_getpeername, 0U },
+    [SYS_LISTEN] = { Syscall_handle_listen, 0U },
+    [SYS_ACCEPT] = { Syscall_handle_accept, 0U },
+    [SYS_MOUSE_GET_EVENT] = { Syscall_handle_mouse_get_event, 0U },
+    [SYS_CONSOLE_ROUTE_SET] = { Syscall_handle_console_route_set, 0U },
+    [SYS_CONSOLE_ROUTE_READ] = { Syscall_handle_console_route_read, 0U },
+    [SYS_CONSOLE_ROUTE_SET_SID] = { Syscall_handle_console_route_set_sid, 0U },
+    [SYS_CONSOLE_ROUTE_READ_SID] = { Syscall_handle_console_route_read_sid, 0U },
+    [SYS_MOUSE_DEBUG_INFO_GET] = { Syscall_handle_mouse_debug_info_get, 0U },
+    [SYS_KBD_INJECT_SCANCODE] = { Syscall_handle_kbd_inject_scancode, 0U },
+    [SYS_CONSOLE_ROUTE_INPUT_WRITE_SID] = { Syscall_handle_console_route_input_write_sid, 0U },
+    [SYS_CONSOLE_ROUTE_INPUT_READ] = { Syscall_handle_console_route_input_read, 0U },
+    [SYS_KBD_CAPTURE_SET] = { Syscall_handle_kbd_capture_set, 0U },
+    [SYS_PIPE] = { Syscall_handle_pipe, 0U },
+    [SYS_FUTEX] = { Syscall_handle_futex, 0U },
+    [SYS_SHMGET] = { Syscall_handle_shmget, 0U },
+    [SYS_SHMAT] = { Syscall_handle_shmat, 0U },
+    [SYS_SHMDT] = { Syscall_handle_shmdt, 0U },
+    [SYS_SHMCTL] = { Syscall_handle_shmctl, 0U },
+    [SYS_MSGGET] = { Syscall_handle_msgget, 0U },
+    [SYS_MSGSND] = { Syscall_handle_msgsnd, 0U },
+    [SYS_MSGRCV] = { Syscall_handle_msgrcv, 0U },
+    [SYS_MSGCTL] = { Syscall_handle_msgctl, 0U },
+    [SYS_RTC_TIME_GET] = { Syscall_handle_rtc_time_get, SYSCALL_ENTRY_FAST },
+    [SYS_KDEBUG_WRITE] = { Syscall_handle_kdebug_write, 0U },
+    [SYS_SETPRIORITY] = { Syscall_handle_setpriority, 0U },
+    [SYS_GETPRIORITY] = { Syscall_handle_getpriority, SYSCALL_ENTRY_FAST },
+    [SYS_SCHED_SETSCHEDULER] = { Syscall_handle_sched_setscheduler, 0U },
+    [SYS_SCHED_GETSCHEDULER] = { Syscall_handle_sched_getscheduler, SYSCALL_ENTRY_FAST },
+    [SYS_SCHED_SETAFFINITY] = { Syscall_handle_sched_setaffinity, 0U },
+    [SYS_SCHED_GETAFFINITY] = { Syscall_handle_sched_getaffinity, SYSCALL_ENTRY_FAST },
+    [SYS_GETRUSAGE] = { Syscall_handle_getrusage, SYSCALL_ENTRY_FAST },
+    [SYS_GETPID] = { Syscall_handle_getpid, SYSCALL_ENTRY_FAST },
+    [SYS_GETPPID] = { Syscall_handle_getppid, SYSCALL_ENTRY_FAST },
+    [SYS_SYSCALL_STATS_GET] = { Syscall_handle_syscall_stats_get, SYSCALL_ENTRY_FAST },
+    [SYS_TLB_INFO_GET] = { Syscall_handle_tlb_info_get, SYSCALL_ENTRY_FAST },
+    [SYS_MEM_INFO_GET] = { Syscall_handle_mem_info_get, SYSCALL_ENTRY_FAST },
+    [SYS_GETRLIMIT] = { Syscall_handle_getrlimit, SYSCALL_ENTRY_FAST },
+    [SYS_SETRLIMIT] = { Syscall_handle_setrlimit, 0U },
+    [SYS_KMEM_INFO_GET] = { Syscall_handle_kmem_info_get, 0U },
+    [SYS_SYNC] = { Syscall_handle_sync, 0U },
+    [SYS_IPC_INFO_GET] = { Syscall_handle_ipc_info_get, 0U },
+};
+static uint64_t Syscall_handle_syscall_stats_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-            Syscall_state.procs[slot].fs_base = fs_base;
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-            Syscall_write_fs_base(fs_base);
-            return 0;
-        }
+    syscall_stats_info_t* info = (syscall_stats_info_t*) kmalloc(sizeof(*info));
+    if (!info)
+        return (uint64_t) -1;
+    memset(info, 0, sizeof(*info));
 
-        case SYS_THREAD_GET_FSBASE:
-        {
-            uintptr_t fs_base = Syscall_read_fs_base();
-            if (!Syscall_state.proc_lock_ready)
-                return (uint64_t) fs_base;
+    info->nr_count = SYSCALL_NR_MAX;
+    for (uint32_t cpu = 0; cpu < 256U; cpu++)
+    {
+        const syscall_cpu_stats_t* stats = &Syscall_state.cpu_syscall_stats[cpu];
+        info->fast_returns += __atomic_load_n(&stats->fast_returns, __ATOMIC_RELAXED);
+        for (uint32_t nr = 0; nr < SYSCALL_NR_MAX; nr++)
+            info->calls[nr] += __atomic_load_n(&stats->calls[nr], __ATOMIC_RELAXED);
+    }
 
-            uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-            int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-            if (slot >= 0)
-                Syscall_state.procs[slot].fs_base = fs_base;
-            spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-            return (uint64_t) fs_base;
-        }
+    bool ok = Syscall_copy_to_user((void*) frame->rdi, info, sizeof(*info));
+    kfree(info);
+    return ok ? 0 : (uint64_t) -1;
+}
 
-        case SYS_POWER:
-        {
-            uint32_t cmd = (uint32_t) frame->rdi;
-            uint32_t arg = (uint32_t) frame->rsi;
-            switch (cmd)
-            {
-                case SYS_POWER_CMD_SHUTDOWN:
-                    return ACPI_shutdown() ? 0 : (uint64_t) -1;
-                case SYS_POWER_CMD_SLEEP:
-                    if (arg > (uint32_t) ACPI_SLEEP_S5)
-                        return (uint64_t) -1;
-                    return ACPI_sleep((ACPI_sleep_state_t) arg) ? 0 : (uint64_t) -1;
-                case SYS_POWER_CMD_REBOOT:
-                    return ACPI_reboot() ? 0 : (uint64_t) -1;
-                default:
-                    return (uint64_t) -1;
-            }
-        }
+static uint64_t Syscall_handle_tlb_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_PIPE:
-            return Syscall_handle_pipe(cpu_index, frame);
+    VMM_pcid_stats_t stats;
+    VMM_get_pcid_stats(&stats);
+
+    syscall_tlb_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.pcid_enabled = stats.enabled ? 1U : 0U;
+    info.invpcid = stats.invpcid ? 1U : 0U;
+    info.cr3_switches = stats.cr3_switches;
+    info.cr3_noflush = stats.cr3_noflush;
+    info.cr3_flush = stats.cr3_flush;
+    info.pcid_recycles = stats.recycles;
+    info.as_invalidations = stats.as_invalidations;
+    info.global_invalidations = stats.global_invalidations;
+    info.lazy_skips = stats.lazy_skips;
+    info.lazy_flushes = stats.lazy_flushes;
+
+    SMP_tlb_stats_t shootdowns;
+    SMP_get_tlb_stats(&shootdowns);
+    info.shootdowns = shootdowns.requests;
+    info.shootdowns_no_ipi = shootdowns.requests_no_ipi;
+    info.shootdown_ipis = shootdowns.ipis;
+    info.shootdown_pages = shootdowns.pages;
+    info.shootdown_full_flushes = shootdowns.full_flushes;
+    return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+}
+
+static uint64_t Syscall_handle_mem_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_FUTEX:
-            return Syscall_handle_futex(cpu_index, frame);
+    PMM_stats_t stats;
+    PMM_get_stats(&stats);
+
+    syscall_mem_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.page_size = PHYS_PAGE_SIZE;
+    info.total_pages = stats.total_pages;
+    info.free_pages = stats.free_pages;
+    for (uint32_t order = 0; order < SYS_MEM_ORDER_COUNT; order++)
+        info.free_blocks[order] = stats.free_blocks[order];
+    info.allocs = stats.allocs;
+    info.frees = stats.frees;
+    info.splits = stats.splits;
+    info.merges = stats.merges;
+    info.bad_frees = stats.bad_frees;
+    info.cached_pages = stats.cached_pages;
+    info.pcp_hits = stats.pcp_hits;
+    info.pcp_refills = stats.pcp_refills;
+    info.pcp_drains = stats.pcp_drains;
+    info.node_count = stats.node_count;
+    for (uint32_t node = 0; node < stats.node_count && node < SYS_MEM_MAX_NODES; node++)
+    {
+        info.node_id[node] = stats.nodes[node].node_id;
+        info.node_total_pages[node] = stats.nodes[node].total_pages;
+        info.node_free_pages[node] = stats.nodes[node].free_pages;
+        info.node_local_allocs[node] = stats.nodes[node].local_allocs;
+        info.node_remote_allocs[node] = stats.nodes[node].remote_allocs;
+    }
+    info.thp_pages = __atomic_load_n(&Syscall_state.thp_pages, __ATOMIC_RELAXED);
+    info.thp_faults = __atomic_load_n(&Syscall_state.thp_faults, __ATOMIC_RELAXED);
+    info.thp_fallbacks = __atomic_load_n(&Syscall_state.thp_fallbacks, __ATOMIC_RELAXED);
+    info.thp_splits = __atomic_load_n(&Syscall_state.thp_splits, __ATOMIC_RELAXED);
+    info.thp_collapses = __atomic_load_n(&Syscall_state.thp_collapses, __ATOMIC_RELAXED);
+    info.zero_pool_pages = stats.zero_pool_pages;
+    info.zero_hits = stats.zero_hits;
+    info.zero_misses = stats.zero_misses;
+    info.usercopy_slow = __atomic_load_n(&Syscall_state.usercopy_slow, __ATOMIC_RELAXED);
+    info.rlimit_hits = __atomic_load_n(&Syscall_state.rlimit_hits, __ATOMIC_RELAXED);
+
+    ZSWAP_stats_t swap;
+    zswap_get_stats(&swap);
+    info.swap_pages = swap.stored_pages;
+    info.swap_fill_pages = swap.fill_pages;
+    info.swap_pool_bytes = swap.pool_bytes;
+    info.swap_pool_limit = swap.pool_limit;
+    info.swap_outs = __atomic_load_n(&Syscall_state.swap_outs, __ATOMIC_RELAXED);
+    info.swap_ins = __atomic_load_n(&Syscall_state.swap_ins, __ATOMIC_RELAXED);
+    info.swap_rejects = swap.rejects + swap.failures;
+    info.swap_direct = __atomic_load_n(&Syscall_state.swap_direct, __ATOMIC_RELAXED);
+    info.reclaim_runs = stats.reclaim_runs;
+    info.reclaim_pages = stats.reclaim_pages;
+
+    BCACHE_stats_t bcache;
+    BCache_get_stats(&bcache);
+    info.bcache_blocks = bcache.blocks;
+    info.bcache_dirty = bcache.dirty_blocks;
+    info.bcache_bytes = bcache.bytes;
+    info.bcache_limit = bcache.limit;
+    info.bcache_hits = bcache.hits;
+    info.bcache_misses = bcache.misses;
+    info.bcache_reads = bcache.reads;
+    info.bcache_writes = bcache.writes;
+    info.bcache_evictions = bcache.evictions;
+    return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+}
+
+// Walks the heap under its lock, so not a fast call; SYS_KMEM_INFO_DUMP also logs it.
+static uint64_t Syscall_handle_kmem_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_SHMGET:
-            return Syscall_handle_shmget(cpu_index, frame);
+    if ((frame->rsi & ~(uint64_t) SYS_KMEM_INFO_DUMP) != 0)
+        return (uint64_t) -1;
+    if ((frame->rsi & SYS_KMEM_INFO_DUMP) != 0)
+        kmem_dump(KMEM_DUMP_SITES);
+
+    KMEM_stats_t stats;
+    kmem_get_stats(&stats);
+    KMEM_site_stats_t sites[SYS_KMEM_SITE_MAX];
+    uint32_t site_count = kmem_get_sites(sites, SYS_KMEM_SITE_MAX);
+
+    syscall_kmem_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.bytes_in_use = stats.bytes_in_use;
+    info.bytes_peak = stats.bytes_peak;
+    info.allocs = stats.allocs;
+    info.frees = stats.frees;
+    info.failures = stats.failures;
+    info.last_failure_size = stats.last_failure_size;
+    info.heap_size = stats.heap_size;
+    info.heap_used = stats.heap_used;
+    info.heap_used_blocks = stats.heap_used_blocks;
+    info.heap_free = stats.heap_free;
+    info.heap_free_blocks = stats.heap_free_blocks;
+    info.heap_largest_free = stats.heap_largest_free;
+    info.arenas_grown = stats.arenas_grown;
+    info.arenas_released = stats.arenas_released;
+    info.arenas = stats.arenas;
+    info.tracking = THEOS_KMEM_TRACK ? 1U : 0U;
+    info.site_count = stats.site_count;
+    info.site_returned = site_count;
+    info.untracked = stats.untracked;
+    for (uint32_t i = 0; i < site_count; i++)
+    {
+        info.sites[i].site = sites[i].site;
+        info.sites[i].allocs = sites[i].allocs;
+        info.sites[i].frees = sites[i].frees;
+        info.sites[i].live_bytes = sites[i].live_bytes;
+        info.sites[i].live_count = sites[i].live_count;
+        info.sites[i].peak_bytes = sites[i].peak_bytes;
+    }
+    return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+}
+
+// Pipes and message queues are kmalloc'd on creation: this counts the ones alive right now.
+static uint64_t Syscall_handle_ipc_info_get(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_SHMAT:
-            return Syscall_handle_shmat(cpu_index, frame);
+    syscall_ipc_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.pipes_max = SYSCALL_PIPE_MAX;
+    info.msg_queues_max = SYSCALL_MSG_MAX_QUEUES;
+    if (Syscall_state.pipe_lock_ready)
+    {
+        spin_lock(&Syscall_state.pipe_lock);
+        for (uint32_t i = 0; i < SYSCALL_PIPE_MAX; i++)
+        {
+            if (Syscall_state.pipes[i])
+                info.pipes++;
+        }
+        spin_unlock(&Syscall_state.pipe_lock);
+    }
+    if (Syscall_state.msg_lock_ready)
+    {
+        spin_lock(&Syscall_state.msg_lock);
+        for (uint32_t i = 0; i < SYSCALL_MSG_MAX_QUEUES; i++)
+        {
+            if (Syscall_state.msg_queues[i])
+                info.msg_queues++;
+        }
+        spin_unlock(&Syscall_state.msg_lock);
+    }
+    return Syscall_copy_to_user((void*) frame->rdi, &info, sizeof(info)) ? 0 : (uint64_t) -1;
+}
 
-        case SYS_SHMDT:
-            return Syscall_handle_shmdt(cpu_index, frame);
+// Writes happen at the end of each ext4 change anyway; this catches anything still dirty.
+static uint64_t Syscall_handle_sync(uint32_t cpu_index, const syscall_frame_t* frame)
+{
+    (void) cpu_index;
 
-        case SYS_SHMCTL:
-            return Syscall_handle_shmctl(cpu_index, frame);
+    if ((frame->rdi & ~(uint64_t) SYS_SYNC_DROP_CACHES) != 0)
+        return (uint64_t) -1;
+    if (!BCache_sync(NULL))
+        return (uint64_t) -1;
+    if ((frame->rdi & SYS_SYNC_DROP_CACHES) != 0)
+        (void) BCache_drop_clean();
 
-        case SYS_MSGGET:
-            return Syscall_handle_msgget(cpu_index, frame);
+    return 0;
+}
 
-        case SYS_MSGSND:
-            return Syscall_handle_msgsnd(cpu_index, frame);
+/*
+ * Trivial calls neither block nor touch the scheduler, so when nothing is pending they can
+ * sysret without the post handler: the register image is not needed until the process is
+ * next preempted or enters a full syscall, both of which save it again. Returns with
+ * interrupts masked on success so no tick can slip in before the stub's sysret.
+ */
+static bool Syscall_fast_return_try(uint32_t cpu_index, task_cpu_local_t* cpu_local)
+{
+    if (!Syscall_state.proc_lock_ready)
+        return false;
 
-        case SYS_MSGRCV:
-            return Syscall_handle_msgrcv(cpu_index, frame);
+    cli();
+    uint32_t slot = Syscall_state.cpu_current_proc[cpu_index];
+    if (slot >= SYSCALL_MAX_PROCS ||
+        __atomic_load_n(&Syscall_state.cpu_need_resched[cpu_index], __ATOMIC_ACQUIRE) != 0)
+    {
+        sti();
+        return false;
+    }
 
-        default:
-        {
-            if (Syscall_state.proc_lock_ready)
-            {
-                uint32_t pid = 0;
-                bool delivered = false;
+    syscall_process_t* proc = &Syscall_state.procs[slot];
+    uintptr_t kstack_base = Syscall_state.proc_kstack_base[slot];
+    if (!proc->used || __atomic_load_n(&proc->exiting, __ATOMIC_ACQUIRE) || kstack_base == 0 ||
+        cpu_local->syscall_rsp0 != ((kstack_base + SYSCALL_PROC_KSTACK_SIZE) & ~0xFULL))
+    {
+        sti();
+        return false;
+    }
 
-                uint64_t lock_flags = spin_lock_irqsave(&Syscall_state.proc_lock);
-                int32_t slot = Syscall_proc_ensure_current_locked(cpu_index, frame);
-                if (slot >= 0)
-                {
-                    syscall_process_t* proc = &Syscall_state.procs[slot];
-                    pid = proc->pid;
+    if (proc->exec_start_tsc != 0)
+        Syscall_sched_charge(proc, x86_rdtsc());
+    proc->in_kernel = false;
+    Syscall_state.cpu_syscall_stats[cpu_index].fast_returns++;
+    cpu_local->syscall_fast_return = 1;
+    return true;
+}
 
-                    delivered = Syscall_signal_terminate_owner_locked(proc->owner_pid, SYS_SIGSYS);
-                    if (!delivered)
-                    {
-                        proc->exiting = true;
-                        proc->terminated_by_signal = true;
-                        proc->term_signal = SYS_SIGSYS;
-                        proc->exit_status = 128 + SYS_SIGSYS;
-                        proc->thread_exit_value = 0;
-                        delivered = true;
-                    }
-                }
-                spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
+uint64_t Syscall_interrupt_handler(uint64_t syscall_num, syscall_frame_t* frame, uint32_t cpu_index)
+{
+    // The LAPIC is only read when the per-CPU block cannot say which CPU this is.
+    task_cpu_local_t* cpu_local = task_get_cpu_local();
+    if (cpu_local)
+        cpu_index = __atomic_load_n(&cpu_local->cpu_index, __ATOMIC_RELAXED);
+    if (cpu_index >= 256)
+        cpu_index = cpu_local ? __atomic_load_n(&cpu_local->apic_id, __ATOMIC_RELAXED) : APIC_get_current_lapic_id();
 
-                if (delivered)
-                {
-                    kdebug_printf("[USER] pid=%u killed by SIGSYS (unknown syscall=%llu)\n",
-                                  (unsigned int) pid,
-                                  (unsigned long long) syscall_num);
-                }
-            }
+    Syscall_account_enter(cpu_index);
+    if (cpu_local)
+        cpu_local->syscall_count++;
 
-            return (uint64_t) -1;
-        }
-    }
+    const syscall_table_entry_t* entry = (syscall_num < SYSCALL_NR_MAX) ? &Syscall_table[syscall_num] : NULL;
+    if (!entry || !entry->fn)
+        return Syscall_handle_unknown(syscall_num, cpu_index, frame);
+
+    // Only this CPU bumps its row, so a plain increment is enough.
+    Syscall_state.cpu_syscall_stats[cpu_index].calls[syscall_num]++;
+    uint64_t ret = entry->fn(cpu_index, frame);
+    if ((entry->flags & SYSCALL_ENTRY_FAST) != 0 && cpu_local)
+        (void) Syscall_fast_return_try(cpu_index, cpu_local);
+    return ret;
 }
 
 uint64_t Syscall_interupt_handler(uint64_t syscall_num, syscall_frame_t* frame, uint32_t cpu_index)
@@ -9268,39 +12434,85 @@ uint64_t Syscall_interupt_handler(uint64_t syscall_num, syscall_frame_t* frame,
     return Syscall_interrupt_handler(syscall_num, frame, cpu_index);
 }
 
+// Register image a process resumes from when it next leaves the kernel through this syscall.
+static void Syscall_proc_save_syscall_return(syscall_process_t* proc, const syscall_frame_t* frame, uint64_t syscall_ret)
+{
+    proc->rax = syscall_ret;
+    proc->rcx = 0;
+    proc->rdx = frame->rdx;
+    proc->rsi = frame->rsi;
+    proc->rdi = frame->rdi;
+    proc->r8 = frame->r8;
+    proc->r9 = frame->r9;
+    proc->r10 = frame->r10;
+    proc->r11 = 0;
+    proc->r15 = frame->r15;
+    proc->r14 = frame->r14;
+    proc->r13 = frame->r13;
+    proc->r12 = frame->r12;
+    proc->rbp = frame->rbp;
+    proc->rbx = frame->rbx;
+    proc->rip = frame->rip;
+    proc->rflags = frame->rflags | SYSCALL_RFLAGS_IF;
+    proc->rsp = frame->rsp;
+    proc->cr3_phys = Syscall_read_cr3_phys();
+    proc->fs_base = Syscall_read_fs_base();
+    proc->pending_rax = syscall_ret;
+}
+
+/*
+ * Common return: the caller keeps the CPU, already runs on its own kernel stack and is not
+ * being killed. Its register image belongs to this CPU, so the slot lock is enough and
+ * proc_lock stays out of the syscall path. Anything else takes the full path below.
+ */
+static bool Syscall_post_fast_path_try(uint64_t syscall_ret,
+                                       const syscall_frame_t* frame,
+                                       uint32_t cpu_index,
+                                       const task_cpu_local_t* cpu_local)
+{
+    int32_t slot = Syscall_proc_current_slot_fast(cpu_index);
+    if (slot < 0 || !cpu_local ||
+        __atomic_load_n(&Syscall_state.cpu_need_resched[cpu_index], __ATOMIC_ACQUIRE) != 0)
+        return false;
+
+    uintptr_t kstack_base = Syscall_state.proc_kstack_base[slot];
+    if (kstack_base == 0 ||
+        cpu_local->syscall_rsp0 != ((kstack_base + SYSCALL_PROC_KSTACK_SIZE) & ~0xFULL))
+        return false;
+
+    syscall_process_t* current = &Syscall_state.procs[slot];
+    uint64_t flags = spin_lock_irqsave(&current->lock);
+    if (current->exiting)
+    {
+        spin_unlock_irqrestore(&current->lock, flags);
+        return false;
+    }
+
+    if (current->exec_start_tsc != 0)
+        Syscall_sched_charge(current, x86_rdtsc());
+    current->in_kernel = false;
+    Syscall_proc_save_syscall_return(current, frame, syscall_ret);
+    current->last_cpu = cpu_index;
+    Syscall_state.cpu_slice_ticks[cpu_index] = 0;
+    spin_unlock_irqrestore(&current->lock, flags);
+    return true;
+}
+
 uint64_t Syscall_post_handler(uint64_t syscall_ret, syscall_frame_t* frame, uint32_t cpu_index)
 {
     if (!frame || !Syscall_state.proc_lock_ready)
         return syscall_ret;
 
     task_cpu_local_t* post_cpu_local = task_get_cpu_local();
-    uint8_t post_apic_id = APIC_get_current_lapic_id();
     if (post_cpu_local)
-    {
         cpu_index = __atomic_load_n(&post_cpu_local->cpu_index, __ATOMIC_RELAXED);
-        post_apic_id = __atomic_load_n(&post_cpu_local->apic_id, __ATOMIC_RELAXED);
-    }
-
     if (cpu_index >= 256)
-        cpu_index = post_apic_id;
-
-    Syscall_debug_post_calls++;
-    Syscall_debug_post_calls_cpu[cpu_index & 0x3U]++;
-
-    uintptr_t old_cr3_to_free = 0;
-    bool free_old_cr3 = false;
-    bool cleanup_fds = false;
-    uint32_t cleanup_pid = 0;
-    uint32_t cleanup_ppid = 0;
-    uint32_t cleanup_owner_pid = 0;
-    uint32_t cleanup_console_sid = 0;
-    uint32_t cleanup_tid = 0;
-    int64_t cleanup_status = 0;
-    int32_t cleanup_signal = 0;
-    uint64_t cleanup_thread_value = 0;
-    bool queue_exit_event = false;
-    bool queue_thread_exit_event = false;
-    bool cleanup_console_route = false;
+        cpu_index = post_cpu_local ? __atomic_load_n(&post_cpu_local->apic_id, __ATOMIC_RELAXED) :
+                                     APIC_get_current_lapic_id();
+
+    if (Syscall_post_fast_path_try(syscall_ret, frame, cpu_index, post_cpu_local))
+        return syscall_ret;
+
     uint64_t ret_for_next = syscall_ret;
     uintptr_t next_cr3 = Syscall_read_cr3_phys();
     uintptr_t next_fs_base = Syscall_read_fs_base();
@@ -9314,54 +12526,43 @@ uint64_t Syscall_post_handler(uint64_t syscall_ret, syscall_frame_t* frame, uint
     }
 
     syscall_process_t* current = &Syscall_state.procs[current_slot];
-    if (!current->exiting)
-    {
-        current->rax = syscall_ret;
-        current->rcx = 0;
-        current->rdx = frame->rdx;
-        current->rsi = frame->rsi;
-        current->rdi = frame->rdi;
-        current->r8 = frame->r8;
-        current->r9 = frame->r9;
-        current->r10 = frame->r10;
-        current->r11 = 0;
-        current->r15 = frame->r15;
-        current->r14 = frame->r14;
-        current->r13 = frame->r13;
-        current->r12 = frame->r12;
-        current->rbp = frame->rbp;
-        current->rbx = frame->rbx;
-        current->rip = frame->rip;
-        current->rflags = frame->rflags | SYSCALL_RFLAGS_IF;
-        current->rsp = frame->rsp;
-        current->cr3_phys = Syscall_read_cr3_phys();
-        current->fs_base = Syscall_read_fs_base();
-        current->pending_rax = syscall_ret;
-    }
-    else
+    Syscall_sched_update_curr_locked(cpu_index);
+    current->in_kernel = false;
+    spin_lock(&current->lock);
+    bool exiting = current->exiting;
+    if (!exiting)
+        Syscall_proc_save_syscall_return(current, frame, syscall_ret);
+    spin_unlock(&current->lock);
+    if (exiting)
     {
         bool owner_has_other_live = Syscall_proc_owner_has_other_live_locked(current->owner_pid, current_slot);
-        if (!owner_has_other_live && current->owns_cr3)
-        {
-            old_cr3_to_free = current->cr3_phys;
-            free_old_cr3 = (old_cr3_to_free != 0);
-        }
-
-        cleanup_pid = current->owner_pid;
-        cleanup_ppid = current->ppid;
-        cleanup_owner_pid = current->owner_pid;
-        cleanup_console_sid = current->console_sid;
-        cleanup_tid = current->pid;
-        cleanup_status = current->exit_status;
-        cleanup_signal = current->terminated_by_signal ? current->term_signal : 0;
-        cleanup_thread_value = current->thread_exit_value;
-        queue_thread_exit_event = current->is_thread && cleanup_owner_pid != 0 && cleanup_tid != 0;
-        queue_exit_event = (!owner_has_other_live && cleanup_ppid != 0 && cleanup_pid != 0);
-        cleanup_fds = !owner_has_other_live;
-        cleanup_console_route = false;
-        Syscall_idle_claimed_slots[(uint32_t) current_slot] = 0U;
-        memset(current, 0, sizeof(*current));
-        Syscall_state.cpu_current_proc[cpu_index] = SYSCALL_PROC_NONE;
+        uint32_t exit_pid = current->owner_pid;
+        uint32_t exit_ppid = current->ppid;
+        uint32_t exit_tid = current->pid;
+
+        // Teardown that may sleep runs after the switch, off this (now free) kernel stack.
+        syscall_switch_cleanup_t* cleanup = &Syscall_state.cpu_switch_cleanup[cpu_index];
+        cleanup->pending = true;
+        cleanup->owner_pid = exit_pid;
+        cleanup->cleanup_fds = !owner_has_other_live;
+        if (!owner_has_other_live && current->owns_cr3 && current->cr3_phys != 0)
+        {
+            cleanup->free_cr3 = true;
+            cleanup->cr3_phys = current->cr3_phys;
+        }
+
+        if (!owner_has_other_live && exit_ppid != 0 && exit_pid != 0)
+            Syscall_exit_event_push_locked(exit_ppid,
+                                           exit_pid,
+                                           current->exit_status,
+                                           current->terminated_by_signal ? current->term_signal : 0);
+        if (current->is_thread && exit_pid != 0 && exit_tid != 0)
+            Syscall_thread_exit_event_push_locked(exit_pid, exit_tid, current->thread_exit_value);
+
+        Syscall_sched_update_curr_locked(cpu_index);
+        Syscall_proc_usage_fold_exit_locked(current_slot);
+        Syscall_proc_release_slot_locked((uint32_t) current_slot);
+        Syscall_proc_set_current_locked(cpu_index, -1);
         current_slot = -1;
     }
 
@@ -9390,21 +12591,19 @@ uint64_t Syscall_post_handler(uint64_t syscall_ret, syscall_frame_t* frame, uint
         else
             next_slot = Syscall_proc_pick_next_locked(current_slot, cpu_index);
     }
-    if (next_slot < 0)
+    if (next_slot != current_slot)
     {
-        spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
-        if (free_old_cr3)
-            Syscall_free_address_space(old_cr3_to_free);
-        task_idle_loop();
+        if (current_slot >= 0 && next_slot >= 0)
+        {
+            Syscall_debug_post_switch++;
+            Syscall_debug_post_switch_cpu[cpu_index & 0x3U]++;
+        }
+
+        // The outgoing process was saved above; never sysret from its kernel stack.
+        Syscall_proc_switch_locked(cpu_index, -1, next_slot);
         __builtin_unreachable();
     }
 
-    Syscall_state.cpu_current_proc[cpu_index] = (uint32_t) next_slot;
-    if (current_slot >= 0 && next_slot != current_slot)
-    {
-        Syscall_debug_post_switch++;
-        Syscall_debug_post_switch_cpu[cpu_index & 0x3U]++;
-    }
     Syscall_state.cpu_slice_ticks[cpu_index] = 0;
     syscall_process_t* next = &Syscall_state.procs[next_slot];
     next->last_cpu = cpu_index;
@@ -9426,24 +12625,17 @@ uint64_t Syscall_post_handler(uint64_t syscall_ret, syscall_frame_t* frame, uint
     ret_for_next = next->pending_rax;
     next_cr3 = next->cr3_phys;
     next_fs_base = next->fs_base;
-    if (queue_exit_event)
-        Syscall_exit_event_push_locked(cleanup_ppid, cleanup_pid, cleanup_status, cleanup_signal);
-    if (queue_thread_exit_event)
-        Syscall_thread_exit_event_push_locked(cleanup_owner_pid, cleanup_tid, cleanup_thread_value);
+
+    // First syscall of a process may still run on the per-CPU stack: move it to its own.
+    uintptr_t kstack_top = Syscall_proc_kstack_top_locked((uint32_t) next_slot, cpu_index);
+    if (post_cpu_local && post_cpu_local->syscall_rsp0 != kstack_top)
+        task_set_user_kernel_stack(cpu_index, kstack_top);
     spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
     if (next_cr3 != Syscall_read_cr3_phys())
-        Syscall_write_cr3_phys(next_cr3);
+        VMM_switch_cr3(cpu_index, next_cr3);
     if (next_fs_base != Syscall_read_fs_base())
         Syscall_write_fs_base(next_fs_base);
-    if (cleanup_fds)
-        Syscall_fd_cleanup_owner(cleanup_pid);
-    if (cleanup_fds && cleanup_pid != 0U && Syscall_kbd_hardware_capture_pid == cleanup_pid)
-        Syscall_kbd_hardware_capture_pid = 0U;
-    if (cleanup_console_route)
-        Syscall_console_route_clear_sid(cleanup_console_sid);
-    if (free_old_cr3 && old_cr3_to_free != next_cr3)
-        Syscall_free_address_space(old_cr3_to_free);
 
     return ret_for_next;
 }
@@ -9467,8 +12659,11 @@ bool Syscall_handle_user_exception(interrupt_frame_t* frame, uintptr_t fault_add
     if (cpu_index >= 256)
         cpu_index = apic_id;
 
+    if (frame->int_no == 14)
+        Syscall_swap_direct_reclaim();
     if (frame->int_no == 14 &&
-        Syscall_resolve_cow_fault(cpu_index, fault_addr, frame->err_code))
+        (Syscall_resolve_lazy_fault(fault_addr, frame->err_code) ||
+         Syscall_resolve_cow_fault(cpu_index, fault_addr, frame->err_code)))
     {
         return true;
     }
@@ -9517,12 +12712,7 @@ bool Syscall_handle_user_exception(interrupt_frame_t* frame, uintptr_t fault_add
     }
 
     if (!terminated)
-    {
-        proc->exiting = true;
-        proc->terminated_by_signal = true;
-        proc->term_signal = signal;
-        proc->exit_status = 128 + signal;
-    }
+        Syscall_proc_mark_killed_locked(proc, signal);
     spin_unlock_irqrestore(&Syscall_state.proc_lock, lock_flags);
 
     const char* signal_name = Syscall_signal_name(signal);
@@ -0,0 +1,25 @@
+#include <CPU/UserCopy.h>
+
+#include <Memory/VMMLayout.h>
+
+/*
+ * Kernel-mode #PF: resume at the fixup when the faulting instruction is one of the user
+ * accessors and the address is a user one. Anything else (a kernel pointer gone bad, a
+ * vmalloc guard page) stays fatal.
+ */
+bool UserCopy_fixup_fault(interrupt_frame_t* frame, uintptr_t fault_addr)
+{
+    if (!frame || fault_addr > VMM_USER_SPACE_MAX)
+        return false;
+
+    for (const UserCopy_fixup_t* entry = ex_table_start; entry < ex_table_end; entry++)
+    {
+        if (entry->insn == frame->rip)
+        {
+            frame->rip = entry->fixup;
+            return true;
+        }
+    }
+
+    return false;
+}
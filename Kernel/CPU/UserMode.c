@@ -36,17 +36,12 @@ static inline uintptr_t UserMode_read_cr3_phys(void)
 
 static inline void UserMode_write_cr3_phys(uintptr_t cr3_phys)
 {
-    __asm__ __volatile__("mov %0, %%cr3" : : "r"(cr3_phys) : "memory");
+    VMM_switch_cr3(task_get_current_cpu_index(), cr3_phys);
 }
 
 static uintptr_t UserMode_alloc_zero_page_phys(void)
 {
-    uintptr_t phys = (uintptr_t) PMM_alloc_page();
-    if (phys == 0)
-        return 0;
-
-    memset((void*) P2V(phys), 0, 0x1000U);
-    return phys;
+    return (uintptr_t) PMM_alloc_zeroed_page();
 }
 
 static void UserMode_free_user_pt(uintptr_t pt_phys)
@@ -169,12 +164,11 @@ static bool UserMode_map_user_range(uintptr_t base, size_t size)
         uintptr_t phys = 0;
         if (!VMM_virt_to_phys(page, &phys))
         {
-            void* new_page = PMM_alloc_page();
+            void* new_page = PMM_alloc_zeroed_page();
             if (!new_page)
                 return false;
 
             VMM_map_user_page(page, (uintptr_t) new_page);
-            memset((void*) page, 0, 0x1000U);
         }
         else if (!VMM_is_user_accessible(page))
             return false;
@@ -0,0 +1,103 @@
+#include <CPU/VDSO.h>
+
+#include <CPU/APIC.h>
+#include <CPU/ISR.h>
+#include <CPU/x86.h>
+#include <Debug/KDebug.h>
+#include <Device/RTC.h>
+#include <Memory/PMM.h>
+#include <Memory/VMM.h>
+
+#include <string.h>
+
+static VDSO_runtime_state_t VDSO_state;
+
+static uint64_t VDSO_ticks_to_ns(uint64_t ticks, uint32_t tick_hz)
+{
+    if (tick_hz == 0U)
+        return 0ULL;
+    return (ticks / tick_hz) * 1000000000ULL + ((ticks % tick_hz) * 1000000000ULL) / tick_hz;
+}
+
+// Same split multiply as the libc reader, so both sides agree to the nanosecond.
+static uint64_t VDSO_scale_tsc(uint64_t delta, uint64_t mult)
+{
+    const uint64_t low_mask = (1ULL << SYS_VVAR_TSC_SHIFT) - 1ULL;
+    return (delta >> SYS_VVAR_TSC_SHIFT) * mult + (((delta & low_mask) * mult) >> SYS_VVAR_TSC_SHIFT);
+}
+
+bool VDSO_init(void)
+{
+    uintptr_t phys = (uintptr_t) PMM_alloc_page();
+    if (phys == 0)
+        return false;
+
+    syscall_vvar_t* vvar = (syscall_vvar_t*) P2V(phys);
+    memset(vvar, 0, PHYS_PAGE_SIZE);
+
+    uint32_t tick_hz = ISR_get_tick_hz();
+    uint64_t ticks = ISR_get_timer_ticks();
+    uint64_t now_ns = VDSO_ticks_to_ns(ticks, tick_hz);
+    uint64_t rtc_seconds = RTC_get_epoch_seconds();
+
+    vvar->tick_hz = tick_hz;
+    vvar->ticks = ticks;
+    vvar->ns_base = now_ns;
+    vvar->tsc_base = x86_rdtsc();
+    if (rtc_seconds != 0ULL && rtc_seconds * 1000000000ULL > now_ns)
+        vvar->realtime_offset_ns = rtc_seconds * 1000000000ULL - now_ns;
+
+    VDSO_state.vvar_phys = phys;
+    VDSO_state.vvar = vvar;
+    __atomic_store_n(&VDSO_state.ready, true, __ATOMIC_RELEASE);
+
+    kdebug_printf("[VDSO] vvar phys=0x%llX user=0x%llX tick_hz=%u rtc=%llu\n",
+                  (unsigned long long) phys,
+                  (unsigned long long) SYS_VVAR_ADDR,
+                  (unsigned int) tick_hz,
+                  (unsigned long long) rtc_seconds);
+    return true;
+}
+
+/*
+ * Called by the one CPU that advances the wall-clock tick, so the seqlock has a single writer.
+ * The TSC base is moved forward every tick to keep the reader's multiply far from overflow.
+ */
+void VDSO_on_tick(uint64_t ticks)
+{
+    if (!__atomic_load_n(&VDSO_state.ready, __ATOMIC_ACQUIRE))
+        return;
+
+    syscall_vvar_t* vvar = VDSO_state.vvar;
+    uint64_t tsc = x86_rdtsc();
+    uint32_t tick_hz = ISR_get_tick_hz();
+
+    uint64_t now_ns;
+    if (vvar->tsc_mult != 0ULL)
+        now_ns = vvar->ns_base + VDSO_scale_tsc(tsc > vvar->tsc_base ? tsc - vvar->tsc_base : 0ULL, vvar->tsc_mult);
+    else
+        now_ns = VDSO_ticks_to_ns(ticks, tick_hz);
+    if (now_ns < vvar->ns_base)
+        now_ns = vvar->ns_base;
+
+    // The TSC rate is only known once the LAPIC timer is calibrated; ticks carry the clock until then.
+    uint64_t tsc_mult = vvar->tsc_mult;
+    uint64_t tsc_hz = APIC_get_tsc_hz();
+    if (tsc_mult == 0ULL && tsc_hz != 0ULL)
+        tsc_mult = (1000000000ULL << SYS_VVAR_TSC_SHIFT) / tsc_hz;
+
+    uint32_t seq = vvar->seq;
+    __atomic_store_n(&vvar->seq, seq + 1U, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    vvar->tick_hz = tick_hz;
+    vvar->ticks = ticks;
+    vvar->tsc_base = tsc;
+    vvar->tsc_mult = tsc_mult;
+    vvar->ns_base = now_ns;
+    __atomic_store_n(&vvar->seq, seq + 2U, __ATOMIC_RELEASE);
+}
+
+uintptr_t VDSO_get_vvar_phys(void)
+{
+    return __atomic_load_n(&VDSO_state.ready, __ATOMIC_ACQUIRE) ? VDSO_state.vvar_phys : 0;
+}
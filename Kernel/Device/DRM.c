@@ -667,7 +667,7 @@ static void DRM_release_buffer_if_unused_locked(drm_buffer_t* buffer)
         for (uint32_t i = 0; i < buffer->page_count; i++)
         {
             if (buffer->page_phys[i] != 0)
-                PMM_dealloc_page((void*) buffer->page_phys[i]);
+                PMM_dealloc_page_cold((void*) buffer->page_phys[i]);
         }
 
         kfree(buffer->page_phys);
@@ -1190,7 +1190,7 @@ bool DRM_create_dumb(uint32_t file_id, drm_mode_create_dumb_t* io)
     bool alloc_ok = true;
     for (uint32_t i = 0; i < page_count; i++)
     {
-        uintptr_t phys = (uintptr_t) PMM_alloc_page();
+        uintptr_t phys = (uintptr_t) PMM_alloc_zeroed_page();
         if (phys == 0)
         {
             alloc_ok = false;
@@ -1198,7 +1198,6 @@ bool DRM_create_dumb(uint32_t file_id, drm_mode_create_dumb_t* io)
         }
 
         page_phys[i] = phys;
-        memset((void*) P2V(phys), 0, PHYS_PAGE_SIZE);
     }
 
     if (!alloc_ok)
@@ -109,3 +109,50 @@ void RTC_read(RTC_t* rtc)
         rtc->year = (uint16_t) RTC_from_bcd((uint8_t) rtc->year) + 2000;
     }
 }
+
+static bool RTC_is_leap_year(uint32_t year)
+{
+    if ((year % 4U) != 0U)
+        return false;
+    if ((year % 100U) != 0U)
+        return true;
+    return (year % 400U) == 0U;
+}
+
+static uint32_t RTC_days_in_month(uint32_t year, uint32_t month_1_to_12)
+{
+    static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (month_1_to_12 == 2U)
+        return days[1] + (RTC_is_leap_year(year) ? 1U : 0U);
+    if (month_1_to_12 < 1U || month_1_to_12 > 12U)
+        return 31U;
+    return days[month_1_to_12 - 1U];
+}
+
+// Seconds since 1970-01-01 UTC from the CMOS clock, 0 when the clock reads garbage.
+uint64_t RTC_get_epoch_seconds(void)
+{
+    RTC_t rtc;
+    RTC_read(&rtc);
+    uint32_t year = (uint32_t) rtc.year;
+    uint32_t month = (uint32_t) rtc.month;
+    uint32_t day = (uint32_t) rtc.month_day;
+    uint32_t hour = (uint32_t) rtc.hours;
+    uint32_t minute = (uint32_t) rtc.minutes;
+    uint32_t second = (uint32_t) rtc.seconds;
+
+    if (year < 1970U || month < 1U || month > 12U || day < 1U || day > 31U ||
+        hour > 23U || minute > 59U || second > 59U)
+        return 0ULL;
+
+    uint64_t days = 0ULL;
+    for (uint32_t y = 1970U; y < year; y++)
+        days += RTC_is_leap_year(y) ? 366ULL : 365ULL;
+    for (uint32_t m = 1U; m < month; m++)
+        days += (uint64_t) RTC_days_in_month(year, m);
+    if (day > RTC_days_in_month(year, month))
+        return 0ULL;
+    days += (uint64_t) (day - 1U);
+
+    return days * 86400ULL + (uint64_t) hour * 3600ULL + (uint64_t) minute * 60ULL + (uint64_t) second;
+}
@@ -18,6 +18,7 @@
 #include <Memory/PMM.h>
 #include <Memory/VMM.h>
 #include <Memory/KMem.h>
+#include <Memory/VMalloc.h>
 #include <Task/Task.h>
 #include <CPU/APIC.h>
 #include <CPU/ACPI.h>
@@ -28,8 +29,10 @@
 #include <CPU/ISR.h>
 #include <CPU/FPU.h>
 #include <CPU/PCI.h>
+#include <CPU/VDSO.h>
 #include <CPU/x86.h>
 #include <Network/ARP.h>
+#include <Storage/BCache.h>
 #include <Storage/VFS.h>
 
 #include <stdint.h>
@@ -470,6 +473,7 @@ __attribute__((__noreturn__)) void k_entry(void)
     VMM_hardware_mapping();
     VMM_load_cr3();
     kdebug_puts("[BOOT] CR3 loaded\n");
+    vmalloc_init();
     GDT_load_kernel_segments();
     kdebug_puts("[BOOT] GDT reloaded\n");
     LimineHelper_promote_bootloader_reclaimable();
@@ -516,6 +520,7 @@ __attribute__((__noreturn__)) void k_entry(void)
         kdebug_printf("[BOOT] NUMA %s nodes=%u\n",
                       NUMA_is_available() ? "enabled" : "disabled",
                       NUMA_get_node_count());
+        PMM_numa_init();
         APIC_enable();
         kdebug_puts("[BOOT] APIC enabled\n");
     }
@@ -534,8 +539,14 @@ __attribute__((__noreturn__)) void k_entry(void)
     kdebug_puts("[BOOT] keyboard init\n");
     Mouse_init();
     kdebug_printf("[BOOT] mouse init ready=%s\n", Mouse_is_ready() ? "yes" : "no");
+    BCache_init();
     Syscall_init();
     kdebug_puts("[BOOT] syscall init\n");
+    if (!VDSO_init())
+    {
+        kdebug_puts("[BOOT] vDSO init failed\n");
+        abort();
+    }
     AHCI_write_guard_disallow_all();
 
     static ext4_fs_t fs;
@@ -2,6 +2,7 @@
 
 #include <Debug/KDebug.h>
 #include <Memory/KMem.h>
+#include <Storage/BCache.h>
 
 #include <string.h>
 #include <stdio.h>
@@ -27,73 +28,66 @@ static bool ext4_dir_entry_is_valid(ext4_fs_t* fs, uint32_t offset, const ext4_d
     return true;
 }
 
+static uint64_t ext4_block_lba(const ext4_fs_t* fs, uint64_t block)
+{
+    return fs->lba_base + block * (fs->block_size / AHCI_SECTOR_SIZE);
+}
+
+// Every metadata and data access goes through the block cache, one block at a time.
 static bool ext4_read_bytes(ext4_fs_t* fs, uint64_t offset, void* out, size_t size)
 {
     if (!fs || !fs->port || (!out && size != 0))
         return false;
-    if (size == 0)
-        return true;
-
-    uint64_t start_lba = fs->lba_base + (offset / AHCI_SECTOR_SIZE);
-    uint64_t end_lba = fs->lba_base + ((offset + size + AHCI_SECTOR_SIZE - 1) / AHCI_SECTOR_SIZE);
-    if (end_lba <= start_lba || (end_lba - start_lba) > 0xFFFFFFFFULL)
-        return false;
 
-    uint32_t sectors = (uint32_t) (end_lba - start_lba);
-    size_t byte_count = (size_t) sectors * AHCI_SECTOR_SIZE;
+    uint8_t* dst = (uint8_t*) out;
+    while (size != 0)
+    {
+        uint32_t in_block = (uint32_t) (offset % fs->block_size);
+        uint32_t chunk = fs->block_size - in_block;
+        if (chunk > size)
+            chunk = (uint32_t) size;
 
-    uint8_t* tmp = (uint8_t*) kmalloc(byte_count);
-    if (!tmp)
-        return false;
+        if (!BCache_read(fs->port, ext4_block_lba(fs, offset / fs->block_size), fs->block_size, in_block, dst, chunk))
+            return false;
 
-    if (AHCI_sata_read(fs->port, (uint32_t) start_lba, (uint32_t) (start_lba >> 32), sectors, tmp) != 0)
-    {
-        kfree(tmp);
-        return false;
+        dst += chunk;
+        offset += chunk;
+        size -= chunk;
     }
 
-    memcpy(out, tmp + (offset % AHCI_SECTOR_SIZE), size);
-    kfree(tmp);
     return true;
 }
 
+// Dirties the cached blocks only; ext4_sync sends them to the disk.
 static bool ext4_write_bytes(ext4_fs_t* fs, uint64_t offset, const void* data, size_t size)
 {
     if (!fs || !fs->port || (!data && size != 0))
         return false;
-    if (size == 0)
-        return true;
 
-    uint64_t start_lba = fs->lba_base + (offset / AHCI_SECTOR_SIZE);
-    uint64_t end_lba = fs->lba_base + ((offset + size + AHCI_SECTOR_SIZE - 1) / AHCI_SECTOR_SIZE);
-    if (end_lba <= start_lba || (end_lba - start_lba) > 0xFFFFFFFFULL)
-        return false;
-
-    uint32_t sectors = (uint32_t) (end_lba - start_lba);
-    size_t byte_count = (size_t) sectors * AHCI_SECTOR_SIZE;
-
-    uint8_t* tmp = (uint8_t*) kmalloc(byte_count);
-    if (!tmp)
-        return false;
-
-    if (AHCI_sata_read(fs->port, (uint32_t) start_lba, (uint32_t) (start_lba >> 32), sectors, tmp) != 0)
+    const uint8_t* src = (const uint8_t*) data;
+    while (size != 0)
     {
-        kfree(tmp);
-        return false;
-    }
+        uint32_t in_block = (uint32_t) (offset % fs->block_size);
+        uint32_t chunk = fs->block_size - in_block;
+        if (chunk > size)
+            chunk = (uint32_t) size;
 
-    memcpy(tmp + (offset % AHCI_SECTOR_SIZE), data, size);
+        if (!BCache_write(fs->port, ext4_block_lba(fs, offset / fs->block_size), fs->block_size, in_block, src, chunk))
+            return false;
 
-    if (AHCI_SATA_write(fs->port, (uint32_t) start_lba, (uint32_t) (start_lba >> 32), sectors, tmp) != 0)
-    {
-        kfree(tmp);
-        return false;
+        src += chunk;
+        offset += chunk;
+        size -= chunk;
     }
 
-    kfree(tmp);
     return true;
 }
 
+static bool ext4_sync(ext4_fs_t* fs)
+{
+    return BCache_sync(fs->port);
+}
+
 static bool ext4_read_block(ext4_fs_t* fs, uint32_t block, void* out)
 {
     return ext4_read_bytes(fs, (uint64_t) block * fs->block_size, out, fs->block_size);
@@ -125,19 +119,7 @@ static bool ext4_read_inode(ext4_fs_t* fs, uint32_t inode_num, ext4_inode_t* out
     uint64_t inode_table_block = gd.bg_inode_table_lo;
     uint64_t offset = inode_table_block * fs->block_size + (uint64_t) index * fs->inode_size;
 
-    uint8_t* tmp = (uint8_t*) kmalloc(fs->inode_size);
-    if (!tmp)
-        return false;
-
-    if (!ext4_read_bytes(fs, offset, tmp, fs->inode_size))
-    {
-        kfree(tmp);
-        return false;
-    }
-
-    memcpy(out, tmp, sizeof(*out));
-    kfree(tmp);
-    return true;
+    return ext4_read_bytes(fs, offset, out, sizeof(*out));
 }
 
 static bool ext4_write_inode(ext4_fs_t* fs, uint32_t inode_num, const ext4_inode_t* inode)
@@ -661,8 +643,14 @@ bool ext4_mount_lba(ext4_fs_t* fs, HBA_PORT_t* port, uint64_t lba_base)
     fs->port = port;
     fs->lba_base = lba_base;
 
-    if (!ext4_read_bytes(fs, EXT4_SUPERBLOCK_ADDR, &fs->superblock, sizeof(fs->superblock)))
+    // The block size is not known yet, so the superblock is read around the cache; anything
+    // still dirty there from an earlier mount of the same disk goes out first.
+    uint8_t buf[1024];
+    uint64_t sb_lba = lba_base + (EXT4_SUPERBLOCK_ADDR / AHCI_SECTOR_SIZE);
+    if (!BCache_sync(port) ||
+        AHCI_sata_read(port, (uint32_t) sb_lba, (uint32_t) (sb_lba >> 32), sizeof(buf) / AHCI_SECTOR_SIZE, buf) != 0)
         return false;
+    memcpy(&fs->superblock, buf, sizeof(fs->superblock));
     if (fs->superblock.s_magic != EXT4_MAGIC_SIGNATURE)
         return false;
 
@@ -847,6 +835,7 @@ bool ext4_read_file(ext4_fs_t* fs, const char* name, uint8_t** out_buf, size_t*
         return false;
     }
 
+    // Copied out of the block cache, so the tail needs no bounce block of its own.
     size_t read = 0;
     uint32_t block_index = 0;
     while (read < size)
@@ -864,17 +853,8 @@ bool ext4_read_file(ext4_fs_t* fs, const char* name, uint8_t** out_buf, size_t*
             continue;
         }
 
-        uint8_t* block = (uint8_t*) kmalloc(fs->block_size);
-        if (!block)
+        if (!ext4_read_bytes(fs, (uint64_t) phys * fs->block_size, buf + read, to_copy))
             break;
-        if (!ext4_read_block(fs, phys, block))
-        {
-            kfree(block);
-            break;
-        }
-
-        memcpy(buf + read, block, to_copy);
-        kfree(block);
 
         read += to_copy;
         block_index++;
@@ -892,7 +872,7 @@ bool ext4_read_file(ext4_fs_t* fs, const char* name, uint8_t** out_buf, size_t*
     return true;
 }
 
-bool ext4_create_file(ext4_fs_t* fs, const char* name, const uint8_t* data, size_t size)
+static bool ext4_create_file_impl(ext4_fs_t* fs, const char* name, const uint8_t* data, size_t size)
 {
     if (!fs || !name || name[0] == '\0')
         return false;
@@ -972,7 +952,7 @@ bool ext4_create_file(ext4_fs_t* fs, const char* name, const uint8_t* data, size
     return ext4_dir_insert_entry(fs, &parent, leaf, new_inode, EXT4_FT_REG_FILE);
 }
 
-bool ext4_create_dir(ext4_fs_t* fs, const char* path)
+static bool ext4_create_dir_impl(ext4_fs_t* fs, const char* path)
 {
     if (!fs || !path || path[0] == '\0')
         return false;
@@ -1057,3 +1037,20 @@ bool ext4_create_dir(ext4_fs_t* fs, const char* path)
     (void) ext4_write_inode(fs, parent_inode_num, &parent);
     return true;
 }
+
+/*
+ * The bitmaps, group descriptor and superblock are rewritten several times by one call:
+ * they meet in the cache and go out once here. With no journal, nothing is left dirty
+ * past the call that made the change.
+ */
+bool ext4_create_file(ext4_fs_t* fs, const char* name, const uint8_t* data, size_t size)
+{
+    bool ok = ext4_create_file_impl(fs, name, data, size);
+    return fs && ext4_sync(fs) && ok;
+}
+
+bool ext4_create_dir(ext4_fs_t* fs, const char* path)
+{
+    bool ok = ext4_create_dir_impl(fs, path);
+    return fs && ext4_sync(fs) && ok;
+}
@@ -1,7 +1,12 @@
 #include <Memory/KMem.h>
 #include <Memory/KMem_private.h>
 
+#include <Debug/KDebug.h>
 #include <Debug/Spinlock.h>
+#include <Memory/PMM.h>
+#include <Memory/Slab.h>
+#include <Memory/VMM.h>
+#include <Memory/VMalloc.h>
 
 #include <string.h>
 #include <stdint.h>
@@ -14,9 +19,9 @@ static size_t kmem_align(size_t size)
     return (size + (alignment - 1)) & ~(alignment - 1);
 }
 
-static uint8_t* kmem_heap_end(void)
+static uint8_t* kmem_arena_end(const kmem_arena_t* arena)
 {
-    return (uint8_t*) KMEM_state.heap_start + KMEM_state.heap_size;
+    return (uint8_t*) arena->start + arena->size;
 }
 
 static malloc_header_t* kmem_next_header(malloc_header_t* header)
@@ -24,45 +29,159 @@ static malloc_header_t* kmem_next_header(malloc_header_t* header)
     return (malloc_header_t*) ((uint8_t*) header + sizeof (malloc_header_t) + header->size);
 }
 
-static int kmem_header_is_valid(malloc_header_t* header)
+static int kmem_header_is_valid(const kmem_arena_t* arena, malloc_header_t* header)
 {
-    return (uint8_t*) header + sizeof (malloc_header_t) <= kmem_heap_end();
+    return (uint8_t*) header + sizeof (malloc_header_t) <= kmem_arena_end(arena);
 }
 
-void kmem_init(uint64_t heap_start, size_t heap_size)
+// A used block is only resized by its owner, so this needs no lock.
+static size_t kmem_block_size(const void* ptr)
 {
-    spinlock_init(&KMEM_state.lock);
-    KMEM_state.lock_ready = true;
+    return ((const malloc_header_t*) ((const uint8_t*) ptr - sizeof (malloc_header_t)))->size;
+}
 
-    KMEM_state.heap_start = (void*) heap_start;
-    KMEM_state.heap_size = kmem_align(heap_size);
+// Caller holds the heap lock: arenas come and go under it.
+static kmem_arena_t* kmem_arena_of(const void* ptr)
+{
+    for (uint32_t i = 0; i < KMEM_state.arena_count; i++)
+    {
+        kmem_arena_t* arena = &KMEM_state.arenas[i];
+        if (arena->start && (const uint8_t*) ptr >= (const uint8_t*) arena->start &&
+            (const uint8_t*) ptr < kmem_arena_end(arena))
+            return arena;
+    }
 
-    if (KMEM_state.heap_size <= sizeof (malloc_header_t))
+    return NULL;
+}
+
+static bool kmem_arena_add(void* start, size_t size, uint32_t order, bool boot)
+{
+    kmem_arena_t* arena = NULL;
+    for (uint32_t i = 0; i < KMEM_state.arena_count && !arena; i++)
     {
-        KMEM_state.heap_start = NULL;
-        KMEM_state.heap_size = 0;
-        return;
+        if (!KMEM_state.arenas[i].start)
+            arena = &KMEM_state.arenas[i];
+    }
+    if (!arena)
+    {
+        if (KMEM_state.arena_count >= KMEM_ARENA_MAX)
+            return false;
+        arena = &KMEM_state.arenas[KMEM_state.arena_count++];
     }
 
-    malloc_header_t* first_malloc_header = (malloc_header_t*) KMEM_state.heap_start;
+    malloc_header_t* first_malloc_header = (malloc_header_t*) start;
     first_malloc_header->state = MEM_STATE_AVAILABLE;
-    first_malloc_header->size = KMEM_state.heap_size - sizeof (malloc_header_t);
+    first_malloc_header->size = size - sizeof (malloc_header_t);
     first_malloc_header->prev_malloc_header = NULL;
+
+    arena->start = start;
+    arena->size = size;
+    arena->order = order;
+    arena->boot = boot;
+    if (!boot)
+        KMEM_state.arenas_grown++;
+    return true;
+}
+
+static bool kmem_arena_is_empty(const kmem_arena_t* arena)
+{
+    const malloc_header_t* first = (const malloc_header_t*) arena->start;
+    return first->state == MEM_STATE_AVAILABLE && first->size == arena->size - sizeof (malloc_header_t);
+}
+
+/*
+ * The boot arena is all there is until the PMM has free lists; after that the heap grows
+ * by one buddy block per arena, and every larger request goes to vmalloc.
+ */
+void kmem_init(uint64_t heap_start, size_t heap_size)
+{
+    spinlock_init(&KMEM_state.lock);
+#if THEOS_KMEM_TRACK
+    spinlock_init(&KMEM_state.track_lock);
+#endif
+
+    heap_size = kmem_align(heap_size);
+    if (heap_size <= sizeof (malloc_header_t))
+        return;
+
+    kmem_arena_add((void*) heap_start, heap_size, 0, true);
+
+    kmem_slab_init();
 }
 
 void* kmalloc(size_t size)
+{
+    return kmalloc_site(size, (uintptr_t) __builtin_return_address(0));
+}
+
+// `site` is the caller kmalloc is charged to when allocations are tracked.
+static void* kmalloc_site(size_t size, uintptr_t site)
 {
     if (size == 0)
         return (void*) NULL;
-    if (!KMEM_state.heap_start || KMEM_state.heap_size <= sizeof (malloc_header_t))
+    if (KMEM_state.arena_count == 0)
         return (void*) NULL;
 
-    if (!KMEM_state.lock_ready)
-        return kmalloc_nolock(size);
+    // Small requests come from the slab size classes; the heap backs them until the PMM has pages.
+    void* slab_ptr = kmem_slab_alloc_size(size);
+    if (slab_ptr)
+    {
+        kmem_note_alloc(slab_ptr, kmem_slab_object_size(slab_ptr), site);
+        return slab_ptr;
+    }
+
+    // Whole files and frame buffers need no physically contiguous block: map pages instead.
+    if (size > KMEM_VMALLOC_THRESHOLD)
+    {
+        void* vmalloc_ptr = vmalloc(size);
+        if (vmalloc_ptr)
+        {
+            kmem_note_alloc(vmalloc_ptr, size, site);
+            return vmalloc_ptr;
+        }
+    }
 
     uint64_t flags = spin_lock_irqsave(&KMEM_state.lock);
     void* ptr = kmalloc_nolock(size);
     spin_unlock_irqrestore(&KMEM_state.lock, flags);
+    if (!ptr)
+        ptr = kmalloc_grow(size);
+    if (!ptr)
+    {
+        kmem_note_failure(size);
+        return NULL;
+    }
+
+    kmem_note_alloc(ptr, kmem_block_size(ptr), site);
+    return ptr;
+}
+
+// Every arena is full: take a new one from the PMM, outside the heap lock.
+static void* kmalloc_grow(size_t size)
+{
+    size_t needed = kmem_align(size) + sizeof (malloc_header_t);
+    uint32_t order = KMEM_ARENA_ORDER;
+    while (order < KMEM_ARENA_MAX_ORDER && ((size_t) PHYS_PAGE_SIZE << order) < needed)
+        order++;
+    if (((size_t) PHYS_PAGE_SIZE << order) < needed)
+        return NULL;
+
+    void* block = PMM_alloc_pages(order);
+    if (!block)
+        return NULL;
+
+    uint64_t flags = spin_lock_irqsave(&KMEM_state.lock);
+    void* ptr = kmalloc_nolock(size);           // Another CPU may have grown the heap meanwhile.
+    bool added = false;
+    if (!ptr && kmem_arena_add((void*) P2V(block), (size_t) PHYS_PAGE_SIZE << order, order, false))
+    {
+        added = true;
+        ptr = kmalloc_nolock(size);
+    }
+    spin_unlock_irqrestore(&KMEM_state.lock, flags);
+
+    if (!added)
+        PMM_free_pages(block, order);
     return ptr;
 }
 
@@ -70,8 +189,24 @@ static void* kmalloc_nolock(size_t size)
 {
     size = kmem_align(size);
 
-    malloc_header_t* malloc_header = (malloc_header_t*) KMEM_state.heap_start;
-    while (kmem_header_is_valid(malloc_header))
+    for (uint32_t i = 0; i < KMEM_state.arena_count; i++)
+    {
+        kmem_arena_t* arena = &KMEM_state.arenas[i];
+        if (!arena->start || arena->size < size + sizeof (malloc_header_t))
+            continue;
+
+        void* ptr = kmem_arena_alloc(arena, size);
+        if (ptr)
+            return ptr;
+    }
+
+    return (void*) NULL;
+}
+
+static void* kmem_arena_alloc(kmem_arena_t* arena, size_t size)
+{
+    malloc_header_t* malloc_header = (malloc_header_t*) arena->start;
+    while (kmem_header_is_valid(arena, malloc_header))
     {
         if (malloc_header->state == MEM_STATE_AVAILABLE && malloc_header->size >= size)
         {
@@ -85,18 +220,20 @@ static void* kmalloc_nolock(size_t size)
                 new_bottom_malloc->prev_malloc_header = malloc_header;
 
                 malloc_header_t* next = kmem_next_header(new_bottom_malloc);
-                if (kmem_header_is_valid(next))
+                if (kmem_header_is_valid(arena, next))
                     next->prev_malloc_header = new_bottom_malloc;
 
                 malloc_header->size = size;
             }
 
             malloc_header->state = MEM_STATE_USED;
+            KMEM_state.heap_used += malloc_header->size;
+            KMEM_state.heap_used_blocks++;
             return (void*) ((uint8_t*) malloc_header + sizeof (malloc_header_t));
         }
 
         malloc_header_t* next = kmem_next_header(malloc_header);
-        if (!kmem_header_is_valid(next))
+        if (!kmem_header_is_valid(arena, next))
             break;
         malloc_header = next;
     }
@@ -106,49 +243,39 @@ static void* kmalloc_nolock(size_t size)
 
 void* krealloc(void* ptr, size_t new_size)
 {
+    uintptr_t site = (uintptr_t) __builtin_return_address(0);
     if (!ptr)
-        return kmalloc(new_size);
+        return kmalloc_site(new_size, site);
     if (new_size == 0)
     {
         kfree(ptr);
         return NULL;
     }
 
-    if (!KMEM_state.lock_ready)
+    size_t old_size = 0;
+    if (vmalloc_owns(ptr))
+        old_size = vmalloc_size(ptr);
+    else
     {
-        malloc_header_t* malloc_header = (malloc_header_t*) ((uint8_t*) ptr - sizeof (malloc_header_t));
-        if (malloc_header->size >= new_size)
-            return ptr;
-
-        void* new_ptr = kmalloc_nolock(new_size);
-        if (!new_ptr)
-            return NULL;
+        uint64_t flags = spin_lock_irqsave(&KMEM_state.lock);
+        bool in_heap = kmem_arena_of(ptr) != NULL;
+        if (in_heap)
+            old_size = ((malloc_header_t*) ((uint8_t*) ptr - sizeof (malloc_header_t)))->size;
+        spin_unlock_irqrestore(&KMEM_state.lock, flags);
 
-        memcpy(new_ptr, ptr, malloc_header->size);
-        kfree_nolock(ptr);
-        return new_ptr;
+        if (!in_heap)
+            old_size = kmem_slab_object_size(ptr);
     }
 
-    uint64_t flags = spin_lock_irqsave(&KMEM_state.lock);
-
-    malloc_header_t* malloc_header = (malloc_header_t*) ((uint8_t*) ptr - sizeof (malloc_header_t));
-    if (malloc_header->size >= new_size)
-    {
-        spin_unlock_irqrestore(&KMEM_state.lock, flags);
+    if (old_size >= new_size)
         return ptr;
-    }
 
-    void* new_ptr = kmalloc_nolock(new_size);
+    void* new_ptr = kmalloc_site(new_size, site);
     if (!new_ptr)
-    {
-        spin_unlock_irqrestore(&KMEM_state.lock, flags);
         return NULL;
-    }
-
-    memcpy(new_ptr, ptr, malloc_header->size);
-    kfree_nolock(ptr);
-    spin_unlock_irqrestore(&KMEM_state.lock, flags);
 
+    memcpy(new_ptr, ptr, old_size);
+    kfree(ptr);
     return new_ptr;
 }
 
@@ -157,28 +284,73 @@ void kfree(void* ptr)
     if (!ptr)
         return;
 
-    if (!KMEM_state.lock_ready)
+    // Accounted before the memory goes back, so a racing kmalloc of the same address is not undone.
+    if (vmalloc_owns(ptr))
     {
-        kfree_nolock(ptr);
+        size_t bytes = vmalloc_size(ptr);
+        if (bytes)
+            kmem_note_free(ptr, bytes);
+        vfree(ptr);
         return;
     }
 
     uint64_t flags = spin_lock_irqsave(&KMEM_state.lock);
-    kfree_nolock(ptr);
+    kmem_arena_t* arena = kmem_arena_of(ptr);
+    if (!arena)
+    {
+        spin_unlock_irqrestore(&KMEM_state.lock, flags);
+        size_t bytes = kmem_slab_object_size(ptr);
+        if (bytes)
+            kmem_note_free(ptr, bytes);
+        kmem_slab_free(ptr);
+        return;
+    }
+
+    size_t bytes = kfree_nolock(arena, ptr);
+    if (bytes)
+        kmem_note_free(ptr, bytes);
+
+    // Keep one empty grown arena around; any further one goes back to the PMM.
+    void* release = NULL;
+    uint32_t release_order = 0;
+    if (!arena->boot && kmem_arena_is_empty(arena))
+    {
+        for (uint32_t i = 0; i < KMEM_state.arena_count; i++)
+        {
+            kmem_arena_t* other = &KMEM_state.arenas[i];
+            if (other != arena && other->start && !other->boot && kmem_arena_is_empty(other))
+            {
+                release = arena->start;
+                release_order = arena->order;
+                arena->start = NULL;
+                arena->size = 0;
+                KMEM_state.arenas_released++;
+                break;
+            }
+        }
+    }
     spin_unlock_irqrestore(&KMEM_state.lock, flags);
+
+    if (release)
+        PMM_free_pages((void*) V2P(release), release_order);
 }
 
-static void kfree_nolock(void* ptr)
+// Returns the size of the block released, 0 for a double free.
+static size_t kfree_nolock(kmem_arena_t* arena, void* ptr)
 {
     malloc_header_t* malloc_header = (malloc_header_t*) ((uint8_t*) ptr - sizeof (malloc_header_t));
-    
+
     if (malloc_header->state == MEM_STATE_AVAILABLE)
-        return;
+        return 0;
+
+    size_t bytes = malloc_header->size;
+    KMEM_state.heap_used -= bytes;
+    KMEM_state.heap_used_blocks--;
 
     malloc_header_t* prev_malloc_header = malloc_header->prev_malloc_header;
     malloc_header_t* next_malloc_header = kmem_next_header(malloc_header);
 
-    if (kmem_header_is_valid(next_malloc_header) && next_malloc_header->state == MEM_STATE_AVAILABLE)
+    if (kmem_header_is_valid(arena, next_malloc_header) && next_malloc_header->state == MEM_STATE_AVAILABLE)
         malloc_header->size += next_malloc_header->size + sizeof (malloc_header_t);
 
     if (prev_malloc_header != NULL && prev_malloc_header->state == MEM_STATE_AVAILABLE)
@@ -188,8 +360,282 @@ static void kfree_nolock(void* ptr)
     }
 
     malloc_header_t* next = kmem_next_header(malloc_header);
-    if (kmem_header_is_valid(next))
+    if (kmem_header_is_valid(arena, next))
         next->prev_malloc_header = malloc_header;
 
     malloc_header->state = MEM_STATE_AVAILABLE;
+    return bytes;
+}
+
+static void kmem_note_alloc(void* ptr, size_t bytes, uintptr_t site)
+{
+    __atomic_add_fetch(&KMEM_state.allocs, 1, __ATOMIC_RELAXED);
+    uint64_t now = __atomic_add_fetch(&KMEM_state.bytes_in_use, bytes, __ATOMIC_RELAXED);
+    uint64_t peak = __atomic_load_n(&KMEM_state.bytes_peak, __ATOMIC_RELAXED);
+    while (now > peak &&
+           !__atomic_compare_exchange_n(&KMEM_state.bytes_peak, &peak, now, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+
+#if THEOS_KMEM_TRACK
+    kmem_track_insert(ptr, bytes, site);
+#else
+    (void) ptr;
+    (void) site;
+#endif
+}
+
+static void kmem_note_free(void* ptr, size_t bytes)
+{
+    __atomic_add_fetch(&KMEM_state.frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&KMEM_state.bytes_in_use, bytes, __ATOMIC_RELAXED);
+
+#if THEOS_KMEM_TRACK
+    kmem_track_remove(ptr, bytes);
+#else
+    (void) ptr;
+#endif
+}
+
+/*
+ * A failed kmalloc is usually fragmentation seen from far away: log the heap as it is now,
+ * on the 1st, 2nd, 4th, 8th... failure so a caller retrying in a loop cannot flood the log.
+ */
+static void kmem_note_failure(size_t size)
+{
+    uint64_t failures = __atomic_add_fetch(&KMEM_state.failures, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&KMEM_state.last_failure_size, size, __ATOMIC_RELAXED);
+    if ((failures & (failures - 1U)) != 0)
+        return;
+    if (__atomic_exchange_n(&KMEM_state.dumping, true, __ATOMIC_ACQUIRE))
+        return;
+
+    kdebug_printf("[KMEM] kmalloc(%llu) failed, failure #%llu\n",
+                  (unsigned long long) size, (unsigned long long) failures);
+    kmem_dump(KMEM_DUMP_SITES);
+    __atomic_store_n(&KMEM_state.dumping, false, __ATOMIC_RELEASE);
+}
+
+#if THEOS_KMEM_TRACK
+// sites[] is an open-addressed set keyed by return address that never shrinks.
+static uint32_t kmem_site_index_locked(uintptr_t site)
+{
+    uint32_t index = (uint32_t) (((uint64_t) site * 0x9E3779B97F4A7C15ULL) >> 32) & (KMEM_SITE_MAX - 1U);
+    for (uint32_t probe = 0; probe < KMEM_SITE_MAX; probe++)
+    {
+        KMEM_site_stats_t* entry = &KMEM_state.sites[index];
+        if (entry->site == site)
+            return index;
+        if (entry->site == 0)
+        {
+            entry->site = site;
+            KMEM_state.site_count++;
+            return index;
+        }
+        index = (index + 1U) & (KMEM_SITE_MAX - 1U);
+    }
+
+    return KMEM_SITE_MAX;
+}
+
+static uint32_t kmem_track_hash(const void* ptr)
+{
+    return (uint32_t) (((uint64_t) (uintptr_t) ptr * 0x9E3779B97F4A7C15ULL) >> 32) & (KMEM_TRACK_SLOTS - 1U);
+}
+
+static void kmem_track_insert(void* ptr, size_t bytes, uintptr_t site)
+{
+    uint64_t flags = spin_lock_irqsave(&KMEM_state.track_lock);
+    uint32_t index = kmem_site_index_locked(site);
+    uint32_t slot = kmem_track_hash(ptr);
+    uint32_t probe = 0;
+    while (probe < KMEM_TRACK_SLOTS && KMEM_state.track[slot].ptr)
+    {
+        slot = (slot + 1U) & (KMEM_TRACK_SLOTS - 1U);
+        probe++;
+    }
+
+    // Keep one slot empty so lookups always terminate.
+    if (index == KMEM_SITE_MAX || probe >= KMEM_TRACK_SLOTS - 1U)
+    {
+        KMEM_state.untracked++;
+        spin_unlock_irqrestore(&KMEM_state.track_lock, flags);
+        return;
+    }
+
+    KMEM_state.track[slot].ptr = ptr;
+    KMEM_state.track[slot].site = index;
+
+    KMEM_site_stats_t* entry = &KMEM_state.sites[index];
+    entry->allocs++;
+    entry->live_count++;
+    entry->live_bytes += bytes;
+    if (entry->live_bytes > entry->peak_bytes)
+        entry->peak_bytes = entry->live_bytes;
+    spin_unlock_irqrestore(&KMEM_state.track_lock, flags);
+}
+
+// Linear probing with backward-shift deletion: no tombstones to slow lookups down over time.
+static void kmem_track_remove(void* ptr, size_t bytes)
+{
+    uint64_t flags = spin_lock_irqsave(&KMEM_state.track_lock);
+    uint32_t slot = kmem_track_hash(ptr);
+    while (KMEM_state.track[slot].ptr && KMEM_state.track[slot].ptr != ptr)
+        slot = (slot + 1U) & (KMEM_TRACK_SLOTS - 1U);
+
+    if (!KMEM_state.track[slot].ptr)
+    {
+        spin_unlock_irqrestore(&KMEM_state.track_lock, flags);
+        return;                                 // Allocated before the tracker had room.
+    }
+
+    KMEM_site_stats_t* entry = &KMEM_state.sites[KMEM_state.track[slot].site];
+    entry->frees++;
+    entry->live_count--;
+    entry->live_bytes -= bytes;
+
+    uint32_t hole = slot;
+    uint32_t next = (slot + 1U) & (KMEM_TRACK_SLOTS - 1U);
+    while (KMEM_state.track[next].ptr)
+    {
+        uint32_t home = kmem_track_hash(KMEM_state.track[next].ptr);
+        // Move the entry back unless its home lies cyclically in (hole, next].
+        if (((next - home) & (KMEM_TRACK_SLOTS - 1U)) >= ((next - hole) & (KMEM_TRACK_SLOTS - 1U)))
+        {
+            KMEM_state.track[hole] = KMEM_state.track[next];
+            hole = next;
+        }
+        next = (next + 1U) & (KMEM_TRACK_SLOTS - 1U);
+    }
+    KMEM_state.track[hole].ptr = NULL;
+    spin_unlock_irqrestore(&KMEM_state.track_lock, flags);
+}
+#endif
+
+/*
+ * The heap keeps no separate free list: free blocks are found by walking the headers, so
+ * the free-list figures are computed here rather than maintained on every call.
+ */
+void kmem_get_stats(KMEM_stats_t* out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof (*out));
+
+    uint64_t flags = spin_lock_irqsave(&KMEM_state.lock);
+    for (uint32_t i = 0; i < KMEM_state.arena_count; i++)
+    {
+        kmem_arena_t* arena = &KMEM_state.arenas[i];
+        if (!arena->start)
+            continue;
+
+        out->arenas++;
+        out->heap_size += arena->size;
+        malloc_header_t* header = (malloc_header_t*) arena->start;
+        while (kmem_header_is_valid(arena, header))
+        {
+            if (header->state == MEM_STATE_AVAILABLE)
+            {
+                out->heap_free += header->size;
+                out->heap_free_blocks++;
+                if (header->size > out->heap_largest_free)
+                    out->heap_largest_free = header->size;
+            }
+            header = kmem_next_header(header);
+        }
+    }
+    out->heap_used = KMEM_state.heap_used;
+    out->heap_used_blocks = KMEM_state.heap_used_blocks;
+    out->arenas_grown = KMEM_state.arenas_grown;
+    out->arenas_released = KMEM_state.arenas_released;
+    spin_unlock_irqrestore(&KMEM_state.lock, flags);
+
+    out->bytes_in_use = __atomic_load_n(&KMEM_state.bytes_in_use, __ATOMIC_RELAXED);
+    out->bytes_peak = __atomic_load_n(&KMEM_state.bytes_peak, __ATOMIC_RELAXED);
+    out->allocs = __atomic_load_n(&KMEM_state.allocs, __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&KMEM_state.frees, __ATOMIC_RELAXED);
+    out->failures = __atomic_load_n(&KMEM_state.failures, __ATOMIC_RELAXED);
+    out->last_failure_size = __atomic_load_n(&KMEM_state.last_failure_size, __ATOMIC_RELAXED);
+
+#if THEOS_KMEM_TRACK
+    flags = spin_lock_irqsave(&KMEM_state.track_lock);
+    out->site_count = KMEM_state.site_count;
+    out->untracked = KMEM_state.untracked;
+    spin_unlock_irqrestore(&KMEM_state.track_lock, flags);
+#endif
+}
+
+// The `max` callers holding the most live bytes, largest first. Always 0 without THEOS_KMEM_TRACK.
+uint32_t kmem_get_sites(KMEM_site_stats_t* out, uint32_t max)
+{
+#if THEOS_KMEM_TRACK
+    if (!out || max == 0)
+        return 0;
+
+    uint32_t count = 0;
+    uint64_t flags = spin_lock_irqsave(&KMEM_state.track_lock);
+    for (uint32_t i = 0; i < KMEM_SITE_MAX; i++)
+    {
+        const KMEM_site_stats_t* entry = &KMEM_state.sites[i];
+        if (entry->site == 0)
+            continue;
+
+        uint32_t pos = count;
+        while (pos > 0 && out[pos - 1U].live_bytes < entry->live_bytes)
+        {
+            if (pos < max)
+                out[pos] = out[pos - 1U];
+            pos--;
+        }
+        if (pos < max)
+        {
+            out[pos] = *entry;
+            if (count < max)
+                count++;
+        }
+    }
+    spin_unlock_irqrestore(&KMEM_state.track_lock, flags);
+    return count;
+#else
+    (void) out;
+    (void) max;
+    return 0;
+#endif
+}
+
+void kmem_dump(uint32_t max_sites)
+{
+    KMEM_stats_t stats;
+    kmem_get_stats(&stats);
+
+    kdebug_printf("[KMEM] in use=%llu peak=%llu allocs=%llu frees=%llu failures=%llu last_failed=%llu\n",
+                  (unsigned long long) stats.bytes_in_use, (unsigned long long) stats.bytes_peak,
+                  (unsigned long long) stats.allocs, (unsigned long long) stats.frees,
+                  (unsigned long long) stats.failures, (unsigned long long) stats.last_failure_size);
+    kdebug_printf("[KMEM] heap arenas=%u size=%llu used=%llu/%llu blocks free=%llu/%llu blocks largest=%llu\n",
+                  stats.arenas, (unsigned long long) stats.heap_size,
+                  (unsigned long long) stats.heap_used, (unsigned long long) stats.heap_used_blocks,
+                  (unsigned long long) stats.heap_free, (unsigned long long) stats.heap_free_blocks,
+                  (unsigned long long) stats.heap_largest_free);
+
+#if THEOS_KMEM_TRACK
+    KMEM_site_stats_t sites[KMEM_DUMP_SITES];
+    if (max_sites > KMEM_DUMP_SITES)
+        max_sites = KMEM_DUMP_SITES;
+
+    uint32_t count = kmem_get_sites(sites, max_sites);
+    kdebug_printf("[KMEM] sites=%u untracked=%llu\n", stats.site_count, (unsigned long long) stats.untracked);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        kdebug_printf("[KMEM]   site=0x%llX live=%llu/%llu peak=%llu allocs=%llu frees=%llu\n",
+                      (unsigned long long) sites[i].site,
+                      (unsigned long long) sites[i].live_bytes, (unsigned long long) sites[i].live_count,
+                      (unsigned long long) sites[i].peak_bytes,
+                      (unsigned long long) sites[i].allocs, (unsigned long long) sites[i].frees);
+    }
+#else
+    (void) max_sites;
+#endif
 }
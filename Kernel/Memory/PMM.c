@@ -1,7 +1,10 @@
 #include <Memory/PMM.h>
 
+#include <CPU/NUMA.h>
+#include <Debug/KDebug.h>
 #include <Memory/KMem.h>
 #include <Memory/VMM.h>
+#include <Task/Task.h>
 
 #include <stdbool.h>
 #include <limits.h>
@@ -12,6 +15,10 @@
 
 static PMM_runtime_state_t PMM_state;
 
+_Static_assert(PMM_MAX_NODES == NUMA_MAX_NODES, "PMM node pools must cover every NUMA node");
+_Static_assert(sizeof(PMM_page_t) == 8, "page descriptors must stay 8 bytes");
+_Static_assert(PMM_MAX_NODES <= 256U, "page descriptors store the node in a byte");
+
 void PMM_init(uintptr_t kernel_phys_start,
               uintptr_t kernel_phys_end,
               uintptr_t kernel_virt_start,
@@ -21,6 +28,10 @@ void PMM_init(uintptr_t kernel_phys_start,
     PMM_state.kernel_phys_end = kernel_phys_end;
     PMM_state.kernel_virt_start = kernel_virt_start;
     PMM_state.kernel_virt_end = kernel_virt_end;
+
+    // One node holding everything until PMM_numa_init knows better.
+    PMM_state.stats.node_count = 1;
+    PMM_state.node_fallback[0][0] = 0;
 }
 
 uintptr_t PMM_get_kernel_start(void)
@@ -120,13 +131,14 @@ bool PMM_promote_boot_entries_to_allocatable(uint64_t type,
 
         uintptr_t len = entry->addr_end - entry->addr_start;
         int regions_before = PMM_state.num_regions;
+        uint64_t pages_before = PMM_state.stats.total_pages;
         PMM_init_region(entry->addr_start, len);
         if (PMM_state.num_regions <= regions_before)
             continue;
         entry->flags |= PMM_BOOT_ENTRY_ALLOCATABLE;
 
         regions_added++;
-        pages_added += (uint64_t) (PMM_state.regions[PMM_state.num_regions - 1].len / PHYS_PAGE_SIZE);
+        pages_added += PMM_state.stats.total_pages - pages_before;
     }
 
     if (regions_added_out)
@@ -137,10 +149,182 @@ bool PMM_promote_boot_entries_to_allocatable(uint64_t type,
     return regions_added != 0;
 }
 
+static inline uint8_t* PMM_page_map(const PMM_region_t* region)
+{
+    return (uint8_t*) P2V(region->addr_mmap_start);
+}
+
+static inline PMM_page_t* PMM_page_descs(const PMM_region_t* region)
+{
+    return (PMM_page_t*) P2V(region->addr_pages_start);
+}
+
+// A frame leaves the allocator with no owners or flags recorded, whatever it went back with.
+static void PMM_page_reset(PMM_page_t* page, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        page[i].refcount = 0;
+        page[i].mapcount = 0;
+        page[i].flags = 0;
+    }
+}
+
+static inline PMM_free_block_t* PMM_block_at(const PMM_region_t* region, uint64_t index)
+{
+    return (PMM_free_block_t*) P2V((region->first_pfn + index) * PHYS_PAGE_SIZE);
+}
+
+static void PMM_push_free_locked(uint32_t region_index, uint64_t index, uint32_t order)
+{
+    PMM_region_t* region = &PMM_state.regions[region_index];
+    PMM_page_map(region)[index] = (uint8_t) (PMM_PAGE_FREE_HEAD | order);
+
+    PMM_free_block_t* block = PMM_block_at(region, index);
+    PMM_free_block_t** list = &PMM_state.free_lists[region->node][order];
+    PMM_free_block_t* head = *list;
+    block->region_index = region_index;
+    block->order = order;
+    block->prev = NULL;
+    block->next = head;
+    if (head)
+        head->prev = block;
+    *list = block;
+    PMM_state.stats.free_blocks[order]++;
+}
+
+static void PMM_remove_free_locked(PMM_free_block_t* block)
+{
+    PMM_region_t* region = &PMM_state.regions[block->region_index];
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        PMM_state.free_lists[region->node][block->order] = block->next;
+    if (block->next)
+        block->next->prev = block->prev;
+
+    uint64_t index = (V2P(block) / PHYS_PAGE_SIZE) - region->first_pfn;
+    PMM_page_map(region)[index] = PMM_PAGE_IN_BLOCK;
+    PMM_state.stats.free_blocks[block->order]--;
+}
+
+// Hand a run of pages to the buddy lists as the largest naturally aligned blocks it holds.
+static void PMM_release_run_locked(uint32_t region_index, uint64_t index, uint64_t count)
+{
+    PMM_region_t* region = &PMM_state.regions[region_index];
+    while (count != 0)
+    {
+        uint64_t pfn = region->first_pfn + index;
+        uint32_t order = 0;
+        while (order < PMM_MAX_ORDER &&
+               (pfn & ((1ULL << (order + 1U)) - 1U)) == 0 &&
+               (1ULL << (order + 1U)) <= count)
+            order++;
+
+        uint64_t pages = 1ULL << order;
+        memset(PMM_page_map(region) + index, PMM_PAGE_IN_BLOCK, (size_t) pages);
+        PMM_push_free_locked(region_index, index, order);
+        PMM_state.stats.free_pages += pages;
+        PMM_state.stats.nodes[region->node].free_pages += pages;
+        index += pages;
+        count -= pages;
+    }
+}
+
+/*
+ * Node index of a page frame, and the first frame past the span that shares it. Memory the
+ * SRAT does not describe goes to node 0.
+ */
+static uint32_t PMM_pfn_node(uint64_t pfn, uint64_t* span_end_pfn)
+{
+    uint32_t node = 0;
+    uint64_t span_end = UINT64_MAX;
+    uint32_t range_count = PMM_state.numa_ready ? NUMA_get_memory_range_count() : 0;
+    for (uint32_t i = 0; i < range_count; i++)
+    {
+        const NUMA_memory_range_t* range = NUMA_get_memory_range(i);
+        uint64_t first = (range->base + (PHYS_PAGE_SIZE - 1U)) / PHYS_PAGE_SIZE;
+        uint64_t end = (range->base + range->length) / PHYS_PAGE_SIZE;
+        if (pfn >= first && pfn < end)
+        {
+            uint32_t index = NUMA_get_node_index(range->node_id);
+            if (index < PMM_state.stats.node_count)
+                node = index;
+            span_end = end;
+            break;
+        }
+
+        if (first > pfn && first < span_end)
+            span_end = first;
+    }
+
+    *span_end_pfn = span_end;
+    return node;
+}
+
+/*
+ * Append a region to the table, cut at node boundaries, and give its free pages (those
+ * still marked as inside a block) to the buddy lists of their node.
+ */
+static void PMM_add_region_locked(const PMM_region_t* region)
+{
+    uint64_t pfn = region->first_pfn;
+    uint64_t end_pfn = region->first_pfn + region->page_count;
+    while (pfn < end_pfn)
+    {
+        uint64_t span_end = 0;
+        uint32_t node = PMM_pfn_node(pfn, &span_end);
+        if (span_end > end_pfn)
+            span_end = end_pfn;
+
+        if (PMM_state.num_regions >= PMM_MAX_REGIONS)
+            panic("PMM: too many memory regions");
+
+        uint32_t region_index = (uint32_t) PMM_state.num_regions;
+        PMM_region_t* part = &PMM_state.regions[region_index];
+        part->addr_start = pfn * PHYS_PAGE_SIZE;
+        part->addr_end = span_end * PHYS_PAGE_SIZE;
+        part->addr_mmap_start = region->addr_mmap_start + (pfn - region->first_pfn);
+        part->addr_pages_start = region->addr_pages_start + ((pfn - region->first_pfn) * sizeof(PMM_page_t));
+        part->len = part->addr_end - part->addr_start;
+        part->first_pfn = pfn;
+        part->page_count = span_end - pfn;
+        part->node = node;
+        // Per-CPU cache frees look regions up without the lock: publish the entry before the count.
+        __atomic_store_n(&PMM_state.num_regions, PMM_state.num_regions + 1, __ATOMIC_RELEASE);
+
+        const uint8_t* map = PMM_page_map(part);
+        PMM_page_t* pages = PMM_page_descs(part);
+        uint64_t run_start = 0;
+        uint64_t run_len = 0;
+        for (uint64_t index = 0; index <= part->page_count; index++)
+        {
+            if (index < part->page_count)
+                pages[index].node = (uint8_t) node;
+            if (index < part->page_count && map[index] != PMM_PAGE_RESERVED)
+                PMM_state.stats.nodes[node].total_pages++;
+
+            if (index < part->page_count && map[index] == PMM_PAGE_IN_BLOCK)
+            {
+                if (run_len == 0)
+                    run_start = index;
+                run_len++;
+                continue;
+            }
+
+            if (run_len != 0)
+                PMM_release_run_locked(region_index, run_start, run_len);
+            run_len = 0;
+        }
+
+        pfn = span_end;
+    }
+}
+
 void PMM_init_region(uintptr_t addr, uintptr_t len)
 {
-    uintptr_t region_start = addr;
-    uintptr_t region_end = addr + len;
+    uintptr_t region_start = (addr + (PHYS_PAGE_SIZE - 1U)) & ~(uintptr_t) (PHYS_PAGE_SIZE - 1U);
+    uintptr_t region_end = (addr + len) & ~(uintptr_t) (PHYS_PAGE_SIZE - 1U);
 
     // Never manage legacy low memory (IVT/BIOS/EBDA/etc.) with PMM/KMEM.
     if (region_end <= 0x100000)
@@ -154,16 +338,23 @@ void PMM_init_region(uintptr_t addr, uintptr_t len)
     region.addr_start = region_start;
     region.addr_end = region_end;
     region.addr_mmap_start = (uintptr_t) -1;
+    region.addr_pages_start = 0;
     region.len = region_end - region_start;
+    region.first_pfn = region_start / PHYS_PAGE_SIZE;
+    region.page_count = region.len / PHYS_PAGE_SIZE;
+    region.node = 0;
 
-    size_t num_pages = region.len / PHYS_PAGE_SIZE;
-    size_t bitmap_words = (num_pages + ((sizeof(uint64_t) * 8U) - 1U)) / (sizeof(uint64_t) * 8U);
-    size_t bitmap_bytes = bitmap_words * sizeof(uint64_t);
-    size_t mmap_num_pages = (bitmap_bytes + (PHYS_PAGE_SIZE - 1U)) / PHYS_PAGE_SIZE;
+    size_t num_pages = (size_t) region.page_count;
+    size_t mmap_num_pages = (num_pages + (PHYS_PAGE_SIZE - 1U)) / PHYS_PAGE_SIZE;
     if (mmap_num_pages == 0)
         mmap_num_pages = 1;
+    size_t desc_num_pages = ((num_pages * sizeof(PMM_page_t)) + (PHYS_PAGE_SIZE - 1U)) / PHYS_PAGE_SIZE;
+    // The state map and the descriptors live in the region itself: a sliver cannot hold them.
+    if (mmap_num_pages + desc_num_pages >= num_pages)
+        return;
     uintptr_t kmem_reserved_start = 0;
     uintptr_t kmem_reserved_end = 0;
+    uint64_t usable_pages = 0;
 
     for (uint64_t i = region.addr_start; i < region.addr_end; i += PHYS_PAGE_SIZE)
     {
@@ -172,14 +363,16 @@ void PMM_init_region(uintptr_t addr, uintptr_t len)
         else if (region.addr_mmap_start == (uintptr_t) -1)
         {
             region.addr_mmap_start = i;
-            memset((void*) P2V(region.addr_mmap_start), PMM_MEM_NOTAVAILABLE, mmap_num_pages * PHYS_PAGE_SIZE);
-            i += mmap_num_pages * PHYS_PAGE_SIZE;
+            memset((void*) P2V(region.addr_mmap_start), PMM_PAGE_RESERVED, mmap_num_pages * PHYS_PAGE_SIZE);
+            region.addr_pages_start = i + (mmap_num_pages * PHYS_PAGE_SIZE);
+            memset((void*) P2V(region.addr_pages_start), 0, desc_num_pages * PHYS_PAGE_SIZE);
+            i += (mmap_num_pages + desc_num_pages) * PHYS_PAGE_SIZE;
             if (!PMM_state.kmem_initialized)
             {
                 uintptr_t heap_available = (region.addr_end > i) ? (region.addr_end - i) : 0;
                 size_t heap_size = (size_t) (heap_available & ~(uintptr_t) (PHYS_PAGE_SIZE - 1));
-                if (heap_size > KMEM_HEAP_SIZE)
-                    heap_size = KMEM_HEAP_SIZE;
+                if (heap_size > KMEM_BOOT_HEAP_SIZE)
+                    heap_size = KMEM_BOOT_HEAP_SIZE;
 
                 if (heap_size > (sizeof (malloc_header_t) + sizeof (uintptr_t)))
                 {
@@ -197,9 +390,12 @@ void PMM_init_region(uintptr_t addr, uintptr_t len)
         if (kmem_reserved_start != 0 && i >= kmem_reserved_start && i < kmem_reserved_end)
             continue;
 
-        uint32_t bit = (uint32_t) ((i - region.addr_start) / PHYS_PAGE_SIZE);
-        if (bit < num_pages)
-            PMM_mmap_set(&region, (int) bit);
+        uint64_t index = (i - region.addr_start) / PHYS_PAGE_SIZE;
+        if (index < num_pages)
+        {
+            ((uint8_t*) P2V(region.addr_mmap_start))[index] = PMM_PAGE_IN_BLOCK;
+            usable_pages++;
+        }
     }
 
     if (region.addr_mmap_start == (uintptr_t) -1)
@@ -208,80 +404,811 @@ void PMM_init_region(uintptr_t addr, uintptr_t len)
     if (!PMM_state.kmem_initialized)
         panic("PMM: failed to initialize kernel heap");
 
-    if (PMM_state.num_regions >= PMM_MAX_REGIONS)
-        panic("PMM: too many memory regions");
+    // Usable pages were marked free above: the region add releases each run of them.
+    uint64_t flags = spin_lock_irqsave(&PMM_state.lock);
+    PMM_state.stats.total_pages += usable_pages;
+    PMM_add_region_locked(&region);
+    spin_unlock_irqrestore(&PMM_state.lock, flags);
+}
+
+/*
+ * Once the SRAT is parsed, sort each node's fallback order by SLIT distance and rebuild the
+ * region table so every region, and every free block, lies in a single node. Runs on the
+ * BSP before the APs start, so nothing walks the table behind the lock meanwhile.
+ */
+void PMM_numa_init(void)
+{
+    if (!NUMA_is_available())
+        return;
+
+    uint32_t node_count = NUMA_get_node_count();
+    if (node_count > PMM_MAX_NODES)
+        node_count = PMM_MAX_NODES;
+
+    uint64_t flags = spin_lock_irqsave(&PMM_state.lock);
+    PMM_state.stats.node_count = node_count;
+    for (uint32_t node = 0; node < node_count; node++)
+    {
+        uint32_t node_id = NUMA_get_node_id(node);
+        uint32_t* fallback = PMM_state.node_fallback[node];
+        PMM_state.stats.nodes[node].node_id = node_id;
+        uint32_t keys[PMM_MAX_NODES];
+        for (uint32_t i = 0; i < node_count; i++)
+        {
+            // Insertion sort by distance; the own node goes first even on a flat SLIT.
+            uint32_t key = NUMA_get_distance(node_id, NUMA_get_node_id(i)) * 2U + ((i == node) ? 0U : 1U);
+            uint32_t pos = i;
+            while (pos > 0 && keys[pos - 1U] > key)
+            {
+                keys[pos] = keys[pos - 1U];
+                fallback[pos] = fallback[pos - 1U];
+                pos--;
+            }
+            keys[pos] = key;
+            fallback[pos] = i;
+        }
+    }
 
-    memcpy(&PMM_state.regions[PMM_state.num_regions++], &region, sizeof (region)); // Store the current region.
+    for (uint32_t cpu = 0; cpu < PMM_PCP_MAX_CPUS; cpu++)
+    {
+        uint32_t index = NUMA_get_node_index(NUMA_get_cpu_node(cpu));
+        PMM_state.cpu_node[cpu] = (uint8_t) ((index < node_count) ? index : 0);
+    }
+
+    // Pull every free block out of the lists: their pages go back to "inside a block".
+    for (uint32_t node = 0; node < PMM_MAX_NODES; node++)
+    {
+        for (uint32_t order = 0; order < PMM_ORDER_COUNT; order++)
+        {
+            while (PMM_state.free_lists[node][order])
+                PMM_remove_free_locked(PMM_state.free_lists[node][order]);
+        }
+        PMM_state.stats.nodes[node].total_pages = 0;
+        PMM_state.stats.nodes[node].free_pages = 0;
+    }
+    PMM_state.stats.free_pages = 0;
+
+    PMM_region_t regions[PMM_MAX_REGIONS];
+    int region_count = PMM_state.num_regions;
+    memcpy(regions, PMM_state.regions, sizeof(regions));
+    PMM_state.num_regions = 0;
+    PMM_state.numa_ready = true;
+    for (int i = 0; i < region_count; i++)
+        PMM_add_region_locked(&regions[i]);
+    spin_unlock_irqrestore(&PMM_state.lock, flags);
+
+    for (uint32_t node = 0; node < node_count; node++)
+    {
+        const PMM_node_stats_t* stats = &PMM_state.stats.nodes[node];
+        kdebug_printf("[PMM] node=%u total=%llu MiB free=%llu MiB nearest=%u\n",
+                      stats->node_id,
+                      (unsigned long long) ((stats->total_pages * PHYS_PAGE_SIZE) >> 20),
+                      (unsigned long long) ((stats->free_pages * PHYS_PAGE_SIZE) >> 20),
+                      (node_count > 1) ? NUMA_get_node_id(PMM_state.node_fallback[node][1]) : stats->node_id);
+    }
+}
+
+static int PMM_find_region(uint64_t pfn)
+{
+    int count = __atomic_load_n(&PMM_state.num_regions, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++)
+    {
+        const PMM_region_t* region = &PMM_state.regions[i];
+        if (pfn >= region->first_pfn && pfn - region->first_pfn < region->page_count)
+            return i;
+    }
+
+    return -1;
 }
 
-void PMM_mmap_unset(PMM_region_t* region, int bit)
+static uint8_t* PMM_page_state(uintptr_t addr, uint32_t* node_out)
 {
-    uint64_t* bitmap = (uint64_t*) P2V(region->addr_mmap_start);
-    bitmap[bit / 64] &= ~(1ULL << (bit % 64));
+    uint64_t pfn = addr / PHYS_PAGE_SIZE;
+    int found_region = PMM_find_region(pfn);
+    if (found_region < 0)
+        return NULL;
+
+    PMM_region_t* region = &PMM_state.regions[found_region];
+    if (node_out)
+        *node_out = region->node;
+    return PMM_page_map(region) + (pfn - region->first_pfn);
 }
 
-void PMM_mmap_set(PMM_region_t* region, int bit)
+static uint32_t PMM_current_node(void)
 {
-    uint64_t* bitmap = (uint64_t*) P2V(region->addr_mmap_start);
-    bitmap[bit / 64] |= (1ULL << (bit % 64));
+    uint32_t cpu_index = task_get_current_cpu_index();
+    return (cpu_index < PMM_PCP_MAX_CPUS) ? PMM_state.cpu_node[cpu_index] : 0;
 }
 
-uint32_t PMM_get_index_of_free_page(PMM_region_t region)
-{   
-    uint32_t num_pages = (uint32_t) (region.len / PHYS_PAGE_SIZE);
-    uint32_t num_words = (num_pages + 63) / 64;
-    uint64_t* bitmap = (uint64_t*) P2V(region.addr_mmap_start);
+/*
+ * Take the smallest free block of at least 2^order pages and split it down, handing the
+ * upper halves back to the lists. Nodes are tried nearest first, starting with the one
+ * asked for. The block is naturally aligned to its size.
+ */
+static uintptr_t PMM_alloc_block_locked(uint32_t order, uint32_t node)
+{
+    if (node >= PMM_state.stats.node_count)
+        node = 0;
 
-    for (uint32_t word_index = 0; word_index < num_words; word_index++)
+    uint32_t found = PMM_ORDER_COUNT;
+    uint32_t served = node;
+    for (uint32_t i = 0; i < PMM_state.stats.node_count && found > PMM_MAX_ORDER; i++)
     {
-        uint64_t word = bitmap[word_index];
-        if (word == 0)
-            continue;
+        served = PMM_state.node_fallback[node][i];
+        found = order;
+        while (found <= PMM_MAX_ORDER && !PMM_state.free_lists[served][found])
+            found++;
+    }
+    if (found > PMM_MAX_ORDER)
+        return 0; // Out of memory.
 
-        for (uint8_t bit_index = 0; bit_index < 64; bit_index++)
-        {
-            uint64_t bit = 1ULL << bit_index;
-            if ((word & bit) == 0)
-                continue;
+    PMM_free_block_t* block = PMM_state.free_lists[served][found];
+    uint32_t region_index = block->region_index;
+    PMM_remove_free_locked(block);
 
-            uint32_t page_index = word_index * 64 + bit_index;
-            if (page_index < num_pages)
-                return page_index;
-        }
+    PMM_region_t* region = &PMM_state.regions[region_index];
+    uint64_t index = (V2P(block) / PHYS_PAGE_SIZE) - region->first_pfn;
+    while (found > order)
+    {
+        found--;
+        PMM_push_free_locked(region_index, index + (1ULL << found), found);
+        PMM_state.stats.splits++;
+    }
+
+    uint64_t pages = 1ULL << order;
+    memset(PMM_page_map(region) + index, PMM_PAGE_USED, (size_t) pages);
+    PMM_page_reset(PMM_page_descs(region) + index, pages);
+    PMM_state.stats.free_pages -= pages;
+    PMM_state.stats.nodes[served].free_pages -= pages;
+    PMM_state.stats.allocs++;
+    if (served == node)
+        PMM_state.stats.nodes[node].local_allocs++;
+    else
+        PMM_state.stats.nodes[node].remote_allocs++;
+
+    return (uintptr_t) ((region->first_pfn + index) * PHYS_PAGE_SIZE);
+}
+
+/*
+ * Give back a block and merge it with its buddy as long as that one is free too. Frees of
+ * pages the PMM does not own, or does not see as in use, are refused: a stray double free
+ * must not corrupt the lists.
+ */
+static bool PMM_free_block_locked(uintptr_t addr, uint32_t order)
+{
+    uint64_t pages = 1ULL << order;
+    uint64_t pfn = addr / PHYS_PAGE_SIZE;
+    int found_region = PMM_find_region(pfn);
+    if (found_region < 0)
+        return false;
+
+    PMM_region_t* region = &PMM_state.regions[found_region];
+    uint64_t index = pfn - region->first_pfn;
+    if (index + pages > region->page_count)
+        return false;
+
+    uint8_t* map = PMM_page_map(region);
+    for (uint64_t i = 0; i < pages; i++)
+    {
+        if (map[index + i] != PMM_PAGE_USED)
+            return false;
+    }
+
+    memset(map + index, PMM_PAGE_IN_BLOCK, (size_t) pages);
+    PMM_state.stats.free_pages += pages;
+    PMM_state.stats.nodes[region->node].free_pages += pages;
+    PMM_state.stats.frees++;
+
+    while (order < PMM_MAX_ORDER)
+    {
+        uint64_t buddy_pfn = (region->first_pfn + index) ^ (1ULL << order);
+        if (buddy_pfn < region->first_pfn || buddy_pfn - region->first_pfn >= region->page_count)
+            break;
+
+        uint64_t buddy_index = buddy_pfn - region->first_pfn;
+        if (map[buddy_index] != (uint8_t) (PMM_PAGE_FREE_HEAD | order))
+            break;
+
+        PMM_remove_free_locked(PMM_block_at(region, buddy_index));
+        if (buddy_index < index)
+            index = buddy_index;
+        order++;
+        PMM_state.stats.merges++;
+    }
+
+    PMM_push_free_locked((uint32_t) found_region, index, order);
+    return true;
+}
+
+// Hand cached pages back to the buddy lists under a single acquisition of the global lock.
+static void PMM_pcp_release(const uintptr_t* pages, uint32_t count)
+{
+    if (count == 0)
+        return;
+
+    uint64_t flags = spin_lock_irqsave(&PMM_state.lock);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint8_t* state = PMM_page_state(pages[i], NULL);
+        if (state)
+            *state = PMM_PAGE_USED;
+        if (!state || !PMM_free_block_locked(pages[i], 0))
+            PMM_state.stats.bad_frees++;
+    }
+    spin_unlock_irqrestore(&PMM_state.lock, flags);
+
+    __atomic_sub_fetch(&PMM_state.pcp_cached_pages, count, __ATOMIC_RELAXED);
+}
+
+// Take a batch of single pages from the buddy lists; the caller holds the CPU cache lock.
+static void PMM_pcp_refill_locked(PMM_pcp_t* pcp)
+{
+    uint32_t node = PMM_state.cpu_node[(uint32_t) (pcp - PMM_state.pcp)];
+    uint32_t taken = 0;
+    uint64_t flags = spin_lock_irqsave(&PMM_state.lock);
+    while (taken < PMM_PCP_BATCH)
+    {
+        uintptr_t addr = PMM_alloc_block_locked(0, node);
+        if (addr == 0)
+            break;
+
+        *PMM_page_state(addr, NULL) = PMM_PAGE_CACHED;
+        pcp->pages[taken++] = addr;
+    }
+    spin_unlock_irqrestore(&PMM_state.lock, flags);
+
+    if (taken == 0)
+        return;
+
+    // The buddy hands out ascending addresses: keep the lowest on top so it is reused first.
+    for (uint32_t i = 0; i < taken / 2U; i++)
+    {
+        uintptr_t tmp = pcp->pages[i];
+        pcp->pages[i] = pcp->pages[taken - 1U - i];
+        pcp->pages[taken - 1U - i] = tmp;
+    }
+    pcp->count = taken;
+    pcp->refills++;
+    __atomic_add_fetch(&PMM_state.pcp_cached_pages, taken, __ATOMIC_RELAXED);
+}
+
+static PMM_pcp_t* PMM_pcp_current(void)
+{
+    if (__atomic_load_n(&PMM_state.pcp_disabled, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    // Migrating after this read only means using another CPU's cache, still under its lock.
+    uint32_t cpu_index = task_get_current_cpu_index();
+    if (cpu_index >= PMM_PCP_MAX_CPUS)
+        return NULL;
+
+    return &PMM_state.pcp[cpu_index];
+}
+
+// Shrinkers run in registration order, each asked for what the previous ones left.
+static void PMM_reclaim_job(void* arg)
+{
+    (void) arg;
+
+    uint32_t count = __atomic_load_n(&PMM_state.shrinker_count, __ATOMIC_ACQUIRE);
+    uint64_t free_pages = PMM_get_free_page_count();
+    uint64_t high = PMM_reclaim_high_watermark();
+    if (count != 0 && free_pages < high)
+    {
+        uint64_t target = high - free_pages;
+        uint64_t reclaimed = 0;
+        for (uint32_t i = 0; i < count && reclaimed < target; i++)
+            reclaimed += PMM_state.shrinkers[i](target - reclaimed);
+
+        __atomic_add_fetch(&PMM_state.reclaim_runs, 1U, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&PMM_state.reclaim_pages, reclaimed, __ATOMIC_RELAXED);
+        if (reclaimed == 0)
+            __atomic_store_n(&PMM_state.reclaim_backoff, PMM_RECLAIM_BACKOFF, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&PMM_state.reclaim_queued, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Below the low watermark, queue one shrinker pass for an idle CPU, the way the zero pool
+ * queues its refill. A pass that found nothing to free holds the next one back for a
+ * while, so a machine that is simply full does not rescan on every allocation.
+ */
+static void PMM_reclaim_check(void)
+{
+    if (__atomic_load_n(&PMM_state.shrinker_count, __ATOMIC_RELAXED) == 0 ||
+        PMM_get_free_page_count() >= PMM_reclaim_low_watermark())
+        return;
+
+    if (__atomic_load_n(&PMM_state.reclaim_backoff, __ATOMIC_RELAXED) != 0)
+    {
+        __atomic_sub_fetch(&PMM_state.reclaim_backoff, 1U, __ATOMIC_RELAXED);
+        return;
+    }
+
+    uint8_t expected = 0;
+    if (__atomic_compare_exchange_n(&PMM_state.reclaim_queued, &expected, 1, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) &&
+        !task_schedule_work(PMM_reclaim_job, NULL))
+        __atomic_store_n(&PMM_state.reclaim_queued, 0, __ATOMIC_RELEASE);
+}
+
+// Prefer the given node, then the others by distance.
+void* PMM_alloc_pages_node(uint32_t order, uint32_t node)
+{
+    if (order > PMM_MAX_ORDER)
+        return NULL;
+
+    uint64_t flags = spin_lock_irqsave(&PMM_state.lock);
+    uintptr_t addr = PMM_alloc_block_locked(order, node);
+    spin_unlock_irqrestore(&PMM_state.lock, flags);
+
+    // Pages parked in CPU caches may be all that is left, or may be blocking a merge.
+    if (addr == 0 && __atomic_load_n(&PMM_state.pcp_cached_pages, __ATOMIC_RELAXED) != 0)
+    {
+        PMM_drain_all();
+        flags = spin_lock_irqsave(&PMM_state.lock);
+        addr = PMM_alloc_block_locked(order, node);
+        spin_unlock_irqrestore(&PMM_state.lock, flags);
+    }
+
+    // So may the zeroed pools, last: their pages cost a refill to get back.
+    if (addr == 0 && __atomic_load_n(&PMM_state.zero_pool_pages, __ATOMIC_RELAXED) != 0)
+    {
+        PMM_zero_pool_drain_all();
+        flags = spin_lock_irqsave(&PMM_state.lock);
+        addr = PMM_alloc_block_locked(order, node);
+        spin_unlock_irqrestore(&PMM_state.lock, flags);
+    }
+
+    PMM_reclaim_check();
+    return (void*) addr;
+}
+
+// Local node first: the node of the CPU asking, which for a fault is the faulting CPU.
+void* PMM_alloc_pages(uint32_t order)
+{
+    return PMM_alloc_pages_node(order, PMM_current_node());
+}
+
+void PMM_free_pages(void* ptr, uint32_t order)
+{
+    uintptr_t addr = (uintptr_t) ptr;
+    uint64_t pages = 1ULL << (order & PMM_PAGE_ORDER_MASK);
+    if (order > PMM_MAX_ORDER || (addr & ((pages * PHYS_PAGE_SIZE) - 1U)) != 0)
+    {
+        kdebug_printf("[PMM] bad free addr=0x%llX order=%u\n", (unsigned long long) addr, order);
+        return;
     }
 
-    return (uint32_t) -1;
+    uint64_t flags = spin_lock_irqsave(&PMM_state.lock);
+    bool valid = PMM_free_block_locked(addr, order);
+    if (!valid)
+        PMM_state.stats.bad_frees++;
+    spin_unlock_irqrestore(&PMM_state.lock, flags);
+
+    if (!valid)
+    {
+        kdebug_printf("[PMM] refused free addr=0x%llX order=%u (not allocated)\n",
+                      (unsigned long long) addr,
+                      order);
+    }
 }
 
 void* PMM_alloc_page(void)
 {
-    for (int i = 0; i < PMM_state.num_regions; i++)
+    PMM_pcp_t* pcp = PMM_pcp_current();
+    if (pcp)
     {
-        PMM_region_t* region = &PMM_state.regions[i];
-        while (TRUE)
+        uint64_t flags = spin_lock_irqsave(&pcp->lock);
+        if (!pcp->offline && pcp->count == 0)
+            PMM_pcp_refill_locked(pcp);
+
+        if (!pcp->offline && pcp->count != 0)
         {
-            uint32_t index = PMM_get_index_of_free_page(*region);
-            if (index == (uint32_t) -1)
-                break;
+            uintptr_t addr = pcp->pages[--pcp->count];
+            *PMM_page_state(addr, NULL) = PMM_PAGE_USED;
+            PMM_page_reset(PMM_page_get(addr), 1);
+            pcp->hits++;
+            spin_unlock_irqrestore(&pcp->lock, flags);
+            __atomic_sub_fetch(&PMM_state.pcp_cached_pages, 1U, __ATOMIC_RELAXED);
+            PMM_reclaim_check();
+            return (void*) addr;
+        }
+        spin_unlock_irqrestore(&pcp->lock, flags);
+    }
 
-            uintptr_t page = region->addr_start + ((uintptr_t) index * PHYS_PAGE_SIZE);
-            PMM_mmap_unset(region, (int) index);
+    return PMM_alloc_pages(0);
+}
 
-            // Hard guard: never return low-memory or kernel image pages.
-            // TODO : maybe find a clever way instead of hard guard.
-            if (page < 0x100000 || (page >= PMM_state.kernel_phys_start && page < PMM_state.kernel_phys_end))
-                continue;
+/*
+ * Park a single page in the current CPU's cache. Hot frees go on top, to be handed out
+ * next while still in cache; cold ones (pages written by a device or not touched lately)
+ * go to the bottom, first in line to be drained back to the buddy lists.
+ */
+static void PMM_pcp_free(void* ptr, bool cold)
+{
+    uintptr_t addr = (uintptr_t) ptr;
+    PMM_pcp_t* pcp = PMM_pcp_current();
+    uint32_t node = 0;
+    uint8_t* state = ((addr & (PHYS_PAGE_SIZE - 1U)) == 0) ? PMM_page_state(addr, &node) : NULL;
+    // A page from another node would be handed out locally next: send it home instead.
+    if (!pcp || !state || node != PMM_state.cpu_node[(uint32_t) (pcp - PMM_state.pcp)])
+    {
+        PMM_free_pages(ptr, 0);
+        return;
+    }
 
-            return (void*) page;
-        }
+    uintptr_t batch[PMM_PCP_BATCH];
+    uint32_t batch_count = 0;
+    uint64_t flags = spin_lock_irqsave(&pcp->lock);
+    uint8_t expected = PMM_PAGE_USED;
+    if (pcp->offline ||
+        !__atomic_compare_exchange_n(state, &expected, PMM_PAGE_CACHED, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+        // Offline cache, or not a page in use: the buddy path frees or refuses it.
+        spin_unlock_irqrestore(&pcp->lock, flags);
+        PMM_free_pages(ptr, 0);
+        return;
     }
 
-    return NULL; // Out of memory.
+    if (cold)
+    {
+        memmove(&pcp->pages[1], &pcp->pages[0], pcp->count * sizeof(uintptr_t));
+        pcp->pages[0] = addr;
+    }
+    else
+        pcp->pages[pcp->count] = addr;
+    pcp->count++;
+    __atomic_add_fetch(&PMM_state.pcp_cached_pages, 1U, __ATOMIC_RELAXED);
+
+    if (pcp->count > PMM_PCP_HIGH)
+    {
+        batch_count = PMM_PCP_BATCH;
+        memcpy(batch, pcp->pages, sizeof(batch));
+        pcp->count -= batch_count;
+        memmove(&pcp->pages[0], &pcp->pages[batch_count], pcp->count * sizeof(uintptr_t));
+        pcp->drains++;
+        PMM_pcp_release(batch, batch_count);
+    }
+    spin_unlock_irqrestore(&pcp->lock, flags);
 }
 
 void PMM_dealloc_page(void* ptr)
 {
-    uint64_t addr = (uint64_t) ptr;
-    // TODO: method to get the region of a page.
-    
+    PMM_pcp_free(ptr, false);
+}
+
+void PMM_dealloc_page_cold(void* ptr)
+{
+    PMM_pcp_free(ptr, true);
+}
+
+void PMM_drain_cpu(uint32_t cpu_index)
+{
+    if (cpu_index >= PMM_PCP_MAX_CPUS)
+        return;
+
+    PMM_pcp_t* pcp = &PMM_state.pcp[cpu_index];
+    uint64_t flags = spin_lock_irqsave(&pcp->lock);
+    if (pcp->count != 0)
+    {
+        PMM_pcp_release(pcp->pages, pcp->count);
+        pcp->count = 0;
+        pcp->drains++;
+    }
+    spin_unlock_irqrestore(&pcp->lock, flags);
+}
+
+void PMM_drain_all(void)
+{
+    for (uint32_t cpu = 0; cpu < PMM_PCP_MAX_CPUS; cpu++)
+    {
+        if (__atomic_load_n(&PMM_state.pcp[cpu].count, __ATOMIC_RELAXED) != 0)
+            PMM_drain_cpu(cpu);
+    }
+}
+
+// An offline CPU's cache is emptied and bypassed until the CPU comes back.
+void PMM_cpu_set_online(uint32_t cpu_index, bool online)
+{
+    if (cpu_index >= PMM_PCP_MAX_CPUS)
+        return;
+
+    PMM_pcp_t* pcp = &PMM_state.pcp[cpu_index];
+    uint64_t flags = spin_lock_irqsave(&pcp->lock);
+    pcp->offline = online ? 0 : 1;
+    spin_unlock_irqrestore(&pcp->lock, flags);
+
+    if (!online)
+        PMM_drain_cpu(cpu_index);
+}
+
+void PMM_set_pcp_enabled(bool enabled)
+{
+    __atomic_store_n(&PMM_state.pcp_disabled, !enabled, __ATOMIC_RELEASE);
+    if (!enabled)
+        PMM_drain_all();
+}
+
+/*
+ * Zero a frame with non-temporal stores: the page is meant for a later fault, likely on
+ * another CPU, so there is no point evicting the cache for it. movnti works on general
+ * registers and leaves the FPU state alone; the sfence orders the stores before the page
+ * is published.
+ */
+static void PMM_zero_page_nt(uintptr_t phys)
+{
+    uint64_t* dst = (uint64_t*) P2V(phys);
+    uint64_t zero = 0;
+    for (uint32_t i = 0; i < PHYS_PAGE_SIZE / sizeof(uint64_t); i += 4U)
+    {
+        __asm__ __volatile__("movnti %1, 0(%0)\n\t"
+                             "movnti %1, 8(%0)\n\t"
+                             "movnti %1, 16(%0)\n\t"
+                             "movnti %1, 24(%0)"
+                             :
+                             : "r"(dst + i), "r"(zero)
+                             : "memory");
+    }
+    __asm__ __volatile__("sfence" ::: "memory");
+}
+
+static void PMM_zero_pool_refill_job(void* arg)
+{
+    uint32_t node = (uint32_t) (uintptr_t) arg;
+    PMM_zero_pool_refill(node);
+    __atomic_store_n(&PMM_state.zero_pool[node].refill_queued, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Top a node's pool up to PMM_ZERO_POOL_HIGH. The zeroing runs without any lock held;
+ * each page is taken from the node itself, and the job stops early when memory is short
+ * or the node has nothing left of its own.
+ */
+void PMM_zero_pool_refill(uint32_t node)
+{
+    if (node >= PMM_MAX_NODES || node >= PMM_state.stats.node_count)
+        return;
+
+    PMM_zero_pool_t* pool = &PMM_state.zero_pool[node];
+    while (!__atomic_load_n(&PMM_state.zero_pool_disabled, __ATOMIC_ACQUIRE) &&
+           __atomic_load_n(&pool->count, __ATOMIC_RELAXED) < PMM_ZERO_POOL_HIGH &&
+           __atomic_load_n(&PMM_state.stats.free_pages, __ATOMIC_RELAXED) > PMM_ZERO_POOL_RESERVE)
+    {
+        uintptr_t addr = (uintptr_t) PMM_alloc_pages_node(0, node);
+        if (addr == 0)
+            return;
+        if (PMM_page_get(addr)->node != node)
+        {
+            PMM_free_pages((void*) addr, 0);
+            return;
+        }
+
+        PMM_zero_page_nt(addr);
+        __atomic_add_fetch(&PMM_state.zero_refills, 1U, __ATOMIC_RELAXED);
+
+        uint64_t flags = spin_lock_irqsave(&pool->lock);
+        bool kept = pool->count < PMM_ZERO_POOL_HIGH && !__atomic_load_n(&PMM_state.zero_pool_disabled, __ATOMIC_ACQUIRE);
+        if (kept)
+        {
+            pool->pages[pool->count++] = addr;
+            __atomic_add_fetch(&PMM_state.zero_pool_pages, 1U, __ATOMIC_RELAXED);
+        }
+        spin_unlock_irqrestore(&pool->lock, flags);
+
+        if (!kept)
+        {
+            PMM_free_pages((void*) addr, 0);
+            return;
+        }
+    }
+}
+
+/*
+ * A zero-filled page for user memory or a page table: from the local node's pool when it
+ * has one, zeroed here otherwise. A pool running low gets a refill queued for an idle CPU.
+ */
+void* PMM_alloc_zeroed_page(void)
+{
+    uint32_t node = PMM_current_node();
+    if (node < PMM_MAX_NODES && !__atomic_load_n(&PMM_state.zero_pool_disabled, __ATOMIC_ACQUIRE))
+    {
+        PMM_zero_pool_t* pool = &PMM_state.zero_pool[node];
+        uintptr_t addr = 0;
+        uint64_t flags = spin_lock_irqsave(&pool->lock);
+        if (pool->count != 0)
+            addr = pool->pages[--pool->count];
+        uint32_t left = pool->count;
+        spin_unlock_irqrestore(&pool->lock, flags);
+
+        uint8_t expected = 0;
+        if (left < PMM_ZERO_POOL_LOW &&
+            __atomic_compare_exchange_n(&pool->refill_queued, &expected, 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) &&
+            !task_schedule_work(PMM_zero_pool_refill_job, (void*) (uintptr_t) node))
+            __atomic_store_n(&pool->refill_queued, 0, __ATOMIC_RELEASE);
+
+        if (addr != 0)
+        {
+            __atomic_sub_fetch(&PMM_state.zero_pool_pages, 1U, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&PMM_state.zero_hits, 1U, __ATOMIC_RELAXED);
+            return (void*) addr;
+        }
+    }
+
+    void* page = PMM_alloc_page();
+    if (!page)
+        return NULL;
+
+    memset((void*) P2V((uintptr_t) page), 0, PHYS_PAGE_SIZE);
+    __atomic_add_fetch(&PMM_state.zero_misses, 1U, __ATOMIC_RELAXED);
+    return page;
+}
+
+void PMM_zero_pool_drain_all(void)
+{
+    for (uint32_t node = 0; node < PMM_MAX_NODES; node++)
+    {
+        PMM_zero_pool_t* pool = &PMM_state.zero_pool[node];
+        if (__atomic_load_n(&pool->count, __ATOMIC_RELAXED) == 0)
+            continue;
+
+        uintptr_t pages[PMM_ZERO_POOL_HIGH];
+        uint64_t flags = spin_lock_irqsave(&pool->lock);
+        uint32_t count = pool->count;
+        memcpy(pages, pool->pages, count * sizeof(uintptr_t));
+        pool->count = 0;
+        spin_unlock_irqrestore(&pool->lock, flags);
+
+        __atomic_sub_fetch(&PMM_state.zero_pool_pages, count, __ATOMIC_RELAXED);
+        for (uint32_t i = 0; i < count; i++)
+            PMM_free_pages((void*) pages[i], 0);
+    }
+}
+
+// Off, the pools are emptied and every zeroed page is cleared on the spot (for measurements).
+void PMM_set_zero_pool_enabled(bool enabled)
+{
+    __atomic_store_n(&PMM_state.zero_pool_disabled, !enabled, __ATOMIC_RELEASE);
+    if (!enabled)
+        PMM_zero_pool_drain_all();
+}
+
+uint64_t PMM_get_free_page_count(void)
+{
+    return __atomic_load_n(&PMM_state.stats.free_pages, __ATOMIC_RELAXED) +
+           __atomic_load_n(&PMM_state.pcp_cached_pages, __ATOMIC_RELAXED) +
+           __atomic_load_n(&PMM_state.zero_pool_pages, __ATOMIC_RELAXED);
+}
+
+uint64_t PMM_get_total_page_count(void)
+{
+    return __atomic_load_n(&PMM_state.stats.total_pages, __ATOMIC_RELAXED);
+}
+
+uint64_t PMM_reclaim_low_watermark(void)
+{
+    uint64_t low = PMM_get_total_page_count() >> PMM_RECLAIM_LOW_SHIFT;
+    return low < PMM_RECLAIM_MIN_PAGES ? PMM_RECLAIM_MIN_PAGES : low;
+}
+
+uint64_t PMM_reclaim_high_watermark(void)
+{
+    uint64_t high = PMM_get_total_page_count() >> PMM_RECLAIM_HIGH_SHIFT;
+    uint64_t low = PMM_reclaim_low_watermark();
+    return high < low * 2U ? low * 2U : high;
+}
+
+/*
+ * Called at init by whoever can give memory back: cheap ones first, since a pass stops
+ * as soon as enough was freed. Entries are never removed, so the job reads them unlocked.
+ */
+bool PMM_register_shrinker(PMM_shrinker_t shrinker)
+{
+    if (!shrinker)
+        return false;
+
+    uint32_t slot = __atomic_fetch_add(&PMM_state.shrinker_reserved, 1U, __ATOMIC_ACQ_REL);
+    if (slot >= PMM_SHRINKER_MAX)
+        return false;
+
+    PMM_state.shrinkers[slot] = shrinker;
+    while (__atomic_load_n(&PMM_state.shrinker_count, __ATOMIC_ACQUIRE) != slot)
+        __asm__ __volatile__("pause");
+    __atomic_store_n(&PMM_state.shrinker_count, slot + 1U, __ATOMIC_RELEASE);
+    return true;
+}
+
+// The descriptor of the frame holding phys, NULL for memory the PMM does not manage.
+PMM_page_t* PMM_page_get(uintptr_t phys)
+{
+    uint64_t pfn = phys / PHYS_PAGE_SIZE;
+    int found_region = PMM_find_region(pfn);
+    if (found_region < 0)
+        return NULL;
+
+    const PMM_region_t* region = &PMM_state.regions[found_region];
+    return PMM_page_descs(region) + (pfn - region->first_pfn);
+}
+
+/*
+ * Shared-frame references are lock-free: every user of one frame goes through its own
+ * descriptor, so two forks or faults on different frames never meet.
+ */
+bool PMM_page_ref_add(uintptr_t phys, uint32_t delta, uint8_t flag)
+{
+    PMM_page_t* page = PMM_page_get(phys);
+    if (!page || delta == 0)
+        return false;
+
+    uint32_t refs = __atomic_load_n(&page->refcount, __ATOMIC_RELAXED);
+    do
+    {
+        if (refs > UINT32_MAX - delta)
+            return false;
+    } while (!__atomic_compare_exchange_n(&page->refcount, &refs, refs + delta, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    __atomic_or_fetch(&page->flags, flag, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Drop one reference; out_zero reports the last one, after which the caller frees the frame.
+bool PMM_page_ref_sub(uintptr_t phys, bool* out_zero)
+{
+    if (out_zero)
+        *out_zero = false;
+
+    PMM_page_t* page = PMM_page_get(phys);
+    if (!page)
+        return false;
+
+    uint32_t refs = __atomic_load_n(&page->refcount, __ATOMIC_RELAXED);
+    do
+    {
+        if (refs == 0)
+            return false;
+    } while (!__atomic_compare_exchange_n(&page->refcount, &refs, refs - 1U, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    if (refs == 1U)
+    {
+        __atomic_store_n(&page->flags, 0, __ATOMIC_RELEASE);
+        if (out_zero)
+            *out_zero = true;
+    }
+    return true;
+}
+
+uint32_t PMM_page_ref_get(uintptr_t phys)
+{
+    const PMM_page_t* page = PMM_page_get(phys);
+    return page ? __atomic_load_n(&page->refcount, __ATOMIC_ACQUIRE) : 0U;
+}
+
+void PMM_get_stats(PMM_stats_t* out)
+{
+    if (!out)
+        return;
+
+    uint64_t flags = spin_lock_irqsave(&PMM_state.lock);
+    memcpy(out, &PMM_state.stats, sizeof(*out));
+    spin_unlock_irqrestore(&PMM_state.lock, flags);
+
+    out->cached_pages = __atomic_load_n(&PMM_state.pcp_cached_pages, __ATOMIC_RELAXED);
+    out->zero_pool_pages = __atomic_load_n(&PMM_state.zero_pool_pages, __ATOMIC_RELAXED);
+    out->free_pages += out->cached_pages + out->zero_pool_pages;
+    out->zero_hits = __atomic_load_n(&PMM_state.zero_hits, __ATOMIC_RELAXED);
+    out->zero_misses = __atomic_load_n(&PMM_state.zero_misses, __ATOMIC_RELAXED);
+    out->zero_refills = __atomic_load_n(&PMM_state.zero_refills, __ATOMIC_RELAXED);
+    out->reclaim_runs = __atomic_load_n(&PMM_state.reclaim_runs, __ATOMIC_RELAXED);
+    out->reclaim_pages = __atomic_load_n(&PMM_state.reclaim_pages, __ATOMIC_RELAXED);
+    for (uint32_t cpu = 0; cpu < PMM_PCP_MAX_CPUS; cpu++)
+    {
+        const PMM_pcp_t* pcp = &PMM_state.pcp[cpu];
+        out->pcp_hits += __atomic_load_n(&pcp->hits, __ATOMIC_RELAXED);
+        out->pcp_refills += __atomic_load_n(&pcp->refills, __ATOMIC_RELAXED);
+        out->pcp_drains += __atomic_load_n(&pcp->drains, __ATOMIC_RELAXED);
+    }
 }
@@ -0,0 +1,481 @@
+#include <Memory/Slab.h>
+#include <Memory/Slab_private.h>
+
+#include <Debug/KDebug.h>
+#include <Memory/PMM.h>
+#include <Memory/VMM.h>
+#include <Task/Task.h>
+
+#include <string.h>
+
+static SLAB_runtime_state_t SLAB_state;
+
+static const char* const kmem_size_class_names[KMEM_SIZE_CLASS_COUNT] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
+
+_Static_assert((KMEM_SIZE_CLASS_MIN << (KMEM_SIZE_CLASS_COUNT - 1U)) == KMEM_SLAB_MAX_OBJECT,
+               "kmalloc size classes must end at the largest slab object");
+
+static inline uint32_t kmem_align_up(uint32_t value, uint32_t align)
+{
+    return (value + (align - 1U)) & ~(align - 1U);
+}
+
+static void kmem_slab_list_push(kmem_slab_list_t* list, kmem_slab_t* slab)
+{
+    slab->prev = NULL;
+    slab->next = list->head;
+    if (list->head)
+        list->head->prev = slab;
+    list->head = slab;
+    list->count++;
+}
+
+static void kmem_slab_list_remove(kmem_slab_list_t* list, kmem_slab_t* slab)
+{
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        list->head = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+    slab->next = NULL;
+    slab->prev = NULL;
+    list->count--;
+}
+
+static kmem_slab_t* kmem_slab_of(const void* obj)
+{
+    return (kmem_slab_t*) ((uintptr_t) obj & ~(uintptr_t) (KMEM_SLAB_SIZE - 1U));
+}
+
+/*
+ * Carve a fresh buddy block into objects. Constructors run here, once per object: a freed
+ * object must come back in its constructed state, so it is never built again.
+ */
+static kmem_slab_t* kmem_cache_grow_locked(kmem_cache_t* cache)
+{
+    uintptr_t phys = (uintptr_t) PMM_alloc_pages(KMEM_SLAB_ORDER);
+    if (phys == 0)
+        return NULL;
+
+    uintptr_t base = P2V(phys);
+    if ((base & (KMEM_SLAB_SIZE - 1U)) != 0)
+    {
+        PMM_free_pages((void*) phys, KMEM_SLAB_ORDER);
+        return NULL; // The object-to-slab mask needs the HHDM view aligned too.
+    }
+
+    kmem_slab_t* slab = (kmem_slab_t*) base;
+    slab->cache = cache;
+    slab->free_list = NULL;
+    slab->in_use = 0;
+    slab->magic = KMEM_SLAB_MAGIC;
+    for (uint32_t i = cache->objects_per_slab; i-- > 0;)
+    {
+        uint8_t* obj = (uint8_t*) base + cache->first_offset + (size_t) i * cache->stride;
+        if (cache->ctor)
+            cache->ctor(obj);
+        *(void**) (obj + cache->free_offset) = slab->free_list;
+        slab->free_list = obj;
+    }
+
+    kmem_slab_list_push(&cache->partial, slab);
+    cache->slabs_grown++;
+    return slab;
+}
+
+static void* kmem_cache_take_locked(kmem_cache_t* cache)
+{
+    kmem_slab_t* slab = cache->partial.head;
+    if (!slab && cache->empty.head)
+    {
+        slab = cache->empty.head;
+        kmem_slab_list_remove(&cache->empty, slab);
+        kmem_slab_list_push(&cache->partial, slab);
+    }
+    if (!slab)
+        slab = kmem_cache_grow_locked(cache);
+    if (!slab)
+        return NULL;
+
+    uint8_t* obj = (uint8_t*) slab->free_list;
+    slab->free_list = *(void**) (obj + cache->free_offset);
+    slab->in_use++;
+    if (slab->in_use == cache->objects_per_slab)
+    {
+        kmem_slab_list_remove(&cache->partial, slab);
+        kmem_slab_list_push(&cache->full, slab);
+    }
+    cache->slab_allocs++;
+    return obj;
+}
+
+static void kmem_cache_put_locked(kmem_cache_t* cache, void* obj)
+{
+    kmem_slab_t* slab = kmem_slab_of(obj);
+    if (slab->in_use == cache->objects_per_slab)
+    {
+        kmem_slab_list_remove(&cache->full, slab);
+        kmem_slab_list_push(&cache->partial, slab);
+    }
+
+    *(void**) ((uint8_t*) obj + cache->free_offset) = slab->free_list;
+    slab->free_list = obj;
+    slab->in_use--;
+    cache->slab_frees++;
+    if (slab->in_use != 0)
+        return;
+
+    // Keep one empty slab to absorb alloc/free ping-pong, give the rest back.
+    kmem_slab_list_remove(&cache->partial, slab);
+    if (cache->empty.count == 0)
+    {
+        kmem_slab_list_push(&cache->empty, slab);
+        return;
+    }
+
+    slab->magic = 0;
+    PMM_free_pages((void*) V2P(slab), KMEM_SLAB_ORDER);
+    cache->slabs_released++;
+}
+
+static kmem_magazine_t* kmem_cache_magazine(kmem_cache_t* cache)
+{
+    if ((cache->flags & KMEM_CACHE_NO_MAGAZINE) != 0 || !SLAB_state.magazine_cache)
+        return NULL;
+
+    // Migrating after this read only means using another CPU's magazine, still under its lock.
+    uint32_t cpu_index = task_get_current_cpu_index();
+    if (cpu_index >= KMEM_CACHE_MAX_CPUS)
+        return NULL;
+
+    kmem_magazine_t* magazine = __atomic_load_n(&cache->magazines[cpu_index], __ATOMIC_ACQUIRE);
+    if (magazine)
+        return magazine;
+
+    magazine = (kmem_magazine_t*) kmem_cache_alloc(SLAB_state.magazine_cache);
+    if (!magazine)
+        return NULL;
+
+    memset(magazine, 0, sizeof(*magazine));
+    spinlock_init(&magazine->lock);
+    kmem_magazine_t* expected = NULL;
+    if (!__atomic_compare_exchange_n(&cache->magazines[cpu_index], &expected, magazine, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        kmem_cache_free(SLAB_state.magazine_cache, magazine);
+        return expected;
+    }
+
+    return magazine;
+}
+
+// Return all but the newest `keep` objects to their slabs under one cache lock acquisition.
+static void kmem_magazine_drain_locked(kmem_cache_t* cache, kmem_magazine_t* magazine, uint32_t keep)
+{
+    if (magazine->count <= keep)
+        return;
+
+    uint32_t give = magazine->count - keep;
+    uint64_t flags = spin_lock_irqsave(&cache->lock);
+    for (uint32_t i = 0; i < give; i++)
+        kmem_cache_put_locked(cache, magazine->objs[i]);
+    spin_unlock_irqrestore(&cache->lock, flags);
+
+    memmove(&magazine->objs[0], &magazine->objs[give], keep * sizeof(void*));
+    magazine->count = keep;
+}
+
+void kmem_slab_init(void)
+{
+    spinlock_init(&SLAB_state.lock);
+
+    // Magazines come from their own cache, which has none: no recursion on the slow path.
+    SLAB_state.magazine_cache = kmem_cache_create("kmem-magazine",
+                                                  sizeof(kmem_magazine_t),
+                                                  sizeof(uintptr_t),
+                                                  NULL,
+                                                  KMEM_CACHE_NO_MAGAZINE);
+    // Classes are naturally aligned up to a cache line.
+    for (uint32_t i = 0; i < KMEM_SIZE_CLASS_COUNT; i++)
+    {
+        uint32_t size = KMEM_SIZE_CLASS_MIN << i;
+        SLAB_state.size_classes[i] = kmem_cache_create(kmem_size_class_names[i],
+                                                       size,
+                                                       (size < 64U) ? size : 64U,
+                                                       NULL,
+                                                       0);
+    }
+
+    SLAB_state.ready = true;
+}
+
+/*
+ * Objects up to KMEM_SLAB_MAX_OBJECT bytes; `align` must be a power of two. The constructor
+ * runs under the cache lock and must not allocate from the same cache.
+ */
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, kmem_ctor_t ctor, uint32_t flags)
+{
+    if (size == 0 || size > KMEM_SLAB_MAX_OBJECT)
+        return NULL;
+    if (align < sizeof(void*))
+        align = sizeof(void*);
+    if ((align & (align - 1U)) != 0 || align > KMEM_SLAB_MAX_OBJECT)
+        return NULL;
+
+    uint32_t object_size = (uint32_t) size;
+    uint32_t free_offset = ctor ? kmem_align_up(object_size, sizeof(void*)) : 0;
+    uint32_t span = ctor ? free_offset + (uint32_t) sizeof(void*) : object_size;
+    if (span < sizeof(void*))
+        span = sizeof(void*);
+    uint32_t stride = kmem_align_up(span, (uint32_t) align);
+    uint32_t first_offset = kmem_align_up((uint32_t) sizeof(kmem_slab_t), (uint32_t) align);
+
+    uint64_t lock_flags = spin_lock_irqsave(&SLAB_state.lock);
+    kmem_cache_t* cache = NULL;
+    for (uint32_t i = 0; i < KMEM_CACHE_MAX; i++)
+    {
+        if (!SLAB_state.caches[i].used)
+        {
+            cache = &SLAB_state.caches[i];
+            break;
+        }
+    }
+
+    if (cache)
+    {
+        memset(cache, 0, sizeof(*cache));
+        strncpy(cache->name, name ? name : "anon", KMEM_CACHE_NAME_MAX - 1U);
+        cache->flags = flags;
+        cache->object_size = object_size;
+        cache->stride = stride;
+        cache->free_offset = free_offset;
+        cache->first_offset = first_offset;
+        cache->objects_per_slab = (KMEM_SLAB_SIZE - first_offset) / stride;
+        cache->ctor = ctor;
+        spinlock_init(&cache->lock);
+        cache->used = true;
+    }
+    spin_unlock_irqrestore(&SLAB_state.lock, lock_flags);
+
+    if (!cache)
+        kdebug_printf("[SLAB] cache table full, cannot create %s\n", name ? name : "anon");
+    return cache;
+}
+
+// Fails, leaving the cache usable, while objects are still held.
+bool kmem_cache_destroy(kmem_cache_t* cache)
+{
+    if (!cache || !cache->used)
+        return false;
+
+    kmem_cache_shrink(cache);
+
+    uint64_t flags = spin_lock_irqsave(&cache->lock);
+    bool busy = cache->partial.count != 0 || cache->full.count != 0;
+    spin_unlock_irqrestore(&cache->lock, flags);
+    if (busy)
+    {
+        kdebug_printf("[SLAB] destroy refused: %s still has objects in use\n", cache->name);
+        return false;
+    }
+
+    for (uint32_t cpu = 0; cpu < KMEM_CACHE_MAX_CPUS; cpu++)
+    {
+        kmem_magazine_t* magazine = __atomic_exchange_n(&cache->magazines[cpu], NULL, __ATOMIC_ACQ_REL);
+        if (magazine)
+            kmem_cache_free(SLAB_state.magazine_cache, magazine);
+    }
+
+    flags = spin_lock_irqsave(&SLAB_state.lock);
+    cache->used = false;
+    spin_unlock_irqrestore(&SLAB_state.lock, flags);
+    return true;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* cache)
+{
+    if (!cache || !cache->used)
+        return NULL;
+
+    kmem_magazine_t* magazine = kmem_cache_magazine(cache);
+    if (!magazine)
+    {
+        uint64_t flags = spin_lock_irqsave(&cache->lock);
+        void* obj = kmem_cache_take_locked(cache);
+        spin_unlock_irqrestore(&cache->lock, flags);
+        return obj;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&magazine->lock);
+    if (magazine->count == 0)
+    {
+        // Refill half a magazine at once so the next allocations stay lock-free.
+        uint64_t cache_flags = spin_lock_irqsave(&cache->lock);
+        while (magazine->count < KMEM_MAGAZINE_BATCH)
+        {
+            void* obj = kmem_cache_take_locked(cache);
+            if (!obj)
+                break;
+            magazine->objs[magazine->count++] = obj;
+        }
+        spin_unlock_irqrestore(&cache->lock, cache_flags);
+        magazine->misses++;
+    }
+    else
+        magazine->hits++;
+
+    void* obj = (magazine->count != 0) ? magazine->objs[--magazine->count] : NULL;
+    spin_unlock_irqrestore(&magazine->lock, flags);
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* cache, void* obj)
+{
+    if (!obj)
+        return;
+
+    kmem_slab_t* slab = kmem_slab_of(obj);
+    if (!cache || slab->magic != KMEM_SLAB_MAGIC || slab->cache != cache)
+    {
+        kdebug_printf("[SLAB] refused free obj=0x%llX cache=%s\n",
+                      (unsigned long long) (uintptr_t) obj,
+                      cache ? cache->name : "null");
+        return;
+    }
+
+    kmem_magazine_t* magazine = kmem_cache_magazine(cache);
+    if (!magazine)
+    {
+        uint64_t flags = spin_lock_irqsave(&cache->lock);
+        kmem_cache_put_locked(cache, obj);
+        spin_unlock_irqrestore(&cache->lock, flags);
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&magazine->lock);
+    if (magazine->count == KMEM_MAGAZINE_SIZE)
+        kmem_magazine_drain_locked(cache, magazine, KMEM_MAGAZINE_BATCH);
+    magazine->objs[magazine->count++] = obj;
+    spin_unlock_irqrestore(&magazine->lock, flags);
+}
+
+// Empty every CPU magazine and give all empty slabs back to the PMM.
+void kmem_cache_shrink(kmem_cache_t* cache)
+{
+    if (!cache || !cache->used)
+        return;
+
+    for (uint32_t cpu = 0; cpu < KMEM_CACHE_MAX_CPUS; cpu++)
+    {
+        kmem_magazine_t* magazine = __atomic_load_n(&cache->magazines[cpu], __ATOMIC_ACQUIRE);
+        if (!magazine)
+            continue;
+
+        uint64_t flags = spin_lock_irqsave(&magazine->lock);
+        kmem_magazine_drain_locked(cache, magazine, 0);
+        spin_unlock_irqrestore(&magazine->lock, flags);
+    }
+
+    uint64_t flags = spin_lock_irqsave(&cache->lock);
+    while (cache->empty.head)
+    {
+        kmem_slab_t* slab = cache->empty.head;
+        kmem_slab_list_remove(&cache->empty, slab);
+        slab->magic = 0;
+        PMM_free_pages((void*) V2P(slab), KMEM_SLAB_ORDER);
+        cache->slabs_released++;
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+bool kmem_cache_get_stats(const kmem_cache_t* cache, kmem_cache_stats_t* out)
+{
+    if (!cache || !out || !cache->used)
+        return false;
+
+    memset(out, 0, sizeof(*out));
+    kmem_cache_t* mutable_cache = (kmem_cache_t*) cache;
+    uint64_t flags = spin_lock_irqsave(&mutable_cache->lock);
+    memcpy(out->name, cache->name, sizeof(out->name));
+    out->object_size = cache->object_size;
+    out->objects_per_slab = cache->objects_per_slab;
+    out->slabs = cache->partial.count + cache->full.count + cache->empty.count;
+    out->objects_total = (uint64_t) out->slabs * cache->objects_per_slab;
+    uint64_t out_of_slabs = cache->slab_allocs - cache->slab_frees;
+    out->slabs_grown = cache->slabs_grown;
+    out->slabs_released = cache->slabs_released;
+    spin_unlock_irqrestore(&mutable_cache->lock, flags);
+
+    for (uint32_t cpu = 0; cpu < KMEM_CACHE_MAX_CPUS; cpu++)
+    {
+        const kmem_magazine_t* magazine = __atomic_load_n(&cache->magazines[cpu], __ATOMIC_ACQUIRE);
+        if (!magazine)
+            continue;
+
+        out->magazine_objects += __atomic_load_n(&magazine->count, __ATOMIC_RELAXED);
+        out->magazine_hits += __atomic_load_n(&magazine->hits, __ATOMIC_RELAXED);
+        out->magazine_misses += __atomic_load_n(&magazine->misses, __ATOMIC_RELAXED);
+    }
+
+    out->objects_active = (out_of_slabs > out->magazine_objects) ? out_of_slabs - out->magazine_objects : 0;
+    return true;
+}
+
+uint32_t kmem_cache_get_count(void)
+{
+    return KMEM_CACHE_MAX;
+}
+
+// Slot `index` of the cache table, or NULL when that slot is unused.
+kmem_cache_t* kmem_cache_get(uint32_t index)
+{
+    if (index >= KMEM_CACHE_MAX || !SLAB_state.caches[index].used)
+        return NULL;
+
+    return &SLAB_state.caches[index];
+}
+
+// kmalloc front end: the smallest power-of-two class that fits, NULL when none does.
+void* kmem_slab_alloc_size(size_t size)
+{
+    if (!SLAB_state.ready || size == 0 || size > KMEM_SLAB_MAX_OBJECT)
+        return NULL;
+
+    uint32_t size_class = 0;
+    while ((size_t) (KMEM_SIZE_CLASS_MIN << size_class) < size)
+        size_class++;
+
+    return kmem_cache_alloc(SLAB_state.size_classes[size_class]);
+}
+
+bool kmem_slab_owns(const void* ptr)
+{
+    if (!ptr || !SLAB_state.ready)
+        return false;
+
+    const kmem_slab_t* slab = kmem_slab_of(ptr);
+    const kmem_cache_t* cache = slab->cache;
+    return slab->magic == KMEM_SLAB_MAGIC &&
+           cache >= &SLAB_state.caches[0] && cache < &SLAB_state.caches[KMEM_CACHE_MAX];
+}
+
+size_t kmem_slab_object_size(const void* ptr)
+{
+    return kmem_slab_owns(ptr) ? kmem_slab_of(ptr)->cache->object_size : 0;
+}
+
+void kmem_slab_free(void* ptr)
+{
+    if (!kmem_slab_owns(ptr))
+    {
+        kdebug_printf("[SLAB] refused free obj=0x%llX (not a slab object)\n",
+                      (unsigned long long) (uintptr_t) ptr);
+        return;
+    }
+
+    kmem_cache_free(kmem_slab_of(ptr)->cache, ptr);
+}
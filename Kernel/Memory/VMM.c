@@ -6,7 +6,9 @@
 #include <Device/TTY.h>
 #include <CPU/MSR.h>
 #include <CPU/SMP.h>
+#include <CPU/x86.h>
 #include <Debug/KDebug.h>
+#include <Task/Task.h>
 
 #include <string.h>
 #include <stdint.h>
@@ -18,9 +20,14 @@ _Static_assert(VMM_HHDM_BASE < VMM_MMIO_BASE,
                "VMM layout mismatch: HHDM must be below MMIO window");
 _Static_assert(VMM_MMIO_BASE < VMM_KERNEL_VIRT_BASE,
                "VMM layout mismatch: MMIO window must stay below kernel text mapping");
+_Static_assert(((VMM_VMALLOC_BASE >> 39) & 0x1FFULL) == VMM_VMALLOC_PML4_INDEX,
+               "VMM layout mismatch: vmalloc base and PML4 index disagree");
+_Static_assert(VMM_MMIO_BASE < VMM_VMALLOC_BASE && VMM_VMALLOC_BASE + VMM_VMALLOC_SIZE <= VMM_KERNEL_VIRT_BASE,
+               "VMM layout mismatch: vmalloc window must sit between MMIO and kernel text");
 
 static VMM_runtime_state_t VMM_state = {
-    .hhdm_base = VMM_HHDM_BASE
+    .hhdm_base = VMM_HHDM_BASE,
+    .pcid_gen = 1
 };
 
 static uintptr_t canonical_address(uintptr_t addr)
@@ -42,7 +49,21 @@ static inline void VMM_cpuid_leaf(uint32_t leaf, uint32_t* eax, uint32_t* edx)
         *edx = out_edx;
 }
 
-static bool VMM_is_nx_supported(void)
+static inline void VMM_cpuid_subleaf(uint32_t leaf, uint32_t subleaf, uint32_t* ebx, uint32_t* ecx)
+{
+    uint32_t out_ebx = 0;
+    uint32_t out_ecx = 0;
+    __asm__ __volatile__("cpuid"
+                         : "=b"(out_ebx), "=c"(out_ecx)
+                         : "a"(leaf), "c"(subleaf)
+                         : "edx");
+    if (ebx)
+        *ebx = out_ebx;
+    if (ecx)
+        *ecx = out_ecx;
+}
+
+bool VMM_is_nx_supported(void)
 {
     if (VMM_state.nx_checked)
         return VMM_state.nx_supported;
@@ -81,6 +102,17 @@ void VMM_enable_nx_current_cpu(void)
     MSR_set(IA32_EFER, efer | IA32_EFER_NXE);
 }
 
+/*
+ * Limine hands the BSP over with CR0.WP set, the AP trampoline does not. Direct user copies
+ * rely on it: a kernel write to a read-only or COW user page must fault like a user one.
+ */
+void VMM_enable_wp_current_cpu(void)
+{
+    uint64_t cr0 = x86_read_cr0();
+    if ((cr0 & VMM_CR0_WP) == 0)
+        x86_write_cr0(cr0 | VMM_CR0_WP);
+}
+
 uintptr_t VMM_get_hhdm_base(void)
 {
     return VMM_state.hhdm_base;
@@ -126,7 +158,7 @@ uintptr_t VMM_phys_to_hhdm_addr(uintptr_t phys)
 
 static bool VMM_is_mmio_window_addr(uintptr_t virt)
 {
-    return virt >= VMM_MMIO_BASE && virt < VMM_KERNEL_VIRT_BASE;
+    return virt >= VMM_MMIO_BASE && virt < VMM_VMALLOC_BASE;
 }
 
 static bool VMM_is_mmio_window_range(uintptr_t virt, size_t len)
@@ -229,6 +261,85 @@ static bool VMM_interrupts_enabled(void)
     return (rflags & (1ULL << 9)) != 0;
 }
 
+static inline void VMM_invpcid(uint64_t type, uint64_t pcid, uintptr_t virt)
+{
+    struct
+    {
+        uint64_t pcid;
+        uint64_t addr;
+    } __attribute__((packed)) desc = { pcid, virt };
+    __asm__ __volatile__("invpcid %0, %1" : : "m"(desc), "r"(type) : "memory");
+}
+
+static inline uintptr_t VMM_read_cr3_raw(void)
+{
+    uintptr_t cr3 = 0;
+    __asm__ __volatile__("mov %%cr3, %0" : "=r"(cr3));
+    return cr3;
+}
+
+/*
+ * An address space changed under its own PCID on this CPU (the caller flushes that one):
+ * every other CPU that still has it tagged must flush before using the tag again.
+ */
+static void VMM_pcid_mark_stale_remote(uintptr_t cr3_phys, uint32_t self_cpu)
+{
+    uint32_t limit = __atomic_load_n(&VMM_state.pcid_cpu_limit, __ATOMIC_ACQUIRE);
+    for (uint32_t cpu = 0; cpu < limit; cpu++)
+    {
+        if (cpu == self_cpu)
+            continue;
+
+        VMM_pcid_cpu_t* pcid_cpu = &VMM_state.pcid_cpu[cpu];
+        for (uint32_t slot = 0; slot < VMM_PCID_SLOTS; slot++)
+        {
+            if (__atomic_load_n(&pcid_cpu->slots[slot].cr3_phys, __ATOMIC_ACQUIRE) == cr3_phys)
+                __atomic_store_n(&pcid_cpu->slots[slot].gen, 0, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static void VMM_pcid_invalidate_page(uintptr_t virt)
+{
+    if (__atomic_load_n(&VMM_state.pcid_cpu_limit, __ATOMIC_ACQUIRE) == 0)
+        return;
+
+    // Kernel mappings are shared by every address space: age all tags at once.
+    if (virt > VMM_USER_SPACE_MAX)
+    {
+        VMM_pcid_invalidate_all();
+        return;
+    }
+
+    __atomic_fetch_add(&VMM_state.pcid_as_invalidations, 1, __ATOMIC_RELAXED);
+    VMM_pcid_mark_stale_remote(VMM_read_cr3_raw() & FRAME, task_get_current_cpu_index());
+}
+
+// Drop every non-global entry of the context this CPU runs in, and only that one.
+static void VMM_flush_live_context(void)
+{
+    uintptr_t live = VMM_read_cr3_raw();
+    if (VMM_state.invpcid_supported && (live & VMM_CR3_PCID_MASK) != 0)
+        VMM_invpcid(VMM_INVPCID_SINGLE, live & VMM_CR3_PCID_MASK, 0);
+    else
+        __asm__ __volatile__("mov %0, %%cr3" : : "r"(live) : "memory");
+}
+
+/*
+ * Remote half of a flush: user pages go only to CPUs running this address space. The
+ * fence orders the page-table writes before the scan of what the other CPUs have loaded,
+ * against VMM_switch_cr3 publishing its CR3 before it walks the new tables.
+ */
+static void VMM_tlb_shootdown_remote(uintptr_t page, size_t page_count)
+{
+    if (!VMM_interrupts_enabled())
+        return;
+
+    uintptr_t cr3_phys = (page > VMM_USER_SPACE_MAX) ? 0 : (VMM_read_cr3_raw() & FRAME);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    (void) SMP_tlb_shootdown_range(cr3_phys, page, page_count);
+}
+
 static void add_attribute(uintptr_t* entry, uintptr_t attribute)
 {
     *entry |= attribute;
@@ -334,7 +445,7 @@ static bool VMM_unmap_page_local(uintptr_t virt, uintptr_t* old_phys_out)
 
     PDT_t* PDT = VMM_state.recursive_active ? VMM_get_pdt(pml4_index, pdpt_index) : (PDT_t*) VMM_phys_to_hhdm(get_address(&pdpt_entry));
     uintptr_t pdt_entry = PDT->entries[pdt_index];
-    if (!is_present(&pdt_entry))
+    if (!is_present(&pdt_entry) || (pdt_entry & LARGE_PAGE) != 0)
         return false;
 
     PT_t* PT = VMM_state.recursive_active ? VMM_get_pt(pml4_index, pdpt_index, pdt_index) : (PT_t*) VMM_phys_to_hhdm(get_address(&pdt_entry));
@@ -397,6 +508,15 @@ void VMM_map_kernel(void)
     add_attribute(&recursive_entry, WRITABLE);
     VMM_state.pml4->entries[VMM_RECURSIVE_INDEX] = recursive_entry;
 
+    // User address spaces copy the kernel half of the PML4 once: the vmalloc slot must exist first.
+    PDPT_t* vmalloc_pdpt = (PDPT_t*) VMM_alloc_table();
+    if (!vmalloc_pdpt)
+        panic("VMM: failed to allocate vmalloc PDPT");
+    uintptr_t vmalloc_entry = VMM_hhdm_to_phys((uintptr_t) vmalloc_pdpt);
+    add_attribute(&vmalloc_entry, PRESENT);
+    add_attribute(&vmalloc_entry, WRITABLE);
+    VMM_state.pml4->entries[VMM_VMALLOC_PML4_INDEX] = vmalloc_entry;
+
     uint64_t kernel_pages = 0;
     for (uintptr_t phys = kernel_phys_start; phys < kernel_phys_end; phys += PHYS_PAGE_SIZE)
     {
@@ -518,7 +638,10 @@ void VMM_drop_startup_identity_map(void)
 
     bool tlb_flush_ok = true;
     if (VMM_state.cr3_loaded)
+    {
+        VMM_pcid_invalidate_all();
         tlb_flush_ok = SMP_tlb_shootdown_all();
+    }
 
     VMM_state.startup_identity_map_active = false;
     kdebug_printf("[VMM] startup identity dropped total_unmapped=%llu tlb_flush=%s\n",
@@ -628,13 +751,16 @@ void VMM_map_page_flags(uintptr_t virt, uintptr_t phys, uintptr_t flags)
 
     uintptr_t entry = phys & FRAME;
     add_attribute(&entry, page_flags);
+    uintptr_t old_entry = PT->entries[PT_INDEX(virt)];
     PT->entries[PT_INDEX(virt)] = entry;
 
+    // A non-present entry is never cached, so only a replaced mapping needs the other CPUs.
     if (VMM_state.cr3_loaded)
     {
-        VMM_invlpg(virt);
-        if (VMM_interrupts_enabled())
-            (void) SMP_tlb_shootdown_page(virt);
+        if (is_present(&old_entry))
+            VMM_flush_tlb_range(virt, 1);
+        else
+            VMM_invlpg(virt);
     }
 }
 
@@ -690,21 +816,32 @@ void VMM_map_mmio_uc_pages(uintptr_t virt, uintptr_t phys, size_t len)
 
 bool VMM_unmap_page(uintptr_t virt, uintptr_t* old_phys_out)
 {
-    uintptr_t page = virt & FRAME;
-    if (!VMM_unmap_page_local(page, old_phys_out))
+    if (!VMM_unmap_page_noflush(virt, old_phys_out))
         return FALSE;
 
-    if (VMM_state.cr3_loaded)
-    {
-        VMM_invlpg(page);
-        if (VMM_interrupts_enabled())
-            (void) SMP_tlb_shootdown_page(page);
-    }
-
+    VMM_flush_tlb_range(virt & FRAME, 1);
     return TRUE;
 }
 
+/*
+ * Clear the PTE and leave the TLBs alone: the caller batches VMM_flush_tlb_range over the
+ * pages it unmapped and must not free their frames before that flush.
+ */
+bool VMM_unmap_page_noflush(uintptr_t virt, uintptr_t* old_phys_out)
+{
+    return VMM_unmap_page_local(virt & FRAME, old_phys_out);
+}
+
 bool VMM_update_page_flags(uintptr_t virt, uintptr_t set_bits, uintptr_t clear_bits)
+{
+    if (!VMM_update_page_flags_noflush(virt, set_bits, clear_bits))
+        return FALSE;
+
+    VMM_flush_tlb_range(virt & FRAME, 1);
+    return TRUE;
+}
+
+bool VMM_update_page_flags_noflush(uintptr_t virt, uintptr_t set_bits, uintptr_t clear_bits)
 {
     uint16_t pml4_index = PML4_INDEX(virt);
     uint16_t pdpt_index = PDPT_INDEX(virt);
@@ -723,7 +860,7 @@ bool VMM_update_page_flags(uintptr_t virt, uintptr_t set_bits, uintptr_t clear_b
 
     PDT_t* PDT = VMM_state.recursive_active ? VMM_get_pdt(pml4_index, pdpt_index) : (PDT_t*) VMM_phys_to_hhdm(get_address(&pdpt_entry));
     uintptr_t pdt_entry = PDT->entries[pdt_index];
-    if (!is_present(&pdt_entry))
+    if (!is_present(&pdt_entry) || (pdt_entry & LARGE_PAGE) != 0)
         return FALSE;
 
     PT_t* PT = VMM_state.recursive_active ? VMM_get_pt(pml4_index, pdpt_index, pdt_index) : (PT_t*) VMM_phys_to_hhdm(get_address(&pdt_entry));
@@ -747,16 +884,30 @@ bool VMM_update_page_flags(uintptr_t virt, uintptr_t set_bits, uintptr_t clear_b
     entry &= ~(clear_bits & allowed_mask);
     entry |= PRESENT;
     PT->entries[pt_index] = entry;
+    return TRUE;
+}
+
+/*
+ * Flush page_count pages from virt after their PTEs changed in the current address space:
+ * here, on the other CPUs running it (one IPI each for the whole range) and in the PCID
+ * tags other CPUs keep for it. Large ranges drop the whole context instead.
+ */
+void VMM_flush_tlb_range(uintptr_t virt, size_t page_count)
+{
+    if (!VMM_state.cr3_loaded || page_count == 0)
+        return;
 
     uintptr_t page = virt & FRAME;
-    if (VMM_state.cr3_loaded)
+    VMM_pcid_invalidate_page(page);
+    if (page_count > SMP_TLB_FLUSH_ALL_PAGES)
+        VMM_flush_live_context();
+    else
     {
-        VMM_invlpg(page);
-        if (VMM_interrupts_enabled())
-            (void) SMP_tlb_shootdown_page(page);
+        for (size_t i = 0; i < page_count; i++)
+            VMM_invlpg(page + (i * PHYS_PAGE_SIZE));
     }
 
-    return TRUE;
+    VMM_tlb_shootdown_remote(page, page_count);
 }
 
 void VMM_load_cr3(void)
@@ -767,6 +918,296 @@ void VMM_load_cr3(void)
     VMM_enable_nx_current_cpu();
 }
 
+void VMM_enable_pcid_current_cpu(uint32_t cpu_index)
+{
+    if (cpu_index >= VMM_PCID_MAX_CPUS)
+        return;
+
+    // From here on every CR3 load of this CPU goes through VMM_switch_cr3.
+    __atomic_store_n(&VMM_state.tlb_cpu[cpu_index].loaded_cr3, VMM_read_cr3_raw() & FRAME, __ATOMIC_SEQ_CST);
+
+    uint32_t features_ecx = 0;
+    VMM_cpuid_subleaf(1U, 0U, NULL, &features_ecx);
+    bool pcid = (features_ecx & (1U << 17)) != 0;
+    if (!pcid)
+    {
+        kdebug_printf("[VMM] cpu=%u PCID not supported, CR3 writes flush the TLB\n", cpu_index);
+        return;
+    }
+
+    uint32_t max_leaf = 0;
+    VMM_cpuid_leaf(0U, &max_leaf, NULL);
+    uint32_t ext_features_ebx = 0;
+    if (max_leaf >= 7U)
+        VMM_cpuid_subleaf(7U, 0U, &ext_features_ebx, NULL);
+
+    // CR4.PCIDE can only be set while the live CR3 uses PCID 0.
+    uintptr_t cr3 = VMM_read_cr3_raw();
+    if ((cr3 & VMM_CR3_PCID_MASK) != 0)
+        __asm__ __volatile__("mov %0, %%cr3" : : "r"(cr3 & FRAME) : "memory");
+    x86_write_cr4(x86_read_cr4() | VMM_CR4_PCIDE);
+
+    VMM_pcid_cpu_t* pcid_cpu = &VMM_state.pcid_cpu[cpu_index];
+    memset(pcid_cpu, 0, sizeof(*pcid_cpu));
+    pcid_cpu->enabled = true;
+
+    VMM_state.pcid_supported = true;
+    if (cpu_index == 0)
+        VMM_state.invpcid_supported = (ext_features_ebx & (1U << 10)) != 0;
+    else if ((ext_features_ebx & (1U << 10)) == 0)
+        VMM_state.invpcid_supported = false;
+
+    uint32_t limit = __atomic_load_n(&VMM_state.pcid_cpu_limit, __ATOMIC_RELAXED);
+    while (limit < cpu_index + 1U &&
+           !__atomic_compare_exchange_n(&VMM_state.pcid_cpu_limit, &limit, cpu_index + 1U, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        ;
+
+    kdebug_printf("[VMM] cpu=%u PCID on slots=%u invpcid=%s\n",
+                  cpu_index,
+                  VMM_PCID_SLOTS,
+                  VMM_state.invpcid_supported ? "on" : "off");
+}
+
+/*
+ * Load cr3_phys on cpu_index under the PCID this CPU tagged it with. The TLB entries of
+ * that PCID are kept when its slot is still at the current flush generation; a new slot
+ * (free or taken round-robin from another address space) is flushed by the load itself.
+ */
+void VMM_switch_cr3(uint32_t cpu_index, uintptr_t cr3_phys)
+{
+    cr3_phys &= FRAME;
+    if (cpu_index < VMM_PCID_MAX_CPUS)
+        __atomic_store_n(&VMM_state.tlb_cpu[cpu_index].loaded_cr3, cr3_phys, __ATOMIC_SEQ_CST);
+    if (cpu_index >= VMM_PCID_MAX_CPUS || !VMM_state.pcid_cpu[cpu_index].enabled)
+    {
+        __asm__ __volatile__("mov %0, %%cr3" : : "r"(cr3_phys) : "memory");
+        return;
+    }
+
+    VMM_pcid_cpu_t* pcid_cpu = &VMM_state.pcid_cpu[cpu_index];
+    uint64_t gen = __atomic_load_n(&VMM_state.pcid_gen, __ATOMIC_ACQUIRE);
+    pcid_cpu->cr3_switches++;
+
+    uint32_t free_slot = VMM_PCID_SLOTS;
+    for (uint32_t slot = 0; slot < VMM_PCID_SLOTS; slot++)
+    {
+        uintptr_t tagged = __atomic_load_n(&pcid_cpu->slots[slot].cr3_phys, __ATOMIC_ACQUIRE);
+        if (tagged == cr3_phys)
+        {
+            uint64_t value = cr3_phys | (uint64_t) (slot + 1U);
+            if (__atomic_load_n(&pcid_cpu->slots[slot].gen, __ATOMIC_ACQUIRE) == gen)
+            {
+                value |= VMM_CR3_NOFLUSH;
+                pcid_cpu->cr3_noflush++;
+            }
+            else
+            {
+                __atomic_store_n(&pcid_cpu->slots[slot].gen, gen, __ATOMIC_RELEASE);
+                pcid_cpu->cr3_flush++;
+            }
+            __asm__ __volatile__("mov %0, %%cr3" : : "r"(value) : "memory");
+            return;
+        }
+
+        if (tagged == 0 && free_slot == VMM_PCID_SLOTS)
+            free_slot = slot;
+    }
+
+    uint32_t slot = free_slot;
+    if (slot == VMM_PCID_SLOTS)
+    {
+        slot = pcid_cpu->next_victim;
+        pcid_cpu->next_victim = (slot + 1U) % VMM_PCID_SLOTS;
+        pcid_cpu->recycles++;
+    }
+
+    __atomic_store_n(&pcid_cpu->slots[slot].cr3_phys, cr3_phys, __ATOMIC_RELEASE);
+    __atomic_store_n(&pcid_cpu->slots[slot].gen, gen, __ATOMIC_RELEASE);
+    pcid_cpu->cr3_flush++;
+    __asm__ __volatile__("mov %0, %%cr3" : : "r"(cr3_phys | (uint64_t) (slot + 1U)) : "memory");
+}
+
+/*
+ * Page tables of cr3_phys were edited in place: flush it here if live, on the other CPUs
+ * running it, and untag it everywhere else.
+ */
+void VMM_flush_address_space(uintptr_t cr3_phys)
+{
+    cr3_phys &= FRAME;
+    uint32_t self_cpu = task_get_current_cpu_index();
+    if ((VMM_read_cr3_raw() & FRAME) == cr3_phys)
+        VMM_flush_live_context();
+    else
+        self_cpu = VMM_PCID_MAX_CPUS;
+
+    if (__atomic_load_n(&VMM_state.pcid_cpu_limit, __ATOMIC_ACQUIRE) != 0)
+    {
+        __atomic_fetch_add(&VMM_state.pcid_as_invalidations, 1, __ATOMIC_RELAXED);
+        VMM_pcid_mark_stale_remote(cr3_phys, self_cpu);
+    }
+
+    if (VMM_interrupts_enabled())
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        (void) SMP_tlb_shootdown_address_space(cr3_phys);
+    }
+}
+
+/*
+ * cr3_phys is about to be freed: its frame may come back as another address space. Idle
+ * CPUs that still have it loaded are moved to the kernel tables first, so no page walk can
+ * reach the freed ones.
+ */
+void VMM_forget_address_space(uintptr_t cr3_phys)
+{
+    cr3_phys &= FRAME;
+    VMM_tlb_release_address_space(task_get_current_cpu_index(), cr3_phys);
+    if (VMM_interrupts_enabled())
+        (void) SMP_tlb_release_address_space(cr3_phys);
+
+    uint32_t limit = __atomic_load_n(&VMM_state.pcid_cpu_limit, __ATOMIC_ACQUIRE);
+    for (uint32_t cpu = 0; cpu < limit; cpu++)
+    {
+        VMM_pcid_cpu_t* pcid_cpu = &VMM_state.pcid_cpu[cpu];
+        for (uint32_t slot = 0; slot < VMM_PCID_SLOTS; slot++)
+        {
+            uintptr_t expected = cr3_phys;
+            if (__atomic_compare_exchange_n(&pcid_cpu->slots[slot].cr3_phys, &expected, 0, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+                __atomic_store_n(&pcid_cpu->slots[slot].gen, 0, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+/*
+ * Kernel mappings changed: tags on every CPU go stale by generation. With INVPCID this CPU
+ * drops every context at once and keeps its slots valid for the new generation.
+ */
+void VMM_pcid_invalidate_all(void)
+{
+    if (__atomic_load_n(&VMM_state.pcid_cpu_limit, __ATOMIC_ACQUIRE) == 0)
+        return;
+
+    __atomic_fetch_add(&VMM_state.pcid_global_invalidations, 1, __ATOMIC_RELAXED);
+    uint64_t gen = __atomic_add_fetch(&VMM_state.pcid_gen, 1, __ATOMIC_ACQ_REL);
+
+    uint32_t self_cpu = task_get_current_cpu_index();
+    if (!VMM_state.invpcid_supported || self_cpu >= VMM_PCID_MAX_CPUS ||
+        !VMM_state.pcid_cpu[self_cpu].enabled)
+        return;
+
+    VMM_pcid_cpu_t* pcid_cpu = &VMM_state.pcid_cpu[self_cpu];
+    uint64_t seen[VMM_PCID_SLOTS];
+    for (uint32_t slot = 0; slot < VMM_PCID_SLOTS; slot++)
+        seen[slot] = __atomic_load_n(&pcid_cpu->slots[slot].gen, __ATOMIC_ACQUIRE);
+
+    VMM_invpcid(VMM_INVPCID_ALL, 0, 0);
+
+    // A slot marked stale after the snapshot keeps its mark: the flush may predate that edit.
+    for (uint32_t slot = 0; slot < VMM_PCID_SLOTS; slot++)
+    {
+        uint64_t expected = seen[slot];
+        (void) __atomic_compare_exchange_n(&pcid_cpu->slots[slot].gen, &expected, gen, false,
+                                           __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    }
+}
+
+// This CPU goes idle and keeps the user address space loaded rather than switching away.
+void VMM_tlb_enter_lazy(uint32_t cpu_index)
+{
+    if (cpu_index >= VMM_PCID_MAX_CPUS)
+        return;
+
+    __atomic_store_n(&VMM_state.tlb_cpu[cpu_index].lazy, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * This CPU is about to run user code: run the flush a shootdown left for it while idle.
+ * Pairs with VMM_tlb_cpu_needs_flush: either side sees the other's store first.
+ */
+void VMM_tlb_leave_lazy(uint32_t cpu_index)
+{
+    if (cpu_index >= VMM_PCID_MAX_CPUS)
+        return;
+
+    VMM_tlb_cpu_t* tlb_cpu = &VMM_state.tlb_cpu[cpu_index];
+    if (__atomic_load_n(&tlb_cpu->lazy, __ATOMIC_RELAXED) == 0)
+        return;
+
+    __atomic_store_n(&tlb_cpu->lazy, 0, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&tlb_cpu->flush_pending, 0, __ATOMIC_SEQ_CST) != 0)
+    {
+        VMM_flush_live_context();
+        __atomic_fetch_add(&VMM_state.tlb_lazy_flushes, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Leave cr3_phys for the kernel tables if cpu_index (the running CPU) still has it loaded.
+void VMM_tlb_release_address_space(uint32_t cpu_index, uintptr_t cr3_phys)
+{
+    if (cpu_index >= VMM_PCID_MAX_CPUS || !VMM_tlb_cpu_has_loaded(cpu_index, cr3_phys))
+        return;
+
+    VMM_switch_cr3(cpu_index, VMM_state.pml4_phys);
+}
+
+bool VMM_tlb_cpu_has_loaded(uint32_t cpu_index, uintptr_t cr3_phys)
+{
+    if (cpu_index >= VMM_PCID_MAX_CPUS)
+        return false;
+
+    return __atomic_load_n(&VMM_state.tlb_cpu[cpu_index].loaded_cr3, __ATOMIC_SEQ_CST) == (cr3_phys & FRAME);
+}
+
+/*
+ * Shootdown target filter: does cpu_index have to be interrupted for a change to cr3_phys?
+ * Only if that address space is live there and the CPU is running it; an idle CPU just
+ * gets a pending flush.
+ */
+bool VMM_tlb_cpu_needs_flush(uint32_t cpu_index, uintptr_t cr3_phys)
+{
+    if (cpu_index >= VMM_PCID_MAX_CPUS)
+        return true;
+
+    VMM_tlb_cpu_t* tlb_cpu = &VMM_state.tlb_cpu[cpu_index];
+    if (__atomic_load_n(&tlb_cpu->loaded_cr3, __ATOMIC_SEQ_CST) != (cr3_phys & FRAME))
+        return false;
+    if (__atomic_load_n(&tlb_cpu->lazy, __ATOMIC_SEQ_CST) == 0)
+        return true;
+
+    __atomic_store_n(&tlb_cpu->flush_pending, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&tlb_cpu->lazy, __ATOMIC_SEQ_CST) == 0)
+        return true;
+
+    __atomic_fetch_add(&VMM_state.tlb_lazy_skips, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+void VMM_get_pcid_stats(VMM_pcid_stats_t* out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+    out->enabled = VMM_state.pcid_supported;
+    out->invpcid = VMM_state.invpcid_supported;
+    out->as_invalidations = __atomic_load_n(&VMM_state.pcid_as_invalidations, __ATOMIC_RELAXED);
+    out->global_invalidations = __atomic_load_n(&VMM_state.pcid_global_invalidations, __ATOMIC_RELAXED);
+    out->lazy_skips = __atomic_load_n(&VMM_state.tlb_lazy_skips, __ATOMIC_RELAXED);
+    out->lazy_flushes = __atomic_load_n(&VMM_state.tlb_lazy_flushes, __ATOMIC_RELAXED);
+
+    uint32_t limit = __atomic_load_n(&VMM_state.pcid_cpu_limit, __ATOMIC_ACQUIRE);
+    for (uint32_t cpu = 0; cpu < limit; cpu++)
+    {
+        const VMM_pcid_cpu_t* pcid_cpu = &VMM_state.pcid_cpu[cpu];
+        out->cr3_switches += __atomic_load_n(&pcid_cpu->cr3_switches, __ATOMIC_RELAXED);
+        out->cr3_noflush += __atomic_load_n(&pcid_cpu->cr3_noflush, __ATOMIC_RELAXED);
+        out->cr3_flush += __atomic_load_n(&pcid_cpu->cr3_flush, __ATOMIC_RELAXED);
+        out->recycles += __atomic_load_n(&pcid_cpu->recycles, __ATOMIC_RELAXED);
+    }
+}
+
 bool VMM_virt_to_phys(uintptr_t virt, uintptr_t* phys_out)
 {
     uint16_t pml4_index = PML4_INDEX(virt);
@@ -788,6 +1229,11 @@ bool VMM_virt_to_phys(uintptr_t virt, uintptr_t* phys_out)
     uintptr_t pdt_entry = PDT->entries[pdt_index];
     if (!is_present(&pdt_entry))
         return FALSE;
+    if ((pdt_entry & LARGE_PAGE) != 0)
+    {
+        *phys_out = (pdt_entry & LARGE_FRAME) | (virt & (LARGE_PAGE_SIZE - 1U));
+        return TRUE;
+    }
 
     PT_t* PT = VMM_state.recursive_active ? VMM_get_pt(pml4_index, pdpt_index, pdt_index) : (PT_t*) VMM_phys_to_hhdm(get_address(&pdt_entry));
     uintptr_t pt_entry = PT->entries[pt_index];
@@ -819,6 +1265,8 @@ bool VMM_is_user_accessible(uintptr_t virt)
     uintptr_t pdt_entry = PDT->entries[pdt_index];
     if (!is_present(&pdt_entry) || (pdt_entry & USER_MODE) == 0)
         return FALSE;
+    if ((pdt_entry & LARGE_PAGE) != 0)
+        return TRUE;
 
     PT_t* PT = VMM_state.recursive_active ? VMM_get_pt(pml4_index, pdpt_index, pdt_index) : (PT_t*) VMM_phys_to_hhdm(get_address(&pdt_entry));
     uintptr_t pt_entry = PT->entries[pt_index];
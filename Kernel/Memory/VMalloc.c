@@ -0,0 +1,345 @@
+#include <Memory/VMalloc.h>
+#include <Memory/VMalloc_private.h>
+
+#include <Memory/PMM.h>
+#include <Memory/VMM.h>
+#include <Debug/KDebug.h>
+
+#include <string.h>
+#include <stdint.h>
+
+static VMALLOC_runtime_state_t VMALLOC_state;
+
+static bool vmalloc_interrupts_enabled(void)
+{
+    uint64_t rflags = 0;
+    __asm__ __volatile__("pushfq\n\tpopq %0" : "=r"(rflags));
+    return (rflags & (1ULL << 9)) != 0;
+}
+
+// Slots with span_pages == 0 are unused and taken before the table grows.
+static VMALLOC_area_t* vmalloc_new_slot_locked(void)
+{
+    for (uint32_t i = 0; i < VMALLOC_state.area_count; i++)
+    {
+        if (VMALLOC_state.areas[i].span_pages == 0)
+            return &VMALLOC_state.areas[i];
+    }
+
+    if (VMALLOC_state.area_count >= VMALLOC_AREA_MAX)
+        return NULL;
+
+    return &VMALLOC_state.areas[VMALLOC_state.area_count++];
+}
+
+/*
+ * First fit over the freed ranges, splitting off the tail when a slot is left for it,
+ * then the bump pointer. The window is never handed back to the page tables: its
+ * intermediate tables stay, so reusing a range only rewrites leaf entries.
+ */
+static VMALLOC_area_t* vmalloc_reserve_locked(size_t span_pages)
+{
+    for (uint32_t i = 0; i < VMALLOC_state.area_count; i++)
+    {
+        VMALLOC_area_t* area = &VMALLOC_state.areas[i];
+        if (area->span_pages < span_pages || area->state != VMALLOC_AREA_FREE)
+            continue;
+
+        if (area->span_pages > span_pages)
+        {
+            VMALLOC_area_t* rest = vmalloc_new_slot_locked();
+            if (rest)
+            {
+                rest->base = area->base + (span_pages * PHYS_PAGE_SIZE);
+                rest->span_pages = area->span_pages - span_pages;
+                rest->mapped_pages = 0;
+                rest->size = 0;
+                rest->state = VMALLOC_AREA_FREE;
+                area->span_pages = span_pages;
+            }
+        }
+
+        area->state = VMALLOC_AREA_USED;
+        return area;
+    }
+
+    uintptr_t window_end = VMM_VMALLOC_BASE + VMM_VMALLOC_SIZE;
+    if (span_pages > (window_end - VMALLOC_state.next) / PHYS_PAGE_SIZE)
+        return NULL;
+
+    VMALLOC_area_t* area = vmalloc_new_slot_locked();
+    if (!area)
+        return NULL;
+
+    area->base = VMALLOC_state.next;
+    area->span_pages = span_pages;
+    area->mapped_pages = 0;
+    area->size = 0;
+    area->state = VMALLOC_AREA_USED;
+    VMALLOC_state.next += span_pages * PHYS_PAGE_SIZE;
+    return area;
+}
+
+static VMALLOC_area_t* vmalloc_find_locked(uintptr_t base)
+{
+    for (uint32_t i = 0; i < VMALLOC_state.area_count; i++)
+    {
+        VMALLOC_area_t* area = &VMALLOC_state.areas[i];
+        if (area->span_pages != 0 && area->base == base)
+            return area;
+    }
+
+    return NULL;
+}
+
+// Fold a free range into its free neighbours, and into the bump pointer when it is the last one.
+static void vmalloc_merge_locked(VMALLOC_area_t* area)
+{
+    for (uint32_t i = 0; i < VMALLOC_state.area_count; i++)
+    {
+        VMALLOC_area_t* other = &VMALLOC_state.areas[i];
+        if (other == area || other->span_pages == 0 || other->state != VMALLOC_AREA_FREE)
+            continue;
+
+        if (other->base + (other->span_pages * PHYS_PAGE_SIZE) == area->base)
+        {
+            other->span_pages += area->span_pages;
+            area->span_pages = 0;
+            area = other;
+            i = (uint32_t) -1;      // The grown range may now touch another neighbour.
+        }
+        else if (area->base + (area->span_pages * PHYS_PAGE_SIZE) == other->base)
+        {
+            area->span_pages += other->span_pages;
+            other->span_pages = 0;
+            i = (uint32_t) -1;
+        }
+    }
+
+    if (area->base + (area->span_pages * PHYS_PAGE_SIZE) == VMALLOC_state.next)
+    {
+        VMALLOC_state.next = area->base;
+        area->span_pages = 0;
+    }
+
+    while (VMALLOC_state.area_count > 0 && VMALLOC_state.areas[VMALLOC_state.area_count - 1].span_pages == 0)
+        VMALLOC_state.area_count--;
+}
+
+/*
+ * Unmap an area and give its frames back. The frames are freed only after each batch has
+ * been flushed everywhere, so this runs with interrupts on and without the lock held: the
+ * area is already marked so nobody else touches its entries meanwhile.
+ */
+static void vmalloc_release_area(VMALLOC_area_t* area)
+{
+    uintptr_t base = area->base;
+    size_t pages = area->mapped_pages;
+    uintptr_t frames[VMALLOC_UNMAP_BATCH];
+
+    for (size_t done = 0; done < pages;)
+    {
+        size_t batch = pages - done;
+        if (batch > VMALLOC_UNMAP_BATCH)
+            batch = VMALLOC_UNMAP_BATCH;
+
+        uintptr_t virt = base + (done * PHYS_PAGE_SIZE);
+        size_t frame_count = 0;
+        for (size_t i = 0; i < batch; i++)
+        {
+            uintptr_t phys = 0;
+            if (VMM_unmap_page_noflush(virt + (i * PHYS_PAGE_SIZE), &phys) && phys != 0)
+                frames[frame_count++] = phys;
+        }
+
+        VMM_flush_tlb_range(virt, batch);
+        for (size_t i = 0; i < frame_count; i++)
+            PMM_dealloc_page((void*) frames[i]);
+
+        done += batch;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&VMALLOC_state.lock);
+    VMALLOC_state.mapped_pages -= pages;
+    area->mapped_pages = 0;
+    area->size = 0;
+    area->state = VMALLOC_AREA_FREE;
+    vmalloc_merge_locked(area);
+    spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+}
+
+static void vmalloc_reap_deferred(void)
+{
+    if (!vmalloc_interrupts_enabled())
+        return;
+
+    for (;;)
+    {
+        VMALLOC_area_t* victim = NULL;
+        uint64_t flags = spin_lock_irqsave(&VMALLOC_state.lock);
+        for (uint32_t i = 0; i < VMALLOC_state.area_count; i++)
+        {
+            VMALLOC_area_t* area = &VMALLOC_state.areas[i];
+            if (area->span_pages != 0 && area->state == VMALLOC_AREA_DEFERRED)
+            {
+                area->state = VMALLOC_AREA_RELEASING;
+                victim = area;
+                break;
+            }
+        }
+        spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+
+        if (!victim)
+            return;
+
+        vmalloc_release_area(victim);
+    }
+}
+
+// The window's PML4 slot is created by VMM_map_kernel; this only opens it once CR3 is live.
+void vmalloc_init(void)
+{
+    spinlock_init(&VMALLOC_state.lock);
+    VMALLOC_state.next = VMM_VMALLOC_BASE;
+    VMALLOC_state.area_count = 0;
+    __atomic_store_n(&VMALLOC_state.ready, true, __ATOMIC_RELEASE);
+
+    kdebug_printf("[VMALLOC] window [0x%llX..0x%llX) areas=%u\n",
+                  (unsigned long long) VMM_VMALLOC_BASE,
+                  (unsigned long long) (VMM_VMALLOC_BASE + VMM_VMALLOC_SIZE),
+                  VMALLOC_AREA_MAX);
+}
+
+bool vmalloc_is_ready(void)
+{
+    return __atomic_load_n(&VMALLOC_state.ready, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Page-granular, virtually contiguous kernel memory backed by single frames, for buffers
+ * too large to want a physically contiguous block. Not for DMA that assumes contiguity.
+ */
+void* vmalloc(size_t size)
+{
+    if (size == 0 || !vmalloc_is_ready())
+        return NULL;
+
+    size_t pages = (size + PHYS_PAGE_SIZE - 1U) / PHYS_PAGE_SIZE;
+    if (pages > (VMM_VMALLOC_SIZE / PHYS_PAGE_SIZE))
+        return NULL;
+
+    vmalloc_reap_deferred();
+
+    uint64_t flags = spin_lock_irqsave(&VMALLOC_state.lock);
+    VMALLOC_area_t* area = vmalloc_reserve_locked(pages + VMALLOC_GUARD_PAGES);
+    if (!area)
+    {
+        VMALLOC_state.failures++;
+        spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+        return NULL;
+    }
+
+    // Mapping stays under the lock: new page tables in the window must not be built twice.
+    area->size = size;
+    for (size_t i = 0; i < pages; i++)
+    {
+        uintptr_t phys = (uintptr_t) PMM_alloc_page();
+        if (phys == 0)
+            break;
+
+        VMM_map_page_flags(area->base + (i * PHYS_PAGE_SIZE), phys, NO_EXECUTE);
+        area->mapped_pages++;
+    }
+    VMALLOC_state.mapped_pages += area->mapped_pages;
+
+    if (area->mapped_pages != pages)
+    {
+        VMALLOC_state.failures++;
+        bool release_now = (flags & (1ULL << 9)) != 0;
+        area->state = release_now ? VMALLOC_AREA_RELEASING : VMALLOC_AREA_DEFERRED;
+        spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+        if (release_now)
+            vmalloc_release_area(area);
+        return NULL;
+    }
+
+    VMALLOC_state.allocs++;
+    spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+    return (void*) area->base;
+}
+
+void vfree(void* ptr)
+{
+    if (!ptr || !vmalloc_is_ready())
+        return;
+
+    bool release_now = vmalloc_interrupts_enabled();
+    uint64_t flags = spin_lock_irqsave(&VMALLOC_state.lock);
+    VMALLOC_area_t* area = vmalloc_find_locked((uintptr_t) ptr);
+    if (!area || area->state != VMALLOC_AREA_USED)
+    {
+        spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+        kdebug_printf("[VMALLOC] bad vfree ptr=0x%llX\n", (unsigned long long) (uintptr_t) ptr);
+        return;
+    }
+
+    // Without interrupts the remote flush cannot run: keep the pages until a later call.
+    area->state = release_now ? VMALLOC_AREA_RELEASING : VMALLOC_AREA_DEFERRED;
+    VMALLOC_state.frees++;
+    spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+
+    if (release_now)
+    {
+        vmalloc_release_area(area);
+        vmalloc_reap_deferred();
+    }
+}
+
+bool vmalloc_owns(const void* ptr)
+{
+    uintptr_t addr = (uintptr_t) ptr;
+    return addr >= VMM_VMALLOC_BASE && addr - VMM_VMALLOC_BASE < VMM_VMALLOC_SIZE;
+}
+
+size_t vmalloc_size(const void* ptr)
+{
+    if (!ptr || !vmalloc_is_ready())
+        return 0;
+
+    size_t size = 0;
+    uint64_t flags = spin_lock_irqsave(&VMALLOC_state.lock);
+    VMALLOC_area_t* area = vmalloc_find_locked((uintptr_t) ptr);
+    if (area && area->state == VMALLOC_AREA_USED)
+        size = area->size;
+    spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+    return size;
+}
+
+void vmalloc_get_stats(VMALLOC_stats_t* out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof (*out));
+    if (!vmalloc_is_ready())
+        return;
+
+    uint64_t flags = spin_lock_irqsave(&VMALLOC_state.lock);
+    for (uint32_t i = 0; i < VMALLOC_state.area_count; i++)
+    {
+        const VMALLOC_area_t* area = &VMALLOC_state.areas[i];
+        if (area->span_pages == 0)
+            continue;
+
+        if (area->state == VMALLOC_AREA_FREE)
+            out->free_areas++;
+        else
+            out->areas++;
+    }
+    out->mapped_pages = VMALLOC_state.mapped_pages;
+    out->window_used = VMALLOC_state.next - VMM_VMALLOC_BASE;
+    out->allocs = VMALLOC_state.allocs;
+    out->frees = VMALLOC_state.frees;
+    out->failures = VMALLOC_state.failures;
+    spin_unlock_irqrestore(&VMALLOC_state.lock, flags);
+}
@@ -0,0 +1,419 @@
+#include <Memory/ZSwap.h>
+#include <Memory/ZSwap_private.h>
+
+#include <Memory/KMem.h>
+#include <Memory/PMM.h>
+#include <Memory/VMalloc.h>
+#include <Debug/KDebug.h>
+
+#include <string.h>
+#include <stdint.h>
+
+static ZSWAP_runtime_state_t ZSWAP_state;
+
+static inline uint32_t zswap_read32(const uint8_t* ptr)
+{
+    uint32_t value = 0;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint32_t zswap_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32U - ZSWAP_LZ4_HASH_BITS);
+}
+
+// Length continuation bytes of the LZ4 block format: 255 while more follows, then the rest.
+static bool zswap_put_length(uint8_t* dst, uint32_t* op, uint32_t cap, uint32_t len)
+{
+    while (len >= 255U)
+    {
+        if (*op >= cap)
+            return false;
+        dst[(*op)++] = 255U;
+        len -= 255U;
+    }
+
+    if (*op >= cap)
+        return false;
+    dst[(*op)++] = (uint8_t) len;
+    return true;
+}
+
+// One sequence: token, literals, then the match unless match_len is 0 (the last sequence).
+static bool zswap_put_sequence(uint8_t* dst,
+                               uint32_t* op,
+                               uint32_t cap,
+                               const uint8_t* literals,
+                               uint32_t literal_len,
+                               uint32_t offset,
+                               uint32_t match_len)
+{
+    if (*op >= cap)
+        return false;
+
+    uint32_t token_at = (*op)++;
+    uint8_t token = (uint8_t) ((literal_len >= 15U ? 15U : literal_len) << 4);
+    if (literal_len >= 15U && !zswap_put_length(dst, op, cap, literal_len - 15U))
+        return false;
+    if (literal_len > cap - *op)
+        return false;
+
+    memcpy(dst + *op, literals, literal_len);
+    *op += literal_len;
+
+    if (match_len != 0)
+    {
+        if (cap - *op < 2U)
+            return false;
+        dst[(*op)++] = (uint8_t) (offset & 0xFFU);
+        dst[(*op)++] = (uint8_t) (offset >> 8);
+
+        uint32_t extra = match_len - ZSWAP_LZ4_MIN_MATCH;
+        token |= (uint8_t) (extra >= 15U ? 15U : extra);
+        if (extra >= 15U && !zswap_put_length(dst, op, cap, extra - 15U))
+            return false;
+    }
+
+    dst[token_at] = token;
+    return true;
+}
+
+/*
+ * Greedy LZ4 over one page, a single hash probe per position: the output is a standard LZ4
+ * block. Returns its size, or 0 when it does not fit in cap.
+ */
+static uint32_t zswap_compress(const uint8_t* src, uint8_t* dst, uint32_t cap)
+{
+    uint16_t table[1U << ZSWAP_LZ4_HASH_BITS];     // Position + 1 of the last sequence per hash.
+    memset(table, 0, sizeof(table));
+
+    const uint32_t match_limit = ZSWAP_PAGE_SIZE - ZSWAP_LZ4_MFLIMIT;
+    const uint32_t match_end = ZSWAP_PAGE_SIZE - ZSWAP_LZ4_LAST_LITERALS;
+    uint32_t ip = 0;
+    uint32_t anchor = 0;
+    uint32_t op = 0;
+    while (ip < match_limit)
+    {
+        uint32_t sequence = zswap_read32(src + ip);
+        uint32_t hash = zswap_hash(sequence);
+        uint32_t ref = table[hash];
+        table[hash] = (uint16_t) (ip + 1U);
+        if (ref == 0 || zswap_read32(src + ref - 1U) != sequence)
+        {
+            ip++;
+            continue;
+        }
+
+        uint32_t match = ref - 1U;
+        uint32_t len = ZSWAP_LZ4_MIN_MATCH;
+        while (ip + len < match_end && src[match + len] == src[ip + len])
+            len++;
+
+        if (!zswap_put_sequence(dst, &op, cap, src + anchor, ip - anchor, ip - match, len))
+            return 0;
+        ip += len;
+        anchor = ip;
+    }
+
+    if (!zswap_put_sequence(dst, &op, cap, src + anchor, ZSWAP_PAGE_SIZE - anchor, 0, 0))
+        return 0;
+    return op;
+}
+
+static bool zswap_get_length(const uint8_t* src, uint32_t len, uint32_t* ip, uint32_t* value)
+{
+    uint8_t byte = 0;
+    do
+    {
+        if (*ip >= len)
+            return false;
+        byte = src[(*ip)++];
+        *value += byte;
+    } while (byte == 255U);
+
+    return true;
+}
+
+// Bounds are checked anyway: a corrupted slot fails the swap-in instead of scribbling.
+static bool zswap_decompress(const uint8_t* src, uint32_t len, uint8_t* dst)
+{
+    uint32_t ip = 0;
+    uint32_t op = 0;
+    while (ip < len)
+    {
+        uint8_t token = src[ip++];
+        uint32_t literal_len = token >> 4;
+        if (literal_len == 15U && !zswap_get_length(src, len, &ip, &literal_len))
+            return false;
+        if (literal_len > len - ip || literal_len > ZSWAP_PAGE_SIZE - op)
+            return false;
+
+        memcpy(dst + op, src + ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+        if (ip == len)
+            break;
+
+        if (len - ip < 2U)
+            return false;
+        uint32_t offset = (uint32_t) src[ip] | ((uint32_t) src[ip + 1U] << 8);
+        ip += 2U;
+
+        uint32_t match_len = token & 15U;
+        if (match_len == 15U && !zswap_get_length(src, len, &ip, &match_len))
+            return false;
+        match_len += ZSWAP_LZ4_MIN_MATCH;
+        if (offset == 0 || offset > op || match_len > ZSWAP_PAGE_SIZE - op)
+            return false;
+
+        // Byte by byte: a match may overlap the bytes it produces.
+        for (uint32_t i = 0; i < match_len; i++, op++)
+            dst[op] = dst[op - offset];
+    }
+
+    return op == ZSWAP_PAGE_SIZE;
+}
+
+static bool zswap_page_fill(const void* page, uint64_t* out_word)
+{
+    const uint64_t* words = (const uint64_t*) page;
+    for (uint32_t i = 1; i < ZSWAP_PAGE_SIZE / sizeof(uint64_t); i++)
+    {
+        if (words[i] != words[0])
+            return false;
+    }
+
+    *out_word = words[0];
+    return true;
+}
+
+// The slot table is sized from physical memory on the first store, so an idle pool costs nothing.
+static bool zswap_table_init(void)
+{
+    if (__atomic_load_n(&ZSWAP_state.ready, __ATOMIC_ACQUIRE))
+        return true;
+
+    uint64_t total_pages = PMM_get_total_page_count();
+    uint64_t capacity = total_pages >> ZSWAP_SLOT_SHIFT;
+    if (capacity > ZSWAP_SLOT_LIMIT)
+        capacity = ZSWAP_SLOT_LIMIT;
+    if (capacity < 2U)
+        return false;
+
+    ZSWAP_slot_t* slots = (ZSWAP_slot_t*) vmalloc((size_t) capacity * sizeof(ZSWAP_slot_t));
+    if (!slots)
+        return false;
+    memset(slots, 0, (size_t) capacity * sizeof(ZSWAP_slot_t));
+
+    uint64_t flags = spin_lock_irqsave(&ZSWAP_state.lock);
+    if (!ZSWAP_state.ready)
+    {
+        ZSWAP_state.slots = slots;
+        ZSWAP_state.capacity = (uint32_t) capacity;
+        ZSWAP_state.next_unused = 1U;
+        ZSWAP_state.free_head = 0;
+        ZSWAP_state.pool_limit = (total_pages * ZSWAP_PAGE_SIZE) >> ZSWAP_POOL_SHIFT;
+        __atomic_store_n(&ZSWAP_state.ready, 1U, __ATOMIC_RELEASE);
+        slots = NULL;
+    }
+    spin_unlock_irqrestore(&ZSWAP_state.lock, flags);
+
+    if (slots)
+        vfree(slots);
+    else
+        kdebug_printf("[ZSWAP] pool ready slots=%llu limit=%llu KiB\n",
+                      (unsigned long long) capacity,
+                      (unsigned long long) (ZSWAP_state.pool_limit / 1024U));
+    return true;
+}
+
+/*
+ * Compress a page into a new slot with one reference. Fails, leaving the page to its
+ * owner, when it compresses badly, the pool is full or memory is too short for the copy.
+ */
+bool zswap_store(const void* page, uint32_t* out_slot)
+{
+    if (!page || !out_slot || !zswap_table_init())
+        return false;
+
+    uint64_t fill = 0;
+    uintptr_t data = 0;
+    uint32_t len = 0;
+    uint16_t kind = ZSWAP_SLOT_FILL;
+    if (zswap_page_fill(page, &fill))
+        data = (uintptr_t) fill;
+    else
+    {
+        uint8_t buffer[ZSWAP_MAX_STORED];
+        len = zswap_compress((const uint8_t*) page, buffer, sizeof(buffer));
+        if (len == 0)
+        {
+            __atomic_add_fetch(&ZSWAP_state.rejects, 1U, __ATOMIC_RELAXED);
+            return false;
+        }
+        if (__atomic_load_n(&ZSWAP_state.pool_bytes, __ATOMIC_RELAXED) + len > ZSWAP_state.pool_limit)
+        {
+            __atomic_add_fetch(&ZSWAP_state.failures, 1U, __ATOMIC_RELAXED);
+            return false;
+        }
+
+        void* copy = kmalloc(len);
+        if (!copy)
+        {
+            __atomic_add_fetch(&ZSWAP_state.failures, 1U, __ATOMIC_RELAXED);
+            return false;
+        }
+        memcpy(copy, buffer, len);
+        data = (uintptr_t) copy;
+        kind = ZSWAP_SLOT_DATA;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&ZSWAP_state.lock);
+    uint32_t slot = ZSWAP_state.free_head;
+    if (slot != 0)
+        ZSWAP_state.free_head = (uint32_t) ZSWAP_state.slots[slot].data;
+    else if (ZSWAP_state.next_unused < ZSWAP_state.capacity)
+        slot = ZSWAP_state.next_unused++;
+
+    if (slot != 0)
+    {
+        ZSWAP_slot_t* entry = &ZSWAP_state.slots[slot];
+        entry->data = data;
+        entry->len = len;
+        entry->refs = 1U;
+        entry->kind = kind;
+        ZSWAP_state.stored_pages++;
+        ZSWAP_state.pool_bytes += len;
+        ZSWAP_state.stores++;
+        if (kind == ZSWAP_SLOT_FILL)
+            ZSWAP_state.fill_pages++;
+    }
+    spin_unlock_irqrestore(&ZSWAP_state.lock, flags);
+
+    if (slot == 0)
+    {
+        __atomic_add_fetch(&ZSWAP_state.failures, 1U, __ATOMIC_RELAXED);
+        if (kind == ZSWAP_SLOT_DATA)
+            kfree((void*) data);
+        return false;
+    }
+
+    *out_slot = slot;
+    return true;
+}
+
+/*
+ * Decompress a slot into page without dropping the reference: the caller frees it once
+ * the page is mapped. The buffer cannot go away meanwhile, the caller's reference holds it.
+ */
+bool zswap_load(uint32_t slot, void* page)
+{
+    if (!page || !__atomic_load_n(&ZSWAP_state.ready, __ATOMIC_ACQUIRE))
+        return false;
+
+    uint64_t flags = spin_lock_irqsave(&ZSWAP_state.lock);
+    ZSWAP_slot_t entry = { 0 };
+    if (slot != 0 && slot < ZSWAP_state.next_unused)
+        entry = ZSWAP_state.slots[slot];
+    if (entry.refs != 0)
+        ZSWAP_state.loads++;
+    spin_unlock_irqrestore(&ZSWAP_state.lock, flags);
+
+    if (entry.refs == 0)
+    {
+        kdebug_printf("[ZSWAP] load of free slot %u\n", slot);
+        return false;
+    }
+
+    if (entry.kind == ZSWAP_SLOT_FILL)
+    {
+        uint64_t* words = (uint64_t*) page;
+        for (uint32_t i = 0; i < ZSWAP_PAGE_SIZE / sizeof(uint64_t); i++)
+            words[i] = (uint64_t) entry.data;
+        return true;
+    }
+
+    if (!zswap_decompress((const uint8_t*) entry.data, entry.len, (uint8_t*) page))
+    {
+        kdebug_printf("[ZSWAP] corrupted slot %u len=%u\n", slot, entry.len);
+        return false;
+    }
+
+    return true;
+}
+
+// Another PTE now refers to the slot (fork).
+bool zswap_dup(uint32_t slot)
+{
+    if (!__atomic_load_n(&ZSWAP_state.ready, __ATOMIC_ACQUIRE))
+        return false;
+
+    bool ok = false;
+    uint64_t flags = spin_lock_irqsave(&ZSWAP_state.lock);
+    if (slot != 0 && slot < ZSWAP_state.next_unused)
+    {
+        ZSWAP_slot_t* entry = &ZSWAP_state.slots[slot];
+        ok = entry->refs != 0 && entry->refs != UINT16_MAX;
+        if (ok)
+            entry->refs++;
+    }
+    spin_unlock_irqrestore(&ZSWAP_state.lock, flags);
+    return ok;
+}
+
+static void zswap_release_slot_locked(uint32_t slot, uintptr_t* out_buffer)
+{
+    ZSWAP_slot_t* entry = &ZSWAP_state.slots[slot];
+    if (entry->kind == ZSWAP_SLOT_DATA)
+        *out_buffer = entry->data;
+    else
+        ZSWAP_state.fill_pages--;
+
+    ZSWAP_state.stored_pages--;
+    ZSWAP_state.pool_bytes -= entry->len;
+    entry->kind = ZSWAP_SLOT_FREE;
+    entry->len = 0;
+    entry->data = ZSWAP_state.free_head;
+    ZSWAP_state.free_head = slot;
+}
+
+void zswap_free(uint32_t slot)
+{
+    if (!__atomic_load_n(&ZSWAP_state.ready, __ATOMIC_ACQUIRE))
+        return;
+
+    uintptr_t buffer = 0;
+    bool bad = true;
+    uint64_t flags = spin_lock_irqsave(&ZSWAP_state.lock);
+    if (slot != 0 && slot < ZSWAP_state.next_unused && ZSWAP_state.slots[slot].refs != 0)
+    {
+        bad = false;
+        if (--ZSWAP_state.slots[slot].refs == 0)
+            zswap_release_slot_locked(slot, &buffer);
+    }
+    spin_unlock_irqrestore(&ZSWAP_state.lock, flags);
+
+    if (bad)
+        kdebug_printf("[ZSWAP] bad free slot=%u\n", slot);
+    if (buffer != 0)
+        kfree((void*) buffer);
+}
+
+void zswap_get_stats(ZSWAP_stats_t* out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+    uint64_t flags = spin_lock_irqsave(&ZSWAP_state.lock);
+    out->stored_pages = ZSWAP_state.stored_pages;
+    out->fill_pages = ZSWAP_state.fill_pages;
+    out->pool_bytes = ZSWAP_state.pool_bytes;
+    out->pool_limit = ZSWAP_state.pool_limit;
+    out->stores = ZSWAP_state.stores;
+    out->loads = ZSWAP_state.loads;
+    spin_unlock_irqrestore(&ZSWAP_state.lock, flags);
+    out->rejects = __atomic_load_n(&ZSWAP_state.rejects, __ATOMIC_RELAXED);
+    out->failures = __atomic_load_n(&ZSWAP_state.failures, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,508 @@
+#include <Storage/BCache.h>
+#include <Storage/BCache_private.h>
+
+#include <Memory/KMem.h>
+#include <Memory/PMM.h>
+#include <Debug/KDebug.h>
+
+#include <string.h>
+#include <stdint.h>
+
+static BCACHE_runtime_state_t BCACHE_state;
+
+static uint32_t BCache_hash(const HBA_PORT_t* port, uint64_t lba)
+{
+    uint64_t key = lba ^ ((uint64_t) (uintptr_t) port >> 7);
+    return (uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (BCACHE_HASH_BUCKETS - 1U);
+}
+
+static bool BCache_request_valid(HBA_PORT_t* port, uint32_t size, uint32_t offset, uint32_t len)
+{
+    if (!port || !__atomic_load_n(&BCACHE_state.ready, __ATOMIC_ACQUIRE))
+        return false;
+    if (size == 0 || size > BCACHE_BLOCK_MAX || (size % AHCI_SECTOR_SIZE) != 0)
+        return false;
+
+    return offset <= size && len <= size - offset;
+}
+
+// Free memory under the PMM's low watermark shrinks the cache to its floor until it recovers.
+static uint64_t BCache_limit(void)
+{
+    uint64_t limit = (PMM_get_total_page_count() * PHYS_PAGE_SIZE) >> BCACHE_MEM_SHIFT;
+    if (limit > (uint64_t) THEOS_BCACHE_MAX_KIB * 1024U)
+        limit = (uint64_t) THEOS_BCACHE_MAX_KIB * 1024U;
+    if (PMM_get_free_page_count() < PMM_reclaim_low_watermark() || limit < BCACHE_MIN_BYTES)
+        limit = BCACHE_MIN_BYTES;
+
+    return limit;
+}
+
+static BCACHE_entry_t* BCache_find_locked(const HBA_PORT_t* port, uint64_t lba, uint32_t size)
+{
+    BCACHE_entry_t* entry = BCACHE_state.buckets[BCache_hash(port, lba)];
+    while (entry)
+    {
+        if (entry->port == port && entry->lba == lba && entry->size == size)
+            return entry;
+        entry = entry->hash_next;
+    }
+
+    return NULL;
+}
+
+static void BCache_lru_unlink_locked(BCACHE_entry_t* entry)
+{
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        BCACHE_state.lru_head = entry->lru_next;
+
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        BCACHE_state.lru_tail = entry->lru_prev;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void BCache_lru_push_locked(BCACHE_entry_t* entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = BCACHE_state.lru_head;
+    if (BCACHE_state.lru_head)
+        BCACHE_state.lru_head->lru_prev = entry;
+    else
+        BCACHE_state.lru_tail = entry;
+    BCACHE_state.lru_head = entry;
+}
+
+static void BCache_insert_locked(BCACHE_entry_t* entry)
+{
+    uint32_t bucket = BCache_hash(entry->port, entry->lba);
+    entry->hash_next = BCACHE_state.buckets[bucket];
+    BCACHE_state.buckets[bucket] = entry;
+    BCACHE_state.bucket_gen[bucket]++;
+    BCache_lru_push_locked(entry);
+    BCACHE_state.blocks++;
+    BCACHE_state.bytes += entry->size;
+}
+
+// Takes a clean entry out of the cache; the caller frees it once the lock is dropped.
+static void BCache_remove_locked(BCACHE_entry_t* entry)
+{
+    uint32_t bucket = BCache_hash(entry->port, entry->lba);
+    BCACHE_entry_t** link = &BCACHE_state.buckets[bucket];
+    while (*link && *link != entry)
+        link = &(*link)->hash_next;
+    if (*link)
+        *link = entry->hash_next;
+    BCACHE_state.bucket_gen[bucket]++;
+
+    entry->hash_next = NULL;
+    BCache_lru_unlink_locked(entry);
+    BCACHE_state.blocks--;
+    BCACHE_state.bytes -= entry->size;
+}
+
+static void BCache_mark_dirty_locked(BCACHE_entry_t* entry)
+{
+    if (entry->dirty)
+        return;
+
+    entry->dirty = 1;
+    entry->dirty_next = NULL;
+    entry->dirty_prev = BCACHE_state.dirty_tail;
+    if (BCACHE_state.dirty_tail)
+        BCACHE_state.dirty_tail->dirty_next = entry;
+    else
+        BCACHE_state.dirty_head = entry;
+    BCACHE_state.dirty_tail = entry;
+    BCACHE_state.dirty_blocks++;
+}
+
+static void BCache_clear_dirty_locked(BCACHE_entry_t* entry)
+{
+    if (!entry->dirty)
+        return;
+
+    if (entry->dirty_prev)
+        entry->dirty_prev->dirty_next = entry->dirty_next;
+    else
+        BCACHE_state.dirty_head = entry->dirty_next;
+
+    if (entry->dirty_next)
+        entry->dirty_next->dirty_prev = entry->dirty_prev;
+    else
+        BCACHE_state.dirty_tail = entry->dirty_prev;
+
+    entry->dirty = 0;
+    entry->dirty_prev = NULL;
+    entry->dirty_next = NULL;
+    BCACHE_state.dirty_blocks--;
+}
+
+// The least recently used block that can go without a disk write, or NULL.
+static BCACHE_entry_t* BCache_evict_clean_locked(void)
+{
+    for (BCACHE_entry_t* entry = BCACHE_state.lru_tail; entry; entry = entry->lru_prev)
+    {
+        if (entry->dirty || entry->writeback)
+            continue;
+
+        BCache_remove_locked(entry);
+        BCACHE_state.evictions++;
+        return entry;
+    }
+
+    return NULL;
+}
+
+static BCACHE_entry_t* BCache_entry_alloc(HBA_PORT_t* port, uint64_t lba, uint32_t size)
+{
+    BCACHE_entry_t* entry = (BCACHE_entry_t*) kmalloc(sizeof(*entry));
+    if (!entry)
+        return NULL;
+
+    memset(entry, 0, sizeof(*entry));
+    entry->data = (uint8_t*) kmalloc(size);
+    if (!entry->data)
+    {
+        kfree(entry);
+        return NULL;
+    }
+
+    entry->port = port;
+    entry->lba = lba;
+    entry->size = size;
+    return entry;
+}
+
+static void BCache_entry_free(BCACHE_entry_t* entry)
+{
+    if (!entry)
+        return;
+
+    kfree(entry->data);
+    kfree(entry);
+}
+
+// Runs without the lock: the AHCI command sleeps until its completion interrupt.
+static bool BCache_disk_io(BCACHE_entry_t* entry, bool write)
+{
+    uint32_t sectors = entry->size / AHCI_SECTOR_SIZE;
+    int status = write
+        ? AHCI_SATA_write(entry->port, (uint32_t) entry->lba, (uint32_t) (entry->lba >> 32), sectors, entry->data)
+        : AHCI_sata_read(entry->port, (uint32_t) entry->lba, (uint32_t) (entry->lba >> 32), sectors, entry->data);
+    if (status == 0)
+        return true;
+
+    if (__atomic_add_fetch(&BCACHE_state.io_errors, 1U, __ATOMIC_RELAXED) == 1U)
+        kdebug_printf("[BCACHE] %s failed lba=%llu sectors=%u\n",
+                      write ? "write" : "read",
+                      (unsigned long long) entry->lba,
+                      sectors);
+    return false;
+}
+
+/*
+ * Write the oldest dirty block of port (any port for NULL) back. The entry stays cached
+ * and readable meanwhile; a write landing during the I/O dirties it again, so the next
+ * pass sends the newer contents. Returns 1 when a block was written, 0 when none was
+ * waiting and -1 on a disk error, the block then staying dirty.
+ */
+static int BCache_writeback_one(HBA_PORT_t* port)
+{
+    uint64_t flags = spin_lock_irqsave(&BCACHE_state.lock);
+    BCACHE_entry_t* entry = BCACHE_state.dirty_head;
+    while (entry && (entry->writeback || (port && entry->port != port)))
+        entry = entry->dirty_next;
+    if (!entry)
+    {
+        spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+        return 0;
+    }
+
+    BCache_clear_dirty_locked(entry);
+    entry->writeback = 1;
+    spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+
+    bool ok = BCache_disk_io(entry, true);
+
+    flags = spin_lock_irqsave(&BCACHE_state.lock);
+    entry->writeback = 0;
+    if (ok)
+        BCACHE_state.writes++;
+    else
+        BCache_mark_dirty_locked(entry);
+    spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+    return ok ? 1 : -1;
+}
+
+/*
+ * Evict from the cold end until size more bytes fit. When only dirty blocks are left
+ * there, write the oldest back and retry; a disk error lets the cache run over its limit
+ * rather than lose data.
+ */
+static void BCache_make_room(uint32_t size)
+{
+    uint64_t limit = BCache_limit();
+    for (;;)
+    {
+        BCACHE_entry_t* victim = NULL;
+        uint64_t flags = spin_lock_irqsave(&BCACHE_state.lock);
+        bool over = BCACHE_state.bytes + size > limit;
+        if (over)
+            victim = BCache_evict_clean_locked();
+        spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+
+        if (!over)
+            return;
+        if (victim)
+        {
+            BCache_entry_free(victim);
+            continue;
+        }
+        if (BCache_writeback_one(NULL) <= 0)
+            return;
+    }
+}
+
+/*
+ * Find or load a block. Returns it with the lock held (flags in out_flags), or NULL with
+ * the lock free. Without fill the block is zeroed instead of read: the caller overwrites
+ * all of it. A miss reads the disk unlocked; if another thread cached the block meanwhile
+ * its copy wins, since it may already hold newer writes, and ours is handed back in
+ * out_spare for the caller to free after unlocking. If the bucket changed during the read
+ * the block may have been written, written back and evicted behind it, so our copy can be
+ * older than the disk: it is dropped and the lookup starts over.
+ */
+static BCACHE_entry_t* BCache_get(HBA_PORT_t* port,
+                                  uint64_t lba,
+                                  uint32_t size,
+                                  bool fill,
+                                  BCACHE_entry_t** out_spare,
+                                  uint64_t* out_flags)
+{
+    *out_spare = NULL;
+    uint32_t bucket = BCache_hash(port, lba);
+
+    for (;;)
+    {
+        uint64_t flags = spin_lock_irqsave(&BCACHE_state.lock);
+        BCACHE_entry_t* entry = BCache_find_locked(port, lba, size);
+        if (entry)
+        {
+            BCACHE_state.hits++;
+            BCache_lru_unlink_locked(entry);
+            BCache_lru_push_locked(entry);
+            *out_flags = flags;
+            return entry;
+        }
+        BCACHE_state.misses++;
+        uint32_t gen = BCACHE_state.bucket_gen[bucket];
+        spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+
+        BCache_make_room(size);
+        BCACHE_entry_t* fresh = BCache_entry_alloc(port, lba, size);
+        if (!fresh)
+            return NULL;
+
+        if (!fill)
+            memset(fresh->data, 0, size);
+        else if (!BCache_disk_io(fresh, false))
+        {
+            BCache_entry_free(fresh);
+            return NULL;
+        }
+
+        flags = spin_lock_irqsave(&BCACHE_state.lock);
+        if (fill)
+            BCACHE_state.reads++;
+
+        entry = BCache_find_locked(port, lba, size);
+        if (entry)
+        {
+            BCache_lru_unlink_locked(entry);
+            BCache_lru_push_locked(entry);
+            *out_spare = fresh;
+        }
+        else if (BCACHE_state.bucket_gen[bucket] != gen)
+        {
+            spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+            BCache_entry_free(fresh);
+            continue;
+        }
+        else
+        {
+            BCache_insert_locked(fresh);
+            entry = fresh;
+        }
+
+        *out_flags = flags;
+        return entry;
+    }
+}
+
+void BCache_init(void)
+{
+    spinlock_init(&BCACHE_state.lock);
+    __atomic_store_n(&BCACHE_state.ready, true, __ATOMIC_RELEASE);
+
+    // Clean blocks are the cheapest memory to give back: ask before anonymous pages are swapped.
+    (void) PMM_register_shrinker(BCache_shrink);
+
+    kdebug_printf("[BCACHE] limit=%llu KiB floor=%u KiB buckets=%u\n",
+                  (unsigned long long) (BCache_limit() / 1024U),
+                  BCACHE_MIN_BYTES / 1024U,
+                  BCACHE_HASH_BUCKETS);
+}
+
+// Copy len bytes at offset out of the size-byte block starting at sector lba.
+bool BCache_read(HBA_PORT_t* port, uint64_t lba, uint32_t size, uint32_t offset, void* out, uint32_t len)
+{
+    if (!BCache_request_valid(port, size, offset, len) || (!out && len != 0))
+        return false;
+    if (len == 0)
+        return true;
+
+    BCACHE_entry_t* spare = NULL;
+    uint64_t flags = 0;
+    BCACHE_entry_t* entry = BCache_get(port, lba, size, true, &spare, &flags);
+    if (!entry)
+        return false;
+
+    memcpy(out, entry->data + offset, len);
+    spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+    BCache_entry_free(spare);
+    return true;
+}
+
+// Only marks the block dirty: it reaches the disk on BCache_sync or when evicted.
+bool BCache_write(HBA_PORT_t* port, uint64_t lba, uint32_t size, uint32_t offset, const void* data, uint32_t len)
+{
+    if (!BCache_request_valid(port, size, offset, len) || (!data && len != 0))
+        return false;
+    if (len == 0)
+        return true;
+
+    BCACHE_entry_t* spare = NULL;
+    uint64_t flags = 0;
+    bool whole = offset == 0 && len == size;
+    BCACHE_entry_t* entry = BCache_get(port, lba, size, !whole, &spare, &flags);
+    if (!entry)
+        return false;
+
+    memcpy(entry->data + offset, data, len);
+    BCache_mark_dirty_locked(entry);
+    spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+    BCache_entry_free(spare);
+    return true;
+}
+
+/*
+ * Write back the dirty blocks of port, or of every port for NULL. Bounded by what was
+ * dirty on entry, so a steady writer cannot keep it going.
+ */
+bool BCache_sync(HBA_PORT_t* port)
+{
+    if (!__atomic_load_n(&BCACHE_state.ready, __ATOMIC_ACQUIRE))
+        return true;
+
+    uint64_t flags = spin_lock_irqsave(&BCACHE_state.lock);
+    uint64_t budget = BCACHE_state.dirty_blocks;
+    spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+
+    for (uint64_t i = 0; i < budget; i++)
+    {
+        int status = BCache_writeback_one(port);
+        if (status < 0)
+            return false;
+        if (status == 0)
+            break;
+    }
+
+    return true;
+}
+
+// Forget every clean block, for cold-cache measurements. Returns how many went.
+uint64_t BCache_drop_clean(void)
+{
+    if (!__atomic_load_n(&BCACHE_state.ready, __ATOMIC_ACQUIRE))
+        return 0;
+
+    uint64_t dropped = 0;
+    for (;;)
+    {
+        uint64_t flags = spin_lock_irqsave(&BCACHE_state.lock);
+        BCACHE_entry_t* victim = BCache_evict_clean_locked();
+        spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+
+        if (!victim)
+            return dropped;
+
+        BCache_entry_free(victim);
+        dropped++;
+    }
+}
+
+/*
+ * The PMM's shrinker: drop clean blocks from the cold end, down to the floor. Dirty ones
+ * are left alone, since this runs from a work item that must not wait for the disk.
+ */
+uint64_t BCache_shrink(uint64_t target_pages)
+{
+    if (target_pages == 0 || !__atomic_load_n(&BCACHE_state.ready, __ATOMIC_ACQUIRE))
+        return 0;
+
+    uint64_t target_bytes = target_pages * PHYS_PAGE_SIZE;
+    uint64_t freed_bytes = 0;
+    BCACHE_entry_t* victims = NULL;
+
+    uint64_t flags = spin_lock_irqsave(&BCACHE_state.lock);
+    while (freed_bytes < target_bytes && BCACHE_state.bytes > BCACHE_MIN_BYTES)
+    {
+        BCACHE_entry_t* victim = BCache_evict_clean_locked();
+        if (!victim)
+            break;
+
+        freed_bytes += victim->size;
+        victim->hash_next = victims;
+        victims = victim;
+    }
+    spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+
+    while (victims)
+    {
+        BCACHE_entry_t* next = victims->hash_next;
+        BCache_entry_free(victims);
+        victims = next;
+    }
+
+    return freed_bytes / PHYS_PAGE_SIZE;
+}
+
+void BCache_get_stats(BCACHE_stats_t* out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+    if (!__atomic_load_n(&BCACHE_state.ready, __ATOMIC_ACQUIRE))
+        return;
+
+    uint64_t flags = spin_lock_irqsave(&BCACHE_state.lock);
+    out->blocks = BCACHE_state.blocks;
+    out->dirty_blocks = BCACHE_state.dirty_blocks;
+    out->bytes = BCACHE_state.bytes;
+    out->hits = BCACHE_state.hits;
+    out->misses = BCACHE_state.misses;
+    out->reads = BCACHE_state.reads;
+    out->writes = BCACHE_state.writes;
+    out->evictions = BCACHE_state.evictions;
+    spin_unlock_irqrestore(&BCACHE_state.lock, flags);
+
+    out->limit = BCache_limit();
+    out->io_errors = __atomic_load_n(&BCACHE_state.io_errors, __ATOMIC_RELAXED);
+}
@@ -228,6 +228,28 @@ task_t* task_get_current_task(void)
     return current_task;
 }
 
+uintptr_t task_get_cpu_kernel_stack(uint32_t cpu_index)
+{
+    if (cpu_index >= TASK_MAX_CPUS)
+        return 0;
+
+    return task_scheduler_state.cpu_kernel_stack[cpu_index];
+}
+
+void task_set_user_kernel_stack(uint32_t cpu_index, uintptr_t rsp0)
+{
+    if (cpu_index >= TASK_MAX_CPUS || rsp0 == 0)
+        return;
+
+    rsp0 &= ~0xFULL;
+    // The CPU reads rsp0 from the TSS on every ring3->ring0 transition, no TR reload needed.
+    tss_per_cpu[cpu_index].rsp0 = rsp0;
+
+    task_cpu_local_t* cpu_local = task_get_cpu_local();
+    if (cpu_local)
+        cpu_local->syscall_rsp0 = rsp0;
+}
+
 static void task_kick_cpu(uint32_t cpu_index)
 {
     if (!APIC_is_enabled() || cpu_index >= TASK_MAX_CPUS)
@@ -243,7 +265,7 @@ static void task_kick_cpu(uint32_t cpu_index)
     (void) APIC_send_ipi(apic_id, SMP_IPI_VECTOR_SCHED);
 }
 
-static bool task_cpu_is_online(uint32_t cpu_index)
+bool task_cpu_is_online(uint32_t cpu_index)
 {
     if (cpu_index >= TASK_MAX_CPUS)
         return false;
@@ -276,6 +298,7 @@ void task_waiter_init(task_waiter_t* waiter)
 
     memset(waiter, 0, sizeof(*waiter));
     waiter->cpu_index = task_current_cpu_index();
+    waiter->parked_slot = SYSCALL_PROC_NONE;
 }
 
 static void task_waiter_signal(task_waiter_t* waiter, bool kick_remote)
@@ -283,10 +306,13 @@ static void task_waiter_signal(task_waiter_t* waiter, bool kick_remote)
     if (!waiter)
         return;
 
-    if (__atomic_exchange_n(&waiter->signaled, 1, __ATOMIC_ACQ_REL) != 0)
+    if (__atomic_exchange_n(&waiter->signaled, 1, __ATOMIC_SEQ_CST) != 0)
         return;
 
     uint32_t target_cpu = __atomic_load_n(&waiter->cpu_index, __ATOMIC_ACQUIRE);
+    // Pairs with the parked/signaled handshake in Syscall_block_current().
+    if (__atomic_load_n(&waiter->parked, __ATOMIC_SEQ_CST) != 0)
+        Syscall_wake_parked(waiter->parked_slot, waiter);
     if (kick_remote && target_cpu < TASK_MAX_CPUS && target_cpu != task_current_cpu_index())
         task_kick_cpu(target_cpu);
 }
@@ -364,6 +390,11 @@ static bool task_waiter_wait(task_waiter_t* waiter, uint64_t timeout_ticks)
     if (!task_interrupts_enabled())
         return false;
 
+    // Inside a user syscall the process is parked and the CPU runs something else.
+    bool parked_signaled = false;
+    if (Syscall_block_current(waiter, timeout_ticks, &parked_signaled))
+        return parked_signaled;
+
     uint64_t start_ticks = 0;
     if (timeout_ticks != TASK_WAIT_TIMEOUT_INFINITE)
         start_ticks = ISR_get_timer_ticks();
@@ -447,6 +478,8 @@ bool task_wait_queue_wait_event(task_wait_queue_t* queue,
         if (!task_waiter_wait(waiter, remaining))
         {
             task_wait_queue_cancel(queue, waiter);
+            if (__atomic_load_n(&waiter->interrupted, __ATOMIC_ACQUIRE) != 0)
+                return !predicate(context);
             if (timeout_ticks != TASK_WAIT_TIMEOUT_INFINITE)
             {
                 uint64_t elapsed = ISR_get_timer_ticks() - start_ticks;
@@ -647,15 +680,15 @@ static void task_maybe_kick_stealer(uint32_t source_cpu, uint32_t depth)
     __atomic_store_n(&task_scheduler_state.steal_cursor[source_cpu], cursor, __ATOMIC_RELAXED);
 }
 
-static uint32_t task_pick_push_target(uint32_t source_cpu)
+uint32_t task_balance_pick_push_target(uint32_t source_cpu, task_balance_depth_fn_t depth_fn)
 {
     if (source_cpu >= TASK_MAX_CPUS || !task_cpu_is_online(source_cpu))
         return 0;
 
-    if (!task_is_push_balance_enabled())
+    if (!depth_fn || !task_is_push_balance_enabled())
         return source_cpu;
 
-    uint32_t source_depth = task_runqueue_depth_cpu(source_cpu);
+    uint32_t source_depth = depth_fn(source_cpu);
     if (source_depth < TASK_PUSH_TRIGGER_DEPTH)
         return source_cpu;
 
@@ -671,7 +704,7 @@ static uint32_t task_pick_push_target(uint32_t source_cpu)
         if (cpu == source_cpu || !task_cpu_is_online(cpu))
             continue;
 
-        uint32_t depth = task_runqueue_depth_cpu(cpu);
+        uint32_t depth = depth_fn(cpu);
         if (depth < best_depth)
         {
             best_depth = depth;
@@ -688,6 +721,11 @@ static uint32_t task_pick_push_target(uint32_t source_cpu)
     return best_cpu;
 }
 
+static uint32_t task_pick_push_target(uint32_t source_cpu)
+{
+    return task_balance_pick_push_target(source_cpu, task_runqueue_depth_cpu);
+}
+
 static uint32_t task_runqueue_steal_batch_from_cpu(uint32_t victim_cpu, task_work_item_t* out, uint32_t max_items)
 {
     if (!out || victim_cpu >= TASK_MAX_CPUS || max_items == 0)
@@ -739,9 +777,12 @@ static uint32_t task_runqueue_steal_batch_from_cpu(uint32_t victim_cpu, task_wor
     return stolen;
 }
 
-static bool task_try_steal_work(uint32_t thief_cpu, task_work_item_t* out)
+bool task_balance_steal(uint32_t thief_cpu,
+                        task_balance_depth_fn_t depth_fn,
+                        task_balance_steal_fn_t steal_fn,
+                        void* context)
 {
-    if (!out || thief_cpu >= TASK_MAX_CPUS)
+    if (thief_cpu >= TASK_MAX_CPUS || !depth_fn || !steal_fn)
         return false;
 
     if (!task_is_work_stealing_enabled() || !APIC_is_enabled())
@@ -750,9 +791,6 @@ static bool task_try_steal_work(uint32_t thief_cpu, task_work_item_t* out)
     if (SMP_get_online_cpu_count() <= 1)
         return false;
 
-    if (APIC_get_current_lapic_id() == APIC_get_bsp_lapic_id())
-        return false;
-
     uint8_t core_count = APIC_get_core_count();
     uint32_t max_cpu = core_count;
     if (max_cpu == 0 || max_cpu > TASK_MAX_CPUS)
@@ -778,44 +816,81 @@ static bool task_try_steal_work(uint32_t thief_cpu, task_work_item_t* out)
         scanned_victims++;
 
         uint32_t batch_max = 1;
-        uint32_t victim_depth = task_runqueue_depth_cpu(victim_cpu);
-        if (victim_depth > TASK_STEAL_BATCH_TRIGGER_DEPTH)
+        if (depth_fn(victim_cpu) > TASK_STEAL_BATCH_TRIGGER_DEPTH)
             batch_max = TASK_STEAL_BATCH_MAX;
 
-        uint32_t local_depth = task_runqueue_depth_cpu(thief_cpu);
-        uint32_t local_free = (local_depth < TASK_RUNQUEUE_CAPACITY) ? (TASK_RUNQUEUE_CAPACITY - local_depth) : 0;
-        if (batch_max > (local_free + 1U))
-            batch_max = local_free + 1U;
-        if (batch_max == 0)
-            batch_max = 1;
-
-        task_work_item_t stolen_items[TASK_STEAL_BATCH_MAX] = { 0 };
-        uint32_t stolen_count = task_runqueue_steal_batch_from_cpu(victim_cpu, stolen_items, batch_max);
-        if (stolen_count != 0)
+        if (steal_fn(victim_cpu, batch_max, context) != 0)
         {
-            task_copy_work_item(out, &stolen_items[0]);
-
-            for (uint32_t i = 1; i < stolen_count; i++)
-            {
-                if (!task_runqueue_enqueue_item(thief_cpu, &stolen_items[i], false))
-                {
-                    stolen_items[i].fn(stolen_items[i].arg);
-                    __atomic_add_fetch(&task_scheduler_state.stats.exec_runs[thief_cpu], 1, __ATOMIC_RELAXED);
-                    uint64_t total_runs = __atomic_add_fetch(&task_scheduler_state.stats.exec_runs_total, 1, __ATOMIC_RELAXED);
-                    task_maybe_log_cpu_stats(total_runs);
-                }
-            }
-
-            __atomic_store_n(&task_scheduler_state.stats.last_steal_victim[thief_cpu], victim_cpu, __ATOMIC_RELAXED);
-            __atomic_fetch_add(&task_scheduler_state.stats.steal_runs[thief_cpu], 1, __ATOMIC_RELAXED);
-            __atomic_fetch_add(&task_scheduler_state.stats.steal_batch_total[thief_cpu], stolen_count, __ATOMIC_RELAXED);
-            __atomic_fetch_add(&task_scheduler_state.stats.steal_from_cpu[victim_cpu], 1, __ATOMIC_RELAXED);
             __atomic_store_n(&task_scheduler_state.steal_cursor[thief_cpu], cursor, __ATOMIC_RELAXED);
             return true;
         }
     }
 
     __atomic_store_n(&task_scheduler_state.steal_cursor[thief_cpu], cursor, __ATOMIC_RELAXED);
+    return false;
+}
+
+typedef struct task_steal_work_context
+{
+    uint32_t thief_cpu;
+    task_work_item_t* out;
+} task_steal_work_context_t;
+
+static uint32_t task_steal_work_from_cpu(uint32_t victim_cpu, uint32_t batch_max, void* context)
+{
+    task_steal_work_context_t* ctx = (task_steal_work_context_t*) context;
+    uint32_t thief_cpu = ctx->thief_cpu;
+
+    uint32_t local_depth = task_runqueue_depth_cpu(thief_cpu);
+    uint32_t local_free = (local_depth < TASK_RUNQUEUE_CAPACITY) ? (TASK_RUNQUEUE_CAPACITY - local_depth) : 0;
+    if (batch_max > (local_free + 1U))
+        batch_max = local_free + 1U;
+    if (batch_max == 0)
+        batch_max = 1;
+
+    task_work_item_t stolen_items[TASK_STEAL_BATCH_MAX] = { 0 };
+    uint32_t stolen_count = task_runqueue_steal_batch_from_cpu(victim_cpu, stolen_items, batch_max);
+    if (stolen_count == 0)
+        return 0;
+
+    task_copy_work_item(ctx->out, &stolen_items[0]);
+
+    for (uint32_t i = 1; i < stolen_count; i++)
+    {
+        if (!task_runqueue_enqueue_item(thief_cpu, &stolen_items[i], false))
+        {
+            stolen_items[i].fn(stolen_items[i].arg);
+            __atomic_add_fetch(&task_scheduler_state.stats.exec_runs[thief_cpu], 1, __ATOMIC_RELAXED);
+            uint64_t total_runs = __atomic_add_fetch(&task_scheduler_state.stats.exec_runs_total, 1, __ATOMIC_RELAXED);
+            task_maybe_log_cpu_stats(total_runs);
+        }
+    }
+
+    __atomic_store_n(&task_scheduler_state.stats.last_steal_victim[thief_cpu], victim_cpu, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&task_scheduler_state.stats.steal_runs[thief_cpu], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&task_scheduler_state.stats.steal_batch_total[thief_cpu], stolen_count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&task_scheduler_state.stats.steal_from_cpu[victim_cpu], 1, __ATOMIC_RELAXED);
+    return stolen_count;
+}
+
+static bool task_try_steal_work(uint32_t thief_cpu, task_work_item_t* out)
+{
+    if (!out || thief_cpu >= TASK_MAX_CPUS)
+        return false;
+
+    if (!task_is_work_stealing_enabled() || !APIC_is_enabled())
+        return false;
+
+    if (SMP_get_online_cpu_count() <= 1)
+        return false;
+
+    if (APIC_get_current_lapic_id() == APIC_get_bsp_lapic_id())
+        return false;
+
+    task_steal_work_context_t ctx = { .thief_cpu = thief_cpu, .out = out };
+    if (task_balance_steal(thief_cpu, task_runqueue_depth_cpu, task_steal_work_from_cpu, &ctx))
+        return true;
+
     __atomic_fetch_add(&task_scheduler_state.stats.steal_fail_runs[thief_cpu], 1, __ATOMIC_RELAXED);
     return false;
 }
@@ -878,6 +953,8 @@ bool task_init_cpu(uint32_t cpu_index, uintptr_t kernel_stack, uint8_t apic_id)
         return false;
 
     VMM_enable_nx_current_cpu();
+    VMM_enable_wp_current_cpu();
+    VMM_enable_pcid_current_cpu(cpu_index);
 
     TSS_t* tss = &tss_per_cpu[cpu_index];
     memset(tss, 0, sizeof (*tss));
@@ -901,6 +978,7 @@ bool task_init_cpu(uint32_t cpu_index, uintptr_t kernel_stack, uint8_t apic_id)
 
     GDT_load_TSS_segment(tss);
     TSS_flush(TSS_SYSTEM_SEGMENT);
+    task_scheduler_state.cpu_kernel_stack[cpu_index] = tss->rsp0;
 
     if (apic_id == 0xFF)
         apic_id = APIC_get_core_id((uint8_t) cpu_index);
@@ -1150,7 +1228,7 @@ void task_switch(void)
     task_t* prev = current_task;
     current_task = next_task;
 
-    /* Eager FPU: save/restore FPU context on every task switch. */
+    /* Eager FPU switch: clean state is not written back and live registers are not reloaded. */
     FPU_switch_task(prev, current_task);
 
     // Update rsp0 for new task's kernel stack
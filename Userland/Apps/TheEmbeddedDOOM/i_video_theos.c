@@ -9,6 +9,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -18,6 +19,8 @@
 #include <syscall.h>
 #include <unistd.h>
 
+#define DOOM_RT_PRIORITY 8
+
 typedef struct doom_drm_state
 {
     bool ready;
@@ -576,6 +579,16 @@ void I_UpdateNoBlit(void)
 
 void I_InitGraphics(void)
 {
+    // -rt: the game loop (which also mixes and submits audio) runs SCHED_FIFO ahead of fair load.
+    if (M_CheckParm("-rt"))
+    {
+        struct sched_param rt_param = { .sched_priority = DOOM_RT_PRIORITY };
+        if (sched_setscheduler(0, SCHED_FIFO, &rt_param) == 0)
+            printf("[DOOM] realtime priority %d\n", rt_param.sched_priority);
+        else
+            printf("[DOOM] realtime priority refused errno=%d\n", errno);
+    }
+
     DoomVideoProf.tick_hz = doom_video_tick_hz();
     DoomVideoProf.last_frame_tick = 0ULL;
     doom_video_prof_reset_window(sys_tick_get());
@@ -14,6 +14,32 @@ def _get_int(obj, key, default=0):
     return _to_int(default, default)
 
 
+def _proc_cpu_top(prev_snap, snap, d_tick, limit=5):
+    # CPU% of one CPU per thread, from utime+stime deltas over the wall-clock delta.
+    if prev_snap is None or d_tick <= 0:
+        return []
+
+    prev_cpu = {}
+    for entry in prev_snap.get("proc", {}).get("entries", []):
+        prev_cpu[_get_int(entry, "pid", 0)] = _get_int(entry, "utime_ns", 0) + _get_int(entry, "stime_ns", 0)
+
+    top = []
+    for entry in snap.get("proc", {}).get("entries", []):
+        pid = _get_int(entry, "pid", 0)
+        if pid not in prev_cpu:
+            continue
+        d_cpu = _get_int(entry, "utime_ns", 0) + _get_int(entry, "stime_ns", 0) - prev_cpu[pid]
+        if d_cpu < 0:
+            d_cpu = 0
+        pct = int((100 * d_cpu) / (d_tick * 1000000))
+        if pct > 100:
+            pct = 100
+        top.append((pct, pid))
+
+    top.sort(reverse=True)
+    return [{"pid": pid, "cpu_pct": pct} for pct, pid in top[:limit]]
+
+
 def compute_health(prev_snap, snap):
     score = 100
     notes = []
@@ -33,6 +59,7 @@ def compute_health(prev_snap, snap):
         score -= 10
         notes.append("net drops")
 
+    d_tick = 0
     if prev_snap is not None:
         d_tick = _to_int(snap.get("tick_ms", 0), 0) - _to_int(prev_snap.get("tick_ms", 0), 0)
         if d_tick > 0:
@@ -50,4 +77,5 @@ def compute_health(prev_snap, snap):
 
     if score < 0:
         score = 0
-    return {"score": score, "notes": notes, "cpu_usage_pct": usage}
+    proc_top = _proc_cpu_top(prev_snap, snap, d_tick)
+    return {"score": score, "notes": notes, "cpu_usage_pct": usage, "proc_top": proc_top}
@@ -44,6 +44,30 @@ def _normalize_dict(raw, schema):
     return out
 
 
+_PROC_ENTRY_SCHEMA = {
+    "pid": 0,
+    "owner_pid": 0,
+    "flags": 0,
+    "utime_ns": 0,
+    "stime_ns": 0,
+    "wait_ns": 0,
+    "nvcsw": 0,
+    "nivcsw": 0,
+}
+
+
+def _normalize_proc_entries(raw):
+    # Per-thread usage is only there when the native module exports syscall_proc_info_t entries.
+    entries = []
+    try:
+        items = raw.get("entries", []) if hasattr(raw, "get") else []
+        for item in items:
+            entries.append(_normalize_dict(item, _PROC_ENTRY_SCHEMA))
+    except Exception:
+        return []
+    return entries
+
+
 def collect_snapshot():
     cpu_raw = th.cpu_info()
     sched_raw = th.sched_info()
@@ -97,6 +121,7 @@ def collect_snapshot():
         "total": 0,
         "visible": 0,
     })
+    proc["entries"] = _normalize_proc_entries(proc_raw)
     net = _normalize_dict(net_raw, {
         "rx_packets": 0,
         "rx_dropped": 0,
@@ -82,6 +82,8 @@ class WMView:
         lines.append("")
         lines.append("Processes")
         lines.append(_s("  visible=", _get_int(proc, "visible", 0), " total=", _get_int(proc, "total", 0)))
+        for item in health.get("proc_top", []):
+            lines.append(_s("  pid=", _get_int(item, "pid", 0), " cpu=", _get_int(item, "cpu_pct", 0), "%"))
         lines.append("")
         lines.append("Alerts")
         notes = health.get("notes", [])
@@ -262,6 +262,71 @@ static void monitor_print_cpu_usage(const syscall_cpu_info_t* cpu)
     printf("  cpu_usage    : ~%u%% (work vs idle-hlt samples)\n", (unsigned int) pct);
 }
 
+static uint32_t monitor_proc_prev_pid[SYS_PROC_MAX_ENTRIES];
+static uint64_t monitor_proc_prev_cpu_ns[SYS_PROC_MAX_ENTRIES];
+static uint32_t monitor_proc_prev_count;
+static uint64_t monitor_proc_prev_wall_ns;
+
+static uint64_t monitor_proc_cpu_ns(const syscall_proc_info_t* proc)
+{
+    return proc->utime_ns + proc->stime_ns;
+}
+
+static uint64_t monitor_wall_ns(const syscall_cpu_info_t* cpu)
+{
+    if (!cpu || cpu->tick_hz == 0U)
+        return 0ULL;
+    return (cpu->ticks * 1000000000ULL) / (uint64_t) cpu->tick_hz;
+}
+
+// Share of one CPU used since the previous frame, in tenths of a percent (-1 = no sample yet).
+static int32_t monitor_proc_cpu_permille(const syscall_proc_info_t* proc, uint64_t wall_ns)
+{
+    if (!proc || wall_ns <= monitor_proc_prev_wall_ns || monitor_proc_prev_wall_ns == 0ULL)
+        return -1;
+
+    for (uint32_t i = 0; i < monitor_proc_prev_count; i++)
+    {
+        if (monitor_proc_prev_pid[i] != proc->pid)
+            continue;
+
+        uint64_t cpu_ns = monitor_proc_cpu_ns(proc);
+        uint64_t prev_ns = monitor_proc_prev_cpu_ns[i];
+        uint64_t d_cpu = (cpu_ns > prev_ns) ? (cpu_ns - prev_ns) : 0ULL;
+        uint64_t d_wall = wall_ns - monitor_proc_prev_wall_ns;
+        uint64_t permille = (d_cpu * 1000ULL + d_wall / 2ULL) / d_wall;
+        return (int32_t) ((permille > 1000ULL) ? 1000ULL : permille);
+    }
+
+    return -1;
+}
+
+static void monitor_proc_remember(const syscall_proc_info_t* procs, uint32_t count, uint64_t wall_ns)
+{
+    monitor_proc_prev_count = 0;
+    for (uint32_t i = 0; i < count && i < SYS_PROC_MAX_ENTRIES; i++)
+    {
+        monitor_proc_prev_pid[i] = procs[i].pid;
+        monitor_proc_prev_cpu_ns[i] = monitor_proc_cpu_ns(&procs[i]);
+        monitor_proc_prev_count++;
+    }
+    monitor_proc_prev_wall_ns = wall_ns;
+}
+
+// Resident size in the largest unit that keeps it readable: 512K, 12.3M.
+static void monitor_format_pages(char* out, size_t out_size, uint64_t pages)
+{
+    uint64_t kib = pages * 4ULL;
+    if (kib < 10240ULL)
+        snprintf(out, out_size, "%lluK", (unsigned long long) kib);
+    else
+        snprintf(out,
+                 out_size,
+                 "%llu.%lluM",
+                 (unsigned long long) (kib / 1024ULL),
+                 (unsigned long long) (((kib % 1024ULL) * 10ULL) / 1024ULL));
+}
+
 static void monitor_format_uptime(char* out, size_t out_size, uint64_t ticks, uint32_t tick_hz)
 {
     if (!out || out_size == 0U)
@@ -366,6 +431,10 @@ static void monitor_render(const monitor_snapshot_t* snap,
         printf("  preempt_cnt  : %u\n", snap->sched.preempt_count);
         printf("  local_rq     : %u\n", snap->sched.local_rq_depth);
         printf("  total_rq     : %u\n", snap->sched.total_rq_depth);
+        printf("  user_rq      : %u (total %u)\n", snap->sched.user_rq_depth, snap->sched.user_rq_total);
+        printf("  pick_next    : %llu cycles avg\n",
+               (unsigned long long) (snap->sched.pick_next_calls ?
+                                     (snap->sched.pick_next_cycles / snap->sched.pick_next_calls) : 0ULL));
     }
     else
     {
@@ -422,7 +491,7 @@ static void monitor_render(const monitor_snapshot_t* snap,
     putc('\n');
 
     printf("\n");
-    printf("  %-5s %-5s %-5s %-4s %-7s %-8s %-5s %-4s %-6s\n",
+    printf("  %-5s %-5s %-5s %-4s %-7s %-8s %-5s %-6s %-7s %-9s %-4s %-6s\n",
            "pid",
            "ppid",
            "own",
@@ -430,9 +499,14 @@ static void monitor_render(const monitor_snapshot_t* snap,
            "type",
            "state",
            "cpu",
+           "cpu%",
+           "rss",
+           "time",
            "sig",
            "exit");
 
+    uint64_t wall_ns = snap->cpu_ok ? monitor_wall_ns(&snap->cpu) : 0ULL;
+
     for (uint32_t i = 0; i < snap->proc_copied; i++)
     {
         const syscall_proc_info_t* proc = &snap->procs[i];
@@ -452,7 +526,29 @@ static void monitor_render(const monitor_snapshot_t* snap,
         else
             snprintf(sig_text, sizeof(sig_text), "-");
 
-        printf("  %-5u %-5u %-5u %-4s %-7s %-8s %-5s %-4s %-6lld\n",
+        char pct_text[12];
+        int32_t permille = monitor_proc_cpu_permille(proc, wall_ns);
+        if (permille < 0)
+            snprintf(pct_text, sizeof(pct_text), "-");
+        else
+            snprintf(pct_text, sizeof(pct_text), "%d.%d", permille / 10, permille % 10);
+
+        // Threads share their owner's address space, and with it the same figure.
+        char rss_text[16];
+        if (proc->rss_pages == 0ULL && proc->vm_pages == 0ULL)
+            snprintf(rss_text, sizeof(rss_text), "-");
+        else
+            monitor_format_pages(rss_text, sizeof(rss_text), proc->rss_pages);
+
+        char time_text[16];
+        uint64_t cpu_ms = monitor_proc_cpu_ns(proc) / 1000000ULL;
+        snprintf(time_text,
+                 sizeof(time_text),
+                 "%llu.%02llu",
+                 (unsigned long long) (cpu_ms / 1000ULL),
+                 (unsigned long long) ((cpu_ms % 1000ULL) / 10ULL));
+
+        printf("  %-5u %-5u %-5u %-4s %-7s %-8s %-5s %-6s %-7s %-9s %-4s %-6lld\n",
                proc->pid,
                proc->ppid,
                proc->owner_pid,
@@ -460,9 +556,15 @@ static void monitor_render(const monitor_snapshot_t* snap,
                kind,
                state,
                cpu_text,
+               pct_text,
+               rss_text,
+               time_text,
                sig_text,
                (long long) proc->exit_status);
     }
+
+    if (wall_ns != 0ULL)
+        monitor_proc_remember(snap->procs, snap->proc_copied, wall_ns);
 }
 
 int main(int argc, char** argv)
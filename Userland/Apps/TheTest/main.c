@@ -11,15 +11,21 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/mman.h>
+#include <sys/msg.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/times.h>
 #include <syscall.h>
+#include <time.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <net/if_arp.h>
 #include <drm/drm_mode.h>
+#include <dirent.h>
 #include <dlfcn.h>
 #include <linux/soundcard.h>
 #include <UAPI/Net.h>
@@ -49,6 +55,46 @@
 // pthread API is expected to be true shared-address-space threading.
 #define TEST_PTHREAD_SHIM
 #define TEST_TLS_DYNAMIC
+// Blocked readers must not steal CPU time from compute-bound processes.
+#define TEST_BLOCKING_BENCH
+// Per-CPU user runqueues: pick-next cost must stay flat as the process count grows.
+#define TEST_SCHED_PICK_BENCH
+// nice weights must split one CPU between fair spinners; RT must run ahead of them.
+#define TEST_SCHED_CLASS
+// Spinning must show up as user time, sleeping as voluntary switches, reaped children as cutime.
+#define TEST_RUSAGE
+// getpid/yield storms across one process per CPU must scale instead of serializing on one lock.
+#define TEST_SYSCALL_SCALING
+// Trivial syscalls must skip the post handler: report null-syscall round-trip cycles.
+#define TEST_NULL_SYSCALL_BENCH
+// Clock reads come from the vvar page: they must track the kernel clocks without any syscall.
+#define TEST_VDSO_CLOCK
+// Two processes ping-ponging over pipes on one CPU must switch CR3 without flushing when PCIDs exist.
+#define TEST_PCID_PINGPONG
+// Map/unmap and fork/exit cycles must give their pages back: the free-page count stays flat.
+#define TEST_PMM_FLAT
+// Per-node page pools must add up to the whole, and a touched mapping should come from the local node.
+#define TEST_NUMA_NODES
+// Anonymous mappings are zero-filled on first touch; MAP_POPULATE keeps the eager behaviour.
+#define TEST_LAZY_MAP
+// Fork cost should grow with the pages mapped, not with the number of frames already shared.
+#define TEST_FORK_SCALING
+// Large anonymous mappings take 2 MiB pages on first touch, split on partial munmap and collapse back.
+#define TEST_THP
+// First touches should find pre-zeroed pages once the idle-time refill has run.
+#define TEST_ZERO_POOL
+// Bulk pipe I/O copies user buffers without a global lock: throughput should grow with processes.
+#define TEST_USERCOPY
+// Proc info reports what an address space maps; RLIMIT_AS/RLIMIT_RSS make mmap fail cleanly.
+#define TEST_MM_ACCOUNTING
+// Kernel heap counters move with kmalloc/kfree and describe a consistent heap.
+#define TEST_KMEM_INFO
+// Writing more anonymous memory than is free pushes pages to the compressed swap pool and back.
+#define TEST_SWAP
+// Pipes and message queues are allocated on creation: more queues than the old fixed table, pipes freed on close.
+#define TEST_IPC_OBJECTS
+// A warm open() and directory listing are served by the ext4 block cache without reading the disk.
+#define TEST_BCACHE
 #define TEST_SIGNALS
 #define TEST_DRM_KMS
 #define TEST_AUDIO_DSP
@@ -83,6 +129,59 @@
 #define THETEST_UDP_POLL_INTERVAL_US  10000U
 #define THETEST_TLS_DYNAMIC_WORKER_ITERS 1024U
 #define THETEST_TLS_DYNAMIC_YIELD_MASK   0x1FU
+#define THETEST_BLOCK_BENCH_PAIRS        4U
+#define THETEST_BLOCK_BENCH_SPIN_ITERS   40000000U
+#define THETEST_BLOCK_BENCH_SETTLE_MS    50U
+#define THETEST_BLOCK_BENCH_TIMEOUT_MS   30000U
+#define THETEST_PICK_BENCH_MAX_PROCS     200U
+#define THETEST_PICK_BENCH_ROUNDS        20U
+#define THETEST_PICK_BENCH_SLEEP_US      2000U
+#define THETEST_SCHED_CLASS_NICE         10
+#define THETEST_SCHED_CLASS_RT_PRIO      5
+#define THETEST_SCHED_CLASS_SETTLE_MS    50U
+#define THETEST_SCHED_CLASS_RUN_MS       500U
+#define THETEST_RUSAGE_SPIN_MS           200U
+#define THETEST_RUSAGE_SLEEPS            5U
+#define THETEST_SYSCALL_SCALING_MAX_PROCS 16U
+#define THETEST_SYSCALL_SCALING_ITERS    20000U
+#define THETEST_SYSCALL_SCALING_SETTLE_MS 50U
+#define THETEST_NULL_SYSCALL_ITERS       100000U
+#define THETEST_VDSO_READS               100000U
+#define THETEST_VDSO_SLEEP_MS            20U
+#define THETEST_PCID_ROUNDS              2000U
+#define THETEST_PCID_TOUCH_PAGES         64U
+#define THETEST_UNMAP_LARGE_PAGES        4096U
+#define THETEST_UNMAP_LARGE_MAX_FLUSHES  256U   // A per-page flush would need one per page.
+#define THETEST_PMM_FLAT_ROUNDS          16U
+#define THETEST_PMM_FLAT_MAP_PAGES       256U
+#define THETEST_PMM_FLAT_SLACK_PAGES     64U    // Room for other processes allocating meanwhile.
+#define THETEST_NUMA_MAP_PAGES           512U
+#define THETEST_LAZY_MAP_PAGES           4096U
+#define THETEST_LAZY_TOUCH_STRIDE        16U    // Touch one page in this many.
+#define THETEST_LAZY_SLACK_PAGES         64U    // Page tables plus other processes allocating meanwhile.
+#define THETEST_FORK_SMALL_PAGES         512U
+#define THETEST_FORK_LARGE_PAGES         8192U
+#define THETEST_THP_MAP_PAGES            8192U  // 32 MiB: 16 huge pages when order-9 blocks are free.
+#define THETEST_THP_MEMSET_ROUNDS        4U
+#define THETEST_THP_COLLAPSE_PAGES       1536U  // 6 MiB populated 4 KiB at a time: two aligned chunks at least.
+#define THETEST_THP_COLLAPSE_SLEEPS      8U
+#define THETEST_ZERO_TOUCH_PAGES         448U   // Under one huge page: every touch is a 4 KiB fault.
+#define THETEST_ZERO_DRAIN_MAPS          3U     // Back to back, more than a pool holds.
+#define THETEST_ZERO_REFILL_MS           50U
+#define THETEST_USERCOPY_MAX_PROCS       8U
+#define THETEST_USERCOPY_ITERS           4000U
+#define THETEST_USERCOPY_CHUNK           4096U  // One pipe buffer.
+#define THETEST_MM_PROC_ENTRIES          256U   // Every process slot the kernel has.
+#define THETEST_MM_TOUCH_PAGES           256U   // Under one huge page: counted 4 KiB at a time.
+#define THETEST_MM_SLACK_PAGES           32U
+#define THETEST_KMEM_ROUNDS              64U    // Each syscall stats call is one kmalloc and one kfree.
+#define THETEST_SWAP_OVERCOMMIT_SHIFT    3U     // Map 1/8 of physical memory more than is free.
+#define THETEST_SWAP_TIMEOUT_MS          60000U
+#define THETEST_IPC_QUEUES               48U    // Past the 32 queues the kernel used to embed.
+#define THETEST_IPC_QUEUE_KEY            0x54510000 // Fixed keys: a rerun finds the same queues.
+#define THETEST_BCACHE_PATH              "/lib/libthetestdyn.so"
+#define THETEST_BCACHE_DIR               "/lib"
+#define THETEST_BCACHE_WARM_ROUNDS       16U
 
 static const char TheTest_net_rx_signature[] = "THEOS_RX_AUTOTEST";
 static const char TheTest_udp_loopback_payload[] = "THEOS_UDP_REQ_LISTEN";
@@ -283,6 +382,62 @@ static void thetest_mmap_probe(const char* label, uintptr_t addr, size_t len, bo
     printf("[TheTest] unmap rc=%d\n", unmap_rc);
 }
 
+static void* thetest_unmap_spinner(void* arg)
+{
+    volatile uint32_t* stop = (volatile uint32_t*) arg;
+    while (*stop == 0U)
+        __asm__ __volatile__("pause");
+    return NULL;
+}
+
+/*
+ * Unmap a large touched range while a second thread keeps the address space live on another
+ * CPU: the kernel must flush in batches, a handful of IPIs instead of one per page per CPU.
+ */
+static void thetest_unmap_large(void)
+{
+    size_t len = (size_t) THETEST_UNMAP_LARGE_PAGES * 4096U;
+    volatile uint8_t* map_ptr = (volatile uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((void*) map_ptr == MAP_FAILED)
+    {
+        printf("[TheTest] large unmap: setup map failed (unexpected)\n");
+        return;
+    }
+    for (uint32_t i = 0; i < THETEST_UNMAP_LARGE_PAGES; i++)
+        map_ptr[(size_t) i * 4096U] = (uint8_t) i;
+
+    volatile uint32_t stop = 0U;
+    pthread_t spinner;
+    bool spinning = pthread_create(&spinner, NULL, thetest_unmap_spinner, (void*) &stop) == 0;
+    (void) usleep(THETEST_BLOCK_BENCH_SETTLE_MS * 1000U);
+
+    syscall_tlb_info_t before;
+    syscall_tlb_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    bool ok = sys_tlb_info_get(&before) == 0;
+    int unmap_rc = munmap((void*) map_ptr, len);
+    ok = sys_tlb_info_get(&after) == 0 && ok && unmap_rc == 0;
+
+    stop = 1U;
+    if (spinning)
+        (void) pthread_join(spinner, NULL);
+
+    uint64_t flushes = after.shootdowns - before.shootdowns;
+    if (ok)
+        ok = flushes <= THETEST_UNMAP_LARGE_MAX_FLUSHES;
+
+    printf("[TheTest] large unmap: %s pages=%u spinner=%s flushes=%llu no_ipi=%llu ipis=%llu full=%llu lazy_skips=%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) THETEST_UNMAP_LARGE_PAGES,
+           spinning ? "on" : "off",
+           (unsigned long long) flushes,
+           (unsigned long long) (after.shootdowns_no_ipi - before.shootdowns_no_ipi),
+           (unsigned long long) (after.shootdown_ipis - before.shootdown_ipis),
+           (unsigned long long) (after.shootdown_full_flushes - before.shootdown_full_flushes),
+           (unsigned long long) (after.lazy_skips - before.lazy_skips));
+}
+
 static void thetest_unmap_probe(void)
 {
     printf("[TheTest] unmap test 'unmapped zone': addr=%p len=0x%llx\n",
@@ -310,6 +465,8 @@ static void thetest_unmap_probe(void)
     int second_unmap_rc = munmap(map_ptr, (size_t) MMAP_TEST_LEN);
     printf("[TheTest] first unmap rc=%d (expected=0)\n", first_unmap_rc);
     printf("[TheTest] second unmap rc=%d (expected<0)\n", second_unmap_rc);
+
+    thetest_unmap_large();
 }
 
 static bool thetest_parse_u64(const char* text, uint64_t* out_value)
@@ -1242,140 +1399,1859 @@ static void thetest_signals_probe(void)
                    status,
                    signal);
         }
-        thetest_signal_report_check("default ignore SIGCHLD", ignore_ok, &passed, &failed);
-        if (wait_rc == -2)
-            (void) kill(ignored_pid, SIGKILL);
+        thetest_signal_report_check("default ignore SIGCHLD", ignore_ok, &passed, &failed);
+        if (wait_rc == -2)
+            (void) kill(ignored_pid, SIGKILL);
+    }
+
+    int stop_pid = thetest_signal_spawn_child(35U, 9);
+    if (stop_pid < 0)
+    {
+        thetest_signal_report_check("SIGSTOP semantics probe", false, &passed, &failed);
+    }
+    else
+    {
+        int stop_kill_rc = kill(stop_pid, SIGSTOP);
+        int status = 0;
+        int signal = 0;
+        int wait_rc = thetest_wait_child(stop_pid, &status, &signal, 700U);
+        bool stop_ok = false;
+
+        if (wait_rc == stop_pid && status == 9 && signal == 0)
+        {
+            stop_ok = (stop_kill_rc == 0);
+            if (stop_ok)
+                printf("[TheTest][signal] SIGSTOP behaved as non-blocking/no-op (not implemented yet)\n");
+        }
+        else if (wait_rc == -2)
+        {
+            int cont_rc = kill(stop_pid, SIGCONT);
+            int resume_wait_rc = thetest_wait_child(stop_pid, &status, &signal, 1500U);
+            stop_ok = (stop_kill_rc == 0 &&
+                       cont_rc == 0 &&
+                       resume_wait_rc == stop_pid &&
+                       status == 9 &&
+                       signal == 0);
+            if (stop_ok)
+                printf("[TheTest][signal] SIGSTOP/SIGCONT behaved as true stop/continue\n");
+        }
+
+        if (!stop_ok)
+        {
+            printf("[TheTest][signal] detail SIGSTOP: kill_rc=%d wait_rc=%d status=%d signal=%d\n",
+                   stop_kill_rc,
+                   wait_rc,
+                   status,
+                   signal);
+        }
+        thetest_signal_report_check("SIGSTOP semantics probe", stop_ok, &passed, &failed);
+        if (wait_rc == -2 && !stop_ok)
+            (void) kill(stop_pid, SIGKILL);
+    }
+
+    if (failed == 0U)
+    {
+        printf("[TheTest] signal probe: OK (checks=%u)\n", (unsigned int) passed);
+    }
+    else
+    {
+        printf("[TheTest] signal probe: FAILED (ok=%u failed=%u)\n",
+               (unsigned int) passed,
+               (unsigned int) failed);
+    }
+}
+
+typedef struct thetest_pthread_arg
+{
+    int id;
+    pthread_mutex_t* lock;
+    volatile int* shared_counter;
+} thetest_pthread_arg_t;
+
+static void* thetest_pthread_worker(void* arg)
+{
+    thetest_pthread_arg_t* cfg = (thetest_pthread_arg_t*) arg;
+    volatile uint64_t acc = 0;
+    for (uint32_t i = 0; i < 250000U; i++)
+        acc = (acc * 1664525ULL) + (uint64_t) i + (uint64_t) cfg->id;
+    (void) acc;
+
+    (void) pthread_mutex_lock(cfg->lock);
+    *cfg->shared_counter += 1;
+    (void) pthread_mutex_unlock(cfg->lock);
+
+    return (void*) (uintptr_t) (cfg->id + 1);
+}
+
+static void thetest_pthread_probe(void)
+{
+    const int worker_count = 4;
+    pthread_t threads[4];
+    thetest_pthread_arg_t args[4];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    volatile int shared_counter = 0;
+    int created = 0;
+
+    for (int i = 0; i < worker_count; i++)
+    {
+        args[i].id = i;
+        args[i].lock = &lock;
+        args[i].shared_counter = &shared_counter;
+        int rc = pthread_create(&threads[i], NULL, thetest_pthread_worker, &args[i]);
+        if (rc != 0)
+        {
+            printf("[TheTest] pthread_create failed idx=%d rc=%d\n", i, rc);
+            break;
+        }
+        created++;
+    }
+
+    int sum = 0;
+    bool ok = (created == worker_count);
+    for (int i = 0; i < created; i++)
+    {
+        void* retval = NULL;
+        int rc = pthread_join(threads[i], &retval);
+        if (rc != 0)
+        {
+            ok = false;
+            printf("[TheTest] pthread_join failed idx=%d rc=%d\n", i, rc);
+            continue;
+        }
+
+        sum += (int) (uintptr_t) retval;
+    }
+
+    int expected = (worker_count * (worker_count + 1)) / 2;
+    if (ok && sum == expected && shared_counter == worker_count)
+        printf("[TheTest] pthread shared-memory test: OK (sum=%d counter=%d)\n", sum, (int) shared_counter);
+    else
+        printf("[TheTest] pthread shared-memory test: FAILED (sum=%d expected=%d counter=%d created=%d)\n",
+               sum,
+               expected,
+               (int) shared_counter,
+               created);
+
+    (void) pthread_mutex_destroy(&lock);
+}
+
+typedef struct thetest_block_reader
+{
+    int fds[2];
+    pthread_t thread;
+    volatile int result;
+} thetest_block_reader_t;
+
+static void* thetest_block_reader_worker(void* arg)
+{
+    thetest_block_reader_t* reader = (thetest_block_reader_t*) arg;
+    char byte = 0;
+    ssize_t rc = read(reader->fds[0], &byte, 1U);
+    reader->result = (rc == 1) ? 1 : -1;
+    return NULL;
+}
+
+static bool thetest_block_bench_compute_round(uint32_t workers, uint64_t* out_cycles)
+{
+    int pids[THETEST_BLOCK_BENCH_PAIRS];
+    uint32_t started = 0;
+    bool ok = true;
+
+    uint64_t start = thetest_rdtsc();
+    for (uint32_t i = 0; i < workers; i++)
+    {
+        int pid = fork();
+        if (pid < 0)
+        {
+            printf("[TheTest] blocking bench: fork failed idx=%u rc=%d\n", (unsigned int) i, pid);
+            ok = false;
+            break;
+        }
+
+        if (pid == 0)
+        {
+            volatile uint64_t acc = 0x243F6A8885A308D3ULL + (uint64_t) i;
+            for (uint32_t iter = 0; iter < THETEST_BLOCK_BENCH_SPIN_ITERS; iter++)
+                acc = (acc * 6364136223846793005ULL) + (uint64_t) iter;
+            _exit(acc == 0ULL ? 2 : 0);
+        }
+
+        pids[started++] = pid;
+    }
+
+    for (uint32_t i = 0; i < started; i++)
+    {
+        int status = 0;
+        int signal = 0;
+        int wait_rc = thetest_wait_child(pids[i], &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS);
+        if (wait_rc != pids[i] || status != 0 || signal != 0)
+        {
+            printf("[TheTest] blocking bench: child %d failed rc=%d status=%d signal=%d\n",
+                   pids[i],
+                   wait_rc,
+                   status,
+                   signal);
+            ok = false;
+        }
+    }
+
+    *out_cycles = thetest_rdtsc() - start;
+    return ok;
+}
+
+static void thetest_blocking_bench_probe(void)
+{
+    const uint32_t pairs = THETEST_BLOCK_BENCH_PAIRS;
+    thetest_block_reader_t readers[THETEST_BLOCK_BENCH_PAIRS];
+    uint32_t readers_started = 0;
+    uint64_t cycles_per_ms = thetest_tsc_cycles_per_ms();
+    uint64_t idle_cycles = 0;
+    uint64_t loaded_cycles = 0;
+
+    if (!thetest_block_bench_compute_round(pairs, &idle_cycles))
+    {
+        printf("[TheTest] blocking bench: FAILED (baseline round)\n");
+        return;
+    }
+
+    bool ok = true;
+    for (uint32_t i = 0; i < pairs; i++)
+    {
+        readers[i].result = 0;
+        if (pipe(readers[i].fds) != 0)
+        {
+            printf("[TheTest] blocking bench: pipe failed idx=%u\n", (unsigned int) i);
+            ok = false;
+            break;
+        }
+
+        if (pthread_create(&readers[i].thread, NULL, thetest_block_reader_worker, &readers[i]) != 0)
+        {
+            printf("[TheTest] blocking bench: pthread_create failed idx=%u\n", (unsigned int) i);
+            (void) close(readers[i].fds[0]);
+            (void) close(readers[i].fds[1]);
+            ok = false;
+            break;
+        }
+        readers_started++;
+    }
+
+    // Give the readers time to reach read() and block before loading the CPUs.
+    (void) usleep(THETEST_BLOCK_BENCH_SETTLE_MS * 1000U);
+
+    if (ok && !thetest_block_bench_compute_round(pairs, &loaded_cycles))
+        ok = false;
+
+    uint32_t readers_woken = 0;
+    for (uint32_t i = 0; i < readers_started; i++)
+    {
+        char byte = 'w';
+        (void) write(readers[i].fds[1], &byte, 1U);
+        (void) pthread_join(readers[i].thread, NULL);
+        if (readers[i].result == 1)
+            readers_woken++;
+        (void) close(readers[i].fds[0]);
+        (void) close(readers[i].fds[1]);
+    }
+
+    if (!ok || readers_woken != pairs || cycles_per_ms == 0 || idle_cycles == 0)
+    {
+        printf("[TheTest] blocking bench: FAILED (readers=%u woken=%u)\n",
+               (unsigned int) readers_started,
+               (unsigned int) readers_woken);
+        return;
+    }
+
+    // Ratio ~1.00 means blocked readers cost the compute workers nothing.
+    uint64_t ratio_x100 = (loaded_cycles * 100ULL) / idle_cycles;
+    printf("[TheTest] blocking bench: OK readers=%u compute=%u idle=%llu ms loaded=%llu ms ratio=%llu.%02llu\n",
+           (unsigned int) pairs,
+           (unsigned int) pairs,
+           (unsigned long long) (idle_cycles / cycles_per_ms),
+           (unsigned long long) (loaded_cycles / cycles_per_ms),
+           (unsigned long long) (ratio_x100 / 100ULL),
+           (unsigned long long) (ratio_x100 % 100ULL));
+}
+
+static const uint32_t TheTest_pick_bench_sizes[] = { 8U, 64U, THETEST_PICK_BENCH_MAX_PROCS };
+
+static void thetest_pick_bench_round(uint32_t procs)
+{
+    int pids[THETEST_PICK_BENCH_MAX_PROCS];
+    uint32_t spawned = 0;
+    syscall_sched_info_t before;
+    syscall_sched_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+
+    if (sys_sched_info_get(&before) != 0)
+    {
+        printf("[TheTest] sched pick bench: sched info unavailable\n");
+        return;
+    }
+
+    for (uint32_t i = 0; i < procs; i++)
+    {
+        int pid = fork();
+        if (pid < 0)
+            break;
+
+        if (pid == 0)
+        {
+            // Mostly asleep: every wakeup and yield goes through pick-next.
+            for (uint32_t round = 0; round < THETEST_PICK_BENCH_ROUNDS; round++)
+            {
+                (void) sched_yield();
+                (void) usleep(THETEST_PICK_BENCH_SLEEP_US);
+            }
+            _exit(0);
+        }
+
+        pids[spawned++] = pid;
+    }
+
+    bool ok = (spawned == procs);
+    for (uint32_t i = 0; i < spawned; i++)
+    {
+        int status = 0;
+        int signal = 0;
+        int wait_rc = thetest_wait_child(pids[i], &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS);
+        if (wait_rc != pids[i] || status != 0 || signal != 0)
+            ok = false;
+    }
+
+    if (sys_sched_info_get(&after) != 0)
+        ok = false;
+
+    uint64_t picks = after.pick_next_calls - before.pick_next_calls;
+    uint64_t cycles = after.pick_next_cycles - before.pick_next_cycles;
+    printf("[TheTest] sched pick bench: %s procs=%u spawned=%u picks=%llu avg=%llu cycles steals=%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) procs,
+           (unsigned int) spawned,
+           (unsigned long long) picks,
+           (unsigned long long) (picks ? (cycles / picks) : 0ULL),
+           (unsigned long long) (after.user_steals - before.user_steals));
+}
+
+static void thetest_pick_bench_probe(void)
+{
+    for (uint32_t i = 0; i < sizeof(TheTest_pick_bench_sizes) / sizeof(TheTest_pick_bench_sizes[0]); i++)
+        thetest_pick_bench_round(TheTest_pick_bench_sizes[i]);
+}
+
+// Spin between two TSC deadlines on CPU 0 and report how many iterations this process got.
+static void thetest_sched_class_spinner(int out_fd, int nice_value, int policy, uint64_t start, uint64_t end)
+{
+    cpu_set_t cpu0;
+    CPU_ZERO(&cpu0);
+    CPU_SET(0, &cpu0);
+    if (sched_setaffinity(0, sizeof(cpu0), &cpu0) != 0)
+        _exit(2);
+    if (nice_value != 0 && setpriority(PRIO_PROCESS, 0, nice_value) != 0)
+        _exit(3);
+    if (policy != SCHED_OTHER)
+    {
+        struct sched_param param = { .sched_priority = THETEST_SCHED_CLASS_RT_PRIO };
+        if (sched_setscheduler(0, policy, &param) != 0)
+            _exit(4);
+    }
+
+    while (thetest_rdtsc() < start)
+        (void) sched_yield();
+
+    uint64_t iterations = 0;
+    while (thetest_rdtsc() < end)
+        iterations++;
+
+    (void) write(out_fd, &iterations, sizeof(iterations));
+    _exit(0);
+}
+
+static bool thetest_sched_class_round(const char* label,
+                                      int nice_a, int policy_a,
+                                      int nice_b, int policy_b,
+                                      uint64_t cycles_per_ms,
+                                      uint64_t* out_a, uint64_t* out_b)
+{
+    int fds[2][2];
+    int pids[2] = { -1, -1 };
+    int nice_values[2] = { nice_a, nice_b };
+    int policies[2] = { policy_a, policy_b };
+    uint64_t start = thetest_rdtsc() + cycles_per_ms * THETEST_SCHED_CLASS_SETTLE_MS;
+    uint64_t end = start + cycles_per_ms * THETEST_SCHED_CLASS_RUN_MS;
+    uint64_t counts[2] = { 0, 0 };
+    bool ok = true;
+
+    for (uint32_t i = 0; i < 2U; i++)
+    {
+        if (pipe(fds[i]) != 0)
+        {
+            printf("[TheTest] sched class %s: pipe failed errno=%d\n", label, errno);
+            return false;
+        }
+
+        pids[i] = fork();
+        if (pids[i] == 0)
+        {
+            (void) close(fds[i][0]);
+            thetest_sched_class_spinner(fds[i][1], nice_values[i], policies[i], start, end);
+        }
+        (void) close(fds[i][1]);
+        if (pids[i] < 0)
+            ok = false;
+    }
+
+    for (uint32_t i = 0; i < 2U; i++)
+    {
+        if (pids[i] > 0)
+        {
+            int status = 0;
+            int signal = 0;
+            if (read(fds[i][0], &counts[i], sizeof(counts[i])) != (int) sizeof(counts[i]))
+                ok = false;
+            if (thetest_wait_child(pids[i], &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS) != pids[i] ||
+                status != 0 || signal != 0)
+                ok = false;
+        }
+        (void) close(fds[i][0]);
+    }
+
+    *out_a = counts[0];
+    *out_b = counts[1];
+    return ok;
+}
+
+static void thetest_sched_class_probe(void)
+{
+    struct sched_param param = { .sched_priority = 0 };
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+
+    bool api_ok = sched_getscheduler(0) == SCHED_OTHER &&
+                  sched_get_priority_min(SCHED_FIFO) == (int) SYS_SCHED_RT_PRIO_MIN &&
+                  sched_get_priority_max(SCHED_FIFO) == (int) SYS_SCHED_RT_PRIO_MAX &&
+                  sched_getparam(0, &param) == 0 && param.sched_priority == 0 &&
+                  sched_getaffinity(0, sizeof(mask), &mask) == 0 && CPU_ISSET(0, &mask) &&
+                  setpriority(PRIO_PROCESS, 0, 5) == 0 && getpriority(PRIO_PROCESS, 0) == 5 &&
+                  setpriority(PRIO_PROCESS, 0, 0) == 0;
+    param.sched_priority = (int) SYS_SCHED_RT_PRIO_MAX + 1;
+    api_ok = api_ok && sched_setscheduler(0, SCHED_FIFO, &param) != 0;
+    printf("[TheTest] sched class api: %s\n", api_ok ? "OK" : "FAILED");
+
+    uint64_t cycles_per_ms = thetest_tsc_cycles_per_ms();
+    if (cycles_per_ms == 0)
+    {
+        printf("[TheTest] sched class: TSC calibration failed\n");
+        return;
+    }
+
+    // Weights 1024 vs 110: the nice 0 spinner should get about nine times the iterations.
+    uint64_t nice0 = 0;
+    uint64_t niced = 0;
+    bool ok = thetest_sched_class_round("nice", 0, SCHED_OTHER, THETEST_SCHED_CLASS_NICE, SCHED_OTHER,
+                                        cycles_per_ms, &nice0, &niced);
+    uint64_t ratio_x100 = niced ? (nice0 * 100ULL) / niced : 0ULL;
+    printf("[TheTest] sched class nice: %s nice0=%llu nice%d=%llu ratio=%llu.%02llu\n",
+           (ok && ratio_x100 >= 300ULL) ? "OK" : "FAILED",
+           (unsigned long long) nice0,
+           THETEST_SCHED_CLASS_NICE,
+           (unsigned long long) niced,
+           (unsigned long long) (ratio_x100 / 100ULL),
+           (unsigned long long) (ratio_x100 % 100ULL));
+
+    // RT throttling leaves fair work a small share, so the FIFO spinner must clearly dominate.
+    uint64_t rt = 0;
+    uint64_t fair = 0;
+    ok = thetest_sched_class_round("fifo", 0, SCHED_FIFO, 0, SCHED_OTHER, cycles_per_ms, &rt, &fair);
+    ratio_x100 = fair ? (rt * 100ULL) / fair : (rt ? 10000ULL : 0ULL);
+    printf("[TheTest] sched class fifo: %s rt=%llu fair=%llu ratio=%llu.%02llu\n",
+           (ok && ratio_x100 >= 500ULL) ? "OK" : "FAILED",
+           (unsigned long long) rt,
+           (unsigned long long) fair,
+           (unsigned long long) (ratio_x100 / 100ULL),
+           (unsigned long long) (ratio_x100 % 100ULL));
+}
+
+static uint64_t thetest_timeval_us(const struct timeval* tv)
+{
+    return (uint64_t) tv->tv_sec * 1000000ULL + (uint64_t) tv->tv_usec;
+}
+
+static void thetest_rusage_spin(uint64_t cycles_per_ms, uint32_t ms)
+{
+    uint64_t end = thetest_rdtsc() + cycles_per_ms * ms;
+    while (thetest_rdtsc() < end)
+        __asm__ __volatile__("pause");
+}
+
+static void thetest_rusage_probe(void)
+{
+    uint64_t cycles_per_ms = thetest_tsc_cycles_per_ms();
+    struct rusage before;
+    struct rusage after;
+    if (cycles_per_ms == 0 || getrusage(RUSAGE_SELF, &before) != 0)
+    {
+        printf("[TheTest] rusage: setup failed\n");
+        return;
+    }
+
+    thetest_rusage_spin(cycles_per_ms, THETEST_RUSAGE_SPIN_MS);
+    for (uint32_t i = 0; i < THETEST_RUSAGE_SLEEPS; i++)
+        (void) usleep(2000U);
+
+    if (getrusage(RUSAGE_SELF, &after) != 0)
+    {
+        printf("[TheTest] rusage: getrusage failed\n");
+        return;
+    }
+
+    // Other runnable work may take part of the CPU during the spin, so only half is required.
+    uint64_t utime_us = thetest_timeval_us(&after.ru_utime) - thetest_timeval_us(&before.ru_utime);
+    long nvcsw = after.ru_nvcsw - before.ru_nvcsw;
+    bool self_ok = utime_us >= (uint64_t) THETEST_RUSAGE_SPIN_MS * 500ULL &&
+                   nvcsw >= (long) THETEST_RUSAGE_SLEEPS;
+    printf("[TheTest] rusage self: %s utime=%lluus stime=%lluus nvcsw=%ld nivcsw=%ld\n",
+           self_ok ? "OK" : "FAILED",
+           (unsigned long long) utime_us,
+           (unsigned long long) (thetest_timeval_us(&after.ru_stime) - thetest_timeval_us(&before.ru_stime)),
+           nvcsw,
+           after.ru_nivcsw - before.ru_nivcsw);
+
+    struct tms tms_before;
+    struct tms tms_after;
+    if (times(&tms_before) == (clock_t) -1)
+    {
+        printf("[TheTest] rusage children: times failed\n");
+        return;
+    }
+
+    int pid = fork();
+    if (pid < 0)
+    {
+        printf("[TheTest] rusage children: fork failed rc=%d\n", pid);
+        return;
+    }
+    if (pid == 0)
+    {
+        thetest_rusage_spin(cycles_per_ms, THETEST_RUSAGE_SPIN_MS);
+        _exit(0);
+    }
+
+    int status = 0;
+    int signal = 0;
+    int wait_rc = thetest_wait_child(pid, &status, &signal, 5000U);
+    if (wait_rc < 0)
+    {
+        if (wait_rc == -2)
+            (void) kill(pid, SIGKILL);
+        printf("[TheTest] rusage children: wait failed rc=%d\n", wait_rc);
+        return;
+    }
+
+    clock_t elapsed = times(&tms_after);
+    bool child_ok = elapsed != (clock_t) -1 && tms_after.tms_cutime > tms_before.tms_cutime;
+    printf("[TheTest] rusage children: %s cutime=%ld cstime=%ld ticks\n",
+           child_ok ? "OK" : "FAILED",
+           (long) (tms_after.tms_cutime - tms_before.tms_cutime),
+           (long) (tms_after.tms_cstime - tms_before.tms_cstime));
+}
+
+// Run one storm of `iters` syscalls per worker after a common start; return calls per ms across all workers.
+static uint64_t thetest_syscall_scaling_round(uint32_t workers, bool yield_storm, uint64_t cycles_per_ms)
+{
+    int fds[2];
+    int pids[THETEST_SYSCALL_SCALING_MAX_PROCS];
+    uint32_t spawned = 0;
+    if (pipe(fds) != 0)
+        return 0;
+
+    uint64_t start = thetest_rdtsc() + cycles_per_ms * THETEST_SYSCALL_SCALING_SETTLE_MS;
+    for (uint32_t i = 0; i < workers; i++)
+    {
+        int pid = fork();
+        if (pid < 0)
+            break;
+
+        if (pid == 0)
+        {
+            (void) close(fds[0]);
+            while (thetest_rdtsc() < start)
+                __asm__ __volatile__("pause");
+
+            for (uint32_t iter = 0; iter < THETEST_SYSCALL_SCALING_ITERS; iter++)
+            {
+                if (yield_storm)
+                    (void) sched_yield();
+                else
+                    (void) getpid();
+            }
+
+            uint64_t end = thetest_rdtsc();
+            (void) write(fds[1], &end, sizeof(end));
+            _exit(0);
+        }
+
+        pids[spawned++] = pid;
+    }
+    (void) close(fds[1]);
+
+    bool ok = (spawned == workers);
+    uint64_t last_end = 0;
+    for (uint32_t i = 0; i < spawned; i++)
+    {
+        uint64_t end = 0;
+        if (read(fds[0], &end, sizeof(end)) != (int) sizeof(end))
+            ok = false;
+        else if (end > last_end)
+            last_end = end;
+    }
+    for (uint32_t i = 0; i < spawned; i++)
+    {
+        int status = 0;
+        int signal = 0;
+        if (thetest_wait_child(pids[i], &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS) != pids[i] ||
+            status != 0 || signal != 0)
+            ok = false;
+    }
+    (void) close(fds[0]);
+
+    if (!ok || last_end <= start)
+        return 0;
+
+    uint64_t calls = (uint64_t) workers * THETEST_SYSCALL_SCALING_ITERS;
+    return (calls * cycles_per_ms) / (last_end - start);
+}
+
+static void thetest_syscall_scaling_probe(void)
+{
+    syscall_cpu_info_t cpu_info;
+    memset(&cpu_info, 0, sizeof(cpu_info));
+    uint64_t cycles_per_ms = thetest_tsc_cycles_per_ms();
+    if (cycles_per_ms == 0 || sys_cpu_info_get(&cpu_info) != 0)
+    {
+        printf("[TheTest] syscall scaling: setup failed\n");
+        return;
+    }
+
+    uint32_t max_workers = cpu_info.online_cpus ? cpu_info.online_cpus : 1U;
+    if (max_workers > THETEST_SYSCALL_SCALING_MAX_PROCS)
+        max_workers = THETEST_SYSCALL_SCALING_MAX_PROCS;
+
+    for (uint32_t storm = 0; storm < 2U; storm++)
+    {
+        bool yield_storm = (storm != 0);
+        const char* label = yield_storm ? "yield" : "getpid";
+        uint64_t single = 0;
+        uint64_t rate = 0;
+        uint32_t workers = 1;
+        for (;;)
+        {
+            rate = thetest_syscall_scaling_round(workers, yield_storm, cycles_per_ms);
+            if (workers == 1U)
+                single = rate;
+            printf("[TheTest] syscall scaling %s: procs=%u rate=%llu calls/ms\n",
+                   label,
+                   (unsigned int) workers,
+                   (unsigned long long) rate);
+            if (rate == 0 || workers >= max_workers)
+                break;
+            workers = (workers * 2U > max_workers) ? max_workers : workers * 2U;
+        }
+
+        // One lock for every syscall keeps the speedup near 1.00 however many CPUs join in.
+        uint64_t speedup_x100 = single ? (rate * 100ULL) / single : 0ULL;
+        bool ok = rate != 0 && speedup_x100 * 2ULL >= (uint64_t) workers * 100ULL;
+        printf("[TheTest] syscall scaling %s: %s procs=%u speedup=%llu.%02llu\n",
+               label,
+               ok ? "OK" : "FAILED",
+               (unsigned int) workers,
+               (unsigned long long) (speedup_x100 / 100ULL),
+               (unsigned long long) (speedup_x100 % 100ULL));
+    }
+}
+
+static void thetest_null_syscall_probe(void)
+{
+    syscall_stats_info_t* before = (syscall_stats_info_t*) malloc(sizeof(*before));
+    syscall_stats_info_t* after = (syscall_stats_info_t*) malloc(sizeof(*after));
+    if (!before || !after)
+    {
+        printf("[TheTest] null syscall: allocation failed\n");
+        free(before);
+        free(after);
+        return;
+    }
+
+    pid_t self = getpid();
+    if (self <= 0 || sys_syscall_stats_get(before) != 0)
+    {
+        printf("[TheTest] null syscall: setup failed\n");
+        free(before);
+        free(after);
+        return;
+    }
+
+    // getpid takes the fast return; kill(self, 0) does the same amount of work through the post handler.
+    uint64_t start = thetest_rdtsc();
+    for (uint32_t i = 0; i < THETEST_NULL_SYSCALL_ITERS; i++)
+        (void) getpid();
+    uint64_t fast_cycles = thetest_rdtsc() - start;
+
+    start = thetest_rdtsc();
+    for (uint32_t i = 0; i < THETEST_NULL_SYSCALL_ITERS; i++)
+        (void) kill(self, 0);
+    uint64_t full_cycles = thetest_rdtsc() - start;
+
+    bool ok = sys_syscall_stats_get(after) == 0 && after->nr_count > SYS_GETPID && after->nr_count > SYS_KILL;
+    uint64_t getpid_calls = ok ? after->calls[SYS_GETPID] - before->calls[SYS_GETPID] : 0ULL;
+    uint64_t kill_calls = ok ? after->calls[SYS_KILL] - before->calls[SYS_KILL] : 0ULL;
+    uint64_t fast_returns = ok ? after->fast_returns - before->fast_returns : 0ULL;
+    ok = ok && getpid_calls >= THETEST_NULL_SYSCALL_ITERS && kill_calls >= THETEST_NULL_SYSCALL_ITERS &&
+         fast_returns >= THETEST_NULL_SYSCALL_ITERS / 2U;
+
+    printf("[TheTest] null syscall: %s getpid=%llu cycles kill0=%llu cycles fast_returns=%llu/%u\n",
+           ok ? "OK" : "FAILED",
+           (unsigned long long) (fast_cycles / THETEST_NULL_SYSCALL_ITERS),
+           (unsigned long long) (full_cycles / THETEST_NULL_SYSCALL_ITERS),
+           (unsigned long long) fast_returns,
+           (unsigned int) THETEST_NULL_SYSCALL_ITERS);
+    free(before);
+    free(after);
+}
+
+static uint64_t thetest_timespec_ns(const struct timespec* ts)
+{
+    return (uint64_t) ts->tv_sec * 1000000000ULL + (uint64_t) ts->tv_nsec;
+}
+
+static void thetest_vdso_clock_probe(void)
+{
+    syscall_stats_info_t* before = (syscall_stats_info_t*) malloc(sizeof(*before));
+    syscall_stats_info_t* after = (syscall_stats_info_t*) malloc(sizeof(*after));
+    if (!before || !after || sys_syscall_stats_get(before) != 0)
+    {
+        printf("[TheTest] vdso clock: setup failed\n");
+        free(before);
+        free(after);
+        return;
+    }
+
+    // Monotonic must never step back, and the vvar tick must match the kernel's own.
+    struct timespec ts;
+    bool ok = clock_gettime(CLOCK_MONOTONIC, &ts) == 0;
+    uint64_t prev_ns = thetest_timespec_ns(&ts);
+    uint64_t start = thetest_rdtsc();
+    for (uint32_t i = 0; ok && i < THETEST_VDSO_READS; i++)
+    {
+        ok = clock_gettime(CLOCK_MONOTONIC, &ts) == 0 && thetest_timespec_ns(&ts) >= prev_ns;
+        prev_ns = thetest_timespec_ns(&ts);
+    }
+    uint64_t read_cycles = thetest_rdtsc() - start;
+    for (uint32_t i = 0; i < THETEST_VDSO_READS; i++)
+        (void) sys_tick_get();
+    uint64_t vvar_ticks = sys_tick_get();
+    uint64_t kernel_ticks = (uint64_t) syscall(SYS_TICK_GET, 0, 0, 0, 0, 0, 0);
+
+    bool stats_ok = sys_syscall_stats_get(after) == 0;
+    uint64_t tick_syscalls = stats_ok ? after->calls[SYS_TICK_GET] - before->calls[SYS_TICK_GET] : 0ULL;
+    bool ticks_ok = kernel_ticks >= vvar_ticks && kernel_ticks - vvar_ticks <= 2ULL;
+    printf("[TheTest] vdso clock reads: %s read=%llu cycles tick_syscalls=%llu vvar_tick=%llu kernel_tick=%llu\n",
+           (ok && stats_ok && tick_syscalls == 1ULL && ticks_ok) ? "OK" : "FAILED",
+           (unsigned long long) (read_cycles / THETEST_VDSO_READS),
+           (unsigned long long) tick_syscalls,
+           (unsigned long long) vvar_ticks,
+           (unsigned long long) kernel_ticks);
+    free(before);
+    free(after);
+
+    struct timespec mono_before;
+    struct timespec mono_after;
+    (void) clock_gettime(CLOCK_MONOTONIC, &mono_before);
+    (void) usleep(THETEST_VDSO_SLEEP_MS * 1000U);
+    (void) clock_gettime(CLOCK_MONOTONIC, &mono_after);
+    uint64_t slept_us = (thetest_timespec_ns(&mono_after) - thetest_timespec_ns(&mono_before)) / 1000ULL;
+    bool sleep_ok = slept_us >= (uint64_t) THETEST_VDSO_SLEEP_MS * 900ULL &&
+                    slept_us <= (uint64_t) THETEST_VDSO_SLEEP_MS * 10000ULL;
+
+    // Wall clock agrees with the RTC syscall to the second when the machine has one.
+    struct timeval tv;
+    uint64_t rtc_seconds = sys_rtc_time_get();
+    bool wall_ok = gettimeofday(&tv, NULL) == 0 && tv.tv_usec >= 0 && tv.tv_usec < 1000000L;
+    if (wall_ok && rtc_seconds != 0ULL)
+    {
+        uint64_t wall = (uint64_t) tv.tv_sec;
+        wall_ok = (wall >= rtc_seconds ? wall - rtc_seconds : rtc_seconds - wall) <= 2ULL &&
+                  (uint64_t) time(NULL) + 2ULL >= wall;
+    }
+    printf("[TheTest] vdso clock time: %s slept=%lluus wall=%lld rtc=%llu\n",
+           (sleep_ok && wall_ok) ? "OK" : "FAILED",
+           (unsigned long long) slept_us,
+           (long long) tv.tv_sec,
+           (unsigned long long) rtc_seconds);
+}
+
+// Touch one byte per page so each side of the ping-pong keeps a TLB working set alive.
+static void thetest_pcid_touch(volatile uint8_t* pages, uint32_t round)
+{
+    for (uint32_t i = 0; i < THETEST_PCID_TOUCH_PAGES; i++)
+        pages[(size_t) i * 4096U] = (uint8_t) (pages[(size_t) i * 4096U] + round);
+}
+
+static void thetest_pcid_pingpong_probe(void)
+{
+    cpu_set_t saved;
+    cpu_set_t cpu0;
+    CPU_ZERO(&cpu0);
+    CPU_SET(0, &cpu0);
+    if (sched_getaffinity(0, sizeof(saved), &saved) != 0 || sched_setaffinity(0, sizeof(cpu0), &cpu0) != 0)
+    {
+        printf("[TheTest] pcid pingpong: affinity failed errno=%d\n", errno);
+        return;
+    }
+
+    volatile uint8_t* pages = (volatile uint8_t*) malloc((size_t) THETEST_PCID_TOUCH_PAGES * 4096U);
+    int to_child[2] = { -1, -1 };
+    int to_parent[2] = { -1, -1 };
+    if (!pages || pipe(to_child) != 0 || pipe(to_parent) != 0)
+    {
+        printf("[TheTest] pcid pingpong: setup failed errno=%d\n", errno);
+        free((void*) pages);
+        (void) sched_setaffinity(0, sizeof(saved), &saved);
+        return;
+    }
+    memset((void*) pages, 0, (size_t) THETEST_PCID_TOUCH_PAGES * 4096U);
+
+    // Both processes inherit the CPU 0 pin, so every round trip is two CR3 switches on one CPU.
+    int pid = fork();
+    if (pid == 0)
+    {
+        (void) close(to_child[1]);
+        (void) close(to_parent[0]);
+        uint8_t token = 0;
+        for (uint32_t i = 0; i < THETEST_PCID_ROUNDS; i++)
+        {
+            if (read(to_child[0], &token, 1) != 1)
+                _exit(1);
+            thetest_pcid_touch(pages, i);
+            if (write(to_parent[1], &token, 1) != 1)
+                _exit(2);
+        }
+        _exit(0);
+    }
+    (void) close(to_child[0]);
+    (void) close(to_parent[1]);
+
+    syscall_tlb_info_t before;
+    syscall_tlb_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    bool ok = pid > 0 && sys_tlb_info_get(&before) == 0;
+    uint64_t start_ns = sys_monotonic_ns();
+    uint8_t token = 0x5A;
+    for (uint32_t i = 0; ok && i < THETEST_PCID_ROUNDS; i++)
+    {
+        thetest_pcid_touch(pages, i);
+        ok = write(to_child[1], &token, 1) == 1 && read(to_parent[0], &token, 1) == 1;
+    }
+    uint64_t elapsed_ns = sys_monotonic_ns() - start_ns;
+    ok = sys_tlb_info_get(&after) == 0 && ok;
+
+    (void) close(to_child[1]);
+    (void) close(to_parent[0]);
+    if (pid > 0)
+    {
+        int status = 0;
+        int signal = 0;
+        if (thetest_wait_child(pid, &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS) != pid || status != 0 || signal != 0)
+            ok = false;
+    }
+    (void) sched_setaffinity(0, sizeof(saved), &saved);
+    free((void*) pages);
+
+    uint64_t switches = after.cr3_switches - before.cr3_switches;
+    uint64_t noflush = after.cr3_noflush - before.cr3_noflush;
+    // With PCIDs most switches between the two address spaces must keep their TLB entries.
+    if (ok && after.pcid_enabled != 0U)
+        ok = switches >= THETEST_PCID_ROUNDS && noflush * 2U >= switches;
+
+    printf("[TheTest] pcid pingpong: %s pcid=%s invpcid=%s rounds=%u rtt=%lluns cr3_switches=%llu noflush=%llu flush=%llu recycles=%llu\n",
+           ok ? "OK" : "FAILED",
+           after.pcid_enabled ? "on" : "off",
+           after.invpcid ? "on" : "off",
+           (unsigned int) THETEST_PCID_ROUNDS,
+           (unsigned long long) (elapsed_ns / THETEST_PCID_ROUNDS),
+           (unsigned long long) switches,
+           (unsigned long long) noflush,
+           (unsigned long long) (after.cr3_flush - before.cr3_flush),
+           (unsigned long long) (after.pcid_recycles - before.pcid_recycles));
+}
+
+static void thetest_pmm_flat_probe(void)
+{
+    syscall_mem_info_t before;
+    syscall_mem_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    bool ok = sys_mem_info_get(&before) == 0;
+
+    size_t len = (size_t) THETEST_PMM_FLAT_MAP_PAGES * 4096U;
+    for (uint32_t round = 0; ok && round < THETEST_PMM_FLAT_ROUNDS; round++)
+    {
+        volatile uint8_t* map_ptr = (volatile uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if ((void*) map_ptr == MAP_FAILED)
+        {
+            ok = false;
+            break;
+        }
+        for (uint32_t i = 0; i < THETEST_PMM_FLAT_MAP_PAGES; i++)
+            map_ptr[(size_t) i * 4096U] = (uint8_t) (round + i);
+
+        // The child shares the mapping copy-on-write and breaks half of it before exiting.
+        int pid = fork();
+        if (pid == 0)
+        {
+            for (uint32_t i = 0; i < THETEST_PMM_FLAT_MAP_PAGES; i += 2U)
+                map_ptr[(size_t) i * 4096U] ^= 0xFFU;
+            _exit(0);
+        }
+
+        int status = 0;
+        int signal = 0;
+        if (pid < 0 || thetest_wait_child(pid, &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS) != pid ||
+            status != 0 || signal != 0)
+            ok = false;
+        if (munmap((void*) map_ptr, len) != 0)
+            ok = false;
+    }
+    ok = sys_mem_info_get(&after) == 0 && ok;
+
+    int64_t lost = (int64_t) before.free_pages - (int64_t) after.free_pages;
+    if (ok)
+        ok = lost <= (int64_t) THETEST_PMM_FLAT_SLACK_PAGES;
+
+    printf("[TheTest] pmm flat: %s rounds=%u free_before=%llu free_after=%llu lost=%lld total=%llu frees=%llu merges=%llu bad_frees=%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) THETEST_PMM_FLAT_ROUNDS,
+           (unsigned long long) before.free_pages,
+           (unsigned long long) after.free_pages,
+           (long long) lost,
+           (unsigned long long) after.total_pages,
+           (unsigned long long) (after.frees - before.frees),
+           (unsigned long long) (after.merges - before.merges),
+           (unsigned long long) (after.bad_frees - before.bad_frees));
+}
+
+static void thetest_numa_nodes_probe(void)
+{
+    syscall_mem_info_t before;
+    syscall_mem_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    bool ok = sys_mem_info_get(&before) == 0;
+
+    size_t len = (size_t) THETEST_NUMA_MAP_PAGES * 4096U;
+    volatile uint8_t* map_ptr = (volatile uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((void*) map_ptr == MAP_FAILED)
+        ok = false;
+    else
+    {
+        for (uint32_t i = 0; i < THETEST_NUMA_MAP_PAGES; i++)
+            map_ptr[(size_t) i * 4096U] = (uint8_t) i;
+    }
+    ok = sys_mem_info_get(&after) == 0 && ok;
+    if ((void*) map_ptr != MAP_FAILED && munmap((void*) map_ptr, len) != 0)
+        ok = false;
+
+    if (ok && (after.node_count == 0 || after.node_count > SYS_MEM_MAX_NODES))
+        ok = false;
+
+    uint64_t total_sum = 0;
+    uint64_t local = 0;
+    uint64_t remote = 0;
+    for (uint32_t node = 0; ok && node < after.node_count; node++)
+    {
+        total_sum += after.node_total_pages[node];
+        if (after.node_free_pages[node] > after.node_total_pages[node])
+            ok = false;
+        local += after.node_local_allocs[node] - before.node_local_allocs[node];
+        remote += after.node_remote_allocs[node] - before.node_remote_allocs[node];
+        printf("[TheTest] numa node=%u total=%llu free=%llu local_allocs=%llu remote_allocs=%llu\n",
+               (unsigned int) after.node_id[node],
+               (unsigned long long) after.node_total_pages[node],
+               (unsigned long long) after.node_free_pages[node],
+               (unsigned long long) after.node_local_allocs[node],
+               (unsigned long long) after.node_remote_allocs[node]);
+    }
+    if (ok)
+        ok = total_sum == after.total_pages;
+
+    printf("[TheTest] numa nodes: %s nodes=%u total=%llu node_sum=%llu touched=%u local=%llu remote=%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) after.node_count,
+           (unsigned long long) after.total_pages,
+           (unsigned long long) total_sum,
+           (unsigned int) THETEST_NUMA_MAP_PAGES,
+           (unsigned long long) local,
+           (unsigned long long) remote);
+}
+
+static int64_t thetest_free_pages_delta(const syscall_mem_info_t* before)
+{
+    syscall_mem_info_t now;
+    memset(&now, 0, sizeof(now));
+    if (sys_mem_info_get(&now) != 0)
+        return INT64_MAX;
+    return (int64_t) before->free_pages - (int64_t) now.free_pages;
+}
+
+static void thetest_lazy_map_probe(void)
+{
+    syscall_mem_info_t base_info;
+    memset(&base_info, 0, sizeof(base_info));
+    bool ok = sys_mem_info_get(&base_info) == 0;
+
+    size_t len = (size_t) THETEST_LAZY_MAP_PAGES * 4096U;
+    const uint32_t touched = THETEST_LAZY_MAP_PAGES / THETEST_LAZY_TOUCH_STRIDE;
+
+    uint64_t start_ns = sys_monotonic_ns();
+    volatile uint8_t* map_ptr = (volatile uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uint64_t lazy_map_ns = sys_monotonic_ns() - start_ns;
+    if ((void*) map_ptr == MAP_FAILED)
+        ok = false;
+
+    // Reserving the range costs page tables only.
+    int64_t after_map = ok ? thetest_free_pages_delta(&base_info) : 0;
+    if (after_map > (int64_t) THETEST_LAZY_SLACK_PAGES)
+        ok = false;
+
+    for (uint32_t i = 0; ok && i < THETEST_LAZY_MAP_PAGES; i += THETEST_LAZY_TOUCH_STRIDE)
+    {
+        if (map_ptr[(size_t) i * 4096U + 123U] != 0)
+            ok = false;
+        map_ptr[(size_t) i * 4096U] = (uint8_t) (i + 1U);
+    }
+    // A touch that lands in a 2 MiB reservation backs the whole chunk at once.
+    syscall_mem_info_t touch_info;
+    memset(&touch_info, 0, sizeof(touch_info));
+    if (ok && sys_mem_info_get(&touch_info) != 0)
+        ok = false;
+    int64_t huge_extra = (int64_t) (touch_info.thp_faults - base_info.thp_faults) * 511;
+    int64_t after_touch = ok ? thetest_free_pages_delta(&base_info) : 0;
+    if (ok && (after_touch < (int64_t) touched ||
+               after_touch > (int64_t) touched + huge_extra + (int64_t) THETEST_LAZY_SLACK_PAGES))
+        ok = false;
+
+    // The child sees the touched pages and faults in fresh zero pages for the others.
+    if (ok)
+    {
+        int pid = fork();
+        if (pid == 0)
+        {
+            int rc = 0;
+            for (uint32_t i = 0; i < THETEST_LAZY_MAP_PAGES; i++)
+            {
+                uint8_t expect = (i % THETEST_LAZY_TOUCH_STRIDE) == 0 ? (uint8_t) (i + 1U) : 0U;
+                if (map_ptr[(size_t) i * 4096U] != expect)
+                    rc = 1;
+                map_ptr[(size_t) i * 4096U] = 0x5AU;
+            }
+            _exit(rc);
+        }
+
+        int status = 0;
+        int signal = 0;
+        if (pid < 0 || thetest_wait_child(pid, &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS) != pid ||
+            status != 0 || signal != 0)
+            ok = false;
+        for (uint32_t i = 1; ok && i < THETEST_LAZY_MAP_PAGES; i += THETEST_LAZY_TOUCH_STRIDE)
+        {
+            if (map_ptr[(size_t) i * 4096U] != 0)
+                ok = false;
+        }
+    }
+    if ((void*) map_ptr != MAP_FAILED && munmap((void*) map_ptr, len) != 0)
+        ok = false;
+
+    start_ns = sys_monotonic_ns();
+    void* eager_ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    uint64_t eager_map_ns = sys_monotonic_ns() - start_ns;
+    int64_t after_populate = 0;
+    if (eager_ptr == MAP_FAILED)
+        ok = false;
+    else
+    {
+        after_populate = thetest_free_pages_delta(&base_info);
+        if (after_populate < (int64_t) THETEST_LAZY_MAP_PAGES)
+            ok = false;
+        if (munmap(eager_ptr, len) != 0)
+            ok = false;
+    }
+
+    int64_t lost = thetest_free_pages_delta(&base_info);
+    if (ok && lost > (int64_t) THETEST_LAZY_SLACK_PAGES)
+        ok = false;
+
+    printf("[TheTest] lazy map: %s pages=%u touched=%u map_cost=%lld touch_cost=%lld populate_cost=%lld lost=%lld lazy_ns=%llu populate_ns=%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) THETEST_LAZY_MAP_PAGES,
+           (unsigned int) touched,
+           (long long) after_map,
+           (long long) after_touch,
+           (long long) after_populate,
+           (long long) lost,
+           (unsigned long long) lazy_map_ns,
+           (unsigned long long) eager_map_ns);
+}
+
+// Fork with pages mapped and touched, the child checking one byte per page; 0 on failure.
+static uint64_t thetest_fork_cost_ns(uint32_t pages)
+{
+    size_t len = (size_t) pages * 4096U;
+    volatile uint8_t* map_ptr = (volatile uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if ((void*) map_ptr == MAP_FAILED)
+        return 0;
+    for (uint32_t i = 0; i < pages; i++)
+        map_ptr[(size_t) i * 4096U] = (uint8_t) (i * 7U);
+
+    uint64_t start_ns = sys_monotonic_ns();
+    int pid = fork();
+    if (pid == 0)
+    {
+        int rc = 0;
+        for (uint32_t i = 0; i < pages; i++)
+        {
+            if (map_ptr[(size_t) i * 4096U] != (uint8_t) (i * 7U))
+                rc = 1;
+        }
+        _exit(rc);
+    }
+
+    int status = 0;
+    int signal = 0;
+    bool ok = pid > 0 && thetest_wait_child(pid, &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS) == pid &&
+              status == 0 && signal == 0;
+    uint64_t elapsed_ns = sys_monotonic_ns() - start_ns;
+    if (munmap((void*) map_ptr, len) != 0)
+        ok = false;
+    return (ok && elapsed_ns != 0) ? elapsed_ns : 0;
+}
+
+static void thetest_fork_scaling_probe(void)
+{
+    uint64_t small_ns = thetest_fork_cost_ns(THETEST_FORK_SMALL_PAGES);
+    uint64_t large_ns = thetest_fork_cost_ns(THETEST_FORK_LARGE_PAGES);
+    bool ok = small_ns != 0 && large_ns != 0;
+
+    printf("[TheTest] fork scaling: %s small_pages=%u small_ns=%llu large_pages=%u large_ns=%llu ns_per_page=%llu/%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) THETEST_FORK_SMALL_PAGES,
+           (unsigned long long) small_ns,
+           (unsigned int) THETEST_FORK_LARGE_PAGES,
+           (unsigned long long) large_ns,
+           (unsigned long long) (small_ns / THETEST_FORK_SMALL_PAGES),
+           (unsigned long long) (large_ns / THETEST_FORK_LARGE_PAGES));
+}
+
+// Time THETEST_THP_MEMSET_ROUNDS passes of memset over a fresh mapping; 0 on failure.
+static uint64_t thetest_thp_memset_ns(int extra_flags, uint8_t** out_ptr)
+{
+    size_t len = (size_t) THETEST_THP_MAP_PAGES * 4096U;
+    uint8_t* map_ptr = (uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+    if ((void*) map_ptr == MAP_FAILED)
+        return 0;
+
+    uint64_t start_ns = sys_monotonic_ns();
+    for (uint32_t round = 0; round < THETEST_THP_MEMSET_ROUNDS; round++)
+        memset(map_ptr, (int) (round + 1U), len);
+    uint64_t elapsed_ns = sys_monotonic_ns() - start_ns;
+
+    bool ok = true;
+    for (uint32_t i = 0; i < THETEST_THP_MAP_PAGES; i++)
+    {
+        if (map_ptr[(size_t) i * 4096U + (i & 0xFFFU)] != (uint8_t) THETEST_THP_MEMSET_ROUNDS)
+            ok = false;
+    }
+
+    *out_ptr = map_ptr;
+    return (ok && elapsed_ns != 0) ? elapsed_ns : 0;
+}
+
+static void thetest_thp_probe(void)
+{
+    syscall_mem_info_t before;
+    syscall_mem_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    bool ok = sys_mem_info_get(&before) == 0;
+    size_t len = (size_t) THETEST_THP_MAP_PAGES * 4096U;
+
+    // Lazy mappings are 2 MiB aligned and take huge pages; MAP_POPULATE ones stay 4 KiB.
+    uint8_t* huge_ptr = NULL;
+    uint8_t* small_ptr = NULL;
+    uint64_t huge_ns = thetest_thp_memset_ns(0, &huge_ptr);
+    uint64_t small_ns = thetest_thp_memset_ns(MAP_POPULATE, &small_ptr);
+    if (huge_ns == 0 || small_ns == 0)
+        ok = false;
+    if (ok && sys_mem_info_get(&after) != 0)
+        ok = false;
+    uint64_t faults = after.thp_faults - before.thp_faults;
+    uint64_t fallbacks = after.thp_fallbacks - before.thp_fallbacks;
+    if (ok && faults + fallbacks == 0)
+        ok = false;
+
+    // Unmapping one page from the middle of a huge page splits it; the rest stays readable.
+    if (huge_ptr && (void*) huge_ptr != MAP_FAILED)
+    {
+        size_t hole = (size_t) (THETEST_THP_MAP_PAGES / 2U + 7U) * 4096U;
+        if (munmap(huge_ptr + hole, 4096U) != 0)
+            ok = false;
+        if (huge_ptr[hole - 4096U] != (uint8_t) THETEST_THP_MEMSET_ROUNDS ||
+            huge_ptr[hole + 4096U] != (uint8_t) THETEST_THP_MEMSET_ROUNDS)
+            ok = false;
+        if (munmap(huge_ptr, hole) != 0 || munmap(huge_ptr + hole + 4096U, len - hole - 4096U) != 0)
+            ok = false;
+    }
+    if (small_ptr && (void*) small_ptr != MAP_FAILED && munmap(small_ptr, len) != 0)
+        ok = false;
+
+    // A 4 KiB populated range gets folded into huge pages by the pass that runs on sleep.
+    size_t collapse_len = (size_t) THETEST_THP_COLLAPSE_PAGES * 4096U;
+    uint8_t* collapse_ptr = (uint8_t*) mmap(NULL, collapse_len, PROT_READ | PROT_WRITE,
+                                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    syscall_mem_info_t collapse_before;
+    memset(&collapse_before, 0, sizeof(collapse_before));
+    if ((void*) collapse_ptr == MAP_FAILED || sys_mem_info_get(&collapse_before) != 0)
+        ok = false;
+    else
+    {
+        for (uint32_t i = 0; i < THETEST_THP_COLLAPSE_PAGES; i++)
+            collapse_ptr[(size_t) i * 4096U] = (uint8_t) (i * 13U);
+        for (uint32_t i = 0; i < THETEST_THP_COLLAPSE_SLEEPS; i++)
+            (void) sys_sleep_ms(1U);
+        for (uint32_t i = 0; i < THETEST_THP_COLLAPSE_PAGES; i++)
+        {
+            if (collapse_ptr[(size_t) i * 4096U] != (uint8_t) (i * 13U))
+                ok = false;
+        }
+    }
+
+    memset(&after, 0, sizeof(after));
+    if (sys_mem_info_get(&after) != 0)
+        ok = false;
+    uint64_t splits = after.thp_splits - before.thp_splits;
+    uint64_t collapses = after.thp_collapses - collapse_before.thp_collapses;
+    if (ok && faults != 0 && splits == 0)
+        ok = false;
+    if ((void*) collapse_ptr != MAP_FAILED && munmap(collapse_ptr, collapse_len) != 0)
+        ok = false;
+
+    printf("[TheTest] thp: %s pages=%u huge_faults=%llu fallbacks=%llu splits=%llu collapses=%llu memset_ns=%llu/%llu (2M/4K)\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) THETEST_THP_MAP_PAGES,
+           (unsigned long long) faults,
+           (unsigned long long) fallbacks,
+           (unsigned long long) splits,
+           (unsigned long long) collapses,
+           (unsigned long long) huge_ns,
+           (unsigned long long) small_ns);
+}
+
+// First touch of every page of a fresh lazy mapping, in ns per page; 0 on failure.
+static uint64_t thetest_zero_touch_ns(void)
+{
+    size_t len = (size_t) THETEST_ZERO_TOUCH_PAGES * 4096U;
+    volatile uint8_t* map_ptr = (volatile uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((void*) map_ptr == MAP_FAILED)
+        return 0;
+
+    bool ok = true;
+    uint64_t start_ns = sys_monotonic_ns();
+    for (uint32_t i = 0; i < THETEST_ZERO_TOUCH_PAGES; i++)
+        map_ptr[(size_t) i * 4096U] = 1U;
+    uint64_t elapsed_ns = sys_monotonic_ns() - start_ns;
+
+    for (uint32_t i = 0; i < THETEST_ZERO_TOUCH_PAGES; i++)
+    {
+        if (map_ptr[(size_t) i * 4096U + 4095U] != 0)
+            ok = false;
+    }
+    if (munmap((void*) map_ptr, len) != 0)
+        ok = false;
+    return ok ? (elapsed_ns / THETEST_ZERO_TOUCH_PAGES) + 1U : 0;
+}
+
+static void thetest_zero_pool_probe(void)
+{
+    syscall_mem_info_t before;
+    syscall_mem_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+
+    // Give the idle CPUs time to fill the pools, then fault against a full one.
+    (void) sys_sleep_ms(THETEST_ZERO_REFILL_MS);
+    bool ok = sys_mem_info_get(&before) == 0;
+    uint64_t pooled_ns = thetest_zero_touch_ns();
+    if (pooled_ns == 0)
+        ok = false;
+    if (ok && sys_mem_info_get(&after) != 0)
+        ok = false;
+    uint64_t pooled_hits = after.zero_hits - before.zero_hits;
+
+    // Back to back the pool runs dry and the last mapping zeroes its pages on the spot.
+    uint64_t drained_ns = 0;
+    for (uint32_t round = 0; ok && round < THETEST_ZERO_DRAIN_MAPS; round++)
+    {
+        drained_ns = thetest_zero_touch_ns();
+        if (drained_ns == 0)
+            ok = false;
+    }
+
+    memset(&after, 0, sizeof(after));
+    if (sys_mem_info_get(&after) != 0)
+        ok = false;
+    uint64_t hits = after.zero_hits - before.zero_hits;
+    uint64_t misses = after.zero_misses - before.zero_misses;
+    if (ok && hits + misses < (uint64_t) THETEST_ZERO_TOUCH_PAGES * (THETEST_ZERO_DRAIN_MAPS + 1U))
+        ok = false;
+
+    printf("[TheTest] zero pool: %s pages=%u pooled_ns/page=%llu drained_ns/page=%llu pooled_hits=%llu hits=%llu misses=%llu pool=%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) THETEST_ZERO_TOUCH_PAGES,
+           (unsigned long long) pooled_ns,
+           (unsigned long long) drained_ns,
+           (unsigned long long) pooled_hits,
+           (unsigned long long) hits,
+           (unsigned long long) misses,
+           (unsigned long long) after.zero_pool_pages);
+}
+
+static uint8_t thetest_usercopy_buf[THETEST_USERCOPY_CHUNK] __attribute__((aligned(64)));
+
+// Every worker pushes 4 KiB through its own pipe and reads it back; return KiB per ms across all workers.
+static uint64_t thetest_usercopy_round(uint32_t workers, uint64_t cycles_per_ms)
+{
+    int fds[2];
+    int pids[THETEST_USERCOPY_MAX_PROCS];
+    uint32_t spawned = 0;
+    if (pipe(fds) != 0)
+        return 0;
+
+    uint64_t start = thetest_rdtsc() + cycles_per_ms * THETEST_SYSCALL_SCALING_SETTLE_MS;
+    for (uint32_t i = 0; i < workers; i++)
+    {
+        int pid = fork();
+        if (pid < 0)
+            break;
+
+        if (pid == 0)
+        {
+            (void) close(fds[0]);
+            int loop[2];
+            if (pipe(loop) != 0)
+                _exit(1);
+
+            memset(thetest_usercopy_buf, (int) i, sizeof(thetest_usercopy_buf));
+            while (thetest_rdtsc() < start)
+                __asm__ __volatile__("pause");
+
+            for (uint32_t iter = 0; iter < THETEST_USERCOPY_ITERS; iter++)
+            {
+                if (write(loop[1], thetest_usercopy_buf, THETEST_USERCOPY_CHUNK) != (int) THETEST_USERCOPY_CHUNK ||
+                    read(loop[0], thetest_usercopy_buf, THETEST_USERCOPY_CHUNK) != (int) THETEST_USERCOPY_CHUNK)
+                    _exit(1);
+            }
+
+            uint64_t end = thetest_rdtsc();
+            (void) write(fds[1], &end, sizeof(end));
+            _exit(thetest_usercopy_buf[0] == (uint8_t) i ? 0 : 1);
+        }
+
+        pids[spawned++] = pid;
     }
+    (void) close(fds[1]);
 
-    int stop_pid = thetest_signal_spawn_child(35U, 9);
-    if (stop_pid < 0)
+    bool ok = (spawned == workers);
+    uint64_t last_end = 0;
+    for (uint32_t i = 0; i < spawned; i++)
     {
-        thetest_signal_report_check("SIGSTOP semantics probe", false, &passed, &failed);
+        uint64_t end = 0;
+        if (read(fds[0], &end, sizeof(end)) != (int) sizeof(end))
+            ok = false;
+        else if (end > last_end)
+            last_end = end;
     }
-    else
+    for (uint32_t i = 0; i < spawned; i++)
     {
-        int stop_kill_rc = kill(stop_pid, SIGSTOP);
         int status = 0;
         int signal = 0;
-        int wait_rc = thetest_wait_child(stop_pid, &status, &signal, 700U);
-        bool stop_ok = false;
+        if (thetest_wait_child(pids[i], &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS) != pids[i] ||
+            status != 0 || signal != 0)
+            ok = false;
+    }
+    (void) close(fds[0]);
 
-        if (wait_rc == stop_pid && status == 9 && signal == 0)
-        {
-            stop_ok = (stop_kill_rc == 0);
-            if (stop_ok)
-                printf("[TheTest][signal] SIGSTOP behaved as non-blocking/no-op (not implemented yet)\n");
-        }
-        else if (wait_rc == -2)
-        {
-            int cont_rc = kill(stop_pid, SIGCONT);
-            int resume_wait_rc = thetest_wait_child(stop_pid, &status, &signal, 1500U);
-            stop_ok = (stop_kill_rc == 0 &&
-                       cont_rc == 0 &&
-                       resume_wait_rc == stop_pid &&
-                       status == 9 &&
-                       signal == 0);
-            if (stop_ok)
-                printf("[TheTest][signal] SIGSTOP/SIGCONT behaved as true stop/continue\n");
-        }
+    if (!ok || last_end <= start)
+        return 0;
 
-        if (!stop_ok)
+    // Each iteration copies the chunk twice: in on write, out on read.
+    uint64_t kib = ((uint64_t) workers * THETEST_USERCOPY_ITERS * THETEST_USERCOPY_CHUNK * 2ULL) / 1024ULL;
+    return (kib * cycles_per_ms) / (last_end - start);
+}
+
+static void thetest_usercopy_probe(void)
+{
+    syscall_cpu_info_t cpu_info;
+    syscall_mem_info_t before;
+    syscall_mem_info_t after;
+    memset(&cpu_info, 0, sizeof(cpu_info));
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    uint64_t cycles_per_ms = thetest_tsc_cycles_per_ms();
+    if (cycles_per_ms == 0 || sys_cpu_info_get(&cpu_info) != 0 || sys_mem_info_get(&before) != 0)
+    {
+        printf("[TheTest] usercopy: setup failed\n");
+        return;
+    }
+
+    uint32_t max_workers = cpu_info.online_cpus ? cpu_info.online_cpus : 1U;
+    if (max_workers > THETEST_USERCOPY_MAX_PROCS)
+        max_workers = THETEST_USERCOPY_MAX_PROCS;
+
+    uint64_t single = 0;
+    uint64_t rate = 0;
+    uint32_t workers = 1;
+    for (;;)
+    {
+        rate = thetest_usercopy_round(workers, cycles_per_ms);
+        if (workers == 1U)
+            single = rate;
+        printf("[TheTest] usercopy: procs=%u rate=%llu KiB/ms\n",
+               (unsigned int) workers,
+               (unsigned long long) rate);
+        if (rate == 0 || workers >= max_workers)
+            break;
+        workers = (workers * 2U > max_workers) ? max_workers : workers * 2U;
+    }
+
+    // Only the first touch of each child's COW buffer should leave the direct copy.
+    bool ok = sys_mem_info_get(&after) == 0;
+    uint64_t slow = after.usercopy_slow - before.usercopy_slow;
+    uint64_t speedup_x100 = single ? (rate * 100ULL) / single : 0ULL;
+    if (rate == 0 || speedup_x100 * 2ULL < (uint64_t) workers * 100ULL)
+        ok = false;
+    printf("[TheTest] usercopy: %s procs=%u speedup=%llu.%02llu slow=%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) workers,
+           (unsigned long long) (speedup_x100 / 100ULL),
+           (unsigned long long) (speedup_x100 % 100ULL),
+           (unsigned long long) slow);
+}
+
+// The caller's own row of SYS_PROC_INFO_GET, asked for in full so no slot order can hide it.
+static bool thetest_mm_self(syscall_proc_info_t* entries, syscall_proc_info_t* out)
+{
+    uint32_t total = 0;
+    int count = sys_proc_info_get(entries, THETEST_MM_PROC_ENTRIES, &total);
+    uint32_t self = (uint32_t) getpid();
+    for (int i = 0; i < count; i++)
+    {
+        if (entries[i].pid == self)
         {
-            printf("[TheTest][signal] detail SIGSTOP: kill_rc=%d wait_rc=%d status=%d signal=%d\n",
-                   stop_kill_rc,
-                   wait_rc,
-                   status,
-                   signal);
+            *out = entries[i];
+            return true;
         }
-        thetest_signal_report_check("SIGSTOP semantics probe", stop_ok, &passed, &failed);
-        if (wait_rc == -2 && !stop_ok)
-            (void) kill(stop_pid, SIGKILL);
     }
 
-    if (failed == 0U)
+    return false;
+}
+
+// Runs in a child so the limits it sets die with it; the exit code carries one bit per failed check.
+static int thetest_mm_accounting_child(void)
+{
+    syscall_proc_info_t* entries = (syscall_proc_info_t*) malloc(THETEST_MM_PROC_ENTRIES * sizeof(*entries));
+    syscall_proc_info_t base;
+    syscall_proc_info_t touched;
+    syscall_proc_info_t unmapped;
+    if (!entries || !thetest_mm_self(entries, &base))
+        return 1;
+
+    int failed = 0;
+    size_t len = (size_t) THETEST_MM_TOUCH_PAGES * 4096U;
+    volatile uint8_t* map_ptr = (volatile uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((void*) map_ptr == MAP_FAILED)
+        return 1;
+    for (uint32_t i = 0; i < THETEST_MM_TOUCH_PAGES; i++)
+        map_ptr[(size_t) i * 4096U] = 1;
+    if (!thetest_mm_self(entries, &touched) ||
+        touched.anon_pages < base.anon_pages + THETEST_MM_TOUCH_PAGES ||
+        touched.rss_pages != touched.anon_pages + touched.file_pages + touched.shared_pages ||
+        touched.vm_pages < base.vm_pages + THETEST_MM_TOUCH_PAGES || touched.pt_pages == 0)
+        failed |= 1 << 1;
+    if (munmap((void*) map_ptr, len) != 0 || !thetest_mm_self(entries, &unmapped) ||
+        unmapped.anon_pages + THETEST_MM_TOUCH_PAGES > touched.anon_pages ||
+        unmapped.vm_pages + THETEST_MM_TOUCH_PAGES > touched.vm_pages)
+        failed |= 1 << 2;
+
+    // RLIMIT_AS: room for a small mapping, not for the large one.
+    struct rlimit limit = { (rlim_t) (unmapped.vm_pages + THETEST_MM_SLACK_PAGES) * 4096U, RLIM_INFINITY };
+    if (setrlimit(RLIMIT_AS, &limit) != 0)
+        failed |= 1 << 3;
+    void* refused = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* allowed = mmap(NULL, 4096U, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (refused != MAP_FAILED || allowed == MAP_FAILED)
+        failed |= 1 << 4;
+    if (refused != MAP_FAILED)
+        (void) munmap(refused, len);
+    if (allowed != MAP_FAILED)
+        (void) munmap(allowed, 4096U);
+    limit.rlim_cur = RLIM_INFINITY;
+    if (setrlimit(RLIMIT_AS, &limit) != 0)
+        failed |= 1 << 3;
+
+    // RLIMIT_RSS: an eager mapping past it fails as a whole, and the hard limit cannot go back up.
+    limit.rlim_cur = (rlim_t) (unmapped.rss_pages + THETEST_MM_SLACK_PAGES) * 4096U;
+    limit.rlim_max = limit.rlim_cur;
+    if (setrlimit(RLIMIT_RSS, &limit) != 0)
+        failed |= 1 << 5;
+    refused = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (refused != MAP_FAILED)
+    {
+        failed |= 1 << 6;
+        (void) munmap(refused, len);
+    }
+    syscall_proc_info_t after;
+    if (!thetest_mm_self(entries, &after) || after.anon_pages > unmapped.anon_pages + THETEST_MM_SLACK_PAGES)
+        failed |= 1 << 6;
+    limit.rlim_max = RLIM_INFINITY;
+    if (setrlimit(RLIMIT_RSS, &limit) == 0 || errno != EPERM)
+        failed |= 1 << 7;
+
+    return failed;
+}
+
+static void thetest_mm_accounting_probe(void)
+{
+    syscall_mem_info_t before;
+    syscall_mem_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    bool ok = sys_mem_info_get(&before) == 0;
+
+    int pid = fork();
+    if (pid == 0)
+        _exit(thetest_mm_accounting_child());
+
+    int status = -1;
+    int signal = 0;
+    if (pid < 0 || thetest_wait_child(pid, &status, &signal, THETEST_BLOCK_BENCH_TIMEOUT_MS) != pid ||
+        status != 0 || signal != 0)
+        ok = false;
+    if (sys_mem_info_get(&after) != 0)
+        ok = false;
+
+    uint64_t hits = after.rlimit_hits - before.rlimit_hits;
+    if (hits < 2U)
+        ok = false;
+    printf("[TheTest] mm accounting: %s status=0x%x signal=%d limit_hits=%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) status,
+           signal,
+           (unsigned long long) hits);
+}
+
+static void thetest_kmem_info_probe(void)
+{
+    syscall_kmem_info_t* before = (syscall_kmem_info_t*) malloc(sizeof(*before));
+    syscall_kmem_info_t* after = (syscall_kmem_info_t*) malloc(sizeof(*after));
+    syscall_stats_info_t* scratch = (syscall_stats_info_t*) malloc(sizeof(*scratch));
+    if (!before || !after || !scratch)
+    {
+        printf("[TheTest] kmem info: allocation failed\n");
+        free(before);
+        free(after);
+        free(scratch);
+        return;
+    }
+
+    bool ok = sys_kmem_info_get(before, 0) == 0;
+    for (uint32_t i = 0; i < THETEST_KMEM_ROUNDS; i++)
     {
-        printf("[TheTest] signal probe: OK (checks=%u)\n", (unsigned int) passed);
+        if (sys_syscall_stats_get(scratch) != 0)
+            ok = false;
     }
-    else
+    if (sys_kmem_info_get(after, 0) != 0)
+        ok = false;
+    if (sys_kmem_info_get(after, ~0U) == 0)     // Unknown flags are refused.
+        ok = false;
+
+    uint64_t allocs = after->allocs - before->allocs;
+    uint64_t frees = after->frees - before->frees;
+    if (allocs < THETEST_KMEM_ROUNDS || frees < THETEST_KMEM_ROUNDS)
+        ok = false;
+    if (after->bytes_peak < after->bytes_in_use || after->bytes_peak < before->bytes_peak)
+        ok = false;
+    if (after->heap_used + after->heap_free > after->heap_size ||
+        after->heap_largest_free > after->heap_free ||
+        (after->heap_free != 0 && after->heap_free_blocks == 0))
+        ok = false;
+    if (after->site_returned > SYS_KMEM_SITE_MAX || (!after->tracking && after->site_returned != 0))
+        ok = false;
+
+    printf("[TheTest] kmem info: %s in_use=%llu peak=%llu heap=%llu free=%llu/%llu largest=%llu tracking=%u sites=%u\n",
+           ok ? "OK" : "FAILED",
+           (unsigned long long) after->bytes_in_use,
+           (unsigned long long) after->bytes_peak,
+           (unsigned long long) after->heap_size,
+           (unsigned long long) after->heap_free,
+           (unsigned long long) after->heap_free_blocks,
+           (unsigned long long) after->heap_largest_free,
+           after->tracking,
+           after->site_count);
+
+    free(before);
+    free(after);
+    free(scratch);
+}
+
+// Odd pages are one repeated byte, even ones compress: both kinds of swapped page come back.
+static void thetest_swap_fill_page(uint64_t* words, uint64_t index)
+{
+    if ((index & 1U) != 0)
     {
-        printf("[TheTest] signal probe: FAILED (ok=%u failed=%u)\n",
-               (unsigned int) passed,
-               (unsigned int) failed);
+        memset(words, (int) (index & 0xFFU), 4096U);
+        return;
     }
+
+    for (uint32_t i = 0; i < 512U; i++)
+        words[i] = ((i & 7U) == 0) ? index : 0x5A5A5A5A00000000ULL | i;
 }
 
-typedef struct thetest_pthread_arg
+static bool thetest_swap_check_page(const uint64_t* words, uint64_t index)
 {
-    int id;
-    pthread_mutex_t* lock;
-    volatile int* shared_counter;
-} thetest_pthread_arg_t;
+    uint64_t expected[512];
+    thetest_swap_fill_page(expected, index);
+    return memcmp(words, expected, sizeof(expected)) == 0;
+}
 
-static void* thetest_pthread_worker(void* arg)
+static int thetest_swap_child(uint64_t pages)
 {
-    thetest_pthread_arg_t* cfg = (thetest_pthread_arg_t*) arg;
-    volatile uint64_t acc = 0;
-    for (uint32_t i = 0; i < 250000U; i++)
-        acc = (acc * 1664525ULL) + (uint64_t) i + (uint64_t) cfg->id;
-    (void) acc;
+    size_t len = (size_t) pages * 4096U;
+    uint8_t* map_ptr = (uint8_t*) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((void*) map_ptr == MAP_FAILED)
+        return 1;
 
-    (void) pthread_mutex_lock(cfg->lock);
-    *cfg->shared_counter += 1;
-    (void) pthread_mutex_unlock(cfg->lock);
+    for (uint64_t i = 0; i < pages; i++)
+        thetest_swap_fill_page((uint64_t*) (map_ptr + (size_t) i * 4096U), i);
 
-    return (void*) (uintptr_t) (cfg->id + 1);
+    // Second pass in the same order: the oldest pages are the ones that went out first.
+    for (uint64_t i = 0; i < pages; i++)
+    {
+        if (!thetest_swap_check_page((const uint64_t*) (map_ptr + (size_t) i * 4096U), i))
+            return 2;
+    }
+
+    return munmap(map_ptr, len) == 0 ? 0 : 3;
 }
 
-static void thetest_pthread_probe(void)
+static void thetest_swap_probe(void)
 {
-    const int worker_count = 4;
-    pthread_t threads[4];
-    thetest_pthread_arg_t args[4];
-    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-    volatile int shared_counter = 0;
-    int created = 0;
+    syscall_mem_info_t before;
+    syscall_mem_info_t after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    if (sys_mem_info_get(&before) != 0)
+    {
+        printf("[TheTest] swap: FAILED mem info\n");
+        return;
+    }
 
-    for (int i = 0; i < worker_count; i++)
+    uint64_t pages = before.free_pages + (before.total_pages >> THETEST_SWAP_OVERCOMMIT_SHIFT);
+    if (pages > USER_MMAP_WINDOW_LEN / 4096U)
     {
-        args[i].id = i;
-        args[i].lock = &lock;
-        args[i].shared_counter = &shared_counter;
-        int rc = pthread_create(&threads[i], NULL, thetest_pthread_worker, &args[i]);
-        if (rc != 0)
-        {
-            printf("[TheTest] pthread_create failed idx=%d rc=%d\n", i, rc);
-            break;
-        }
-        created++;
+        printf("[TheTest] swap: skipped, %llu pages do not fit the mmap window\n", (unsigned long long) pages);
+        return;
     }
 
-    int sum = 0;
-    bool ok = (created == worker_count);
-    for (int i = 0; i < created; i++)
+    int pid = fork();
+    if (pid == 0)
+        _exit(thetest_swap_child(pages));
+
+    bool ok = true;
+    int status = -1;
+    int signal = 0;
+    if (pid < 0 || thetest_wait_child(pid, &status, &signal, THETEST_SWAP_TIMEOUT_MS) != pid ||
+        status != 0 || signal != 0)
+        ok = false;
+    if (sys_mem_info_get(&after) != 0)
+        ok = false;
+
+    uint64_t outs = after.swap_outs - before.swap_outs;
+    uint64_t ins = after.swap_ins - before.swap_ins;
+    if (outs == 0 || ins == 0 || after.swap_pool_bytes > after.swap_pool_limit)
+        ok = false;
+    printf("[TheTest] swap: %s status=0x%x signal=%d pages=%llu outs=%llu ins=%llu direct=%llu rejects=%llu reclaim=%llu/%llu\n",
+           ok ? "OK" : "FAILED",
+           (unsigned int) status,
+           signal,
+           (unsigned long long) pages,
+           (unsigned long long) outs,
+           (unsigned long long) ins,
+           (unsigned long long) (after.swap_direct - before.swap_direct),
+           (unsigned long long) (after.swap_rejects - before.swap_rejects),
+           (unsigned long long) (after.reclaim_runs - before.reclaim_runs),
+           (unsigned long long) (after.reclaim_pages - before.reclaim_pages));
+}
+
+typedef struct thetest_ipc_msg
+{
+    int32_t mtype;
+    uint32_t value;
+} thetest_ipc_msg_t;
+
+// Each queue is removed once used and each pipe closed: the live counts must end where they began.
+static void thetest_ipc_objects_probe(void)
+{
+    syscall_ipc_info_t before;
+    syscall_ipc_info_t after;
+    memset(&after, 0, sizeof(after));
+    if (sys_ipc_info_get(&before) != 0 || before.pipes_max == 0)
     {
-        void* retval = NULL;
-        int rc = pthread_join(threads[i], &retval);
-        if (rc != 0)
+        printf("[TheTest] ipc objects: setup failed\n");
+        return;
+    }
+
+    bool ok = true;
+    uint32_t queues = 0;
+    for (uint32_t i = 0; i < THETEST_IPC_QUEUES && ok; i++)
+    {
+        int msqid = msgget((key_t) (THETEST_IPC_QUEUE_KEY + (int) i), IPC_CREAT | 0600);
+        thetest_ipc_msg_t out = { .mtype = (int32_t) (i + 1U), .value = 0xC0DE0000U | i };
+        thetest_ipc_msg_t in;
+        memset(&in, 0, sizeof(in));
+        if (msqid < 0 || msgsnd(msqid, &out, sizeof(out.value), IPC_NOWAIT) != 0 ||
+            msgrcv(msqid, &in, sizeof(in.value), out.mtype, IPC_NOWAIT) != (ssize_t) sizeof(in.value) ||
+            in.mtype != out.mtype || in.value != out.value)
+            ok = false;
+        else
+            queues++;
+        if (msqid >= 0 && msgctl(msqid, IPC_RMID, NULL) != 0)
+            ok = false;
+    }
+
+    // Twice as many pipes over time as the table has slots: each close must give its slot back.
+    uint32_t rounds = (before.pipes_max * 2U) + 1U;
+    uint32_t pipes = 0;
+    for (uint32_t i = 0; i < rounds && ok; i++)
+    {
+        int fds[2] = { -1, -1 };
+        uint32_t value = i;
+        uint32_t echo = ~i;
+        if (pipe(fds) != 0)
         {
             ok = false;
-            printf("[TheTest] pthread_join failed idx=%d rc=%d\n", i, rc);
-            continue;
+            break;
         }
+        if (write(fds[1], &value, sizeof(value)) != (ssize_t) sizeof(value) ||
+            read(fds[0], &echo, sizeof(echo)) != (ssize_t) sizeof(echo) || echo != value)
+            ok = false;
+        else
+            pipes++;
+        close(fds[0]);
+        close(fds[1]);
+    }
 
-        sum += (int) (uintptr_t) retval;
+    if (sys_ipc_info_get(&after) != 0 || after.pipes != before.pipes || after.msg_queues != before.msg_queues)
+        ok = false;
+
+    printf("[TheTest] ipc objects: %s queues=%u pipes=%u/%u live_pipes=%u->%u live_queues=%u->%u/%u\n",
+           ok ? "OK" : "FAILED",
+           queues,
+           pipes,
+           rounds,
+           before.pipes,
+           after.pipes,
+           before.msg_queues,
+           after.msg_queues,
+           after.msg_queues_max);
+}
+
+// open() reads the whole file, so this times path resolution, the inode and the data together.
+static uint64_t thetest_bcache_open_ns(void)
+{
+    struct timespec start;
+    struct timespec end;
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
+    int fd = open(THETEST_BCACHE_PATH, O_RDONLY);
+    (void) clock_gettime(CLOCK_MONOTONIC, &end);
+    if (fd < 0)
+        return UINT64_MAX;
+
+    close(fd);
+    return thetest_timespec_ns(&end) - thetest_timespec_ns(&start);
+}
+
+static uint32_t thetest_bcache_list_dir(void)
+{
+    DIR* dir = opendir(THETEST_BCACHE_DIR);
+    if (!dir)
+        return 0;
+
+    uint32_t entries = 0;
+    while (readdir(dir))
+        entries++;
+    closedir(dir);
+    return entries;
+}
+
+/*
+ * Cold: the clean blocks are dropped first, so the open reads every block it needs. Warm:
+ * the same open again and a listing of its directory must not read a single block. Only
+ * reads are counted: the KDEBUG log may be written back meanwhile.
+ */
+static void thetest_bcache_probe(void)
+{
+    syscall_mem_info_t before;
+    syscall_mem_info_t cold;
+    syscall_mem_info_t warm;
+    if (sys_sync(SYS_SYNC_DROP_CACHES) != 0 || sys_mem_info_get(&before) != 0)
+    {
+        printf("[TheTest] block cache: setup failed\n");
+        return;
     }
 
-    int expected = (worker_count * (worker_count + 1)) / 2;
-    if (ok && sum == expected && shared_counter == worker_count)
-        printf("[TheTest] pthread shared-memory test: OK (sum=%d counter=%d)\n", sum, (int) shared_counter);
-    else
-        printf("[TheTest] pthread shared-memory test: FAILED (sum=%d expected=%d counter=%d created=%d)\n",
-               sum,
-               expected,
-               (int) shared_counter,
-               created);
+    uint64_t cold_ns = thetest_bcache_open_ns();
+    uint32_t entries = thetest_bcache_list_dir();
+    if (cold_ns == UINT64_MAX || entries == 0 || sys_mem_info_get(&cold) != 0)
+    {
+        printf("[TheTest] block cache: FAILED cannot open %s\n", THETEST_BCACHE_PATH);
+        return;
+    }
 
-    (void) pthread_mutex_destroy(&lock);
+    uint64_t warm_ns = 0;
+    bool listed = true;
+    for (uint32_t i = 0; i < THETEST_BCACHE_WARM_ROUNDS; i++)
+    {
+        warm_ns += thetest_bcache_open_ns();
+        listed = listed && thetest_bcache_list_dir() == entries;
+    }
+    warm_ns /= THETEST_BCACHE_WARM_ROUNDS;
+    (void) sys_mem_info_get(&warm);
+
+    uint64_t cold_reads = cold.bcache_reads - before.bcache_reads;
+    uint64_t warm_reads = warm.bcache_reads - cold.bcache_reads;
+    bool ok = listed && cold_reads != 0 && warm_reads == 0 && warm_ns < cold_ns;
+    printf("[TheTest] block cache: %s cold_open=%lluus warm_open=%lluus (x%u) cold_reads=%llu warm_reads=%llu "
+           "hits=%llu blocks=%llu limit=%lluKiB\n",
+           ok ? "OK" : "FAILED",
+           (unsigned long long) (cold_ns / 1000ULL),
+           (unsigned long long) (warm_ns / 1000ULL),
+           THETEST_BCACHE_WARM_ROUNDS,
+           (unsigned long long) cold_reads,
+           (unsigned long long) warm_reads,
+           (unsigned long long) (warm.bcache_hits - cold.bcache_hits),
+           (unsigned long long) warm.bcache_blocks,
+           (unsigned long long) (warm.bcache_limit / 1024ULL));
 }
 
 typedef struct thetest_tls_dynamic_arg
@@ -2922,6 +4798,86 @@ int thetest_run_cli(int argc, char** argv, char** envp)
     thetest_pthread_probe();
 #endif
 
+#ifdef TEST_BLOCKING_BENCH
+    thetest_blocking_bench_probe();
+#endif
+
+#ifdef TEST_SCHED_PICK_BENCH
+    thetest_pick_bench_probe();
+#endif
+
+#ifdef TEST_SCHED_CLASS
+    thetest_sched_class_probe();
+#endif
+
+#ifdef TEST_RUSAGE
+    thetest_rusage_probe();
+#endif
+
+#ifdef TEST_SYSCALL_SCALING
+    thetest_syscall_scaling_probe();
+#endif
+
+#ifdef TEST_NULL_SYSCALL_BENCH
+    thetest_null_syscall_probe();
+#endif
+
+#ifdef TEST_VDSO_CLOCK
+    thetest_vdso_clock_probe();
+#endif
+
+#ifdef TEST_PCID_PINGPONG
+    thetest_pcid_pingpong_probe();
+#endif
+
+#ifdef TEST_PMM_FLAT
+    thetest_pmm_flat_probe();
+#endif
+
+#ifdef TEST_NUMA_NODES
+    thetest_numa_nodes_probe();
+#endif
+
+#ifdef TEST_LAZY_MAP
+    thetest_lazy_map_probe();
+#endif
+
+#ifdef TEST_FORK_SCALING
+    thetest_fork_scaling_probe();
+#endif
+
+#ifdef TEST_THP
+    thetest_thp_probe();
+#endif
+
+#ifdef TEST_ZERO_POOL
+    thetest_zero_pool_probe();
+#endif
+
+#ifdef TEST_USERCOPY
+    thetest_usercopy_probe();
+#endif
+
+#ifdef TEST_MM_ACCOUNTING
+    thetest_mm_accounting_probe();
+#endif
+
+#ifdef TEST_KMEM_INFO
+    thetest_kmem_info_probe();
+#endif
+
+#ifdef TEST_SWAP
+    thetest_swap_probe();
+#endif
+
+#ifdef TEST_IPC_OBJECTS
+    thetest_ipc_objects_probe();
+#endif
+
+#ifdef TEST_BCACHE
+    thetest_bcache_probe();
+#endif
+
 #ifdef TEST_TLS_DYNAMIC
     thetest_tls_dynamic_probe();
 #endif
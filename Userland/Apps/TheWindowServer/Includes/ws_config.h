@@ -15,6 +15,8 @@
 #define WS_RENDER_TILE_W 128U
 #define WS_RENDER_TILE_H 128U
 #define WS_RENDER_TIME_BUDGET_TICKS 2ULL
+#define WS_RENDER_RT_PRIORITY 10
+#define WS_RENDER_RT_IDLE_US 1000U
 #define WS_SERVER_BACKLOG       16
 #define WS_CLIENT_MAX           16U
 #define WS_CLIENT_EVENT_QUEUE   32U
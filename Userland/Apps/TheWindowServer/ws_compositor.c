@@ -203,6 +203,10 @@ void* ws_render_thread_main(void* arg)
     if (!desktop)
         return NULL;
 
+    // Composition runs ahead of client traffic; falls back to the fair class if RT is refused.
+    struct sched_param rt_param = { .sched_priority = WS_RENDER_RT_PRIORITY };
+    bool realtime = sched_setscheduler(0, SCHED_FIFO, &rt_param) == 0;
+
     for (;;)
     {
         (void) pthread_mutex_lock(&desktop->render_mutex);
@@ -218,7 +222,11 @@ void* ws_render_thread_main(void* arg)
 
         if (!do_full && !has_tiles)
         {
-            (void) sched_yield();
+            // An idle RT thread must sleep: yielding would keep the CPU away from fair threads.
+            if (realtime)
+                (void) usleep(WS_RENDER_RT_IDLE_US);
+            else
+                (void) sched_yield();
             continue;
         }
 
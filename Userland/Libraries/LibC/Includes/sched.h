@@ -1,6 +1,45 @@
 #ifndef _SCHED_H
 #define _SCHED_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SCHED_OTHER 0
+#define SCHED_FIFO  1
+#define SCHED_RR    2
+
+#define CPU_SETSIZE 256
+
+struct sched_param
+{
+    int sched_priority;
+};
+
+typedef struct
+{
+    uint64_t __bits[CPU_SETSIZE / 64];
+} cpu_set_t;
+
+#define CPU_ZERO(set)                                                     \
+    do                                                                    \
+    {                                                                     \
+        for (size_t __i = 0; __i < (CPU_SETSIZE / 64); __i++)             \
+            (set)->__bits[__i] = 0;                                       \
+    } while (0)
+
+#define CPU_SET(cpu, set)   ((set)->__bits[(size_t) (cpu) / 64U] |= (1ULL << ((size_t) (cpu) % 64U)))
+#define CPU_CLR(cpu, set)   ((set)->__bits[(size_t) (cpu) / 64U] &= ~(1ULL << ((size_t) (cpu) % 64U)))
+#define CPU_ISSET(cpu, set) (((set)->__bits[(size_t) (cpu) / 64U] & (1ULL << ((size_t) (cpu) % 64U))) != 0)
+
 int sched_yield(void);
+int sched_get_priority_min(int policy);
+int sched_get_priority_max(int policy);
+int sched_setscheduler(pid_t pid, int policy, const struct sched_param* param);
+int sched_getscheduler(pid_t pid);
+int sched_setparam(pid_t pid, const struct sched_param* param);
+int sched_getparam(pid_t pid, struct sched_param* param);
+int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t* mask);
+int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t* mask);
 
 #endif
@@ -21,6 +21,16 @@ extern "C" {
 #define IPC_NOWAIT 04000
 #endif
 
+#ifndef IPC_RMID
+#define IPC_RMID 0
+#endif
+#ifndef IPC_SET
+#define IPC_SET 1
+#endif
+#ifndef IPC_STAT
+#define IPC_STAT 2
+#endif
+
 key_t ftok(const char* path, int proj_id);
 
 #ifdef __cplusplus
@@ -12,6 +12,7 @@
 #define MAP_SHARED    0x01
 #define MAP_PRIVATE   0x02
 #define MAP_ANONYMOUS 0x20
+#define MAP_POPULATE  0x8000
 
 #define MAP_FAILED ((void*) -1)
 
@@ -14,9 +14,15 @@ struct msgbuf
     char mtext[1];
 };
 
+struct msqid_ds
+{
+    int __unused;
+};
+
 int msgget(key_t key, int msgflg);
 int msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg);
 ssize_t msgrcv(int msqid, void* msgp, size_t msgsz, long msgtyp, int msgflg);
+int msgctl(int msqid, int cmd, struct msqid_ds* buf);
 
 #ifdef __cplusplus
 }
@@ -21,16 +21,6 @@ extern "C" {
 #define SHM_EXEC   0100000
 #endif
 
-#ifndef IPC_RMID
-#define IPC_RMID 0
-#endif
-#ifndef IPC_SET
-#define IPC_SET 1
-#endif
-#ifndef IPC_STAT
-#define IPC_STAT 2
-#endif
-
 struct shmid_ds
 {
     int __unused;
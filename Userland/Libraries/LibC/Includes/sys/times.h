@@ -0,0 +1,25 @@
+#ifndef _SYS_TIMES_H
+#define _SYS_TIMES_H
+
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fields and the return value count kernel timer ticks (tick_hz of SYS_CPU_INFO_GET).
+struct tms
+{
+    clock_t tms_utime;
+    clock_t tms_stime;
+    clock_t tms_cutime;
+    clock_t tms_cstime;
+};
+
+clock_t times(struct tms* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
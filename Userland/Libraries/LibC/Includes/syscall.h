@@ -31,6 +31,8 @@ int fs_mkdir(const char* path);
 int fs_readdir(const char* path, uint64_t index, syscall_dirent_t* out_entry);
 int sys_sleep_ms(uint32_t ms);
 uint64_t sys_tick_get(void);
+uint64_t sys_monotonic_ns(void);
+uint64_t sys_realtime_ns(void);
 uint64_t sys_rtc_time_get(void);
 int sys_cpu_info_get(syscall_cpu_info_t* out_info);
 int sys_sched_info_get(syscall_sched_info_t* out_info);
@@ -50,6 +52,11 @@ __attribute__((__noreturn__)) void sys_exit(int status);
 int sys_fork(void);
 int sys_execve(const char* path, const char* const argv[], const char* const envp[]);
 int sys_yield(void);
+int sys_getpid(void);
+int sys_getppid(void);
+int sys_syscall_stats_get(syscall_stats_info_t* out_info);
+int sys_tlb_info_get(syscall_tlb_info_t* out_info);
+int sys_mem_info_get(syscall_mem_info_t* out_info);
 void* sys_map_ex(void* addr, size_t len, uint64_t prot, uint64_t flags, int fd, uint64_t offset);
 void* sys_map(void* addr, size_t len, uint64_t prot);
 int sys_unmap(void* addr, size_t len);
@@ -96,6 +103,19 @@ int sys_shmctl(int shmid, int cmd);
 int sys_msgget(int key, int msgflg);
 int sys_msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg);
 long sys_msgrcv(int msqid, void* msgp, size_t msgsz, long msgtyp, int msgflg);
+int sys_msgctl(int msqid, int cmd);
+int sys_setpriority(uint32_t which, int who, int nice_value);
+int sys_getpriority(uint32_t which, int who);
+int sys_sched_setscheduler(int pid, uint32_t policy, uint32_t rt_priority);
+int sys_sched_getscheduler(int pid, int* out_rt_priority);
+int sys_sched_setaffinity(int pid, size_t len, const uint64_t* mask);
+int sys_sched_getaffinity(int pid, size_t len, uint64_t* mask);
+int sys_getrusage(uint32_t who, syscall_rusage_t* out_usage);
+int sys_getrlimit(uint32_t resource, syscall_rlimit_t* out_limit);
+int sys_setrlimit(uint32_t resource, const syscall_rlimit_t* limit);
+int sys_kmem_info_get(syscall_kmem_info_t* out_info, uint32_t flags);
+int sys_sync(uint32_t flags);
+int sys_ipc_info_get(syscall_ipc_info_t* out_info);
 #endif
 
 #endif
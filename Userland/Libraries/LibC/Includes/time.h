@@ -35,12 +35,19 @@ struct timespec
 
 #define TIME_UTC 1
 
+typedef int clockid_t;
+
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+
 clock_t clock(void);
 double difftime(time_t time1, time_t time0);
 time_t mktime(struct tm* tm);
 time_t time(time_t* tloc);
 int nanosleep(const struct timespec* req, struct timespec* rem);
 int timespec_get(struct timespec* ts, int base);
+int clock_gettime(clockid_t clock_id, struct timespec* ts);
+int clock_getres(clockid_t clock_id, struct timespec* res);
 
 char* asctime(const struct tm* tm);
 char* ctime(const time_t* timer);
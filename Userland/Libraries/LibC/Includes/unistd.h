@@ -28,6 +28,8 @@ void* sbrk(intptr_t increment);
 int clear_screen(void);
 
 pid_t fork(void);
+pid_t getpid(void);
+pid_t getppid(void);
 int execve(const char* path, char* const argv[], char* const envp[]);
 int execv(const char* path, char* const argv[]);
 int execvp(const char* file, char* const argv[]);
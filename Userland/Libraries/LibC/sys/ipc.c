@@ -111,3 +111,14 @@ ssize_t msgrcv(int msqid, void* msgp, size_t msgsz, long msgtyp, int msgflg)
     }
     return (ssize_t) rc;
 }
+
+int msgctl(int msqid, int cmd, struct msqid_ds* buf)
+{
+    (void) buf;
+    if (sys_msgctl(msqid, cmd) < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
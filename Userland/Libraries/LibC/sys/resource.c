@@ -0,0 +1,146 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <syscall.h>
+
+int getpriority(int which, id_t who)
+{
+    if (which != PRIO_PROCESS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The kernel answers 20 - nice so that -1 stays free for errors.
+    int raw = sys_getpriority(SYS_PRIO_PROCESS, (int) who);
+    if (raw < 0)
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    errno = 0;
+    return 20 - raw;
+}
+
+int setpriority(int which, id_t who, int prio)
+{
+    if (which != PRIO_PROCESS)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (sys_setpriority(SYS_PRIO_PROCESS, (int) who, prio) < 0)
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void rusage_ns_to_timeval(uint64_t ns, struct timeval* out)
+{
+    out->tv_sec = (time_t) (ns / 1000000000ULL);
+    out->tv_usec = (suseconds_t) ((ns % 1000000000ULL) / 1000ULL);
+}
+
+int getrusage(int who, struct rusage* usage)
+{
+    if (!usage)
+    {
+        errno = EFAULT;
+        return -1;
+    }
+
+    uint32_t kernel_who;
+    if (who == RUSAGE_SELF)
+        kernel_who = SYS_RUSAGE_SELF;
+    else if (who == RUSAGE_THREAD)
+        kernel_who = SYS_RUSAGE_THREAD;
+    else if (who == RUSAGE_CHILDREN)
+        kernel_who = SYS_RUSAGE_CHILDREN;
+    else
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    syscall_rusage_t raw;
+    if (sys_getrusage(kernel_who, &raw) < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(usage, 0, sizeof(*usage));
+    rusage_ns_to_timeval(raw.utime_ns, &usage->ru_utime);
+    rusage_ns_to_timeval(raw.stime_ns, &usage->ru_stime);
+    usage->ru_nvcsw = (long) raw.nvcsw;
+    usage->ru_nivcsw = (long) raw.nivcsw;
+    return 0;
+}
+
+static int rlimit_to_kernel(int resource, uint32_t* out_resource)
+{
+    if (resource == RLIMIT_AS)
+        *out_resource = SYS_RLIMIT_AS;
+    else if (resource == RLIMIT_RSS)
+        *out_resource = SYS_RLIMIT_RSS;
+    else
+        return -1;
+
+    return 0;
+}
+
+int getrlimit(int resource, struct rlimit* rlim)
+{
+    uint32_t kernel_resource;
+    if (rlimit_to_kernel(resource, &kernel_resource) < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!rlim)
+    {
+        errno = EFAULT;
+        return -1;
+    }
+
+    syscall_rlimit_t raw;
+    if (sys_getrlimit(kernel_resource, &raw) < 0)
+    {
+        errno = EFAULT;
+        return -1;
+    }
+
+    rlim->rlim_cur = (rlim_t) raw.cur;
+    rlim->rlim_max = (rlim_t) raw.max;
+    return 0;
+}
+
+int setrlimit(int resource, const struct rlimit* rlim)
+{
+    uint32_t kernel_resource;
+    if (rlimit_to_kernel(resource, &kernel_resource) < 0 || !rlim)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (rlim->rlim_cur > rlim->rlim_max)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // With sane arguments, the kernel only refuses raising the hard limit.
+    syscall_rlimit_t raw = { (uint64_t) rlim->rlim_cur, (uint64_t) rlim->rlim_max };
+    if (sys_setrlimit(kernel_resource, &raw) < 0)
+    {
+        errno = EPERM;
+        return -1;
+    }
+
+    return 0;
+}
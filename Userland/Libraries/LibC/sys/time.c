@@ -3,8 +3,6 @@
 #include <sys/time.h>
 #include <syscall.h>
 
-static uint32_t LibC_time_tick_hz_cache = 100U;
-
 static int LibC_time_valid_which(int which)
 {
     return (which == ITIMER_REAL || which == ITIMER_VIRTUAL || which == ITIMER_PROF);
@@ -34,51 +32,14 @@ static void LibC_time_clear_itimer(struct itimerval* itv)
     itv->it_value.tv_usec = 0;
 }
 
-static void LibC_time_fill_timeval_from_ticks(struct timeval* tv, uint64_t ticks, uint32_t tick_hz)
-{
-    if (!tv)
-        return;
-
-    if (tick_hz == 0)
-        tick_hz = 100U;
-
-    tv->tv_sec = (time_t) (ticks / (uint64_t) tick_hz);
-    uint64_t rem_ticks = ticks % (uint64_t) tick_hz;
-    tv->tv_usec = (suseconds_t) ((rem_ticks * 1000000ULL) / (uint64_t) tick_hz);
-}
-
 int gettimeofday(struct timeval* tv, struct timezone* tz)
 {
     if (tv)
     {
-        uint64_t rtc_seconds = sys_rtc_time_get();
-        if (rtc_seconds != 0ULL)
-        {
-            tv->tv_sec = (time_t) rtc_seconds;
-            tv->tv_usec = 0;
-        }
-        else
-        {
-            syscall_cpu_info_t info;
-            uint64_t ticks = 0;
-            uint32_t tick_hz = 0;
-
-            if (sys_cpu_info_get(&info) == 0 && info.tick_hz != 0)
-            {
-                ticks = info.ticks;
-                tick_hz = info.tick_hz;
-                LibC_time_tick_hz_cache = tick_hz;
-            }
-            else
-            {
-                ticks = sys_tick_get();
-                tick_hz = LibC_time_tick_hz_cache;
-                if (tick_hz == 0)
-                    tick_hz = 100U;
-            }
-
-            LibC_time_fill_timeval_from_ticks(tv, ticks, tick_hz);
-        }
+        // Read from the vvar page: no syscall. Without an RTC this is time since boot.
+        uint64_t ns = sys_realtime_ns();
+        tv->tv_sec = (time_t) (ns / 1000000000ULL);
+        tv->tv_usec = (suseconds_t) ((ns % 1000000000ULL) / 1000ULL);
     }
 
     if (tz)
@@ -0,0 +1,32 @@
+#include <errno.h>
+#include <sys/times.h>
+#include <syscall.h>
+
+static clock_t times_ns_to_ticks(uint64_t ns, uint32_t tick_hz)
+{
+    return (clock_t) ((ns / 1000000000ULL) * tick_hz + ((ns % 1000000000ULL) * tick_hz) / 1000000000ULL);
+}
+
+clock_t times(struct tms* buffer)
+{
+    if (buffer)
+    {
+        syscall_cpu_info_t info;
+        syscall_rusage_t self;
+        syscall_rusage_t children;
+        if (sys_cpu_info_get(&info) < 0 || info.tick_hz == 0U ||
+            sys_getrusage(SYS_RUSAGE_SELF, &self) < 0 ||
+            sys_getrusage(SYS_RUSAGE_CHILDREN, &children) < 0)
+        {
+            errno = EINVAL;
+            return (clock_t) -1;
+        }
+
+        buffer->tms_utime = times_ns_to_ticks(self.utime_ns, info.tick_hz);
+        buffer->tms_stime = times_ns_to_ticks(self.stime_ns, info.tick_hz);
+        buffer->tms_cutime = times_ns_to_ticks(children.utime_ns, info.tick_hz);
+        buffer->tms_cstime = times_ns_to_ticks(children.stime_ns, info.tick_hz);
+    }
+
+    return (clock_t) sys_tick_get();
+}
@@ -1,5 +1,46 @@
 #include <syscall.h>
 
+// Mapped read-only by exec in every process; the kernel rewrites it on each tick.
+static const volatile syscall_vvar_t* const LibC_vvar = (const volatile syscall_vvar_t*) (uintptr_t) SYS_VVAR_ADDR;
+
+static inline uint64_t LibC_vvar_rdtsc(void)
+{
+    uint32_t lo;
+    uint32_t hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | (uint64_t) lo;
+}
+
+static uint64_t LibC_vvar_clock_ns(int realtime)
+{
+    const uint64_t low_mask = (1ULL << SYS_VVAR_TSC_SHIFT) - 1ULL;
+    for (;;)
+    {
+        uint32_t seq = __atomic_load_n(&LibC_vvar->seq, __ATOMIC_ACQUIRE);
+        if ((seq & 1U) != 0U)
+        {
+            __asm__ __volatile__("pause");
+            continue;
+        }
+
+        uint64_t tsc_base = LibC_vvar->tsc_base;
+        uint64_t tsc_mult = LibC_vvar->tsc_mult;
+        uint64_t ns = LibC_vvar->ns_base;
+        uint64_t offset = realtime ? LibC_vvar->realtime_offset_ns : 0ULL;
+        uint64_t tsc = LibC_vvar_rdtsc();
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&LibC_vvar->seq, __ATOMIC_RELAXED) != seq)
+            continue;
+
+        if (tsc_mult != 0ULL && tsc > tsc_base)
+        {
+            uint64_t delta = tsc - tsc_base;
+            ns += (delta >> SYS_VVAR_TSC_SHIFT) * tsc_mult + (((delta & low_mask) * tsc_mult) >> SYS_VVAR_TSC_SHIFT);
+        }
+        return ns + offset;
+    }
+}
+
 int fs_is_dir(const char* path)
 {
     return (int) syscall(SYS_FS_ISDIR, (long) path, 0, 0, 0, 0, 0);
@@ -22,7 +63,17 @@ int sys_sleep_ms(uint32_t ms)
 
 uint64_t sys_tick_get(void)
 {
-    return (uint64_t) syscall(SYS_TICK_GET, 0, 0, 0, 0, 0, 0);
+    return LibC_vvar->ticks;
+}
+
+uint64_t sys_monotonic_ns(void)
+{
+    return LibC_vvar_clock_ns(0);
+}
+
+uint64_t sys_realtime_ns(void)
+{
+    return LibC_vvar_clock_ns(1);
 }
 
 uint64_t sys_rtc_time_get(void)
@@ -129,6 +180,31 @@ int sys_yield(void)
     return (int) syscall(SYS_YIELD, 0, 0, 0, 0, 0, 0);
 }
 
+int sys_getpid(void)
+{
+    return (int) syscall(SYS_GETPID, 0, 0, 0, 0, 0, 0);
+}
+
+int sys_getppid(void)
+{
+    return (int) syscall(SYS_GETPPID, 0, 0, 0, 0, 0, 0);
+}
+
+int sys_syscall_stats_get(syscall_stats_info_t* out_info)
+{
+    return (int) syscall(SYS_SYSCALL_STATS_GET, (long) out_info, 0, 0, 0, 0, 0);
+}
+
+int sys_tlb_info_get(syscall_tlb_info_t* out_info)
+{
+    return (int) syscall(SYS_TLB_INFO_GET, (long) out_info, 0, 0, 0, 0, 0);
+}
+
+int sys_mem_info_get(syscall_mem_info_t* out_info)
+{
+    return (int) syscall(SYS_MEM_INFO_GET, (long) out_info, 0, 0, 0, 0, 0);
+}
+
 void* sys_map_ex(void* addr, size_t len, uint64_t prot, uint64_t flags, int fd, uint64_t offset)
 {
     long ret = syscall(SYS_MAP, (long) addr, (long) len, (long) prot, (long) flags, (long) fd, (long) offset);
@@ -385,3 +461,68 @@ long sys_msgrcv(int msqid, void* msgp, size_t msgsz, long msgtyp, int msgflg)
 {
     return syscall(SYS_MSGRCV, (long) msqid, (long) msgp, (long) msgsz, (long) msgtyp, (long) msgflg, 0);
 }
+
+int sys_msgctl(int msqid, int cmd)
+{
+    return (int) syscall(SYS_MSGCTL, (long) msqid, (long) cmd, 0, 0, 0, 0);
+}
+
+int sys_setpriority(uint32_t which, int who, int nice_value)
+{
+    return (int) syscall(SYS_SETPRIORITY, (long) which, (long) who, (long) nice_value, 0, 0, 0);
+}
+
+int sys_getpriority(uint32_t which, int who)
+{
+    return (int) syscall(SYS_GETPRIORITY, (long) which, (long) who, 0, 0, 0, 0);
+}
+
+int sys_sched_setscheduler(int pid, uint32_t policy, uint32_t rt_priority)
+{
+    return (int) syscall(SYS_SCHED_SETSCHEDULER, (long) pid, (long) policy, (long) rt_priority, 0, 0, 0);
+}
+
+int sys_sched_getscheduler(int pid, int* out_rt_priority)
+{
+    return (int) syscall(SYS_SCHED_GETSCHEDULER, (long) pid, (long) out_rt_priority, 0, 0, 0, 0);
+}
+
+int sys_sched_setaffinity(int pid, size_t len, const uint64_t* mask)
+{
+    return (int) syscall(SYS_SCHED_SETAFFINITY, (long) pid, (long) len, (long) mask, 0, 0, 0);
+}
+
+int sys_sched_getaffinity(int pid, size_t len, uint64_t* mask)
+{
+    return (int) syscall(SYS_SCHED_GETAFFINITY, (long) pid, (long) len, (long) mask, 0, 0, 0);
+}
+
+int sys_getrusage(uint32_t who, syscall_rusage_t* out_usage)
+{
+    return (int) syscall(SYS_GETRUSAGE, (long) who, (long) out_usage, 0, 0, 0, 0);
+}
+
+int sys_getrlimit(uint32_t resource, syscall_rlimit_t* out_limit)
+{
+    return (int) syscall(SYS_GETRLIMIT, (long) resource, (long) out_limit, 0, 0, 0, 0);
+}
+
+int sys_setrlimit(uint32_t resource, const syscall_rlimit_t* limit)
+{
+    return (int) syscall(SYS_SETRLIMIT, (long) resource, (long) limit, 0, 0, 0, 0);
+}
+
+int sys_kmem_info_get(syscall_kmem_info_t* out_info, uint32_t flags)
+{
+    return (int) syscall(SYS_KMEM_INFO_GET, (long) out_info, (long) flags, 0, 0, 0, 0);
+}
+
+int sys_sync(uint32_t flags)
+{
+    return (int) syscall(SYS_SYNC, (long) flags, 0, 0, 0, 0, 0);
+}
+
+int sys_ipc_info_get(syscall_ipc_info_t* out_info)
+{
+    return (int) syscall(SYS_IPC_INFO_GET, (long) out_info, 0, 0, 0, 0, 0);
+}
@@ -84,10 +84,12 @@ static int LibC_time_append_num(char* dst, size_t max, size_t* io_pos, int value
 
 clock_t clock(void)
 {
-    struct timeval tv;
-    if (gettimeofday(&tv, NULL) != 0)
+    syscall_rusage_t usage;
+    if (sys_getrusage(SYS_RUSAGE_SELF, &usage) < 0)
         return (clock_t) -1;
-    return (clock_t) ((tv.tv_sec * (time_t) CLOCKS_PER_SEC) + ((tv.tv_usec * CLOCKS_PER_SEC) / 1000000L));
+
+    uint64_t cpu_ns = usage.utime_ns + usage.stime_ns;
+    return (clock_t) (cpu_ns / (1000000000ULL / (uint64_t) CLOCKS_PER_SEC));
 }
 
 double difftime(time_t time1, time_t time0)
@@ -138,13 +140,48 @@ int timespec_get(struct timespec* ts, int base)
     if (!ts || base != TIME_UTC)
         return 0;
 
-    struct timeval tv;
-    if (gettimeofday(&tv, NULL) != 0)
-        return 0;
+    return clock_gettime(CLOCK_REALTIME, ts) == 0 ? base : 0;
+}
+
+int clock_gettime(clockid_t clock_id, struct timespec* ts)
+{
+    if (!ts)
+    {
+        errno = EFAULT;
+        return -1;
+    }
+
+    uint64_t ns;
+    if (clock_id == CLOCK_REALTIME)
+        ns = sys_realtime_ns();
+    else if (clock_id == CLOCK_MONOTONIC)
+        ns = sys_monotonic_ns();
+    else
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ts->tv_sec = (time_t) (ns / 1000000000ULL);
+    ts->tv_nsec = (long) (ns % 1000000000ULL);
+    return 0;
+}
+
+int clock_getres(clockid_t clock_id, struct timespec* res)
+{
+    if (clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC)
+    {
+        errno = EINVAL;
+        return -1;
+    }
 
-    ts->tv_sec = tv.tv_sec;
-    ts->tv_nsec = tv.tv_usec * 1000L;
-    return base;
+    // Both clocks interpolate the TSC between ticks (the kernel calibrates it before userland starts).
+    if (res)
+    {
+        res->tv_sec = 0;
+        res->tv_nsec = 1L;
+    }
+    return 0;
 }
 
 struct tm* gmtime(const time_t* timer)
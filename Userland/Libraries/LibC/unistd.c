@@ -716,6 +716,16 @@ pid_t fork(void)
     return (pid_t) rc;
 }
 
+pid_t getpid(void)
+{
+    return (pid_t) sys_getpid();
+}
+
+pid_t getppid(void)
+{
+    return (pid_t) sys_getppid();
+}
+
 int execve(const char* path, char* const argv[], char* const envp[])
 {
     if (!path || path[0] == '\0')
@@ -1039,7 +1049,7 @@ void* mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset)
         return MAP_FAILED;
     }
 
-    int supported_flags = MAP_PRIVATE | MAP_SHARED | MAP_ANONYMOUS;
+    int supported_flags = MAP_PRIVATE | MAP_SHARED | MAP_ANONYMOUS | MAP_POPULATE;
     bool is_private = (flags & MAP_PRIVATE) != 0;
     bool is_shared = (flags & MAP_SHARED) != 0;
     if ((flags & ~supported_flags) != 0)
@@ -1193,6 +1203,120 @@ int sched_yield(void)
     return 0;
 }
 
+int sched_get_priority_min(int policy)
+{
+    if (policy == SCHED_FIFO || policy == SCHED_RR)
+        return (int) SYS_SCHED_RT_PRIO_MIN;
+    if (policy == SCHED_OTHER)
+        return 0;
+
+    errno = EINVAL;
+    return -1;
+}
+
+int sched_get_priority_max(int policy)
+{
+    if (policy == SCHED_FIFO || policy == SCHED_RR)
+        return (int) SYS_SCHED_RT_PRIO_MAX;
+    if (policy == SCHED_OTHER)
+        return 0;
+
+    errno = EINVAL;
+    return -1;
+}
+
+int sched_setscheduler(pid_t pid, int policy, const struct sched_param* param)
+{
+    if (!param || pid < 0 || policy < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (sys_sched_setscheduler((int) pid, (uint32_t) policy, (uint32_t) param->sched_priority) < 0)
+    {
+        errno = (pid == 0) ? EINVAL : ESRCH;
+        return -1;
+    }
+
+    return 0;
+}
+
+int sched_getscheduler(pid_t pid)
+{
+    int policy = sys_sched_getscheduler((int) pid, NULL);
+    if (policy < 0)
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    return policy;
+}
+
+int sched_setparam(pid_t pid, const struct sched_param* param)
+{
+    int policy = sched_getscheduler(pid);
+    if (policy < 0)
+        return -1;
+
+    return sched_setscheduler(pid, policy, param);
+}
+
+int sched_getparam(pid_t pid, struct sched_param* param)
+{
+    if (!param)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int rt_priority = 0;
+    if (sys_sched_getscheduler((int) pid, &rt_priority) < 0)
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    param->sched_priority = rt_priority;
+    return 0;
+}
+
+int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t* mask)
+{
+    if (!mask || cpusetsize == 0)
+    {
+        errno = EFAULT;
+        return -1;
+    }
+
+    if (sys_sched_setaffinity((int) pid, cpusetsize, mask->__bits) < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t* mask)
+{
+    if (!mask || cpusetsize < sizeof(uint64_t))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(mask, 0, cpusetsize < sizeof(*mask) ? cpusetsize : sizeof(*mask));
+    if (sys_sched_getaffinity((int) pid, cpusetsize, mask->__bits) < 0)
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    return 0;
+}
+
 unsigned int sleep(unsigned int seconds)
 {
     uint64_t remaining_ms = (uint64_t) seconds * 1000ULL;